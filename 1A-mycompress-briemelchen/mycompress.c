@@ -7,10 +7,11 @@
  * 
  * @details mycompress takes as option -o outputfile, where outputfile is a  file, if no output file is given, it will  print to stdout. 
  * Furthermore, the programm takes a arbitrarily number of input files as arguments. If no input files are given, mycompress reads from stdin.
- * Foreach inputfile given, mycompress reads them and compresses them line-by-line, after compressing, they are written to the given output-file (or stdout).
+ * Foreach inputfile given, mycompress reads them in blocks and compresses them, after compressing, they are written to the given output-file (or stdout).
  * The compress process runs as followed: the input is compressed by subsituting subsequent identical characters by only one occurence of the character followed
  * by the number of characters(e.g aaabb => a3b2). This process also handles new-line characters. After the compressing, the compressed lines are printed
  * to the output file. Statistics containing the number of written/read characters as well as a compression ratio are printed to sterr.
+ * With -b the input is written as a binary container instead, which is read again with -d (see pack_and_print for the format).
  * 
  * 
  */
@@ -25,15 +26,41 @@
 
 #include <string.h>
 
-#include <string.h>
+#include <stdint.h>
 
 #define PROGRAM_NAME "mycompress"
 
+#define BLOCK_SIZE (64 * 1024) // size of the blocks the input is read in
+#define OUT_SIZE (64 * 1024)   // size of the output buffer
+#define MAX_RUN_TEXT 21        // maximal length of a character followed by a count
+
+#define CONTAINER_MAGIC "MCRL"                // magic bytes at the beginning of a container
+#define CONTAINER_INDEX_MAGIC "MCRX"          // magic bytes at the end of a container
+#define CONTAINER_VERSION 1                   // version of the container format
+#define CONTAINER_BLOCK_SIZE (1024 * 1024)    // input bytes per block of a container
+#define CONTAINER_MAX_BLOCK (64 * 1024 * 1024) // maximal block size accepted by -d
+#define CONTAINER_RUN_MIN 3                   // shorter runs are stored as literals
+#define MAX_PAYLOAD(size) ((size) + (size) / 64 + 64) // maximal payload of a block with size input bytes
+
+/**
+ * @brief holds the state of the compression of one input between two blocks.
+ */
+typedef struct
+{
+    int fd;                  // file descriptor of the output
+    char current;            // character of the current run
+    long int count;          // length of the current run, 0 if there is none
+    int line_started;        // 1 if a run of the current line has already been started, otherwise 0
+    long int new_line_chars; // count of newline characters preceding the next line
+    size_t out_len;          // number of bytes in out
+    char out[OUT_SIZE];      // compressed output which is not written yet
+} encoder;
+
 /**
  * @brief reads from an input file, compresses it and writes the compressed lines to an output file.
- * @details compress_and_print reads from an input in file compresses it (via function compress(..)) and writes it to the outputfile out.
- * Foreach line compress(..) gets called. The input file gets closed after processing it. The output file is not and has to be closed by callers of compress_and_print.
- * Additional, the function calls has_new_line_chars for each line, to check if there are newline- characters which need to be processed.
+ * @details compress_and_print reads from an input in file in blocks of BLOCK_SIZE bytes, compresses them (via function compress(..))
+ * and writes the output to the outputfile out. Runs and newline characters at the end of a block are continued with the next block.
+ * The input file gets closed after processing it. The output file is not and has to be closed by callers of compress_and_print.
  * If any error occurs, the error is written to sterr and the program exits. Uses global variable final_stats to update the statistics.
  * @param in which should be read and compressed. In is closed after processing.
  * @param out which the compressed string is written to. Out is NOT closed after processing. 
@@ -43,25 +70,125 @@
 static void compress_and_print(FILE *in, FILE *out);
 
 /**
- * @brief compress takes an char-pointer aswell as integerpointer. The string is getting compressed as specified. The compressed string is returned.
- * @details compress takes an charpointer and iterates through it char by char (until terminating byte is reached). The string 
- * is compressed by substituting subsequent identical characters by only one occurrence of the character followed by the number of characters(e.g aaabb => a3b2)
- * The additional parameter new_line_chars holds the address of an integer, where the numbers of preceded newline characters (\n) is saved. 
- * (e.g. if 2 newlines preeceded the line aabb => 2a2b2)
- * When error occurs (e.g. memory allocation fails) the program exits. Uses global variable final_stats to update the statistics.
- * @param toCompress pointer to the char(s) which should be compressed.
- * @param new_line_chars holds the address of the count of preceded newline characters
- * @return the compressed string in the specified format.
+ * @brief reads from an input file and writes it as a binary container to an output file.
+ * @details the container has the following layout (integers are little endian, varints have 7 bits per byte and the highest
+ * bit set on all but the last byte):
+ * - header: "MCRL", version (1 byte), block size (4 bytes)
+ * - blocks: input length (varint), payload length (varint), payload
+ * - end:    0 (varint)
+ * - index:  offset of every block from the start of the container (8 bytes each)
+ * - footer: number of blocks (8 bytes), offset of the index (8 bytes), "MCRX"
+ * Every block but the last holds block size bytes of the input, so any position can be found with the index. The payload
+ * is a sequence of tokens: a varint t, where t even is a run of t / 2 + CONTAINER_RUN_MIN copies of the next byte, and t odd
+ * are t / 2 + 1 literal bytes which follow. The input file gets closed after processing it, out not.
+ * If any error occurs, the error is written to sterr and the program exits. Uses global variable final_stats to update the statistics.
+ * @param in which should be read and packed. In is closed after processing.
+ * @param out which the container is written to. Out is NOT closed after processing.
+ */
+static void pack_and_print(FILE *in, FILE *out);
+
+/**
+ * @brief reads binary containers from an input file and writes their original data to an output file.
+ * @details (concatenated) containers are read as written by pack_and_print, each block is decoded with memset/memcpy and
+ * written with one write. If the input is not a valid container, the error is written to sterr and the program exits.
+ * Uses global variable final_stats to update the statistics.
+ * @param in which should be read and unpacked. In is closed after processing.
+ * @param out which the original data is written to. Out is NOT closed after processing.
  */
-static char *compress(char *toCompress, int *new_line_chars);
+static void unpack_and_print(FILE *in, FILE *out);
 
 /**
- * @brief checks if a given char-pointer (which has to be \0 terminated), contains a new line character '\n'
- * @details takes a string and checks if it contains a new line character '\n'. Returns 0 if it contains one, otherwise -1.
- * @param str string to be checked. Has to be NUL-terminated ('\0')
- * @return 0 if the string contains a new line character, otherwise -1
+ * @brief encodes a block of the input into the tokens of a container.
+ * @param raw block of the input
+ * @param len number of bytes in raw
+ * @param payload buffer of at least MAX_PAYLOAD(len) bytes, where the tokens are written to
+ * @return number of bytes written to payload
  */
-static int has_new_line_char(char *str);
+static size_t pack_block(const char *raw, size_t len, unsigned char *payload);
+
+/**
+ * @brief decodes the tokens of a block of a container.
+ * @param payload tokens of the block
+ * @param len number of bytes in payload
+ * @param raw buffer where the decoded bytes are written to
+ * @param raw_len number of bytes the block has to have
+ * @return 0 on success, -1 if the tokens are invalid
+ */
+static int unpack_block(const unsigned char *payload, size_t len, char *raw, size_t raw_len);
+
+/**
+ * @brief encodes a varint.
+ * @param dst buffer with space for at least 10 bytes
+ * @param value to be encoded
+ * @return number of bytes written to dst
+ */
+static size_t put_varint(unsigned char *dst, uint64_t value);
+
+/**
+ * @brief reads a varint of an container from fd.
+ * @details exits the program if the input ends before the varint. Uses global variable final_stats to update the statistics.
+ * @param fd file descriptor to read from
+ * @return the value of the varint
+ */
+static uint64_t read_varint(int fd);
+
+/**
+ * @brief reads until len bytes are read or the end of the file is reached.
+ * @details exits the program if reading fails. Uses global variable final_stats to update the statistics.
+ * @param fd file descriptor to read from
+ * @param data buffer for the bytes
+ * @param len number of bytes to read
+ * @return number of bytes read (less than len only at the end of the file)
+ */
+static size_t read_all(int fd, void *data, size_t len);
+
+/**
+ * @brief writes all len bytes with write.
+ * @details exits the program if writing fails. Uses global variable final_stats to update the statistics.
+ * @param fd file descriptor to write to
+ * @param data bytes to be written
+ * @param len number of bytes to write
+ */
+static void write_all(int fd, const void *data, size_t len);
+
+/**
+ * @brief compress takes a block of the input and compresses it as specified into the output buffer of the encoder.
+ * @details the block is compressed by substituting subsequent identical characters by only one occurrence of the character followed
+ * by the number of characters(e.g aaabb => a3b2). Each line is ended by a newline character, the number of newline characters preceding
+ * a line is written before it (e.g. if 2 newlines preeceded the line aabb => 2a2b2).
+ * The last run of the block is not written yet, as it might be continued by the next block.
+ * When error occurs (e.g. writing fails) the program exits.
+ * @param enc encoder holding the state of the compression
+ * @param block pointer to the chars which should be compressed.
+ * @param len number of chars in block
+ */
+static void compress(encoder *enc, const char *block, size_t len);
+
+/**
+ * @brief counts how often the first char of data is repeated at the beginning of data.
+ * @details compares 8 chars at once as 64 bit words, only the last word is compared char by char.
+ * @param data pointer to the chars (at least one)
+ * @param len number of chars in data
+ * @return length of the run (at least 1)
+ */
+static size_t run_length(const char *data, size_t len);
+
+/**
+ * @brief appends a character and/or a count to the output buffer of the encoder.
+ * @details the buffer is written to the output if there is not enough space left. If c is '\0' only the count is appended,
+ * if count is 0 only the character is appended.
+ * @param enc encoder holding the output buffer
+ * @param c character to be appended or '\0'
+ * @param count count to be appended or 0
+ */
+static void emit(encoder *enc, char c, long int count);
+
+/**
+ * @brief writes the output buffer of the encoder to the output with write.
+ * @details exits the program if writing fails. Uses global variable final_stats to update the statistics.
+ * @param enc encoder holding the output buffer
+ */
+static void flush_output(encoder *enc);
 
 /**
  * @brief prints the usage message to stderr of the program and exits.
@@ -96,10 +223,21 @@ int main(int argc, char **argv)
     int opt_o = 0;
     char c;
     FILE *out;
-    while ((c = getopt(argc, argv, "o:")) != -1)
+    void (*process)(FILE *, FILE *) = compress_and_print; // function which processes each input file
+    while ((c = getopt(argc, argv, "o:bd")) != -1)
     {
         switch (c)
         {
+        case 'b':
+            if (process != compress_and_print)
+                usage();
+            process = pack_and_print;
+            break;
+        case 'd':
+            if (process != compress_and_print)
+                usage();
+            process = unpack_and_print;
+            break;
         case 'o':
             opt_o++;
             if (opt_o >= 2)
@@ -141,7 +279,7 @@ int main(int argc, char **argv)
     if (argv[arg_index] == NULL)
     {
         FILE *in = stdin;
-        compress_and_print(in, out);
+        process(in, out);
         if (fclose(out) != 0)
         {
             error("fclose failed");
@@ -158,7 +296,7 @@ int main(int argc, char **argv)
             }
             else
             {
-                compress_and_print(in, out);
+                process(in, out);
             }
 
             arg_index++;
@@ -176,128 +314,445 @@ int main(int argc, char **argv)
 
 static void compress_and_print(FILE *in, FILE *out)
 {
-    char *line = NULL;
-    size_t n = 0;
-    ssize_t result;
-    int new_line_chars = 0;
+    static char block[BLOCK_SIZE];
+    static encoder enc;
+    enc.fd = fileno(out);
+    enc.count = 0;
+    enc.line_started = 0;
+    enc.new_line_chars = 0;
+    enc.out_len = 0;
 
-    while ((result = getline(&line, &n, in)) != -1)
+    ssize_t result;
+    while ((result = read(fileno(in), block, BLOCK_SIZE)) != 0)
     {
-        char *compressed = compress(line, &new_line_chars);
-        if (fputs(compressed, out) < 0)
+        if (result == -1 && errno == EINTR)
         {
-            free(line);
-            error("Writing to stream failed: fputs failed");
+            continue;
         }
-
-        if (has_new_line_char(line) == 0)
+        if (result == -1)
         {
-            new_line_chars++;
+            error("Reading from File failed");
         }
-        free(compressed);
+        compress(&enc, block, result);
         final_stats.read_chars += result; // update statistics
     }
 
-    free(line);
+    // the last run, line and newline characters
+    if (enc.count != 0)
+    {
+        emit(&enc, enc.current, enc.count);
+    }
+    if (enc.line_started)
+    {
+        emit(&enc, '\n', 0);
+    }
+    if (enc.new_line_chars != 0)
+    {
+        emit(&enc, '\0', enc.new_line_chars);
+        emit(&enc, '\n', 0);
+    }
+    flush_output(&enc);
+
+    if (fclose(in) != 0)
+    {
+        error("fclose failed");
+    }
+}
 
-    if (new_line_chars != 0)
+static void compress(encoder *enc, const char *block, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len)
     {
-        int bytes_needed = snprintf(NULL, 0, "%d", new_line_chars);
-        char *buffer = malloc(bytes_needed + 2);
-        snprintf(buffer, bytes_needed + 2, "%d", new_line_chars);
-        strncat(buffer, "\n", 2);
-        final_stats.written_chars += 1;
-        if (fputs(buffer, out) < 0)
+        char ac_char = block[pos];
+        size_t count = run_length(block + pos, len - pos);
+        pos += count;
+
+        if (ac_char == '\n') // ends the line, all further newlines are counted
+        {
+            if (enc->count != 0)
+            {
+                emit(enc, enc->current, enc->count);
+                enc->count = 0;
+            }
+            if (enc->line_started)
+            {
+                emit(enc, '\n', 0);
+                enc->line_started = 0;
+            }
+            enc->new_line_chars += count;
+        }
+        else if (enc->count != 0 && enc->current == ac_char) // run continued from the last block
         {
-            error("Writing to stream failed: fputs failed");
+            enc->count += count;
+        }
+        else
+        {
+            if (enc->count != 0)
+            {
+                emit(enc, enc->current, enc->count);
+            }
+            else if (!enc->line_started) // first run of the line -> add preceding newline-characters
+            {
+                if (enc->new_line_chars != 0)
+                {
+                    emit(enc, '\0', enc->new_line_chars);
+                }
+                enc->new_line_chars = 0;
+                enc->line_started = 1;
+            }
+            enc->current = ac_char;
+            enc->count = count;
         }
-        free(buffer);
     }
+}
 
-    if (ferror(in) != 0)
+static size_t run_length(const char *data, size_t len)
+{
+    size_t i = 1;
+    if (i == len || data[i] != data[0]) // most runs are short
     {
-        error("Reading from File failed");
+        return i;
     }
 
-    if (fclose(in) != 0)
+    uint64_t pattern = 0x0101010101010101ULL * (unsigned char)data[0];
+    for (; i + 8 <= len; i += 8)
     {
-        error("fclose failed");
+        uint64_t word;
+        memcpy(&word, data + i, sizeof(word));
+        if (word != pattern)
+        {
+            break;
+        }
+    }
+    while (i < len && data[i] == data[0])
+    {
+        i++;
     }
+    return i;
 }
 
-static char *compress(char *toCompress, int *new_line_chars)
+static void emit(encoder *enc, char c, long int count)
 {
+    if (enc->out_len + MAX_RUN_TEXT > OUT_SIZE)
+    {
+        flush_output(enc);
+    }
+    if (c != '\0')
+    {
+        enc->out[enc->out_len++] = c;
+    }
+    if (count != 0)
+    {
+        char digits[20];
+        int n = 0;
+        for (; count > 0; count /= 10)
+        {
+            digits[n++] = '0' + count % 10;
+        }
+        while (n > 0)
+        {
+            enc->out[enc->out_len++] = digits[--n];
+        }
+    }
+}
 
-    int needed_bytes_newlines = snprintf(NULL, 0, "%d", *new_line_chars); // size needed for storing the new-line-char
+static void flush_output(encoder *enc)
+{
+    write_all(enc->fd, enc->out, enc->out_len);
+    enc->out_len = 0;
+}
 
-    // max size is size of input * 2 if no consecutive chars are given (e.g.: "abc" -> "a1b1c1") + newline-char + null byte + bytes needed for preceding newline chars
-    char *compressed = malloc(sizeof(char) * strlen(toCompress) * 2 + 2 + needed_bytes_newlines);
-    long int count = 0;
-    strcpy(compressed, ""); //init empty string
-    if (compressed == NULL)
+/****************************************BINARY-CONTAINER*********************************************************/
+static void pack_and_print(FILE *in, FILE *out)
+{
+    static char raw[CONTAINER_BLOCK_SIZE];
+    static unsigned char payload[MAX_PAYLOAD(CONTAINER_BLOCK_SIZE)];
+    unsigned char head[20];
+    int fd = fileno(out);
+
+    size_t blocks = 0;
+    size_t index_size = 16;
+    uint64_t *index = malloc(sizeof(uint64_t) * index_size); // offsets of the blocks
+    if (index == NULL)
     {
         error("Memory allocation failed");
     }
 
-    if (*toCompress == '\n') // if line is empty
+    memcpy(head, CONTAINER_MAGIC, 4);
+    head[4] = CONTAINER_VERSION;
+    for (int i = 0; i < 4; i++)
+        head[5 + i] = (CONTAINER_BLOCK_SIZE >> (8 * i)) & 0xFF;
+    write_all(fd, head, 9);
+    uint64_t offset = 9;
+
+    size_t len;
+    while ((len = read_all(fileno(in), raw, CONTAINER_BLOCK_SIZE)) != 0)
     {
-        return compressed;
+        if (blocks == index_size) // index is to small -> realloc needed
+        {
+            index_size *= 2;
+            uint64_t *temp = realloc(index, sizeof(uint64_t) * index_size);
+            if (temp == NULL)
+            {
+                free(index);
+                error("Memory allocation failed");
+            }
+            index = temp;
+        }
+        index[blocks++] = offset;
+
+        size_t payload_len = pack_block(raw, len, payload);
+        size_t head_len = put_varint(head, len);
+        head_len += put_varint(head + head_len, payload_len);
+        write_all(fd, head, head_len);
+        write_all(fd, payload, payload_len);
+        offset += head_len + payload_len;
+
+        if (len < CONTAINER_BLOCK_SIZE) // end of the file
+            break;
     }
-    else if (*new_line_chars != 0) // adds preceding newline-characters
+
+    // end of the blocks, index and footer
+    head[0] = 0;
+    write_all(fd, head, 1);
+    uint64_t index_offset = offset + 1;
+    unsigned char entry[8];
+    for (size_t i = 0; i < blocks; i++)
+    {
+        for (int j = 0; j < 8; j++)
+            entry[j] = (index[i] >> (8 * j)) & 0xFF;
+        write_all(fd, entry, 8);
+    }
+    free(index);
+    unsigned char footer[20];
+    for (int j = 0; j < 8; j++)
     {
-        char *buffer = malloc(needed_bytes_newlines + 1);
-        snprintf(buffer, needed_bytes_newlines + 1, "%d", *new_line_chars);
-        strncat(compressed, buffer, needed_bytes_newlines);
-        final_stats.written_chars += strlen(buffer);
-        free(buffer);
-        *new_line_chars = 0;
+        footer[j] = ((uint64_t)blocks >> (8 * j)) & 0xFF;
+        footer[8 + j] = (index_offset >> (8 * j)) & 0xFF;
     }
+    memcpy(footer + 16, CONTAINER_INDEX_MAGIC, 4);
+    write_all(fd, footer, 20);
 
-    while (*toCompress != '\0')
+    if (fclose(in) != 0)
     {
-        char ac_char = *toCompress;
-       
-        while (*toCompress == ac_char)
+        error("fclose failed");
+    }
+}
+
+static void unpack_and_print(FILE *in, FILE *out)
+{
+    int in_fd = fileno(in);
+    int out_fd = fileno(out);
+    unsigned char header[20];
+    size_t len;
+    while ((len = read_all(in_fd, header, 9)) != 0) // one container per iteration
+    {
+        uint64_t block_size = header[5] | header[6] << 8 | header[7] << 16 | (uint64_t)header[8] << 24;
+        if (len != 9 || memcmp(header, CONTAINER_MAGIC, 4) != 0 || header[4] != CONTAINER_VERSION ||
+            block_size == 0 || block_size > CONTAINER_MAX_BLOCK)
         {
-            count++;
-            toCompress++;
+            errno = EINVAL;
+            error("Input is not a valid container");
+        }
+        char *raw = malloc(block_size);
+        unsigned char *payload = malloc(MAX_PAYLOAD(block_size));
+        if (raw == NULL || payload == NULL)
+        {
+            error("Memory allocation failed");
         }
 
-        if (ac_char != '\n')
+        uint64_t offset = 9;
+        uint64_t blocks = 0;
+        uint64_t raw_len;
+        while ((raw_len = read_varint(in_fd)) != 0)
         {
-            int bytes_needed = snprintf(NULL, 0, "%ld", count); // get buffer size for the count
-            char *buffer = malloc(bytes_needed + 1);
-            snprintf(buffer, bytes_needed + 1, "%ld", count);
+            uint64_t payload_len = read_varint(in_fd);
+            if (raw_len > block_size || payload_len > MAX_PAYLOAD(block_size) ||
+                read_all(in_fd, payload, payload_len) != payload_len ||
+                unpack_block(payload, payload_len, raw, raw_len) == -1)
+            {
+                errno = EINVAL;
+                error("Input is not a valid container");
+            }
+            write_all(out_fd, raw, raw_len);
+            unsigned char varints[20];
+            offset += put_varint(varints, raw_len) + put_varint(varints, payload_len) + payload_len;
+            blocks++;
+        }
+        free(raw);
+        free(payload);
 
-            if (buffer == NULL)
+        // skip the index and check the footer
+        uint64_t index_offset = offset + 1;
+        for (uint64_t i = 0; i < blocks; i++)
+        {
+            if (read_all(in_fd, header, 8) != 8)
             {
-                error("Memory allocation failed");
+                errno = EINVAL;
+                error("Input is not a valid container");
             }
+        }
+        uint64_t footer_blocks = 0, footer_offset = 0;
+        len = read_all(in_fd, header, 20);
+        for (int j = 7; j >= 0; j--)
+        {
+            footer_blocks = footer_blocks << 8 | header[j];
+            footer_offset = footer_offset << 8 | header[8 + j];
+        }
+        if (len != 20 || footer_blocks != blocks || footer_offset != index_offset ||
+            memcmp(header + 16, CONTAINER_INDEX_MAGIC, 4) != 0)
+        {
+            errno = EINVAL;
+            error("Input is not a valid container");
+        }
+    }
 
-            strncat(compressed, &ac_char, 1);
-            strncat(compressed, buffer, bytes_needed);
-            final_stats.written_chars += strlen(buffer) + 1;
-            free(buffer);
+    if (fclose(in) != 0)
+    {
+        error("fclose failed");
+    }
+}
+
+static size_t pack_block(const char *raw, size_t len, unsigned char *payload)
+{
+    size_t out = 0;
+    size_t literal = 0; // start of the literal bytes which are not written yet
+    size_t pos = 0;
+    while (pos <= len)
+    {
+        size_t count = pos < len ? run_length(raw + pos, len - pos) : 0;
+        if (pos < len && count < CONTAINER_RUN_MIN) // to short for a run
+        {
+            pos += count;
+            continue;
+        }
+        if (literal < pos)
+        {
+            out += put_varint(payload + out, ((pos - literal - 1) << 1) | 1);
+            memcpy(payload + out, raw + literal, pos - literal);
+            out += pos - literal;
+        }
+        if (pos == len)
+            break;
+        out += put_varint(payload + out, (count - CONTAINER_RUN_MIN) << 1);
+        payload[out++] = raw[pos];
+        pos += count;
+        literal = pos;
+    }
+    return out;
+}
+
+static int unpack_block(const unsigned char *payload, size_t len, char *raw, size_t raw_len)
+{
+    const unsigned char *end = payload + len;
+    size_t out = 0;
+    while (payload < end)
+    {
+        uint64_t token = 0;
+        int shift = 0;
+        do
+        {
+            if (payload == end || shift >= 64)
+                return -1;
+            token |= (uint64_t)(*payload & 0x7F) << shift;
+            shift += 7;
+        } while (*payload++ & 0x80);
+
+        if ((token >> 1) > raw_len)
+            return -1;
+        size_t count = token >> 1;
+        if (token & 1) // literal bytes
+        {
+            count += 1;
+            if ((size_t)(end - payload) < count || raw_len - out < count)
+                return -1;
+            memcpy(raw + out, payload, count);
+            payload += count;
+        }
+        else // run
+        {
+            count += CONTAINER_RUN_MIN;
+            if (payload == end || raw_len - out < count)
+                return -1;
+            memset(raw + out, *payload++, count);
+        }
+        out += count;
+    }
+    return out == raw_len ? 0 : -1;
+}
+
+static size_t put_varint(unsigned char *dst, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        dst[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    dst[n++] = value;
+    return n;
+}
+
+static uint64_t read_varint(int fd)
+{
+    uint64_t value = 0;
+    unsigned char byte;
+    int shift = 0;
+    do
+    {
+        if (shift >= 64 || read_all(fd, &byte, 1) != 1)
+        {
+            errno = EINVAL;
+            error("Input is not a valid container");
+        }
+        value |= (uint64_t)(byte & 0x7F) << shift;
+        shift += 7;
+    } while (byte & 0x80);
+    return value;
+}
+
+static size_t read_all(int fd, void *data, size_t len)
+{
+    size_t done = 0;
+    while (done < len)
+    {
+        ssize_t result = read(fd, (char *)data + done, len - done);
+        if (result == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result == -1)
+        {
+            error("Reading from File failed");
         }
-        count = 0;
-     
+        if (result == 0)
+        {
+            break;
+        }
+        done += result;
     }
-    strcat(compressed, "\n");
-    final_stats.written_chars++;
-    return compressed;
+    final_stats.read_chars += done; // update statistics
+    return done;
 }
 
-static int has_new_line_char(char *str)
+static void write_all(int fd, const void *data, size_t len)
 {
-    while (*str != '\0')
+    const char *pos = data;
+    while (pos < (const char *)data + len)
     {
-        if (*str == '\n')
+        ssize_t result = write(fd, pos, (const char *)data + len - pos);
+        if (result == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (result == -1)
         {
-            return 0;
+            error("Writing to stream failed: write failed");
         }
-        str++;
+        pos += result;
     }
-    return -1;
+    final_stats.written_chars += len; // update statistics
 }
 
 static void error(char *error_message)
@@ -308,6 +763,6 @@ static void error(char *error_message)
 
 static void usage(void)
 {
-    fprintf(stderr, "Usage: %s [-o outfile] [file...]\n", PROGRAM_NAME);
+    fprintf(stderr, "Usage: %s [-b | -d] [-o outfile] [file...]\n", PROGRAM_NAME);
     exit(EXIT_FAILURE);
 }
\ No newline at end of file
@@ -0,0 +1,550 @@
+/**
+ * @file container.c
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Implementation of the binary run-length container.
+ **/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "container.h"
+#include "rle.h"
+
+/**
+ * @brief The size of the header of a container.
+ */
+#define HEADER_SIZE 9
+
+/**
+ * @brief The size of the footer of a container.
+ */
+#define FOOTER_SIZE 20
+
+/**
+ * @brief The largest block size a container may have.
+ */
+#define MAX_BLOCK_SIZE (64 * 1024 * 1024)
+
+/**
+ * @brief The largest payload of a block (all bytes as literals plus the
+ * tokens).
+ */
+#define MAX_PAYLOAD(block_size) ((block_size) + (block_size) / 64 + 64)
+
+/**
+ * Structure of a reader
+ * @brief A buffered reader, which can provide a number of bytes at once.
+ */
+typedef struct Reader
+{
+    int fd;
+    unsigned char *buffer;
+    size_t cap;
+    size_t start;
+    size_t end;
+    bool eof;
+    uint64_t pos; // The number of bytes consumed so far
+} Reader;
+
+/**
+ * Encode a varint.
+ * @param dst A buffer with space for at least 10 bytes.
+ * @param value The value.
+ * @return The number of bytes written.
+ */
+static size_t put_varint(unsigned char *dst, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        dst[n++] = (value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    dst[n++] = value;
+    return n;
+}
+
+/**
+ * Encode a little endian integer.
+ * @param dst A buffer with space for at least 8 bytes.
+ * @param value The value.
+ * @param size The number of bytes to write.
+ */
+static void put_le(unsigned char *dst, uint64_t value, size_t size)
+{
+    for (size_t i = 0; i < size; i++)
+    {
+        dst[i] = value >> (8 * i);
+    }
+}
+
+/**
+ * Decode a little endian integer.
+ * @param src The bytes.
+ * @param size The number of bytes to read.
+ * @return The value.
+ */
+static uint64_t get_le(const unsigned char *src, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        value |= (uint64_t)src[i] << (8 * i);
+    }
+    return value;
+}
+
+/**
+ * Encode a block.
+ * @brief Encodes the raw bytes into tokens.
+ * @param raw The bytes of the block.
+ * @param len The number of bytes in raw.
+ * @param payload A buffer for MAX_PAYLOAD(len) bytes.
+ * @return The number of bytes in payload.
+ */
+static size_t encode_block(const unsigned char *raw, size_t len,
+                           unsigned char *payload)
+{
+    size_t out = 0;
+    size_t literal = 0; // The start of the pending literal bytes
+    size_t pos = 0;
+    while (pos <= len)
+    {
+        size_t run = pos < len ? rle_run_length(raw + pos, len - pos) : 0;
+        if (pos < len && run < CONTAINER_RUN_MIN)
+        {
+            pos += run;
+            continue;
+        }
+
+        // Write the literal bytes before the run
+        if (literal < pos)
+        {
+            out += put_varint(payload + out, ((pos - literal - 1) << 1) | 1);
+            memcpy(payload + out, raw + literal, pos - literal);
+            out += pos - literal;
+        }
+        if (pos == len)
+        {
+            break;
+        }
+        out += put_varint(payload + out, (run - CONTAINER_RUN_MIN) << 1);
+        payload[out++] = raw[pos];
+        pos += run;
+        literal = pos;
+    }
+    return out;
+}
+
+/**
+ * Fill a block.
+ * @brief Reads until the block is full or the end of the file is reached.
+ * @param fd The file descriptor.
+ * @param block The block.
+ * @param size The size of block.
+ * @return The number of bytes read or -1 if reading failed.
+ */
+static ssize_t fill_block(int fd, unsigned char *block, size_t size)
+{
+    size_t len = 0;
+    while (len < size)
+    {
+        ssize_t n = read_block(fd, block + len, size - len);
+        if (n == -1)
+        {
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        len += n;
+    }
+    return len;
+}
+
+int container_compress(int in_fd, int out_fd, uint64_t *read,
+                       uint64_t *written)
+{
+    static unsigned char raw[CONTAINER_BLOCK_SIZE];
+    static unsigned char payload[MAX_PAYLOAD(CONTAINER_BLOCK_SIZE)];
+    unsigned char head[20];
+
+    // The offsets of the blocks for the index
+    size_t blocks = 0;
+    size_t cap = 16;
+    unsigned char *index = malloc(cap * 8);
+    if (index == NULL)
+    {
+        return -1;
+    }
+
+    memcpy(head, CONTAINER_MAGIC, 4);
+    head[4] = CONTAINER_VERSION;
+    put_le(head + 5, CONTAINER_BLOCK_SIZE, 4);
+    if (write_all(out_fd, head, HEADER_SIZE) == -1)
+    {
+        free(index);
+        return -1;
+    }
+    uint64_t pos = HEADER_SIZE;
+
+    while (true)
+    {
+        ssize_t len = fill_block(in_fd, raw, sizeof(raw));
+        if (len == -1)
+        {
+            free(index);
+            *written += pos;
+            return -1;
+        }
+        if (len == 0)
+        {
+            break;
+        }
+        *read += len;
+
+        if (blocks == cap)
+        {
+            cap *= 2;
+            unsigned char *tmp = realloc(index, cap * 8);
+            if (tmp == NULL)
+            {
+                free(index);
+                *written += pos;
+                return -1;
+            }
+            index = tmp;
+        }
+        put_le(index + blocks * 8, pos, 8);
+        blocks++;
+
+        size_t payload_len = encode_block(raw, len, payload);
+        size_t head_len = put_varint(head, len);
+        head_len += put_varint(head + head_len, payload_len);
+        if (write_all(out_fd, head, head_len) == -1 ||
+            write_all(out_fd, payload, payload_len) == -1)
+        {
+            free(index);
+            *written += pos;
+            return -1;
+        }
+        pos += head_len + payload_len;
+
+        if ((size_t)len < sizeof(raw))
+        {
+            break;
+        }
+    }
+
+    // The end of the blocks, the index and the footer
+    head[0] = 0;
+    uint64_t index_pos = pos + 1;
+    unsigned char footer[FOOTER_SIZE];
+    put_le(footer, blocks, 8);
+    put_le(footer + 8, index_pos, 8);
+    memcpy(footer + 16, CONTAINER_INDEX_MAGIC, 4);
+    int result = 0;
+    if (write_all(out_fd, head, 1) == -1 ||
+        write_all(out_fd, index, blocks * 8) == -1 ||
+        write_all(out_fd, footer, FOOTER_SIZE) == -1)
+    {
+        result = -1;
+    }
+    free(index);
+    *written += index_pos + blocks * 8 + FOOTER_SIZE;
+    return result;
+}
+
+/**
+ * Fill the reader.
+ * @brief Makes sure that at least n bytes are buffered.
+ * @param reader The reader.
+ * @param n The number of bytes needed (at most the capacity of the reader).
+ * @return 0 if n bytes are buffered, 1 if the end of the file was reached
+ * before and -1 if reading failed.
+ */
+static int ensure(Reader *reader, size_t n)
+{
+    if (reader->end - reader->start >= n)
+    {
+        return 0;
+    }
+    memmove(reader->buffer, reader->buffer + reader->start,
+            reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+    while (reader->end < n && !reader->eof)
+    {
+        ssize_t len = read_block(reader->fd, reader->buffer + reader->end,
+                                 reader->cap - reader->end);
+        if (len == -1)
+        {
+            return -1;
+        }
+        reader->eof = len == 0;
+        reader->end += len;
+    }
+    return reader->end >= n ? 0 : 1;
+}
+
+/**
+ * Consume bytes.
+ * @brief Marks n buffered bytes as read.
+ * @param reader The reader.
+ * @param n The number of bytes.
+ */
+static void consume(Reader *reader, size_t n)
+{
+    reader->start += n;
+    reader->pos += n;
+}
+
+/**
+ * Read a varint.
+ * @param reader The reader.
+ * @param value A pointer to where the value is stored.
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+static int read_varint(Reader *reader, uint64_t *value)
+{
+    *value = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        int result = ensure(reader, 1);
+        if (result != 0)
+        {
+            errno = result == 1 ? EINVAL : errno;
+            return -1;
+        }
+        unsigned char byte = reader->buffer[reader->start];
+        consume(reader, 1);
+        *value |= (uint64_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            return 0;
+        }
+    }
+    errno = EINVAL;
+    return -1;
+}
+
+/**
+ * Decode a block.
+ * @brief Decodes the tokens of the payload.
+ * @param payload The payload.
+ * @param len The number of bytes in payload.
+ * @param raw A buffer for the decoded block.
+ * @param raw_len The number of bytes the block must have.
+ * @return Upon success 0, -1 if the payload is invalid.
+ */
+static int decode_block(const unsigned char *payload, size_t len,
+                        unsigned char *raw, size_t raw_len)
+{
+    const unsigned char *end = payload + len;
+    size_t out = 0;
+    while (payload < end)
+    {
+        uint64_t token = 0;
+        int shift = 0;
+        while (true)
+        {
+            if (payload == end || shift >= 64)
+            {
+                return -1;
+            }
+            unsigned char byte = *payload++;
+            token |= (uint64_t)(byte & 0x7F) << shift;
+            shift += 7;
+            if ((byte & 0x80) == 0)
+            {
+                break;
+            }
+        }
+
+        if ((token >> 1) > raw_len)
+        {
+            return -1;
+        }
+        size_t n = token >> 1;
+        if (token & 1)
+        {
+            n += 1;
+            if ((size_t)(end - payload) < n || raw_len - out < n)
+            {
+                return -1;
+            }
+            memcpy(raw + out, payload, n);
+            payload += n;
+        }
+        else
+        {
+            n += CONTAINER_RUN_MIN;
+            if (payload == end || raw_len - out < n)
+            {
+                return -1;
+            }
+            memset(raw + out, *payload++, n);
+        }
+        out += n;
+    }
+    return out == raw_len ? 0 : -1;
+}
+
+/**
+ * Read a container.
+ * @brief Reads one container (after its magic) and writes its original data.
+ * @param reader The reader, whose capacity is big enough for the container.
+ * @param out_fd The file descriptor to write to.
+ * @param raw A buffer for a block.
+ * @param block_size The block size of the container.
+ * @param start The position of the container in the input.
+ * @param written Pointer to the written characters counter.
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+static int read_blocks(Reader *reader, int out_fd, unsigned char *raw,
+                       uint64_t block_size, uint64_t start, uint64_t *written)
+{
+    uint64_t blocks = 0;
+    while (true)
+    {
+        uint64_t raw_len;
+        uint64_t payload_len;
+        if (read_varint(reader, &raw_len) == -1)
+        {
+            return -1;
+        }
+        if (raw_len == 0)
+        {
+            break;
+        }
+        if (raw_len > block_size || read_varint(reader, &payload_len) == -1 ||
+            payload_len > MAX_PAYLOAD(block_size))
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        int result = ensure(reader, payload_len);
+        if (result != 0)
+        {
+            errno = result == 1 ? EINVAL : errno;
+            return -1;
+        }
+        if (decode_block(reader->buffer + reader->start, payload_len, raw,
+                         raw_len) == -1)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        consume(reader, payload_len);
+        if (write_all(out_fd, raw, raw_len) == -1)
+        {
+            return -1;
+        }
+        *written += raw_len;
+        blocks++;
+    }
+
+    // Skip the index and check the footer
+    uint64_t index_pos = reader->pos - start;
+    for (uint64_t i = 0; i < blocks; i++)
+    {
+        if (ensure(reader, 8) != 0)
+        {
+            errno = EINVAL;
+            return -1;
+        }
+        consume(reader, 8);
+    }
+    if (ensure(reader, FOOTER_SIZE) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    const unsigned char *footer = reader->buffer + reader->start;
+    if (get_le(footer, 8) != blocks || get_le(footer + 8, 8) != index_pos ||
+        memcmp(footer + 16, CONTAINER_INDEX_MAGIC, 4) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    consume(reader, FOOTER_SIZE);
+    return 0;
+}
+
+int container_decompress(int in_fd, int out_fd, uint64_t *read,
+                         uint64_t *written)
+{
+    Reader reader = {in_fd, NULL, 0, 0, 0, false, 0};
+    unsigned char *raw = NULL;
+    uint64_t raw_size = 0;
+    int result = 0;
+
+    while (result == 0)
+    {
+        // Read the header of the next container
+        if (reader.buffer == NULL)
+        {
+            reader.cap = MAX_PAYLOAD(CONTAINER_BLOCK_SIZE) + 64;
+            reader.buffer = malloc(reader.cap);
+            if (reader.buffer == NULL)
+            {
+                result = -1;
+                break;
+            }
+        }
+        int available = ensure(&reader, HEADER_SIZE);
+        if (available == 1 && reader.end == reader.start)
+        {
+            break;
+        }
+        const unsigned char *header = reader.buffer + reader.start;
+        if (available != 0 || memcmp(header, CONTAINER_MAGIC, 4) != 0 ||
+            header[4] != CONTAINER_VERSION || get_le(header + 5, 4) == 0 ||
+            get_le(header + 5, 4) > MAX_BLOCK_SIZE)
+        {
+            errno = available == -1 ? errno : EINVAL;
+            result = -1;
+            break;
+        }
+        uint64_t block_size = get_le(header + 5, 4);
+        uint64_t start = reader.pos;
+        consume(&reader, HEADER_SIZE);
+
+        // Make the buffers big enough for the blocks of the container
+        if (raw_size < block_size)
+        {
+            unsigned char *tmp = realloc(raw, block_size);
+            if (tmp == NULL)
+            {
+                result = -1;
+                break;
+            }
+            raw = tmp;
+            raw_size = block_size;
+        }
+        if (reader.cap < MAX_PAYLOAD(block_size) + 64)
+        {
+            size_t cap = MAX_PAYLOAD(block_size) + 64;
+            unsigned char *tmp = realloc(reader.buffer, cap);
+            if (tmp == NULL)
+            {
+                result = -1;
+                break;
+            }
+            reader.buffer = tmp;
+            reader.cap = cap;
+        }
+
+        result = read_blocks(&reader, out_fd, raw, block_size, start, written);
+    }
+
+    *read += reader.pos;
+    free(reader.buffer);
+    free(raw);
+    return result;
+}
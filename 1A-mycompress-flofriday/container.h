@@ -0,0 +1,83 @@
+/**
+ * @file container.h
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Binary run-length container, which is written by -b and read by -d.
+ * @details A container has the following layout (all integers are little
+ * endian, varints have 7 bits per byte with the highest bit set on all but
+ * the last byte):
+ *
+ *     header:  "MCRL", version (1 byte), block size (4 bytes)
+ *     blocks:  raw length (varint), payload length (varint), payload
+ *     end:     0 (varint)
+ *     index:   offset of every block from the start of the container
+ *              (8 bytes each)
+ *     footer:  number of blocks (8 bytes), offset of the index (8 bytes),
+ *              "MCRX"
+ *
+ * Every block but the last one holds block size bytes of the input, so the
+ * block of any position can be found with the index without reading the
+ * blocks before it. A payload is a sequence of tokens: a varint t, where
+ * (t & 1) == 0 is a run of (t >> 1) + CONTAINER_RUN_MIN copies of the next
+ * byte and (t & 1) == 1 are (t >> 1) + 1 literal bytes, which follow.
+ * Containers can be concatenated.
+ **/
+
+#ifndef CONTAINER_H
+#define CONTAINER_H
+
+#include <stdint.h>
+
+/**
+ * @brief The magic bytes at the beginning of a container.
+ */
+#define CONTAINER_MAGIC "MCRL"
+
+/**
+ * @brief The magic bytes at the end of a container.
+ */
+#define CONTAINER_INDEX_MAGIC "MCRX"
+
+/**
+ * @brief The version of the container format.
+ */
+#define CONTAINER_VERSION 1
+
+/**
+ * @brief The number of input bytes in each block.
+ */
+#define CONTAINER_BLOCK_SIZE (1024 * 1024)
+
+/**
+ * @brief Shorter runs are stored as literals.
+ */
+#define CONTAINER_RUN_MIN 3
+
+/**
+ * Write a container.
+ * @brief Reads the input until the end of the file and writes it as a
+ * container.
+ * @param in_fd The file descriptor to read from.
+ * @param out_fd The file descriptor to write to.
+ * @param read Pointer to the read characters counter.
+ * @param written Pointer to the written characters counter.
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+int container_compress(int in_fd, int out_fd, uint64_t *read,
+                       uint64_t *written);
+
+/**
+ * Read containers.
+ * @brief Reads all containers of the input and writes their original data.
+ * @param in_fd The file descriptor to read from.
+ * @param out_fd The file descriptor to write to.
+ * @param read Pointer to the read characters counter.
+ * @param written Pointer to the written characters counter.
+ * @return Upon success 0, otherwise -1 (errno is set, EINVAL if the input is
+ * not a valid container).
+ */
+int container_decompress(int in_fd, int out_fd, uint64_t *read,
+                         uint64_t *written);
+
+#endif
@@ -15,6 +15,23 @@
 #include <assert.h>
 #include <stdint.h>
 
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rle.h"
+#include "parallel_rle.h"
+#include "container.h"
+
+/**
+ * @brief What the program does with its input files.
+ */
+typedef enum Mode
+{
+    MODE_TEXT,      // Compress into the a3b2 text format
+    MODE_BINARY,    // Compress into the binary container (-b)
+    MODE_DECOMPRESS // Decompress binary containers (-d)
+} Mode;
+
 /**
  * Usage function.
  * @brief This function writes a short usage description to stderr and exits the
@@ -24,7 +41,7 @@
  **/
 void usage(const char prog_name[])
 {
-    fprintf(stderr, "[%s] Usage: %s [-o outfile] [file...]\n", prog_name, prog_name);
+    fprintf(stderr, "[%s] Usage: %s [-b | -d] [-j threads] [-o outfile] [file...]\n", prog_name, prog_name);
     exit(EXIT_FAILURE);
 }
 
@@ -35,63 +52,114 @@ void usage(const char prog_name[])
  * and written accourding to the characters it read and wrote.
  * @details The function asumes all provided pointers are vaild and will
  * produce a segmentation vault if they are not.
+ * The file is read with read in blocks of RLE_BLOCK_SIZE bytes, which are
+ * encoded by rle.h directly to the file descriptor of out (so nothing may be
+ * buffered in out).
  * @param in The file to compress and to read from.
  * @param out The file to write to.
  * @param read Pointer to the read characters counter.
  * @param written Pointer to the written characters pointer.
- * @return Upon success 0, or -1 if writing to the out file failed.
+ * @return Upon success 0, or -1 if reading or writing failed.
  */
 int compress(FILE *in, FILE *out, uint64_t *read, uint64_t *written)
 {
-    int cnt = 0; // counts how often a char is repeated
-    int last;
+    static unsigned char block[RLE_BLOCK_SIZE];
+    static RleEncoder encoder;
+    rle_init(&encoder, fileno(out));
+
+    int fd = fileno(in);
     while (true)
     {
-        //  Read the current char and exit if EOF is reached
-        int c = fgetc(in);
-        if (feof(in))
+        ssize_t n = read_block(fd, block, sizeof(block));
+        if (n == -1)
         {
-            break;
+            return -1;
         }
-        *read = *read + 1;
-
-        // The first character
-        if (cnt == 0)
+        if (n == 0)
         {
-            cnt = 1;
-            last = c;
-            continue;
-        }
-
-        // If the current character is equal to the last
-        if (c == last)
-        {
-            cnt++;
-            continue;
+            break;
         }
+        *read += n;
 
-        // The current character is unequal to the last
-        // Write the compressed data to the outfile.
-        int tmp = fprintf(out, "%c%d", last, cnt);
-        if (tmp == -1)
+        if (rle_encode(&encoder, block, n) == -1)
         {
+            *written += encoder.written;
             return -1;
         }
-        *written += tmp;
+    }
 
-        // Reset for the next chracter
-        last = c;
-        cnt = 1;
+    int result = rle_finish(&encoder);
+    *written += encoder.written;
+    return result;
+}
+
+/**
+ * Parallel compression function.
+ * @brief Compresses the in file like compress, but with multiple threads.
+ * @details The in file is mapped into memory and encoded by parallel_rle.h.
+ * Files which cannot be mapped (like pipes) and files smaller than
+ * PARALLEL_CHUNK_SIZE are compressed by compress instead.
+ * @param in The file to compress and to read from.
+ * @param out The file to write to.
+ * @param threads The number of threads.
+ * @param read Pointer to the read characters counter.
+ * @param written Pointer to the written characters pointer.
+ * @return Upon success 0, or -1 if reading or writing failed.
+ */
+int compress_parallel(FILE *in, FILE *out, int threads, uint64_t *read,
+                      uint64_t *written)
+{
+    struct stat info;
+    if (fstat(fileno(in), &info) == -1 || !S_ISREG(info.st_mode) ||
+        info.st_size < PARALLEL_CHUNK_SIZE)
+    {
+        return compress(in, out, read, written);
+    }
+    void *data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fileno(in), 0);
+    if (data == MAP_FAILED)
+    {
+        return compress(in, out, read, written);
     }
+    madvise(data, info.st_size, MADV_SEQUENTIAL);
 
-    // Write the last character to the file
-    int tmp = fprintf(out, "%c%d", last, cnt);
-    if (tmp == -1)
+    static RleEncoder encoder;
+    rle_init(&encoder, fileno(out));
+    int result = parallel_encode(&encoder, data, info.st_size, threads);
+    if (result == 0)
+    {
+        result = rle_finish(&encoder);
+    }
+    *read += info.st_size;
+    *written += encoder.written;
+    munmap(data, info.st_size);
+    return result;
+}
+
+/**
+ * Process a file.
+ * @brief Compresses or decompresses the in file according to the mode.
+ * @details Threads are only used for the text format.
+ * @param in The file to read from.
+ * @param out The file to write to.
+ * @param mode What to do with the file.
+ * @param threads The number of threads.
+ * @param read Pointer to the read characters counter.
+ * @param written Pointer to the written characters pointer.
+ * @return Upon success 0, or -1 if the file couldn't be processed.
+ */
+int process(FILE *in, FILE *out, Mode mode, int threads, uint64_t *read,
+            uint64_t *written)
+{
+    switch (mode)
     {
-        return -1;
+    case MODE_BINARY:
+        return container_compress(fileno(in), fileno(out), read, written);
+    case MODE_DECOMPRESS:
+        return container_decompress(fileno(in), fileno(out), read, written);
+    default:
+        return threads > 1 ? compress_parallel(in, out, threads, read, written)
+                           : compress(in, out, read, written);
     }
-    *written += tmp;
-    return 0;
 }
 
 /**
@@ -108,12 +176,32 @@ int main(int argc, char *argv[])
 {
     // Read the flags with getopts and save the output file into out_filename
     const char *out_filename = NULL;
+    long threads = 1;
+    Mode mode = MODE_TEXT;
     int c;
     const char *const progname = argv[0];
-    while ((c = getopt(argc, argv, "o:")) != -1)
+    while ((c = getopt(argc, argv, "o:j:bd")) != -1)
     {
+        char *end;
         switch (c)
         {
+        case 'b':
+        case 'd':
+            if (mode != MODE_TEXT)
+            {
+                fprintf(stderr, "[%s] ERROR: flags -b and -d can only appear once\n", progname);
+                usage(progname);
+            }
+            mode = c == 'b' ? MODE_BINARY : MODE_DECOMPRESS;
+            break;
+        case 'j':
+            threads = strtol(optarg, &end, 10);
+            if (*end != '\0' || end == optarg || threads < 1 || threads > 1024)
+            {
+                fprintf(stderr, "[%s] ERROR: invalid number of threads %s\n", progname, optarg);
+                usage(progname);
+            }
+            break;
         case 'o':
             if (out_filename != NULL)
             {
@@ -153,6 +241,7 @@ int main(int argc, char *argv[])
     }
 
     // Compress the files
+    const char *action = mode == MODE_DECOMPRESS ? "decompressing" : "compressing";
     uint64_t read = 0;
     uint64_t written = 0;
     for (int i = 0; i < input_len; i++)
@@ -164,9 +253,9 @@ int main(int argc, char *argv[])
             fclose(out_file);
             exit(EXIT_FAILURE);
         }
-        if (compress(in_file, out_file, &read, &written) == -1)
+        if (process(in_file, out_file, mode, threads, &read, &written) == -1)
         {
-            fprintf(stderr, "[%s] ERROR: An error occoured while compressing file %s: %s\n", argv[0], input_filenames[i], strerror(errno));
+            fprintf(stderr, "[%s] ERROR: An error occoured while %s file %s: %s\n", argv[0], action, input_filenames[i], strerror(errno));
             fclose(in_file);
             fclose(out_file);
             exit(EXIT_FAILURE);
@@ -177,9 +266,9 @@ int main(int argc, char *argv[])
     // If no input file was specified use stdin
     if (input_len == 0)
     {
-        if (compress(stdin, out_file, &read, &written) == -1)
+        if (process(stdin, out_file, mode, threads, &read, &written) == -1)
         {
-            fprintf(stderr, "[%s] ERROR: An error occoured while compressing file stdin: %s\n", argv[0], strerror(errno));
+            fprintf(stderr, "[%s] ERROR: An error occoured while %s file stdin: %s\n", argv[0], action, strerror(errno));
             fclose(out_file);
             exit(EXIT_FAILURE);
         }
@@ -0,0 +1,186 @@
+/**
+ * @file parallel_rle.c
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Implementation of the run-length encoding on multiple threads.
+ **/
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "parallel_rle.h"
+
+/**
+ * Structure of a chunk
+ * @brief A part of the data, which is encoded by one thread.
+ * @details A run of n bytes needs at most 2 * n bytes of text, so text has
+ * space for 2 * PARALLEL_CHUNK_SIZE bytes.
+ */
+typedef struct Chunk
+{
+    const unsigned char *data; // The data of the chunk
+    size_t len;                // The number of bytes in data
+    uint64_t first_len;        // The length of the first run
+    uint64_t last_len;         // The length of the last run
+    bool single;               // If the chunk is only one run
+    char *text;                // The encoded runs between the first and last
+    size_t text_len;           // The number of bytes in text
+} Chunk;
+
+/**
+ * Encode a chunk.
+ * @brief Encodes all runs of the chunk into its text apart from the first and
+ * the last run, which are only counted.
+ * @param arg A pointer to the chunk.
+ * @return Always NULL.
+ */
+static void *encode_chunk(void *arg)
+{
+    Chunk *chunk = arg;
+    const unsigned char *data = chunk->data;
+    size_t len = chunk->len;
+
+    chunk->text_len = 0;
+    chunk->first_len = rle_run_length(data, len);
+    chunk->single = chunk->first_len == len;
+    if (chunk->single)
+    {
+        return NULL;
+    }
+
+    size_t pos = chunk->first_len;
+    while (true)
+    {
+        size_t run = rle_run_length(data + pos, len - pos);
+        if (pos + run == len)
+        {
+            chunk->last_len = run;
+            break;
+        }
+        chunk->text_len += rle_format_run(chunk->text + chunk->text_len,
+                                          data[pos], run);
+        pos += run;
+    }
+    return NULL;
+}
+
+/**
+ * Stitch a chunk.
+ * @brief Joins the first run of the chunk with the current run of the encoder
+ * and appends the rest of the chunk.
+ * @param encoder The encoder.
+ * @param chunk The encoded chunk.
+ * @return Upon success 0, otherwise -1.
+ */
+static int stitch_chunk(RleEncoder *encoder, const Chunk *chunk)
+{
+    if (rle_push_run(encoder, chunk->data[0], chunk->first_len) == -1)
+    {
+        return -1;
+    }
+    if (chunk->single)
+    {
+        return 0;
+    }
+    if (rle_append_encoded(encoder, chunk->text, chunk->text_len) == -1)
+    {
+        return -1;
+    }
+    return rle_push_run(encoder, chunk->data[chunk->len - 1], chunk->last_len);
+}
+
+/**
+ * Encode in rounds.
+ * @brief Splits the data into rounds of one chunk per thread, encodes the
+ * chunks of a round on the threads and stitches them.
+ * @param encoder The encoder.
+ * @param data The data.
+ * @param len The number of bytes in data.
+ * @param threads The number of threads.
+ * @param chunks An array of threads chunks with allocated texts.
+ * @return Upon success 0, otherwise -1.
+ */
+static int encode_rounds(RleEncoder *encoder, const unsigned char *data,
+                         size_t len, int threads, Chunk *chunks)
+{
+    pthread_t ids[threads];
+    bool started[threads];
+    size_t pos = 0;
+    while (pos < len)
+    {
+        // Encode up to one chunk per thread, the first one in this thread
+        int count = 0;
+        for (; count < threads && pos < len; count++)
+        {
+            size_t chunk_len = len - pos;
+            if (chunk_len > PARALLEL_CHUNK_SIZE)
+            {
+                chunk_len = PARALLEL_CHUNK_SIZE;
+            }
+            chunks[count].data = data + pos;
+            chunks[count].len = chunk_len;
+            pos += chunk_len;
+        }
+        for (int i = 1; i < count; i++)
+        {
+            started[i] = pthread_create(&ids[i], NULL, encode_chunk,
+                                        &chunks[i]) == 0;
+        }
+        encode_chunk(&chunks[0]);
+        for (int i = 1; i < count; i++)
+        {
+            // Chunks without a thread are encoded here
+            if (started[i])
+            {
+                pthread_join(ids[i], NULL);
+            }
+            else
+            {
+                encode_chunk(&chunks[i]);
+            }
+        }
+
+        // Stitch the chunks in their order
+        for (int i = 0; i < count; i++)
+        {
+            if (stitch_chunk(encoder, &chunks[i]) == -1)
+            {
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+int parallel_encode(RleEncoder *encoder, const unsigned char *data, size_t len,
+                    int threads)
+{
+    Chunk *chunks = calloc(threads, sizeof(Chunk));
+    if (chunks == NULL)
+    {
+        return -1;
+    }
+
+    int result = 0;
+    for (int i = 0; i < threads && result == 0; i++)
+    {
+        chunks[i].text = malloc(2 * PARALLEL_CHUNK_SIZE);
+        if (chunks[i].text == NULL)
+        {
+            result = -1;
+        }
+    }
+    if (result == 0)
+    {
+        result = encode_rounds(encoder, data, len, threads, chunks);
+    }
+
+    for (int i = 0; i < threads; i++)
+    {
+        free(chunks[i].text);
+    }
+    free(chunks);
+    return result;
+}
@@ -0,0 +1,40 @@
+/**
+ * @file parallel_rle.h
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Run-length encoding of data in memory on multiple threads.
+ **/
+
+#ifndef PARALLEL_RLE_H
+#define PARALLEL_RLE_H
+
+#include <stddef.h>
+
+#include "rle.h"
+
+/**
+ * @brief The number of bytes every thread encodes at once.
+ */
+#define PARALLEL_CHUNK_SIZE (4 * 1024 * 1024)
+
+/**
+ * Encode on threads.
+ * @brief Encodes the data with the encoder like rle_encode, but the data is
+ * split into chunks which are encoded on the threads.
+ * @details Every thread encodes the runs of its chunk apart from the first
+ * and the last one. The chunks are then stitched together in order with the
+ * encoder, which joins the first and last runs with the runs of the
+ * neighbouring chunks, so the output is the same as the one of rle_encode.
+ * At most threads chunks are encoded at once, so the memory needed doesn't
+ * depend on the size of the data.
+ * @param encoder The encoder.
+ * @param data The data.
+ * @param len The number of bytes in data.
+ * @param threads The number of threads (at least one).
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+int parallel_encode(RleEncoder *encoder, const unsigned char *data, size_t len,
+                    int threads);
+
+#endif
@@ -0,0 +1,236 @@
+/**
+ * @file rle.c
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Implementation of the streaming run-length encoder.
+ **/
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "rle.h"
+
+void rle_init(RleEncoder *encoder, int fd)
+{
+    encoder->fd = fd;
+    encoder->last = 0;
+    encoder->count = 0;
+    encoder->written = 0;
+    encoder->out_len = 0;
+}
+
+ssize_t read_block(int fd, void *data, size_t len)
+{
+    ssize_t n;
+    while ((n = read(fd, data, len)) == -1 && errno == EINTR)
+        ;
+    return n;
+}
+
+int write_all(int fd, const void *data, size_t len)
+{
+    const char *pos = data;
+    while (len > 0)
+    {
+        ssize_t n = write(fd, pos, len);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1)
+        {
+            return -1;
+        }
+        pos += n;
+        len -= n;
+    }
+    return 0;
+}
+
+size_t rle_run_length(const unsigned char *data, size_t len)
+{
+    const unsigned char c = data[0];
+    size_t i = 1;
+
+    // Most runs of text are short, so the next byte is checked first
+    if (i == len || data[i] != c)
+    {
+        return i;
+    }
+
+#ifdef __SSE2__
+    const __m128i pattern = _mm_set1_epi8((char)c);
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i block = _mm_loadu_si128((const __m128i *)(data + i));
+        unsigned mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, pattern));
+        if (mask != 0xFFFF)
+        {
+            return i + __builtin_ctz(~mask);
+        }
+    }
+#else
+    const uint64_t pattern = 0x0101010101010101ULL * c;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t block;
+        memcpy(&block, data + i, sizeof(block));
+        uint64_t diff = block ^ pattern;
+        if (diff != 0)
+        {
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+            return i + __builtin_ctzll(diff) / 8;
+#else
+            return i + __builtin_clzll(diff) / 8;
+#endif
+        }
+    }
+#endif
+
+    while (i < len && data[i] == c)
+    {
+        i++;
+    }
+    return i;
+}
+
+size_t rle_format_run(char *dst, unsigned char c, uint64_t count)
+{
+    dst[0] = c;
+    if (count < 10)
+    {
+        dst[1] = '0' + count;
+        return 2;
+    }
+
+    // Write the digits backwards and then copy them in the right order
+    char digits[20];
+    size_t n = 0;
+    while (count > 0)
+    {
+        digits[n++] = '0' + count % 10;
+        count /= 10;
+    }
+    for (size_t i = 0; i < n; i++)
+    {
+        dst[1 + i] = digits[n - 1 - i];
+    }
+    return 1 + n;
+}
+
+/**
+ * Flush the output.
+ * @brief Writes the buffered output of the encoder with one write.
+ * @param encoder The encoder.
+ * @return Upon success 0, otherwise -1.
+ */
+static int flush(RleEncoder *encoder)
+{
+    if (write_all(encoder->fd, encoder->out, encoder->out_len) == -1)
+    {
+        return -1;
+    }
+    encoder->written += encoder->out_len;
+    encoder->out_len = 0;
+    return 0;
+}
+
+/**
+ * Emit the current run.
+ * @brief Appendes the current run of the encoder to the output buffer and
+ * flushes it if it is full.
+ * @param encoder The encoder.
+ * @return Upon success 0, otherwise -1.
+ */
+static int emit_run(RleEncoder *encoder)
+{
+    if (encoder->out_len + RLE_MAX_RUN_TEXT > RLE_OUT_SIZE &&
+        flush(encoder) == -1)
+    {
+        return -1;
+    }
+    encoder->out_len += rle_format_run(encoder->out + encoder->out_len,
+                                       encoder->last, encoder->count);
+    return 0;
+}
+
+int rle_encode(RleEncoder *encoder, const unsigned char *data, size_t len)
+{
+    size_t pos = 0;
+
+    // Continue the run of the last block
+    if (encoder->count != 0 && len > 0 && data[0] == encoder->last)
+    {
+        size_t run = rle_run_length(data, len);
+        encoder->count += run;
+        pos = run;
+    }
+
+    while (pos < len)
+    {
+        size_t run = rle_run_length(data + pos, len - pos);
+        if (encoder->count != 0 && emit_run(encoder) == -1)
+        {
+            return -1;
+        }
+        encoder->last = data[pos];
+        encoder->count = run;
+        pos += run;
+    }
+    return 0;
+}
+
+int rle_push_run(RleEncoder *encoder, unsigned char c, uint64_t count)
+{
+    if (encoder->count != 0 && encoder->last == c)
+    {
+        encoder->count += count;
+        return 0;
+    }
+    if (encoder->count != 0 && emit_run(encoder) == -1)
+    {
+        return -1;
+    }
+    encoder->last = c;
+    encoder->count = count;
+    return 0;
+}
+
+int rle_append_encoded(RleEncoder *encoder, const char *text, size_t len)
+{
+    if (encoder->count != 0 && emit_run(encoder) == -1)
+    {
+        return -1;
+    }
+    encoder->count = 0;
+
+    // Short texts are buffered, long ones are written directly
+    if (encoder->out_len + len <= RLE_OUT_SIZE)
+    {
+        memcpy(encoder->out + encoder->out_len, text, len);
+        encoder->out_len += len;
+        return 0;
+    }
+    if (flush(encoder) == -1 || write_all(encoder->fd, text, len) == -1)
+    {
+        return -1;
+    }
+    encoder->written += len;
+    return 0;
+}
+
+int rle_finish(RleEncoder *encoder)
+{
+    if (encoder->count != 0 && emit_run(encoder) == -1)
+    {
+        return -1;
+    }
+    encoder->count = 0;
+    return flush(encoder);
+}
@@ -0,0 +1,141 @@
+/**
+ * @file rle.h
+ * @author flofriday XXXXXXXX <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.10.2020
+ *
+ * @brief Streaming run-length encoder, which writes every run as the
+ * character followed by the decimal count (e.g. aaabb => a3b2).
+ **/
+
+#ifndef RLE_H
+#define RLE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+/**
+ * @brief The size of the blocks the input is read in.
+ */
+#define RLE_BLOCK_SIZE (64 * 1024)
+
+/**
+ * @brief The size of the output buffer of an encoder.
+ */
+#define RLE_OUT_SIZE (64 * 1024)
+
+/**
+ * @brief The maximal length of one encoded run (a character and the digits of
+ * a 64 bit count).
+ */
+#define RLE_MAX_RUN_TEXT 21
+
+/**
+ * Structure of an encoder
+ * @brief The state of an encoder between two blocks: the run that is not
+ * finished yet and the output that is not written yet.
+ */
+typedef struct RleEncoder
+{
+    int fd;                 // The file descriptor the output is written to
+    unsigned char last;     // The character of the current run
+    uint64_t count;         // The length of the current run (0 if none)
+    uint64_t written;       // The number of bytes written so far
+    size_t out_len;         // The number of bytes in out
+    char out[RLE_OUT_SIZE]; // The output that is not written yet
+} RleEncoder;
+
+/**
+ * Initialize an encoder.
+ * @param encoder The encoder.
+ * @param fd The file descriptor the output will be written to.
+ */
+void rle_init(RleEncoder *encoder, int fd);
+
+/**
+ * Encode a block.
+ * @brief Encodes the block, the last run of the block is continued by the next
+ * block.
+ * @param encoder The encoder.
+ * @param data The block.
+ * @param len The number of bytes in data.
+ * @return Upon success 0, or -1 if writing failed (errno is set).
+ */
+int rle_encode(RleEncoder *encoder, const unsigned char *data, size_t len);
+
+/**
+ * Finish the encoding.
+ * @brief Encodes the last run and writes all buffered output.
+ * @param encoder The encoder.
+ * @return Upon success 0, or -1 if writing failed (errno is set).
+ */
+int rle_finish(RleEncoder *encoder);
+
+/**
+ * Push a run.
+ * @brief Continues the current run with the run if they have the same
+ * character, otherwise the current run is encoded and the run becomes the
+ * current run.
+ * @param encoder The encoder.
+ * @param c The character of the run.
+ * @param count The length of the run (at least 1).
+ * @return Upon success 0, or -1 if writing failed (errno is set).
+ */
+int rle_push_run(RleEncoder *encoder, unsigned char c, uint64_t count);
+
+/**
+ * Append encoded runs.
+ * @brief Encodes the current run and appends the already encoded runs to the
+ * output. The first of the runs must have a different character than the
+ * current run.
+ * @param encoder The encoder.
+ * @param text The encoded runs.
+ * @param len The number of bytes in text.
+ * @return Upon success 0, or -1 if writing failed (errno is set).
+ */
+int rle_append_encoded(RleEncoder *encoder, const char *text, size_t len);
+
+/**
+ * Get the length of a run.
+ * @brief Counts how often the first byte repeats at the beginning of data.
+ * The bytes are compared 16 at a time with SSE2 (or 8 at a time as words if
+ * SSE2 isn't available).
+ * @param data The data (at least one byte).
+ * @param len The number of bytes in data.
+ * @return The length of the run (at least 1).
+ */
+size_t rle_run_length(const unsigned char *data, size_t len);
+
+/**
+ * Format a run.
+ * @brief Writes the character and the decimal count (without a terminating
+ * null byte).
+ * @param dst A buffer with at least RLE_MAX_RUN_TEXT bytes.
+ * @param c The character of the run.
+ * @param count The length of the run.
+ * @return The number of bytes written to dst.
+ */
+size_t rle_format_run(char *dst, unsigned char c, uint64_t count);
+
+/**
+ * Read a block.
+ * @brief Reads up to len bytes, read is called again if it was interrupted.
+ * @param fd The file descriptor.
+ * @param data The buffer.
+ * @param len The size of data.
+ * @return The number of bytes read (0 at the end of the file), or -1 if
+ * reading failed (errno is set).
+ */
+ssize_t read_block(int fd, void *data, size_t len);
+
+/**
+ * Write a buffer.
+ * @brief Writes the whole buffer, even if write only writes a part of it.
+ * @param fd The file descriptor.
+ * @param data The buffer.
+ * @param len The number of bytes in data.
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+int write_all(int fd, const void *data, size_t len);
+
+#endif
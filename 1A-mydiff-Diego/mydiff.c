@@ -1,11 +1,16 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <getopt.h>
+#include <unistd.h>
 #include <string.h>  // weil sonst sagt er immer ein warning das errno declaration not provided
 #include <strings.h> // weil sonst 'warning' [implicit declaration of function 'strcasecmp' is invalid in C99]
 #include <math.h>
 #include <sys/errno.h>
 
+#include "myers.h"
+#include "tree.h"
+#include "stream.h"
+
 #define debug(fmt, ...)                        \
     (void)fprintf(stderr, "[%s:%d] " fmt "\n", \
                   __FILE__, __LINE__,          \
@@ -21,7 +26,7 @@ char *programname;
  */
 void usage(void)
 {
-    fprintf(stderr, "Usage: %s [-i] [-o outfile] file1 file2\n", programname);
+    fprintf(stderr, "Usage: %s [-i] [-u | -U lines] [-s [-w lines] [-q]] [-r [-j threads]] [-o outfile] file1 file2\n", programname);
     exit(EXIT_FAILURE);
 }
 
@@ -242,6 +247,121 @@ void output(int lineCounter, int linedifferences, char *outputFilename)
     free(outputString);
 }
 
+/**
+ * @brief prints a unified diff
+ * 
+ * Compares the files with the Myers diff and prints the hunks to stdout or
+ * the outputfile (which was already created by the option)
+ * 
+ * @param filename1 the first file
+ * @param filename2 the second file
+ * @param caseSensitive whether its case sensitive or not
+ * @param context the number of unchanged lines around each change
+ * @param outputFilename the filename of the output file
+ */
+void unifiedDiff(const char *filename1, const char *filename2, int caseSensitive, size_t context, char *outputFilename)
+{
+    FileLines file1;
+    FileLines file2;
+    if (loadLines(filename1, caseSensitive, &file1) == -1 || loadLines(filename2, caseSensitive, &file2) == -1)
+    {
+        fprintf(stderr, "%s: reading failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    DiffResult result;
+    if (diffLines(&file1, &file2, caseSensitive, &result) == -1)
+    {
+        fprintf(stderr, "%s: diff failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *outputFile = outputFilename == NULL ? stdout : openFileAppend(outputFilename);
+    if (printUnified(outputFile, filename1, filename2, &file1, &file2, &result, context) == -1 ||
+        fflush(outputFile) == EOF)
+    {
+        fprintf(stderr, "%s: output failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (outputFilename != NULL)
+    {
+        properclose(outputFile);
+    }
+
+    freeDiff(&result);
+    freeLines(&file1);
+    freeLines(&file2);
+}
+
+/**
+ * @brief prints a unified diff of two large files
+ * 
+ * Streams both files through windows of window lines, so the memory doesn't
+ * depend on the size of the files, and prints the hunks (or with summary
+ * only the counts) to stdout or the outputfile (which was already created by
+ * the option)
+ * 
+ * @param filename1 the first file
+ * @param filename2 the second file
+ * @param caseSensitive whether its case sensitive or not
+ * @param context the number of unchanged lines around each change
+ * @param window the number of lines read ahead of each file
+ * @param summary 1 to print only a summary
+ * @param outputFilename the filename of the output file
+ */
+void streamingDiff(const char *filename1, const char *filename2, int caseSensitive, size_t context, size_t window,
+                   int summary, char *outputFilename)
+{
+    FILE *outputFile = outputFilename == NULL ? stdout : openFileAppend(outputFilename);
+    if (streamDiff(outputFile, filename1, filename2, caseSensitive, context, window, summary) == -1)
+    {
+        fprintf(stderr, "%s: streaming diff failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (fflush(outputFile) == EOF)
+    {
+        fprintf(stderr, "%s: fflush failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (outputFilename != NULL)
+    {
+        properclose(outputFile);
+    }
+}
+
+/**
+ * @brief prints a unified diff of two directories
+ * 
+ * Compares all files of both directories (recursively) on multiple threads and
+ * prints the hunks to stdout or the outputfile (which was already created by the option)
+ * 
+ * @param directory1 the first directory
+ * @param directory2 the second directory
+ * @param caseSensitive whether its case sensitive or not
+ * @param context the number of unchanged lines around each change
+ * @param threads the number of threads
+ * @param outputFilename the filename of the output file
+ */
+void treeDiff(const char *directory1, const char *directory2, int caseSensitive, size_t context, int threads,
+              char *outputFilename)
+{
+    FILE *outputFile = outputFilename == NULL ? stdout : openFileAppend(outputFilename);
+    if (diffTrees(outputFile, directory1, directory2, caseSensitive, context, threads) == -1)
+    {
+        fprintf(stderr, "%s: directory diff failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (fflush(outputFile) == EOF)
+    {
+        fprintf(stderr, "%s: fflush failed: %s\n", programname, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (outputFilename != NULL)
+    {
+        properclose(outputFile);
+    }
+}
+
 /**
  * @brief the main
  * 
@@ -258,14 +378,62 @@ int main(int argc, char *argv[])
     int caseSensitive = 1; // 1 - it is case sensitive (base case)
                            //  0 - its not case sensitive
     char *outputFilename = NULL;
+    int unified = 0; // 1 - print a unified diff instead of the line differences
+    size_t context = 3;
+    int recursive = 0; // 1 - compare two directories (always unified)
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int streaming = 0; // 1 - diff the files in a window of lines instead of reading them whole
+    size_t window = 65536;
+    int summary = 0; // 1 - only count the changed lines (streaming)
+    char *end = NULL;
     int c = -1;
-    while ((c = getopt(argc, argv, "io:")) != -1)
+    while ((c = getopt(argc, argv, "iuU:sw:qrj:o:")) != -1)
     {
         switch (c)
         {
         case 'i':
             caseSensitive = 0; // dont mind case
             break;
+        case 'u':
+            unified = 1;
+            break;
+        case 'U':
+            unified = 1;
+            errno = 0;
+            context = strtoul(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' || optarg[0] == '-')
+            {
+                usage();
+            }
+            break;
+        case 's':
+            streaming = 1;
+            break;
+        case 'w':
+            streaming = 1;
+            errno = 0;
+            window = strtoul(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' || optarg[0] == '-' || window < 1 ||
+                window > 100000000)
+            {
+                usage();
+            }
+            break;
+        case 'q':
+            streaming = 1;
+            summary = 1;
+            break;
+        case 'r':
+            recursive = 1;
+            break;
+        case 'j':
+            errno = 0;
+            threads = strtol(optarg, &end, 10);
+            if (errno != 0 || end == optarg || *end != '\0' || threads < 1 || threads > 1024)
+            {
+                usage();
+            }
+            break;
         case 'o':
             outputFilename = optarg;
             createOutputFile(outputFilename);
@@ -294,6 +462,24 @@ int main(int argc, char *argv[])
     //debug("%s", filename1);
     //debug("%s", filename2);
 
+    if (recursive == 1)
+    {
+        treeDiff(filename1, filename2, caseSensitive, context, threads < 1 ? 1 : threads, outputFilename);
+        return EXIT_SUCCESS;
+    }
+
+    if (streaming == 1)
+    {
+        streamingDiff(filename1, filename2, caseSensitive, context, window, summary, outputFilename);
+        return EXIT_SUCCESS;
+    }
+
+    if (unified == 1)
+    {
+        unifiedDiff(filename1, filename2, caseSensitive, context, outputFilename);
+        return EXIT_SUCCESS;
+    }
+
     FILE *file1 = readFile(filename1);
     FILE *file2 = readFile(filename2);
 
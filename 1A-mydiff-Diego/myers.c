@@ -0,0 +1,525 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "myers.h"
+
+/**
+ * @brief the state of a diff which is shared by all recursive calls
+ */
+typedef struct Context
+{
+    const uint32_t *ids1; // interned lines of the first file
+    const uint32_t *ids2; // interned lines of the second file
+    long *forward;        // furthest reaching x per diagonal forward
+    long *backward;       // furthest reaching x per diagonal backward
+    char *removed;
+    char *added;
+} Context;
+
+/**
+ * @brief folds ASCII upper case letters of 8 bytes to lower case
+ *
+ * Sets the 0x20 bit of every byte between 'A' and 'Z' without looking at the
+ * bytes one by one
+ *
+ * @param word 8 bytes of a line
+ * @return uint64_t the folded bytes
+ */
+static uint64_t foldWord(uint64_t word)
+{
+    uint64_t low = word & 0x7F7F7F7F7F7F7F7FULL;
+    uint64_t atLeastA = low + 0x3F3F3F3F3F3F3F3FULL; // high bit set if >= 'A'
+    uint64_t aboveZ = low + 0x2525252525252525ULL;   // high bit set if > 'Z'
+    uint64_t upper = atLeastA & ~aboveZ & ~word & 0x8080808080808080ULL;
+    return word | (upper >> 2);
+}
+
+/**
+ * @details Hashes 8 bytes at once
+ */
+uint64_t hashLine(const char *text, size_t length, int caseSensitive)
+{
+    uint64_t hash = 0x9E3779B97F4A7C15ULL ^ length;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8)
+    {
+        uint64_t word;
+        memcpy(&word, text + i, sizeof(word));
+        if (!caseSensitive)
+        {
+            word = foldWord(word);
+        }
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 32;
+    }
+    uint64_t word = 0;
+    memcpy(&word, text + i, length - i);
+    if (!caseSensitive)
+    {
+        word = foldWord(word);
+    }
+    hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+    return hash ^ (hash >> 29);
+}
+
+/**
+ * @brief checks whether two lines are equal
+ *
+ * @param line1 the first line
+ * @param line2 the second line
+ * @param caseSensitive whether the case is compared or not
+ * @return int 1 if they are equal, otherwise 0
+ */
+static int linesEqual(const Line *line1, const Line *line2, int caseSensitive)
+{
+    if (line1->hash != line2->hash || line1->length != line2->length)
+    {
+        return 0;
+    }
+    if (caseSensitive)
+    {
+        return memcmp(line1->text, line2->text, line1->length) == 0;
+    }
+    for (size_t i = 0; i < line1->length; i++)
+    {
+        if (tolower((unsigned char)line1->text[i]) != tolower((unsigned char)line2->text[i]))
+        {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int loadLines(const char *filename, int caseSensitive, FileLines *result)
+{
+    memset(result, 0, sizeof(*result));
+    FILE *file = fopen(filename, "r");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    // read the whole file into one buffer
+    size_t capacity = 64 * 1024;
+    result->data = malloc(capacity);
+    while (result->data != NULL)
+    {
+        result->size += fread(result->data + result->size, 1, capacity - result->size, file);
+        if (result->size < capacity)
+        {
+            break;
+        }
+        capacity *= 2;
+        char *tmp = realloc(result->data, capacity);
+        if (tmp == NULL)
+        {
+            free(result->data);
+        }
+        result->data = tmp;
+    }
+    int readError = ferror(file);
+    fclose(file);
+    if (result->data == NULL || readError)
+    {
+        free(result->data);
+        result->data = NULL;
+        errno = readError ? EIO : ENOMEM;
+        return -1;
+    }
+
+    // count the lines and split the buffer into them
+    size_t count = 0;
+    for (const char *pos = result->data; pos < result->data + result->size; count++)
+    {
+        const char *newline = memchr(pos, '\n', result->data + result->size - pos);
+        pos = newline == NULL ? result->data + result->size : newline + 1;
+    }
+    result->lines = malloc(sizeof(Line) * (count + 1));
+    if (result->lines == NULL)
+    {
+        freeLines(result);
+        return -1;
+    }
+    const char *pos = result->data;
+    for (size_t i = 0; i < count; i++)
+    {
+        const char *newline = memchr(pos, '\n', result->data + result->size - pos);
+        const char *end = newline == NULL ? result->data + result->size : newline + 1;
+        result->lines[i].text = pos;
+        result->lines[i].length = end - pos;
+        result->lines[i].hash = hashLine(pos, end - pos, caseSensitive);
+        pos = end;
+    }
+    result->count = count;
+    return 0;
+}
+
+void freeLines(FileLines *file)
+{
+    free(file->data);
+    free(file->lines);
+    file->data = NULL;
+    file->lines = NULL;
+    file->count = 0;
+}
+
+void freeDiff(DiffResult *result)
+{
+    free(result->removed);
+    free(result->added);
+    result->removed = NULL;
+    result->added = NULL;
+}
+
+int internLines(const FileLines *file1, const FileLines *file2, int caseSensitive, uint32_t *ids)
+{
+    size_t total = file1->count + file2->count;
+    size_t size = 16;
+    while (size < 2 * total)
+    {
+        size *= 2;
+    }
+
+    // open addressing table of the first line with every id
+    const Line **table = calloc(size, sizeof(Line *));
+    uint32_t *tableIds = malloc(sizeof(uint32_t) * size);
+    if (table == NULL || tableIds == NULL)
+    {
+        free(table);
+        free(tableIds);
+        return -1;
+    }
+
+    uint32_t nextId = 0;
+    for (size_t i = 0; i < total; i++)
+    {
+        const Line *line = i < file1->count ? &file1->lines[i] : &file2->lines[i - file1->count];
+        size_t slot = line->hash & (size - 1);
+        while (table[slot] != NULL && !linesEqual(table[slot], line, caseSensitive))
+        {
+            slot = (slot + 1) & (size - 1);
+        }
+        if (table[slot] == NULL)
+        {
+            table[slot] = line;
+            tableIds[slot] = nextId++;
+        }
+        ids[i] = tableIds[slot];
+    }
+
+    free(table);
+    free(tableIds);
+    return 0;
+}
+
+/**
+ * @brief the index of a diagonal in the arrays of the context
+ *
+ * @param k the diagonal (may be negative)
+ * @param size the number of diagonals which are used
+ * @return size_t the index
+ */
+static size_t diagonal(long k, long size)
+{
+    long index = k % size;
+    return index < 0 ? index + size : index;
+}
+
+/**
+ * @brief computes the diff of a range of both files
+ *
+ * Removes the common prefix and suffix, then searches the middle snake from
+ * both ends at once and recurses on both sides of it
+ *
+ * @param context the state of the diff
+ * @param start1 the first line of the range in the first file
+ * @param n the number of lines of the range in the first file
+ * @param start2 the first line of the range in the second file
+ * @param m the number of lines of the range in the second file
+ */
+static void diffRange(Context *context, long start1, long n, long start2, long m)
+{
+    const uint32_t *a = context->ids1;
+    const uint32_t *b = context->ids2;
+    while (n > 0 && m > 0 && a[start1] == b[start2])
+    {
+        start1++;
+        start2++;
+        n--;
+        m--;
+    }
+    while (n > 0 && m > 0 && a[start1 + n - 1] == b[start2 + m - 1])
+    {
+        n--;
+        m--;
+    }
+    if (n == 0 || m == 0)
+    {
+        memset(context->added + start2, 1, m);
+        memset(context->removed + start1, 1, n);
+        return;
+    }
+
+    long total = n + m;
+    long size = 2 * (n < m ? n : m) + 2;
+    long delta = n - m;
+    memset(context->forward, 0, sizeof(long) * size);
+    memset(context->backward, 0, sizeof(long) * size);
+
+    for (long h = 0; h <= total / 2 + total % 2; h++)
+    {
+        for (int forward = 1; forward >= 0; forward--)
+        {
+            long *current = forward ? context->forward : context->backward;
+            long *other = forward ? context->backward : context->forward;
+            long kLow = -(h - 2 * (h > m ? h - m : 0));
+            long kHigh = h - 2 * (h > n ? h - n : 0);
+            for (long k = kLow; k <= kHigh; k += 2)
+            {
+                long x;
+                if (k == -h || (k != h && current[diagonal(k - 1, size)] < current[diagonal(k + 1, size)]))
+                {
+                    x = current[diagonal(k + 1, size)];
+                }
+                else
+                {
+                    x = current[diagonal(k - 1, size)] + 1;
+                }
+                long y = x - k;
+                long startX = x;
+                long startY = y;
+
+                // follow the snake (backwards from the end of the range)
+                if (forward)
+                {
+                    while (x < n && y < m && a[start1 + x] == b[start2 + y])
+                    {
+                        x++;
+                        y++;
+                    }
+                }
+                else
+                {
+                    while (x < n && y < m && a[start1 + n - 1 - x] == b[start2 + m - 1 - y])
+                    {
+                        x++;
+                        y++;
+                    }
+                }
+                current[diagonal(k, size)] = x;
+
+                long z = delta - k;
+                if (total % 2 == forward && z >= -(h - forward) && z <= h - forward &&
+                    x + other[diagonal(z, size)] >= n)
+                {
+                    long d, x1, y1, x2, y2;
+                    if (forward)
+                    {
+                        d = 2 * h - 1;
+                        x1 = startX;
+                        y1 = startY;
+                        x2 = x;
+                        y2 = y;
+                    }
+                    else
+                    {
+                        d = 2 * h;
+                        x1 = n - x;
+                        y1 = m - y;
+                        x2 = n - startX;
+                        y2 = m - startY;
+                    }
+
+                    if (d > 1 || (x1 != x2 && y1 != y2))
+                    {
+                        diffRange(context, start1, x1, start2, y1);
+                        diffRange(context, start1 + x2, n - x2, start2 + y2, m - y2);
+                    }
+                    else if (m > n)
+                    {
+                        memset(context->added + start2 + n, 1, m - n);
+                    }
+                    else if (m < n)
+                    {
+                        memset(context->removed + start1 + m, 1, n - m);
+                    }
+                    return;
+                }
+            }
+        }
+    }
+}
+
+void diffIds(const uint32_t *ids1, size_t n, const uint32_t *ids2, size_t m, long *forward, long *backward,
+             char *removed, char *added)
+{
+    Context context = {ids1, ids2, forward, backward, removed, added};
+    diffRange(&context, 0, n, 0, m);
+}
+
+int diffLines(const FileLines *file1, const FileLines *file2, int caseSensitive, DiffResult *result)
+{
+    size_t n = file1->count;
+    size_t m = file2->count;
+    size_t size = 2 * (n < m ? n : m) + 2;
+    uint32_t *ids = malloc(sizeof(uint32_t) * (n + m + 1));
+    long *forward = malloc(sizeof(long) * size);
+    long *backward = malloc(sizeof(long) * size);
+    result->removed = calloc(n + 1, 1);
+    result->added = calloc(m + 1, 1);
+    if (ids == NULL || forward == NULL || backward == NULL || result->removed == NULL ||
+        result->added == NULL || internLines(file1, file2, caseSensitive, ids) == -1)
+    {
+        free(ids);
+        free(forward);
+        free(backward);
+        freeDiff(result);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    diffIds(ids, n, ids + n, m, forward, backward, result->removed, result->added);
+
+    free(ids);
+    free(forward);
+    free(backward);
+    return 0;
+}
+
+/**
+ * @brief prints one line of a hunk
+ *
+ * @param output the stream to print to
+ * @param prefix ' ', '-' or '+'
+ * @param line the line
+ * @return int 0 on success, -1 if printing failed
+ */
+static int printLine(FILE *output, char prefix, const Line *line)
+{
+    if (fputc(prefix, output) == EOF || fwrite(line->text, 1, line->length, output) != line->length)
+    {
+        return -1;
+    }
+    if (line->length == 0 || line->text[line->length - 1] != '\n')
+    {
+        if (fputs("\n\\ No newline at end of file\n", output) == EOF)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief prints the range of a hunk header
+ *
+ * @param output the stream to print to
+ * @param start the first line of the hunk (0 based)
+ * @param count the number of lines of the hunk
+ * @return int 0 on success, -1 if printing failed
+ */
+static int printRange(FILE *output, size_t start, size_t count)
+{
+    // an empty range is named after the line before it
+    size_t first = count == 0 ? start : start + 1;
+    int printed = count == 1 ? fprintf(output, "%zu", first) : fprintf(output, "%zu,%zu", first, count);
+    return printed < 0 ? -1 : 0;
+}
+
+int printUnified(FILE *output, const char *filename1, const char *filename2,
+                 const FileLines *file1, const FileLines *file2, const DiffResult *result, size_t context)
+{
+    size_t n = file1->count;
+    size_t m = file2->count;
+    size_t i = 0;
+    size_t j = 0;
+    int hunks = 0;
+    while (1)
+    {
+        // skip to the next change
+        while (i < n && j < m && !result->removed[i] && !result->added[j])
+        {
+            i++;
+            j++;
+        }
+        if (i == n && j == m)
+        {
+            break;
+        }
+
+        // the hunk ends when more than 2 * context unchanged lines follow a change
+        size_t before = i < j ? i : j;
+        before = before < context ? before : context;
+        size_t start1 = i - before;
+        size_t start2 = j - before;
+        size_t end1 = i;
+        size_t end2 = j;
+        while (1)
+        {
+            while (end1 < n && result->removed[end1])
+            {
+                end1++;
+            }
+            while (end2 < m && result->added[end2])
+            {
+                end2++;
+            }
+            size_t same = 0;
+            while (end1 + same < n && end2 + same < m && !result->removed[end1 + same] &&
+                   !result->added[end2 + same] && same <= 2 * context)
+            {
+                same++;
+            }
+            int last = end1 + same == n && end2 + same == m;
+            if (same > 2 * context || last)
+            {
+                size_t after = same < context ? same : context;
+                end1 += after;
+                end2 += after;
+                break;
+            }
+            end1 += same;
+            end2 += same;
+        }
+
+        if (hunks == 0 && fprintf(output, "--- %s\n+++ %s\n", filename1, filename2) < 0)
+        {
+            return -1;
+        }
+        if (fputs("@@ -", output) == EOF || printRange(output, start1, end1 - start1) == -1 ||
+            fputs(" +", output) == EOF || printRange(output, start2, end2 - start2) == -1 ||
+            fputs(" @@\n", output) == EOF)
+        {
+            return -1;
+        }
+
+        // print the lines of the hunk, removed lines before added ones
+        i = start1;
+        j = start2;
+        while (i < end1 || j < end2)
+        {
+            int ok;
+            if (i < end1 && result->removed[i])
+            {
+                ok = printLine(output, '-', &file1->lines[i++]);
+            }
+            else if (j < end2 && result->added[j])
+            {
+                ok = printLine(output, '+', &file2->lines[j++]);
+            }
+            else
+            {
+                ok = printLine(output, ' ', &file1->lines[i++]);
+                j++;
+            }
+            if (ok == -1)
+            {
+                return -1;
+            }
+        }
+        hunks++;
+    }
+    return hunks;
+}
@@ -0,0 +1,149 @@
+#ifndef MYERS_H
+#define MYERS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+/**
+ * @brief a line of a file
+ *
+ * The text points into the buffer of the file and includes the newline
+ * (if the line has one), so a last line without newline differs from the
+ * same line with newline
+ */
+typedef struct Line
+{
+    const char *text;
+    size_t length;
+    uint64_t hash;
+} Line;
+
+/**
+ * @brief all lines of a file
+ *
+ * The whole file is read into data, which is the arena of all lines
+ */
+typedef struct FileLines
+{
+    char *data;
+    size_t size;
+    Line *lines;
+    size_t count;
+} FileLines;
+
+/**
+ * @brief the result of a diff
+ *
+ * removed[i] is 1 if line i of the first file was removed, added[j] is 1 if
+ * line j of the second file was added
+ */
+typedef struct DiffResult
+{
+    char *removed;
+    char *added;
+} DiffResult;
+
+/**
+ * @brief reads all lines of a file
+ *
+ * Reads the whole file into one buffer and hashes every line (folding the
+ * case if caseSensitive is 0)
+ *
+ * @param filename the path of the file
+ * @param caseSensitive whether the hashes are case sensitive or not
+ * @param result the lines of the file
+ * @return int 0 on success, -1 on failure (errno is set)
+ */
+int loadLines(const char *filename, int caseSensitive, FileLines *result);
+
+/**
+ * @brief frees the lines of a file
+ *
+ * @param file the lines loaded by loadLines
+ */
+void freeLines(FileLines *file);
+
+/**
+ * @brief hashes a line
+ *
+ * @param text the line
+ * @param length the length of the line
+ * @param caseSensitive whether the case is hashed or not
+ * @return uint64_t the hash
+ */
+uint64_t hashLine(const char *text, size_t length, int caseSensitive);
+
+/**
+ * @brief maps the lines of both files to ids
+ *
+ * Equal lines get the same id (smaller than the number of all lines), so the
+ * diff only has to compare integers
+ *
+ * @param file1 the lines of the first file
+ * @param file2 the lines of the second file
+ * @param caseSensitive whether the case is compared or not
+ * @param ids an array for the ids of all lines of both files, the first file first
+ * @return int 0 on success, -1 if there wasn't enough memory
+ */
+int internLines(const FileLines *file1, const FileLines *file2, int caseSensitive, uint32_t *ids);
+
+/**
+ * @brief computes a minimal diff of two sequences of line ids
+ *
+ * The core of diffLines, for callers which intern the lines themselves
+ *
+ * @param ids1 the ids of the first file
+ * @param n the number of lines of the first file
+ * @param ids2 the ids of the second file
+ * @param m the number of lines of the second file
+ * @param forward space for 2 * min(n, m) + 2 longs
+ * @param backward space for 2 * min(n, m) + 2 longs
+ * @param removed n zeroed bytes, set to 1 for the removed lines
+ * @param added m zeroed bytes, set to 1 for the added lines
+ */
+void diffIds(const uint32_t *ids1, size_t n, const uint32_t *ids2, size_t m, long *forward, long *backward,
+             char *removed, char *added);
+
+/**
+ * @brief computes a minimal diff of two files
+ *
+ * Interns the lines of both files to integer ids (equal hashes are checked
+ * byte by byte) and runs Myers' O(ND) algorithm in linear space with the
+ * middle snake, after removing the common prefix and suffix. So files which
+ * only differ in a few lines are compared in near linear time.
+ *
+ * @param file1 the lines of the first file
+ * @param file2 the lines of the second file
+ * @param caseSensitive whether lines are compared case sensitive or not
+ * @param result the removed and added lines, free with freeDiff
+ * @return int 0 on success, -1 on failure (errno is set)
+ */
+int diffLines(const FileLines *file1, const FileLines *file2, int caseSensitive, DiffResult *result);
+
+/**
+ * @brief frees the result of a diff
+ *
+ * @param result the result of diffLines
+ */
+void freeDiff(DiffResult *result);
+
+/**
+ * @brief prints a diff as unified hunks
+ *
+ * Prints the header with both filenames and every hunk with the given
+ * number of context lines (like diff -U)
+ *
+ * @param output the stream to print to
+ * @param filename1 the name of the first file
+ * @param filename2 the name of the second file
+ * @param file1 the lines of the first file
+ * @param file2 the lines of the second file
+ * @param result the result of diffLines
+ * @param context the number of unchanged lines around each change
+ * @return int the number of hunks, -1 if printing failed
+ */
+int printUnified(FILE *output, const char *filename1, const char *filename2,
+                 const FileLines *file1, const FileLines *file2, const DiffResult *result, size_t context);
+
+#endif
@@ -0,0 +1,765 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+
+#include "myers.h"
+#include "stream.h"
+
+/**
+ * @brief the lines of a file which are read but not printed yet
+ *
+ * Every line has its own getline buffer. Dropped lines give their buffer to
+ * the end of the window, so after the first windows no line needs malloc
+ */
+typedef struct Window
+{
+    FILE *file;
+    Line *lines;
+    char **buffers;
+    size_t *capacities;
+    char **spareBuffers; // scratch space for dropWindow
+    size_t *spareCapacities;
+    size_t count;
+    size_t limit;
+    int eof;
+} Window;
+
+/**
+ * @brief collects the unified hunks while the diff streams by
+ *
+ * Outside of a hunk text holds the last (at most context) unchanged lines,
+ * which become the context in front of the next change. Inside of a hunk it
+ * holds the hunk so far, or the end of it once the front went to the
+ * temporary file spill. Every line is stored as it is printed (with its
+ * prefix), ends has the offset behind every line
+ */
+typedef struct Emitter
+{
+    FILE *output;
+    const char *filename1;
+    const char *filename2;
+    size_t context;
+    size_t limit; // lines after which a hunk is spilled
+    int summary;
+    size_t line1; // the next line of the first file (0 based)
+    size_t line2; // the next line of the second file (0 based)
+    int inHunk;
+    size_t start1;
+    size_t start2;
+    size_t count1;
+    size_t count2;
+    size_t trailing; // unchanged lines since the last change of the hunk
+    char *text;
+    size_t length;
+    size_t capacity;
+    size_t *ends;
+    size_t lines;
+    size_t endsCapacity;
+    FILE *spill; // the front of a long hunk
+    size_t spilled;
+    int lastChanged;
+    size_t removed;
+    size_t added;
+    long hunks;
+} Emitter;
+
+/**
+ * @brief the windows and the scratch space of a round
+ *
+ * All arrays are allocated once for the size of the windows
+ */
+typedef struct Stream
+{
+    Window window1;
+    Window window2;
+    int caseSensitive;
+    uint32_t *ids;        // the ids of both windows, the first window first
+    unsigned char *seen1; // how often an id is in the first window (up to 2)
+    unsigned char *seen2;
+    size_t *where1;     // the line of an id in the first window
+    size_t *candidate1; // lines unique in both windows, in the order of the second
+    size_t *candidate2;
+    size_t *previous; // the candidate in front of a candidate in the longest sequence
+    size_t *tails;    // the candidate which ends the best sequence of every length
+    size_t *anchor1;
+    size_t *anchor2;
+    long *forward;
+    long *backward;
+    char *removed;
+    char *added;
+    Emitter emitter;
+} Stream;
+
+/**
+ * @brief allocates the arrays of a window
+ *
+ * @param window the window to set up
+ * @param file the file which fills the window
+ * @param limit the number of lines of the window
+ * @return int 0 on success, -1 if there wasn't enough memory
+ */
+static int openWindow(Window *window, FILE *file, size_t limit)
+{
+    memset(window, 0, sizeof(*window));
+    window->file = file;
+    window->limit = limit;
+    window->lines = malloc(sizeof(Line) * limit);
+    window->buffers = calloc(limit, sizeof(char *));
+    window->capacities = calloc(limit, sizeof(size_t));
+    window->spareBuffers = malloc(sizeof(char *) * limit);
+    window->spareCapacities = malloc(sizeof(size_t) * limit);
+    if (window->lines == NULL || window->buffers == NULL || window->capacities == NULL ||
+        window->spareBuffers == NULL || window->spareCapacities == NULL)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief frees a window (also one which could not be set up completely)
+ *
+ * @param window the window
+ */
+static void closeWindow(Window *window)
+{
+    if (window->buffers != NULL)
+    {
+        for (size_t i = 0; i < window->limit; i++)
+        {
+            free(window->buffers[i]);
+        }
+    }
+    free(window->lines);
+    free(window->buffers);
+    free(window->capacities);
+    free(window->spareBuffers);
+    free(window->spareCapacities);
+}
+
+/**
+ * @brief reads lines until the window is full or the file ends
+ *
+ * @param window the window
+ * @param caseSensitive whether the hashes are case sensitive or not
+ * @return int 0 on success, -1 on failure (errno is set)
+ */
+static int fillWindow(Window *window, int caseSensitive)
+{
+    while (!window->eof && window->count < window->limit)
+    {
+        size_t i = window->count;
+        errno = 0;
+        ssize_t length = getline(&window->buffers[i], &window->capacities[i], window->file);
+        if (length == -1)
+        {
+            if (ferror(window->file) || errno == ENOMEM)
+            {
+                errno = errno != 0 ? errno : EIO;
+                return -1;
+            }
+            window->eof = 1;
+            break;
+        }
+        window->lines[i].text = window->buffers[i];
+        window->lines[i].length = length;
+        window->lines[i].hash = hashLine(window->buffers[i], length, caseSensitive);
+        window->count++;
+    }
+    return 0;
+}
+
+/**
+ * @brief drops the first lines of a window
+ *
+ * Their buffers are moved behind the remaining lines to be read into again
+ *
+ * @param window the window
+ * @param count the number of lines to drop
+ */
+static void dropWindow(Window *window, size_t count)
+{
+    size_t rest = window->count - count;
+    memcpy(window->spareBuffers, window->buffers, sizeof(char *) * count);
+    memcpy(window->spareCapacities, window->capacities, sizeof(size_t) * count);
+    memmove(window->lines, window->lines + count, sizeof(Line) * rest);
+    memmove(window->buffers, window->buffers + count, sizeof(char *) * rest);
+    memmove(window->capacities, window->capacities + count, sizeof(size_t) * rest);
+    memcpy(window->buffers + rest, window->spareBuffers, sizeof(char *) * count);
+    memcpy(window->capacities + rest, window->spareCapacities, sizeof(size_t) * count);
+    window->count = rest;
+}
+
+/**
+ * @brief stores a line as it will be printed in the hunk
+ *
+ * @param emitter the emitter
+ * @param prefix ' ', '-' or '+'
+ * @param line the line
+ * @return int 0 on success, -1 if there wasn't enough memory
+ */
+static int appendLine(Emitter *emitter, char prefix, const Line *line)
+{
+    static const char noNewline[] = "\n\\ No newline at end of file\n";
+    int complete = line->length > 0 && line->text[line->length - 1] == '\n';
+    size_t needed = 1 + line->length + (complete ? 0 : sizeof(noNewline) - 1);
+    if (emitter->length + needed > emitter->capacity)
+    {
+        size_t capacity = emitter->capacity == 0 ? 64 * 1024 : emitter->capacity;
+        while (capacity < emitter->length + needed)
+        {
+            capacity *= 2;
+        }
+        char *text = realloc(emitter->text, capacity);
+        if (text == NULL)
+        {
+            return -1;
+        }
+        emitter->text = text;
+        emitter->capacity = capacity;
+    }
+    if (emitter->lines == emitter->endsCapacity)
+    {
+        size_t capacity = emitter->endsCapacity == 0 ? 1024 : 2 * emitter->endsCapacity;
+        size_t *ends = realloc(emitter->ends, sizeof(size_t) * capacity);
+        if (ends == NULL)
+        {
+            return -1;
+        }
+        emitter->ends = ends;
+        emitter->endsCapacity = capacity;
+    }
+
+    char *pos = emitter->text + emitter->length;
+    *pos++ = prefix;
+    memcpy(pos, line->text, line->length);
+    pos += line->length;
+    if (!complete)
+    {
+        memcpy(pos, noNewline, sizeof(noNewline) - 1);
+        pos += sizeof(noNewline) - 1;
+    }
+    emitter->length = pos - emitter->text;
+    emitter->ends[emitter->lines++] = emitter->length;
+    return 0;
+}
+
+/**
+ * @brief forgets the first stored lines
+ *
+ * @param emitter the emitter
+ * @param count the number of lines to forget
+ */
+static void dropLines(Emitter *emitter, size_t count)
+{
+    if (count == 0)
+    {
+        return;
+    }
+    size_t offset = emitter->ends[count - 1];
+    memmove(emitter->text, emitter->text + offset, emitter->length - offset);
+    emitter->length -= offset;
+    for (size_t i = count; i < emitter->lines; i++)
+    {
+        emitter->ends[i - count] = emitter->ends[i] - offset;
+    }
+    emitter->lines -= count;
+}
+
+/**
+ * @brief prints the range of a hunk header
+ *
+ * @param output the stream to print to
+ * @param start the first line of the hunk (0 based)
+ * @param count the number of lines of the hunk
+ * @return int 0 on success, -1 if printing failed
+ */
+static int printRange(FILE *output, size_t start, size_t count)
+{
+    // an empty range is named after the line before it
+    size_t first = count == 0 ? start : start + 1;
+    int printed = count == 1 ? fprintf(output, "%zu", first) : fprintf(output, "%zu,%zu", first, count);
+    return printed < 0 ? -1 : 0;
+}
+
+/**
+ * @brief prints the first stored lines as a hunk
+ *
+ * The spilled front of the hunk comes first
+ *
+ * @param emitter the emitter
+ * @param lines the number of stored lines to print
+ * @param count1 the number of these lines from the first file
+ * @param count2 the number of these lines from the second file
+ * @return int 0 on success, -1 if printing failed
+ */
+static int printHunk(Emitter *emitter, size_t lines, size_t count1, size_t count2)
+{
+    FILE *output = emitter->output;
+    if (emitter->hunks == 0 && fprintf(output, "--- %s\n+++ %s\n", emitter->filename1, emitter->filename2) < 0)
+    {
+        return -1;
+    }
+    if (fputs("@@ -", output) == EOF || printRange(output, emitter->start1, count1) == -1 ||
+        fputs(" +", output) == EOF || printRange(output, emitter->start2, count2) == -1 ||
+        fputs(" @@\n", output) == EOF)
+    {
+        return -1;
+    }
+    if (emitter->spilled > 0)
+    {
+        if (fseek(emitter->spill, 0, SEEK_SET) == -1)
+        {
+            return -1;
+        }
+        char buffer[64 * 1024];
+        while (emitter->spilled > 0)
+        {
+            size_t chunk = emitter->spilled < sizeof(buffer) ? emitter->spilled : sizeof(buffer);
+            if (fread(buffer, 1, chunk, emitter->spill) != chunk || fwrite(buffer, 1, chunk, output) != chunk)
+            {
+                return -1;
+            }
+            emitter->spilled -= chunk;
+        }
+        // the next hunk overwrites the file from the start
+        if (fseek(emitter->spill, 0, SEEK_SET) == -1)
+        {
+            return -1;
+        }
+    }
+    size_t length = lines > 0 ? emitter->ends[lines - 1] : 0;
+    if (fwrite(emitter->text, 1, length, output) != length)
+    {
+        return -1;
+    }
+    emitter->hunks++;
+    return 0;
+}
+
+/**
+ * @brief ends the current hunk
+ *
+ * Prints it with at most context unchanged lines after the last change and
+ * keeps the last context unchanged lines for the next hunk
+ *
+ * @param emitter the emitter
+ * @return int 0 on success, -1 if printing failed
+ */
+static int closeHunk(Emitter *emitter)
+{
+    size_t cut = emitter->trailing > emitter->context ? emitter->trailing - emitter->context : 0;
+    size_t lines = emitter->lines - cut;
+    if (printHunk(emitter, lines, emitter->count1 - cut, emitter->count2 - cut) == -1)
+    {
+        return -1;
+    }
+    dropLines(emitter, lines);
+    if (emitter->lines > emitter->context)
+    {
+        dropLines(emitter, emitter->lines - emitter->context);
+    }
+    emitter->inHunk = 0;
+    emitter->trailing = 0;
+    return 0;
+}
+
+/**
+ * @brief a line which is in both files
+ *
+ * @param emitter the emitter
+ * @param line the line of the first file
+ * @return int 0 on success, -1 on failure
+ */
+static int keepLine(Emitter *emitter, const Line *line)
+{
+    emitter->line1++;
+    emitter->line2++;
+    emitter->lastChanged = 0;
+    if (emitter->summary)
+    {
+        return 0;
+    }
+    if (appendLine(emitter, ' ', line) == -1)
+    {
+        return -1;
+    }
+    if (!emitter->inHunk)
+    {
+        if (emitter->lines > emitter->context)
+        {
+            dropLines(emitter, 1);
+        }
+        return 0;
+    }
+    emitter->count1++;
+    emitter->count2++;
+    emitter->trailing++;
+    return emitter->trailing > 2 * emitter->context ? closeHunk(emitter) : 0;
+}
+
+/**
+ * @brief a line which was removed or added
+ *
+ * Once a hunk has limit lines in memory they are written to the temporary
+ * file before the line, so a hunk never needs more memory than the windows.
+ * Nothing in front of a change is cut from a hunk, so it can go
+ *
+ * @param emitter the emitter
+ * @param prefix '-' for a removed line, '+' for an added one
+ * @param line the line
+ * @return int 0 on success, -1 on failure
+ */
+static int changeLine(Emitter *emitter, char prefix, const Line *line)
+{
+    int removed = prefix == '-';
+    emitter->removed += removed;
+    emitter->added += !removed;
+    if (emitter->summary)
+    {
+        // every block of changed lines is one change
+        emitter->hunks += !emitter->lastChanged;
+    }
+    else if (!emitter->inHunk)
+    {
+        emitter->inHunk = 1;
+        emitter->start1 = emitter->line1 - emitter->lines;
+        emitter->start2 = emitter->line2 - emitter->lines;
+        emitter->count1 = emitter->lines;
+        emitter->count2 = emitter->lines;
+    }
+    else if (emitter->lines >= emitter->limit)
+    {
+        if (emitter->spill == NULL && (emitter->spill = tmpfile()) == NULL)
+        {
+            return -1;
+        }
+        if (fwrite(emitter->text, 1, emitter->length, emitter->spill) != emitter->length)
+        {
+            return -1;
+        }
+        emitter->spilled += emitter->length;
+        dropLines(emitter, emitter->lines);
+    }
+    emitter->lastChanged = 1;
+    emitter->line1 += removed;
+    emitter->line2 += !removed;
+    if (emitter->summary)
+    {
+        return 0;
+    }
+    emitter->count1 += removed;
+    emitter->count2 += !removed;
+    emitter->trailing = 0;
+    return appendLine(emitter, prefix, line);
+}
+
+/**
+ * @brief diffs the lines between two anchors exactly and passes them on
+ *
+ * @param stream the stream
+ * @param start1 the first line in the first window
+ * @param n the number of lines in the first window
+ * @param start2 the first line in the second window
+ * @param m the number of lines in the second window
+ * @return int 0 on success, -1 on failure
+ */
+static int diffSegment(Stream *stream, size_t start1, size_t n, size_t start2, size_t m)
+{
+    const uint32_t *ids1 = stream->ids;
+    const uint32_t *ids2 = stream->ids + stream->window1.count;
+    const Line *lines1 = stream->window1.lines + start1;
+    const Line *lines2 = stream->window2.lines + start2;
+    memset(stream->removed, 0, n + 1);
+    memset(stream->added, 0, m + 1);
+    diffIds(ids1 + start1, n, ids2 + start2, m, stream->forward, stream->backward, stream->removed,
+            stream->added);
+
+    // removed lines before added ones, like printUnified
+    size_t i = 0;
+    size_t j = 0;
+    while (i < n || j < m)
+    {
+        int ok;
+        if (i < n && stream->removed[i])
+        {
+            ok = changeLine(&stream->emitter, '-', &lines1[i++]);
+        }
+        else if (j < m && stream->added[j])
+        {
+            ok = changeLine(&stream->emitter, '+', &lines2[j++]);
+        }
+        else
+        {
+            ok = keepLine(&stream->emitter, &lines1[i++]);
+            j++;
+        }
+        if (ok == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief finds the anchors of both windows
+ *
+ * The lines which occur once in each window, and of them the longest
+ * sequence which is in the same order in both (found with patience sorting)
+ *
+ * @param stream the stream, the ids of the windows are set
+ * @return size_t the number of anchors in anchor1 and anchor2
+ */
+static size_t findAnchors(Stream *stream)
+{
+    size_t n = stream->window1.count;
+    size_t m = stream->window2.count;
+    const uint32_t *ids1 = stream->ids;
+    const uint32_t *ids2 = stream->ids + n;
+    memset(stream->seen1, 0, n + m);
+    memset(stream->seen2, 0, n + m);
+    for (size_t i = 0; i < n; i++)
+    {
+        if (stream->seen1[ids1[i]] < 2)
+        {
+            stream->seen1[ids1[i]]++;
+        }
+        stream->where1[ids1[i]] = i;
+    }
+    for (size_t j = 0; j < m; j++)
+    {
+        if (stream->seen2[ids2[j]] < 2)
+        {
+            stream->seen2[ids2[j]]++;
+        }
+    }
+    size_t candidates = 0;
+    for (size_t j = 0; j < m; j++)
+    {
+        if (stream->seen1[ids2[j]] == 1 && stream->seen2[ids2[j]] == 1)
+        {
+            stream->candidate1[candidates] = stream->where1[ids2[j]];
+            stream->candidate2[candidates] = j;
+            candidates++;
+        }
+    }
+
+    // tails[k] is the candidate with the smallest line ending a sequence of k + 1
+    size_t length = 0;
+    for (size_t c = 0; c < candidates; c++)
+    {
+        size_t low = 0;
+        size_t high = length;
+        while (low < high)
+        {
+            size_t middle = low + (high - low) / 2;
+            if (stream->candidate1[stream->tails[middle]] < stream->candidate1[c])
+            {
+                low = middle + 1;
+            }
+            else
+            {
+                high = middle;
+            }
+        }
+        stream->previous[c] = low > 0 ? stream->tails[low - 1] : (size_t)-1;
+        stream->tails[low] = c;
+        if (low == length)
+        {
+            length++;
+        }
+    }
+
+    size_t c = length > 0 ? stream->tails[length - 1] : 0;
+    for (size_t k = length; k > 0; k--)
+    {
+        stream->anchor1[k - 1] = stream->candidate1[c];
+        stream->anchor2[k - 1] = stream->candidate2[c];
+        c = stream->previous[c];
+    }
+    return length;
+}
+
+/**
+ * @brief diffs the windows up to their last anchor
+ *
+ * Without an anchor, or once both files are read completely, the windows are
+ * diffed to their end
+ *
+ * @param stream the stream with both windows filled
+ * @return int 0 on success, -1 on failure (errno is set)
+ */
+static int diffRound(Stream *stream)
+{
+    Window *window1 = &stream->window1;
+    Window *window2 = &stream->window2;
+    FileLines file1 = {NULL, 0, window1->lines, window1->count};
+    FileLines file2 = {NULL, 0, window2->lines, window2->count};
+    if (internLines(&file1, &file2, stream->caseSensitive, stream->ids) == -1)
+    {
+        errno = ENOMEM;
+        return -1;
+    }
+
+    size_t anchors = findAnchors(stream);
+    size_t start1 = 0;
+    size_t start2 = 0;
+    for (size_t k = 0; k < anchors; k++)
+    {
+        size_t anchor1 = stream->anchor1[k];
+        size_t anchor2 = stream->anchor2[k];
+        if (diffSegment(stream, start1, anchor1 - start1, start2, anchor2 - start2) == -1 ||
+            keepLine(&stream->emitter, &window1->lines[anchor1]) == -1)
+        {
+            return -1;
+        }
+        start1 = anchor1 + 1;
+        start2 = anchor2 + 1;
+    }
+    if (anchors == 0 || (window1->eof && window2->eof))
+    {
+        if (diffSegment(stream, start1, window1->count - start1, start2, window2->count - start2) == -1)
+        {
+            return -1;
+        }
+        start1 = window1->count;
+        start2 = window2->count;
+    }
+    dropWindow(window1, start1);
+    dropWindow(window2, start2);
+    return 0;
+}
+
+/**
+ * @brief allocates the scratch space of a stream
+ *
+ * @param stream the stream, zeroed
+ * @param window the number of lines of each window
+ * @return int 0 on success, -1 if there wasn't enough memory
+ */
+static int allocateStream(Stream *stream, size_t window)
+{
+    stream->ids = malloc(sizeof(uint32_t) * 2 * window);
+    stream->seen1 = malloc(2 * window);
+    stream->seen2 = malloc(2 * window);
+    stream->where1 = malloc(sizeof(size_t) * 2 * window);
+    stream->candidate1 = malloc(sizeof(size_t) * window);
+    stream->candidate2 = malloc(sizeof(size_t) * window);
+    stream->previous = malloc(sizeof(size_t) * window);
+    stream->tails = malloc(sizeof(size_t) * window);
+    stream->anchor1 = malloc(sizeof(size_t) * window);
+    stream->anchor2 = malloc(sizeof(size_t) * window);
+    stream->forward = malloc(sizeof(long) * (2 * window + 2));
+    stream->backward = malloc(sizeof(long) * (2 * window + 2));
+    stream->removed = malloc(window + 1);
+    stream->added = malloc(window + 1);
+    return stream->ids == NULL || stream->seen1 == NULL || stream->seen2 == NULL || stream->where1 == NULL ||
+                   stream->candidate1 == NULL || stream->candidate2 == NULL || stream->previous == NULL ||
+                   stream->tails == NULL || stream->anchor1 == NULL || stream->anchor2 == NULL ||
+                   stream->forward == NULL || stream->backward == NULL || stream->removed == NULL ||
+                   stream->added == NULL
+               ? -1
+               : 0;
+}
+
+/**
+ * @brief frees everything a stream allocated
+ *
+ * @param stream the stream
+ */
+static void freeStream(Stream *stream)
+{
+    closeWindow(&stream->window1);
+    closeWindow(&stream->window2);
+    free(stream->ids);
+    free(stream->seen1);
+    free(stream->seen2);
+    free(stream->where1);
+    free(stream->candidate1);
+    free(stream->candidate2);
+    free(stream->previous);
+    free(stream->tails);
+    free(stream->anchor1);
+    free(stream->anchor2);
+    free(stream->forward);
+    free(stream->backward);
+    free(stream->removed);
+    free(stream->added);
+    free(stream->emitter.text);
+    free(stream->emitter.ends);
+    if (stream->emitter.spill != NULL)
+    {
+        fclose(stream->emitter.spill);
+    }
+}
+
+long streamDiff(FILE *output, const char *filename1, const char *filename2, int caseSensitive, size_t context,
+                size_t window, int summary)
+{
+    FILE *file1 = fopen(filename1, "r");
+    FILE *file2 = file1 == NULL ? NULL : fopen(filename2, "r");
+    if (file2 == NULL)
+    {
+        int error = errno;
+        if (file1 != NULL)
+        {
+            fclose(file1);
+        }
+        errno = error;
+        return -1;
+    }
+
+    Stream stream;
+    memset(&stream, 0, sizeof(stream));
+    stream.caseSensitive = caseSensitive;
+    stream.emitter.output = output;
+    stream.emitter.filename1 = filename1;
+    stream.emitter.filename2 = filename2;
+    stream.emitter.context = context;
+    stream.emitter.limit = window;
+    stream.emitter.summary = summary;
+
+    int ok = openWindow(&stream.window1, file1, window) == 0 && openWindow(&stream.window2, file2, window) == 0 &&
+             allocateStream(&stream, window) == 0;
+    if (!ok)
+    {
+        errno = ENOMEM;
+    }
+    while (ok)
+    {
+        if (fillWindow(&stream.window1, caseSensitive) == -1 || fillWindow(&stream.window2, caseSensitive) == -1)
+        {
+            ok = 0;
+        }
+        else if (stream.window1.count == 0 && stream.window2.count == 0)
+        {
+            break;
+        }
+        else if (diffRound(&stream) == -1)
+        {
+            ok = 0;
+        }
+    }
+
+    Emitter *emitter = &stream.emitter;
+    if (ok && emitter->inHunk && closeHunk(emitter) == -1)
+    {
+        ok = 0;
+    }
+    if (ok && summary && emitter->hunks > 0 &&
+        fprintf(output, "Files %s and %s differ: %zu lines removed, %zu lines added in %ld changes\n", filename1,
+                filename2, emitter->removed, emitter->added, emitter->hunks) < 0)
+    {
+        ok = 0;
+    }
+
+    int error = errno;
+    long hunks = emitter->hunks;
+    freeStream(&stream);
+    fclose(file1);
+    fclose(file2);
+    errno = error;
+    return ok ? hunks : -1;
+}
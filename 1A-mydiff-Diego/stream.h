@@ -0,0 +1,35 @@
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * @brief compares two files of any size in bounded memory
+ *
+ * Reads both files through a window of at most window lines each. Lines
+ * which occur exactly once in both windows are anchors (like patience diff),
+ * the longest sequence of anchors in the same order splits the windows and
+ * only the lines between two anchors are diffed exactly with Myers. Everything
+ * up to the last anchor is printed and dropped from the windows, then they are
+ * filled again. A window without anchors is diffed as a whole. So a larger
+ * window finds more of the lines that moved and gives a smaller diff, a smaller
+ * one needs less memory.
+ *
+ * The hunks are unified (like diff -U), the front of a hunk which grows beyond
+ * window lines waits in a temporary file. With summary only the number of
+ * removed and added lines is printed.
+ *
+ * @param output the stream to print to
+ * @param filename1 the first file
+ * @param filename2 the second file
+ * @param caseSensitive whether lines are compared case sensitive or not
+ * @param context the number of unchanged lines around each change
+ * @param window the number of lines read ahead of each file
+ * @param summary 1 to print only a summary
+ * @return long the number of hunks (changes with summary), -1 on failure (errno is set)
+ */
+long streamDiff(FILE *output, const char *filename1, const char *filename2, int caseSensitive, size_t context,
+                size_t window, int summary);
+
+#endif
@@ -0,0 +1,466 @@
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "myers.h"
+#include "tree.h"
+
+/**
+ * @brief the relative paths of all regular files of a directory tree
+ */
+typedef struct FileList
+{
+    char **paths;
+    size_t count;
+    size_t capacity;
+} FileList;
+
+/**
+ * @brief a file which exists in both trees
+ */
+typedef struct Pair
+{
+    char *path1;
+    char *path2;
+    char *text;    // the output of the diff
+    size_t length; // the length of the output
+    int status;    // 0 - identical, 1 - different, -1 - failed
+    int error;     // the errno if it failed
+    int done;
+} Pair;
+
+/**
+ * @brief the jobs of the threads
+ */
+typedef struct Pool
+{
+    Pair *pairs;
+    size_t count;
+    size_t next; // the next pair which isnt taken by a thread
+    int caseSensitive;
+    size_t context;
+    pthread_mutex_t mutex;
+    pthread_cond_t finished; // signaled when a pair is done
+} Pool;
+
+/**
+ * @brief joins two parts of a path
+ *
+ * @param first the first part
+ * @param second the second part (may be empty)
+ * @return char* the allocated path, NULL if there wasnt enough memory
+ */
+static char *joinPath(const char *first, const char *second)
+{
+    size_t length1 = strlen(first);
+    size_t length2 = strlen(second);
+    char *path = malloc(length1 + length2 + 2);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+    memcpy(path, first, length1);
+    if (length2 == 0)
+    {
+        path[length1] = '\0';
+        return path;
+    }
+    path[length1] = '/';
+    memcpy(path + length1 + 1, second, length2 + 1);
+    return path;
+}
+
+/**
+ * @brief frees a list of files
+ *
+ * @param list the list
+ */
+static void freeFileList(FileList *list)
+{
+    for (size_t i = 0; i < list->count; i++)
+    {
+        free(list->paths[i]);
+    }
+    free(list->paths);
+}
+
+/**
+ * @brief adds all regular files of a directory to the list
+ *
+ * Walks the subdirectories recursively
+ *
+ * @param root the root of the tree
+ * @param relative the path of the directory relative to the root ("" for the root)
+ * @param list the list of files
+ * @return int 0 on success, -1 on failure (errno is set)
+ */
+static int collectFiles(const char *root, const char *relative, FileList *list)
+{
+    char *directoryPath = joinPath(root, relative);
+    if (directoryPath == NULL)
+    {
+        return -1;
+    }
+    DIR *directory = opendir(directoryPath);
+    free(directoryPath);
+    if (directory == NULL)
+    {
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent *entry;
+    while (result == 0 && (entry = readdir(directory)) != NULL)
+    {
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+        {
+            continue;
+        }
+
+        char *path = relative[0] == '\0' ? joinPath(entry->d_name, "") : joinPath(relative, entry->d_name);
+        char *fullPath = path == NULL ? NULL : joinPath(root, path);
+        struct stat info;
+        if (fullPath == NULL || stat(fullPath, &info) == -1)
+        {
+            // dangling symbolic links are ignored
+            result = fullPath != NULL && errno == ENOENT ? 0 : -1;
+        }
+        else if (S_ISDIR(info.st_mode))
+        {
+            result = collectFiles(root, path, list);
+        }
+        else if (S_ISREG(info.st_mode))
+        {
+            if (list->count == list->capacity)
+            {
+                size_t capacity = list->capacity == 0 ? 64 : list->capacity * 2;
+                char **paths = realloc(list->paths, sizeof(char *) * capacity);
+                if (paths == NULL)
+                {
+                    result = -1;
+                }
+                else
+                {
+                    list->paths = paths;
+                    list->capacity = capacity;
+                }
+            }
+            if (result == 0)
+            {
+                list->paths[list->count++] = path;
+                path = NULL;
+            }
+        }
+        free(path);
+        free(fullPath);
+    }
+
+    int error = errno;
+    closedir(directory);
+    errno = error;
+    return result;
+}
+
+/**
+ * @brief compares two paths for qsort
+ */
+static int comparePaths(const void *path1, const void *path2)
+{
+    return strcmp(*(char *const *)path1, *(char *const *)path2);
+}
+
+/**
+ * @brief checks whether two files have the same content
+ *
+ * Compares the sizes first and the mapped contents only if they are equal
+ *
+ * @param path1 the first file
+ * @param path2 the second file
+ * @return int 1 if the files are identical, 0 if they arent (or cant be mapped)
+ */
+static int sameContent(const char *path1, const char *path2)
+{
+    int fd1 = open(path1, O_RDONLY);
+    int fd2 = open(path2, O_RDONLY);
+    struct stat info1;
+    struct stat info2;
+    int same = 0;
+    if (fd1 != -1 && fd2 != -1 && fstat(fd1, &info1) == 0 && fstat(fd2, &info2) == 0 &&
+        info1.st_size == info2.st_size)
+    {
+        size_t size = info1.st_size;
+        if (size == 0)
+        {
+            same = 1;
+        }
+        else
+        {
+            void *data1 = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd1, 0);
+            void *data2 = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd2, 0);
+            same = data1 != MAP_FAILED && data2 != MAP_FAILED && memcmp(data1, data2, size) == 0;
+            if (data1 != MAP_FAILED)
+            {
+                munmap(data1, size);
+            }
+            if (data2 != MAP_FAILED)
+            {
+                munmap(data2, size);
+            }
+        }
+    }
+    if (fd1 != -1)
+    {
+        close(fd1);
+    }
+    if (fd2 != -1)
+    {
+        close(fd2);
+    }
+    return same;
+}
+
+/**
+ * @brief diffs a pair of files into a buffer
+ *
+ * @param pair the pair, the result is stored in it
+ * @param caseSensitive whether lines are compared case sensitive or not
+ * @param context the number of unchanged lines around each change
+ */
+static void diffPair(Pair *pair, int caseSensitive, size_t context)
+{
+    pair->status = 0;
+    if (sameContent(pair->path1, pair->path2))
+    {
+        return;
+    }
+
+    FileLines file1;
+    FileLines file2;
+    DiffResult result;
+    if (loadLines(pair->path1, caseSensitive, &file1) == -1)
+    {
+        pair->status = -1;
+        pair->error = errno;
+        return;
+    }
+    if (loadLines(pair->path2, caseSensitive, &file2) == -1)
+    {
+        pair->status = -1;
+        pair->error = errno;
+        freeLines(&file1);
+        return;
+    }
+    if (diffLines(&file1, &file2, caseSensitive, &result) == -1)
+    {
+        pair->status = -1;
+        pair->error = errno;
+        freeLines(&file1);
+        freeLines(&file2);
+        return;
+    }
+
+    FILE *buffer = open_memstream(&pair->text, &pair->length);
+    int hunks = buffer == NULL ? -1 : printUnified(buffer, pair->path1, pair->path2, &file1, &file2, &result, context);
+    if (buffer == NULL || fclose(buffer) == EOF || hunks == -1)
+    {
+        pair->status = -1;
+        pair->error = errno;
+    }
+    else
+    {
+        // with -i the files can differ but have no different lines
+        pair->status = hunks > 0 ? 1 : 0;
+    }
+
+    freeDiff(&result);
+    freeLines(&file1);
+    freeLines(&file2);
+}
+
+/**
+ * @brief the function of every thread
+ *
+ * Takes the next pair until all pairs are taken
+ *
+ * @param argument the pool
+ * @return void* NULL
+ */
+static void *work(void *argument)
+{
+    Pool *pool = argument;
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->next < pool->count)
+    {
+        Pair *pair = &pool->pairs[pool->next++];
+        pthread_mutex_unlock(&pool->mutex);
+
+        diffPair(pair, pool->caseSensitive, pool->context);
+
+        pthread_mutex_lock(&pool->mutex);
+        pair->done = 1;
+        pthread_cond_broadcast(&pool->finished);
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+/**
+ * @brief prints that a file only exists in one tree
+ *
+ * @param output the stream to print to
+ * @param root the root of the tree with the file
+ * @param relative the path of the file relative to the root
+ * @return int 0 on success, -1 if printing failed
+ */
+static int printOnlyIn(FILE *output, const char *root, const char *relative)
+{
+    const char *name = strrchr(relative, '/');
+    int printed;
+    if (name == NULL)
+    {
+        printed = fprintf(output, "Only in %s: %s\n", root, relative);
+    }
+    else
+    {
+        printed = fprintf(output, "Only in %s/%.*s: %s\n", root, (int)(name - relative), relative, name + 1);
+    }
+    return printed < 0 ? -1 : 0;
+}
+
+int diffTrees(FILE *output, const char *directory1, const char *directory2, int caseSensitive, size_t context,
+              int threads)
+{
+    FileList list1 = {NULL, 0, 0};
+    FileList list2 = {NULL, 0, 0};
+    if (collectFiles(directory1, "", &list1) == -1 || collectFiles(directory2, "", &list2) == -1)
+    {
+        int error = errno;
+        freeFileList(&list1);
+        freeFileList(&list2);
+        errno = error;
+        return -1;
+    }
+    qsort(list1.paths, list1.count, sizeof(char *), comparePaths);
+    qsort(list2.paths, list2.count, sizeof(char *), comparePaths);
+
+    // pair the files with the same relative path
+    Pool pool = {calloc(list1.count + 1, sizeof(Pair)), 0, 0, caseSensitive, context};
+    if (pool.pairs == NULL)
+    {
+        freeFileList(&list1);
+        freeFileList(&list2);
+        return -1;
+    }
+    int result = 0;
+    for (size_t i = 0, j = 0; result == 0 && i < list1.count && j < list2.count;)
+    {
+        int compare = strcmp(list1.paths[i], list2.paths[j]);
+        if (compare < 0)
+        {
+            i++;
+        }
+        else if (compare > 0)
+        {
+            j++;
+        }
+        else
+        {
+            Pair *pair = &pool.pairs[pool.count++];
+            pair->path1 = joinPath(directory1, list1.paths[i++]);
+            pair->path2 = joinPath(directory2, list2.paths[j++]);
+            if (pair->path1 == NULL || pair->path2 == NULL)
+            {
+                result = -1;
+            }
+        }
+    }
+
+    pthread_t *workers = malloc(sizeof(pthread_t) * threads);
+    int started = 0;
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.finished, NULL);
+    while (result == 0 && workers != NULL && started < threads &&
+           pthread_create(&workers[started], NULL, work, &pool) == 0)
+    {
+        started++;
+    }
+    if (started == 0)
+    {
+        result = -1;
+    }
+
+    // print everything in the order of the paths
+    int error = 0;
+    size_t next = 0;
+    for (size_t i = 0, j = 0; result != -1 && (i < list1.count || j < list2.count);)
+    {
+        int compare = i == list1.count ? 1 : j == list2.count ? -1 : strcmp(list1.paths[i], list2.paths[j]);
+        if (compare < 0)
+        {
+            result = printOnlyIn(output, directory1, list1.paths[i++]) == -1 ? -1 : result + 1;
+            continue;
+        }
+        if (compare > 0)
+        {
+            result = printOnlyIn(output, directory2, list2.paths[j++]) == -1 ? -1 : result + 1;
+            continue;
+        }
+        i++;
+        j++;
+
+        Pair *pair = &pool.pairs[next++];
+        pthread_mutex_lock(&pool.mutex);
+        while (!pair->done)
+        {
+            pthread_cond_wait(&pool.finished, &pool.mutex);
+        }
+        pthread_mutex_unlock(&pool.mutex);
+
+        if (pair->status == -1)
+        {
+            error = pair->error;
+            result = -1;
+        }
+        else if (pair->status == 1)
+        {
+            result = fwrite(pair->text, 1, pair->length, output) == pair->length ? result + 1 : -1;
+        }
+    }
+    if (result == -1 && error == 0)
+    {
+        error = errno;
+    }
+
+    // the remaining pairs arent needed anymore if something failed
+    pthread_mutex_lock(&pool.mutex);
+    pool.next = pool.count;
+    pthread_mutex_unlock(&pool.mutex);
+    for (int i = 0; i < started; i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+    pthread_mutex_destroy(&pool.mutex);
+    pthread_cond_destroy(&pool.finished);
+
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        free(pool.pairs[i].path1);
+        free(pool.pairs[i].path2);
+        free(pool.pairs[i].text);
+    }
+    free(pool.pairs);
+    free(workers);
+    freeFileList(&list1);
+    freeFileList(&list2);
+    if (result == -1)
+    {
+        errno = error == 0 ? ENOMEM : error;
+    }
+    return result;
+}
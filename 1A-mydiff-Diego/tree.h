@@ -0,0 +1,29 @@
+#ifndef TREE_H
+#define TREE_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * @brief compares two directory trees
+ *
+ * Walks both directories recursively and pairs the regular files by their
+ * relative path. Pairs with the same size and content are skipped, all other
+ * pairs are diffed (unified, like diff -ru) on a pool of threads. The output
+ * is printed in the sorted order of the paths, no matter which thread
+ * finishes first. Files which only exist in one tree are named with
+ * "Only in dir: path".
+ *
+ * @param output the stream to print to
+ * @param directory1 the first directory
+ * @param directory2 the second directory
+ * @param caseSensitive whether lines are compared case sensitive or not
+ * @param context the number of unchanged lines around each change
+ * @param threads the number of threads which diff the files
+ * @return int the number of files which differ or exist in one tree only, -1 on
+ * failure (errno is set)
+ */
+int diffTrees(FILE *output, const char *directory1, const char *directory2, int caseSensitive, size_t context,
+              int threads);
+
+#endif
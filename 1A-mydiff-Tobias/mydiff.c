@@ -15,6 +15,11 @@
  * [-i] to specify a case-insensitive comparison
  * [-o path] to specify that the output should be written to the specified file instead of stdout.
  * If this file does not exist it will be created.
+ * [-r] to specify that the two paths are directories, whose files are compared pairwise by their relative paths
+ * (in sorted order, files with the same content are skipped without comparing their lines)
+ * [-j threads] to specify the number of threads comparing the files in [-r] mode (default: number of CPUs).
+ * Regular files are memory-mapped and compared 16 bytes at a time (with the case folded in the registers
+ * for [-i]); other files (e.g. pipes) are read character by character.
  **/
  // Because of the simplicity of the Task, it was decided, that the program didn't need to be split into multiple files.
 
@@ -23,9 +28,21 @@
 #include <stdlib.h>
 #include <memory.h>
 #include <errno.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <pthread.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #define NUMBER_OF_ARGUMENTS 2
 
+#define MAX_THREADS 1024
+
+#define NFTW_MAX_OPEN_DIRECTORIES 32
+
 
 /** Convenience type to emulate a boolean value. */
 typedef enum {
@@ -33,18 +50,55 @@ typedef enum {
     true = 1
 } bool;
 
+/** A file which exists in both directory trees. */
+typedef struct {
+    char *path1;
+    char *path2;
+    char *differences;       // the printed differences (NULL if there are none)
+    size_t differencesSize;
+    bool done;
+} FilePair;
+
+/** The file pairs which are compared by the threads. */
+typedef struct {
+    FilePair *pairs;
+    size_t count;
+    size_t next;             // the next pair which is not compared by any thread yet
+    bool caseInsensitive;
+    pthread_mutex_t mutex;
+    pthread_cond_t pairDone;
+} PairPool;
+
 /** The program name as specified in argumentValues[0] */
 static char *programName_g;
 
+/** The relative paths of the regular files found by nftw(3) (which does not pass a user argument) */
+static char **foundPaths_g;
+static size_t foundPathsCount_g;
+static size_t foundPathsCapacity_g;
+static size_t rootLength_g;
+
 
 static void tryParseArguments(int argumentCounter, char *argumentValues[],
                               char **inputPath1_out, char **inputPath2_out, char **outputPath_out,
-                              bool *caseInsensitive_out);
+                              bool *caseInsensitive_out, bool *recursive_out, int *threads_out);
 
 static void tryOpenFiles(const char *inputPath1, const char *inputPath2, const char *outputPath,
                          FILE **input1_out, FILE **input2_out, FILE **output_out);
 
-static void tryPrintDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output);
+static void tryOpenOutputFile(const char *outputPath, FILE **output_out);
+
+static int tryPrintFileDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output);
+
+static int tryPrintTreeDifferences(const char *directory1, const char *directory2, bool caseInsensitive,
+                                   int threads, FILE *output);
+
+static bool tryMapFile(FILE *file, const char **data_out, size_t *size_out);
+
+static int tryPrintDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output);
+
+static int tryPrintMappedDifferences(const char *data1, size_t size1, const char *data2, size_t size2,
+                                     bool caseInsensitive, FILE *output);
 
 
 
@@ -66,20 +120,34 @@ int main(int argumentCounter, char *argumentValues[])
     programName_g = argumentValues[0];
 
     bool caseInsensitive;
+    bool recursive;
+    int threads;
     char *inputPath1 = NULL;
     char *inputPath2 = NULL;
     char *outputPath = NULL;
-    tryParseArguments(argumentCounter, argumentValues, &inputPath1, &inputPath2, &outputPath, &caseInsensitive);
+    tryParseArguments(argumentCounter, argumentValues, &inputPath1, &inputPath2, &outputPath,
+                      &caseInsensitive, &recursive, &threads);
 
-    FILE *input1 = NULL;
-    FILE *input2 = NULL;
     FILE *output = NULL;
-    tryOpenFiles(inputPath1, inputPath2, outputPath, &input1, &input2, &output);
+    int differences;
+    if (recursive)
+    {
+        tryOpenOutputFile(outputPath, &output);
+        differences = tryPrintTreeDifferences(inputPath1, inputPath2, caseInsensitive, threads, output);
+    }
+    else
+    {
+        FILE *input1 = NULL;
+        FILE *input2 = NULL;
+        tryOpenFiles(inputPath1, inputPath2, outputPath, &input1, &input2, &output);
+        differences = tryPrintFileDifferences(input1, input2, caseInsensitive, output);
+        fclose(input1);
+        fclose(input2);
+    }
 
-    tryPrintDifferences(input1, input2, caseInsensitive, output);
+    if (differences == 0)
+        fprintf(output, "No differences found!");
 
-    fclose(input1);
-    fclose(input2);
     fclose(output);
     return EXIT_SUCCESS;
 }
@@ -93,7 +161,7 @@ int main(int argumentCounter, char *argumentValues[])
  */
 static inline void printUsageErrorAndTerminate(const char *message)
 {
-    fprintf(stderr,"%s\nUSAGE: %s [-i] [-o outfile] file1 file2", message, programName_g);
+    fprintf(stderr,"%s\nUSAGE: %s [-i] [-r [-j threads]] [-o outfile] file1 file2", message, programName_g);
     exit(EXIT_FAILURE);
 }
 
@@ -126,20 +194,38 @@ static inline void printErrnoAndTerminate(const char *additionalMessage)
  * (or NULL for default output) after the function terminates.
  * @param caseInsensitive_out Contains a pointer to a bool enum indicating weather the comparison should
  * be done case insensitive or not after the function terminates.
+ * @param recursive_out Contains a pointer to a bool enum indicating weather the input paths are directories
+ * after the function terminates.
+ * @param threads_out Contains a pointer to the number of threads for comparing directories
+ * after the function terminates.
  */
 static void tryParseArguments(int argumentCounter, char *argumentValues[],
                               char **inputPath1_out, char **inputPath2_out, char **outputPath_out,
-                              bool *caseInsensitive_out)
+                              bool *caseInsensitive_out, bool *recursive_out, int *threads_out)
 {
     *caseInsensitive_out = false;
+    *recursive_out = false;
+    long processors = sysconf(_SC_NPROCESSORS_ONLN);
+    *threads_out = processors < 1 ? 1 : processors > MAX_THREADS ? MAX_THREADS : (int) processors;
 
     int opt;
-    while((opt = getopt(argumentCounter, argumentValues, "io:")) != -1)
+    char *end;
+    long threads;
+    while((opt = getopt(argumentCounter, argumentValues, "irj:o:")) != -1)
     {
         switch(opt)
         {
             case 'o': *outputPath_out      = optarg; break;
             case 'i': *caseInsensitive_out = true;   break;
+            case 'r': *recursive_out       = true;   break;
+
+            case 'j':
+                errno = 0;
+                threads = strtol(optarg, &end, 10);
+                if (errno != 0 || end == optarg || *end != '\0' || threads < 1 || threads > MAX_THREADS)
+                    printUsageErrorAndTerminate("Invalid number of threads");
+                *threads_out = (int) threads;
+                break;
 
             case '?': printUsageErrorAndTerminate("One or more invalid options");
             default:  printUsageErrorAndTerminate("Unknown option returned by getopt(3)");
@@ -177,6 +263,21 @@ static void tryOpenFiles(const char *inputPath1, const char *inputPath2, const c
     if (*input1_out == NULL || *input2_out == NULL)
         printErrnoAndTerminate("Opening input files failed");
 
+    tryOpenOutputFile(outputPath, output_out);
+}
+
+/**
+ * @brief Tries to open the output file if one is configured.
+ *
+ * @details If the output file does not exist it will be created.
+ * Terminates the program with EXIT_FAILURE if opening (or creating) the file fails.
+
+ * @param outputPath The path of the file to write the output into (or NULL for output over stdout).
+ * @param output_out Contains a pointer to the (in write mode) opened output file (or stdout if outputPath was NULL)
+ * after the function terminates.
+ */
+static void tryOpenOutputFile(const char *outputPath, FILE **output_out)
+{
     if (outputPath != NULL)
     {
         *output_out = fopen(outputPath, "w");
@@ -187,6 +288,38 @@ static void tryOpenFiles(const char *inputPath1, const char *inputPath2, const c
         *output_out = stdout;
 }
 
+/**
+ * @brief Compares the given files and prints the differing lines one by one.
+ *
+ * @details Memory-maps both files if possible and compares them with tryPrintMappedDifferences(),
+ * otherwise they are read with tryPrintDifferences().
+ *
+ * @param input1          The first file to compare.
+ * @param input2          The second file to compare.
+ * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
+ * @param output          The file the result is to be printed to (can also be stdout).
+ *
+ * @return The number of differing lines.
+ */
+static int tryPrintFileDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output)
+{
+    const char *data1 = NULL;
+    const char *data2 = NULL;
+    size_t size1 = 0;
+    size_t size2 = 0;
+    int differingLines;
+    if (tryMapFile(input1, &data1, &size1) && tryMapFile(input2, &data2, &size2))
+        differingLines = tryPrintMappedDifferences(data1, size1, data2, size2, caseInsensitive, output);
+    else
+        differingLines = tryPrintDifferences(input1, input2, caseInsensitive, output);
+
+    if (data1 != NULL)
+        munmap((void *) data1, size1);
+    if (data2 != NULL)
+        munmap((void *) data2, size2);
+    return differingLines;
+}
+
 
 /**
  * @brief Checks if the given parameter is EOF or '\n'.
@@ -213,32 +346,55 @@ static inline bool isAnyNewLineOrEof(int c1, int c2)
  * @brief Takes an opened File, moves the current file position to the next line
  *        and returns the first character of that line.
  *
- * @param file The already opened file in question
+ * @param file        The already opened file in question
+ * @param currentChar The last character read from the file (it may already be the end of the line)
  *
  * @return The first character of the next line
  */
-static int moveToFirstCharOfNextLine(FILE *file) {
-    while (!isNewLineOrEof(fgetc(file)));
-    return fgetc(file);
+static int moveToFirstCharOfNextLine(FILE *file, int currentChar) {
+    while (!isNewLineOrEof(currentChar))
+        currentChar = fgetc(file);
+    return currentChar == EOF ? EOF : fgetc(file);
 }
 
 /**
- * @brief Compares the given files and prints the differing lines one by one ("No differences found!" if there are none).
+ * @brief Prints the number of differences of a line, if there are any.
+ * @details Terminates the program with EXIT_FAILURE if printing fails.
+ *
+ * @param output                    The file the result is to be printed to (can also be stdout).
+ * @param line                      The number of the line.
+ * @param numberOfDifferencesInLine The number of differing characters in the line.
+ *
+ * @return Returns true if the line differs, false otherwise.
+ */
+static bool tryPrintLineDifferences(FILE *output, int line, int numberOfDifferencesInLine)
+{
+    if (numberOfDifferencesInLine == 0)
+        return false;
+
+    if (fprintf(output, "Line: %i, differing characters: %i\n", line, numberOfDifferencesInLine) < 0)
+        printErrnoAndTerminate("Printing differences failed");
+    return true;
+}
+
+/**
+ * @brief Compares the given files and prints the differing lines one by one.
  *
  * @details This function compares the two given files line by line until one of the files ends.
  * Each line is only compared until one of the lines from each file ends (so 'a\n' is equal to 'ab\n').
  * If two lines differ, the line number and the number of differences is printed immediately.
- * If the files are equal in terms of the described algorithm, "No differences found!" is printed instead.
  * In case of an error while printing out a differing line, the program terminates with EXIT_FAILURE.
  *
  * @param input1          The first file to compare.
  * @param input2          The second file to compare.
  * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
  * @param output          The file the result is to be printed to (can also be stdout).
+ *
+ * @return The number of differing lines.
  */
 // An approach using fgetc was chosen over one using fgets to avoid having to use dynamic memory allocation
 // as it is a source of many possible mistakes and would make the code arguably more complicated
-static void tryPrintDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output)
+static int tryPrintDifferences(FILE *input1, FILE *input2, bool caseInsensitive, FILE *output)
 {
     int (*comparer)(const char*, const char*) = caseInsensitive ? &strcasecmp : &strcmp;
 
@@ -261,17 +417,490 @@ static void tryPrintDifferences(FILE *input1, FILE *input2, bool caseInsensitive
             currCharFile2 = fgetc(input2);
         }
 
-        if (numberOfDifferencesInLine != 0)
+        if (tryPrintLineDifferences(output, line, numberOfDifferencesInLine))
+            differingLines++;
+
+        currCharFile1 = moveToFirstCharOfNextLine(input1, currCharFile1);
+        currCharFile2 = moveToFirstCharOfNextLine(input2, currCharFile2);
+    }
+
+    return differingLines;
+}
+
+
+/**
+ * @brief Maps an opened input file into memory.
+ * @details Only regular files are mapped, for all other files (or if mmap(2) fails) false is returned
+ * and the file has to be read with stdio instead. An empty file is 'mapped' with data_out set to NULL.
+ *
+ * @param file     The already opened file in question.
+ * @param data_out Contains a pointer to the mapped content of the file after the function terminates.
+ * @param size_out Contains the size of the file after the function terminates.
+ *
+ * @return Returns true if the file was mapped, false otherwise.
+ */
+static bool tryMapFile(FILE *file, const char **data_out, size_t *size_out)
+{
+    struct stat info;
+    if (fstat(fileno(file), &info) == -1 || !S_ISREG(info.st_mode))
+        return false;
+
+    *size_out = info.st_size;
+    if (*size_out == 0)
+        return true;
+
+    void *data = mmap(NULL, *size_out, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (data == MAP_FAILED)
+        return false;
+
+    madvise(data, *size_out, MADV_SEQUENTIAL);
+    *data_out = data;
+    return true;
+}
+
+/**
+ * @brief Folds an ASCII character to lower case (like strcasecmp(3) in the C locale).
+ *
+ * @param character The character to fold.
+ */
+static inline unsigned char toLowerAscii(unsigned char character)
+{
+    return (character >= 'A' && character <= 'Z') ? character | 0x20 : character;
+}
+
+/**
+ * @brief Checks if the given character ends the compared part of a line ('\n' or '\r').
+ *
+ * @param character The character to check.
+ */
+static inline bool isLineEnd(char character)
+{
+    return character == '\n' || character == '\r';
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Folds all ASCII upper case letters of the vector to lower case.
+ *
+ * @param bytes The 16 characters to fold.
+ */
+static inline __m128i toLowerAsciiVector(__m128i bytes)
+{
+    // the compare is signed, so bytes >= 0x80 are never in the range
+    __m128i isUpper = _mm_and_si128(_mm_cmpgt_epi8(bytes, _mm_set1_epi8('A' - 1)),
+                                    _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), bytes));
+    return _mm_or_si128(bytes, _mm_and_si128(isUpper, _mm_set1_epi8(0x20)));
+}
+
+/**
+ * @brief Returns a bit mask of the positions of '\n' and '\r' in the vector.
+ *
+ * @param bytes The 16 characters to check.
+ */
+static inline int lineEndMask(__m128i bytes)
+{
+    return _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n')),
+                                          _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\r'))));
+}
+#endif
+
+/**
+ * @brief Counts the differing characters of two lines until one of them ends.
+ * @details Compares 16 characters at once while at least 16 characters of both lines are left
+ * and moves both positions to the first character which was not compared (the end of one of the lines).
+ *
+ * @param pos1            Contains the position in the first file, which is moved forward.
+ * @param end1            The end of the first file.
+ * @param pos2            Contains the position in the second file, which is moved forward.
+ * @param end2            The end of the second file.
+ * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
+ *
+ * @return The number of differing characters.
+ */
+static int countDifferencesInLine(const char **pos1, const char *end1, const char **pos2, const char *end2,
+                                  bool caseInsensitive)
+{
+    const char *p1 = *pos1;
+    const char *p2 = *pos2;
+    int numberOfDifferences = 0;
+
+#ifdef __SSE2__
+    while (end1 - p1 >= 16 && end2 - p2 >= 16)
+    {
+        __m128i bytes1 = _mm_loadu_si128((const __m128i *) p1);
+        __m128i bytes2 = _mm_loadu_si128((const __m128i *) p2);
+        unsigned int lineEnds = lineEndMask(bytes1) | lineEndMask(bytes2);
+        if (caseInsensitive)
         {
+            bytes1 = toLowerAsciiVector(bytes1);
+            bytes2 = toLowerAsciiVector(bytes2);
+        }
+        unsigned int differences = ~_mm_movemask_epi8(_mm_cmpeq_epi8(bytes1, bytes2)) & 0xFFFF;
+
+        if (lineEnds != 0)
+        {
+            int length = __builtin_ctz(lineEnds);
+            numberOfDifferences += __builtin_popcount(differences & ((1u << length) - 1));
+            *pos1 = p1 + length;
+            *pos2 = p2 + length;
+            return numberOfDifferences;
+        }
+        numberOfDifferences += __builtin_popcount(differences);
+        p1 += 16;
+        p2 += 16;
+    }
+#endif
+
+    for (; p1 < end1 && p2 < end2 && !isLineEnd(*p1) && !isLineEnd(*p2); p1++, p2++)
+    {
+        unsigned char c1 = *p1;
+        unsigned char c2 = *p2;
+        if (caseInsensitive ? toLowerAscii(c1) != toLowerAscii(c2) : c1 != c2)
+            numberOfDifferences++;
+    }
+
+    *pos1 = p1;
+    *pos2 = p2;
+    return numberOfDifferences;
+}
+
+/**
+ * @brief Returns the first character of the line after the given position (or end if there is none).
+ *
+ * @param pos The position in the file.
+ * @param end The end of the file.
+ */
+static inline const char *skipToNextLine(const char *pos, const char *end)
+{
+    const char *newLine = memchr(pos, '\n', end - pos);
+    return newLine == NULL ? end : newLine + 1;
+}
+
+/**
+ * @brief Compares the given mapped files and prints the differing lines one by one.
+ *
+ * @details Does the same comparison as tryPrintDifferences() on memory-mapped files.
+ * In case of an error while printing out a differing line, the program terminates with EXIT_FAILURE.
+ *
+ * @param data1           The content of the first file (NULL if it is empty).
+ * @param size1           The size of the first file.
+ * @param data2           The content of the second file (NULL if it is empty).
+ * @param size2           The size of the second file.
+ * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
+ * @param output          The file the result is to be printed to (can also be stdout).
+ *
+ * @return The number of differing lines.
+ */
+static int tryPrintMappedDifferences(const char *data1, size_t size1, const char *data2, size_t size2,
+                                     bool caseInsensitive, FILE *output)
+{
+    const char *pos1 = data1;
+    const char *pos2 = data2;
+    const char *end1 = data1 + size1;
+    const char *end2 = data2 + size2;
+
+    int differingLines = 0;
+
+    for (int line = 1; pos1 < end1 && pos2 < end2; line++)
+    {
+        int numberOfDifferencesInLine = countDifferencesInLine(&pos1, end1, &pos2, end2, caseInsensitive);
+        if (tryPrintLineDifferences(output, line, numberOfDifferencesInLine))
             differingLines++;
-            if (fprintf(output, "Line: %i, differing characters: %i\n", line, numberOfDifferencesInLine) < 0)
-                printErrnoAndTerminate("Printing differences failed");
+
+        pos1 = skipToNextLine(pos1, end1);
+        pos2 = skipToNextLine(pos2, end2);
+    }
+
+    return differingLines;
+}
+
+
+/**
+ * @brief Adds a regular file found by nftw(3) to foundPaths_g.
+ * @details Terminates the program with EXIT_FAILURE if there is not enough memory.
+ *
+ * global variables used: foundPaths_g, foundPathsCount_g, foundPathsCapacity_g - The found files
+ *                        rootLength_g - The length of the path of the walked directory
+ *
+ * @param path The path of the file.
+ * @param info The status of the file.
+ * @param type The type of the file given by nftw(3).
+ * @param ftw  The position of the file in the tree.
+ *
+ * @return Always 0 to continue walking.
+ */
+static int addRegularFile(const char *path, const struct stat *info, int type, struct FTW *ftw)
+{
+    if (type != FTW_F || !S_ISREG(info->st_mode))
+        return 0;
+
+    if (foundPathsCount_g == foundPathsCapacity_g)
+    {
+        foundPathsCapacity_g = foundPathsCapacity_g == 0 ? 64 : foundPathsCapacity_g * 2;
+        foundPaths_g = realloc(foundPaths_g, foundPathsCapacity_g * sizeof(char *));
+        if (foundPaths_g == NULL)
+            printErrnoAndTerminate("Collecting files failed");
+    }
+
+    const char *relativePath = path + rootLength_g;
+    while (*relativePath == '/')
+        relativePath++;
+
+    if ((foundPaths_g[foundPathsCount_g++] = strdup(relativePath)) == NULL)
+        printErrnoAndTerminate("Collecting files failed");
+    return 0;
+}
+
+/**
+ * @brief Compares two strings given as pointers to them (for qsort(3)).
+ */
+static int comparePaths(const void *path1, const void *path2)
+{
+    return strcmp(*(char * const *) path1, *(char * const *) path2);
+}
+
+/**
+ * @brief Collects the sorted relative paths of all regular files in a directory tree.
+ * @details Terminates the program with EXIT_FAILURE if walking the directory fails.
+ *
+ * @param directory The directory to walk recursively.
+ * @param paths_out Contains the allocated array of allocated paths after the function terminates.
+ * @param count_out Contains the number of paths after the function terminates.
+ */
+static void tryCollectFiles(const char *directory, char ***paths_out, size_t *count_out)
+{
+    foundPaths_g = NULL;
+    foundPathsCount_g = 0;
+    foundPathsCapacity_g = 0;
+    rootLength_g = strlen(directory);
+
+    if (nftw(directory, addRegularFile, NFTW_MAX_OPEN_DIRECTORIES, 0) == -1)
+        printErrnoAndTerminate("Walking directory failed");
+
+    qsort(foundPaths_g, foundPathsCount_g, sizeof(char *), comparePaths);
+    *paths_out = foundPaths_g;
+    *count_out = foundPathsCount_g;
+}
+
+/**
+ * @brief Checks if two mapped files have exactly the same content.
+ *
+ * @param data1 The content of the first file (NULL if it is empty).
+ * @param size1 The size of the first file.
+ * @param data2 The content of the second file (NULL if it is empty).
+ * @param size2 The size of the second file.
+ */
+static inline bool isSameContent(const char *data1, size_t size1, const char *data2, size_t size2)
+{
+    return size1 == size2 && (size1 == 0 || memcmp(data1, data2, size1) == 0);
+}
+
+/**
+ * @brief Compares the files of a pair and stores the printed differences in the pair.
+ * @details Files with the same size and content are skipped without comparing their lines.
+ * Terminates the program with EXIT_FAILURE if opening a file or printing to memory fails.
+ *
+ * @param pair            The pair to compare.
+ * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
+ */
+static void tryComparePair(FilePair *pair, bool caseInsensitive)
+{
+    FILE *input1 = fopen(pair->path1, "r");
+    FILE *input2 = fopen(pair->path2, "r");
+    if (input1 == NULL || input2 == NULL)
+        printErrnoAndTerminate("Opening input files failed");
+
+    const char *data1 = NULL;
+    const char *data2 = NULL;
+    size_t size1 = 0;
+    size_t size2 = 0;
+    bool mapped = tryMapFile(input1, &data1, &size1) && tryMapFile(input2, &data2, &size2);
+
+    if (!mapped || !isSameContent(data1, size1, data2, size2))
+    {
+        FILE *differences = open_memstream(&pair->differences, &pair->differencesSize);
+        if (differences == NULL)
+            printErrnoAndTerminate("Opening memory stream failed");
+
+        int differingLines = mapped ? tryPrintMappedDifferences(data1, size1, data2, size2, caseInsensitive, differences)
+                                    : tryPrintDifferences(input1, input2, caseInsensitive, differences);
+        if (fclose(differences) == EOF)
+            printErrnoAndTerminate("Printing differences failed");
+
+        if (differingLines == 0)
+        {
+            free(pair->differences);
+            pair->differences = NULL;
         }
+    }
+
+    if (data1 != NULL)
+        munmap((void *) data1, size1);
+    if (data2 != NULL)
+        munmap((void *) data2, size2);
+    fclose(input1);
+    fclose(input2);
+}
+
+/**
+ * @brief The function of each thread, which compares the next pair until all pairs are taken.
+ *
+ * @param argument The PairPool.
+ *
+ * @return Always NULL.
+ */
+static void *comparePairs(void *argument)
+{
+    PairPool *pool = argument;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (pool->next < pool->count)
+    {
+        FilePair *pair = &pool->pairs[pool->next++];
+        pthread_mutex_unlock(&pool->mutex);
 
-        currCharFile1 = moveToFirstCharOfNextLine(input1);
-        currCharFile2 = moveToFirstCharOfNextLine(input2);
+        tryComparePair(pair, pool->caseInsensitive);
+
+        pthread_mutex_lock(&pool->mutex);
+        pair->done = true;
+        pthread_cond_broadcast(&pool->pairDone);
     }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
 
-    if (differingLines == 0)
-        fprintf(output, "No differences found!");
+/**
+ * @brief Joins a directory and a relative path.
+ * @details Terminates the program with EXIT_FAILURE if there is not enough memory.
+ *
+ * @param directory    The directory.
+ * @param relativePath The path relative to the directory.
+ *
+ * @return The allocated path.
+ */
+static char *tryJoinPath(const char *directory, const char *relativePath)
+{
+    char *path = malloc(strlen(directory) + strlen(relativePath) + 2);
+    if (path == NULL)
+        printErrnoAndTerminate("Joining paths failed");
+
+    sprintf(path, "%s/%s", directory, relativePath);
+    return path;
+}
+
+/**
+ * @brief Compares the files of two directory trees and prints the differing lines of each pair of files.
+ *
+ * @details Files are paired by their path relative to the given directories, the pairs are compared by
+ * the given number of threads. The output is printed in the sorted order of the paths: a line
+ * "diff path1 path2" followed by the differing lines for each pair which differs,
+ * "Only in directory: path" for each file which only exists in one of the trees.
+ * In case of an error, the program terminates with EXIT_FAILURE.
+ *
+ * @param directory1      The first directory to compare.
+ * @param directory2      The second directory to compare.
+ * @param caseInsensitive Indicates weather or not the comparison should be case insensitive.
+ * @param threads         The number of threads comparing the files.
+ * @param output          The file the result is to be printed to (can also be stdout).
+ *
+ * @return The number of differing pairs and files which only exist in one tree.
+ */
+static int tryPrintTreeDifferences(const char *directory1, const char *directory2, bool caseInsensitive,
+                                   int threads, FILE *output)
+{
+    char **paths1;
+    char **paths2;
+    size_t count1;
+    size_t count2;
+    tryCollectFiles(directory1, &paths1, &count1);
+    tryCollectFiles(directory2, &paths2, &count2);
+
+    PairPool pool = { .pairs = calloc(count1 + 1, sizeof(FilePair)), .caseInsensitive = caseInsensitive };
+    if (pool.pairs == NULL)
+        printErrnoAndTerminate("Allocating file pairs failed");
+
+    for (size_t i = 0, j = 0; i < count1 && j < count2;)
+    {
+        int comparison = strcmp(paths1[i], paths2[j]);
+        if (comparison == 0)
+        {
+            pool.pairs[pool.count].path1 = tryJoinPath(directory1, paths1[i++]);
+            pool.pairs[pool.count].path2 = tryJoinPath(directory2, paths2[j++]);
+            pool.count++;
+        }
+        else if (comparison < 0)
+            i++;
+        else
+            j++;
+    }
+
+    pthread_t workers[MAX_THREADS];
+    pthread_mutex_init(&pool.mutex, NULL);
+    pthread_cond_init(&pool.pairDone, NULL);
+    for (int i = 0; i < threads; i++)
+    {
+        if ((errno = pthread_create(&workers[i], NULL, comparePairs, &pool)) != 0)
+            printErrnoAndTerminate("Creating thread failed");
+    }
+
+    // print everything in the order of the paths while the threads are still comparing
+    int differences = 0;
+    size_t nextPair = 0;
+    for (size_t i = 0, j = 0; i < count1 || j < count2;)
+    {
+        int comparison = i == count1 ? 1 : j == count2 ? -1 : strcmp(paths1[i], paths2[j]);
+        int printed = 0;
+        if (comparison < 0)
+        {
+            printed = fprintf(output, "Only in %s: %s\n", directory1, paths1[i++]);
+            differences++;
+        }
+        else if (comparison > 0)
+        {
+            printed = fprintf(output, "Only in %s: %s\n", directory2, paths2[j++]);
+            differences++;
+        }
+        else
+        {
+            i++;
+            j++;
+            FilePair *pair = &pool.pairs[nextPair++];
+
+            pthread_mutex_lock(&pool.mutex);
+            while (!pair->done)
+                pthread_cond_wait(&pool.pairDone, &pool.mutex);
+            pthread_mutex_unlock(&pool.mutex);
+
+            if (pair->differences != NULL)
+            {
+                differences++;
+                if ((printed = fprintf(output, "diff %s %s\n", pair->path1, pair->path2)) >= 0 &&
+                    fwrite(pair->differences, 1, pair->differencesSize, output) != pair->differencesSize)
+                    printed = -1;
+            }
+        }
+
+        if (printed < 0)
+            printErrnoAndTerminate("Printing differences failed");
+    }
+
+    for (int i = 0; i < threads; i++)
+        pthread_join(workers[i], NULL);
+    pthread_mutex_destroy(&pool.mutex);
+    pthread_cond_destroy(&pool.pairDone);
+
+    for (size_t i = 0; i < pool.count; i++)
+    {
+        free(pool.pairs[i].path1);
+        free(pool.pairs[i].path2);
+        free(pool.pairs[i].differences);
+    }
+    free(pool.pairs);
+    for (size_t i = 0; i < count1; i++)
+        free(paths1[i]);
+    for (size_t i = 0; i < count2; i++)
+        free(paths2[i]);
+    free(paths1);
+    free(paths2);
+    return differences;
 }
@@ -0,0 +1,812 @@
+/**
+ * @file index.c
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Trigram index over a static set of files
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+
+#define EMPTY_SLOT UINT32_MAX /**< Trigrams only have 24 bits, so this marks an unused slot. **/
+
+/**
+ * @brief The header of an index file
+ */
+typedef struct
+{
+	char magic[4];
+	uint32_t block_size;
+	uint64_t file_count;
+	uint64_t block_count;
+	uint64_t trigram_count;
+	uint64_t postings_size;
+} index_header;
+
+/**
+ * @brief A file in an index file, followed by its path (padded to 8 bytes)
+ */
+typedef struct
+{
+	uint64_t size;
+	int64_t mtime_sec;
+	int64_t mtime_nsec;
+	uint64_t block_count;
+	uint64_t path_length;
+} index_file;
+
+/**
+ * @brief An entry of the trigram table of an index file
+ */
+typedef struct
+{
+	uint32_t trigram;
+	uint32_t count; /**< The number of blocks in the posting list **/
+	uint64_t offset; /**< The offset of the posting list **/
+} index_trigram;
+
+struct trigram_index
+{
+	void *data;
+	size_t size;
+
+	size_t file_count;
+	size_t block_count;
+	uint64_t *file_sizes;
+	size_t *first_blocks; /**< The number of the first block of every file (and the block count at the end) **/
+	const uint64_t *offsets;
+
+	const index_trigram *trigrams;
+	size_t trigram_count;
+	const unsigned char *postings;
+	size_t postings_size;
+};
+
+/**
+ * @brief The posting list of a trigram while the index is built
+ */
+typedef struct
+{
+	uint32_t trigram;
+	uint32_t count;
+	uint64_t last; /**< The last block in the list **/
+	unsigned char *bytes;
+	size_t length;
+	size_t capacity;
+} posting;
+
+/**
+ * @brief An open addressing hash table of posting lists
+ */
+typedef struct
+{
+	posting *slots;
+	size_t capacity;
+	size_t used;
+} posting_table;
+
+/**
+ * @brief Returns the lowercase equivalent of an ASCII char.
+ * @param c The char
+ * @return The folded char
+ */
+static inline unsigned char fold(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/**
+ * @brief Returns the number of bytes a path takes in an index file.
+ * @param length The length of the path
+ * @return The length rounded up to a multiple of 8
+ */
+static inline size_t padded(size_t length)
+{
+	return (length + 7) & ~(size_t) 7;
+}
+
+/**
+ * @brief Returns the slot of a trigram in the table.
+ * @param table The table
+ * @param trigram The trigram
+ * @return The slot of the trigram or the empty slot where it belongs
+ */
+static posting *find_slot(const posting_table *const table, uint32_t trigram)
+{
+	size_t slot = (trigram * 2654435761u) & (table->capacity - 1);
+	while (table->slots[slot].trigram != EMPTY_SLOT && table->slots[slot].trigram != trigram)
+	{
+		slot = (slot + 1) & (table->capacity - 1);
+	}
+
+	return &table->slots[slot];
+}
+
+/**
+ * @brief Doubles the capacity of the table.
+ * @param table The table
+ * @return 0 on success
+ * @return -1 if there is not enough memory
+ */
+static int grow_table(posting_table *const table)
+{
+	posting_table grown = {malloc(table->capacity * 2 * sizeof(posting)), table->capacity * 2, table->used};
+	if (grown.slots == NULL)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < grown.capacity; ++i)
+	{
+		grown.slots[i].trigram = EMPTY_SLOT;
+	}
+	for (size_t i = 0; i < table->capacity; ++i)
+	{
+		if (table->slots[i].trigram != EMPTY_SLOT)
+		{
+			*find_slot(&grown, table->slots[i].trigram) = table->slots[i];
+		}
+	}
+
+	free(table->slots);
+	*table = grown;
+	return 0;
+}
+
+/**
+ * @brief Adds a block to the posting list of a trigram (if it isn't the last block of the list already).
+ * @param table The table
+ * @param trigram The trigram
+ * @param block The number of the block
+ * @return 0 on success
+ * @return -1 if there is not enough memory
+ */
+static int add_posting(posting_table *const table, uint32_t trigram, uint64_t block)
+{
+	posting *list = find_slot(table, trigram);
+	if (list->trigram == EMPTY_SLOT)
+	{
+		if (table->used * 2 >= table->capacity)
+		{
+			if (grow_table(table) == -1)
+			{
+				return -1;
+			}
+			list = find_slot(table, trigram);
+		}
+
+		*list = (posting) {trigram, 0, 0, NULL, 0, 0};
+		++table->used;
+	}
+	else if (list->last == block)
+	{
+		return 0;
+	}
+
+	if (list->capacity - list->length < 10)
+	{
+		size_t capacity = list->capacity ? list->capacity * 2 : 16;
+		unsigned char *bytes = realloc(list->bytes, capacity);
+		if (bytes == NULL)
+		{
+			return -1;
+		}
+
+		list->bytes = bytes;
+		list->capacity = capacity;
+	}
+
+	uint64_t delta = block - list->last;
+	do
+	{
+		unsigned char byte = delta & 0x7F;
+		delta >>= 7;
+		list->bytes[list->length++] = delta ? byte | 0x80 : byte;
+	} while (delta);
+
+	list->last = block;
+	++list->count;
+	return 0;
+}
+
+/**
+ * @brief Splits a file into blocks and adds the trigrams of every block to the table.
+ * @param data The content of the file
+ * @param size The size of the file
+ * @param table The table
+ * @param offsets Pointer to the array of block offsets, which is grown
+ * @param block_count Pointer to the number of blocks of all files so far
+ * @param capacity Pointer to the capacity of the offsets
+ * @return 0 on success
+ * @return -1 if there is not enough memory
+ */
+static int index_file_blocks(const unsigned char *const data, size_t size, posting_table *const table,
+                             uint64_t **offsets, size_t *block_count, size_t *capacity)
+{
+	size_t pos = 0;
+	while (pos < size)
+	{
+		size_t end = size;
+		if (size - pos > INDEX_BLOCK_SIZE)
+		{
+			const unsigned char *newline = memchr(data + pos + INDEX_BLOCK_SIZE, '\n', size - pos - INDEX_BLOCK_SIZE);
+			end = newline ? (size_t) (newline - data) + 1 : size;
+		}
+
+		if (*block_count == *capacity)
+		{
+			*capacity = *capacity ? *capacity * 2 : 1024;
+			uint64_t *grown = realloc(*offsets, *capacity * sizeof(uint64_t));
+			if (grown == NULL)
+			{
+				return -1;
+			}
+			*offsets = grown;
+		}
+
+		/* block numbers start at 1 in the table, so 0 can mean "no block yet" */
+		uint64_t block = (*block_count)++;
+		(*offsets)[block] = pos;
+
+		uint32_t trigram = 0;
+		for (size_t i = pos; i < end; ++i)
+		{
+			trigram = ((trigram << 8) | fold(data[i])) & 0xFFFFFF;
+			if (i - pos >= 2 && add_posting(table, trigram, block + 1) == -1)
+			{
+				return -1;
+			}
+		}
+
+		pos = end;
+	}
+
+	return 0;
+}
+
+/**
+ * @brief Compares two trigrams of the table for qsort.
+ */
+static int compare_trigrams(const void *a, const void *b)
+{
+	uint32_t trigram_a = ((const posting *) a)->trigram;
+	uint32_t trigram_b = ((const posting *) b)->trigram;
+	return (trigram_a > trigram_b) - (trigram_a < trigram_b);
+}
+
+/**
+ * @brief Writes the index to a file.
+ * @param output The file opened for writing
+ * @param files The paths of the files
+ * @param infos The stats of the files
+ * @param file_blocks The number of blocks of every file
+ * @param count The number of files
+ * @param offsets The offsets of all blocks
+ * @param block_count The number of blocks
+ * @param lists The posting lists, sorted by their trigram
+ * @param list_count The number of posting lists
+ * @return 0 on success
+ * @return -1 on failure (errno is set)
+ */
+static int write_index(FILE *output, char *const *files, const struct stat *infos, const size_t *file_blocks,
+                       size_t count, const uint64_t *offsets, size_t block_count, const posting *lists,
+                       size_t list_count)
+{
+	index_header header = {0};
+	memcpy(header.magic, INDEX_MAGIC, sizeof(header.magic));
+	header.block_size = INDEX_BLOCK_SIZE;
+	header.file_count = count;
+	header.block_count = block_count;
+	header.trigram_count = list_count;
+	for (size_t i = 0; i < list_count; ++i)
+	{
+		header.postings_size += lists[i].length;
+	}
+
+	bool ok = fwrite(&header, sizeof(header), 1, output) == 1;
+	for (size_t i = 0; ok && i < count; ++i)
+	{
+		static const char padding[8];
+		size_t length = strlen(files[i]);
+		index_file file = {infos[i].st_size, infos[i].st_mtim.tv_sec, infos[i].st_mtim.tv_nsec, file_blocks[i], length};
+		ok = fwrite(&file, sizeof(file), 1, output) == 1 && fwrite(files[i], 1, length, output) == length &&
+		     fwrite(padding, 1, padded(length) - length, output) == padded(length) - length;
+	}
+
+	ok = ok && fwrite(offsets, sizeof(uint64_t), block_count, output) == block_count;
+
+	uint64_t offset = 0;
+	for (size_t i = 0; ok && i < list_count; ++i)
+	{
+		index_trigram entry = {lists[i].trigram, lists[i].count, offset};
+		ok = fwrite(&entry, sizeof(entry), 1, output) == 1;
+		offset += lists[i].length;
+	}
+
+	for (size_t i = 0; ok && i < list_count; ++i)
+	{
+		ok = fwrite(lists[i].bytes, 1, lists[i].length, output) == lists[i].length;
+	}
+
+	return ok ? 0 : -1;
+}
+
+int index_build(const char *path, char *const *files, size_t count)
+{
+	int ret = -1;
+	int error = 0;
+
+	posting_table table = {malloc(1024 * sizeof(posting)), 1024, 0};
+	struct stat *infos = malloc((count + 1) * sizeof(struct stat));
+	size_t *file_blocks = malloc((count + 1) * sizeof(size_t));
+	uint64_t *offsets = NULL;
+	size_t block_count = 0;
+	size_t capacity = 0;
+	char *temporary = malloc(strlen(path) + 5);
+	FILE *output = NULL;
+	bool created = false;
+
+	if (table.slots == NULL || infos == NULL || file_blocks == NULL || temporary == NULL)
+	{
+		error = ENOMEM;
+		goto cleanup;
+	}
+	for (size_t i = 0; i < table.capacity; ++i)
+	{
+		table.slots[i].trigram = EMPTY_SLOT;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		int fd = open(files[i], O_RDONLY);
+		if (fd == -1 || fstat(fd, &infos[i]) == -1)
+		{
+			error = errno;
+			if (fd != -1)
+			{
+				close(fd);
+			}
+			goto cleanup;
+		}
+
+		size_t before = block_count;
+		int result = 0;
+		if (infos[i].st_size > 0)
+		{
+			void *data = mmap(NULL, infos[i].st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (data == MAP_FAILED)
+			{
+				result = -1;
+			}
+			else
+			{
+				madvise(data, infos[i].st_size, MADV_SEQUENTIAL);
+				result = index_file_blocks(data, infos[i].st_size, &table, &offsets, &block_count, &capacity);
+				munmap(data, infos[i].st_size);
+			}
+		}
+
+		error = errno;
+		close(fd);
+		if (result == -1)
+		{
+			goto cleanup;
+		}
+		file_blocks[i] = block_count - before;
+	}
+	error = 0;
+
+	/* pack the used slots and sort them, so the table can be searched binary */
+	size_t list_count = 0;
+	for (size_t i = 0; i < table.capacity; ++i)
+	{
+		if (table.slots[i].trigram != EMPTY_SLOT)
+		{
+			table.slots[list_count++] = table.slots[i];
+		}
+	}
+	qsort(table.slots, list_count, sizeof(posting), compare_trigrams);
+	for (size_t i = list_count; i < table.capacity; ++i)
+	{
+		table.slots[i].trigram = EMPTY_SLOT;
+	}
+
+	sprintf(temporary, "%s.tmp", path);
+	output = fopen(temporary, "w");
+	created = output != NULL;
+	if (output == NULL || write_index(output, files, infos, file_blocks, count, offsets, block_count, table.slots,
+	                                  list_count) == -1)
+	{
+		error = errno;
+		goto cleanup;
+	}
+
+	FILE *written = output;
+	output = NULL;
+	if (fclose(written) == EOF || rename(temporary, path) == -1)
+	{
+		error = errno;
+		goto cleanup;
+	}
+	ret = 0;
+
+cleanup:
+	if (output)
+	{
+		fclose(output);
+	}
+	if (ret == -1 && created)
+	{
+		unlink(temporary);
+	}
+	if (table.slots)
+	{
+		for (size_t i = 0; i < table.capacity; ++i)
+		{
+			if (table.slots[i].trigram != EMPTY_SLOT)
+			{
+				free(table.slots[i].bytes);
+			}
+		}
+	}
+
+	free(table.slots);
+	free(infos);
+	free(file_blocks);
+	free(offsets);
+	free(temporary);
+
+	if (ret == -1)
+	{
+		errno = error ? error : ENOMEM;
+	}
+	return ret;
+}
+
+/**
+ * @brief Checks the files of an index file and reads their sizes and blocks.
+ * @param index The index with data, size, file_count and block_count set
+ * @param pos Pointer to the position after the header, which is moved after the files
+ * @param files The paths of the files which should be indexed
+ * @param count The number of files
+ * @return 0 if the files are the expected ones and unchanged
+ * @return -1 otherwise (errno is set)
+ */
+static int load_files(trigram_index *const index, size_t *pos, char *const *files, size_t count)
+{
+	if (index->file_count != count)
+	{
+		errno = ESTALE;
+		return -1;
+	}
+
+	index->file_sizes = malloc((count + 1) * sizeof(uint64_t));
+	index->first_blocks = malloc((count + 1) * sizeof(size_t));
+	if (index->file_sizes == NULL || index->first_blocks == NULL)
+	{
+		return -1;
+	}
+
+	const char *data = index->data;
+	size_t blocks = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		index_file file;
+		if (index->size - *pos < sizeof(file))
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		memcpy(&file, data + *pos, sizeof(file));
+		*pos += sizeof(file);
+
+		struct stat info;
+		if (file.path_length != strlen(files[i]) || index->size - *pos < padded(file.path_length) ||
+		    memcmp(data + *pos, files[i], file.path_length) != 0 || stat(files[i], &info) == -1 ||
+		    (uint64_t) info.st_size != file.size || info.st_mtim.tv_sec != file.mtime_sec ||
+		    info.st_mtim.tv_nsec != file.mtime_nsec || file.block_count > index->block_count - blocks)
+		{
+			errno = ESTALE;
+			return -1;
+		}
+
+		*pos += padded(file.path_length);
+		index->file_sizes[i] = file.size;
+		index->first_blocks[i] = blocks;
+		blocks += file.block_count;
+	}
+
+	if (blocks != index->block_count)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	index->first_blocks[count] = blocks;
+	return 0;
+}
+
+trigram_index *index_load(const char *path, char *const *files, size_t count)
+{
+	trigram_index *index = calloc(1, sizeof(*index));
+	if (index == NULL)
+	{
+		return NULL;
+	}
+
+	int fd = open(path, O_RDONLY);
+	struct stat info;
+	if (fd == -1 || fstat(fd, &info) == -1)
+	{
+		int error = errno;
+		if (fd != -1)
+		{
+			close(fd);
+		}
+		free(index);
+		errno = error;
+		return NULL;
+	}
+
+	index->size = info.st_size;
+	index->data = index->size >= sizeof(index_header) ? mmap(NULL, index->size, PROT_READ, MAP_PRIVATE, fd, 0) : NULL;
+	close(fd);
+	if (index->data == MAP_FAILED || index->data == NULL)
+	{
+		int error = index->data == NULL ? EINVAL : errno;
+		index->data = NULL;
+		index_free(index);
+		errno = error;
+		return NULL;
+	}
+
+	index_header header;
+	memcpy(&header, index->data, sizeof(header));
+	if (memcmp(header.magic, INDEX_MAGIC, sizeof(header.magic)) != 0 || header.block_size != INDEX_BLOCK_SIZE)
+	{
+		index_free(index);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	index->file_count = header.file_count;
+	index->block_count = header.block_count;
+	size_t pos = sizeof(header);
+	if (load_files(index, &pos, files, count) == -1)
+	{
+		int error = errno;
+		index_free(index);
+		errno = error;
+		return NULL;
+	}
+
+	/* the rest has to be exactly the offsets, the trigram table and the postings */
+	size_t remaining = index->size - pos;
+	if (header.block_count > remaining / sizeof(uint64_t) ||
+	    header.trigram_count > (remaining - header.block_count * sizeof(uint64_t)) / sizeof(index_trigram) ||
+	    header.postings_size != remaining - header.block_count * sizeof(uint64_t) -
+	                            header.trigram_count * sizeof(index_trigram))
+	{
+		index_free(index);
+		errno = EINVAL;
+		return NULL;
+	}
+
+	const char *data = index->data;
+	index->offsets = (const uint64_t *) (data + pos);
+	pos += header.block_count * sizeof(uint64_t);
+	index->trigrams = (const index_trigram *) (data + pos);
+	index->trigram_count = header.trigram_count;
+	pos += header.trigram_count * sizeof(index_trigram);
+	index->postings = (const unsigned char *) (data + pos);
+	index->postings_size = header.postings_size;
+
+	return index;
+}
+
+void index_free(trigram_index *index)
+{
+	if (index)
+	{
+		if (index->data)
+		{
+			munmap(index->data, index->size);
+		}
+
+		free(index->file_sizes);
+		free(index->first_blocks);
+		free(index);
+	}
+}
+
+size_t index_block_count(const trigram_index *index)
+{
+	return index->block_count;
+}
+
+void index_block(const trigram_index *index, size_t block, size_t *file, uint64_t *begin, uint64_t *end)
+{
+	/* the last file whose first block is not after the block */
+	size_t low = 0;
+	size_t high = index->file_count;
+	while (high - low > 1)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (index->first_blocks[middle] <= block)
+		{
+			low = middle;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	*file = low;
+	*begin = index->offsets[block];
+	*end = block + 1 < index->first_blocks[low + 1] ? index->offsets[block + 1] : index->file_sizes[low];
+}
+
+/**
+ * @brief Searches the trigram table.
+ * @param index The index
+ * @param trigram The trigram
+ * @return The entry of the trigram, NULL if no block contains it
+ */
+static const index_trigram *find_trigram(const trigram_index *const index, uint32_t trigram)
+{
+	size_t low = 0;
+	size_t high = index->trigram_count;
+	while (low < high)
+	{
+		size_t middle = low + (high - low) / 2;
+		if (index->trigrams[middle].trigram < trigram)
+		{
+			low = middle + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return low < index->trigram_count && index->trigrams[low].trigram == trigram ? &index->trigrams[low] : NULL;
+}
+
+/**
+ * @brief Compares two trigrams for qsort.
+ */
+static int compare_values(const void *a, const void *b)
+{
+	uint32_t value_a = *(const uint32_t *) a;
+	uint32_t value_b = *(const uint32_t *) b;
+	return (value_a > value_b) - (value_a < value_b);
+}
+
+/**
+ * @brief Marks the blocks containing all trigrams of a keyword.
+ * @param index The index
+ * @param keyword The keyword (at least 3 bytes)
+ * @param length The length of the keyword
+ * @param hits A counter for every block, which is 0 for all blocks
+ * @param candidates The flags of the blocks, which are set for the blocks containing the keyword
+ * @return 0 on success
+ * @return -1 if there is not enough memory
+ */
+static int mark_keyword(const trigram_index *const index, const char *const keyword, size_t length, uint32_t *hits,
+                        bool *candidates)
+{
+	size_t count = length - 2;
+	uint32_t *trigrams = malloc(count * sizeof(uint32_t));
+	if (trigrams == NULL)
+	{
+		return -1;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		trigrams[i] = (fold(keyword[i]) << 16) | (fold(keyword[i + 1]) << 8) | fold(keyword[i + 2]);
+	}
+	qsort(trigrams, count, sizeof(uint32_t), compare_values);
+
+	/* a block contains all trigrams if it is in the list of every distinct trigram,
+	   hits counts in how many lists (so far) a block is */
+	uint32_t lists = 0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (i > 0 && trigrams[i] == trigrams[i - 1])
+		{
+			continue;
+		}
+
+		const index_trigram *entry = find_trigram(index, trigrams[i]);
+		if (entry == NULL)
+		{
+			lists = 0;
+			break;
+		}
+
+		const unsigned char *pos = index->postings + entry->offset;
+		const unsigned char *end = index->postings + index->postings_size;
+		uint64_t block = 0;
+		for (uint32_t j = 0; j < entry->count; ++j)
+		{
+			uint64_t delta = 0;
+			for (int shift = 0; pos < end && shift < 64; shift += 7)
+			{
+				unsigned char byte = *pos++;
+				delta |= (uint64_t) (byte & 0x7F) << shift;
+				if (!(byte & 0x80))
+				{
+					break;
+				}
+			}
+
+			block += delta;
+			if (block >= 1 && block <= index->block_count && hits[block - 1] == lists)
+			{
+				hits[block - 1] = lists + 1;
+			}
+		}
+		++lists;
+	}
+
+	for (size_t block = 0; block < index->block_count; ++block)
+	{
+		if (lists > 0 && hits[block] == lists)
+		{
+			candidates[block] = true;
+		}
+		hits[block] = 0;
+	}
+
+	free(trigrams);
+	return 0;
+}
+
+bool *index_candidates(const trigram_index *index, const char *const *keywords, size_t count)
+{
+	bool *candidates = calloc(index->block_count + 1, sizeof(bool));
+	uint32_t *hits = calloc(index->block_count + 1, sizeof(uint32_t));
+	if (candidates == NULL || hits == NULL)
+	{
+		free(candidates);
+		free(hits);
+		return NULL;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t length = strlen(keywords[i]);
+		const char *newline = memchr(keywords[i], '\n', length);
+		if (newline != NULL && newline != keywords[i] + length - 1)
+		{
+			continue;
+		}
+
+		if (length < 3)
+		{
+			memset(candidates, true, index->block_count);
+			break;
+		}
+
+		if (mark_keyword(index, keywords[i], length, hits, candidates) == -1)
+		{
+			free(candidates);
+			free(hits);
+			return NULL;
+		}
+	}
+
+	free(hits);
+	return candidates;
+}
@@ -0,0 +1,87 @@
+/**
+ * @file index.h
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Trigram index over a static set of files
+ *
+ * The files are split into blocks of about INDEX_BLOCK_SIZE bytes at line boundaries. For every trigram of the
+ * (ASCII case folded) content the index stores the blocks containing it, so a keyword can only occur in the blocks
+ * which contain all of its trigrams. As the trigrams are folded, the same index serves case sensitive and case
+ * insensitive searches, the candidate blocks just have to be searched afterwards.
+ *
+ * The index file (in native byte order) consists of a header, the files (path, size and modification time, so a
+ * stale index is detected), the offsets of all blocks, a table of all trigrams sorted by their value and the posting
+ * lists, which are the differences between consecutive block numbers as varints.
+ **/
+
+#ifndef INDEX_H
+#define INDEX_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define INDEX_MAGIC "MGI1" /**< The magic bytes at the beginning of an index file. **/
+#define INDEX_BLOCK_SIZE (64 * 1024) /**< The minimum number of bytes of a block (but the last one of a file). **/
+
+typedef struct trigram_index trigram_index;
+
+/**
+ * @brief Builds the index of the given files and writes it to path.
+ * The index is written to a temporary file first, which replaces path when it is complete.
+ * @param path The path of the index file
+ * @param files The paths of the files to index
+ * @param count The number of files
+ * @return 0 on success
+ * @return -1 on failure (errno is set)
+ */
+int index_build(const char *path, char *const *files, size_t count);
+
+/**
+ * @brief Loads an index file.
+ * @param path The path of the index file
+ * @param files The paths of the files which should be indexed by it
+ * @param count The number of files
+ * @return The index, which has to be freed with index_free
+ * @return NULL on failure (errno is set, ESTALE if the index doesn't belong to the files or they have been changed,
+ * EINVAL if it is not a valid index file)
+ */
+trigram_index *index_load(const char *path, char *const *files, size_t count);
+
+/**
+ * @brief Frees an index.
+ * @param index The index to free
+ */
+void index_free(trigram_index *index);
+
+/**
+ * @brief Returns the number of blocks of all files.
+ * @param index The index
+ * @return The number of blocks
+ */
+size_t index_block_count(const trigram_index *index);
+
+/**
+ * @brief Returns the position of a block.
+ * @param index The index
+ * @param block The number of the block (the blocks of a file are numbered consecutively, in the order of the files)
+ * @param file Pointer to the number of the file of the block
+ * @param begin Pointer to the offset of the first byte of the block in the file
+ * @param end Pointer to the offset after the last byte of the block
+ */
+void index_block(const trigram_index *index, size_t block, size_t *file, uint64_t *begin, uint64_t *end);
+
+/**
+ * @brief Marks the blocks which may contain one of the keywords.
+ * A block is a candidate if it contains all trigrams of a keyword. Keywords shorter than 3 bytes match every
+ * block, keywords which can't match a line (see searcher_create) match none.
+ * @param index The index
+ * @param keywords The keywords
+ * @param count The number of keywords
+ * @return An array with a flag for each block, which has to be freed
+ * @return NULL if there was not enough memory
+ */
+bool *index_candidates(const trigram_index *index, const char *const *keywords, size_t count);
+
+#endif
@@ -5,8 +5,12 @@
  *
  * @brief mygrep
  *
- * This program greps one or more input files (both case sensitive and insensitive) for a keyword and
- * outputs the matching lines to stdout or another output file.
+ * This program greps one or more input files (both case sensitive and insensitive) for a keyword (or several
+ * keywords given with -e) and outputs the matching lines to stdout or another output file.
+ * Regular files are memory-mapped, with -j they are split into chunks at line boundaries, which are searched by
+ * several threads and printed in the order of the input.
+ * With -I the files are searched with a trigram index (see index.h), only the blocks which may contain a keyword
+ * are read.
  **/
 
 #include <assert.h>
@@ -18,6 +22,45 @@
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "index.h"
+#include "search.h"
+
+#define READ_BLOCK_SIZE (1 << 20) /**< The number of bytes read at once. **/
+#define CHUNK_SIZE (4 << 20) /**< The number of bytes searched by a thread at once. **/
+#define CHUNKS_AHEAD 4 /**< The number of chunks per thread which may be searched before they are printed. **/
+#define MAX_THREADS 1024
+
+/**
+ * @brief A part of the input consisting of complete lines, which is searched by one thread
+ */
+typedef struct
+{
+	const char *begin;
+	const char *end;
+	char *output; /**< The matching lines **/
+	size_t output_length;
+	int ret;
+	bool done;
+} chunk;
+
+/**
+ * @brief The chunks of a buffer and the state shared by the threads searching them
+ */
+typedef struct
+{
+	const searcher *searcher;
+	chunk *chunks;
+	size_t count;
+	size_t next; /**< The next chunk which is not taken by a thread **/
+	size_t printed; /**< The number of chunks which have been printed **/
+	size_t ahead; /**< The maximum number of chunks searched before they are printed **/
+	pthread_mutex_t mutex;
+	pthread_cond_t changed; /**< Signaled when a chunk is done or printed **/
+} chunk_queue;
 
 static char *program_name; /**< The program name. Needs to be defined by the application. **/
 
@@ -40,90 +83,449 @@ __attribute__((format (printf, 1, 2))) void error(const char *const restrict for
 
 
 /**
- * @brief Writes up to length lowercase equivalents of the chars in input to output
- * @param input The input buffer
- * @param output The output buffer
- * @param length The number of chars to write
+ * @brief Returns the byte after the last newline in a buffer.
+ * @param begin The beginning of the buffer
+ * @param end The end of the buffer
+ * @return The beginning of the last line, begin if there is no newline
  */
-static void lowercase(const char *const restrict input, char *const restrict output, size_t length)
+static const char *last_line_start(const char *const begin, const char *end)
 {
-	for (size_t i = 0; i < length; ++i)
+	while (end > begin && end[-1] != '\n')
 	{
-		output[i] = (char) tolower((unsigned char) input[i]);
+		--end;
 	}
+
+	return end;
 }
 
 /**
- * @brief Greps a file for a keyword and outputs the matching lines to stdout.
- * @param input An input file opened for reading
- * @param keyword The keyword to search for
+ * @brief Outputs all lines of a buffer which contain a keyword.
+ * The buffer is searched as a whole, only the lines containing a match are located.
+ * @param searcher The searcher for the keywords
+ * @param begin The beginning of the buffer, which has to be the beginning of a line
+ * @param end The end of the buffer, which has to be the end of a line
  * @param output An output file opened for writing to write the matching lines to
- * @param case_insensitive Whether the search should occur without regard to case sensitivity
  * @return EXIT_SUCCESS on success
  * @return EXIT_FAILURE on failure. An error message has been written to stderr
  */
-int mygrep(FILE *input, const char *const keyword, FILE *output, bool case_insensitive)
+static int grep_buffer(const searcher *const searcher, const char *begin, const char *const end, FILE *output)
+{
+	const char *match;
+	while (begin < end && (match = searcher_find(searcher, begin, end)) != NULL)
+	{
+		const char *line = last_line_start(begin, match);
+		const char *newline = memchr(match, '\n', end - match);
+		const char *line_end = newline ? newline + 1 : end;
+
+		if (fwrite(line, 1, line_end - line, output) != (size_t) (line_end - line))
+		{
+			error("fwrite failed: %s", strerror(errno));
+			return EXIT_FAILURE;
+		}
+
+		begin = line_end;
+	}
+
+	return EXIT_SUCCESS;
+}
+
+/**
+ * @brief The function of the threads. Searches the next chunk into a memory buffer until all chunks are taken.
+ * A thread doesn't take a chunk which is more than ahead chunks in front of the printed ones, so the memory for
+ * the matching lines stays bounded.
+ * @param argument The chunk_queue
+ * @return NULL
+ */
+static void *search_chunks(void *argument)
 {
+	chunk_queue *queue = argument;
+
+	pthread_mutex_lock(&queue->mutex);
+	while (queue->next < queue->count)
+	{
+		if (queue->next >= queue->printed + queue->ahead)
+		{
+			pthread_cond_wait(&queue->changed, &queue->mutex);
+			continue;
+		}
+
+		chunk *current = &queue->chunks[queue->next++];
+		pthread_mutex_unlock(&queue->mutex);
+
+		FILE *output = open_memstream(&current->output, &current->output_length);
+		if (output == NULL)
+		{
+			error("open_memstream failed: %s", strerror(errno));
+			current->ret = EXIT_FAILURE;
+		}
+		else
+		{
+			current->ret = grep_buffer(queue->searcher, current->begin, current->end, output);
+			if (fclose(output) == EOF)
+			{
+				error("fclose failed: %s", strerror(errno));
+				current->ret = EXIT_FAILURE;
+			}
+		}
+
+		pthread_mutex_lock(&queue->mutex);
+		current->done = true;
+		pthread_cond_broadcast(&queue->changed);
+	}
+	pthread_mutex_unlock(&queue->mutex);
+
+	return NULL;
+}
+
+/**
+ * @brief Outputs all lines of a buffer which contain a keyword, searched by several threads.
+ * The buffer is split into chunks of about CHUNK_SIZE bytes at line boundaries. The matching lines of each chunk
+ * are collected in memory and printed in the order of the chunks as soon as they are done.
+ * @param searcher The searcher for the keywords
+ * @param begin The beginning of the buffer, which has to be the beginning of a line
+ * @param end The end of the buffer, which has to be the end of a line
+ * @param output An output file opened for writing to write the matching lines to
+ * @param threads The number of threads
+ * @return EXIT_SUCCESS on success
+ * @return EXIT_FAILURE on failure. An error message has been written to stderr
+ */
+static int grep_parallel(const searcher *const searcher, const char *begin, const char *const end, FILE *output,
+                         int threads)
+{
+	size_t size = end - begin;
+	if (threads == 1 || size <= CHUNK_SIZE)
+	{
+		return grep_buffer(searcher, begin, end, output);
+	}
+
 	int ret = EXIT_SUCCESS;
-	
-	char *keyword_buffer;
-	char *haystack = NULL;
-	size_t length;
-	char *haystack_buffer = NULL;
-	
-	if (case_insensitive)
+	chunk_queue queue = {
+		.searcher = searcher,
+		.chunks = calloc(size / CHUNK_SIZE + 1, sizeof(chunk)),
+		.ahead = (size_t) threads * CHUNKS_AHEAD
+	};
+	pthread_t *workers = malloc(threads * sizeof(pthread_t));
+	int started = 0;
+	if (queue.chunks == NULL || workers == NULL)
 	{
-		length = strlen(keyword);
-		
-		keyword_buffer = malloc(length * sizeof(char));
-		if (keyword_buffer == NULL)
+		error("malloc failed: %s", strerror(errno));
+		ret = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	/* every chunk ends after the first newline following CHUNK_SIZE bytes */
+	for (const char *pos = begin; pos < end; ++queue.count)
+	{
+		const char *chunk_end = end;
+		if ((size_t) (end - pos) > CHUNK_SIZE)
+		{
+			const char *newline = memchr(pos + CHUNK_SIZE, '\n', end - pos - CHUNK_SIZE);
+			chunk_end = newline ? newline + 1 : end;
+		}
+
+		queue.chunks[queue.count].begin = pos;
+		queue.chunks[queue.count].end = chunk_end;
+		pos = chunk_end;
+	}
+
+	pthread_mutex_init(&queue.mutex, NULL);
+	pthread_cond_init(&queue.changed, NULL);
+	for (; started < threads; ++started)
+	{
+		int result = pthread_create(&workers[started], NULL, search_chunks, &queue);
+		if (result != 0)
 		{
-			error("malloc failed");
+			error("pthread_create failed: %s", strerror(result));
 			ret = EXIT_FAILURE;
-			goto cleanup;
+			break;
 		}
+	}
+
+	/* without any thread, nobody would search the chunks */
+	for (size_t i = 0; started > 0 && i < queue.count; ++i)
+	{
+		chunk *current = &queue.chunks[i];
 
-		lowercase(keyword, keyword_buffer, length);
+		pthread_mutex_lock(&queue.mutex);
+		while (!current->done)
+		{
+			pthread_cond_wait(&queue.changed, &queue.mutex);
+		}
+		pthread_mutex_unlock(&queue.mutex);
+
+		if (current->ret != EXIT_SUCCESS)
+		{
+			ret = EXIT_FAILURE;
+		}
+		else if (ret == EXIT_SUCCESS && fwrite(current->output, 1, current->output_length, output) != current->output_length)
+		{
+			error("fwrite failed: %s", strerror(errno));
+			ret = EXIT_FAILURE;
+		}
+
+		free(current->output);
+		current->output = NULL;
+
+		pthread_mutex_lock(&queue.mutex);
+		queue.printed = i + 1;
+		pthread_cond_broadcast(&queue.changed);
+		pthread_mutex_unlock(&queue.mutex);
 	}
-	else
+
+	for (int i = 0; i < started; ++i)
 	{
-		/* This const cast is needed, as keyword_buffer can't be const
-		   due to it being passed to lowercase in another branch */
-		keyword_buffer = (char *const) keyword;
+		pthread_join(workers[i], NULL);
 	}
+	pthread_mutex_destroy(&queue.mutex);
+	pthread_cond_destroy(&queue.changed);
 
-	length = 0;
-	while ((getline(&haystack, &length, input)) != -1)
+cleanup:
+	free(workers);
+	free(queue.chunks);
+
+	return ret;
+}
+
+/**
+ * @brief Maps a regular file into memory.
+ * @param input An input file opened for reading
+ * @param data Pointer to the mapped content (NULL for an empty file)
+ * @param size Pointer to the size of the file
+ * @return true if the file has been mapped (or is empty)
+ * @return false if the file isn't a regular file or can't be mapped, it has to be read instead
+ */
+static bool map_input(FILE *input, const char **data, size_t *size)
+{
+	struct stat info;
+	if (fstat(fileno(input), &info) == -1 || !S_ISREG(info.st_mode))
 	{
-		if (case_insensitive)
+		return false;
+	}
+
+	*size = info.st_size;
+	*data = NULL;
+	if (*size == 0)
+	{
+		return true;
+	}
+
+	void *mapped = mmap(NULL, *size, PROT_READ, MAP_PRIVATE, fileno(input), 0);
+	if (mapped == MAP_FAILED)
+	{
+		return false;
+	}
+
+	madvise(mapped, *size, MADV_SEQUENTIAL);
+	*data = mapped;
+	return true;
+}
+
+/**
+ * @brief Greps a file for keywords and outputs the matching lines to stdout.
+ * Regular files are mapped into memory and searched as a whole. Other files are read in blocks of READ_BLOCK_SIZE
+ * bytes per thread (or more for longer lines), which are searched up to their last complete line.
+ * @param input An input file opened for reading
+ * @param searcher The searcher for the keywords
+ * @param output An output file opened for writing to write the matching lines to
+ * @param threads The number of threads searching the input
+ * @return EXIT_SUCCESS on success
+ * @return EXIT_FAILURE on failure. An error message has been written to stderr
+ */
+int mygrep(FILE *input, const searcher *const searcher, FILE *output, int threads)
+{
+	int ret = EXIT_SUCCESS;
+
+	const char *data;
+	size_t size;
+	if (map_input(input, &data, &size))
+	{
+		ret = grep_parallel(searcher, data, data + size, output, threads);
+		if (data)
+		{
+			munmap((void *) data, size);
+		}
+
+		return ret;
+	}
+
+	size_t capacity = (size_t) READ_BLOCK_SIZE * threads;
+	size_t filled = 0;
+	char *buffer = malloc(capacity);
+	if (buffer == NULL)
+	{
+		error("malloc failed: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	bool eof = false;
+	while (!eof && ret == EXIT_SUCCESS)
+	{
+		ssize_t count = read(fileno(input), buffer + filled, capacity - filled);
+		if (count == -1)
 		{
-			if (!(haystack_buffer = realloc(haystack_buffer, length * sizeof(char))))
+			if (errno == EINTR)
 			{
-				error("realloc failed: %s", strerror(errno));
-				ret = EXIT_FAILURE;
-				goto cleanup;
+				continue;
 			}
-			lowercase(haystack, haystack_buffer, length);
+
+			error("read failed: %s", strerror(errno));
+			ret = EXIT_FAILURE;
+			break;
 		}
-		else
+
+		filled += count;
+		eof = count == 0;
+
+		/* a pipe returns less than requested, so fill the block before the threads split it */
+		if (!eof && threads > 1 && filled < capacity)
 		{
-			haystack_buffer = haystack;
+			continue;
+		}
+
+		/* only complete lines are searched, the rest is kept for the next block */
+		const char *complete = eof ? buffer + filled : last_line_start(buffer, buffer + filled);
+		ret = grep_parallel(searcher, buffer, complete, output, threads);
+
+		size_t rest = buffer + filled - complete;
+		memmove(buffer, complete, rest);
+		filled = rest;
+
+		if (filled == capacity)
+		{
+			char *grown = realloc(buffer, capacity * 2);
+			if (grown == NULL)
+			{
+				error("realloc failed: %s", strerror(errno));
+				ret = EXIT_FAILURE;
+				break;
+			}
+
+			buffer = grown;
+			capacity *= 2;
 		}
-		
-		if (strstr(haystack_buffer, keyword_buffer))
+	}
+
+	free(buffer);
+
+	return ret;
+}
+
+/**
+ * @brief Loads the index of the files, building it first if it doesn't exist or is stale.
+ * @param path The path of the index file
+ * @param files The paths of the files
+ * @param count The number of files
+ * @return The index
+ * @return NULL on failure. An error message has been written to stderr
+ */
+static trigram_index *open_index(const char *const path, char *const *files, size_t count)
+{
+	trigram_index *index = index_load(path, files, count);
+	if (index == NULL && (errno == ENOENT || errno == ESTALE || errno == EINVAL))
+	{
+		if (index_build(path, files, count) == -1)
 		{
-			fprintf(output, "%s", haystack);
+			error("Cannot build index %s: %s", path, strerror(errno));
+			return NULL;
 		}
+
+		index = index_load(path, files, count);
 	}
 
-cleanup:
-	if (case_insensitive)
+	if (index == NULL)
+	{
+		error("Cannot load index %s: %s", path, strerror(errno));
+	}
+	return index;
+}
+
+/**
+ * @brief Greps files for keywords with a trigram index and outputs the matching lines.
+ * Only the blocks containing all trigrams of a keyword are mapped and searched, in the order of the files.
+ * @param path The path of the index file
+ * @param files The paths of the files
+ * @param count The number of files
+ * @param keywords The keywords
+ * @param keyword_count The number of keywords
+ * @param searcher The searcher for the keywords
+ * @param output An output file opened for writing to write the matching lines to
+ * @return EXIT_SUCCESS on success
+ * @return EXIT_FAILURE on failure. An error message has been written to stderr
+ */
+static int grep_indexed(const char *const path, char *const *files, size_t count, const char *const *keywords,
+                        size_t keyword_count, const searcher *const searcher, FILE *output)
+{
+	trigram_index *index = open_index(path, files, count);
+	if (index == NULL)
+	{
+		return EXIT_FAILURE;
+	}
+
+	bool *candidates = index_candidates(index, keywords, keyword_count);
+	if (candidates == NULL)
 	{
-		free(haystack_buffer);
-		free(keyword_buffer);
+		error("malloc failed: %s", strerror(errno));
+		index_free(index);
+		return EXIT_FAILURE;
 	}
 
-	free(haystack);
+	int ret = EXIT_SUCCESS;
+	size_t block_count = index_block_count(index);
+	size_t block = 0;
+	while (ret == EXIT_SUCCESS && block < block_count)
+	{
+		if (!candidates[block])
+		{
+			++block;
+			continue;
+		}
+
+		size_t file;
+		uint64_t begin;
+		uint64_t end;
+		index_block(index, block, &file, &begin, &end);
+
+		FILE *f = fopen(files[file], "r");
+		const char *data;
+		size_t size;
+		if (f == NULL || !map_input(f, &data, &size) || size < end)
+		{
+			error("Failed to read input file %s", files[file]);
+			if (f)
+			{
+				fclose(f);
+			}
+			ret = EXIT_FAILURE;
+			break;
+		}
+
+		/* the mapping is advised sequential, but only some blocks are touched */
+		madvise((void *) data, size, MADV_RANDOM);
+
+		/* all candidate blocks of this file */
+		size_t file_block;
+		do
+		{
+			if (candidates[block])
+			{
+				ret = grep_buffer(searcher, data + begin, data + end, output);
+			}
+
+			if (++block < block_count)
+			{
+				index_block(index, block, &file_block, &begin, &end);
+			}
+		} while (ret == EXIT_SUCCESS && block < block_count && file_block == file);
+
+		if (data)
+		{
+			munmap((void *) data, size);
+		}
+		fclose(f);
+	}
+
+	free(candidates);
+	index_free(index);
 
 	return ret;
 }
@@ -143,10 +545,22 @@ int main(int argc, char **argv)
 	program_name = argv[0];
 
 	bool case_insensitive = false;
+	const char *index_path = NULL;
 	FILE *output_file = stdout;
+	int threads = 1;
+	char *end;
+
+	/* there can't be more keywords than arguments */
+	const char **keywords = malloc(argc * sizeof(char *));
+	size_t keyword_count = 0;
+	if (keywords == NULL)
+	{
+		error("malloc failed: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
 	
 	int c;
-	while ((c = getopt(argc, argv, "i::o:")) != -1)
+	while ((c = getopt(argc, argv, "i::e:I:j:o:")) != -1)
 	{
 		switch (c)
 		{
@@ -154,6 +568,28 @@ int main(int argc, char **argv)
 			case_insensitive = true;
 			break;
 
+		case 'e':
+			keywords[keyword_count++] = optarg;
+			break;
+
+		case 'I':
+			index_path = optarg;
+			break;
+
+		case 'j':
+		{
+			errno = 0;
+			long count = strtol(optarg, &end, 10);
+			if (errno != 0 || end == optarg || *end != '\0' || count < 1 || count > MAX_THREADS)
+			{
+				error("Invalid number of threads %s", optarg);
+				return EXIT_FAILURE;
+			}
+
+			threads = (int) count;
+			break;
+		}
+
 	    case 'o':
 		{
 			FILE *f = fopen(optarg, "w");
@@ -178,31 +614,48 @@ int main(int argc, char **argv)
 
 	int ret = EXIT_SUCCESS;
 	int diff;
+	searcher *searcher = NULL;
 
-	char *keyword;
-	if (optind < argc && strlen(argv[optind]) > 0)
+	if (keyword_count == 0 && optind < argc && strlen(argv[optind]) > 0)
 	{
-		keyword = argv[optind++];
+		keywords[keyword_count++] = argv[optind++];
 	}
-	else
+	else if (keyword_count == 0)
 	{
 		error("Parameter keyword required.");
 
-		fprintf(stderr, "Usage: %s [-i] [-o outfile] keyword [file...]\n", argv[0]);
+		fprintf(stderr, "Usage: %s [-i] [-I index] [-j threads] [-o outfile] {keyword | -e keyword...} [file...]\n", argv[0]);
+		ret = EXIT_FAILURE;
+		goto cleanup;
+	}
+
+	searcher = searcher_create(keywords, keyword_count, case_insensitive);
+	if (searcher == NULL)
+	{
+		error("Cannot create searcher: %s", strerror(errno));
 		ret = EXIT_FAILURE;
 		goto cleanup;
 	}
 
 	diff = argc - optind;
 
-	if (diff > 0)
+	if (index_path != NULL && diff <= 0)
+	{
+		error("An index requires input files.");
+		ret = EXIT_FAILURE;
+	}
+	else if (index_path != NULL)
+	{
+		ret = grep_indexed(index_path, argv + optind, diff, keywords, keyword_count, searcher, output_file);
+	}
+	else if (diff > 0)
 	{
 		for (int pos = optind; pos < argc; ++pos)
 		{
 			FILE *f = fopen(argv[pos], "r");
 			if (f)
 			{
-				ret = mygrep(f, keyword, output_file, case_insensitive);
+				ret = mygrep(f, searcher, output_file, threads);
 				fclose(f);
 			}
 			else
@@ -214,7 +667,7 @@ int main(int argc, char **argv)
 	}
 	else if (diff == 0)
 	{
-		ret = mygrep(stdin, keyword, output_file, case_insensitive);
+		ret = mygrep(stdin, searcher, output_file, threads);
 	}
 	else
 	{
@@ -223,6 +676,9 @@ int main(int argc, char **argv)
 	}
 
 cleanup:
+	searcher_free(searcher);
+	free(keywords);
+
 	if (output_file != stdout)
 	{
 		fclose(output_file);
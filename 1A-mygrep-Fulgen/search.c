@@ -0,0 +1,384 @@
+/**
+ * @file search.c
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Substring search over whole buffers
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "search.h"
+
+#define ALPHABET_SIZE 256
+
+struct searcher
+{
+	bool case_insensitive;
+	bool matches_all; /**< An empty keyword occurs everywhere. **/
+
+	/* a single keyword (folded if case_insensitive) */
+	unsigned char *keyword;
+	size_t length;
+
+	/* an Aho-Corasick automaton for multiple keywords, state 0 is the root */
+	uint32_t (*transitions)[ALPHABET_SIZE];
+	bool *accepting;
+	size_t state_count;
+};
+
+/**
+ * @brief Returns the lowercase equivalent of an ASCII char (like tolower in the C locale).
+ * @param c The char
+ * @return The folded char
+ */
+static inline unsigned char fold(unsigned char c)
+{
+	return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+/**
+ * @brief Checks whether a keyword can match a line.
+ * @param keyword The keyword
+ * @param length The length of the keyword
+ * @return false if the keyword contains a newline before its last char
+ */
+static bool fits_in_line(const char *const keyword, size_t length)
+{
+	const char *newline = memchr(keyword, '\n', length);
+	return newline == NULL || newline == keyword + length - 1;
+}
+
+/**
+ * @brief Adds a keyword to the trie of the automaton.
+ * @param searcher The searcher with transitions for at least state_count + length states
+ * @param keyword The keyword
+ * @param length The length of the keyword
+ */
+static void insert_keyword(searcher *const searcher, const char *const keyword, size_t length)
+{
+	uint32_t state = 0;
+	for (size_t i = 0; i < length; ++i)
+	{
+		unsigned char c = searcher->case_insensitive ? fold(keyword[i]) : (unsigned char) keyword[i];
+		if (searcher->transitions[state][c] == 0)
+		{
+			uint32_t next = searcher->state_count++;
+			memset(searcher->transitions[next], 0, sizeof(searcher->transitions[next]));
+			searcher->accepting[next] = false;
+			searcher->transitions[state][c] = next;
+		}
+		state = searcher->transitions[state][c];
+	}
+	searcher->accepting[state] = true;
+}
+
+/**
+ * @brief Turns the trie into a deterministic automaton by resolving all failure links.
+ * Afterwards every state has a transition for every char.
+ * @param searcher The searcher
+ * @return 0 on success
+ * @return -1 if there was not enough memory
+ */
+static int build_automaton(searcher *const searcher)
+{
+	uint32_t *queue = malloc(searcher->state_count * sizeof(uint32_t));
+	uint32_t *failure = malloc(searcher->state_count * sizeof(uint32_t));
+	if (queue == NULL || failure == NULL)
+	{
+		free(queue);
+		free(failure);
+		return -1;
+	}
+
+	/* breadth first, so the failure state of a state is always done before the state itself.
+	   A transition to 0 means "none" in the trie, as no edge leads back to the root. */
+	size_t head = 0;
+	size_t tail = 0;
+	for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+	{
+		uint32_t child = searcher->transitions[0][c];
+		if (child != 0)
+		{
+			failure[child] = 0;
+			queue[tail++] = child;
+		}
+	}
+
+	while (head < tail)
+	{
+		uint32_t state = queue[head++];
+		searcher->accepting[state] |= searcher->accepting[failure[state]];
+
+		for (size_t c = 0; c < ALPHABET_SIZE; ++c)
+		{
+			uint32_t child = searcher->transitions[state][c];
+			uint32_t fallback = searcher->transitions[failure[state]][c];
+			if (child != 0)
+			{
+				failure[child] = fallback;
+				queue[tail++] = child;
+			}
+			else
+			{
+				searcher->transitions[state][c] = fallback;
+			}
+		}
+	}
+
+	/* uppercase chars behave like their lowercase equivalents */
+	if (searcher->case_insensitive)
+	{
+		for (size_t state = 0; state < searcher->state_count; ++state)
+		{
+			for (unsigned char c = 'A'; c <= 'Z'; ++c)
+			{
+				searcher->transitions[state][c] = searcher->transitions[state][fold(c)];
+			}
+		}
+	}
+
+	free(queue);
+	free(failure);
+	return 0;
+}
+
+searcher *searcher_create(const char *const *keywords, size_t count, bool case_insensitive)
+{
+	searcher *result = calloc(1, sizeof(*result));
+	if (result == NULL)
+	{
+		return NULL;
+	}
+	result->case_insensitive = case_insensitive;
+
+	size_t usable = 0;
+	size_t total_length = 0;
+	const char *single = NULL;
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t length = strlen(keywords[i]);
+		if (length == 0)
+		{
+			result->matches_all = true;
+		}
+		else if (fits_in_line(keywords[i], length))
+		{
+			++usable;
+			total_length += length;
+			single = keywords[i];
+		}
+	}
+
+	if (result->matches_all || usable == 0)
+	{
+		return result;
+	}
+
+	if (usable == 1)
+	{
+		result->length = strlen(single);
+		result->keyword = malloc(result->length);
+		if (result->keyword == NULL)
+		{
+			searcher_free(result);
+			return NULL;
+		}
+
+		for (size_t i = 0; i < result->length; ++i)
+		{
+			result->keyword[i] = case_insensitive ? fold(single[i]) : (unsigned char) single[i];
+		}
+		return result;
+	}
+
+	result->transitions = malloc((total_length + 1) * sizeof(*result->transitions));
+	result->accepting = malloc((total_length + 1) * sizeof(bool));
+	if (result->transitions == NULL || result->accepting == NULL)
+	{
+		searcher_free(result);
+		errno = ENOMEM;
+		return NULL;
+	}
+
+	memset(result->transitions[0], 0, sizeof(result->transitions[0]));
+	result->accepting[0] = false;
+	result->state_count = 1;
+	for (size_t i = 0; i < count; ++i)
+	{
+		size_t length = strlen(keywords[i]);
+		if (fits_in_line(keywords[i], length))
+		{
+			insert_keyword(result, keywords[i], length);
+		}
+	}
+
+	if (build_automaton(result) == -1)
+	{
+		searcher_free(result);
+		errno = ENOMEM;
+		return NULL;
+	}
+	return result;
+}
+
+void searcher_free(searcher *searcher)
+{
+	if (searcher)
+	{
+		free(searcher->keyword);
+		free(searcher->transitions);
+		free(searcher->accepting);
+		free(searcher);
+	}
+}
+
+/**
+ * @brief Compares the chars between the first and the last one of the keyword.
+ * @param searcher The searcher with a single keyword
+ * @param candidate The position which matches the first and the last char
+ * @return true if the keyword occurs at candidate
+ */
+static inline bool matches_middle(const searcher *const searcher, const char *const candidate)
+{
+	const unsigned char *text = (const unsigned char *) candidate;
+	if (!searcher->case_insensitive)
+	{
+		return searcher->length <= 2 || memcmp(text + 1, searcher->keyword + 1, searcher->length - 2) == 0;
+	}
+
+	for (size_t i = 1; i + 1 < searcher->length; ++i)
+	{
+		if (fold(text[i]) != searcher->keyword[i])
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Returns the lowercase equivalents of 16 ASCII chars.
+ * @param chars The chars
+ * @return The folded chars
+ */
+static inline __m128i fold_vector(__m128i chars)
+{
+	/* the compare is signed, so chars >= 0x80 are never in the range */
+	__m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+	                              _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), chars));
+	return _mm_or_si128(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/**
+ * @brief Searches a buffer for a single keyword.
+ * Only positions whose first and last char match are compared completely.
+ * @param searcher The searcher with a single keyword
+ * @param begin The beginning of the buffer
+ * @param end The end of the buffer
+ * @return A pointer to the last byte of the first occurrence, NULL if there is none
+ */
+static const char *find_keyword(const searcher *const searcher, const char *begin, const char *end)
+{
+	size_t length = searcher->length;
+	if ((size_t) (end - begin) < length)
+	{
+		return NULL;
+	}
+
+	const char *last_start = end - length;
+	const char *pos = begin;
+	unsigned char first = searcher->keyword[0];
+	unsigned char last = searcher->keyword[length - 1];
+
+#ifdef __SSE2__
+	__m128i first_vector = _mm_set1_epi8((char) first);
+	__m128i last_vector = _mm_set1_epi8((char) last);
+	for (; last_start - pos >= 15; pos += 16)
+	{
+		__m128i firsts = _mm_loadu_si128((const __m128i *) pos);
+		__m128i lasts = _mm_loadu_si128((const __m128i *) (pos + length - 1));
+		if (searcher->case_insensitive)
+		{
+			firsts = fold_vector(firsts);
+			lasts = fold_vector(lasts);
+		}
+
+		unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, first_vector),
+		                                                          _mm_cmpeq_epi8(lasts, last_vector)));
+		while (candidates != 0)
+		{
+			const char *candidate = pos + __builtin_ctz(candidates);
+			if (matches_middle(searcher, candidate))
+			{
+				return candidate + length - 1;
+			}
+			candidates &= candidates - 1;
+		}
+	}
+#endif
+
+	for (; pos <= last_start; ++pos)
+	{
+		unsigned char c1 = pos[0];
+		unsigned char c2 = pos[length - 1];
+		if (searcher->case_insensitive)
+		{
+			c1 = fold(c1);
+			c2 = fold(c2);
+		}
+
+		if (c1 == first && c2 == last && matches_middle(searcher, pos))
+		{
+			return pos + length - 1;
+		}
+	}
+	return NULL;
+}
+
+/**
+ * @brief Searches a buffer with the Aho-Corasick automaton.
+ * @param searcher The searcher with multiple keywords
+ * @param begin The beginning of the buffer
+ * @param end The end of the buffer
+ * @return A pointer to the last byte of the first occurrence, NULL if there is none
+ */
+static const char *find_keywords(const searcher *const searcher, const char *begin, const char *end)
+{
+	uint32_t state = 0;
+	for (const char *pos = begin; pos < end; ++pos)
+	{
+		state = searcher->transitions[state][(unsigned char) *pos];
+		if (searcher->accepting[state])
+		{
+			return pos;
+		}
+	}
+	return NULL;
+}
+
+const char *searcher_find(const searcher *searcher, const char *begin, const char *end)
+{
+	if (searcher->matches_all)
+	{
+		return begin < end ? begin : NULL;
+	}
+	if (searcher->keyword)
+	{
+		return find_keyword(searcher, begin, end);
+	}
+	if (searcher->transitions)
+	{
+		return find_keywords(searcher, begin, end);
+	}
+	return NULL;
+}
@@ -0,0 +1,50 @@
+/**
+ * @file search.h
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Substring search over whole buffers
+ *
+ * A searcher finds the first occurrence of any of its keywords in a buffer. A single keyword is searched by
+ * filtering 16 positions at once for its first and last byte (SSE2), multiple keywords with an Aho-Corasick
+ * automaton. Case insensitive searchers fold the case while comparing, the buffer is never copied.
+ **/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef struct searcher searcher;
+
+/**
+ * @brief Creates a searcher for the given keywords.
+ * Keywords containing a newline anywhere but at their end can never match a line and are ignored.
+ * @param keywords The keywords
+ * @param count The number of keywords
+ * @param case_insensitive Whether the search should occur without regard to case sensitivity
+ * @return The searcher, which has to be freed with searcher_free
+ * @return NULL if there was not enough memory (errno is set)
+ */
+searcher *searcher_create(const char *const *keywords, size_t count, bool case_insensitive);
+
+/**
+ * @brief Frees a searcher.
+ * @param searcher The searcher to free
+ */
+void searcher_free(searcher *searcher);
+
+/**
+ * @brief Searches a buffer for the first occurrence of any keyword.
+ * As no keyword contains a newline before its end, the whole occurrence is part of the line containing the
+ * returned byte.
+ * @param searcher The searcher
+ * @param begin The beginning of the buffer
+ * @param end The end of the buffer
+ * @return A pointer to the last byte of the first (earliest ending) occurrence
+ * @return NULL if no keyword occurs in the buffer
+ */
+const char *searcher_find(const searcher *searcher, const char *begin, const char *end);
+
+#endif
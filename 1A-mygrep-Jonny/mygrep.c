@@ -17,6 +17,11 @@
 #include <errno.h>
 #include <stdbool.h>
 #include <assert.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define READ_BLOCK_SIZE (1 << 20)
 
 char *myprog;
 
@@ -51,10 +56,258 @@ void stringToLower(char *const word)
     }
 }
 
+/**
+ * Converts a character to lower case.
+ * @brief
+ * Like tolower() in the C locale, but without the lookup.
+ * 
+ * @param c the character to convert.
+ * @return the lower case character.
+**/
+static inline unsigned char foldCase(unsigned char c)
+{
+    return (c >= 'A' && c <= 'Z') ? c | 0x20 : c;
+}
+
+#ifdef __SSE2__
+/**
+ * Converts 16 characters to lower case.
+ * @brief
+ * The compare is signed, so characters >= 0x80 are never in the range.
+ * 
+ * @param chars the characters to convert.
+ * @return the lower case characters.
+**/
+static inline __m128i foldCaseVector(__m128i chars)
+{
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), chars));
+    return _mm_or_si128(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/**
+ * Checks if the keyword occurs at a position.
+ * @brief
+ * Compares the characters between the first and the last one of the keyword.
+ * 
+ * @param text the position in the buffer.
+ * @param keyword the keyword (lower case if ignore_case is set).
+ * @param keyword_length the length of the keyword.
+ * @param ignore_case whether the case should be ignored.
+ * @return true if the keyword occurs at text.
+**/
+static bool matchesMiddle(const char *text, const char *keyword, size_t keyword_length, bool ignore_case)
+{
+    if (!ignore_case)
+    {
+        return keyword_length <= 2 || memcmp(text + 1, keyword + 1, keyword_length - 2) == 0;
+    }
+
+    for (size_t i = 1; i + 1 < keyword_length; ++i)
+    {
+        if (foldCase(text[i]) != (unsigned char)keyword[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Searches a buffer for the keyword.
+ * @brief
+ * Returns the first occurrence of the keyword between begin and end or NULL.
+ * 
+ * @details
+ * Filters 16 positions at once for the first and the last character of the keyword (with SSE2),
+ * only the remaining candidates are compared completely. The case is folded while comparing.
+ * 
+ * @param begin the beginning of the buffer.
+ * @param end the end of the buffer.
+ * @param keyword the keyword (lower case if ignore_case is set).
+ * @param keyword_length the length of the keyword (at least 1).
+ * @param ignore_case whether the case should be ignored.
+ * @return the first occurrence or NULL.
+**/
+const char *findKeyword(const char *begin, const char *end, const char *keyword, size_t keyword_length, bool ignore_case)
+{
+    if ((size_t)(end - begin) < keyword_length)
+    {
+        return NULL;
+    }
+
+    const char *last_start = end - keyword_length;
+    const char *pos = begin;
+    unsigned char first = keyword[0];
+    unsigned char last = keyword[keyword_length - 1];
+
+#ifdef __SSE2__
+    __m128i first_vector = _mm_set1_epi8((char)first);
+    __m128i last_vector = _mm_set1_epi8((char)last);
+    for (; last_start - pos >= 15; pos += 16)
+    {
+        __m128i firsts = _mm_loadu_si128((const __m128i *)pos);
+        __m128i lasts = _mm_loadu_si128((const __m128i *)(pos + keyword_length - 1));
+        if (ignore_case)
+        {
+            firsts = foldCaseVector(firsts);
+            lasts = foldCaseVector(lasts);
+        }
+
+        unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, first_vector),
+                                                                  _mm_cmpeq_epi8(lasts, last_vector)));
+        while (candidates != 0)
+        {
+            const char *candidate = pos + __builtin_ctz(candidates);
+            if (matchesMiddle(candidate, keyword, keyword_length, ignore_case))
+            {
+                return candidate;
+            }
+            candidates &= candidates - 1;
+        }
+    }
+#endif
+
+    for (; pos <= last_start; ++pos)
+    {
+        unsigned char c1 = ignore_case ? foldCase(pos[0]) : (unsigned char)pos[0];
+        unsigned char c2 = ignore_case ? foldCase(pos[keyword_length - 1]) : (unsigned char)pos[keyword_length - 1];
+        if (c1 == first && c2 == last && matchesMiddle(pos, keyword, keyword_length, ignore_case))
+        {
+            return pos;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Finds the beginning of the last line in a buffer.
+ * @brief
+ * Returns the position after the last newline between begin and end (or begin if there is none).
+ * 
+ * @param begin the beginning of the buffer.
+ * @param end the end of the buffer.
+ * @return the beginning of the last line.
+**/
+const char *lastLineStart(const char *begin, const char *end)
+{
+    while (end > begin && end[-1] != '\n')
+    {
+        --end;
+    }
+    return end;
+}
+
+/**
+ * Prints all lines of a buffer which contain the keyword.
+ * @brief
+ * Searches the buffer as a whole and only locates the lines which contain the keyword.
+ * 
+ * @details
+ * The buffer has to consist of complete lines. Exits with EXIT_FAILURE if printing fails.
+ * 
+ * @param begin the beginning of the buffer.
+ * @param end the end of the buffer.
+ * @param keyword the keyword (lower case if ignore_case is set).
+ * @param ignore_case whether the case should be ignored.
+ * @param output_file the file to print the lines to.
+**/
+void grepBuffer(const char *begin, const char *end, const char *keyword, bool ignore_case, FILE *output_file)
+{
+    size_t keyword_length = strlen(keyword);
+
+    // a line can only contain a newline at its end
+    const char *newline = strchr(keyword, '\n');
+    if (newline != NULL && newline[1] != '\0')
+    {
+        return;
+    }
+
+    const char *match;
+    while (begin < end && (match = findKeyword(begin, end, keyword, keyword_length, ignore_case)) != NULL)
+    {
+        const char *line = lastLineStart(begin, match);
+        const char *line_end = memchr(match + keyword_length - 1, '\n', end - (match + keyword_length - 1));
+        line_end = line_end == NULL ? end : line_end + 1;
+
+        if (fwrite(line, 1, line_end - line, output_file) != (size_t)(line_end - line))
+        {
+            fprintf(stderr, "[%s] Error: fwrite failed: %s\n", myprog, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        begin = line_end;
+    }
+}
+
+/**
+ * Prints all lines of a file which contain the keyword.
+ * @brief
+ * Reads the file in blocks and searches each block up to its last complete line.
+ * 
+ * @details
+ * The incomplete line at the end of a block is moved to the beginning of the buffer before the next block
+ * is read. The buffer grows if a single line does not fit into it. Exits with EXIT_FAILURE on errors.
+ * 
+ * @param input_file the file to search.
+ * @param keyword the keyword (lower case if ignore_case is set).
+ * @param ignore_case whether the case should be ignored.
+ * @param output_file the file to print the lines to.
+**/
+void grepFile(FILE *input_file, const char *keyword, bool ignore_case, FILE *output_file)
+{
+    size_t buffer_size = READ_BLOCK_SIZE;
+    size_t filled = 0;
+    char *buffer = malloc(buffer_size);
+    if (buffer == NULL)
+    {
+        fprintf(stderr, "[%s] Error: malloc failed: %s\n", myprog, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    ssize_t read_length;
+    do
+    {
+        read_length = read(fileno(input_file), buffer + filled, buffer_size - filled);
+        if (read_length == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "[%s] Error: read failed: %s\n", myprog, strerror(errno));
+            free(buffer);
+            exit(EXIT_FAILURE);
+        }
+        filled += read_length;
+
+        const char *complete = read_length == 0 ? buffer + filled : lastLineStart(buffer, buffer + filled);
+        grepBuffer(buffer, complete, keyword, ignore_case, output_file);
+
+        filled = buffer + filled - complete;
+        memmove(buffer, complete, filled);
+
+        if (filled == buffer_size)
+        {
+            buffer_size *= 2;
+            char *new_buffer = realloc(buffer, buffer_size);
+            if (new_buffer == NULL)
+            {
+                fprintf(stderr, "[%s] Error: realloc failed: %s\n", myprog, strerror(errno));
+                free(buffer);
+                exit(EXIT_FAILURE);
+            }
+            buffer = new_buffer;
+        }
+    } while (read_length != 0);
+
+    free(buffer);
+}
+
 /**
  * Program entry point.
  * @brief The program first parses the arguments. Then it iterates over each file 
- * and each line and searches for the keyword. Once a keyword is found it is printed
+ * and searches it block by block for the keyword. Each line containing the keyword is printed
  * to the output.
  *  
  * @details Each input file is opened and read in the order they are given. The output 
@@ -112,9 +365,11 @@ int main(int argc, char **argv)
     char *input_file_name = argv[optind + 1];
 
     FILE *input_file = stdin;
-    char *buffer = NULL;
-    size_t buffer_length = 0;
-    ssize_t read_length;
+
+    if (ignore_case_flag == true)
+    {
+        stringToLower(keyword);
+    }
 
     FILE *output_file = stdout;
 
@@ -139,29 +394,7 @@ int main(int argc, char **argv)
             }
         }
 
-        while ((read_length = getline(&buffer, &buffer_length, input_file)) != -1)
-        {
-
-            char buffer_copy[read_length];
-            strcpy(buffer_copy, buffer);
-
-            if (ignore_case_flag == true)
-            {
-                stringToLower(buffer);
-                stringToLower(keyword);
-            }
-
-            //keyword was found
-            if (strstr(buffer, keyword) != NULL)
-            {
-                if (fputs(buffer_copy, output_file) == EOF)
-                {
-                    fprintf(stderr, "[%s] Error: fputs failed: %s\n", myprog, strerror(errno));
-                    free(buffer);
-                    exit(EXIT_FAILURE);
-                }
-            }
-        }
+        grepFile(input_file, keyword, ignore_case_flag, output_file);
 
         if (input_file != stdin)
         {
@@ -183,11 +416,5 @@ int main(int argc, char **argv)
         }
     }
 
-    //needs to be freed, because getline() allocates memory
-    if (buffer != NULL)
-    {
-        free(buffer);
-    }
-
     exit(EXIT_SUCCESS);
 }
\ No newline at end of file
@@ -2,7 +2,10 @@
 
 static char* PROGRAM_NAME;
 static void mygrep(char* keyword, FILE* in, FILE* out, bool case_sensitivity);
-static bool strcontains(char* line, char* keyword, bool case_sensitivity);
+static void grep_buffer(const char* begin, const char* end, const char* keyword, FILE* out, bool case_sensitivity);
+static const char* find_keyword(const char* begin, const char* end, const char* keyword, size_t length,
+                                bool case_sensitivity);
+static inline unsigned char fold(unsigned char c);
 static void ERROR_EXIT(char* message);
 static void USAGE(void);
 
@@ -67,7 +70,12 @@ int main(int argc, char **argv) {
     // Get keyword from args
     char* keyword = argv[argind];
     argind++;
-    
+    if (case_sensitivity == false) {
+        for (size_t i = 0; keyword[i]; i++) {
+            keyword[i] = fold(keyword[i]);
+        }
+    }
+
     // Call function on input args (or stdin if no args given)
     FILE* in = stdin;
     if (argind == argc || argc == 1) { 
@@ -97,65 +105,172 @@ int main(int argc, char **argv) {
 /**
  * @brief Reduced variation of the Unix-command grep. Reads in several files and 
  * prints all lines containing a keyword.
+ * The file is read in blocks of READ_BLOCK_SIZE bytes, each block is searched up to
+ * its last complete line and the rest is moved to the front of the buffer.
  * 
- * @param keyword keyword to search for
+ * @param keyword keyword to search for (lower case if the search is case-insensitive)
  * @param in file to read from
  * @param out file to write output to
  * @param case_sensitivity defines whether search should be case-sensitive
  */
 static void mygrep(char* keyword, FILE* in, FILE* out, bool case_sensitivity) {
-    char* line = NULL;
-    size_t len, buflen;
-
-    while ((len = getline(&line, &buflen, in)) != -1) {
-
-        // search string for occurences of keyword
-        char* _line = strdup(line);
-        if (_line == NULL) ERROR_EXIT(strerror(errno));
-        char* _keyword = strdup(keyword);
-        if (_keyword == NULL) ERROR_EXIT(strerror(errno));
-
-
-        bool result = strcontains(_line, _keyword, case_sensitivity);
-        
-        if (result == true) {
-            if (fputs(line, out) == EOF) {
-                free(_keyword);
-                free(_line);
-                free(line);
-                ERROR_EXIT("fputs failed");
+    size_t size = READ_BLOCK_SIZE, filled = 0;
+    char* buffer = malloc(size);
+    if (buffer == NULL) ERROR_EXIT(strerror(errno));
+
+    ssize_t len;
+    do {
+        len = read(fileno(in), buffer + filled, size - filled);
+        if (len == -1) {
+            if (errno == EINTR) continue;
+            free(buffer);
+            ERROR_EXIT(strerror(errno));
+        }
+        filled += len;
+
+        // search all complete lines (everything at the end of the file)
+        const char* complete = buffer + filled;
+        if (len != 0) {
+            while (complete > buffer && complete[-1] != '\n') complete--;
+        }
+        grep_buffer(buffer, complete, keyword, out, case_sensitivity);
+
+        filled = buffer + filled - complete;
+        memmove(buffer, complete, filled);
+
+        // a line longer than the buffer
+        if (filled == size) {
+            size *= 2;
+            char* grown = realloc(buffer, size);
+            if (grown == NULL) {
+                free(buffer);
+                ERROR_EXIT(strerror(errno));
             }
+            buffer = grown;
         }
+    } while (len != 0);
+
+    free(buffer);
+}
+
+/**
+ * @brief Prints all lines of a buffer containing a keyword. The buffer is searched as a
+ * whole, only the lines of the occurences are located.
+ * 
+ * @param begin start of the buffer (start of a line)
+ * @param end end of the buffer (end of a line)
+ * @param keyword keyword to search for (lower case if the search is case-insensitive)
+ * @param out file to write output to
+ * @param case_sensitivity defines whether search should be case-sensitive
+ */
+static void grep_buffer(const char* begin, const char* end, const char* keyword, FILE* out, bool case_sensitivity) {
+    size_t length = strlen(keyword);
+
+    // a keyword with a newline before its end is never part of a line
+    const char* newline = strchr(keyword, '\n');
+    if (newline != NULL && newline[1] != '\0') return;
 
-        free(_keyword);
-        free(_line);
-        free(line);
-        buflen = 0;
-    } 
+    const char* match;
+    while (begin < end && (match = find_keyword(begin, end, keyword, length, case_sensitivity)) != NULL) {
+        const char* line = match;
+        while (line > begin && line[-1] != '\n') line--;
+        const char* line_end = memchr(match + length - 1, '\n', end - (match + length - 1));
+        line_end = (line_end == NULL) ? end : line_end + 1;
 
-    free(line);
+        if (fwrite(line, 1, line_end - line, out) != (size_t) (line_end - line)) {
+            ERROR_EXIT("fwrite failed");
+        }
+        begin = line_end;
+    }
+}
+
+/**
+ * @brief Lower case of an ASCII character (like tolower in the C locale)
+ */
+static inline unsigned char fold(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? (c | 0x20) : c;
 }
 
 /**
- * @brief Checks if a line contains a keyword and returns the result
+ * @brief Checks the characters between the first and the last character of the keyword
  * 
- * @param line string to search in
- * @param keyword keyword to search for
+ * @param text position in the buffer
+ * @param keyword keyword to compare
+ * @param length length of the keyword
+ * @param case_sensitivity whether the comparison should be case-sensitive
+ * @return true if the keyword occurs at text
+ */
+static inline bool matches_middle(const char* text, const char* keyword, size_t length, bool case_sensitivity) {
+    if (case_sensitivity == true) {
+        return length <= 2 || memcmp(text + 1, keyword + 1, length - 2) == 0;
+    }
+    for (size_t i = 1; i + 1 < length; i++) {
+        if (fold(text[i]) != (unsigned char) keyword[i]) return false;
+    }
+    return true;
+}
+
+#ifdef __SSE2__
+/**
+ * @brief Lower case of 16 ASCII characters (the signed compare leaves bytes >= 0x80 alone)
+ */
+static inline __m128i fold_vector(__m128i chars) {
+    __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(chars, _mm_set1_epi8('A' - 1)),
+                                  _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), chars));
+    return _mm_or_si128(chars, _mm_and_si128(upper, _mm_set1_epi8(0x20)));
+}
+#endif
+
+/**
+ * @brief Searches a buffer for the first occurence of a keyword. 16 positions are
+ * checked at once for the first and the last character of the keyword, only those
+ * candidates are compared completely. The case is folded while comparing.
+ * 
+ * @param begin start of the buffer
+ * @param end end of the buffer
+ * @param keyword keyword to search for (lower case if the search is case-insensitive)
+ * @param length length of the keyword (at least 1)
  * @param case_sensitivity whether search should be case-sensitive
- * @return true if line contains keyword
- * @return false if line does not contain keyword
+ * @return the first occurence, NULL if there is none
  */
-static bool strcontains(char* line, char* keyword, bool case_sensitivity) {
-    if (case_sensitivity == false) {
-        for (size_t i = 0; keyword[i]; i++) {
-            keyword[i] = tolower(keyword[i]);
+static const char* find_keyword(const char* begin, const char* end, const char* keyword, size_t length,
+                                bool case_sensitivity) {
+    if ((size_t) (end - begin) < length) return NULL;
+
+    const char* last_start = end - length;
+    const char* pos = begin;
+    unsigned char first = keyword[0], last = keyword[length - 1];
+
+#ifdef __SSE2__
+    __m128i first_vector = _mm_set1_epi8((char) first);
+    __m128i last_vector = _mm_set1_epi8((char) last);
+    for (; last_start - pos >= 15; pos += 16) {
+        __m128i firsts = _mm_loadu_si128((const __m128i*) pos);
+        __m128i lasts = _mm_loadu_si128((const __m128i*) (pos + length - 1));
+        if (case_sensitivity == false) {
+            firsts = fold_vector(firsts);
+            lasts = fold_vector(lasts);
         }
-        for (size_t i = 0; line[i]; i++) {
-            line[i] = tolower(line[i]);
+
+        unsigned int candidates = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(firsts, first_vector),
+                                                                  _mm_cmpeq_epi8(lasts, last_vector)));
+        while (candidates != 0) {
+            const char* candidate = pos + __builtin_ctz(candidates);
+            if (matches_middle(candidate, keyword, length, case_sensitivity)) return candidate;
+            candidates &= candidates - 1;
         }
     }
+#endif
 
-    return (strstr(line, keyword) != NULL);
+    for (; pos <= last_start; pos++) {
+        unsigned char c1 = pos[0], c2 = pos[length - 1];
+        if (case_sensitivity == false) {
+            c1 = fold(c1);
+            c2 = fold(c2);
+        }
+        if (c1 == first && c2 == last && matches_middle(pos, keyword, length, case_sensitivity)) return pos;
+    }
+    return NULL;
 }
 
 static void ERROR_EXIT(char* message) {
@@ -8,5 +8,11 @@
 #include <errno.h>
 #include <ctype.h>
 #include <string.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define READ_BLOCK_SIZE (1 << 20)
 
 #endif
\ No newline at end of file
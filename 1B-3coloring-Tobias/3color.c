@@ -9,93 +9,90 @@
 #include "3color.h"
 
 
-/** For documentation see 3color.h - initializeSharedMemoryAsServer & initializeSharedMemoryAsClient
- *  The function alternates between the described functionalities depending on the value of asServer. */
-static inline void initializeSharedMemory(int *shared_memory_fd_out, shared_memory_t **shared_memory_out, bool asServer)
-{
-    int openingOption = asServer ? OPEN_SHM_OPTION_SERVER : OPEN_SHM_OPTION_CLIENT;
-    *shared_memory_fd_out = shm_open(SHARED_MEMORY_NAME, openingOption, OPEN_SHM_MODE);
-    exitOnFailure(*shared_memory_fd_out, asServer ? OPENING_SHM_ERROR_SERVER : OPENING_SHM_ERROR_CLIENT);
-
-    if (asServer)
-        exitOnFailure(ftruncate(*shared_memory_fd_out, sizeof(shared_memory_t)), TRUNCATING_SHM_ERROR);
-
-    *shared_memory_out = mmap(NULL, sizeof(shared_memory_t), SHM_MAP_PROT, SHM_MAP_FLAGS, *shared_memory_fd_out, MAPPING_SHM_OFFSET);
-    if (*shared_memory_out == MAP_FAILED)
-        printErrnoAndTerminate(MAPPING_SHM_ERROR);
-}
-
-/** For documentation see 3color.h - cleanupSharedMemoryAsServer & cleanupSharedMemoryAsClient
- *  The function alternates between the described functionalities depending on the value of asServer. */
-static inline void cleanupSharedMemory(int shared_memory_fd, shared_memory_t *shared_memory, bool asServer)
-{
-    exitOnFailure(munmap(shared_memory, sizeof(*shared_memory)), UNMAPPING_SHM_ERROR);
-    exitOnFailure(close(shared_memory_fd), CLOSING_SHM_ERROR);
+/** For documentation see 3color.h */
+void initializeSharedMemoryAsServer(shared_memory_t **shared_memory_out) {
+    struct shmring_config config = { .record_size = sizeof(solution_t), .capacity = SOLUTION_BUFFER_SIZE };
 
-    if (asServer)
-        exitOnFailure(shm_unlink(SHARED_MEMORY_NAME), UNLINKING_SHM_ERROR);
+    *shared_memory_out = shmring_create(SHARED_MEMORY_NAME, &config);
+    if (*shared_memory_out == NULL)
+        printErrnoAndTerminate(OPENING_SHM_ERROR_SERVER);
 }
 
-/** For documentation see 3color.h - initializeSemaphoreAsServer & initializeSemaphoreAsClient
- *  The function alternates between the described functionalities depending on the value of asServer. */
-static inline void initializeSemaphore(sem_t **semaphore_out, const char *semaphoreName, bool asServer, unsigned int initialValue)
-{
-    if (asServer)
-        *semaphore_out = sem_open(semaphoreName, OPEN_SEM_OPTION_SERVER, OPEN_SEM_MODE, initialValue);
-    else
-        *semaphore_out = sem_open(semaphoreName, OPEN_SEM_OPTION_CLIENT);
-
-    if (*semaphore_out == SEM_FAILED)
-        printErrnoAndTerminate(OPENING_SEM_ERROR);
+/** For documentation see 3color.h */
+void initializeSharedMemoryAsClient(shared_memory_t **shared_memory_out) {
+    *shared_memory_out = shmring_open(SHARED_MEMORY_NAME, sizeof(solution_t));
+    if (*shared_memory_out == NULL)
+        printErrnoAndTerminate(OPENING_SHM_ERROR_CLIENT);
 }
 
-/** For documentation see 3color.h - cleanupSemaphoreAsServer & cleanupSemaphoreAsClient
- *  The function alternates between the described functionalities depending on the value of asServer. */
-static inline void cleanupSemaphore(sem_t *semaphore, const char *semaphoreName, bool asServer)
-{
-    exitOnFailure(sem_close(semaphore), CLOSING_SEM_ERROR);
-
-    if (asServer)
-        exitOnFailure(sem_unlink(semaphoreName), UNLINKING_SEM_ERROR);
+/** For documentation see 3color.h
+ *  Closing the ring as its creator also shuts it down and unlinks it. */
+void cleanupSharedMemoryAsServer(shared_memory_t *shared_memory) {
+    exitOnFailure(shmring_close(shared_memory), CLOSING_SHM_ERROR);
 }
 
+/** For documentation see 3color.h */
+void cleanupSharedMemoryAsClient(shared_memory_t *shared_memory) {
+    exitOnFailure(shmring_close(shared_memory), CLOSING_SHM_ERROR);
+}
 
 /** For documentation see 3color.h */
-void initializeSharedMemoryAsServer(int *shared_memory_fd_out, shared_memory_t **shared_memory_out) {
-    initializeSharedMemory(shared_memory_fd_out, shared_memory_out, true);
+bool isShutdownRequested(shared_memory_t *shared_memory) {
+    return !shmring_alive(shared_memory);
 }
 
 /** For documentation see 3color.h */
-void initializeSharedMemoryAsClient(int *shared_memory_fd_out, shared_memory_t **shared_memory_out) {
-    initializeSharedMemory(shared_memory_fd_out, shared_memory_out, false);
+int readSolutionFromShm(shared_memory_t *shared_memory, solution_t *solution_out) {
+    if (shmring_read(shared_memory, solution_out, NULL) == -1) {
+        if (errno == EINTR) return -1;
+        else printErrnoAndTerminate(READING_SHM_ERROR);
+    }
+
+    if (solution_out->numberOfEdges < 0 || solution_out->numberOfEdges > MAX_SOLUTION_SIZE) // never trust a client
+        solution_out->numberOfEdges = MAX_SOLUTION_SIZE + 1;
+    return 0;
 }
 
 /** For documentation see 3color.h */
-void cleanupSharedMemoryAsServer(int shared_memory_fd, shared_memory_t *shared_memory) {
-    cleanupSharedMemory(shared_memory_fd, shared_memory, true);
+int writeSolutionToShm(shared_memory_t *shared_memory, const solution_t *solution) {
+    if (shmring_write(shared_memory, solution, sizeof(*solution)) == -1) {
+        if (errno == EINTR || errno == ECANCELED) return -1;
+        else printErrnoAndTerminate(WRITING_SHM_ERROR);
+    }
+    return 0;
 }
 
 /** For documentation see 3color.h */
-void cleanupSharedMemoryAsClient(int shared_memory_fd, shared_memory_t *shared_memory) {
-    cleanupSharedMemory(shared_memory_fd, shared_memory, false);
+void writeBestSolution(shared_memory_t *shared_memory, const solution_t *solution) {
+    shmring_set_best(shared_memory, solution->numberOfEdges, solution, sizeof(*solution));
 }
 
 /** For documentation see 3color.h */
-void initializeSemaphoreAsServer(sem_t **semaphore_out, const char *semaphoreName, unsigned int initialValue) {
-    initializeSemaphore(semaphore_out, semaphoreName, true, initialValue);
+int8_t readBestSolutionSize(shared_memory_t *shared_memory) {
+    uint64_t bound = shmring_best_bound(shared_memory);
+    return bound > MAX_SOLUTION_SIZE ? MAX_SOLUTION_SIZE + 1 : (int8_t) bound;
 }
 
 /** For documentation see 3color.h */
-void initializeSemaphoreAsClient(sem_t **semaphore_out, const char *semaphoreName) {
-    initializeSemaphore(semaphore_out, semaphoreName, false, 0); // initialValue ignored for clients
+void publishGraphAsServer(const char *path, shared_graph_t **shared_graph_out) {
+    struct shmgraph_edge *edges;
+    size_t numberOfEdges;
+    exitOnFailure(shmgraph_load(path, &edges, &numberOfEdges), LOADING_GRAPH_ERROR);
+
+    *shared_graph_out = shmgraph_create(GRAPH_SHARED_MEMORY_NAME, edges, numberOfEdges);
+    if (*shared_graph_out == NULL)
+        printErrnoAndTerminate(PUBLISHING_GRAPH_ERROR);
+    free(edges);
 }
 
 /** For documentation see 3color.h */
-void cleanupSemaphoreAsServer(sem_t *semaphore, const char *semaphoreName) {
-    cleanupSemaphore(semaphore, semaphoreName, true);
+void openGraphAsClient(shared_graph_t **shared_graph_out) {
+    *shared_graph_out = shmgraph_open(GRAPH_SHARED_MEMORY_NAME);
+    if (*shared_graph_out == NULL)
+        printErrnoAndTerminate(OPENING_GRAPH_ERROR_CLIENT);
 }
 
 /** For documentation see 3color.h */
-void cleanupSemaphoreAsClient(sem_t *semaphore) {
-    cleanupSemaphore(semaphore, NULL, false);
+void cleanupGraph(shared_graph_t *shared_graph) {
+    exitOnFailure(shmgraph_close(shared_graph), CLOSING_GRAPH_ERROR);
 }
@@ -10,12 +10,10 @@
 #define _3COLOR_H
 
 //region INCLUDES
-#include <fcntl.h>
-#include <sys/mman.h>
-#include <sys/stat.h>
 #include <unistd.h>
-#include <semaphore.h>
 #include <signal.h>
+#include "shmring.h"
+#include "shmgraph.h"
 #include "util.h"
 //endregion
 
@@ -25,47 +23,25 @@
 
 //region SHARED MEMORY OPTIONS
 #define MAX_SOLUTION_SIZE        8  //for values too big for an int8 adjust type of solution_t.numberOfEdges
-#define SOLUTION_BUFFER_SIZE     10 //for values too big for an int8 adjust type of shared_memory_t.currentWriteIndex
+#define SOLUTION_BUFFER_SIZE     10 //number of solutions the ring in the shared memory holds
 #define SOLUTION_EDGE_ARRAY_SIZE sizeof(((solution_t *)0)->edges)
 
 #define SHARED_MEMORY_NAME     "/01525369_3colorBuffer"
-#define OPEN_SHM_MODE          S_IRWXU                // NOLINT(hicpp-signed-bitwise)
-#define SHM_MAP_PROT           PROT_READ | PROT_WRITE // NOLINT(hicpp-signed-bitwise)
-#define SHM_MAP_FLAGS          MAP_SHARED
-#define MAPPING_SHM_OFFSET     0
-#define OPEN_SHM_OPTION_SERVER O_CREAT | O_RDWR       // NOLINT(hicpp-signed-bitwise)
-#define OPEN_SHM_OPTION_CLIENT O_RDWR
-//endregion
-
-//region SEMAPHORE OPTIONS
-#define FREE_SPACE_SEM_NAME "/01525369_freeSpaceSem"
-#define FREE_SPACE_SEM_INIT MAX_SOLUTION_SIZE
-
-#define USED_SPACE_SEM_NAME "/01525369_usedSpaceSem"
-#define USED_SPACE_SEM_INIT 0
-
-#define EXCL_WRITE_SEM_NAME "/01525369_mutuallyExclusiveWriteSem"
-#define EXCL_WRITE_SEM_INIT 1
-
-#define OPEN_SEM_MODE          S_IRWXU // NOLINT(hicpp-signed-bitwise)
-#define OPEN_SEM_OPTION_CLIENT O_RDWR
-#define OPEN_SEM_OPTION_SERVER O_CREAT | O_RDWR // NOLINT(hicpp-signed-bitwise)
+#define GRAPH_SHARED_MEMORY_NAME "/01525369_3colorGraph" // the graph the supervisor loads with -g FILE
 //endregion
 
 //region ERROR_MESSAGES
 #define OPENING_SHM_ERROR_SERVER "Creating shared memory failed"
 #define OPENING_SHM_ERROR_CLIENT "Opening shared memory failed. Ensure a supervisor is running"
 
-#define TRUNCATING_SHM_ERROR "Initializing shared memory failed"
-#define MAPPING_SHM_ERROR    "Mapping shared memory failed"
-
-#define CLOSING_SHM_ERROR    "Closing shared memory file failed"
-#define UNMAPPING_SHM_ERROR  "Unmapping shared memory failed"
-#define UNLINKING_SHM_ERROR  "Unlinking shared memory failed"
+#define LOADING_GRAPH_ERROR        "Loading the graph file failed"
+#define PUBLISHING_GRAPH_ERROR     "Publishing the graph failed"
+#define OPENING_GRAPH_ERROR_CLIENT "Opening the graph failed. Ensure the supervisor was started with -g FILE"
+#define CLOSING_GRAPH_ERROR        "Closing the graph failed"
 
-#define OPENING_SEM_ERROR   "Opening semaphore failed"
-#define CLOSING_SEM_ERROR   "Closing semaphore failed"
-#define UNLINKING_SEM_ERROR "Unlinking semaphore failed"
+#define CLOSING_SHM_ERROR    "Closing shared memory failed"
+#define READING_SHM_ERROR    "Reading from shared memory failed"
+#define WRITING_SHM_ERROR    "Writing to shared memory failed"
 //endregion
 //endregion
 
@@ -85,106 +61,127 @@ typedef struct {
     int8_t numberOfEdges; // type must be adjusted if MAX_SOLUTION_SIZE gets too big for an int8
 } solution_t;
 
-typedef struct {
-    bool       shutdownRequested;
-    int8_t     currentWriteIndex; // type must be adjusted if SOLUTION_BUFFER_SIZE gets too big for an int8
-    solution_t solutions[SOLUTION_BUFFER_SIZE];
-} shared_memory_t;
+typedef struct shmring shared_memory_t; // the ring of the shmring module, which also holds the best solution and the shutdown flag
+typedef struct shmgraph shared_graph_t;  // the read-only graph of the shmgraph module
 //endregion
 
 //region DECLARATIONS
 /**
  * @brief Creates and initializes a shared memory.
- * @details Calls the functions shm_open(3), ftruncate(2) and mmap(2) with the above specified options
- *          (see section SHARED MEMORY OPTIONS) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of any of those functions
- *          and prints the corresponding error.
+ * @details Creates a ring (see shmring.h) with SOLUTION_BUFFER_SIZE slots for solutions under the name specified above
+ *          (see section SHARED MEMORY OPTIONS). Its backend is chosen by the environment variable SHMRING_BACKEND.
+ *          Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
  *
- * @param shared_memory_fd_out The pointer that should point to the created file descriptor.
- * @param shared_memory_out    The pointer that should point to a pointer pointing to the created shared memory.
+ * @param shared_memory_out The pointer that should point to a pointer pointing to the created shared memory.
  */
-void initializeSharedMemoryAsServer(int *shared_memory_fd_out, shared_memory_t **shared_memory_out);
+void initializeSharedMemoryAsServer(shared_memory_t **shared_memory_out);
 
 /**
  * @brief Opens a shared memory in a client.
- * @details Calls the functions shm_open(3) and mmap(2) with the above specified options
- *          (see section SHARED MEMORY OPTIONS) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of any of those functions
- *          and prints the corresponding error.
+ * @details Opens the ring created by a server.
+ *          Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
  *
- * @param shared_memory_fd_out The pointer that should point to the created file descriptor.
- * @param shared_memory_out    The pointer that should point to a pointer pointing to the shared memory.
+ * @param shared_memory_out The pointer that should point to a pointer pointing to the shared memory.
  */
-void initializeSharedMemoryAsClient(int *shared_memory_fd_out, shared_memory_t **shared_memory_out);
+void initializeSharedMemoryAsClient(shared_memory_t **shared_memory_out);
 
 /**
  * @brief Closes and deletes a shared memory.
- * @details Calls the functions munmap(2), close(2) and shm_unlink(3) with the above specified options
- *          (see section SHARED MEMORY OPTIONS) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of any of those functions
- *          and prints the corresponding error.
+ * @details Requests the shutdown of all clients, which wakes up the ones waiting for free space, and removes the
+ *          shared memory. Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
  *
- * @param shared_memory_fd The file descriptor corresponding to the shared memory.
- * @param shared_memory    The pointer to the shared memory that should be released.
+ * @param shared_memory The pointer to the shared memory that should be released.
  */
-void cleanupSharedMemoryAsServer(int shared_memory_fd, shared_memory_t *shared_memory);
+void cleanupSharedMemoryAsServer(shared_memory_t *shared_memory);
 
 
 /**
  * @brief Closes a shared memory created by a server.
- * @details Calls the functions munmap(2) and close(2) with the above specified options
- *          (see section SHARED MEMORY OPTIONS) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of any of those functions
- *          and prints the corresponding error.
+ * @details Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
  *
- * @param shared_memory_fd The file descriptor corresponding to the shared memory.
- * @param shared_memory    The pointer to the shared memory that should be closed.
+ * @param shared_memory The pointer to the shared memory that should be closed.
  */
-void cleanupSharedMemoryAsClient(int shared_memory_fd, shared_memory_t *shared_memory);
+void cleanupSharedMemoryAsClient(shared_memory_t *shared_memory);
 
 /**
- * @brief Creates and initializes a semaphore.
- * @details Calls the function sem_open(3) with the additional arguments mode and value to do so.
- *          Mode and oflag are set as specified in section SEMAPHORE OPTIONS above.
- *          Terminates the program with EXIT_FAILURE upon failure of sem_open and prints the corresponding error.
- *
- * @param semaphore_out The pointer that should point to a pointer pointing to the created semaphore.
- * @param semaphoreName The name of the semaphore. For details about its construction, see sem_overview(7).
- * @param initialValue  The value that the created semaphore should initially posses.
+ * @brief Checks whether the supervisor requested a shutdown.
+ *
+ * @param shared_memory The shared memory.
+ *
+ * @return true once the supervisor shut the shared memory down, otherwise false.
  */
-void initializeSemaphoreAsServer(sem_t **semaphore_out, const char *semaphoreName, unsigned int initialValue);
+bool isShutdownRequested(shared_memory_t *shared_memory);
 
 /**
- * @brief Opens a semaphore created by a server.
- * @details Calls the function sem_open(3) with name and oflag arguments.
- *          oflag is set as specified in section SEMAPHORE OPTIONS above.
- *          Terminates the program with EXIT_FAILURE upon failure of sem_open and prints the corresponding error.
+ * @brief Reads the next solution from the shared memory.
+ * @details Blocks until a generator wrote a solution. Must only be called by the supervisor.
  *
- * @param semaphore_out The pointer that should point to a pointer pointing to the opened semaphore.
- * @param semaphoreName The name of the semaphore. For details about its construction, see sem_overview(7).
+ * @param shared_memory The shared memory.
+ * @param solution_out  The pointer the solution is copied to.
+ *
+ * @return 0 upon success, -1 if waiting was interrupted by a signal (errno is EINTR).
+ *         Terminates the program with EXIT_FAILURE upon any other failure and prints the corresponding error.
  */
-void initializeSemaphoreAsClient(sem_t **semaphore_out, const char *semaphoreName);
+int readSolutionFromShm(shared_memory_t *shared_memory, solution_t *solution_out);
 
 /**
- * @brief Closes and deletes a semaphore.
- * @details Calls the functions sem_close(3) and sem_unlink(3) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of any of those functions
- *          and prints the corresponding error.
+ * @brief Writes a solution to the shared memory.
+ * @details Blocks until there is free space for it.
+ *
+ * @param shared_memory The shared memory.
+ * @param solution      The solution that is to be written.
  *
- * @param semaphore     A pointer to the semaphore.
- * @param semaphoreName The name of the semaphore.
+ * @return 0 upon success, -1 if a shutdown was requested or waiting was interrupted by a signal.
+ *         Terminates the program with EXIT_FAILURE upon any other failure and prints the corresponding error.
  */
-void cleanupSemaphoreAsServer(sem_t *semaphore, const char *semaphoreName);
+int writeSolutionToShm(shared_memory_t *shared_memory, const solution_t *solution);
 
+/**
+ * @brief Publishes a solution as the best one the supervisor received.
+ * @details The solution and its number of edges are stored in the best-bound slot of the ring. Must only be called by
+ *          the supervisor.
+ *
+ * @param shared_memory The shared memory holding the best solution.
+ * @param solution      The new best solution.
+ */
+void writeBestSolution(shared_memory_t *shared_memory, const solution_t *solution);
+
+/**
+ * @brief Reads the number of edges of the best solution the supervisor received.
+ *
+ * @param shared_memory The shared memory holding the best solution.
+ *
+ * @return The number of edges, MAX_SOLUTION_SIZE + 1 as long as there is no solution.
+ */
+int8_t readBestSolutionSize(shared_memory_t *shared_memory);
+
+/**
+ * @brief Loads a graph file and publishes it in a read-only shared memory.
+ * @details The file is a text or binary edge list (see shmgraph.h), it is parsed once and stored under
+ *          GRAPH_SHARED_MEMORY_NAME, so generators started without edges don't parse anything. Must be called before
+ *          initializeSharedMemoryAsServer, so a generator that opened the ring always finds the whole graph.
+ *          Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
+ *
+ * @param path             The path of the graph file.
+ * @param shared_graph_out The pointer that should point to a pointer pointing to the published graph.
+ */
+void publishGraphAsServer(const char *path, shared_graph_t **shared_graph_out);
+
+/**
+ * @brief Opens the graph a server published.
+ * @details Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
+ *
+ * @param shared_graph_out The pointer that should point to a pointer pointing to the graph.
+ */
+void openGraphAsClient(shared_graph_t **shared_graph_out);
 
 /**
- * @brief Closes a semaphore created by a server.
- * @details Calls the function sem_close(3) to do so.
- *          Terminates the program with EXIT_FAILURE upon failure of sem_close and prints the corresponding error.
+ * @brief Closes a graph, the server also removes it.
+ * @details Terminates the program with EXIT_FAILURE upon failure and prints the corresponding error.
  *
- * @param semaphore A pointer to the semaphore.
+ * @param shared_graph The pointer to the graph that should be closed.
  */
-void cleanupSemaphoreAsClient(sem_t *semaphore);
+void cleanupGraph(shared_graph_t *shared_graph);
 //endregion
 
 #endif //_3COLOR_H
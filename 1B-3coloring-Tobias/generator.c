@@ -5,10 +5,12 @@
  *
  * @brief Contains the main functionality of the 3color - Generator program.
  *
- * @details The Generator accepts a number of edges defining a graph, opens the shared memory and semaphores
+ * @details The Generator accepts a number of edges defining a graph, opens the shared memory
  *          initialized by a supervisor, generates new solutions for the given graph repeatedly and
- *          writes every new solution to the shared memory.
+ *          writes every new solution that is better than the best one the supervisor received so far
+ *          (see readBestSolutionSize) to the shared memory.
  *          The program shuts down when the supervisors sets the corresponding flag in the shared memory.
+ *          Without edges the generator maps the graph the supervisor loaded with -g FILE, so nothing is parsed.
  **/
 // It was chosen to make the generator only accept 2 edges or more, since that guarantees that there are at least 3 nodes in the graph.
 // It was also deliberately chosen to let the generator accept graphs such as 0-1 2-3, where not all nodes are connected,
@@ -22,33 +24,54 @@
 
 #define NUMBER_OF_NECESSARY_EDGES 2
 
+#define COLORINGS_PER_BATCH 64 // one coloring per bit of a uint64_t
+#define COUNTER_BITS        4  // bits of the counters of removed edges, must hold MAX_SOLUTION_SIZE + 1
+
 #define INPUT_ARGUMENT_NUMBER_ERROR "A valid input graph needs at least 3 nodes. SYNOPSIS: generator EDGE1 ... EDGEn (EXAMPLE: generator 0-1 1-2)"
 #define INPUT_ARGUMENT_FORMAT_ERROR "Valid edges (format %lu-%lu) are the only allowed parameters. SYNOPSIS: generator EDGE1 ... EDGEn (EXAMPLE: generator 0-1 1-2)"
 
 /** The program name as specified in argumentValues[0]. This variable is declared in util.h */
 char *programName_g;
 
+/**
+ * @brief The input graph in the form the colorings are evaluated on.
+ * @details The colors are bit-sliced: bit l of lowColorBits[n] and highColorBits[n] are the lower and the
+ *          higher bit of the color of node n in coloring l of the current batch.
+ */
+typedef struct {
+    edge_t   *edges;
+    int      numberOfEdges;
+    int      *edgeNodePositions; // positions of both nodes of edge i in the node arrays at 2*i and 2*i+1
+    int      numberOfNodes;
+    uint64_t *lowColorBits;
+    uint64_t *highColorBits;
+} graph_t;
+
 
 static inline void tryParseArguments(int argumentCounter, char *argumentValues[],
                                      edge_t *edges_out[], int *numberOfEdges_out,
                                      node_t *nodes_out[], int *numberOfNodes_out);
 
-static inline int generateSolution(node_t *nodes, int numberOfNodes, edge_t *edges, int numberOfEdges,
-                                   solution_t *solution_out);
+static inline void createGraph(node_t *nodes, int numberOfNodes, edge_t *edges, int numberOfEdges, graph_t *graph_out);
 
-static inline void writeSolutionToShm(shared_memory_t *shared_memory, solution_t *solution);
+static inline void createGraphFromShm(const struct shmgraph_view *view, graph_t *graph_out);
+
+static inline int generateSolution(graph_t *graph, int8_t maxNumberOfEdges, solution_t *solution_out);
+
+static inline int8_t getMaxNumberOfEdges(shared_memory_t *shared_memory);
 
 
 /**
  * @brief The entry point of the generator program.
  * @details This function executes the whole program.
  *          It calls upon other functions to verify and parse the program arguments,
- *          opens the shared memory and all semaphores initialized by a supervisor and generates new solutions.
+ *          opens the shared memory initialized by a supervisor and generates new solutions.
  *
  * global variables used: programName_g - The program name as declared in util.h and specified in argumentValues[0]
  *
  * @param argumentCounter The argument counter.
- * @param argumentValues  The argument values. Must contain only valid edges (format %ul-%ul) and at least 2 of them.
+ * @param argumentValues  The argument values. Must contain only valid edges (format %ul-%ul) and at least 2 of them,
+ *                        or none if the supervisor was started with -g FILE.
  *
  * @return Returns EXIT_SUCCESS upon success or EXIT_FAILURE upon failure.
  */
@@ -57,57 +80,53 @@ int main(int argumentCounter, char *argumentValues[]) {
     //region INIT
     programName_g = argumentValues[0];
 
-    node_t *nodes;
-    int numberOfNodes;
-    edge_t *edges;
-    int numberOfEdges;
-    tryParseArguments(argumentCounter, argumentValues, &edges, &numberOfEdges, &nodes, &numberOfNodes);
-
-    int shared_memory_fd;
     shared_memory_t *solutionBuffer;
-    initializeSharedMemoryAsClient(&shared_memory_fd, &solutionBuffer);
+    shared_graph_t *sharedGraph = NULL;
+    graph_t graph;
+    if (argumentCounter == 1) // no edges, the graph the supervisor loaded with -g FILE is used
+    {
+        initializeSharedMemoryAsClient(&solutionBuffer); // the supervisor publishes the graph before the ring
+        openGraphAsClient(&sharedGraph);
+        createGraphFromShm(shmgraph_view(sharedGraph), &graph);
+    }
+    else
+    {
+        node_t *nodes;
+        int numberOfNodes;
+        edge_t *edges;
+        int numberOfEdges;
+        tryParseArguments(argumentCounter, argumentValues, &edges, &numberOfEdges, &nodes, &numberOfNodes);
 
-    sem_t *freeSpaceSemaphore;
-    sem_t *usedSpaceSemaphore;
-    sem_t *exclWriteSemaphore;
-    initializeSemaphoreAsClient(&freeSpaceSemaphore, FREE_SPACE_SEM_NAME);
-    initializeSemaphoreAsClient(&usedSpaceSemaphore, USED_SPACE_SEM_NAME);
-    initializeSemaphoreAsClient(&exclWriteSemaphore, EXCL_WRITE_SEM_NAME);
+        createGraph(nodes, numberOfNodes, edges, numberOfEdges, &graph);
+        free(nodes);
+
+        initializeSharedMemoryAsClient(&solutionBuffer);
+    }
 
     srand(getpid()); // Initialize random number generator
     // endregion
 
-    while(!solutionBuffer->shutdownRequested)
+    while(!isShutdownRequested(solutionBuffer))
     {
         solution_t solution = { .numberOfEdges = 0 };
-        if (generateSolution(nodes, numberOfNodes, edges, numberOfEdges, &solution) != -1)
+        if (generateSolution(&graph, getMaxNumberOfEdges(solutionBuffer), &solution) != -1)
         {
-            if (sem_wait(exclWriteSemaphore) == -1) { // Ensure only this generator edits the shm
-                if (errno == EINTR) continue; // This discards the currently generated solution but since it is not expected to happen frequently that is accepted
-                else printErrnoAndTerminate(EXCL_WRITE_SEM_NAME);
-            }
-
-            if (sem_wait(freeSpaceSemaphore) == -1) { // Ensure there is free space
-                if (errno == EINTR) continue; // This discards the currently generated solution but since it is not expected to happen frequently that is accepted
-                else printErrnoAndTerminate(FREE_SPACE_SEM_NAME);
-            }
-
-            writeSolutionToShm(solutionBuffer, &solution);
+            if (solution.numberOfEdges > getMaxNumberOfEdges(solutionBuffer)) // A better solution arrived meanwhile
+                continue;
 
-            exitOnFailure(sem_post(usedSpaceSemaphore), USED_SPACE_SEM_NAME); // Indicate that a solution was written to the shm
-            exitOnFailure(sem_post(exclWriteSemaphore), EXCL_WRITE_SEM_NAME); // Allow other generators to edit the shm again
+            writeSolutionToShm(solutionBuffer, &solution); // a failed write discards the solution, the loop checks for a shutdown
         }
     }
 
     //region CLEANUP
-    cleanupSharedMemoryAsClient(shared_memory_fd, solutionBuffer);
-
-    cleanupSemaphoreAsClient(freeSpaceSemaphore);
-    cleanupSemaphoreAsClient(usedSpaceSemaphore);
-    cleanupSemaphoreAsClient(exclWriteSemaphore);
-
-    free(nodes);
-    free(edges);
+    cleanupSharedMemoryAsClient(solutionBuffer);
+    if (sharedGraph != NULL)
+        cleanupGraph(sharedGraph);
+
+    free(graph.edgeNodePositions);
+    free(graph.lowColorBits);
+    free(graph.highColorBits);
+    free(graph.edges);
     //endregion
 
     return EXIT_SUCCESS;
@@ -115,30 +134,65 @@ int main(int argumentCounter, char *argumentValues[]) {
 
 
 /**
- * @brief Writes the given solution to the given shared memory and modifies its currentWriteIndex accordingly.
+ * @brief Returns the maximum number of edges a new solution may have to be better than the best one
+ *        the supervisor received so far.
+ *
+ * @param shared_memory A pointer to the shared memory holding the size of the best solution.
+ *
+ * @return The maximum number of edges, at most MAX_SOLUTION_SIZE.
+ */
+static inline int8_t getMaxNumberOfEdges(shared_memory_t *shared_memory)
+{
+    int8_t bestSolutionSize = readBestSolutionSize(shared_memory);
+    if (bestSolutionSize > MAX_SOLUTION_SIZE)
+        return MAX_SOLUTION_SIZE;
+
+    return bestSolutionSize > 0 ? bestSolutionSize - 1 : 0;
+}
+
+/**
+ * @brief Returns 64 random bits.
+ * @details Uses a xorshift64* generator which is seeded with rand() on the first call,
+ *          so it depends on the seed set with srand.
  *
- * @param shared_memory A pointer to the shared memory the solution is to be written to.
- * @param solution      A pointer to the solution that is to be written.
+ * @return The random bits.
  */
-static inline void writeSolutionToShm(shared_memory_t *shared_memory, solution_t *solution)
+static inline uint64_t getRandomBits(void)
 {
-    memcpy((shared_memory->solutions)[shared_memory->currentWriteIndex].edges, solution->edges, SOLUTION_EDGE_ARRAY_SIZE);
-    (shared_memory->solutions)[shared_memory->currentWriteIndex].numberOfEdges = solution->numberOfEdges;
+    static uint64_t state = 0;
+    while (state == 0) {
+        for (int i = 0; i < 4; i++)
+            state = (state << 16) | (rand() & 0xffff); // NOLINT(cert-msc30-c, cert-msc50-cpp) RAND_MAX may be 32767
+    }
 
-    if (++(shared_memory->currentWriteIndex) == MAX_SOLUTION_SIZE)
-        shared_memory->currentWriteIndex = 0;
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * UINT64_C(2685821657736338717);
 }
 
 /**
- * @brief Assigns a random 'color' (0,1 or 2) to each node in a given array of nodes.
+ * @brief Assigns a random 'color' (0,1 or 2) to each node of the given graph in each of the COLORINGS_PER_BATCH
+ *        colorings.
+ * @details Colorings that got the invalid 'color' 3 for a node get a new one for it, so all colors are equally likely.
  *
- * @param nodes         A pointer to the nodes that should have a new color assigned to them.
- * @param numberOfNodes The number of nodes stored at the given address.
+ * @param graph A pointer to the graph whose nodes should have new colors assigned to them.
  */
-static inline void colorNodesRandomly(node_t *nodes, int numberOfNodes)
+static inline void colorNodesRandomly(graph_t *graph)
 {
-    for (int i = 0; i < numberOfNodes; i++)
-        nodes[i].color = (rand() % 3); // NOLINT(cert-msc30-c, cert-msc50-cpp)
+    for (int i = 0; i < graph->numberOfNodes; i++)
+    {
+        uint64_t low  = getRandomBits();
+        uint64_t high = getRandomBits();
+        uint64_t invalid;
+        while ((invalid = low & high) != 0) {
+            low  = (low & ~invalid) | (getRandomBits() & invalid);
+            high = (high & ~invalid) | (getRandomBits() & invalid);
+        }
+
+        graph->lowColorBits[i]  = low;
+        graph->highColorBits[i] = high;
+    }
 }
 
 /**
@@ -162,41 +216,136 @@ static inline node_t* getNodePtr(node_t *nodes, int numberOfNodes, unsigned long
 }
 
 /**
- * @brief This function accepts a graph in the form of a number of nodes and edges and generates
- *        a set of edges (a solution_t) that can be removed to make it 3-colorable.
- * @details Solutions with more than 3color.h/MAX_SOLUTION_SIZE edges are waived and -1 is returned to indicate this.
+ * @brief Creates the graph the colorings are evaluated on from the parsed nodes and edges.
+ * @details Looks up the positions of the nodes of every edge once, so evaluating a coloring doesn't have to search
+ *          for them. Terminates the program with EXIT_FAILURE if an allocation fails.
  *
  * @param nodes         A pointer to the array of nodes.
  * @param numberOfNodes The number of nodes stored at the given node array.
- * @param edges         A pointer to the array of edges.
+ * @param edges         A pointer to the array of edges, which is used by the graph.
  * @param numberOfEdges The number of edges stored at the given edge array.
- * @param solution_out  A pointer to a solution struct in which the solution is to be stored.
+ * @param graph_out     A pointer to the graph that is to be created.
+ */
+static inline void createGraph(node_t *nodes, int numberOfNodes, edge_t *edges, int numberOfEdges, graph_t *graph_out)
+{
+    graph_out->edges             = edges;
+    graph_out->numberOfEdges     = numberOfEdges;
+    graph_out->numberOfNodes     = numberOfNodes;
+    graph_out->edgeNodePositions = malloc(2 * numberOfEdges * sizeof(int));
+    graph_out->lowColorBits      = malloc(numberOfNodes * sizeof(uint64_t));
+    graph_out->highColorBits     = malloc(numberOfNodes * sizeof(uint64_t));
+    if (graph_out->edgeNodePositions == NULL || graph_out->lowColorBits == NULL || graph_out->highColorBits == NULL)
+        printErrnoAndTerminate("malloc in createGraph failed");
+
+    for (int i = 0; i < numberOfEdges; i++)
+    {
+        graph_out->edgeNodePositions[2 * i]     = getNodePtr(nodes, numberOfNodes, edges[i].firstNodeIndex) - nodes;
+        graph_out->edgeNodePositions[2 * i + 1] = getNodePtr(nodes, numberOfNodes, edges[i].secondNodeIndex) - nodes;
+    }
+}
+
+/**
+ * @brief Creates the graph the colorings are evaluated on from the graph the supervisor published.
+ * @details The vertex indices of the shared graph are the node positions already, only the edges are copied with
+ *          their labels, as the solutions hold those. Terminates the program with EXIT_FAILURE if an allocation fails.
+ *
+ * @param view      The view on the shared graph.
+ * @param graph_out A pointer to the graph that is to be created.
+ */
+static inline void createGraphFromShm(const struct shmgraph_view *view, graph_t *graph_out)
+{
+    graph_out->numberOfEdges     = view->num_edges;
+    graph_out->numberOfNodes     = view->num_vertices;
+    graph_out->edges             = malloc(view->num_edges * sizeof(edge_t));
+    graph_out->edgeNodePositions = malloc(2 * view->num_edges * sizeof(int));
+    graph_out->lowColorBits      = malloc(view->num_vertices * sizeof(uint64_t));
+    graph_out->highColorBits     = malloc(view->num_vertices * sizeof(uint64_t));
+    if (graph_out->edges == NULL || graph_out->edgeNodePositions == NULL ||
+        graph_out->lowColorBits == NULL || graph_out->highColorBits == NULL)
+        printErrnoAndTerminate("malloc in createGraphFromShm failed");
+
+    for (uint32_t i = 0; i < view->num_edges; i++)
+    {
+        graph_out->edges[i].firstNodeIndex      = view->labels[view->edges[i].u];
+        graph_out->edges[i].secondNodeIndex     = view->labels[view->edges[i].v];
+        graph_out->edgeNodePositions[2 * i]     = view->edges[i].u;
+        graph_out->edgeNodePositions[2 * i + 1] = view->edges[i].v;
+    }
+}
+
+/**
+ * @brief This function accepts a graph and generates a set of edges (a solution_t) that can be removed
+ *        to make it 3-colorable.
+ * @details COLORINGS_PER_BATCH random colorings are evaluated at once. Since the colors are bit-sliced, checking an
+ *          edge compares its node colors in all colorings with a few bitwise operations and adds the result to
+ *          bit-sliced counters. A coloring is dropped as soon as it needs more than maxNumberOfEdges edges to be
+ *          removed, the evaluation stops as soon as all colorings are dropped. Of the remaining colorings the one
+ *          with the fewest edges is returned. If there is none -1 is returned.
  *
- * @return -1 if the solution was too big and got waived, otherwise the number of edges in the solution.
+ * @param graph            A pointer to the graph.
+ * @param maxNumberOfEdges The maximum number of edges in a solution, at most 3color.h/MAX_SOLUTION_SIZE.
+ * @param solution_out     A pointer to a solution struct in which the solution is to be stored.
+ *
+ * @return -1 if all solutions were too big and got waived, otherwise the number of edges in the solution.
  */
-static inline int generateSolution(node_t *nodes, int numberOfNodes, edge_t *edges, int numberOfEdges,
-                                   solution_t *solution_out)
+static inline int generateSolution(graph_t *graph, int8_t maxNumberOfEdges, solution_t *solution_out)
 {
     solution_out->numberOfEdges = 0;
-    colorNodesRandomly(nodes, numberOfNodes);
+    colorNodesRandomly(graph);
+
+    const int *positions = graph->edgeNodePositions;
+    const uint64_t *low  = graph->lowColorBits;
+    const uint64_t *high = graph->highColorBits;
+    const int tooMany    = maxNumberOfEdges + 1;
 
-    int i = 0;
-    for (int s = 0; i < numberOfEdges; i++)
+    uint64_t counters[COUNTER_BITS] = { 0 };
+    uint64_t remaining = UINT64_MAX; // colorings that were not dropped yet
+    for (int i = 0; i < graph->numberOfEdges && remaining != 0; i++)
     {
-        int8_t firstNodeColor  = getNodePtr(nodes, numberOfNodes, edges[i].firstNodeIndex)->color;
-        int8_t secondNodeColor = getNodePtr(nodes, numberOfNodes, edges[i].secondNodeIndex)->color;
-        if (firstNodeColor == secondNodeColor)
+        int first  = positions[2 * i];
+        int second = positions[2 * i + 1];
+        uint64_t carry = ~((low[first] ^ low[second]) | (high[first] ^ high[second])) & remaining;
+
+        uint64_t dropped = remaining;
+        for (int b = 0; b < COUNTER_BITS; b++)
         {
-            if (solution_out->numberOfEdges == MAX_SOLUTION_SIZE) // Already found more edges that need to be removed than the allowed amount
-                break;
+            uint64_t nextCarry = counters[b] & carry;
+            counters[b] ^= carry;
+            carry = nextCarry;
+            dropped &= ((tooMany >> b) & 1) ? counters[b] : ~counters[b];
+        }
+        remaining &= ~dropped;
+    }
 
-            memcpy(&(solution_out->edges[s]), &(edges[i]), sizeof(edge_t));
-            solution_out->numberOfEdges++;
-            s++;
+    if (remaining == 0)
+        return -1; // All solutions were too big and got canceled
+
+    int bestColoring = 0;
+    int bestNumberOfEdges = tooMany;
+    for (int c = 0; c < COLORINGS_PER_BATCH; c++)
+    {
+        if (((remaining >> c) & 1) == 0)
+            continue;
+
+        int numberOfEdges = 0;
+        for (int b = 0; b < COUNTER_BITS; b++)
+            numberOfEdges |= (int) ((counters[b] >> c) & 1) << b;
+
+        if (numberOfEdges < bestNumberOfEdges) {
+            bestNumberOfEdges = numberOfEdges;
+            bestColoring = c;
         }
     }
 
-    return i == numberOfEdges ? 0 : -1; // Indicate whether the solution is valid or if it was too big and got canceled
+    for (int i = 0; solution_out->numberOfEdges < bestNumberOfEdges; i++)
+    {
+        int first  = positions[2 * i];
+        int second = positions[2 * i + 1];
+        if ((((low[first] ^ low[second]) | (high[first] ^ high[second])) >> bestColoring & 1) == 0)
+            memcpy(&(solution_out->edges[solution_out->numberOfEdges++]), &(graph->edges[i]), sizeof(edge_t));
+    }
+
+    return solution_out->numberOfEdges;
 }
 
 /**
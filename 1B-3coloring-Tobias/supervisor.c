@@ -5,16 +5,17 @@
  *
  * @brief Contains the main functionality of the 3color - Supervisor program.
  *
- * @details The Supervisor initializes shared memory and semaphores for its generators,
+ * @details The Supervisor initializes the shared memory for its generators,
  *          determines which of the generated solutions is the best so far and repeatedly writes new found best solutions
  *          to stdout. The program shuts down when receiving SIGINT, SIGTERM or a solution with 0 edges,
  *          meaning the graph given to the generators is 3-colorable.
- *          It also manages when the generators should shut down and frees the shared memory and all semaphores afterwards.
+ *          It also manages when the generators should shut down and frees the shared memory afterwards.
+ *          With -g FILE the supervisor loads a graph file once and publishes it for generators started without edges.
  **/
 
 #include "3color.h"
 
-#define INPUT_ARGUMENT_NUMBER_ERROR "This program does not support any arguments."
+#define INPUT_ARGUMENT_NUMBER_ERROR "The only allowed option is a graph file. SYNOPSIS: supervisor [-g FILE]"
 
 typedef struct sigaction sigaction_t;
 
@@ -44,12 +45,12 @@ void initiateTermination(int _) {
  * @brief The entry point of the supervisor program.
  * @details This function executes the whole program.
  *          It calls upon other functions to verify the program arguments,
- *          create and initialize the shared memory and all semaphores and keeps track of the best solutions.
+ *          create and initialize the shared memory and keeps track of the best solutions.
  *
  * global variables used: programName_g - The program name as declared in util.h and specified in argumentValues[0]
  *
- * @param argumentCounter The argument counter. Must be 1 as no arguments are allowed.
- * @param argumentValues  The argument values. Must only contain the program name.
+ * @param argumentCounter The argument counter.
+ * @param argumentValues  The argument values. May only contain the option -g FILE.
  *
  * @return Returns EXIT_SUCCESS upon success or EXIT_FAILURE upon failure.
  */
@@ -58,7 +59,15 @@ void initiateTermination(int _) {
     //region INIT
     programName_g = argumentValues[0];
 
-    if (argumentCounter > 1)
+    const char *graphPath = NULL;
+    int option;
+    while ((option = getopt(argumentCounter, argumentValues, "g:")) != -1)
+    {
+        if (option != 'g' || graphPath != NULL)
+            printErrorAndTerminate(INPUT_ARGUMENT_NUMBER_ERROR);
+        graphPath = optarg;
+    }
+    if (optind != argumentCounter)
         printErrorAndTerminate(INPUT_ARGUMENT_NUMBER_ERROR);
 
     sigaction_t sigInt;
@@ -66,49 +75,37 @@ void initiateTermination(int _) {
     initializeSignalHandler(SIGINT, initiateTermination, &sigInt);
     initializeSignalHandler(SIGTERM, initiateTermination, &sigTerm);
 
-    int shared_memory_fd;
+    shared_graph_t *sharedGraph = NULL;
+    if (graphPath != NULL)
+        publishGraphAsServer(graphPath, &sharedGraph); // before the ring, see publishGraphAsServer
+
     shared_memory_t *solutionBuffer;
-    initializeSharedMemoryAsServer(&shared_memory_fd, &solutionBuffer);
-
-    sem_t *freeSpaceSemaphore;
-    sem_t *usedSpaceSemaphore;
-    sem_t *exclWriteSemaphore;
-    initializeSemaphoreAsServer(&freeSpaceSemaphore, FREE_SPACE_SEM_NAME, FREE_SPACE_SEM_INIT);
-    initializeSemaphoreAsServer(&usedSpaceSemaphore, USED_SPACE_SEM_NAME, USED_SPACE_SEM_INIT);
-    initializeSemaphoreAsServer(&exclWriteSemaphore, EXCL_WRITE_SEM_NAME, EXCL_WRITE_SEM_INIT);
+    initializeSharedMemoryAsServer(&solutionBuffer);
     //endregion
 
     solution_t currentBestSolution = { .numberOfEdges = MAX_SOLUTION_SIZE + 1 };
 
-    unsigned long currentReadPosition = 0; // prepare for SHM sizes as big as possible
     while (!shouldTerminate_g)
     {
-        if (sem_wait(usedSpaceSemaphore) == -1) { // wait if nothing new was written yet, then read the next solution
-            if (errno == EINTR) continue;
-            else printErrnoAndTerminate(USED_SPACE_SEM_NAME);
-        }
+        solution_t solution;
+        if (readSolutionFromShm(solutionBuffer, &solution) == -1) // wait if nothing new was written yet, then read the next solution
+            continue;
 
-        if (overwriteAndPrintIfBetter(solutionBuffer->solutions[currentReadPosition], &currentBestSolution) == 0)
+        int8_t newBestSolutionSize = overwriteAndPrintIfBetter(solution, &currentBestSolution);
+        if (newBestSolutionSize == 0)
         {
             fprintf(stdout, FOUND_0_EDGE_SOLUTION_MSG);
             break;
         }
-
-        if (++currentReadPosition == MAX_SOLUTION_SIZE)
-            currentReadPosition = 0;
-
-        exitOnFailure(sem_post(freeSpaceSemaphore), FREE_SPACE_SEM_NAME); // indicate one solution was read
+        if (newBestSolutionSize > 0) // let the generators stop working on solutions that can't be better
+            writeBestSolution(solutionBuffer, &currentBestSolution);
     }
     fprintf(stdout, "\n"); // ensure newline in shell after Program stop
 
     //region CLEANUP
-    solutionBuffer->shutdownRequested = true;
-
-    cleanupSharedMemoryAsServer(shared_memory_fd, solutionBuffer);
-
-    cleanupSemaphoreAsServer(freeSpaceSemaphore, FREE_SPACE_SEM_NAME);
-    cleanupSemaphoreAsServer(usedSpaceSemaphore, USED_SPACE_SEM_NAME);
-    cleanupSemaphoreAsServer(exclWriteSemaphore, EXCL_WRITE_SEM_NAME);
+    cleanupSharedMemoryAsServer(solutionBuffer); // also requests the shutdown of the generators
+    if (sharedGraph != NULL)
+        cleanupGraph(sharedGraph);
     //endregion
 
     return EXIT_SUCCESS;
@@ -13,16 +13,11 @@
 #include <stdlib.h>
 #include <errno.h>
 #include <memory.h>
+#include <stdbool.h> // the boolean value, also used by shmring.h
 
 #define ERRNO_ERROR_FORMAT  "%s - %s: %s\n"
 #define CUSTOM_ERROR_FORMAT "%s - %s\n"
 
-/** Convenience type to emulate a boolean value. */
-typedef enum {
-    false = 0,
-    true = 1
-} bool;
-
 /** Must be specified by files using this header.
  * Should contain the program name as specified in argumentValues[0] */
 extern char *programName_g;
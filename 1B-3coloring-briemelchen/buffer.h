@@ -1,80 +1,130 @@
-/**
- * @file buffer.h
- * @author briemelchen
- * @date 03.11.2020
- * @brief Module which handles setup of the circular buffer as well as writing and reading from it.
- * @details All operations as writing and reading to/from the buffer are handled by this module. All operations
- * are synchronized by semaphores which are also defined in the module. Setup for the different programs (supervisor/generator)
- * are also provided in the module.
- * 
- * last modified: 14.11.2020
- */
-#include <sys/stat.h>
-#include <fcntl.h>
-#include <semaphore.h>
-#include "globals.h"
-
-#ifndef circularbuffer_h
-#define circularbuffer_h
-
-sem_t *sem_free;       // semaphore which handles writing operations ("free space semaphore")
-sem_t *sem_used;       // semaphore which handles reading operations ("used space semaphore")
-sem_t *sem_w_block;    // semaphore which makes writing operations atomic so that only one process can write at the same time
-
-circ_buffer *buffer; // buffer which holds the solutions and which is maped from the shared memory
-
-/**
- * @brief setups the buffer and all semaphores for the supervisor.
- * @details setups the supervisor: opens all semaphores with according init-values (sem_free is initalized with
- * BUFFER_LENGTH (see globals.h), sem_used with 0 and sem_w_block with 1). Opens the shared memory and maps it into
- * the addressspace of the supervisor.
- * @return the file discriptor of the shared memory, in case of an error -1.
- */
-int supervisor_setup(void);
-
-/**
- * @brief setups the buffer and all semaphores for the generator-processes.
- * @details opens all semaphores (which have to be created by supervisor process in advance) and the shared memory.
- * Should only be called, if supervisor_setup() has been called before by a different process.
- * @return the file descriptor of the shared memory, in case of an error -1.
- */
-int generator_setup(void);
-
-/**
- * @brief reads an entry from the buffer.
- * @details reads an entry from the buffer. The function respectlively the semaphore  blocks as long as a generator
- * has written an entry to the buffer. If an entry has be written, the  semaphore unblocks and the method returns
- * an solution struct. After that, the semaphore which is used for tracking frees space is posted and the index of the writing position
- * is increased.
- * @return a solution struct, holding a valid 3-color-solution
- */
-solution read_entry_from_buffer(void);
-
-/**
- * @brief writes a solution to the buffer.
- * @details writes a valid solution of the 3-color-problem to the buffer. The semaphore  blocks as long as there
- * is free-space to write. After successfully writing to the buffer, the semaphore sem_used is posted for increasing the
- * used space of the buffer and the index of the writing position is increased.
- * @param solution  to be written
- * @return 0 on success, -1 on failure
- */
-int write_solution_buffer(solution solution);
-
-/**
- * @brief returns the actual state of the buffer.
- * @details the  semaphore blocks as long as get_state returns, so no writing process can fail due to
- * wrong state of the buffer.
- * @return State 0: Buffer is running, State -1: Supervisor indicated to stop the program, -2 on failure
- */
-int get_state(void);
-
-/**
- * @brief sets the state of the buffer, and therefore the state of the program.
- * @details sets the state of the buffer. Set_state is synchronized  via the write-semaphore  to avoid
- * blockings.
- * @param new_state which the buffer should be set to (-1 indicates generators to stop, 0 for "normal" program flow)
- * @return 0 on success, -1 on failure.
- */
-int set_state(int new_state);
-
+/**
+ * @file buffer.h
+ * @author briemelchen
+ * @date 03.11.2020
+ * @brief Module which handles setup of the circular buffer as well as writing and reading from it.
+ * @details All operations as writing and reading to/from the buffer are handled by this module. The buffer is a ring
+ * of the shmring module (../libshmring), which also synchronizes all operations and holds the best solution and the state.
+ * Setup for the different programs (supervisor/generator) are also provided in the module, as well as the graph the
+ * supervisor can publish in a read-only shared memory (shmgraph module), so generators don't have to parse it.
+ * 
+ * last modified: 14.11.2020
+ */
+#include "globals.h"
+#include "shmring.h"
+#include "shmgraph.h"
+
+#ifndef circularbuffer_h
+#define circularbuffer_h
+
+extern struct shmring *ring; // ring which holds the solutions and which is maped from the shared memory
+
+/**
+ * @brief setups the buffer for the supervisor.
+ * @details setups the supervisor: creates the ring with BUFFER_LENGTH (see globals.h) slots in the shared memory and
+ * maps it into the addressspace of the supervisor.
+ * @return 0 on success, in case of an error -1.
+ */
+int supervisor_setup(void);
+
+/**
+ * @brief setups the buffer for the generator-processes.
+ * @details opens the ring (which has to be created by supervisor process in advance).
+ * Should only be called, if supervisor_setup() has been called before by a different process.
+ * @return 0 on success, in case of an error -1.
+ */
+int generator_setup(void);
+
+/**
+ * @brief closes the buffer.
+ * @details unmaps the ring. Called by the supervisor it also sets the state to -1, which frees generators waiting for
+ * free space, and removes the shared memory.
+ * @return 0 on success, -1 on failure.
+ */
+int close_buffer(void);
+
+/**
+ * @brief reads an entry from the buffer.
+ * @details reads an entry from the buffer. The function blocks as long as no generator
+ * has written an entry to the buffer. If an entry has be written, the method returns
+ * an solution struct and the slot can be written again.
+ * @return a solution struct, holding a valid 3-color-solution, removed_edges is -1 on failure (errno is set).
+ */
+solution read_entry_from_buffer(void);
+
+/**
+ * @brief writes a solution to the buffer.
+ * @details writes a valid solution of the 3-color-problem to the buffer. The function blocks as long as there
+ * is no free-space to write.
+ * @param solution  to be written
+ * @return 0 on success, -2 if the state has been set to -1, -1 on failure
+ */
+int write_solution_buffer(solution solution);
+
+/**
+ * @brief loads a graph file and publishes it for the generators.
+ * @details parses the file (text or binary edge list, see shmgraph.h) once and stores it in the read-only shared
+ * memory GRAPH_SHM_NAME (see globals.h). Has to be called before supervisor_setup(), so a generator which opened the
+ * buffer always finds the whole graph.
+ * @param path of the graph file
+ * @return 0 on success, -1 on failure (errno is set).
+ */
+int publish_graph(const char *path);
+
+/**
+ * @brief maps the graph the supervisor published.
+ * @details the edges of the graph are copied with the indices of their nodes (0 to node_c-1), so the solver works
+ * on them like on a parsed graph. The labels of the nodes are needed to translate a solution back, see
+ * translate_solution(). Should only be called after generator_setup().
+ * @param graph which is filled, its edges have to be freed by the caller.
+ * @return 0 on success, -1 on failure (errno is set, ENOENT if the supervisor published no graph).
+ */
+int attach_graph(graph *graph);
+
+/**
+ * @brief translates the node indices of a solution of the published graph back to their labels.
+ * @details does nothing if the generator didn't call attach_graph().
+ * @param solution which is translated
+ */
+void translate_solution(solution *solution);
+
+/**
+ * @brief closes the published graph.
+ * @details unmaps the graph, called by the supervisor it also removes the shared memory. Does nothing if there is
+ * no graph.
+ * @return 0 on success, -1 on failure.
+ */
+int close_graph(void);
+
+/**
+ * @brief returns the actual state of the buffer.
+ * @details a write after the state changed to -1 fails, so no generator can get stuck in a full buffer.
+ * @return State 0: Buffer is running, State -1: Supervisor indicated to stop the program
+ */
+int get_state(void);
+
+/**
+ * @brief sets the state of the buffer, and therefore the state of the program.
+ * @details sets the state of the buffer. Setting it to -1 shuts the ring down, which wakes up all waiting generators.
+ * The state can't go back to 0 afterwards.
+ * @param new_state which the buffer should be set to (-1 indicates generators to stop, 0 for "normal" program flow)
+ * @return 0 on success, -1 on failure.
+ */
+int set_state(int new_state);
+
+/**
+ * @brief publishes a solution as the best solution the supervisor has read.
+ * @details the best solution is the best-bound slot of the ring (protected by a seqlock), only the supervisor may call
+ * this function.
+ * @param solution the new best solution
+ */
+void write_best_solution(solution solution);
+
+/**
+ * @brief reads the best solution the supervisor has published.
+ * @details retries as long as the supervisor writes the best solution meanwhile.
+ * @return the best solution, removed_edges is -1 if there is none yet.
+ */
+solution read_best_solution(void);
+
 #endif
\ No newline at end of file
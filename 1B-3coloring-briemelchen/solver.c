@@ -15,6 +15,7 @@
 #include <string.h>
 #include <regex.h>
 #include <limits.h>
+#include <stdint.h>
 
 /**
  * @brief compares a string to match a regex.
@@ -24,6 +25,24 @@
  */
 static int reg_matches(const char *str);
 
+/**
+ * @brief returns 64 random bits.
+ * @details uses a xorshift64* generator, which is seeded with rand() on the first call, so it depends on the seed
+ * set by the generator. Only the lower 16 bits of rand() are used, as RAND_MAX may be as small as 32767.
+ * @return the random bits
+ */
+static uint64_t random_bits(void);
+
+/**
+ * @brief colors every node of the graph randomly, once for each of the COLORINGS_PER_CALL colorings.
+ * @details the colors are bit-sliced: bit l of low[n] and high[n] is the lower and the higher bit of the color
+ * of node n in coloring l. Lanes which got the invalid color 3 are colored again, so every color is equally likely.
+ * @param low lower color bits, one word per node
+ * @param high higher color bits, one word per node
+ * @param node_c count of nodes
+ */
+static void color_nodes(uint64_t *low, uint64_t *high, int node_c);
+
 solution calculate_solution(graph *graph)
 {
     solution solution;
@@ -36,34 +55,67 @@ solution calculate_solution(graph *graph)
         solution.edges[i].end_node = INT_MIN;
     }
 
-    // holds the colors of each node of the graph.
-    // The index of the array is the label of the node (e.g colored_nodes[0]=1)Node with label 0 has color 1
-    int colored_nodes[graph->node_c];
-    for (int i = 0; i < graph->node_c; i++)
-    {   
-     
-        colored_nodes[i] = (rand() % 3); // seed has to be set by the generator
-      //  printf("Node: %d has color: %d\n", i, colored_nodes[i]);
+    // holds the colors of each node of the graph in all colorings.
+    // The index of the arrays is the label of the node, the bit the coloring
+    uint64_t low[graph->node_c];
+    uint64_t high[graph->node_c];
+    color_nodes(low, high, graph->node_c);
+
+    // count[j] holds bit j of the count of removed edges of each coloring. A coloring is dropped (cleared in alive)
+    // as soon as its count reaches ACCEPTED_SOL, so the counters never overflow.
+    uint64_t count[COUNTER_BITS] = {0};
+    uint64_t alive = UINT64_MAX;
+    for (int i = 0; i < graph->edge_c && alive != 0; i++)
+    {
+        node start = graph->edges[i].start_node;
+        node end = graph->edges[i].end_node;
+        // edge not in 3-color-solution (and therefore in a solution) in every coloring with a set bit
+        uint64_t carry = ~((low[start] ^ low[end]) | (high[start] ^ high[end])) & alive;
+        uint64_t full = alive;
+        for (int j = 0; j < COUNTER_BITS; j++)
+        {
+            uint64_t next = count[j] & carry;
+            count[j] ^= carry;
+            carry = next;
+            full &= (ACCEPTED_SOL >> j) & 1 ? count[j] : ~count[j];
+        }
+        alive &= ~full;
+    }
+
+    if (alive == 0)
+    {
+        solution.removed_edges = -1;
+        return solution;
     }
-    int ac_edge_in_sol = 0;
-    for (int i = 0; i < graph->edge_c && ac_edge_in_sol < ACCEPTED_SOL; i++)
+
+    // takes the coloring with the fewest removed edges
+    int best_lane = 0;
+    int best_count = ACCEPTED_SOL;
+    for (int lane = 0; lane < COLORINGS_PER_CALL; lane++)
     {
-        if (colored_nodes[graph->edges[i].start_node] ==
-            colored_nodes[graph->edges[i].end_node]) // edge not in 3-color-solution and therefore in a solution
+        if (((alive >> lane) & 1) == 0)
+            continue;
+        int lane_count = 0;
+        for (int j = 0; j < COUNTER_BITS; j++)
+            lane_count |= ((count[j] >> lane) & 1) << j;
+        if (lane_count < best_count)
         {
-            solution.edges[ac_edge_in_sol].start_node = graph->edges[i].start_node;
-            solution.edges[ac_edge_in_sol].end_node = graph->edges[i].end_node;
-            ac_edge_in_sol++;
-            solution.removed_edges++;
+            best_count = lane_count;
+            best_lane = lane;
         }
-        if (solution.removed_edges >= ACCEPTED_SOL)
+    }
+
+    for (int i = 0; i < graph->edge_c && solution.removed_edges < best_count; i++)
+    {
+        node start = graph->edges[i].start_node;
+        node end = graph->edges[i].end_node;
+        if ((((low[start] ^ low[end]) | (high[start] ^ high[end])) >> best_lane & 1) == 0)
         {
-            solution.removed_edges = -1;
-            
+            solution.edges[solution.removed_edges] = graph->edges[i];
+            solution.removed_edges++;
         }
     }
 
-   
     return solution;
 }
 
@@ -141,4 +193,34 @@ static int reg_matches(const char *str)
     return_val = regexec(&regex, str, (size_t)0, NULL, 0);
     regfree(&regex);
     return return_val == 0 ? 0 : -1;
-}
\ No newline at end of file
+}
+
+static uint64_t random_bits(void)
+{
+    static uint64_t state = 0;
+    while (state == 0)
+    {
+        for (int i = 0; i < 4; i++)
+            state = (state << 16) | (rand() & 0xffff); // seed has to be set by the generator
+    }
+    // xorshift64*
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return state * UINT64_C(2685821657736338717);
+}
+
+static void color_nodes(uint64_t *low, uint64_t *high, int node_c)
+{
+    for (int i = 0; i < node_c; i++)
+    {
+        low[i] = random_bits();
+        high[i] = random_bits();
+        uint64_t invalid;
+        while ((invalid = low[i] & high[i]) != 0)
+        {
+            low[i] = (low[i] & ~invalid) | (random_bits() & invalid);
+            high[i] = (high[i] & ~invalid) | (random_bits() & invalid);
+        }
+    }
+}
@@ -10,11 +10,17 @@
 #ifndef solver_h
 #define solver_h
 
+#define COLORINGS_PER_CALL 64 // colorings evaluated at once, one per bit of a uint64_t
+#define COUNTER_BITS 4        // bits of the removed edges counters, must hold ACCEPTED_SOL (see globals.h)
+
 /**
  * @brief Computes a valid 3-coloring of a specific graph.
  * @details Computation is performed randomized: Nodes are colored randomly, and afterwards
  * edges with same start and end node color are removed, and therefore a valid 3-coloring is computed.
- * Only solutions with a max-edge-count of ACCEPTED_SOL (see globals.h) are returned.
+ * COLORINGS_PER_CALL colorings are evaluated at once: the colors are bit-sliced into one bit per coloring, so
+ * checking an edge compares the endpoint colors of all colorings with a few bitwise operations, and the count of
+ * removed edges is kept in bit-sliced counters. The coloring with the fewest removed edges is returned.
+ * Only solutions with less than ACCEPTED_SOL (see globals.h) edges are returned.
  * @param graph on which the solution should be computed
  * @return the solution of the 3-coloring. If the solution.removed_edges == -1 a solution is invalid and should be discarded by a generator.
  */
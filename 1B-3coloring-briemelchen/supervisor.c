@@ -1,233 +1,450 @@
-/**
- *@file supervisor.c
- * @author briemelchen
- * @date 03.11.2020
- *
- * @brief Supervisor program reads solutions of the 3-Color Problem and Prints them. Furthermore it's supervises
- * multiple generator processes and forces to exit them if a solution is found (or the supervisor terminates).
- *
- * @details The supervisor program does not take any options or arguments. It setups the circular buffer (see buffer.h/buffer.c)
- * and reads from it. The read process is synchronized by semaphores (see buffer.h/buffer.c). The value saved in the buffer are
- * possible solutions to the 3-Color-Problem of graphs, which are given and solved  by generator-processes.
- * The program also handles common signals (SIGINT, SIGTERM) and informs generator processes if the program needs to exit (or if it has found a solution).
- */
-#include <stdio.h>
-
-#include <unistd.h>
-
-#include <stdlib.h>
-
-#include <errno.h>
-
-#include <string.h>
-
-#include <string.h>
-
-#include <fcntl.h>
-
-#include <limits.h>
-
-#include <fcntl.h>
-
-#include <sys/mman.h>
-
-#include <signal.h>
-
-#include "solver.h"
-
-#define PROGRAM_NAME "./supervisor"
-
-/**
- * @brief reads and prints values from the buffer.
- * @details Reads continuously from the Buffer(if there are any elements to read from) and prints them.
- * New solutions are only printed, if it is a better solution than the currently best solution.
- * If the program is aborted (SIGINT,SIGTERM) or terminates (because a optimal solution has been found) the
- * reading processe aborts and the generators are informed to close aswell.
- */
-static void read_and_print_cbuffer(void);
-
-/**
- * @brief signal handler
- * @details signals SIGTERM and SIGINT are handled properly and invoke clearing of shared resources and semaphores, and
- * informates generators.
- * @param  signal to be handled
- */
-static void handle_signal(int signal);
-
-/**
- * @brief closes all resources.
- * @details closes all resources (semaphores, shared memory) and unlinks them.
- * @return 0 on success, -1 on failure.
- */
-static int clean(void);
-
-/**
- * @brief calls clean and exits the program.
- * @details calls clean() and on successfully calling it exits with EXIT_SUCCESS, on failure,
- * with EXIT_FAILURE
- */
-static void clean_exit(void);
-
-/**
- * @brief prints an error message to stderr and exits.
- * @details prints an error message to stderr and exits it. If errno is set, the reason will also be printed.
- * Exits the program with EXIT_FAILURE.
- * @param error_message containing a appropriate message explaining the error.
- *
- */
-static void error(char *error_message);
-
-/**
- * @brief prints the usage message
- * @details prints the usage message in format Usage ...
- */
-static void usage(void);
-
-static int shmfd;                  // holding the filedescriptor of the shared memory
-static volatile sig_atomic_t quit; // flag which is set if the program needs to quit due to a signal
-
-/**
- * Entrypoint of the program.
- * @brief Program starts here. Handles arguments, setups the buffer and the signalhandler.
- * @details If any arguments are given, program exits with an error.
- * global-variables: shmfd, quit
- * @param argc The argument counter.
- * @param argv The argument vector.
- * @return  0 on success otherwise error code.
- */
-int main(int argc, char **argv)
-{
-
-    if (argc != 1)
-        usage();
-
-    if ((shmfd = supervisor_setup()) == -1)
-        error("Error while doing buffer setup for supervisor.");
-
-    quit = 0;
-
-    struct sigaction sig_handler;
-    memset(&sig_handler, 0, sizeof(sig_handler));
-    sig_handler.sa_handler = handle_signal;
-
-    sigaction(SIGINT, &sig_handler, NULL);
-    sigaction(SIGTERM, &sig_handler, NULL);
-
-    read_and_print_cbuffer();
-}
-
-static void handle_signal(int signal)
-{
-    if (signal == SIGINT || signal == SIGTERM)
-    {
-        quit++; // because exit is not async-safe i inc the quit flag, which let's the supervisor return gracefully
-    }
-}
-
-static void read_and_print_cbuffer(void)
-{
-    int best_sol = INT_MAX; //holds the count of best actual solution
-
-    while (quit == 0)
-    {
-
-        /*
-    // for debug used:
-    int a;
-    sem_getvalue(sem_used,&a);
-    int b;
-    sem_getvalue(sem_free,&b);
-    printf("SEMUSED: %d \n",a);
-    printf("SEMFREE: %d\n",b);
-
-    */
-        solution sol = read_entry_from_buffer();
-
-        if (sol.removed_edges == -1) //-1 indicates error while reading
-        {
-            if (errno == EINTR) // signal
-                break;
-            else
-                error("Failed reading from buffer");
-        }
-
-        if (sol.removed_edges == 0)
-        { // optimal solution is found
-            best_sol = 0;
-            print_solution(sol);
-
-            if (set_state(-1) != 0)
-            {
-                if (errno == EINTR) // signal
-                    break;
-                error("Failed to update state of buffer");
-            }
-
-            clean_exit();
-            return;
-        }
-        else if (sol.removed_edges < best_sol)
-        { // better solution is found
-            best_sol = sol.removed_edges;
-            print_solution(sol);
-        }
-    }
-    if (set_state(-1) != 0)
-        error("Failed to update state of buffer");
-    clean_exit();
-}
-
-static void clean_exit(void)
-{
-
-    if (clean() == 0)
-    {
-        exit(EXIT_SUCCESS);
-    }
-    else
-    {
-        error("Failed to clean resources.");
-    }
-}
-
-static void error(char *error_message)
-{
-    fprintf(stderr, "[%s] ERROR: %s: %s.\n", PROGRAM_NAME, error_message,
-            strcmp(strerror(errno), "Success") == 0 ? "Failure" : strerror(errno));
-    exit(EXIT_FAILURE);
-}
-
-static void usage(void)
-{
-    fprintf(stderr, "Usage: %s\n", PROGRAM_NAME);
-    exit(EXIT_FAILURE);
-}
-
-static int clean(void)
-{
-    int re_val = 0;
-    // freeing stucked generators, which can stuck, if the buffer is full and they wait for free space to write.
-    if (sem_post(sem_free) != 0)
-        error("Error while sem_post(sem_w)");
-
-
-    // printf("Buffer readpos at end: %d\n", buffer->read_pos);
-    // printf("Buffer writepos at end: %d\n", buffer->write_pos);
-    if (sem_close(sem_free) != 0)
-        re_val = -1;
-    if (sem_close(sem_used) != 0)
-        re_val = -1;
-    if (sem_close(sem_w_block) != 0)
-        re_val = -1;
-    if (sem_unlink(SEM_NAME_WR) != 0)
-        re_val = -1;
-    if (sem_unlink(SEM_NAME_RD) != 0)
-        re_val = -1;
-    if (sem_unlink(SEM_NAME_WR_BLOCK) != 0)
-        re_val = -1;
-    if (shm_unlink(SHM_NAME) != 0)
-        re_val = -1;
-    if (munmap(buffer, sizeof(*buffer)) != 0)
-        re_val = -1;
-    return re_val;
-}
\ No newline at end of file
+/**
+ *@file supervisor.c
+ * @author briemelchen
+ * @date 03.11.2020
+ *
+ * @brief Supervisor program reads solutions of the 3-Color Problem and Prints them. Furthermore it's supervises
+ * multiple generator processes and forces to exit them if a solution is found (or the supervisor terminates).
+ *
+ * @details The supervisor program only takes the options -s SECONDS and -g FILE. It setups the circular buffer (see buffer.h/buffer.c)
+ * and reads from it. The read process is synchronized by semaphores (see buffer.h/buffer.c). The value saved in the buffer are
+ * possible solutions to the 3-Color-Problem of graphs, which are given and solved  by generator-processes.
+ * The program also handles common signals (SIGINT, SIGTERM) and informs generator processes if the program needs to exit (or if it has found a solution).
+ * Solutions are canonicalised (edges sorted) and checked against a hash set, so repeated solutions are only counted. With
+ * -s SECONDS statistics (histogram of the unique solution sizes, solutions per second of every generator) are printed to stderr
+ * every SECONDS seconds. With -g FILE a graph file is loaded once and published in a read-only shared memory, which
+ * generators started without edges map instead of parsing their arguments.
+ */
+#include <stdio.h>
+
+#include <unistd.h>
+
+#include <stdlib.h>
+
+#include <errno.h>
+
+#include <string.h>
+
+#include <string.h>
+
+#include <fcntl.h>
+
+#include <limits.h>
+
+#include <stdint.h>
+
+#include <fcntl.h>
+
+#include <sys/mman.h>
+
+#include <signal.h>
+
+#include "solver.h"
+
+#define PROGRAM_NAME "./supervisor"
+#define DEDUP_SLOTS 4096   // slots of the hash set of seen solutions (power of two), cleared when three quarters are used
+#define MAX_GENERATORS 64  // generators the statistics keep apart, further ones are only counted in the totals
+#define MAX_INTERVAL 3600  // largest allowed statistics interval in seconds
+
+typedef struct dedup_slot
+{
+    int used;
+    uint64_t hash;
+    solution sol;
+} dedup_slot;
+
+typedef struct generator_stats
+{
+    int pid;
+    long received; // solutions read since the last report
+    long unique;   // of those solutions not seen before
+} generator_stats;
+
+/**
+ * @brief reads and prints values from the buffer.
+ * @details Reads continuously from the Buffer(if there are any elements to read from) and prints them.
+ * New solutions are only printed, if it is a better solution than the currently best solution.
+ * If the program is aborted (SIGINT,SIGTERM) or terminates (because a optimal solution has been found) the
+ * reading processe aborts and the generators are informed to close aswell.
+ */
+static void read_and_print_cbuffer(void);
+
+/**
+ * @brief brings a solution into canonical form.
+ * @details every edge is stored with the smaller node first, the edges are sorted and unused edges are zeroed, so
+ * the same set of edges always results in the same solution.
+ * @param sol solution to be canonicalised
+ */
+static void canonicalize(solution *sol);
+
+/**
+ * @brief adds a canonical solution to the hash set of seen solutions.
+ * @details uses FNV-1a and linear probing. When three quarters of the set are used it gets cleared, so very old
+ * solutions may count as new again.
+ * global-variables: seen, seen_count
+ * @param sol canonical solution to be added
+ * @return 1 if the solution was not seen before, 0 otherwise.
+ */
+static int insert_unique(solution *sol);
+
+/**
+ * @brief counts a read solution in the statistics.
+ * @details global-variables: histogram, generators, generator_count, received_total, unique_total
+ * @param sol solution which was read
+ * @param unique 1 if the solution was not seen before
+ */
+static void record_statistics(solution *sol, int unique);
+
+/**
+ * @brief prints the statistics since the last report to stderr and resets them.
+ * @details the histogram counts the unique solutions since the start, generators which did not write since the last
+ * report are dropped.
+ * global-variables: histogram, generators, generator_count, received_total, unique_total, report_interval
+ */
+static void print_statistics(void);
+
+/**
+ * @brief alarm handler
+ * @details marks a statistics report as due and restarts the alarm.
+ * @param signal to be handled
+ */
+static void handle_alarm(int signal);
+
+/**
+ * @brief signal handler
+ * @details signals SIGTERM and SIGINT are handled properly and invoke clearing of shared resources and semaphores, and
+ * informates generators.
+ * @param  signal to be handled
+ */
+static void handle_signal(int signal);
+
+/**
+ * @brief closes all resources.
+ * @details closes all resources (the ring in the shared memory and the published graph) and unlinks them.
+ * @return 0 on success, -1 on failure.
+ */
+static int clean(void);
+
+/**
+ * @brief calls clean and exits the program.
+ * @details calls clean() and on successfully calling it exits with EXIT_SUCCESS, on failure,
+ * with EXIT_FAILURE
+ */
+static void clean_exit(void);
+
+/**
+ * @brief prints an error message to stderr and exits.
+ * @details prints an error message to stderr and exits it. If errno is set, the reason will also be printed.
+ * Exits the program with EXIT_FAILURE.
+ * @param error_message containing a appropriate message explaining the error.
+ *
+ */
+static void error(char *error_message);
+
+/**
+ * @brief prints the usage message
+ * @details prints the usage message in format Usage ...
+ */
+static void usage(void);
+
+static volatile sig_atomic_t quit; // flag which is set if the program needs to quit due to a signal
+
+static dedup_slot seen[DEDUP_SLOTS];              // hash set of the seen solutions
+static int seen_count;                            // used slots of seen
+static long histogram[ACCEPTED_SOL];              // unique solutions per size
+static generator_stats generators[MAX_GENERATORS]; // statistics of the generators since the last report
+static int generator_count;                       // used entries of generators
+static long received_total;                       // solutions read since the last report
+static long unique_total;                         // unique solutions read since the last report
+static unsigned int report_interval;              // seconds between two reports, 0 if no statistics are printed
+static volatile sig_atomic_t report_due;          // set by the alarm handler if a report is due
+
+/**
+ * Entrypoint of the program.
+ * @brief Program starts here. Handles arguments, setups the buffer and the signalhandler.
+ * @details If any arguments besides -s SECONDS are given, program exits with an error.
+ * global-variables: quit, report_interval
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return  0 on success otherwise error code.
+ */
+int main(int argc, char **argv)
+{
+
+    int opt;
+    const char *graph_path = NULL;
+    while ((opt = getopt(argc, argv, "s:g:")) != -1)
+    {
+        if (opt == 'g' && graph_path == NULL)
+        {
+            graph_path = optarg;
+            continue;
+        }
+        if (opt != 's' || report_interval != 0)
+            usage();
+
+        char *end;
+        errno = 0;
+        long value = strtol(optarg, &end, 10);
+        if (errno != 0 || end == optarg || *end != '\0' || value < 1 || value > MAX_INTERVAL)
+            usage();
+        report_interval = value;
+    }
+    if (optind != argc)
+        usage();
+
+    if (graph_path != NULL && publish_graph(graph_path) == -1) // before the buffer, see publish_graph()
+        error("Error while publishing the graph.");
+
+    if (supervisor_setup() == -1)
+    {
+        close_graph();
+        error("Error while doing buffer setup for supervisor.");
+    }
+
+    quit = 0;
+
+    struct sigaction sig_handler;
+    memset(&sig_handler, 0, sizeof(sig_handler));
+    sig_handler.sa_handler = handle_signal;
+
+    sigaction(SIGINT, &sig_handler, NULL);
+    sigaction(SIGTERM, &sig_handler, NULL);
+
+    if (report_interval > 0)
+    { // no SA_RESTART, so the alarm interrupts waiting for the next solution
+        sig_handler.sa_handler = handle_alarm;
+        sigaction(SIGALRM, &sig_handler, NULL);
+        alarm(report_interval);
+    }
+
+    read_and_print_cbuffer();
+}
+
+static void handle_signal(int signal)
+{
+    if (signal == SIGINT || signal == SIGTERM)
+    {
+        quit++; // because exit is not async-safe i inc the quit flag, which let's the supervisor return gracefully
+    }
+}
+
+static void read_and_print_cbuffer(void)
+{
+    int best_sol = INT_MAX; //holds the count of best actual solution
+
+    while (quit == 0)
+    {
+        if (report_due)
+        {
+            report_due = 0;
+            print_statistics();
+        }
+
+        /*
+    // for debug used:
+    printf("PENDING: %zu \n", shmring_pending(ring));
+
+    */
+        solution sol = read_entry_from_buffer();
+
+        if (sol.removed_edges == -1) //-1 indicates error while reading
+        {
+            if (errno == EINTR && quit == 0) // alarm of the statistics
+                continue;
+            else if (errno == EINTR) // signal
+                break;
+            else
+                error("Failed reading from buffer");
+        }
+        if (sol.removed_edges < 0 || sol.removed_edges >= ACCEPTED_SOL)
+            continue;
+
+        canonicalize(&sol);
+        int unique = insert_unique(&sol);
+        record_statistics(&sol, unique);
+        if (!unique)
+            continue;
+
+        if (sol.removed_edges == 0)
+        { // optimal solution is found
+            best_sol = 0;
+            print_solution(sol);
+
+            if (set_state(-1) != 0)
+            {
+                if (errno == EINTR) // signal
+                    break;
+                error("Failed to update state of buffer");
+            }
+
+            clean_exit();
+            return;
+        }
+        else if (sol.removed_edges < best_sol)
+        { // better solution is found
+            best_sol = sol.removed_edges;
+            write_best_solution(sol); // lets the generators drop solutions which are not better
+            print_solution(sol);
+        }
+    }
+    if (set_state(-1) != 0)
+        error("Failed to update state of buffer");
+    clean_exit();
+}
+
+static void handle_alarm(int signal)
+{
+    (void)signal;
+    report_due = 1;
+    alarm(report_interval);
+}
+
+static void canonicalize(solution *sol)
+{
+    for (int i = 0; i < sol->removed_edges; i++)
+    {
+        edge e = sol->edges[i];
+        if (e.start_node > e.end_node)
+        { // edges are undirected
+            sol->edges[i].start_node = e.end_node;
+            sol->edges[i].end_node = e.start_node;
+        }
+    }
+    for (int i = 1; i < sol->removed_edges; i++)
+    {
+        edge e = sol->edges[i];
+        int j = i;
+        while (j > 0 && (sol->edges[j - 1].start_node > e.start_node ||
+                         (sol->edges[j - 1].start_node == e.start_node && sol->edges[j - 1].end_node > e.end_node)))
+        {
+            sol->edges[j] = sol->edges[j - 1];
+            j--;
+        }
+        sol->edges[j] = e;
+    }
+    for (int i = sol->removed_edges; i < ACCEPTED_SOL; i++)
+    {
+        sol->edges[i].start_node = 0;
+        sol->edges[i].end_node = 0;
+    }
+}
+
+static int insert_unique(solution *sol)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (int i = 0; i < sol->removed_edges; i++)
+    {
+        hash = (hash ^ (uint32_t)sol->edges[i].start_node) * 1099511628211ULL;
+        hash = (hash ^ (uint32_t)sol->edges[i].end_node) * 1099511628211ULL;
+    }
+
+    int i = hash & (DEDUP_SLOTS - 1);
+    while (seen[i].used)
+    {
+        if (seen[i].hash == hash && seen[i].sol.removed_edges == sol->removed_edges &&
+            memcmp(seen[i].sol.edges, sol->edges, sizeof(sol->edges)) == 0)
+            return 0;
+        i = (i + 1) & (DEDUP_SLOTS - 1);
+    }
+
+    if (seen_count >= DEDUP_SLOTS / 4 * 3)
+    {
+        memset(seen, 0, sizeof(seen));
+        seen_count = 0;
+        i = hash & (DEDUP_SLOTS - 1);
+    }
+    seen[i].used = 1;
+    seen[i].hash = hash;
+    seen[i].sol = *sol;
+    seen_count++;
+    return 1;
+}
+
+static void record_statistics(solution *sol, int unique)
+{
+    received_total++;
+    if (unique)
+    {
+        unique_total++;
+        histogram[sol->removed_edges]++;
+    }
+
+    int i = 0;
+    while (i < generator_count && generators[i].pid != sol->generator)
+        i++;
+    if (i == generator_count)
+    {
+        if (generator_count == MAX_GENERATORS)
+            return;
+        generators[i].pid = sol->generator;
+        generators[i].received = 0;
+        generators[i].unique = 0;
+        generator_count++;
+    }
+    generators[i].received++;
+    if (unique)
+        generators[i].unique++;
+}
+
+static void print_statistics(void)
+{
+    fprintf(stderr, "[%s] %.1f solutions/s (%.1f unique/s), sizes:", PROGRAM_NAME,
+            (double)received_total / report_interval, (double)unique_total / report_interval);
+    for (int i = 0; i < ACCEPTED_SOL; i++)
+    {
+        if (histogram[i] > 0)
+            fprintf(stderr, " %d:%ld", i, histogram[i]);
+    }
+    fprintf(stderr, "\n");
+
+    int kept = 0;
+    for (int i = 0; i < generator_count; i++)
+    {
+        if (generators[i].received == 0)
+            continue;
+        fprintf(stderr, "[%s]   generator %d: %.1f solutions/s (%.1f unique/s)\n", PROGRAM_NAME, generators[i].pid,
+                (double)generators[i].received / report_interval, (double)generators[i].unique / report_interval);
+        generators[kept] = generators[i];
+        generators[kept].received = 0;
+        generators[kept].unique = 0;
+        kept++;
+    }
+    generator_count = kept;
+    received_total = 0;
+    unique_total = 0;
+}
+
+static void clean_exit(void)
+{
+
+    if (clean() == 0)
+    {
+        exit(EXIT_SUCCESS);
+    }
+    else
+    {
+        error("Failed to clean resources.");
+    }
+}
+
+static void error(char *error_message)
+{
+    fprintf(stderr, "[%s] ERROR: %s: %s.\n", PROGRAM_NAME, error_message,
+            strcmp(strerror(errno), "Success") == 0 ? "Failure" : strerror(errno));
+    exit(EXIT_FAILURE);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: %s [-s SECONDS] [-g FILE]\n", PROGRAM_NAME);
+    exit(EXIT_FAILURE);
+}
+
+static int clean(void)
+{
+    // closing the ring frees stucked generators, which can stuck, if the buffer is full and they wait for free space
+    // to write.
+    int ret = close_buffer();
+    return close_graph() == -1 ? -1 : ret;
+}
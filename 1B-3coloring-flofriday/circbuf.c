@@ -10,29 +10,32 @@
  **/
 
 #include <assert.h>
-#include <fcntl.h>
-#include <semaphore.h>
+#include <errno.h>
 #include <stdbool.h>
-#include <stdio.h>
 #include <stdlib.h>
 
 #include "sharedmem.h"
 #include "circbuf.h"
 
 /**
- * @brief Names of the semaphores
+ * @brief The name for the shared memory
  */
-#define SEM_FREE "/XXXXXXXX_osue_sem_free"
-#define SEM_USED "/XXXXXXXX_osue_sem_used"
-#define SEM_WRITE "/XXXXXXXX_osue_sem_write"
+#define SHM_NAME "/XXXXXXXX_osue_shm"
 
 /**
- * @details Uses the macros SEM_FREE, SEM_USED, SEM_WRITE (from circbuf.c) and
- * SHM_SIZE (sharedmem.h).
+ * @details Uses the macro SHM_NAME. The server stores max_edges in the 
+ * application area of the ring.
  */
-struct circbuf *open_circbuf(char role)
+struct circbuf *open_circbuf(char role, const struct shm_config *config)
 {
 	assert(role == 'c' || role == 's');
+	assert(role == 'c' || config != NULL);
+
+	if (role == 's' && config->max_edges > MAX_EDGES)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
 
 	// Allocate memory for the circbuf struct
 	struct circbuf *circbuf = malloc(sizeof(struct circbuf));
@@ -41,223 +44,114 @@ struct circbuf *open_circbuf(char role)
 		return NULL;
 	}
 
-	// Initialize the circbuf fields
-	circbuf->s_free = NULL;
-	circbuf->s_used = NULL;
-	circbuf->s_write = NULL;
-
-	// Open the shared memory
-	circbuf->shm = open_sharedmem(&circbuf->shmfd, role);
-	if (circbuf->shm == NULL)
+	// Create or open the ring
+	if (role == 's')
+	{
+		struct shmring_config ring_config = {
+			.record_size = sizeof(struct solution),
+			.capacity = config->slots,
+			.extra_size = sizeof(struct shm),
+			.hugepages = config->hugepages,
+		};
+		circbuf->ring = shmring_create(SHM_NAME, &ring_config);
+	}
+	else
+	{
+		circbuf->ring = shmring_open(SHM_NAME, sizeof(struct solution));
+	}
+	if (circbuf->ring == NULL)
 	{
 		free(circbuf);
 		return NULL;
 	}
 
-	// Open the semaphores
-	// If however opening one semaphore fails we need to close all resources
+	circbuf->shm = shmring_extra(circbuf->ring);
 	if (role == 's')
 	{
-		// (The server can create them if they do not exist yet, but will fail
-		// if they already exist.)
-		circbuf->s_free = sem_open(SEM_FREE, O_CREAT | O_EXCL, 0600, SHM_SIZE);
-		if (circbuf->s_free == SEM_FAILED)
-		{
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
-		circbuf->s_used = sem_open(SEM_USED, O_CREAT | O_EXCL, 0600, 0);
-		if (circbuf->s_used == SEM_FAILED)
-		{
-			sem_close(circbuf->s_free);
-			sem_unlink(SEM_FREE);
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
-		circbuf->s_write = sem_open(SEM_WRITE, O_CREAT | O_EXCL, 0600, 1);
-		if (circbuf->s_write == SEM_FAILED)
-		{
-			sem_close(circbuf->s_free);
-			sem_unlink(SEM_FREE);
-			sem_close(circbuf->s_used);
-			sem_unlink(SEM_USED);
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
+		circbuf->shm->max_edges = config->max_edges;
 	}
-	else
+	else if (circbuf->shm == NULL || circbuf->shm->max_edges > MAX_EDGES)
 	{
-		circbuf->s_free = sem_open(SEM_FREE, 0);
-		if (circbuf->s_free == SEM_FAILED)
-		{
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
-		circbuf->s_used = sem_open(SEM_USED, 0);
-		if (circbuf->s_used == SEM_FAILED)
-		{
-			sem_close(circbuf->s_free);
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
-		circbuf->s_write = sem_open(SEM_WRITE, 0);
-		if (circbuf->s_write == SEM_FAILED)
-		{
-			sem_close(circbuf->s_free);
-			sem_close(circbuf->s_used);
-			sem_unlink(SEM_USED);
-			close_sharedmem(circbuf->shm, circbuf->shmfd, role);
-			free(circbuf);
-			return NULL;
-		}
+		// The shared memory doesn't fit this program
+		shmring_close(circbuf->ring);
+		free(circbuf);
+		errno = EINVAL;
+		return NULL;
 	}
 
 	return circbuf;
 }
 
 /**
- * @details Uses the macros SEM_FREE, SEM_USED, SEM_WRITE (from circbuf.c) and
- * SHM_SIZE (sharedmem.h).
+ * @details Closing the ring as server also tells the clients that the server 
+ * is no longer alive, so that clients waiting for a free slot give up.
  */
 int close_circbuf(struct circbuf *circbuf, char role)
 {
 	assert(role == 'c' || role == 's');
 
-	// Increase the free semaphore to avoid a generator freezing in a deadlock.
-	// Also communicate with the clients that the server is no longer alive.
-	if (role == 's')
-	{
-		sem_post(circbuf->s_free);
-		circbuf->shm->alive = false;
-	}
-
-	// Init the return value of this function.
-	int ret_val = 0;
-
-	// Close the shared memory
-	if (close_sharedmem(circbuf->shm, circbuf->shmfd, role) < 0)
-	{
-		ret_val = -1;
-	}
+	int ret_val = shmring_close(circbuf->ring);
+	free(circbuf);
+	return ret_val;
+}
 
-	// Close the semaphores
-	if (sem_close(circbuf->s_free) == -1)
-	{
-		ret_val = -1;
-	}
-	if (sem_close(circbuf->s_used) == -1)
-	{
-		ret_val = -1;
-	}
-	if (sem_close(circbuf->s_write) == -1)
-	{
-		ret_val = -1;
-	}
+/**
+ * @details Only the used part of the solution is copied.
+ */
+void write_circbuf(struct circbuf *circbuf, const struct solution *solution)
+{
+	shmring_write(circbuf->ring, solution, SOLUTION_USED_SIZE(solution));
+}
 
-	// The server also unlinks the semaphores
-	if (role == 's')
+/**
+ * @brief Clamp the edge count of a solution read from the shared memory.
+ * @details A client might write more edges than the server accepts.
+ */
+static void clamp_solution(struct circbuf *circbuf, struct solution *solution)
+{
+	if (solution->count > circbuf->shm->max_edges)
 	{
-		if (sem_unlink(SEM_FREE) == -1)
-			ret_val = -1;
-		if (sem_unlink(SEM_USED) == -1)
-			ret_val = -1;
-		if (sem_unlink(SEM_WRITE) == -1)
-			ret_val = -1;
+		solution->count = circbuf->shm->max_edges;
 	}
-
-	return ret_val;
 }
 
 /**
- * @details Uses the macro SHM_SIZE (sharedmem.h).
+ * @details Returns -1 if the ring got shut down or waiting got interrupted by
+ * a signal.
  */
-void write_circbuf(struct circbuf *circbuf, char *content)
+int read_circbuf(struct circbuf *circbuf, struct solution *solution)
 {
-	// Lock the write mutex to ensure only one generator is writing at a time
-	if (sem_wait(circbuf->s_write) == -1)
+	ssize_t len = shmring_read(circbuf->ring, solution, NULL);
+	if (len == -1)
 	{
-		return;
+		return -1;
 	}
-
-	// Write all characters to the buffer
-	for (size_t i = 0; circbuf->shm->alive; i++)
+	if ((size_t)len < offsetof(struct solution, edges))
 	{
-		// Wait for free space in the circular buffer
-		if (sem_wait(circbuf->s_free) == -1)
-		{
-			sem_post(circbuf->s_write);
-			return;
-		};
-
-		// Write the current char and increase the write position and increase
-		// used space indicator
-		circbuf->shm->data[circbuf->shm->writepos] = content[i];
-		sem_post(circbuf->s_used);
-		circbuf->shm->writepos += 1;
-		circbuf->shm->writepos %= SHM_SIZE;
-
-		// Exit the loop if we wrote the Zero-terminator of the string
-		if (content[i] == 0)
-		{
-			break;
-		}
+		solution->count = 0;
+		solution->optimal = false;
 	}
-
-	// Unlock the write mutex
-	sem_post(circbuf->s_write);
-	return;
+	clamp_solution(circbuf, solution);
+	return 0;
 }
 
 /**
- * @details Uses the macro SHM_SIZE (sharedmem.h).
+ * @details The count of edges is the bound of the best slot.
  */
-char *read_circbuf(struct circbuf *circbuf)
+void write_best_circbuf(struct circbuf *circbuf, const struct solution *solution)
 {
-	// Allocate memory for the string we need to read
-	size_t len = 0;
-	size_t cap = 32;
-	char *s = malloc(sizeof(char) * cap);
-	if (s == NULL)
-	{
-		return NULL;
-	}
+	shmring_set_best(circbuf->ring, solution->count, solution, SOLUTION_USED_SIZE(solution));
+}
 
-	// Read until the null-terminated string ends
-	while (true)
+/**
+ * @details The count is clamped like in read_circbuf.
+ */
+bool read_best_circbuf(struct circbuf *circbuf, uint64_t *seen, struct solution *solution)
+{
+	if (!shmring_read_best(circbuf->ring, seen, solution, NULL))
 	{
-		// Wait till there is some content to read
-		if (sem_wait(circbuf->s_used) == -1)
-		{
-			free(s);
-			return NULL;
-		}
-
-		// Copy the current character and increase the read position and the
-		// free semaphore
-		s[len] = circbuf->shm->data[circbuf->shm->readpos];
-		sem_post(circbuf->s_free);
-		len += 1;
-		circbuf->shm->readpos += 1;
-		circbuf->shm->readpos %= SHM_SIZE;
-
-		// Double the capacity of the string if we are running out of space
-		if (len == cap)
-		{
-			cap *= 2;
-			s = realloc(s, sizeof(char) * cap);
-		}
-
-		// Exit the loop if a zero-terminator was read
-		if (s[len - 1] == 0)
-		{
-			break;
-		}
+		return false;
 	}
-
-	return s;
+	clamp_solution(circbuf, solution);
+	return true;
 }
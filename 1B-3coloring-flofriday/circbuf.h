@@ -9,27 +9,29 @@
  * The circbuf module. It contains easy to use functions for many clients to 
  * communicate with one server. While the server can only read the data, the 
  * clients can only write data.
+ * The buffer is a ring of the shmring module (lock-free by default: a client 
+ * claims the slot for a solution by atomically increasing the write position 
+ * and the server polls the sequence numbers of the slots, the environment 
+ * variable SHMRING_BACKEND=semaphore switches to semaphores).
  **/
 
 #ifndef CIRCBUF_H
 #define CIRCBUF_H
 
-#include <semaphore.h>
+#include <stdint.h>
 #include "sharedmem.h"
+#include "shmring.h"
 
 /**
  * Structure of the circular buffer
  * @brief Internal structure of the circular buffer
- * @details Only the shm struct inside the circbuf struct is shared with other 
- * processes
+ * @details The ring and the shm struct (the application area of the ring) are
+ * shared with other processes.
  */
 struct circbuf
 {
+	struct shmring *ring;
 	struct shm *shm;
-	int shmfd;
-	sem_t *s_free;
-	sem_t *s_used;
-	sem_t *s_write;
 };
 
 /**
@@ -49,10 +51,12 @@ struct circbuf
  * and memory corruption.
  * @param role The role of the calling process. Allowed values are 's' for 
  * server and 'c' for client. There can only be one server, but many clients. 
+ * @param config The geometry of the buffer chosen by the server, clients pass
+ * NULL and use the geometry the server stored in the shared memory.
  * @return Upon success a pointer to a shared circular buffer is returned.
- * Otherwise NULL.
+ * Otherwise NULL and errno is set (EINVAL if the configuration is invalid).
  */
-struct circbuf *open_circbuf(char role);
+struct circbuf *open_circbuf(char role, const struct shm_config *config);
 
 /**
  * Close the circular buffer.
@@ -69,27 +73,50 @@ struct circbuf *open_circbuf(char role);
 int close_circbuf(struct circbuf *circbuf, char role);
 
 /**
- * Write a string to the circular buffer
- * @brief This function writes a null-terminated string to the buffer.
- * @details This function blocks till the whole string is written to the buffer.
- * In other words, it is very slow and should be used as little as possible.
+ * Write a solution to the circular buffer
+ * @brief This function writes a solution into the next slot of the buffer.
+ * @details This function blocks till the solution is written to the buffer or
+ * the server is no longer alive.
  * This function might be called by many client processes.
  * @param circbuf A pointer to a circbuf struct created with open_circbuf.
- * @param content The string to be written to the buffer.
+ * @param solution The solution to be written to the buffer.
  */
-void write_circbuf(struct circbuf *circbuf, char *content);
+void write_circbuf(struct circbuf *circbuf, const struct solution *solution);
 
 /**
- * Read a string from the circular buffer
- * @brief This function reads a null-terminated string from the circular buffer 
- * and returns it.
- * @details This function blocks till a whole string was read from the buffer.
- * The returned string must be freed by the caller.
+ * Read a solution from the circular buffer
+ * @brief This function reads the next solution from the circular buffer.
+ * @details This function blocks till a solution was read from the buffer.
+ * It first polls the buffer for a short while and then waits on the semaphore.
  * This function should only be called by a single server process.
  * @param circbuf A pointer to a circbuf struct created with open_circbuf.
- * @return Upon success return a pointer to string with the read message. 
- * Otherwise NULL.
+ * @param solution The struct the solution gets copied to.
+ * @return Upon success 0, otherwise -1.
  */
-char *read_circbuf(struct circbuf *circbuf);
+int read_circbuf(struct circbuf *circbuf, struct solution *solution);
+
+/**
+ * Publish the best solution
+ * @brief This function stores a solution as the best one in the shared memory.
+ * @details This function should only be called by the single server process,
+ * the clients read the solution with read_best_circbuf.
+ * @param circbuf A pointer to a circbuf struct created with open_circbuf.
+ * @param solution The new best solution.
+ */
+void write_best_circbuf(struct circbuf *circbuf, const struct solution *solution);
+
+/**
+ * Read the best solution
+ * @brief This function copies the best solution of the server, if it changed.
+ * @details The caller keeps the sequence number of the last solution it read 
+ * in seen, which must be 0 before the first call. Only if the server published
+ * an other solution since then, the solution is copied, so a client can call
+ * this function after every coloring.
+ * @param circbuf A pointer to a circbuf struct created with open_circbuf.
+ * @param seen The sequence number of the last read solution, gets updated.
+ * @param solution The struct the solution gets copied to.
+ * @return True if a new solution was copied, otherwise false.
+ */
+bool read_best_circbuf(struct circbuf *circbuf, uint64_t *seen, struct solution *solution);
 
 #endif
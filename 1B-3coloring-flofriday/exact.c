@@ -0,0 +1,459 @@
+/**
+ * @file exact.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 31.10.2020
+ *
+ * @brief Implementation of the exact engine.
+ **/
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "exact.h"
+
+/**
+ * A thread calls poll after this many nodes.
+ */
+#define POLL_NODES 4096
+
+/**
+ * Structure of a node
+ * @brief A partial coloring: colors[c] holds the vertecies with color c and
+ * cost the colliding edges between them (including the loops).
+ */
+struct node
+{
+	uint64_t colors[3];
+	size_t cost;
+};
+
+/**
+ * Structure of a worker
+ * @brief A thread and its deque of open nodes, which are nodes[bottom] up to
+ * nodes[top - 1]. The thread itself takes from the top, thieves from the
+ * bottom, both while holding lock.
+ * @details A node is pushed at most two places above the one it replaces, so
+ * the deque never grows beyond three nodes per vertex.
+ */
+struct worker
+{
+	struct exact *exact;
+	pthread_t thread;
+	pthread_mutex_t lock;
+	struct node *nodes;
+	size_t bottom;
+	size_t top;
+	unsigned long polled;
+};
+
+/**
+ * Structure of an exact search
+ * @brief The state all workers share.
+ * @details adj holds the neighbours of every vertex (without itself). limit
+ * and stop are read without lock, but only changed while holding lock, which
+ * also serializes the hooks. busy counts the workers that have a node, the
+ * search is done once it is 0. removed has room for the edges of a solution
+ * below the first limit.
+ */
+struct exact
+{
+	const struct graph *graph;
+	const struct exact_hooks *hooks;
+	uint64_t all;
+	uint64_t adj[EXACT_MAX_VERTICES];
+
+	pthread_mutex_t lock;
+	size_t limit;
+	int stop;
+	size_t busy;
+	size_t *removed;
+
+	struct worker *workers;
+	size_t workers_len;
+};
+
+/**
+ * Number of set bits.
+ * @param mask The bit mask.
+ * @return The number of vertecies in the mask.
+ */
+static inline size_t count_bits(uint64_t mask)
+{
+	return __builtin_popcountll(mask);
+}
+
+/**
+ * Color of a vertex in a node.
+ * @param node The node.
+ * @param vertex The vertex, which must be colored.
+ * @return Its color.
+ */
+static unsigned node_color(const struct node *node, uint32_t vertex)
+{
+	uint64_t bit = UINT64_C(1) << vertex;
+	if (node->colors[COLOR_RED] & bit)
+	{
+		return COLOR_RED;
+	}
+	return node->colors[COLOR_GREEN] & bit ? COLOR_GREEN : COLOR_BLUE;
+}
+
+/**
+ * Report a complete coloring.
+ * @brief Passes the coloring to improve if it is below the limit.
+ * @param exact The exact search.
+ * @param node A node in which every vertex is colored.
+ */
+static void report(struct exact *exact, const struct node *node)
+{
+	const struct graph *graph = exact->graph;
+
+	pthread_mutex_lock(&exact->lock);
+	if (node->cost < exact->limit && !exact->stop)
+	{
+		size_t cnt_removed = 0;
+		for (size_t i = 0; i < graph->edges_len; i++)
+		{
+			if (node_color(node, graph->u[i]) == node_color(node, graph->v[i]))
+			{
+				exact->removed[cnt_removed++] = i;
+			}
+		}
+		__atomic_store_n(&exact->limit, node->cost, __ATOMIC_RELAXED);
+		exact->hooks->improve(exact->hooks->ctx, cnt_removed, exact->removed);
+	}
+	pthread_mutex_unlock(&exact->lock);
+}
+
+/**
+ * Poll the hooks.
+ * @brief Takes a smaller limit of the hooks over or stops the search.
+ * @param exact The exact search.
+ */
+static void poll_hooks(struct exact *exact)
+{
+	pthread_mutex_lock(&exact->lock);
+	size_t limit = exact->hooks->poll(exact->hooks->ctx);
+	if (limit == 0)
+	{
+		__atomic_store_n(&exact->stop, 1, __ATOMIC_RELAXED);
+	}
+	else if (limit < exact->limit)
+	{
+		__atomic_store_n(&exact->limit, limit, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&exact->lock);
+}
+
+/**
+ * Push a node.
+ * @param worker The worker that owns the deque.
+ * @param node The node.
+ */
+static void push_node(struct worker *worker, const struct node *node)
+{
+	pthread_mutex_lock(&worker->lock);
+	worker->nodes[worker->top++] = *node;
+	pthread_mutex_unlock(&worker->lock);
+}
+
+/**
+ * Pop a node.
+ * @brief Takes the last pushed node of the own deque.
+ * @param worker The worker that owns the deque.
+ * @param node The destination.
+ * @return True if there was a node, otherwise false.
+ */
+static bool pop_node(struct worker *worker, struct node *node)
+{
+	bool found = false;
+	pthread_mutex_lock(&worker->lock);
+	if (worker->top > worker->bottom)
+	{
+		*node = worker->nodes[--worker->top];
+		found = true;
+	}
+	if (worker->top == worker->bottom)
+	{
+		worker->top = worker->bottom = 0;
+	}
+	pthread_mutex_unlock(&worker->lock);
+	return found;
+}
+
+/**
+ * Steal a node.
+ * @brief Takes the first node of the deque of an other worker, which is
+ * closest to the root and therefore holds the biggest subtree.
+ * @details The thief is counted as busy before the victim can become idle,
+ * so busy never drops to 0 while a node is open.
+ * @param worker The thief.
+ * @param node The destination.
+ * @return True if a node was stolen, otherwise false.
+ */
+static bool steal_node(struct worker *worker, struct node *node)
+{
+	struct exact *exact = worker->exact;
+	size_t self = worker - exact->workers;
+
+	for (size_t i = 1; i < exact->workers_len; i++)
+	{
+		struct worker *victim = &exact->workers[(self + i) % exact->workers_len];
+		bool found = false;
+
+		pthread_mutex_lock(&victim->lock);
+		if (victim->top > victim->bottom)
+		{
+			*node = victim->nodes[victim->bottom++];
+			__atomic_add_fetch(&exact->busy, 1, __ATOMIC_SEQ_CST);
+			found = true;
+		}
+		if (victim->top == victim->bottom)
+		{
+			victim->top = victim->bottom = 0;
+		}
+		pthread_mutex_unlock(&victim->lock);
+
+		if (found)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * Expand a node.
+ * @brief Reports a complete coloring or pushes the children of the node
+ * which aren't cut off.
+ * @details Every uncolored vertex collides at least with as many colored
+ * neighbours as it has in its best color, and those edges are different for
+ * every vertex, so their sum plus the cost is a lower bound. The next vertex
+ * is the one with the highest such minimum, then the most colors among its
+ * colored neighbours, then the most uncolored neighbours. A vertex only gets
+ * the colors already used and one new color, as renaming the colors gives the
+ * same solution. The children are pushed so the cheapest one is taken first.
+ * @param worker The worker.
+ * @param node The node.
+ */
+static void expand_node(struct worker *worker, const struct node *node)
+{
+	struct exact *exact = worker->exact;
+	uint64_t colored = node->colors[0] | node->colors[1] | node->colors[2];
+	uint64_t uncolored = exact->all & ~colored;
+	if (uncolored == 0)
+	{
+		report(exact, node);
+		return;
+	}
+
+	size_t bound = node->cost;
+	uint32_t next = 0;
+	size_t next_min = 0;
+	uint32_t next_rank = 0;
+
+	for (uint64_t rest = uncolored; rest != 0; rest &= rest - 1)
+	{
+		uint32_t vertex = __builtin_ctzll(rest);
+		uint64_t adj = exact->adj[vertex];
+		size_t min = SIZE_MAX;
+		size_t saturation = 0;
+		for (unsigned c = 0; c < 3; c++)
+		{
+			size_t hits = count_bits(adj & node->colors[c]);
+			min = hits < min ? hits : min;
+			saturation += hits > 0;
+		}
+		bound += min;
+
+		// min, saturation and degree are below 256, so they fit in one rank
+		uint32_t rank = (uint32_t)min << 16 | (uint32_t)saturation << 8 |
+						(uint32_t)count_bits(adj & uncolored);
+		if (rank >= next_rank)
+		{
+			next = vertex;
+			next_min = min;
+			next_rank = rank;
+		}
+	}
+
+	size_t limit = __atomic_load_n(&exact->limit, __ATOMIC_RELAXED);
+	if (bound >= limit)
+	{
+		return;
+	}
+
+	// Choose the colors, the new color is the first empty class
+	unsigned colors_len = 0;
+	while (colors_len < 3 && node->colors[colors_len] != 0)
+	{
+		colors_len++;
+	}
+	if (colors_len < 3)
+	{
+		colors_len++;
+	}
+
+	struct node children[3];
+	size_t children_len = 0;
+	size_t rest_bound = bound - node->cost - next_min;
+	for (unsigned c = 0; c < colors_len; c++)
+	{
+		struct node child = *node;
+		child.colors[c] |= UINT64_C(1) << next;
+		child.cost += count_bits(exact->adj[next] & node->colors[c]);
+		if (child.cost + rest_bound >= limit)
+		{
+			continue;
+		}
+
+		// Insert sorted by descending cost
+		size_t i = children_len++;
+		while (i > 0 && children[i - 1].cost < child.cost)
+		{
+			children[i] = children[i - 1];
+			i--;
+		}
+		children[i] = child;
+	}
+
+	for (size_t i = 0; i < children_len; i++)
+	{
+		push_node(worker, &children[i]);
+	}
+}
+
+/**
+ * Thread of a worker.
+ * @brief Expands nodes of the own deque, steals if it is empty and returns
+ * once no worker has a node left or the search was stopped.
+ * @param arg The worker.
+ * @return NULL.
+ */
+static void *run_worker(void *arg)
+{
+	struct worker *worker = arg;
+	struct exact *exact = worker->exact;
+	bool busy = true;
+	struct node node;
+
+	while (!__atomic_load_n(&exact->stop, __ATOMIC_RELAXED))
+	{
+		if (busy && pop_node(worker, &node))
+		{
+			expand_node(worker, &node);
+			if (++worker->polled % POLL_NODES == 0)
+			{
+				poll_hooks(exact);
+			}
+			continue;
+		}
+
+		if (busy)
+		{
+			busy = false;
+			__atomic_sub_fetch(&exact->busy, 1, __ATOMIC_SEQ_CST);
+		}
+		if (steal_node(worker, &node))
+		{
+			busy = true;
+			push_node(worker, &node);
+			continue;
+		}
+		if (__atomic_load_n(&exact->busy, __ATOMIC_SEQ_CST) == 0)
+		{
+			break;
+		}
+		sched_yield();
+	}
+	return NULL;
+}
+
+/**
+ * @details The loops always collide, so they are the cost of the root. With
+ * only one thread the search runs in the calling thread.
+ */
+int solve_exact(const struct graph *graph, size_t threads, size_t limit, const struct exact_hooks *hooks)
+{
+	if (graph->vertecies_len > EXACT_MAX_VERTICES || threads == 0)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct exact exact = {
+		.graph = graph,
+		.hooks = hooks,
+		.all = graph->vertecies_len == 64 ? UINT64_MAX : (UINT64_C(1) << graph->vertecies_len) - 1,
+		.limit = limit,
+		.busy = threads,
+		.workers_len = threads,
+	};
+	struct node root = {.colors = {0, 0, 0}, .cost = 0};
+	for (size_t i = 0; i < graph->edges_len; i++)
+	{
+		if (graph->u[i] == graph->v[i])
+		{
+			root.cost++;
+			continue;
+		}
+		exact.adj[graph->u[i]] |= UINT64_C(1) << graph->v[i];
+		exact.adj[graph->v[i]] |= UINT64_C(1) << graph->u[i];
+	}
+	if (root.cost >= limit)
+	{
+		return 1;
+	}
+
+	size_t deque_len = 3 * (graph->vertecies_len + 1);
+	exact.removed = malloc(sizeof(size_t) * limit);
+	exact.workers = calloc(threads, sizeof(struct worker));
+	struct node *nodes = malloc(sizeof(struct node) * deque_len * threads);
+	if (exact.removed == NULL || exact.workers == NULL || nodes == NULL)
+	{
+		free(exact.removed);
+		free(exact.workers);
+		free(nodes);
+		return -1;
+	}
+	pthread_mutex_init(&exact.lock, NULL);
+	for (size_t i = 0; i < threads; i++)
+	{
+		exact.workers[i].exact = &exact;
+		exact.workers[i].nodes = nodes + i * deque_len;
+		pthread_mutex_init(&exact.workers[i].lock, NULL);
+	}
+	push_node(&exact.workers[0], &root);
+
+	// Start the other threads, if that fails the started ones do the work
+	// (the deques of the missing ones stay empty)
+	size_t started = 1;
+	for (; started < threads; started++)
+	{
+		if (pthread_create(&exact.workers[started].thread, NULL, run_worker, &exact.workers[started]) != 0)
+		{
+			break;
+		}
+	}
+	__atomic_sub_fetch(&exact.busy, threads - started, __ATOMIC_SEQ_CST);
+	run_worker(&exact.workers[0]);
+	for (size_t i = 1; i < started; i++)
+	{
+		pthread_join(exact.workers[i].thread, NULL);
+	}
+
+	int done = exact.stop ? 0 : 1;
+	for (size_t i = 0; i < threads; i++)
+	{
+		pthread_mutex_destroy(&exact.workers[i].lock);
+	}
+	pthread_mutex_destroy(&exact.lock);
+	free(nodes);
+	free(exact.workers);
+	free(exact.removed);
+	return done;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file exact.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 31.10.2020
+ *
+ * @brief Provides the exact engine, which proves that a solution is optimal.
+ *
+ * The exact module. Unlike the engines of the search module it doesn't create
+ * one coloring after another but searches all colorings with branch and
+ * bound, so once it is done no solution with fewer edges exists. The
+ * vertecies are colored one after another, the next one is the uncolored
+ * vertex which collides least with its colored neighbours in its best color
+ * (ties are broken by the number of different colors among its neighbours
+ * like in DSATUR). A subtree is cut off as soon as its colored edges plus the
+ * collisions every uncolored vertex can't avoid reach the limit. The adjacency
+ * of a vertex and the color classes are bit masks, so the graph may have at
+ * most EXACT_MAX_VERTICES vertecies.
+ * The subtrees are split across threads, every thread works depth first on
+ * its own deque and idle threads steal the topmost open subtree of an other
+ * thread.
+ **/
+
+#ifndef EXACT_H
+#define EXACT_H
+
+#include <stddef.h>
+
+#include "graph.h"
+
+/**
+ * The most vertecies the exact engine can handle.
+ */
+#define EXACT_MAX_VERTICES (64)
+
+/**
+ * Structure of the exact engine callbacks
+ * @brief The functions the engine calls while it searches, they are never
+ * called concurrently.
+ * @details improve is called with every solution that has fewer edges than
+ * the limit, which then becomes the new limit. removed holds the indecies of
+ * the count edges to remove. poll is called regularly and returns the current
+ * limit, which may be smaller than the one of the engine if an other process
+ * found a better solution, or 0 to stop the search.
+ */
+struct exact_hooks
+{
+	void *ctx;
+	void (*improve)(void *ctx, size_t count, const size_t *removed);
+	size_t (*poll)(void *ctx);
+};
+
+/**
+ * Solve a graph exactly.
+ * @brief Searches all colorings of the graph for solutions with fewer than
+ * limit edges with the given number of threads.
+ * @details Returns once the search is done or poll returned 0. If the search
+ * is done, no solution has fewer edges than the last limit (the one of the
+ * last improve call or the last one poll returned).
+ * @param graph The graph to color.
+ * @param threads The number of threads, at least 1.
+ * @param limit The number of edges from which on a solution is not of
+ * interest.
+ * @param hooks The callbacks.
+ * @return 1 if the search is done, 0 if it was stopped and -1 on error with
+ * errno set (EINVAL if the graph has too many vertecies).
+ */
+int solve_exact(const struct graph *graph, size_t threads, size_t limit, const struct exact_hooks *hooks);
+
+#endif
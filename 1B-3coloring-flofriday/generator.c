@@ -21,18 +21,29 @@
 #include <unistd.h>
 
 #include "circbuf.h"
-
-/** 
- * @brief The upper limit of edges in a solution the generator is allowed to
- * submit to the supervisor.
- */
-#define MAX_EDGES 8
+#include "exact.h"
+#include "graph.h"
+#include "search.h"
 
 /**
  * Name of the current program.
  */
 static const char *procname;
 
+/**
+ * The engine that is used if no engine is specified.
+ */
+#ifdef SLOW_ALGO
+#define DEFAULT_ENGINE "random"
+#else
+#define DEFAULT_ENGINE "greedy"
+#endif
+
+/**
+ * The most threads of the exact engine.
+ */
+#define MAX_THREADS 256
+
 /**
  * @brief Indicator if the process should stop.
  * @details The type is sig_atomic_t so it is ok to be called from the signal 
@@ -52,26 +63,29 @@ static void handle_signal(int signal)
 }
 
 /**
- * Vertex structure.
- * @brief A vertex consists of a color and a unique name. Allowed values for the
- * color are 0(red), 1(green), 2(blue), -1(not yet defined).
+ * State of the exact engine.
+ * @brief What the callbacks of the exact engine need: the graph, the buffer
+ * and the best solution this generator knows of (its own or the one of the
+ * supervisor), solutions with limit or more edges are not of interest.
  */
-struct vertex
+struct exact_state
 {
-	int8_t color;
-	char *name;
+	const struct graph *graph;
+	struct circbuf *circbuf;
+	uint64_t best_seen;
+	size_t limit;
+	bool has_best;
+	struct solution best;
 };
 
 /**
- * Edge structure.
- * @brief A edge is just a connection between two vertecies, and since the edges
- * have no direction in our graph we don't have to save which one is the start 
- * and the end.
+ * Hash table slot used while parsing the arguments.
+ * @brief An empty slot has the id UINT32_MAX.
  */
-struct edge
+struct hash_slot
 {
-	struct vertex *v1;
-	struct vertex *v2;
+	uint64_t key;
+	uint32_t id;
 };
 
 /**
@@ -83,180 +97,313 @@ struct edge
  **/
 static void usage(void)
 {
-	fprintf(stderr, "[%s] Usage: %s edge...\n", procname, procname);
+	fprintf(stderr, "[%s] Usage: %s [-e %s|exact] [-t threads] edge...\n", procname, procname, SEARCH_ENGINES);
+	fprintf(stderr, "[%s] \t -t The number of threads of the exact engine (1-%d, default: one per CPU)\n", procname, MAX_THREADS);
 	fprintf(stderr, "[%s] Examples:\n", procname);
 	fprintf(stderr, "[%s] \t %s 0-1 0-2 1-2\n", procname, procname);
 	fprintf(stderr, "[%s] \t %s a-b a-c b-c\n", procname, procname);
 	fprintf(stderr, "[%s] \t %s TU-WU TU-BOKU WU-BOKU\n", procname, procname);
 	fprintf(stderr, "[%s] \t %s 0-1 0-2 0-3 1-2 1-3 2-3\n", procname, procname);
+	fprintf(stderr, "[%s] \t %s -e tabu 0-1 0-2 0-3 1-2 1-3 2-3\n", procname, procname);
+	fprintf(stderr, "[%s] \t %s -e exact -t 4 0-1 0-2 0-3 1-2 1-3 2-3\n", procname, procname);
 	exit(EXIT_FAILURE);
 }
 
 /**
- * Find a vertex in a list of vertecies.
- * @brief This function finds a vertex with the specified name.
- * @param vertecies A list of vertecies.
- * @param len The length of vertecies.
- * @param target The of the vertex we are searching for.
- * @return If found the pointer to the matching vertex will be returned, 
- * otherwise NULL.
+ * Hash a vertex name.
+ * @brief Uses the 64 bit FNV-1a hash.
+ * @param name The name to hash.
+ * @return The hash of the name.
  */
-static struct vertex *find_vertex(struct vertex *vertecies, size_t len, char *target)
+static uint64_t hash_name(const char *name)
 {
-	for (size_t i = 0; i < len; i++)
+	uint64_t hash = UINT64_C(14695981039346656037);
+	for (; *name != '\0'; name++)
 	{
-		if (strcmp(vertecies[i].name, target) == 0)
+		hash = (hash ^ (unsigned char)*name) * UINT64_C(1099511628211);
+	}
+	return hash;
+}
+
+/**
+ * Find a slot in a hash table.
+ * @brief Returns the slot of the key, or the empty slot where it belongs if
+ * the key is not in the table.
+ * @details Uses linear probing, the table must never be full.
+ * @param table The hash table.
+ * @param mask The size of the table minus one (the size is a power of two).
+ * @param key The key to search for.
+ * @param hash The hash of the key.
+ * @param names If not NULL the keys are vertex ids and the slot only matches
+ * if the name of the vertex equals name.
+ * @param name The name to compare the vertex names with.
+ * @return The slot of the key or an empty slot.
+ */
+static struct hash_slot *find_slot(struct hash_slot *table, size_t mask, uint64_t key, uint64_t hash, char **names, const char *name)
+{
+	for (size_t i = hash & mask;; i = (i + 1) & mask)
+	{
+		if (table[i].id == UINT32_MAX)
 		{
-			return &vertecies[i];
+			return &table[i];
 		}
+		if (names == NULL ? table[i].key == key : table[i].key == hash && strcmp(names[table[i].id], name) == 0)
+		{
+			return &table[i];
+		}
+	}
+}
+
+/**
+ * Add a vertex to the graph.
+ * @brief Looks the name up in the vertex table and adds a new vertex if
+ * there is no vertex with that name yet.
+ * @details The graph takes ownership of name, if the vertex already exists
+ * name is freed.
+ * @param graph The graph.
+ * @param table The vertex table, which maps names to vertex ids.
+ * @param mask The size of the table minus one.
+ * @param name The name of the vertex.
+ * @return The id of the vertex.
+ */
+static uint32_t add_vertex(struct graph *graph, struct hash_slot *table, size_t mask, char *name)
+{
+	uint64_t hash = hash_name(name);
+	struct hash_slot *slot = find_slot(table, mask, hash, hash, graph->names, name);
+
+	if (slot->id != UINT32_MAX)
+	{
+		free(name);
+		return slot->id;
 	}
-	return NULL;
+
+	slot->key = hash;
+	slot->id = graph->vertecies_len;
+	graph->names[graph->vertecies_len] = name;
+	graph->vertecies_len++;
+	return slot->id;
 }
 
 /**
- * Find a edge in a list of edges.
- * @brief This function finds an edge connecting two vertecies.
- * @details This function will return edges of the form v1-v2 as well as v2-v1, 
- * because edges in our graph are undirected and therefore order shouldn't 
- * matter.
- * @param edges A list of edges.
- * @param len The length of edges.
- * @param v1 One of the vertecies connected to the edge.
- * @param v2 The other vertex.
- * @return If found the pointer to the matching edge will be returned, 
- * otherwise NULL.
+ * Parse an edge and add it to the graph.
+ * @brief Adds the vertecies of the edge and the edge itself to the graph, if
+ * they are not already in it.
+ * @details The edge table contains the edges as the smaller vertex id in the
+ * upper and the bigger one in the lower 32 bit, because edges in our graph
+ * are undirected and therefore order shouldn't matter.
+ * global variables: procname
+ * @param graph The graph.
+ * @param vertex_table The vertex table.
+ * @param edge_table The edge table.
+ * @param mask The size of the tables minus one.
+ * @param arg The argument to parse.
+ * @param index The position of the argument, used in error messages.
+ * @return 0 on success, otherwise -1.
  */
-static struct edge *find_edge(struct edge *edges, size_t len, struct vertex *v1, struct vertex *v2)
+static int add_edge(struct graph *graph, struct hash_slot *vertex_table, struct hash_slot *edge_table, size_t mask, const char *arg, int index)
 {
-	// Since our edges don't have any directeion we need to check if
-	// v1-v2 is in the list of edges as well as v2-v1
-	for (size_t i = 0; i < len; i++)
+	size_t len = strlen(arg);
+	const char *pos_del = strchr(arg, '-');
+
+	// Check if each edge is valid
+	if (pos_del == NULL)
+	{
+		fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (no seperator found)\n", procname, index, arg);
+		return -1;
+	}
+	if (pos_del != strrchr(arg, '-'))
+	{
+		fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (multiple seperators found)\n", procname, index, arg);
+		return -1;
+	}
+	if (pos_del == arg)
+	{
+		fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (missing first vertex)\n", procname, index, arg);
+		return -1;
+	}
+	if (pos_del == arg + len - 1)
+	{
+		fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (missing second vertex)\n", procname, index, arg);
+		return -1;
+	}
+	if (pos_del - arg >= SOLUTION_NAME_SIZE || arg + len - pos_del - 1 >= SOLUTION_NAME_SIZE)
+	{
+		fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (vertex names can have at most %d characters)\n", procname, index, arg, SOLUTION_NAME_SIZE - 1);
+		return -1;
+	}
+
+	// Split the argument into both vertex names n1 and n2
+	size_t l1 = pos_del - arg;
+	size_t l2 = len - (l1 + 1);
+	char *n1 = malloc(sizeof(char) * (l1 + 1));
+	char *n2 = malloc(sizeof(char) * (l2 + 1));
+
+	if (n1 == NULL || n2 == NULL)
 	{
-		if (edges[i].v1 == v1 && edges[i].v2 == v2)
-			return &edges[i];
+		fprintf(stderr, "[%s] ERROR: Unable to allocate memory for vertecies: %s\n", procname, strerror(errno));
+		free(n1);
+		free(n2);
+		return -1;
+	}
+	memcpy(n1, arg, l1);
+	n1[l1] = 0;
+	memcpy(n2, pos_del + 1, l2);
+	n2[l2] = 0;
 
-		if (edges[i].v1 == v2 && edges[i].v2 == v1)
-			return &edges[i];
+	uint32_t v1 = add_vertex(graph, vertex_table, mask, n1);
+	uint32_t v2 = add_vertex(graph, vertex_table, mask, n2);
+
+	// Add the edge to the edges if it isn't already in them
+	uint64_t key = v1 < v2 ? (uint64_t)v1 << 32 | v2 : (uint64_t)v2 << 32 | v1;
+	uint64_t hash = key * UINT64_C(0x9E3779B97F4A7C15);
+	struct hash_slot *slot = find_slot(edge_table, mask, key, hash ^ (hash >> 32), NULL, NULL);
+
+	if (slot->id == UINT32_MAX)
+	{
+		slot->key = key;
+		slot->id = graph->edges_len;
+		graph->u[graph->edges_len] = v1;
+		graph->v[graph->edges_len] = v2;
+		graph->edges_len++;
 	}
 
-	return NULL;
+	return 0;
 }
 
-#ifdef SLOW_ALGO
 /**
- * Color all vertecies randomly.
- * @brief A naive implementation to color all vertecies randomly.
- * @details Before using this function the caller should have made a call to 
- * srand to seed the pseudo random number generator.
- * @param vertecies A list of vertecies.
- * @param len The length of vertecies.
+ * Free allocated resoureces
+ * @brief Frees the vertex names and the arrays of the graph.
+ * @details The graph should not be used after this call.
+ * @param graph The graph.
  */
-static void color_random(struct vertex *vertecies, size_t len)
+static void clean_up(struct graph *graph)
 {
-	for (size_t i = 0; i < len; i++)
+	// Free the names of the vertecies as we allocated that memory earlier
+	for (size_t i = 0; i < graph->vertecies_len; i++)
 	{
-		vertecies[i].color = rand() % 3;
+		free(graph->names[i]);
 	}
+	free(graph->names);
+	free(graph->u);
+	free(graph->v);
 }
-#endif
 
-#ifndef SLOW_ALGO
 /**
- * Color all vertecies randomly.
- * @brief An optimized implementation to color all vertecies randomly.
- * This function tries, to create higher quality coloring of the graph. 
- * It archieves this by avoiding collisions during the random color asignment 
- * where ever possible (A collision is if two connected vertecies have the 
- * same collor). 
- * This function does this by first setting every color to -1 (undefined). Then
- * it goes over all the edges. If both vertecies in that edge don't have a 
- * color yet, they both get a random (but not the same) color. If only one of 
- * the vertecies has a color the other one will get a non-colliding color
- * randomly choosen.
- * If both colors are already asigned we can check if they do collide and if 
- * so we increase a counter. If the counter is equal to the best solution this 
- * process has ever created, we can stop with the current colloring as we won't 
- * achive a better solution with this configurateion.
- * @details Before using this function the caller should have made a call to 
- * srand to seed the pseudo random number generator.
- * In the case this function returns zero, is it possible that some vertecies 
- * still have the color -1(undefined).
- * @param edges A list of edges.
- * @param edges_len The length of edges.
- * @param vertecies A list of vertecies.
- * @param vertecies_len The length of vertecies.
- * @param limit The best solution this process has ever archived.
- * @return True if creataed coloring is the best this process has ever 
- * archived, otherwise false.
+ * Fill a solution.
+ * @brief Copies the names of the removed edges into a solution record (they
+ * fit, as that is checked while parsing the arguments).
+ * @param graph The graph.
+ * @param solution The record to fill.
+ * @param count The number of removed edges, at most MAX_EDGES.
+ * @param removed The indecies of the removed edges.
  */
-static bool color_random_optimized(struct edge *edges, size_t edges_len, struct vertex *vertecies, size_t vertecies_len, size_t limit)
+static void fill_solution(const struct graph *graph, struct solution *solution, size_t count, const size_t *removed)
 {
-	// Set all colors to -1 so we know which one don't have a color yet
-	for (size_t i = 0; i < vertecies_len; i++)
+	solution->count = count;
+	solution->optimal = false;
+	for (size_t i = 0; i < count; i++)
 	{
-		vertecies[i].color = -1;
+		strcpy(solution->edges[i].v1, graph->names[graph->u[removed[i]]]);
+		strcpy(solution->edges[i].v2, graph->names[graph->v[removed[i]]]);
 	}
+}
 
-	// Now color all vertecies in the edges and try to avoid two vertecies
-	// having the same color
-	size_t collisions = 0;
+/**
+ * Improve callback of the exact engine.
+ * @brief Writes the solution to the shared buffer and keeps it as the best.
+ * @param ctx The exact_state.
+ * @param count The number of removed edges.
+ * @param removed The indecies of the removed edges.
+ */
+static void exact_improve(void *ctx, size_t count, const size_t *removed)
+{
+	struct exact_state *state = ctx;
+	fill_solution(state->graph, &state->best, count, removed);
+	state->has_best = true;
+	state->limit = count;
+	write_circbuf(state->circbuf, &state->best);
+}
 
-	for (size_t i = 0; i < edges_len && collisions < limit; i++)
+/**
+ * Poll callback of the exact engine.
+ * @brief Takes over a better solution of the supervisor.
+ * @details global variables: quit
+ * @param ctx The exact_state.
+ * @return The limit, 0 if the generator should stop.
+ */
+static size_t exact_poll(void *ctx)
+{
+	struct exact_state *state = ctx;
+	if (quit || !shmring_alive(state->circbuf->ring))
 	{
-		struct vertex *v1 = edges[i].v1;
-		struct vertex *v2 = edges[i].v2;
-
-		if (v1->color == -1 && v2->color == -1)
-		{
-			v1->color = rand() % 3;
-			v2->color = rand() % 2;
-			if (v1->color == v2->color)
-				v2->color += 1;
-			continue;
-		}
-		if (v1->color == -1)
-		{
-			v1->color = rand() % 2;
-			if (v1->color == v2->color)
-				v1->color += 1;
-			continue;
-		}
-		if (v2->color == -1)
-		{
-			v2->color = rand() % 2;
-			if (v1->color == v2->color)
-				v2->color += 1;
-			continue;
-		}
-		// Since we are here, it meas both vertecies are already filled, now
-		// we can check if the colors collide with each another.
-		if (v1->color == v2->color)
-			collisions++;
+		return 0;
 	}
 
-	if (collisions < limit)
+	struct solution best;
+	if (read_best_circbuf(state->circbuf, &state->best_seen, &best) && best.count < state->limit)
 	{
-		return true;
+		state->best = best;
+		state->has_best = true;
+		state->limit = best.count;
 	}
-
-	return false;
+	return state->limit;
 }
-#endif
 
 /**
- * Free allocated resoureces
- * @brief Frees the allocated names inside the vertecies.
- * @details The name of the vertecies should not be used after this call.
- * @param vertecies A list of vertecies.
- * @param len The length of vertecies.
+ * Solve the graph exactly.
+ * @brief Runs the exact engine, which writes every better solution to the
+ * shared buffer, and tells the supervisor once it proved that the best
+ * solution is optimal.
+ * @details The proof is the best known solution again, with optimal set. If
+ * there is no solution with at most max_edges edges, the supervisor can't
+ * be told, so only a message is printed.
+ * global variables: procname
+ * @param graph The graph.
+ * @param circbuf The shared buffer.
+ * @param threads The number of threads.
+ * @return 0 if all operations are successfull, otherwise -1.
  */
-static void clean_up(struct vertex *vertecies, size_t vertecies_len)
+static int generate_exact(const struct graph *graph, struct circbuf *circbuf, size_t threads)
 {
-	// Free the names of the vertecies as we allocated that memory earlier
-	for (int i = 0; i < vertecies_len; i++)
+	struct exact_state state = {
+		.graph = graph,
+		.circbuf = circbuf,
+		.best_seen = 0,
+		.limit = circbuf->shm->max_edges + 1,
+		.has_best = false,
+	};
+	struct exact_hooks hooks = {.ctx = &state, .improve = exact_improve, .poll = exact_poll};
+
+	size_t limit = exact_poll(&state);
+	if (limit == 0)
+	{
+		return 0;
+	}
+
+	int done = solve_exact(graph, threads, limit, &hooks);
+	if (done == -1 && errno == EINVAL)
+	{
+		fprintf(stderr, "[%s] ERROR: The exact engine supports at most %d vertecies\n", procname, EXACT_MAX_VERTICES);
+		return -1;
+	}
+	if (done == -1)
 	{
-		free(vertecies[i].name);
+		fprintf(stderr, "[%s] ERROR: Unable to run the exact engine: %s\n", procname, strerror(errno));
+		return -1;
+	}
+	if (done == 0)
+	{
+		return 0;
+	}
+
+	if (!state.has_best)
+	{
+		fprintf(stderr, "[%s] There is no solution with at most %zu edges\n", procname, circbuf->shm->max_edges);
+		return 0;
 	}
+	state.best.optimal = true;
+	write_circbuf(circbuf, &state.best);
+	return 0;
 }
 
 /**
@@ -266,65 +413,81 @@ static void clean_up(struct vertex *vertecies, size_t vertecies_len)
  * @details global variables: quit, procname
  * This function only writes to the shared memeory if it found a new best 
  * coloring, to avoid spaming the buffer.
- * @param edges A list of edges.
- * @param edges_len The length of edges.
- * @param vertecies A list of vertecies.
- * @param vertecies_len The length of vertecies.
+ * With the exact engine the work is done by generate_exact.
+ * @param graph The graph.
+ * @param engine The name of the search engine.
+ * @param threads The number of threads of the exact engine.
  * @return 0 if all operations are successfull, otherwise -1.
  */
-static int generate_solutions(struct edge *edges, size_t edges_len, struct vertex *vertecies, size_t vertecies_len)
+static int generate_solutions(const struct graph *graph, const char *engine, size_t threads)
 {
+	// Seed the reandom number generator with the current time in microseconds
+	// cominded with the pid of the current process. The combination is via
+	// XOR.
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	srand(tv.tv_usec ^ getpid());
+
+	// Create the search engine, the exact engine needs none
+	bool exact = strcmp(engine, "exact") == 0;
+	struct search *search = exact ? NULL : create_search(graph, engine);
+	if (!exact && search == NULL && errno == EINVAL)
+	{
+		fprintf(stderr, "[%s] ERROR: Unknown engine \"%s\" (possible engines: %s|exact)\n", procname, engine, SEARCH_ENGINES);
+		return -1;
+	}
+	if (!exact && search == NULL)
+	{
+		fprintf(stderr, "[%s] ERROR: Unable to create the search: %s\n", procname, strerror(errno));
+		return -1;
+	}
+
 	// Initialize the shared circular buffer
 	struct circbuf *circbuf;
-	circbuf = open_circbuf('c');
+	circbuf = open_circbuf('c', NULL);
 	if (circbuf == NULL)
 	{
 		fprintf(stderr, "[%s] ERROR: Unable to open the shared circular buffer: %s\n", procname, strerror(errno));
 		fprintf(stderr, "[%s] Is the supervisor running?\n", procname);
+		free_search(search);
 		return -1;
 	}
 
-	// Create the array to save the removed edges in
-	size_t removed[edges_len];
-
-	// Seed the reandom number generator with the current time in microseconds
-	// cominded with the pid of the current process. The combination is via
-	// XOR.
-	struct timeval tv;
-	gettimeofday(&tv, NULL);
-	srand(tv.tv_usec ^ getpid());
-
-	// Create a random color asignment, and remove edges so that the 3-coloring
-	// is valid.
-	size_t max_limit = MAX_EDGES + 1;
-
-	while (circbuf->shm->alive && !quit)
+	if (exact)
 	{
-		// Note there are two implementation, to coloring the graph, the one
-		// desciped in the asignment and a optimized one.
-#ifndef SLOW_ALGO
-		// Asign random colors optimized implementation
-		bool new_sol = color_random_optimized(edges, edges_len, vertecies, vertecies_len, max_limit);
-		if (!new_sol)
+		int res = generate_exact(graph, circbuf, threads);
+		if (close_circbuf(circbuf, 'c') == -1)
 		{
-			continue;
+			fprintf(stderr, "[%s] ERROR: Unable to close the shared circular buffer: %s\n", procname, strerror(errno));
+			return -1;
 		}
-#else
-		// Asign random colors default implementation
-		color_random(vertecies, vertecies_len);
-#endif
+		return res;
+	}
+
+	// Create the array to save the removed edges in, the search stops as
+	// soon as there are more than the supervisor accepts.
+	size_t removed[MAX_EDGES + 1];
+
+	// Create colorings, and remove edges so that the 3-coloring is valid.
+	size_t max_limit = circbuf->shm->max_edges + 1;
+	uint64_t best_seen = 0;
 
-		// Find the edges to remove
-		size_t cnt_removed = 0;
-		for (size_t i = 0; i < edges_len && cnt_removed < max_limit; i++)
+	while (shmring_alive(circbuf->ring) && !quit)
+	{
+		// Solutions that aren't better than the best one of the supervisor
+		// are not of interest either
+		struct solution best;
+		if (read_best_circbuf(circbuf, &best_seen, &best) && best.count < max_limit)
 		{
-			if (edges[i].v1->color == edges[i].v2->color)
+			max_limit = best.count;
+			if (max_limit == 0)
 			{
-				removed[cnt_removed] = i;
-				cnt_removed++;
+				break;
 			}
 		}
 
+		size_t cnt_removed = step_search(search, max_limit, removed);
+
 		// Don't write this solution to the shared buffer if it is too big
 		if (cnt_removed >= max_limit)
 		{
@@ -334,32 +497,16 @@ static int generate_solutions(struct edge *edges, size_t edges_len, struct verte
 		// Set a new limit
 		max_limit = cnt_removed;
 
-		// Calculate the length of the output string
-		size_t len = 0;
-
-		len = 2 * cnt_removed + 1;
-		for (size_t i = 0; i < cnt_removed; i++)
-		{
-			len += strlen(edges[removed[i]].v1->name);
-			len += strlen(edges[removed[i]].v2->name);
-		}
-
-		// Creeate the output string and fill it
-		char output[len];
-
-		output[0] = 0;
-		for (size_t i = 0; i < cnt_removed; i++)
-		{
-			strcat(output, edges[removed[i]].v1->name);
-			strcat(output, "-");
-			strcat(output, edges[removed[i]].v2->name);
-			strcat(output, " ");
-		}
+		// Fill the solution record
+		struct solution solution;
+		fill_solution(graph, &solution, cnt_removed, removed);
 
-		// Write the output string
-		write_circbuf(circbuf, output);
+		// Write the solution
+		write_circbuf(circbuf, &solution);
 	}
 
+	free_search(search);
+
 	// Free allocated resources
 	if (close_circbuf(circbuf, 'c') == -1)
 	{
@@ -386,8 +533,36 @@ int main(int argc, char const *argv[])
 	// Save the program name
 	procname = argv[0];
 
+	// Parse the options
+	const char *engine = DEFAULT_ENGINE;
+	long threads = sysconf(_SC_NPROCESSORS_ONLN);
+	int c;
+	while ((c = getopt(argc, (char *const *)argv, "e:t:")) != -1)
+	{
+		char *end;
+		switch (c)
+		{
+		case 'e':
+			engine = optarg;
+			break;
+		case 't':
+			errno = 0;
+			threads = strtol(optarg, &end, 10);
+			if (errno != 0 || end == optarg || *end != '\0' || threads < 1 || threads > MAX_THREADS)
+			{
+				fprintf(stderr, "[%s] ERROR: \"%s\" is not a number between 1 and %d\n", procname, optarg, MAX_THREADS);
+				usage();
+			}
+			break;
+		default:
+			usage();
+		}
+	}
+
+	threads = threads < 1 ? 1 : threads > MAX_THREADS ? MAX_THREADS : threads;
+
 	// Check if there are any arguments
-	if (argc < 2)
+	if (optind >= argc)
 	{
 		fprintf(stderr, "[%s] ERROR: No edges provided\n", argv[0]);
 		usage();
@@ -400,114 +575,57 @@ int main(int argc, char const *argv[])
 	sigaction(SIGINT, &sa, NULL);
 	sigaction(SIGTERM, &sa, NULL);
 
-	// Create an array for edges and vertecies
-	size_t edges_length = 0;
-	struct edge edges[argc - 1];
-	size_t vertecies_length = 0;
-	struct vertex vertecies[(argc - 1) * 2];
-
-	// Parse the arguments and add them to the vertecies and edges
-	for (int i = 1; i < argc; i++)
+	// Create the graph and the hash tables to find vertecies and edges while
+	// parsing. The tables are at most a quarter full, so the probe sequences
+	// stay short.
+	size_t max_edges = argc - optind;
+	size_t table_size = 1;
+	while (table_size < max_edges * 4)
 	{
-		size_t len = strlen(argv[i]);
-		char *arg = malloc(sizeof(char) * (len + 1));
-
-		memset(arg, 0, len + 1);
-		strncpy(arg, argv[i], len);
-		char *pos_del = strchr(arg, '-');
-
-		// Check if each edge is valid
-		if (pos_del == NULL)
-		{
-			fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (no seperator found)\n", argv[0], i, arg);
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		if (pos_del != strrchr(arg, '-'))
-		{
-			fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (multiple seperators found)\n", argv[0], i, arg);
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		if (pos_del == arg)
-		{
-			fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (missing first vertex)\n", argv[0], i, arg);
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		if (pos_del == arg + len - 1)
-		{
-			fprintf(stderr, "[%s] ERROR: Argument %d \"%s\" is not a valid edge (missing second vertex)\n", argv[0], i, arg);
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		// Split the argument into both vertex names n1 and n2
-		size_t l1 = pos_del - arg;
-		char *n1 = malloc(sizeof(char) * (l1 + 1));
-
-		if (n1 == NULL)
-		{
-			free(arg);
-			fprintf(stderr, "[%s] ERROR: Unable to allocate memory for vertecies: %s\n", procname, strerror(errno));
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		strncpy(n1, arg, l1 + 1);
-		n1[l1] = 0;
-		size_t l2 = len - ((pos_del - arg) + 1);
-		char *n2 = malloc(sizeof(char) * (l2 + 1));
-
-		if (n2 == NULL)
-		{
-			free(arg);
-			fprintf(stderr, "[%s] ERROR: Unable to allocate memory for vertecies: %s\n", procname, strerror(errno));
-			free(n1);
-			clean_up(vertecies, vertecies_length);
-			exit(EXIT_FAILURE);
-		}
-		strncpy(n2, pos_del + 1, l2);
-		n2[l2] = 0;
-
-		// Add the vertecieses of the current edge to the vertecies list if
-		// they are not already in them.
-		struct vertex *v1 = find_vertex(vertecies, vertecies_length, n1);
-		if (v1 == NULL)
-		{
-
-			vertecies[vertecies_length].name = n1;
-			vertecies[vertecies_length].color = -1;
-			v1 = &vertecies[vertecies_length];
-			vertecies_length++;
-		}
-		struct vertex *v2 =
-			find_vertex(vertecies, vertecies_length, n2);
-		if (v2 == NULL)
-		{
-			vertecies[vertecies_length].name = n2;
-			vertecies[vertecies_length].color = -1;
-			v2 = &vertecies[vertecies_length];
-			vertecies_length++;
-		}
-		// Add the edge to the edges if it isn't already in them
-		struct edge *e = find_edge(edges, edges_length, v1, v2);
+		table_size <<= 1;
+	}
 
-		if (e == NULL)
+	struct graph graph;
+	graph.vertecies_len = 0;
+	graph.edges_len = 0;
+	graph.names = malloc(sizeof(char *) * max_edges * 2);
+	graph.u = malloc(sizeof(uint32_t) * max_edges);
+	graph.v = malloc(sizeof(uint32_t) * max_edges);
+	struct hash_slot *vertex_table = malloc(sizeof(struct hash_slot) * table_size);
+	struct hash_slot *edge_table = malloc(sizeof(struct hash_slot) * table_size);
+
+	int res = 0;
+	if (graph.names == NULL || graph.u == NULL || graph.v == NULL || vertex_table == NULL || edge_table == NULL)
+	{
+		fprintf(stderr, "[%s] ERROR: Unable to allocate memory for the graph: %s\n", procname, strerror(errno));
+		res = -1;
+	}
+	else
+	{
+		for (size_t i = 0; i < table_size; i++)
 		{
-			edges[edges_length].v1 = v1;
-			edges[edges_length].v2 = v2;
-			edges_length++;
+			vertex_table[i].id = UINT32_MAX;
+			edge_table[i].id = UINT32_MAX;
 		}
+	}
 
-		free(arg);
+	// Parse the arguments and add them to the vertecies and edges
+	for (int i = optind; i < argc && res == 0; i++)
+	{
+		res = add_edge(&graph, vertex_table, edge_table, table_size - 1, argv[i], i - optind + 1);
 	}
+	free(vertex_table);
+	free(edge_table);
 
 	// Generate solution till the supervisor kills us or an error occours or
 	// the user terminates us.
-	int res = generate_solutions(edges, edges_length, vertecies,
-								 vertecies_length);
+	if (res == 0)
+	{
+		res = generate_solutions(&graph, engine, threads);
+	}
 
 	// Free the resources and exit with the correct code
-	clean_up(vertecies, vertecies_length);
+	clean_up(&graph);
 	if (res == 0)
 	{
 		return EXIT_SUCCESS;
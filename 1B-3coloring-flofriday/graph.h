@@ -0,0 +1,76 @@
+/**
+ * @file graph.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 31.10.2020
+ *
+ * @brief The graph the generator colors.
+ *
+ * Contains the graph structure and the functions to read and write the packed
+ * colors of its vertecies.
+ **/
+
+#ifndef GRAPH_H
+#define GRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * The colors a vertex can have.
+ * @brief A color uses two bits, COLOR_NONE marks a vertex that has no color
+ * yet.
+ */
+enum color
+{
+	COLOR_RED = 0,
+	COLOR_GREEN = 1,
+	COLOR_BLUE = 2,
+	COLOR_NONE = 3
+};
+
+/**
+ * Graph structure.
+ * @brief The vertecies are numbered from 0 to vertecies_len - 1 in the order
+ * they first appear in the arguments and only their names are stored. Edge i
+ * connects u[i] and v[i], the endpoints are kept in two seperate arrays so the
+ * loops over all edges read them sequentially. Since the edges have no
+ * direction in our graph it doesn't matter which one is the start and the
+ * end.
+ */
+struct graph
+{
+	size_t vertecies_len;
+	char **names;
+	size_t edges_len;
+	uint32_t *u;
+	uint32_t *v;
+};
+
+/**
+ * Color of a vertex.
+ * @brief Reads the color of a vertex from an array with four colors per byte.
+ * @param colors The packed colors.
+ * @param vertex The index of the vertex.
+ * @return The color of the vertex.
+ */
+static inline unsigned get_color(const uint8_t *colors, uint32_t vertex)
+{
+	return (colors[vertex >> 2] >> ((vertex & 3) << 1)) & 3;
+}
+
+/**
+ * Set the color of a vertex.
+ * @brief Writes the color of a vertex into an array with four colors per
+ * byte.
+ * @param colors The packed colors.
+ * @param vertex The index of the vertex.
+ * @param color The new color.
+ */
+static inline void set_color(uint8_t *colors, uint32_t vertex, unsigned color)
+{
+	unsigned shift = (vertex & 3) << 1;
+	colors[vertex >> 2] = (colors[vertex >> 2] & ~(3 << shift)) |
+						  (color << shift);
+}
+
+#endif
@@ -0,0 +1,594 @@
+/**
+ * @file search.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 31.10.2020
+ *
+ * @brief Implementation of the search engines which color the graph.
+ **/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "search.h"
+
+/**
+ * A local search starts over if it didn't improve for this many steps plus
+ * STALE_STEPS_PER_EDGE steps per edge.
+ */
+#define STALE_STEPS 1000
+#define STALE_STEPS_PER_EDGE 10
+
+/**
+ * Percentage of the minconf steps that recolor randomly instead of choosing
+ * the color that collides least, so the search doesn't get stuck.
+ */
+#define NOISE_PERCENT 10
+
+/**
+ * A recoloring undone by tabu stays forbidden for a random number of steps
+ * below TABU_TENURE_RANDOM plus 6/10 of the colliding edges.
+ */
+#define TABU_TENURE_RANDOM 10
+
+/**
+ * Marks an edge that doesn't collide in conflict_pos.
+ */
+#define NO_CONFLICT UINT32_MAX
+
+/**
+ * Engine structure.
+ * @brief An engine has a name and a function to create the next coloring
+ * (see step_search). The local search engines need the adjacency of the
+ * vertecies and the colliding edges.
+ */
+struct engine
+{
+	const char *name;
+	size_t (*step)(struct search *search, size_t limit, size_t *removed);
+	bool local;
+};
+
+/**
+ * Structure of a search
+ * @brief The colors are packed (see graph.h). The neighbours of vertex x are
+ * adj_vertex[offsets[x]] up to adj_vertex[offsets[x + 1] - 1], connected by
+ * the edges in adj_edge, edges from a vertex to itself are left out as they
+ * always collide. The colliding edges are kept in the first conflicts_len
+ * entries of conflicts, conflict_pos holds the position of each edge in it.
+ * tabu holds for every vertex and color the step until which the vertex must
+ * not get that color.
+ */
+struct search
+{
+	const struct graph *graph;
+	const struct engine *engine;
+	uint8_t *colors;
+
+	uint32_t *offsets;
+	uint32_t *adj_vertex;
+	uint32_t *adj_edge;
+	uint32_t *conflicts;
+	size_t conflicts_len;
+	uint32_t *conflict_pos;
+	uint64_t *tabu;
+
+	uint64_t steps;
+	uint64_t stale_steps;
+	uint64_t last_improvement;
+	size_t run_best;
+	bool started;
+};
+
+/**
+ * Color all vertecies randomly.
+ * @brief A naive implementation to color all vertecies randomly.
+ * @param search The search.
+ */
+static void color_random(struct search *search)
+{
+	for (uint32_t i = 0; i < search->graph->vertecies_len; i++)
+	{
+		set_color(search->colors, i, rand() % 3);
+	}
+}
+
+/**
+ * Color all vertecies randomly.
+ * @brief An optimized implementation to color all vertecies randomly.
+ * This function tries, to create higher quality coloring of the graph.
+ * It archieves this by avoiding collisions during the random color asignment
+ * where ever possible (A collision is if two connected vertecies have the
+ * same collor).
+ * This function does this by first setting every color to COLOR_NONE. Then
+ * it goes over all the edges. If both vertecies in that edge don't have a
+ * color yet, they both get a random (but not the same) color. If only one of
+ * the vertecies has a color the other one will get a non-colliding color
+ * randomly choosen.
+ * If both colors are already asigned we can check if they do collide and if
+ * so we increase a counter. If the counter is equal to the best solution this
+ * process has ever created, we can stop with the current colloring as we won't
+ * achive a better solution with this configurateion.
+ * @details In the case this function returns false, is it possible that some
+ * vertecies still have the color COLOR_NONE.
+ * @param search The search.
+ * @param limit The best solution this process has ever archived.
+ * @return True if creataed coloring is the best this process has ever
+ * archived, otherwise false.
+ */
+static bool color_greedy(struct search *search, size_t limit)
+{
+	const struct graph *graph = search->graph;
+	uint8_t *colors = search->colors;
+
+	// Set all colors to COLOR_NONE so we know which one don't have a color
+	// yet (every byte holds four colors)
+	memset(colors, 0xff, (graph->vertecies_len + 3) / 4);
+
+	// Now color all vertecies in the edges and try to avoid two vertecies
+	// having the same color
+	size_t collisions = 0;
+
+	for (size_t i = 0; i < graph->edges_len && collisions < limit; i++)
+	{
+		uint32_t v1 = graph->u[i];
+		uint32_t v2 = graph->v[i];
+		unsigned c1 = get_color(colors, v1);
+		unsigned c2 = get_color(colors, v2);
+
+		if (c1 == COLOR_NONE && c2 == COLOR_NONE)
+		{
+			c1 = rand() % 3;
+			c2 = rand() % 2;
+			if (c1 == c2)
+				c2 += 1;
+			set_color(colors, v1, c1);
+			set_color(colors, v2, c2);
+			continue;
+		}
+		if (c1 == COLOR_NONE)
+		{
+			c1 = rand() % 2;
+			if (c1 == c2)
+				c1 += 1;
+			set_color(colors, v1, c1);
+			continue;
+		}
+		if (c2 == COLOR_NONE)
+		{
+			c2 = rand() % 2;
+			if (c1 == c2)
+				c2 += 1;
+			set_color(colors, v2, c2);
+			continue;
+		}
+		// Since we are here, it meas both vertecies are already filled, now
+		// we can check if the colors collide with each another.
+		if (c1 == c2)
+			collisions++;
+	}
+
+	if (collisions < limit)
+	{
+		return true;
+	}
+
+	return false;
+}
+
+/**
+ * Find the edges to remove.
+ * @brief Finds the colliding edges of the current coloring.
+ * @details The index is always stored and only kept if the colors collide, so
+ * the loop has no branches.
+ * @param search The search.
+ * @param limit The number of edges at which the search stops.
+ * @param removed The array to write the indecies of the edges to.
+ * @return The number of colliding edges, but at most limit.
+ */
+static size_t find_collisions(struct search *search, size_t limit, size_t *removed)
+{
+	const struct graph *graph = search->graph;
+	const uint8_t *colors = search->colors;
+	const uint32_t *u = graph->u;
+	const uint32_t *v = graph->v;
+
+	size_t cnt_removed = 0;
+	for (size_t i = 0; i < graph->edges_len && cnt_removed < limit; i++)
+	{
+		removed[cnt_removed] = i;
+		cnt_removed += get_color(colors, u[i]) == get_color(colors, v[i]);
+	}
+	return cnt_removed;
+}
+
+/**
+ * Step of the random engine.
+ * @brief See step_search.
+ */
+static size_t step_random(struct search *search, size_t limit, size_t *removed)
+{
+	color_random(search);
+	return find_collisions(search, limit, removed);
+}
+
+/**
+ * Step of the greedy engine.
+ * @brief See step_search.
+ */
+static size_t step_greedy(struct search *search, size_t limit, size_t *removed)
+{
+	if (!color_greedy(search, limit))
+	{
+		return limit;
+	}
+	return find_collisions(search, limit, removed);
+}
+
+/**
+ * Add a colliding edge.
+ * @param search The search.
+ * @param edge The edge that collides now.
+ */
+static void add_conflict(struct search *search, uint32_t edge)
+{
+	search->conflict_pos[edge] = search->conflicts_len;
+	search->conflicts[search->conflicts_len++] = edge;
+}
+
+/**
+ * Remove a colliding edge.
+ * @brief The last colliding edge takes the place of the removed one.
+ * @param search The search.
+ * @param edge The edge that doesn't collide anymore.
+ */
+static void remove_conflict(struct search *search, uint32_t edge)
+{
+	uint32_t pos = search->conflict_pos[edge];
+	uint32_t last = search->conflicts[--search->conflicts_len];
+
+	search->conflicts[pos] = last;
+	search->conflict_pos[last] = pos;
+	search->conflict_pos[edge] = NO_CONFLICT;
+}
+
+/**
+ * Start a local search over.
+ * @brief Creates a new greedy coloring and collects its colliding edges.
+ * @param search The search.
+ */
+static void restart(struct search *search)
+{
+	const struct graph *graph = search->graph;
+
+	color_greedy(search, SIZE_MAX);
+	search->conflicts_len = 0;
+	for (size_t i = 0; i < graph->edges_len; i++)
+	{
+		search->conflict_pos[i] = NO_CONFLICT;
+		if (get_color(search->colors, graph->u[i]) ==
+			get_color(search->colors, graph->v[i]))
+		{
+			add_conflict(search, i);
+		}
+	}
+
+	memset(search->tabu, 0, sizeof(uint64_t) * 3 * graph->vertecies_len);
+	search->run_best = search->conflicts_len;
+	search->last_improvement = search->steps;
+	search->started = true;
+}
+
+/**
+ * Count the colors of the neighbours.
+ * @param search The search.
+ * @param vertex The vertex whose neighbours are counted.
+ * @param counts The array the number of neighbours with each color is
+ * written to.
+ */
+static void count_neighbour_colors(struct search *search, uint32_t vertex, size_t counts[3])
+{
+	counts[0] = counts[1] = counts[2] = 0;
+	for (uint32_t i = search->offsets[vertex]; i < search->offsets[vertex + 1]; i++)
+	{
+		counts[get_color(search->colors, search->adj_vertex[i])]++;
+	}
+}
+
+/**
+ * Recolor a vertex.
+ * @brief Gives a vertex a new color and updates the colliding edges, which
+ * takes O(degree).
+ * @param search The search.
+ * @param vertex The vertex to recolor.
+ * @param color The new color, which must differ from the current one.
+ */
+static void recolor(struct search *search, uint32_t vertex, unsigned color)
+{
+	unsigned old = get_color(search->colors, vertex);
+
+	for (uint32_t i = search->offsets[vertex]; i < search->offsets[vertex + 1]; i++)
+	{
+		unsigned neighbour = get_color(search->colors, search->adj_vertex[i]);
+		if (neighbour == old)
+		{
+			remove_conflict(search, search->adj_edge[i]);
+		}
+		else if (neighbour == color)
+		{
+			add_conflict(search, search->adj_edge[i]);
+		}
+	}
+	set_color(search->colors, vertex, color);
+}
+
+/**
+ * Prepare a step of a local search.
+ * @brief Starts the search over if it didn't start yet or didn't improve for
+ * too long.
+ * @param search The search.
+ * @return True if the search was started over, so there is no move to make in
+ * this step.
+ */
+static bool prepare_local_step(struct search *search)
+{
+	search->steps++;
+	if (!search->started ||
+		search->steps - search->last_improvement > search->stale_steps)
+	{
+		restart(search);
+		return true;
+	}
+	return search->conflicts_len == 0;
+}
+
+/**
+ * Finish a step of a local search.
+ * @brief Remembers an improvement and returns the colliding edges.
+ * @param search The search.
+ * @param limit See step_search.
+ * @param removed See step_search.
+ * @return See step_search.
+ */
+static size_t finish_local_step(struct search *search, size_t limit, size_t *removed)
+{
+	if (search->conflicts_len < search->run_best)
+	{
+		search->run_best = search->conflicts_len;
+		search->last_improvement = search->steps;
+	}
+
+	if (search->conflicts_len >= limit)
+	{
+		return search->conflicts_len;
+	}
+	for (size_t i = 0; i < search->conflicts_len; i++)
+	{
+		removed[i] = search->conflicts[i];
+	}
+	return search->conflicts_len;
+}
+
+/**
+ * Step of the minconf engine.
+ * @brief Recolors a random vertex of a random colliding edge with the other
+ * color that collides with the fewest neighbours (ties are broken randomly).
+ * In NOISE_PERCENT of the steps it takes a random other color instead.
+ * @details See step_search.
+ */
+static size_t step_minconf(struct search *search, size_t limit, size_t *removed)
+{
+	if (!prepare_local_step(search))
+	{
+		uint32_t edge = search->conflicts[rand() % search->conflicts_len];
+		uint32_t vertex = rand() % 2 ? search->graph->u[edge] : search->graph->v[edge];
+		unsigned old = get_color(search->colors, vertex);
+		unsigned c1 = (old + 1) % 3;
+		unsigned c2 = (old + 2) % 3;
+		unsigned color;
+
+		if (rand() % 100 < NOISE_PERCENT)
+		{
+			color = rand() % 2 ? c1 : c2;
+		}
+		else
+		{
+			size_t counts[3];
+			count_neighbour_colors(search, vertex, counts);
+			if (counts[c1] == counts[c2])
+				color = rand() % 2 ? c1 : c2;
+			else
+				color = counts[c1] < counts[c2] ? c1 : c2;
+		}
+		recolor(search, vertex, color);
+	}
+	return finish_local_step(search, limit, removed);
+}
+
+/**
+ * Step of the tabu engine.
+ * @brief Makes the best of the four recolorings of the vertecies of a random
+ * colliding edge, which is not tabu. A tabu recoloring is allowed if it leads
+ * to fewer collisions than ever before in this run. The old color of the
+ * recolored vertex becomes tabu for it.
+ * @details See step_search.
+ */
+static size_t step_tabu(struct search *search, size_t limit, size_t *removed)
+{
+	if (!prepare_local_step(search))
+	{
+		uint32_t edge = search->conflicts[rand() % search->conflicts_len];
+		uint32_t ends[2] = {search->graph->u[edge], search->graph->v[edge]};
+		bool found = false;
+		long best_delta = 0;
+		uint32_t best_vertex = ends[0];
+		unsigned best_color = 0;
+
+		for (int i = 0; i < 2; i++)
+		{
+			size_t counts[3];
+			unsigned old = get_color(search->colors, ends[i]);
+			count_neighbour_colors(search, ends[i], counts);
+
+			for (unsigned color = 0; color < 3; color++)
+			{
+				if (color == old)
+					continue;
+
+				long delta = (long)counts[color] - (long)counts[old];
+				bool allowed = search->tabu[ends[i] * 3 + color] <= search->steps ||
+							   (long)search->conflicts_len + delta < (long)search->run_best;
+				if (allowed && (!found || delta < best_delta || (delta == best_delta && rand() % 2)))
+				{
+					found = true;
+					best_delta = delta;
+					best_vertex = ends[i];
+					best_color = color;
+				}
+			}
+		}
+
+		// Everything is tabu, so just take a random recoloring
+		if (!found)
+		{
+			best_vertex = ends[rand() % 2];
+			best_color = (get_color(search->colors, best_vertex) + 1 + rand() % 2) % 3;
+		}
+
+		unsigned old = get_color(search->colors, best_vertex);
+		recolor(search, best_vertex, best_color);
+		search->tabu[best_vertex * 3 + old] = search->steps + rand() % TABU_TENURE_RANDOM + search->conflicts_len * 6 / 10;
+	}
+	return finish_local_step(search, limit, removed);
+}
+
+/**
+ * The available engines.
+ */
+static const struct engine engines[] = {
+	{"random", step_random, false},
+	{"greedy", step_greedy, false},
+	{"minconf", step_minconf, true},
+	{"tabu", step_tabu, true},
+};
+
+/**
+ * Create the adjacency of the vertecies.
+ * @brief Fills offsets, adj_vertex and adj_edge of a search (see struct
+ * search).
+ * @param search The search, with offsets, adj_vertex and adj_edge allocated.
+ */
+static void create_adjacency(struct search *search)
+{
+	const struct graph *graph = search->graph;
+	uint32_t *offsets = search->offsets;
+
+	// Count the degrees, shifted by one so the sums are the start offsets
+	memset(offsets, 0, sizeof(uint32_t) * (graph->vertecies_len + 1));
+	for (size_t i = 0; i < graph->edges_len; i++)
+	{
+		if (graph->u[i] != graph->v[i])
+		{
+			offsets[graph->u[i] + 1]++;
+			offsets[graph->v[i] + 1]++;
+		}
+	}
+	for (size_t i = 0; i < graph->vertecies_len; i++)
+	{
+		offsets[i + 1] += offsets[i];
+	}
+
+	// Fill the neighbours, using the offsets of the next vertex as the
+	// position to write to and shifting them back afterwards
+	for (size_t i = 0; i < graph->edges_len; i++)
+	{
+		uint32_t u = graph->u[i];
+		uint32_t v = graph->v[i];
+		if (u == v)
+			continue;
+
+		search->adj_vertex[offsets[u]] = v;
+		search->adj_edge[offsets[u]++] = i;
+		search->adj_vertex[offsets[v]] = u;
+		search->adj_edge[offsets[v]++] = i;
+	}
+	for (size_t i = graph->vertecies_len; i > 0; i--)
+	{
+		offsets[i] = offsets[i - 1];
+	}
+	offsets[0] = 0;
+}
+
+struct search *create_search(const struct graph *graph, const char *engine)
+{
+	const struct engine *found = NULL;
+	for (size_t i = 0; i < sizeof(engines) / sizeof(engines[0]); i++)
+	{
+		if (strcmp(engines[i].name, engine) == 0)
+		{
+			found = &engines[i];
+		}
+	}
+	if (found == NULL)
+	{
+		errno = EINVAL;
+		return NULL;
+	}
+
+	struct search *search = calloc(1, sizeof(struct search));
+	if (search == NULL)
+	{
+		return NULL;
+	}
+	search->graph = graph;
+	search->engine = found;
+	search->stale_steps = STALE_STEPS + STALE_STEPS_PER_EDGE * graph->edges_len;
+	search->colors = malloc((graph->vertecies_len + 3) / 4);
+	if (search->colors == NULL)
+	{
+		free_search(search);
+		return NULL;
+	}
+	if (!found->local)
+	{
+		return search;
+	}
+
+	search->offsets = malloc(sizeof(uint32_t) * (graph->vertecies_len + 1));
+	search->adj_vertex = malloc(sizeof(uint32_t) * graph->edges_len * 2);
+	search->adj_edge = malloc(sizeof(uint32_t) * graph->edges_len * 2);
+	search->conflicts = malloc(sizeof(uint32_t) * graph->edges_len);
+	search->conflict_pos = malloc(sizeof(uint32_t) * graph->edges_len);
+	search->tabu = malloc(sizeof(uint64_t) * 3 * graph->vertecies_len);
+	if (search->offsets == NULL || search->adj_vertex == NULL ||
+		search->adj_edge == NULL || search->conflicts == NULL ||
+		search->conflict_pos == NULL || search->tabu == NULL)
+	{
+		free_search(search);
+		return NULL;
+	}
+	create_adjacency(search);
+	return search;
+}
+
+size_t step_search(struct search *search, size_t limit, size_t *removed)
+{
+	return search->engine->step(search, limit, removed);
+}
+
+void free_search(struct search *search)
+{
+	if (search == NULL)
+	{
+		return;
+	}
+	free(search->colors);
+	free(search->offsets);
+	free(search->adj_vertex);
+	free(search->adj_edge);
+	free(search->conflicts);
+	free(search->conflict_pos);
+	free(search->tabu);
+	free(search);
+}
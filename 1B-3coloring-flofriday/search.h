@@ -0,0 +1,75 @@
+/**
+ * @file search.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 31.10.2020
+ *
+ * @brief Provides the search engines which color the graph.
+ *
+ * The search module. Every engine produces one coloring after another, the
+ * generator asks it for the next one with step_search. The engines are:
+ * random: colors every vertex randomly (the algorithm of the assignment).
+ * greedy: colors the vertecies edge by edge and avoids collisions where ever
+ * possible.
+ * minconf: starts with a greedy coloring and recolors one vertex of a
+ * colliding edge at a time with the color that collides least (min-conflicts).
+ * tabu: like minconf but picks the best of the possible recolorings and
+ * forbids undoing a recoloring for a few steps (tabu search).
+ * The local search engines update the colliding edges in O(degree) per step
+ * and start over with a new greedy coloring if they don't improve for a while.
+ **/
+
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include "graph.h"
+
+/**
+ * The names of the engines, as shown in the usage.
+ */
+#define SEARCH_ENGINES "random|greedy|minconf|tabu"
+
+/**
+ * Structure of a search
+ * @brief Internal structure of a search, only used through the functions of
+ * this module.
+ */
+struct search;
+
+/**
+ * Create a search.
+ * @brief This function creates a search with the named engine on a graph.
+ * @details The graph must not change while the search exists. Before using
+ * the search the caller should have made a call to srand to seed the pseudo
+ * random number generator.
+ * @param graph The graph to color.
+ * @param engine The name of the engine (see SEARCH_ENGINES).
+ * @return Upon success a pointer to the search, otherwise NULL and errno is
+ * set (EINVAL if there is no engine with that name).
+ */
+struct search *create_search(const struct graph *graph, const char *engine);
+
+/**
+ * Next coloring.
+ * @brief Creates the next coloring and finds the edges to remove so that it is
+ * a valid 3-coloring.
+ * @details The engine may stop the work on a coloring as soon as it is clear
+ * that it needs limit or more edges to be removed.
+ * @param search The search.
+ * @param limit The number of edges from which on a coloring is not of
+ * interest, at most MAX_EDGES + 1.
+ * @param removed The array the indecies of the edges to remove are written to,
+ * which must have room for limit edges. Only filled if the return value is
+ * smaller than limit.
+ * @return The number of edges to remove, which is limit or more if the
+ * coloring is not of interest.
+ */
+size_t step_search(struct search *search, size_t limit, size_t *removed);
+
+/**
+ * Free a search.
+ * @brief Frees all resources of the search.
+ * @param search The search to free, may be NULL.
+ */
+void free_search(struct search *search);
+
+#endif
@@ -3,72 +3,93 @@
  * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
  * @date 31.10.2020
  *
- * @brief Provides functions to easily setup shared memory 
+ * @brief Provides the structures shared between server and clients
  * 
- * The sharedmem module. It conatains the shm struct and two functions to 
- * setup the memory sharing and to free those resources again.
+ * The sharedmem module. It conatains the solution, the configuration and the 
+ * shm struct, the memory itself is set up by the shmring module.
  **/
 
 #ifndef SHAREDMEM_H
 #define SHAREDMEM_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include "shmring.h"
 
 /**
- * @brief The size (in bytes) of data, NOT the size of the complete struct shm
+ * @brief The default and the maximum number of slots in the shared memory
  */
-#define SHM_SIZE (2048)
+#define SHM_SLOTS (32)
+#define SHM_MAX_SLOTS SHMRING_MAX_CAPACITY
+
+/** 
+ * @brief The upper limit of edges in a solution the generator is allowed to
+ * submit to the supervisor.
+ */
+#define MAX_EDGES 8
 
 /**
- * Structure of the shared memory
- * @brief All fields inside this struct are part of the shared memory.
+ * @brief The size (in bytes) of a vertex name in a solution, including the 
+ * zero-terminator
  */
-struct shm
+#define SOLUTION_NAME_SIZE (32)
+
+/**
+ * Structure of a removed edge
+ * @brief The names of both vertecies of an edge.
+ */
+struct solution_edge
 {
-	bool alive;
-	size_t readpos;
-	size_t writepos;
-	char data[SHM_SIZE];
+	char v1[SOLUTION_NAME_SIZE];
+	char v2[SOLUTION_NAME_SIZE];
 };
 
 /**
- * Shared memory open function
- * @brief This function creates/connects to the shared memory, depending on the
- * role of the caller.
- * @details The value of shmfd might be modified, even tough the function
- * returned with NULL, in which case the file descriptor is invalid and should 
- * not be used. 
- * In general the filedescriptor should not be used to read or 
- * write data to the shared memory, but should only be saved unitl 
- * close_sharedmem gets called. 
- * The caller must not free() the struct returned by this function, if it is no 
- * longer needed, but must call close_sharedmem to free the resources.
- * At any point there should only be one shm struct per process
- * that got created with this function.
- * A server process must call this function first, before any client process 
- * calls it, because the server creates some resources to which the client just
- * connects.
- * @param shmfd A pointer to a filedescriptor. This function will overwrite 
- * the value with a filedescriptor to the shared memory.
- * @param role The role of the calling process. Allowed values are 's' for 
- * server and 'c' for client. There can only be one server, but many clients. 
- * @return Upon success this function will return a pointer to shm struct which 
- * might be shared with other processes. Otherwise NULL is returned.
+ * Structure of a solution
+ * @brief A solution is the list of edges which have to be removed, so that 
+ * the graph is 3-colorable.
+ * @details Only the first count edges are valid and get copied. optimal is
+ * set by a generator that proved that no solution has fewer edges.
  */
-struct shm *open_sharedmem(int *shmfd, char role);
+struct solution
+{
+	size_t count;
+	bool optimal;
+	struct solution_edge edges[MAX_EDGES];
+};
 
 /**
- * Shared memory close function
- * @brief This function closes the connectio and maybe deletes the shared memory
- * depending on the role of the caller.
- * @details After this call the pointer shm will point to invalid memory, and 
- * reading from or writing to it is udefined behaivor.
- * @param shm A pointer to a sharedmem struct created with open_sharedmem
- * @param shmfd A file descriptor created by open_sharedmem
- * @param role The role of the calling process. Allowed values are 's' for 
- * server and 'c' for client. There can only be one server, but many clientsn. 
- * @return Upon success this function will return 0, otherwise -1.
+ * @brief The number of bytes of a solution that are used
  */
-int close_sharedmem(struct shm *shm, int shmfd, char role);
+#define SOLUTION_USED_SIZE(s) \
+	(offsetof(struct solution, edges) + (s)->count * sizeof(struct solution_edge))
+
+/**
+ * Structure of the shared memory configuration
+ * @brief The server chooses the geometry of the shared memory at startup.
+ * @details slots must be between 1 and SHM_MAX_SLOTS, max_edges between 0 and 
+ * MAX_EDGES. If hugepages is set the shared memory is rounded up to a multiple 
+ * of 2 MiB and the kernel is asked to back it with transparent hugepages 
+ * (which only works if shmem_enabled allows it).
+ */
+struct shm_config
+{
+	size_t slots;
+	size_t max_edges;
+	bool hugepages;
+};
+
+/**
+ * Structure of the shared memory
+ * @brief The part of the shared memory that belongs to this program.
+ * @details The slots, the best solution and the flags are managed by the 
+ * shmring module, the program only keeps the geometry there which the ring 
+ * doesn't know about, so the clients don't need to know it when they get 
+ * compiled: max_edges is the upper limit of edges in a solution.
+ */
+struct shm
+{
+	size_t max_edges;
+};
 
 #endif
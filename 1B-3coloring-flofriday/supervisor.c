@@ -15,6 +15,7 @@
 #include <errno.h>
 #include <string.h>
 #include <signal.h>
+#include <unistd.h>
 
 #include "circbuf.h"
 
@@ -36,13 +37,55 @@ static void handle_signal(int signal)
 	quit = 1;
 }
 
+/**
+ * Usage function.
+ * @brief This function writes a short usage description to stderr and exits the
+ * program.
+ * @details Exit the process with EXIT_FAILURE.
+ * @param procname The name of the program.
+ **/
+static void usage(const char *procname)
+{
+	fprintf(stderr, "[%s] Usage: %s [-s slots] [-m max_edges] [-H]\n", procname, procname);
+	fprintf(stderr, "[%s] \t -s The number of slots in the buffer (1-%d, default %d)\n", procname, SHM_MAX_SLOTS, SHM_SLOTS);
+	fprintf(stderr, "[%s] \t -m The most edges a solution may have (0-%d, default %d)\n", procname, MAX_EDGES, MAX_EDGES);
+	fprintf(stderr, "[%s] \t -H Back the buffer with hugepages if possible\n", procname);
+	exit(EXIT_FAILURE);
+}
+
+/**
+ * Parse a number option.
+ * @brief Parses the argument of an option and exits with the usage if it isn't
+ * a number between min and max.
+ * @param procname The name of the program.
+ * @param arg The argument of the option.
+ * @param min The smallest allowed value.
+ * @param max The biggest allowed value.
+ * @return The parsed number.
+ */
+static size_t parse_number(const char *procname, const char *arg, long min, long max)
+{
+	char *end;
+	errno = 0;
+	long value = strtol(arg, &end, 10);
+	if (errno != 0 || end == arg || *end != '\0' || value < min || value > max)
+	{
+		fprintf(stderr, "[%s] ERROR: \"%s\" is not a number between %ld and %ld\n", procname, arg, min, max);
+		usage(procname);
+	}
+	return value;
+}
+
 /**
  * Supervisors entry point.
  * @brief The complete logic is implemented in this function. First the program
  * creates a shared circular buffer. Then it reads in a loop from the buffer and
  * if a solution in the buffer is the best it has yet seen it will print that 
  * solution to stdout. The loop will only be exited if a signal interrupts the 
- * process or the best solution with 0 edges was found.
+ * process, the best solution with 0 edges was found or a generator proved that
+ * the best solution is optimal.
+ * The options set the geometry of the buffer, which the generators read from 
+ * the shared memory.
  * @details global variables: quit
  * @param argc The argument counter.
  * @param argv The argument vector.
@@ -57,17 +100,37 @@ int main(int argc, char const *argv[])
 	sigaction(SIGINT, &sa, NULL);
 	sigaction(SIGTERM, &sa, NULL);
 
-	// Check that there are no arguments passed to the program
-	if (argc > 1)
+	// Parse the options
+	struct shm_config config = {.slots = SHM_SLOTS, .max_edges = MAX_EDGES, .hugepages = false};
+	int c;
+	while ((c = getopt(argc, (char *const *)argv, "s:m:H")) != -1)
 	{
-		fprintf(stderr, "[%s] ERROR: Too many arguments, the supervisor doesn't accept any arguments.\n", argv[0]);
-		fprintf(stderr, "[%s] Usage: %s \n", argv[0], argv[0]);
-		exit(EXIT_FAILURE);
+		switch (c)
+		{
+		case 's':
+			config.slots = parse_number(argv[0], optarg, 1, SHM_MAX_SLOTS);
+			break;
+		case 'm':
+			config.max_edges = parse_number(argv[0], optarg, 0, MAX_EDGES);
+			break;
+		case 'H':
+			config.hugepages = true;
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	// Check that there are no other arguments passed to the program
+	if (optind < argc)
+	{
+		fprintf(stderr, "[%s] ERROR: Too many arguments, the supervisor only accepts options.\n", argv[0]);
+		usage(argv[0]);
 	}
 
 	// Open the shared circular buffer
 	struct circbuf *circbuf;
-	circbuf = open_circbuf('s');
+	circbuf = open_circbuf('s', &config);
 	if (circbuf == NULL)
 	{
 		fprintf(stderr, "[%s] ERROR: Unable to open shared circular buffer: %s\n", argv[0], strerror(errno));
@@ -83,32 +146,29 @@ int main(int argc, char const *argv[])
 	while (!quit)
 	{
 		// Read a solution from the circular buffer
-		char *s = read_circbuf(circbuf);
-		if (s == NULL)
+		struct solution s;
+		if (read_circbuf(circbuf, &s) == -1)
 		{
 			break;
 		}
-
-		// Count the edges in the just read solution
-		size_t len = strlen(s);
-		int tmp_min = 0;
-		for (int i = 0; i < len; i++)
-		{
-			if (s[i] == '-')
-			{
-				tmp_min++;
-			}
-		}
+		int tmp_min = s.count;
 
 		// Print the solution if it is the best yet
-		if (!has_min || tmp_min < min)
+		bool better = !has_min || tmp_min < min;
+		if (better)
 		{
 			has_min = true;
 			min = tmp_min;
+			write_best_circbuf(circbuf, &s);
 
 			if (min > 0)
 			{
-				printf("[%s] Solution with %d edges: %s\n", argv[0], min, s);
+				printf("[%s] Solution with %d edges: ", argv[0], min);
+				for (size_t i = 0; i < s.count; i++)
+				{
+					printf("%s-%s ", s.edges[i].v1, s.edges[i].v2);
+				}
+				printf("\n");
 			}
 			else
 			{
@@ -119,7 +179,13 @@ int main(int argc, char const *argv[])
 			}
 		}
 
-		free(s);
+		// A generator proved that no solution has fewer edges, so the
+		// generators won't find a better one
+		if (s.optimal && !quit && (better || tmp_min == min))
+		{
+			printf("[%s] The solution with %d edges is optimal!\n", argv[0], min);
+			quit = true;
+		}
 	}
 
 	// Free the resources of the circular buffer
@@ -0,0 +1,741 @@
+/**
+ * @file pipebench.c
+ * @date 14.02.2021
+ *
+ * @brief A benchmark for the supervisor/generator pipelines of the second
+ * exercise (3coloring and fb_arc_set).
+ * @details Generates a random graph from a fixed seed and runs the supervisor
+ * of every given solution with 1 up to N generators on it for a fixed
+ * duration. The output of the supervisor is read through a pseudo terminal,
+ * so it is line buffered and every new best solution can be timestamped.
+ * Per run one CSV row with the best size, the time to reach it and what the
+ * generators spent on the CPU and blocked (waiting on semaphores, futexes or
+ * sleeping) is printed, the best-size-over-time curve can be written to a
+ * second CSV file.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+/**
+ * The maximum number of vertices of the random graph.
+ **/
+#define MAX_VERTICES 4096
+
+/**
+ * The maximum number of generators of a run.
+ **/
+#define MAX_GENERATORS 64
+
+/**
+ * The maximum number of arguments given to a supervisor or generator with -a
+ * and -A (or after the colon of a solution).
+ **/
+#define MAX_EXTRA_ARGS 16
+
+/**
+ * How long (in milliseconds) the supervisor gets to set up the shared memory
+ * before the generators are started.
+ **/
+#define SETUP_MS 200
+
+/**
+ * How long (in milliseconds) the processes get to exit after the supervisor
+ * got SIGINT, before they are killed.
+ **/
+#define SHUTDOWN_MS 2000
+
+/**
+ * The configuration of all runs.
+ **/
+struct options
+{
+    long vertices;
+    long edges;
+    long seed;
+    long generators;
+    long duration;
+    char *supervisor_args;
+    char *generator_args;
+    char *curve_path;
+};
+
+/**
+ * The results of a run.
+ **/
+struct results
+{
+    long improvements;
+    long best;
+    double time_to_best;
+    double rate_sum;
+    long rate_samples;
+    double generator_cpu;
+    double generator_blocked;
+    long voluntary_switches;
+};
+
+/**
+ * The name of the current program.
+ **/
+static char *prog_name;
+
+/**
+ * The edges of the random graph as "u-v" arguments.
+ **/
+static char **edge_args;
+
+/**
+ * The file the best-size-over-time curve is written to, or NULL.
+ **/
+static FILE *curve;
+
+/**
+ * Print the usage and exit.
+ **/
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: %s [-n VERTICES] [-e EDGES] [-s SEED] [-g GENERATORS] [-d SECONDS] "
+            "[-a SUPERVISOR_ARGS] [-A GENERATOR_ARGS] [-c CURVE.csv] DIR[:SUPERVISOR_ARGS]...\n",
+            prog_name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Get the current time.
+ * @return The time of the monotonic clock in microseconds.
+ **/
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Sleep for a while.
+ * @param ms The time to sleep in milliseconds.
+ **/
+static void sleep_ms(long ms)
+{
+    struct timespec ts = {.tv_sec = ms / 1000, .tv_nsec = (ms % 1000) * 1000000L};
+    while (nanosleep(&ts, &ts) == -1 && errno == EINTR)
+    {
+    }
+}
+
+/**
+ * Parse a number option.
+ * @return The number, the program exits if it isn't in [min, max].
+ **/
+static long parse_number(const char *arg, long min, long max)
+{
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || value < min ||
+        value > max)
+    {
+        usage();
+    }
+    return value;
+}
+
+/**
+ * Get the next pseudo random number.
+ * @brief A xorshift64* generator, so the graph only depends on the seed.
+ **/
+static uint64_t next_random(uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ULL;
+}
+
+/**
+ * Generate the random graph.
+ * @brief Fills edge_args with distinct edges between distinct vertices, the
+ * direction of every edge is random as well.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int generate_graph(const struct options *opts)
+{
+    size_t n = opts->vertices;
+    uint8_t *used = calloc((n * n + 7) / 8, 1);
+    edge_args = calloc(opts->edges, sizeof(char *));
+    if (used == NULL || edge_args == NULL)
+    {
+        free(used);
+        return -1;
+    }
+
+    uint64_t state = 0x9E3779B97F4A7C15ULL ^ (uint64_t)opts->seed;
+    for (long i = 0; i < opts->edges;)
+    {
+        size_t u = next_random(&state) % n;
+        size_t v = next_random(&state) % n;
+        size_t a = u < v ? u : v;
+        size_t b = u < v ? v : u;
+        if (u == v || used[(a * n + b) / 8] & (1 << (a * n + b) % 8))
+        {
+            continue;
+        }
+        used[(a * n + b) / 8] |= 1 << (a * n + b) % 8;
+
+        char arg[48];
+        snprintf(arg, sizeof(arg), "%zu-%zu", u, v);
+        if ((edge_args[i++] = strdup(arg)) == NULL)
+        {
+            free(used);
+            return -1;
+        }
+    }
+
+    free(used);
+    return 0;
+}
+
+/**
+ * Split extra arguments.
+ * @brief Splits a copy of the string at spaces into args.
+ * @return The number of arguments.
+ **/
+static int split_args(const char *str, char **args, char **copy)
+{
+    int count = 0;
+    *copy = NULL;
+    if (str == NULL)
+    {
+        return 0;
+    }
+    if ((*copy = strdup(str)) == NULL)
+    {
+        return 0;
+    }
+    for (char *arg = strtok(*copy, " "); arg != NULL && count < MAX_EXTRA_ARGS;
+         arg = strtok(NULL, " "))
+    {
+        args[count++] = arg;
+    }
+    return count;
+}
+
+/**
+ * Start the supervisor.
+ * @brief Forks and executes ./supervisor in dir, with its stdout and stderr
+ * connected to the slave of a new pseudo terminal.
+ * @param master Upon success set to the master of the pseudo terminal.
+ * @return Upon success the pid of the supervisor, otherwise -1.
+ **/
+static pid_t start_supervisor(const char *dir, const char *args, int *master)
+{
+    if ((*master = posix_openpt(O_RDWR | O_NOCTTY)) == -1)
+    {
+        return -1;
+    }
+    if (grantpt(*master) == -1 || unlockpt(*master) == -1)
+    {
+        close(*master);
+        return -1;
+    }
+    char *slave_name = ptsname(*master);
+
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        close(*master);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        setsid();
+        int slave = open(slave_name, O_RDWR);
+        if (slave == -1)
+        {
+            _exit(127);
+        }
+        // No "\r\n" translation, the lines get parsed
+        struct termios tio;
+        if (tcgetattr(slave, &tio) == 0)
+        {
+            cfmakeraw(&tio);
+            tcsetattr(slave, TCSANOW, &tio);
+        }
+        dup2(slave, STDOUT_FILENO);
+        dup2(slave, STDERR_FILENO);
+        close(slave);
+        close(*master);
+
+        char *copy;
+        char *argv[MAX_EXTRA_ARGS + 2] = {"./supervisor"};
+        int argc = 1 + split_args(args, argv + 1, &copy);
+        argv[argc] = NULL;
+        if (chdir(dir) == -1)
+        {
+            _exit(127);
+        }
+        execv(argv[0], argv);
+        _exit(127);
+    }
+    return pid;
+}
+
+/**
+ * Start a generator.
+ * @brief Forks and executes ./generator in dir with the random graph, its
+ * output is discarded.
+ * @return Upon success the pid of the generator, otherwise -1.
+ **/
+static pid_t start_generator(const char *dir, const struct options *opts)
+{
+    pid_t pid = fork();
+    if (pid != 0)
+    {
+        return pid;
+    }
+
+    int null = open("/dev/null", O_WRONLY);
+    if (null != -1)
+    {
+        dup2(null, STDOUT_FILENO);
+        dup2(null, STDERR_FILENO);
+        close(null);
+    }
+
+    char *copy;
+    char **argv = calloc(opts->edges + MAX_EXTRA_ARGS + 2, sizeof(char *));
+    if (argv == NULL)
+    {
+        _exit(127);
+    }
+    argv[0] = "./generator";
+    int argc = 1 + split_args(opts->generator_args, argv + 1, &copy);
+    for (long i = 0; i < opts->edges; i++)
+    {
+        argv[argc++] = edge_args[i];
+    }
+    argv[argc] = NULL;
+    if (chdir(dir) == -1)
+    {
+        _exit(127);
+    }
+    execv(argv[0], argv);
+    _exit(127);
+}
+
+/**
+ * Parse the rate of a statistics line.
+ * @brief Supervisors that print statistics report "X solutions/s", only the
+ * totals are counted (not the lines per generator).
+ * @return True if the line was a statistics line.
+ **/
+static bool parse_rate(const char *line, struct results *res)
+{
+    const char *unit = strstr(line, " solutions/s");
+    if (unit == NULL)
+    {
+        return false;
+    }
+    if (strstr(line, "generator") != NULL)
+    {
+        return true;
+    }
+
+    const char *start = unit;
+    while (start > line && (start[-1] == '.' || (start[-1] >= '0' && start[-1] <= '9')))
+    {
+        start--;
+    }
+    if (start < unit)
+    {
+        res->rate_sum += strtod(start, NULL);
+        res->rate_samples++;
+    }
+    return true;
+}
+
+/**
+ * Parse the size of a solution line.
+ * @brief Understands "... with N edges ...", the messages for a solution
+ * without edges (acyclic/3-colorable) and lines that only list the edges.
+ * @return The number of edges, or -1 if the line is no solution.
+ **/
+static long parse_best(const char *line)
+{
+    if (strstr(line, "acyclic") != NULL || strstr(line, "3-colorable") != NULL)
+    {
+        return 0;
+    }
+    if (strstr(line, "Usage") != NULL || strstr(line, "ERROR") != NULL ||
+        strstr(line, "rror") != NULL)
+    {
+        return -1;
+    }
+
+    const char *with = strstr(line, "with ");
+    if (with != NULL)
+    {
+        char *end;
+        long count = strtol(with + 5, &end, 10);
+        if (end != with + 5 && strncmp(end, " edge", 5) == 0)
+        {
+            return count;
+        }
+    }
+
+    // Count the "u-v" tokens
+    long count = 0;
+    for (const char *p = line; *p != '\0'; p++)
+    {
+        if (*p == '-' && p > line && p[-1] >= '0' && p[-1] <= '9' &&
+            p[1] >= '0' && p[1] <= '9')
+        {
+            count++;
+        }
+    }
+    return count > 0 ? count : -1;
+}
+
+/**
+ * Handle a line of the supervisor.
+ **/
+static void handle_line(const char *line, const char *name, long generators,
+                        uint64_t start, struct results *res)
+{
+    if (parse_rate(line, res))
+    {
+        return;
+    }
+
+    long best = parse_best(line);
+    if (best < 0 || (res->best >= 0 && best >= res->best))
+    {
+        return;
+    }
+
+    res->best = best;
+    res->improvements++;
+    res->time_to_best = (now_us() - start) / 1e6;
+    if (curve != NULL)
+    {
+        fprintf(curve, "%s,%ld,%.6f,%ld\n", name, generators, res->time_to_best, best);
+    }
+}
+
+/**
+ * Read the time a process spent on the CPU and waiting for it.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int read_schedstat(pid_t pid, double *cpu, double *runqueue)
+{
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%ld/schedstat", (long)pid);
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        return -1;
+    }
+    unsigned long long on_cpu, waiting;
+    int ret = fscanf(f, "%llu %llu", &on_cpu, &waiting) == 2 ? 0 : -1;
+    fclose(f);
+    *cpu = on_cpu / 1e9;
+    *runqueue = waiting / 1e9;
+    return ret;
+}
+
+/**
+ * Wait for the processes of a run.
+ * @brief Waits up to SHUTDOWN_MS for all processes, kills the remaining ones
+ * and adds up the resource usage of the generators.
+ **/
+static void reap(pid_t *pids, int count, struct results *res)
+{
+    uint64_t deadline = now_us() + SHUTDOWN_MS * 1000;
+    int alive = count;
+    while (alive > 0)
+    {
+        bool killed = now_us() >= deadline;
+        for (int i = 0; i < count; i++)
+        {
+            if (pids[i] <= 0)
+            {
+                continue;
+            }
+            if (killed)
+            {
+                kill(pids[i], SIGKILL);
+            }
+
+            int status;
+            struct rusage usage;
+            pid_t ret = wait4(pids[i], &status, killed ? 0 : WNOHANG, &usage);
+            if (ret == 0)
+            {
+                continue;
+            }
+            if (i > 0 && ret == pids[i])
+            {
+                res->voluntary_switches += usage.ru_nvcsw;
+            }
+            pids[i] = 0;
+            alive--;
+        }
+        if (alive > 0 && !killed)
+        {
+            sleep_ms(10);
+        }
+    }
+}
+
+/**
+ * Run the benchmark of one solution with a number of generators.
+ * @param pids Array of generators + 1 pids, the supervisor first.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int run(const char *dir, const char *args, const char *name,
+               const struct options *opts, long generators,
+               struct results *res)
+{
+    memset(res, 0, sizeof(*res));
+    res->best = -1;
+
+    pid_t pids[MAX_GENERATORS + 1];
+    memset(pids, 0, sizeof(pids));
+    int master;
+    if ((pids[0] = start_supervisor(dir, args, &master)) == -1)
+    {
+        return -1;
+    }
+    sleep_ms(SETUP_MS);
+
+    for (long i = 1; i <= generators; i++)
+    {
+        if ((pids[i] = start_generator(dir, opts)) == -1)
+        {
+            pids[i] = 0;
+        }
+    }
+
+    // Collect the output of the supervisor till the time is up or it exits
+    uint64_t start = now_us();
+    uint64_t end = start + opts->duration * 1000000;
+    char line[4096];
+    size_t line_len = 0;
+    bool supervisor_done = false;
+    while (!supervisor_done && now_us() < end)
+    {
+        struct pollfd pfd = {.fd = master, .events = POLLIN};
+        int timeout = (end - now_us()) / 1000 + 1;
+        if (poll(&pfd, 1, timeout) <= 0)
+        {
+            continue;
+        }
+
+        char chunk[4096];
+        ssize_t n = read(master, chunk, sizeof(chunk));
+        if (n <= 0)
+        {
+            // EIO once the supervisor closed the terminal
+            supervisor_done = true;
+            break;
+        }
+        for (ssize_t i = 0; i < n; i++)
+        {
+            if (chunk[i] == '\n' || chunk[i] == '\r' || line_len == sizeof(line) - 1)
+            {
+                line[line_len] = '\0';
+                handle_line(line, name, generators, start, res);
+                line_len = 0;
+            }
+            else
+            {
+                line[line_len++] = chunk[i];
+            }
+        }
+    }
+    double elapsed = (now_us() - start) / 1e6;
+
+    // The time the generators were neither running nor waiting for the CPU
+    for (long i = 1; i <= generators; i++)
+    {
+        double cpu, runqueue;
+        if (pids[i] > 0 && read_schedstat(pids[i], &cpu, &runqueue) == 0)
+        {
+            res->generator_cpu += cpu;
+            double blocked = elapsed - cpu - runqueue;
+            res->generator_blocked += blocked > 0 ? blocked : 0;
+        }
+    }
+
+    kill(pids[0], SIGINT);
+    reap(pids, generators + 1, res);
+    close(master);
+    return 0;
+}
+
+/**
+ * Print the result row of a run.
+ **/
+static void print_results(const char *name, const struct options *opts,
+                          long generators, const struct results *res)
+{
+    printf("%s,%ld,%ld,%ld,%ld,%ld,%ld,", name, opts->vertices, opts->edges,
+           opts->seed, generators, opts->duration, res->improvements);
+    if (res->best >= 0)
+    {
+        printf("%ld,%.6f,", res->best, res->time_to_best);
+    }
+    else
+    {
+        printf(",,");
+    }
+    if (res->rate_samples > 0)
+    {
+        printf("%.1f,", res->rate_sum / res->rate_samples);
+    }
+    else
+    {
+        printf(",");
+    }
+    printf("%.3f,%.3f,%ld\n", res->generator_cpu, res->generator_blocked,
+           res->voluntary_switches);
+    fflush(stdout);
+}
+
+/**
+ * Program entry point.
+ * @brief Parses the options, generates the graph and runs the benchmark of
+ * every solution with 1 to GENERATORS generators.
+ **/
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+    struct options opts = {.vertices = 20, .edges = 40, .seed = 1,
+                           .generators = 4, .duration = 5};
+
+    int c;
+    while ((c = getopt(argc, argv, "n:e:s:g:d:a:A:c:")) != -1)
+    {
+        switch (c)
+        {
+        case 'n':
+            opts.vertices = parse_number(optarg, 2, MAX_VERTICES);
+            break;
+        case 'e':
+            opts.edges = parse_number(optarg, 1, MAX_VERTICES * (MAX_VERTICES - 1) / 2);
+            break;
+        case 's':
+            opts.seed = parse_number(optarg, 0, INT32_MAX);
+            break;
+        case 'g':
+            opts.generators = parse_number(optarg, 1, MAX_GENERATORS);
+            break;
+        case 'd':
+            opts.duration = parse_number(optarg, 1, 3600);
+            break;
+        case 'a':
+            opts.supervisor_args = optarg;
+            break;
+        case 'A':
+            opts.generator_args = optarg;
+            break;
+        case 'c':
+            opts.curve_path = optarg;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind == argc || opts.edges > opts.vertices * (opts.vertices - 1) / 2)
+    {
+        usage();
+    }
+
+    if (generate_graph(&opts) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to generate the graph: %s\n",
+                prog_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (opts.curve_path != NULL)
+    {
+        if ((curve = fopen(opts.curve_path, "w")) == NULL)
+        {
+            fprintf(stderr, "[%s] ERROR: Unable to open %s: %s\n", prog_name,
+                    opts.curve_path, strerror(errno));
+            exit(EXIT_FAILURE);
+        }
+        fprintf(curve, "impl,generators,time_s,best\n");
+    }
+
+    printf("impl,vertices,edges,seed,generators,duration_s,improvements,best,"
+           "time_to_best_s,solutions_per_s,generator_cpu_s,generator_blocked_s,"
+           "voluntary_switches\n");
+
+    for (int i = optind; i < argc; i++)
+    {
+        // DIR[:SUPERVISOR_ARGS], the name is the last part of the directory
+        char *dir = strdup(argv[i]);
+        if (dir == NULL)
+        {
+            exit(EXIT_FAILURE);
+        }
+        char *args = strchr(dir, ':');
+        if (args != NULL)
+        {
+            *args++ = '\0';
+        }
+        else
+        {
+            args = opts.supervisor_args;
+        }
+        while (strlen(dir) > 1 && dir[strlen(dir) - 1] == '/')
+        {
+            dir[strlen(dir) - 1] = '\0';
+        }
+        const char *name = strrchr(dir, '/') != NULL ? strrchr(dir, '/') + 1 : dir;
+
+        for (long generators = 1; generators <= opts.generators; generators++)
+        {
+            struct results res;
+            if (run(dir, args, name, &opts, generators, &res) == -1)
+            {
+                fprintf(stderr, "[%s] ERROR: Unable to run %s: %s\n", prog_name,
+                        dir, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+            print_results(name, &opts, generators, &res);
+            if (curve != NULL)
+            {
+                fflush(curve);
+            }
+        }
+        free(dir);
+    }
+
+    if (curve != NULL)
+    {
+        fclose(curve);
+    }
+    for (long i = 0; i < opts.edges; i++)
+    {
+        free(edge_args[i]);
+    }
+    free(edge_args);
+    return EXIT_SUCCESS;
+}
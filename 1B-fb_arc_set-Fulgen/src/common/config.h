@@ -9,8 +9,12 @@
 
 #pragma once
 
-#define MAX_FEEDBACK_SETS 500 /**< The maximum number of feedback sets that can be stored inside the circular buffer **/
+#define MAX_FEEDBACK_SETS 500 /**< The default number of feedback sets that can be stored inside the circular buffer **/
+#define MAX_CAPACITY 65536 /**< The maximum number of feedback sets the supervisor accepts for -c **/
 #define MAX_NUM_EDGES 16 /**< The maximum number of edges in a feedback set **/
 
-#define MATRICULAR_NUMBER "11908523_" /**< The matricular number used as a prefix for shared memory and semaphores named **/
+#define MATRICULAR_NUMBER "11908523_" /**< The matricular number used as a prefix for the shared memory name **/
 #define SHM_NAME "fb_arc_set" /**< The name used for the shared memory in conjunction with MATRICULAR_NUMBER **/
+#define MAX_THREADS 64 /**< The maximum number of search threads of a generator **/
+#define MAX_DP_VERTICES 22 /**< The maximum number of vertices the exact search solves with the subset dynamic program (2^n bytes) **/
+#define MAX_EXACT_VERTICES 64 /**< The maximum number of vertices of the exact search **/
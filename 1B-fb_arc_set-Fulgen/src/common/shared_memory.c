@@ -1,78 +1,33 @@
-#include "named_semaphore.h"
 #include "shared_memory.h"
+#include "shmring.h"
 
-#include <assert.h>
 #include <errno.h>
-#include <fcntl.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/mman.h>
-#include <unistd.h>
 
-#define SEM_FREE 0
-#define SEM_USED 1
-#define SEM_WRITE 2
-
-static const char *const semaphore_names[] = {"free", "used", "write"}; /**< Semaphore names **/
-#define MAX_SEMAPHORE_NAME_SIZE 6 /**< Maximum semaphore name size, hardcoded for convenience. **/
+/**
+ * @brief The number of bytes of a feedback arc set that are used. Only those are copied through the buffer.
+ */
+#define USED_SIZE(arc_set) (offsetof(struct feedback_arc_set, edges) + (arc_set)->size * sizeof(struct edge))
 
 /**
  * @brief The shared_memory opaque struct.
+ * @details The buffer, the semaphores, the quit flag and the best size all live in the ring of the shmring module.
  */
 struct shared_memory
 {
-	char *name; /**< The shared memory file name **/
-	int fd; /**< The shared memory file descriptor **/
-	bool created; /**< Whether the shared memory file has been created or opened **/
-	void *memory; /**< A pointer to the memory mapped by mmap **/
-	size_t memory_map_size; /**< The memory map size **/
-	volatile bool *quit; /**< Whether the application should quit **/
-
+	struct shmring *ring; /**< The ring in the shared memory **/
 	bool is_supervisor; /**< Whether the application is a supervisor **/
-
-	size_t read_pos; /**< The read position. Unsynchronized as there can only be one supervisor **/
-	uint32_t *write_pos; /**< The write position. Fixed size as it's part of the shared memory **/
-	char *buffer; /**< The circular buffer in the memory map **/
-	size_t capacity; /**< How many feedback arc sets can be stored **/
-	struct named_semaphore *semaphores[3]; /**< The named semaphores **/
 };
 
-/**
- * @brief Initializes the semaphore pointer with a valid pointer to a named semaphore
- * @param semaphore A pointer to a named semaphore pointer
- * @param index An index of both the semaphore name and the semaphore (see semaphore_names)
- * @param name A semaphore name buffer used to write the full name to. It should already contain a leading slash and a prefix.
- * @param offset The offset in the name buffer which the semaphore name should be inserted at
- * @param value A value to initialize the named semaphore with
- * @return 0 on success. semaphore points to a valid named_semaphore pointer.
- * @return -1 on failure. semaphore points to a NULL named_semaphore pointer. Check errno for details.
- */
-static int initialize_semaphore(struct named_semaphore **semaphore, size_t index, char *name, size_t offset, int value)
-{
-	strcpy(name + offset + 1, semaphore_names[index]); // + 1 to account for the leading slash
-
-	if ((semaphore[index] = named_semaphore_create(name, value)) == NULL)
-	{
-		return -1;
-	}
-
-	return 0;
-}
-
 struct shared_memory *shared_memory_create(const char *const prefix, const char *const name, bool is_supervisor, size_t feedback_arc_capacity)
 {
 	char *shared_memory_name;
 	const size_t prefix_length = strlen(prefix);
 	const size_t name_length = strlen(name);
-	int fd;
-
-	bool created = false;
-	const size_t buffer_size = sizeof(bool) + sizeof(uint32_t) + feedback_arc_capacity * sizeof(struct feedback_arc_set);
-
 	struct shared_memory *shared_memory;
-	void *memory_map;
-	char *semaphore_name;
 
 	/* | leading slash | prefix | name | NUL */
 	if ((shared_memory_name = malloc((1 + prefix_length + name_length + 1) * sizeof(char))) == NULL)
@@ -84,22 +39,10 @@ struct shared_memory *shared_memory_create(const char *const prefix, const char
 	strcpy(shared_memory_name + 1, prefix);
 	strcpy(shared_memory_name + prefix_length + 1, name);
 
-	if ((fd = shm_open(shared_memory_name, O_RDWR, S_IRUSR | S_IWUSR)) == -1)
+	if (is_supervisor && (feedback_arc_capacity == 0 || feedback_arc_capacity > MAX_CAPACITY))
 	{
-		if (errno != ENOENT || !is_supervisor || (fd = shm_open(shared_memory_name, O_RDWR | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR)) == -1)
-		{
-			goto shm_open_error;
-		}
-		else
-		{
-			created = true;
-		}
-	}
-
-	if (ftruncate(fd, buffer_size) == -1)
-	{
-		// error in errno
-		goto ftruncate_error;
+		errno = EINVAL;
+		goto shared_memory_malloc_error;
 	}
 
 	if ((shared_memory = malloc(sizeof(struct shared_memory))) == NULL)
@@ -107,76 +50,36 @@ struct shared_memory *shared_memory_create(const char *const prefix, const char
 		goto shared_memory_malloc_error;
 	}
 
-	if ((memory_map = mmap(NULL, buffer_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == (void *) -1)
+	if (is_supervisor)
 	{
-		goto mmap_error;
-	}
-
-	if ((semaphore_name = malloc(prefix_length + MAX_SEMAPHORE_NAME_SIZE + 1)) == NULL)
-	{
-		goto semaphore_name_malloc_error;
-	}
+		const struct shmring_config config = {.record_size = sizeof(struct feedback_arc_set), .capacity = feedback_arc_capacity};
 
-	*semaphore_name = '/';
-
-	strncpy(semaphore_name + 1, prefix, prefix_length); // no +1 as the NUL character shouldn't be copied
-
-	if (initialize_semaphore(shared_memory->semaphores, SEM_FREE, semaphore_name, prefix_length, feedback_arc_capacity) == -1)
-	{
-		goto sem_free_error;
+		if ((shared_memory->ring = shmring_create(shared_memory_name, &config)) == NULL && errno == EEXIST)
+		{
+			// left over by a supervisor that didn't exit cleanly; the generators join a running supervisor, so
+			// only it may reset the shared state
+			shm_unlink(shared_memory_name);
+			shared_memory->ring = shmring_create(shared_memory_name, &config);
+		}
 	}
-
-	if (initialize_semaphore(shared_memory->semaphores, SEM_USED, semaphore_name, prefix_length, 0) == -1)
+	else
 	{
-		goto sem_used_error;
+		/* The supervisor chose the capacity, which is checked against the size once it is mapped */
+		shared_memory->ring = shmring_open(shared_memory_name, sizeof(struct feedback_arc_set));
 	}
 
-	if (initialize_semaphore(shared_memory->semaphores, SEM_WRITE, semaphore_name, prefix_length, 1) == -1)
+	if (shared_memory->ring == NULL)
 	{
-		goto sem_write_error;
+		goto ring_error;
 	}
 
-	free(semaphore_name);
-
-	shared_memory->name = shared_memory_name;
-	shared_memory->fd = fd;
-	shared_memory->created = created;
-	shared_memory->memory = memory_map;
-	shared_memory->memory_map_size = buffer_size;
-	shared_memory->quit = memory_map;
+	free(shared_memory_name);
 	shared_memory->is_supervisor = is_supervisor;
-	shared_memory->read_pos = 0;
-	shared_memory->write_pos = (uint32_t *) ((char *) memory_map + sizeof(bool));
-	*shared_memory->write_pos = 0;
-	shared_memory->buffer = (char *) shared_memory->write_pos + sizeof(uint32_t);
-	shared_memory->capacity = feedback_arc_capacity;
-
-	if (*shared_memory->quit != true && *shared_memory->quit != false)
-	{
-		// garbage set as quit; set it to false
-		*shared_memory->quit = false;
-	}
-
 	return shared_memory;
 
-sem_write_error:
-	named_semaphore_destroy(shared_memory->semaphores[SEM_USED]);
-sem_used_error:
-	named_semaphore_destroy(shared_memory->semaphores[SEM_FREE]);
-sem_free_error:
-	free(semaphore_name);
-semaphore_name_malloc_error:
-	munmap(memory_map, buffer_size);
-mmap_error:
+ring_error:
 	free(shared_memory);
-ftruncate_error:
 shared_memory_malloc_error:
-	close(fd);
-	if (created)
-	{
-		shm_unlink(shared_memory_name);
-	}
-shm_open_error:
 	free(shared_memory_name);
 shared_memory_name_malloc_error:
 	return NULL;
@@ -184,18 +87,7 @@ shared_memory_name_malloc_error:
 
 void shared_memory_destroy(struct shared_memory *memory)
 {
-	named_semaphore_destroy(memory->semaphores[SEM_WRITE]);
-	named_semaphore_destroy(memory->semaphores[SEM_USED]);
-	named_semaphore_destroy(memory->semaphores[SEM_FREE]);
-	munmap(memory->memory, memory->memory_map_size);
-	close(memory->fd);
-
-	if (memory->created)
-	{
-		shm_unlink(memory->name);
-	}
-
-	free(memory->name);
+	shmring_close(memory->ring);
 	free(memory);
 }
 
@@ -207,55 +99,56 @@ int shared_memory_request_quit(struct shared_memory *memory)
 		return -1;
 	}
 
-	*memory->quit = true;
+	shmring_shutdown(memory->ring);
 	return 0;
 }
 
 bool shared_memory_quit_requested(struct shared_memory *const memory)
 {
-	return *memory->quit;
+	return !shmring_alive(memory->ring);
 }
 
-static int wait_for_semaphore(struct named_semaphore *const semaphore, volatile bool *quit)
+int shared_memory_set_best_size(struct shared_memory *memory, uint32_t size)
 {
-	for (int ret = 0; (ret = named_semaphore_wait(semaphore)); )
+	if (!memory->is_supervisor)
 	{
-		if (ret == -1)
-		{
-			if (errno == EINTR && *quit != 1)
-			{
-				continue;
-			}
-
-			return ret;
-		}
+		errno = EPERM;
+		return -1;
 	}
 
+	shmring_set_best(memory->ring, size, NULL, 0);
 	return 0;
 }
 
-int shared_memory_write_feedback_arc_set(struct shared_memory *memory, struct feedback_arc_set *const arc_set)
+uint32_t shared_memory_best_size(struct shared_memory *const memory)
 {
-	if (memory->is_supervisor)
-	{
-		errno = EPERM;
-		return -1;
-	}
+	const uint64_t bound = shmring_best_bound(memory->ring);
+	return bound > UINT32_MAX ? UINT32_MAX : (uint32_t) bound;
+}
 
-	if (wait_for_semaphore(memory->semaphores[SEM_WRITE], memory->quit) == -1)
+/**
+ * @brief Maps the shutdown of the ring to the errors of this module
+ * @return -1. errno is set to EINTR if quit was set.
+ */
+static int ring_error(void)
+{
+	if (errno == ECANCELED)
 	{
-		return -1;
+		errno = EINTR;
 	}
 
-	if (wait_for_semaphore(memory->semaphores[SEM_FREE], memory->quit) == -1)
+	return -1;
+}
+
+int shared_memory_write_feedback_arc_set(struct shared_memory *memory, struct feedback_arc_set *const arc_set)
+{
+	if (memory->is_supervisor)
 	{
+		errno = EPERM;
 		return -1;
 	}
 
-	memcpy(memory->buffer + *memory->write_pos * sizeof(struct feedback_arc_set), arc_set, sizeof(struct feedback_arc_set));
-	*memory->write_pos = (*memory->write_pos + 1) % memory->capacity;
-
-	return named_semaphore_post(memory->semaphores[SEM_USED]) == 0 && named_semaphore_post(memory->semaphores[SEM_WRITE]) == 0 ? 0 : -1;
+	return shmring_write(memory->ring, arc_set, USED_SIZE(arc_set)) == -1 ? ring_error() : 0;
 }
 
 int shared_memory_read_feedback_arc_set(struct shared_memory *memory, struct feedback_arc_set *arc_set)
@@ -266,13 +159,5 @@ int shared_memory_read_feedback_arc_set(struct shared_memory *memory, struct fee
 		return -1;
 	}
 
-	if (wait_for_semaphore(memory->semaphores[SEM_USED], memory->quit) == -1)
-	{
-		return -1;
-	}
-
-	memcpy(arc_set, memory->buffer + memory->read_pos * sizeof(struct feedback_arc_set), sizeof(struct feedback_arc_set));
-	memory->read_pos = (memory->read_pos + 1) % memory->capacity;
-
-	return named_semaphore_post(memory->semaphores[SEM_FREE]);
+	return shmring_read(memory->ring, arc_set, NULL) == -1 ? ring_error() : 0;
 }
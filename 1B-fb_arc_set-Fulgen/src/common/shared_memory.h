@@ -6,10 +6,13 @@
  * @brief Shared memory datastrucure
  *
  * This module provides a datastructure representing circular buffer in shared memory as well as the necessary semaphores to ensure synchronicity and
- * data integrity.
+ * data integrity. Both are a ring of the shmring module (../libshmring), whose backend (lockfree or semaphore) is chosen with the environment
+ * variable SHMRING_BACKEND of the supervisor.
  * Generators can write to the circular buffer occurs by calling shared_memory_write_feedback_arc_set. The supervisor can read via
  * shared_memory_read_feedback_arc_set. Generators cannot read from and supervisors cannot write to the buffer.
  * The supervisor can request generators to quit using shared_memory_request_quit; generators can check for that using shared_memory_quit_requested.
+ * The supervisor publishes the size of the best set it has read using shared_memory_set_best_size; generators can read it using
+ * shared_memory_best_size and discard any set that is not smaller.
  **/
 
 #pragma once
@@ -23,16 +26,18 @@
  * @brief The shared_memory struct
  *
  * @details This is an opaque struct which only be used as an argument to
- * shared_memory_create, shared_memory_destroy, shared_memory_request_quit, shared_memory_quit_requested, shared_memory_write_feedback_arc_set and shared_memory_read_feedback_arc_set.
+ * shared_memory_create, shared_memory_destroy, shared_memory_request_quit, shared_memory_quit_requested, shared_memory_set_best_size,
+ * shared_memory_best_size, shared_memory_write_feedback_arc_set and shared_memory_read_feedback_arc_set.
  **/
 struct shared_memory;
 
 /**
  * @brief Creates a new shared memory structure
- * @param prefix The prefix used to prefix the shared memory name and the semaphore names. A leading slash is automatically added by the implementation.
+ * @param prefix The prefix used to prefix the shared memory name. A leading slash is automatically added by the implementation.
  * @param name The name for the shared memory
  * @param is_supervisor Whether the caller is a supervisor or a generator
- * @param feedback_arc_capacity How many instances of struct feedback_arc_set the circular buffer should have the capacity for
+ * @param feedback_arc_capacity How many instances of struct feedback_arc_set the circular buffer should have the capacity for,
+ * 1 to MAX_CAPACITY. Only used by the supervisor, which stores it in the shared memory for the generators.
  * @return A valid pointer to a named semaphore struct if successful
  * @return NULL on error. Check errno for details.
  **/
@@ -46,6 +51,7 @@ void shared_memory_destroy(struct shared_memory *memory);
 
 /**
  * @brief Requests generators to quit.
+ * @details Wakes up every process blocked on the buffer, may be called from a signal handler.
  * @param memory A valid pointer to a shared memory struct
  * @return 0 on success
  * @return -1 if not a supervisor. errno is set to EPERM.
@@ -60,13 +66,31 @@ int shared_memory_request_quit(struct shared_memory *memory);
  **/
 bool shared_memory_quit_requested(struct shared_memory *const memory);
 
+/**
+ * @brief Publishes the size of the best feedback arc set read so far to the generators.
+ * @param memory A valid pointer to a shared memory struct
+ * @param size The number of edges of the best feedback arc set
+ * @return 0 on success
+ * @return -1 if not a supervisor. errno is set to EPERM.
+ **/
+int shared_memory_set_best_size(struct shared_memory *memory, uint32_t size);
+
+/**
+ * @brief Returns the size of the best feedback arc set the supervisor has read so far
+ * @details Before the supervisor has read any set, UINT32_MAX is returned.
+ * @param memory A valid pointer to a shared memory struct
+ * @return The number of edges of the best feedback arc set
+ **/
+uint32_t shared_memory_best_size(struct shared_memory *const memory);
+
 /**
  * @brief Writes a feedback arc set to the circular buffer.
- * @details This function blocks until it has acquired the write semaphore and until enough space is present in the circular buffer.
+ * @details This function blocks until enough space is present in the circular buffer. Only the first size edges are copied.
  * @param memory A valid pointer to a shared memory struct
  * @param arc_set A pointer to the feedback arc set to write. Note that no validation is occuring, the caller is responsible for the set's integrity.
  * @return 0 on success
- * @return -1 if not a supervisor. errno is set to EPERM.
+ * @return -1 if a supervisor. errno is set to EPERM.
+ * @return -1 if quitting has been requested. errno is set to EINTR.
  * @return -1 on error. Check errno for details.
  **/
 int shared_memory_write_feedback_arc_set(struct shared_memory *memory, struct feedback_arc_set *const arc_set);
@@ -77,7 +101,8 @@ int shared_memory_write_feedback_arc_set(struct shared_memory *memory, struct fe
  * @param memory A valid pointer to a shared memory struct
  * @param arc_set A pointer to the feedback arc set to copy the read set into. Note that no validation is occuring, the caller is responsible for checking the set's integrity.
  * @return 0 on success
- * @return -1 if a supervisor. errno is set to EPERM.
+ * @return -1 if not a supervisor. errno is set to EPERM.
+ * @return -1 if quitting has been requested or a signal arrived. errno is set to EINTR.
  * @return -1 on error. Check errno for details.
  */
 int shared_memory_read_feedback_arc_set(struct shared_memory *memory, struct feedback_arc_set *arc_set);
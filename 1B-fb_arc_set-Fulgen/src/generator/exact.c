@@ -0,0 +1,724 @@
+/**
+ * @file exact.c
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Exact feedback arc set search
+ *
+ * Implementation of the exact search, see exact.h.
+ **/
+
+#include "exact.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define POLL_NODES 65536 /**< The number of branch and bound nodes after which a thread polls the shared memory **/
+
+/**
+ * @brief The graph with its vertices as indices and its edges as bit masks
+ * @details Duplicate edges are kept in layers: bit w of out[k * MAX_EXACT_VERTICES + v] is set if there are more than k edges v-w, in
+ * holds the same for the reversed edges. So the number of edges from v into a set of vertices is the sum of the popcounts over all layers.
+ **/
+struct graph
+{
+	size_t num_vertices; /**< The number of vertices **/
+	uint64_t all; /**< The set of all vertices **/
+	size_t num_layers; /**< The highest number of duplicates of an edge **/
+	uint64_t *out; /**< The out masks of every layer **/
+	uint64_t *in; /**< The in masks of every layer **/
+	const struct edge *edges; /**< The edges of the graph **/
+	size_t num_edges; /**< The number of edges **/
+	uint32_t *edge_u; /**< The index of the start vertex of every edge **/
+	uint32_t *edge_v; /**< The index of the end vertex of every edge **/
+	uint32_t loops; /**< The number of loops, which are always backward **/
+};
+
+/**
+ * @brief Shared state of the dynamic program
+ **/
+struct dp
+{
+	const struct graph *graph; /**< The graph **/
+	struct shared_memory *memory; /**< The shared memory to poll **/
+	uint8_t *best; /**< The fewest backward edges of every subset, saturated at UINT8_MAX **/
+	size_t num_threads; /**< The number of threads **/
+	pthread_mutex_t start; /**< Held while the threads are created, so num_threads and barrier are final once a thread got it **/
+	pthread_barrier_t barrier; /**< Separates the layers **/
+	bool quit[MAX_DP_VERTICES + 1]; /**< Whether quitting was requested before the end of a layer, written by the first thread only **/
+	uint64_t binomial[MAX_DP_VERTICES + 1][MAX_DP_VERTICES + 1]; /**< binomial[n][k] is n choose k **/
+};
+
+/**
+ * @brief State of one thread of the dynamic program
+ **/
+struct dp_thread
+{
+	pthread_t thread; /**< The thread **/
+	struct dp *dp; /**< The shared state **/
+	size_t index; /**< The index of the thread, which selects its part of every layer **/
+};
+
+/**
+ * @brief Shared state of the branch and bound
+ **/
+struct bnb
+{
+	const struct graph *graph; /**< The graph **/
+	struct shared_memory *memory; /**< The shared memory to poll **/
+	pthread_mutex_t lock; /**< Protects the changes of bound, found and best_order **/
+	uint32_t bound; /**< Only orderings with fewer backward edges are of interest. Read atomically **/
+	bool found; /**< Whether best_order has bound backward edges **/
+	bool quit; /**< Whether quitting was requested. Only accessed atomically **/
+	uint32_t best_order[MAX_EXACT_VERTICES]; /**< The best ordering found **/
+	uint32_t prefix[MAX_EXACT_VERTICES]; /**< The vertices every ordering starts with **/
+	size_t prefix_len; /**< The number of vertices in prefix **/
+	uint64_t prefix_set; /**< The set of vertices in prefix **/
+	uint32_t prefix_cost; /**< The backward edges of prefix, including the loops **/
+	uint32_t roots[MAX_EXACT_VERTICES]; /**< The candidates for the vertex after prefix, one subtree each **/
+	size_t num_roots; /**< The number of roots **/
+	size_t next_root; /**< The next subtree to take. Only accessed atomically **/
+};
+
+/**
+ * @brief State of one thread of the branch and bound
+ **/
+struct bnb_thread
+{
+	pthread_t thread; /**< The thread **/
+	struct bnb *bnb; /**< The shared state **/
+	uint32_t order[MAX_EXACT_VERTICES]; /**< The current ordering **/
+	unsigned long nodes; /**< The number of visited nodes **/
+};
+
+/**
+ * @brief Returns the number of edges from a vertex into a set of vertices
+ * @param graph The graph
+ * @param vertex The index of the vertex
+ * @param set The set of vertices
+ * @return The number of edges
+ **/
+static uint32_t edges_into(const struct graph *graph, uint32_t vertex, uint64_t set)
+{
+	uint32_t count = 0;
+	for (size_t k = 0; k < graph->num_layers; ++k)
+	{
+		count += __builtin_popcountll(graph->out[k * MAX_EXACT_VERTICES + vertex] & set);
+	}
+	return count;
+}
+
+/**
+ * @brief Returns the number of 2-cycles between a vertex and a set of vertices
+ * @details A 2-cycle with more edges in one direction counts as often as the other direction has edges.
+ * @param graph The graph
+ * @param vertex The index of the vertex
+ * @param set The set of vertices
+ * @return The number of 2-cycles, of which one edge is backward in every ordering
+ **/
+static uint32_t cycles_with(const struct graph *graph, uint32_t vertex, uint64_t set)
+{
+	uint32_t count = 0;
+	for (size_t k = 0; k < graph->num_layers; ++k)
+	{
+		count += __builtin_popcountll(graph->out[k * MAX_EXACT_VERTICES + vertex] & graph->in[k * MAX_EXACT_VERTICES + vertex] & set);
+	}
+	return count;
+}
+
+/**
+ * @brief Builds the bit masks of a graph
+ * @param graph The graph to fill
+ * @param edges The edges
+ * @param num_edges The number of edges
+ * @param vertices The distinct vertices
+ * @param num_vertices The number of vertices, at most MAX_EXACT_VERTICES
+ * @return 0 on success
+ * @return -1 on error. Check errno for details.
+ **/
+static int build_graph(struct graph *graph, const struct edge *edges, size_t num_edges, const uint32_t *vertices, size_t num_vertices)
+{
+	memset(graph, 0, sizeof(*graph));
+	graph->num_vertices = num_vertices;
+	graph->all = num_vertices == 64 ? UINT64_MAX : (UINT64_C(1) << num_vertices) - 1;
+	graph->edges = edges;
+	graph->num_edges = num_edges;
+
+	uint32_t *multiplicity = calloc(MAX_EXACT_VERTICES * MAX_EXACT_VERTICES, sizeof(uint32_t));
+	graph->edge_u = malloc(num_edges * sizeof(uint32_t));
+	graph->edge_v = malloc(num_edges * sizeof(uint32_t));
+	if (multiplicity == NULL || graph->edge_u == NULL || graph->edge_v == NULL)
+	{
+		goto error;
+	}
+
+	for (size_t i = 0; i < num_edges; ++i)
+	{
+		for (uint32_t j = 0; j < num_vertices; ++j)
+		{
+			if (vertices[j] == edges[i].u)
+			{
+				graph->edge_u[i] = j;
+			}
+			if (vertices[j] == edges[i].v)
+			{
+				graph->edge_v[i] = j;
+			}
+		}
+
+		if (graph->edge_u[i] == graph->edge_v[i])
+		{
+			++graph->loops;
+			continue;
+		}
+
+		uint32_t count = ++multiplicity[graph->edge_u[i] * MAX_EXACT_VERTICES + graph->edge_v[i]];
+		if (count > graph->num_layers)
+		{
+			graph->num_layers = count;
+		}
+	}
+
+	/* The first layer is always there, as it holds the adjacency */
+	size_t layers = graph->num_layers > 0 ? graph->num_layers : 1;
+	graph->out = calloc(layers * MAX_EXACT_VERTICES, sizeof(uint64_t));
+	graph->in = calloc(layers * MAX_EXACT_VERTICES, sizeof(uint64_t));
+	if (graph->out == NULL || graph->in == NULL)
+	{
+		goto error;
+	}
+
+	for (uint32_t u = 0; u < num_vertices; ++u)
+	{
+		for (uint32_t v = 0; v < num_vertices; ++v)
+		{
+			for (uint32_t k = 0; k < multiplicity[u * MAX_EXACT_VERTICES + v]; ++k)
+			{
+				graph->out[k * MAX_EXACT_VERTICES + u] |= UINT64_C(1) << v;
+				graph->in[k * MAX_EXACT_VERTICES + v] |= UINT64_C(1) << u;
+			}
+		}
+	}
+
+	free(multiplicity);
+	return 0;
+
+error:
+	free(multiplicity);
+	free(graph->edge_u);
+	free(graph->edge_v);
+	free(graph->out);
+	free(graph->in);
+	return -1;
+}
+
+/**
+ * @brief Frees the masks of a graph built with build_graph
+ * @param graph The graph
+ **/
+static void free_graph(struct graph *graph)
+{
+	free(graph->edge_u);
+	free(graph->edge_v);
+	free(graph->out);
+	free(graph->in);
+}
+
+/**
+ * @brief Fills a feedback arc set with the backward edges of an ordering
+ * @param graph The graph
+ * @param position The position of every vertex in the ordering
+ * @param arc_set The feedback arc set to fill, the ordering must have at most MAX_NUM_EDGES backward edges
+ **/
+static void fill_arc_set(const struct graph *graph, const uint32_t *position, struct feedback_arc_set *arc_set)
+{
+	memset(arc_set, 0, sizeof(*arc_set));
+	for (size_t i = 0; i < graph->num_edges; ++i)
+	{
+		if (position[graph->edge_u[i]] >= position[graph->edge_v[i]])
+		{
+			arc_set->edges[arc_set->size++] = graph->edges[i];
+		}
+	}
+}
+
+/**
+ * @brief Returns the subset of a given colexicographic rank among the subsets with k of n vertices
+ * @details The colexicographic order is the numeric order of the bit masks, which Gosper's hack steps through.
+ * @param dp The dynamic program, for the binomials and n
+ * @param rank The rank, below n choose k
+ * @param k The size of the subset
+ * @return The subset
+ **/
+static uint32_t unrank_subset(const struct dp *dp, uint64_t rank, size_t k)
+{
+	uint32_t set = 0;
+	size_t c = dp->graph->num_vertices;
+	for (size_t i = k; i > 0; --i)
+	{
+		do
+		{
+			--c;
+		} while (dp->binomial[c][i] > rank);
+
+		set |= UINT32_C(1) << c;
+		rank -= dp->binomial[c][i];
+	}
+	return set;
+}
+
+/**
+ * @brief Computes the layers of the dynamic program
+ * @details This is the start routine of the threads of the dynamic program. Every layer is split by rank into one range per thread, a
+ * thread unranks the first subset of its range and steps to the next one with Gosper's hack. The first thread polls the shared memory
+ * before every barrier.
+ * @param arg A pointer to the struct dp_thread of this thread
+ * @return NULL
+ **/
+static void *dp_layers(void *arg)
+{
+	struct dp_thread *const self = arg;
+	struct dp *const dp = self->dp;
+	const struct graph *const graph = dp->graph;
+	uint8_t *const best = dp->best;
+
+	pthread_mutex_lock(&dp->start);
+	pthread_mutex_unlock(&dp->start);
+
+	for (size_t k = 1; k <= graph->num_vertices; ++k)
+	{
+		const uint64_t total = dp->binomial[graph->num_vertices][k];
+		const uint64_t first = total * self->index / dp->num_threads;
+		const uint64_t last = total * (self->index + 1) / dp->num_threads;
+		uint32_t set = first < last ? unrank_subset(dp, first, k) : 0;
+
+		for (uint64_t rank = first; rank < last; ++rank)
+		{
+			unsigned fewest = UINT8_MAX;
+			for (uint32_t rest = set; rest != 0; rest &= rest - 1)
+			{
+				uint32_t vertex = __builtin_ctz(rest);
+				uint32_t before = set & ~(UINT32_C(1) << vertex);
+				unsigned count = best[before] + edges_into(graph, vertex, before);
+				if (count < fewest)
+				{
+					fewest = count;
+				}
+			}
+			best[set] = fewest;
+
+			uint32_t lowest = set & -set;
+			uint32_t ripple = set + lowest;
+			set = (((ripple ^ set) >> 2) / lowest) | ripple;
+		}
+
+		if (self->index == 0)
+		{
+			dp->quit[k] = shared_memory_quit_requested(dp->memory);
+		}
+
+		pthread_barrier_wait(&dp->barrier);
+		if (dp->quit[k])
+		{
+			break;
+		}
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Solves a graph with the dynamic program
+ * @details The ordering is rebuilt backwards from the table: the last vertex of a subset is one whose removal explains its value.
+ * See exact_feedback_arc_set for the parameters and return values.
+ **/
+static int solve_dp(const struct graph *graph, size_t num_threads, struct shared_memory *memory, uint32_t *bound,
+	struct feedback_arc_set *arc_set)
+{
+	struct dp *dp = calloc(1, sizeof(struct dp));
+	struct dp_thread *threads = calloc(num_threads, sizeof(struct dp_thread));
+	if (dp == NULL || threads == NULL || (dp->best = malloc(sizeof(uint8_t) << graph->num_vertices)) == NULL)
+	{
+		free(threads);
+		free(dp);
+		return -1;
+	}
+
+	dp->graph = graph;
+	dp->memory = memory;
+	dp->best[0] = 0;
+	for (size_t n = 0; n <= MAX_DP_VERTICES; ++n)
+	{
+		dp->binomial[n][0] = 1;
+		for (size_t k = 1; k <= n; ++k)
+		{
+			dp->binomial[n][k] = dp->binomial[n - 1][k - 1] + (k < n ? dp->binomial[n - 1][k] : 0);
+		}
+	}
+
+	/* The first thread is the calling thread itself, the layers are split between the threads that could be started */
+	pthread_mutex_init(&dp->start, NULL);
+	pthread_mutex_lock(&dp->start);
+	size_t started = 1;
+	for (; started < num_threads; ++started)
+	{
+		threads[started].dp = dp;
+		threads[started].index = started;
+		if (pthread_create(&threads[started].thread, NULL, &dp_layers, &threads[started]) != 0)
+		{
+			break;
+		}
+	}
+
+	int ret = 0;
+	dp->num_threads = started;
+	pthread_barrier_init(&dp->barrier, NULL, started);
+	pthread_mutex_unlock(&dp->start);
+
+	threads[0].dp = dp;
+	threads[0].index = 0;
+	dp_layers(&threads[0]);
+	for (size_t i = 1; i < started; ++i)
+	{
+		pthread_join(threads[i].thread, NULL);
+	}
+	pthread_barrier_destroy(&dp->barrier);
+	pthread_mutex_destroy(&dp->start);
+
+	for (size_t k = 1; k <= graph->num_vertices; ++k)
+	{
+		if (dp->quit[k])
+		{
+			errno = EINTR;
+			ret = -1;
+			goto cleanup;
+		}
+	}
+
+	uint32_t size = dp->best[graph->all] + graph->loops;
+	if (size >= *bound)
+	{
+		goto cleanup;
+	}
+
+	uint32_t position[MAX_EXACT_VERTICES];
+	uint32_t set = graph->all;
+	for (size_t i = graph->num_vertices; i > 0; --i)
+	{
+		for (uint32_t rest = set; rest != 0; rest &= rest - 1)
+		{
+			uint32_t vertex = __builtin_ctz(rest);
+			uint32_t before = set & ~(UINT32_C(1) << vertex);
+			if (dp->best[before] + edges_into(graph, vertex, before) == dp->best[set])
+			{
+				position[vertex] = i - 1;
+				set = before;
+				break;
+			}
+		}
+	}
+
+	fill_arc_set(graph, position, arc_set);
+	*bound = size;
+	ret = 1;
+
+cleanup:
+	free(dp->best);
+	free(dp);
+	free(threads);
+	return ret;
+}
+
+/**
+ * @brief Takes an ordering over as the best one if it has fewer backward edges
+ * @param bnb The branch and bound
+ * @param order The ordering
+ * @param cost The number of backward edges
+ **/
+static void bnb_improve(struct bnb *bnb, const uint32_t *order, uint32_t cost)
+{
+	pthread_mutex_lock(&bnb->lock);
+	if (cost < bnb->bound)
+	{
+		memcpy(bnb->best_order, order, bnb->graph->num_vertices * sizeof(uint32_t));
+		bnb->found = true;
+		__atomic_store_n(&bnb->bound, cost, __ATOMIC_RELAXED);
+	}
+	pthread_mutex_unlock(&bnb->lock);
+}
+
+/**
+ * @brief Polls the shared memory
+ * @details A smaller best size of the supervisor becomes the bound, an own ordering that isn't below it is of no interest anymore.
+ * @param bnb The branch and bound
+ **/
+static void bnb_poll(struct bnb *bnb)
+{
+	if (shared_memory_quit_requested(bnb->memory))
+	{
+		__atomic_store_n(&bnb->quit, true, __ATOMIC_RELAXED);
+		return;
+	}
+
+	uint32_t best_size = shared_memory_best_size(bnb->memory);
+	if (best_size < __atomic_load_n(&bnb->bound, __ATOMIC_RELAXED))
+	{
+		pthread_mutex_lock(&bnb->lock);
+		if (best_size < bnb->bound)
+		{
+			bnb->found = false;
+			__atomic_store_n(&bnb->bound, best_size, __ATOMIC_RELAXED);
+		}
+		pthread_mutex_unlock(&bnb->lock);
+	}
+}
+
+/**
+ * @brief Lists the vertices to branch on after a set of placed vertices
+ * @details The edges from an unplaced vertex into the placed ones are backward in any case, and so is one edge of every 2-cycle
+ * between unplaced vertices, which gives the lower bound. An unplaced vertex without edges from the other unplaced ones can always
+ * come next, so it is the only candidate. Otherwise the candidates are sorted by their edges from the other unplaced vertices.
+ * @param graph The graph
+ * @param placed The set of placed vertices
+ * @param cost The backward edges of the placed vertices
+ * @param candidates The array to write the candidates to
+ * @param lower_bound Set to the lower bound
+ * @return The number of candidates
+ **/
+static size_t list_candidates(const struct graph *graph, uint64_t placed, uint32_t cost, uint32_t *candidates, uint32_t *lower_bound)
+{
+	uint64_t rest = graph->all & ~placed;
+	uint32_t forced = 0;
+	uint32_t cycles = 0;
+	uint32_t keys[MAX_EXACT_VERTICES];
+	size_t num_candidates = 0;
+
+	for (uint64_t left = rest; left != 0; left &= left - 1)
+	{
+		uint32_t vertex = __builtin_ctzll(left);
+		forced += edges_into(graph, vertex, placed);
+		cycles += cycles_with(graph, vertex, rest);
+
+		uint32_t key = __builtin_popcountll(graph->in[vertex] & rest);
+		if (key == 0)
+		{
+			candidates[0] = vertex;
+			keys[0] = 0;
+			num_candidates = SIZE_MAX;
+		}
+
+		if (num_candidates == SIZE_MAX)
+		{
+			continue;
+		}
+
+		size_t i = num_candidates++;
+		while (i > 0 && keys[i - 1] > key)
+		{
+			candidates[i] = candidates[i - 1];
+			keys[i] = keys[i - 1];
+			--i;
+		}
+		candidates[i] = vertex;
+		keys[i] = key;
+	}
+
+	*lower_bound = cost + forced + cycles / 2;
+	return num_candidates == SIZE_MAX ? 1 : num_candidates;
+}
+
+/**
+ * @brief Searches the orderings that start with the placed vertices
+ * @param self The thread
+ * @param placed The set of placed vertices
+ * @param depth The number of placed vertices, which are self->order[0] to self->order[depth - 1]
+ * @param cost The backward edges of the placed vertices
+ **/
+static void bnb_search(struct bnb_thread *self, uint64_t placed, size_t depth, uint32_t cost)
+{
+	struct bnb *const bnb = self->bnb;
+	const struct graph *const graph = bnb->graph;
+
+	if (++self->nodes % POLL_NODES == 0)
+	{
+		bnb_poll(bnb);
+	}
+	if (__atomic_load_n(&bnb->quit, __ATOMIC_RELAXED))
+	{
+		return;
+	}
+
+	if (depth == graph->num_vertices)
+	{
+		bnb_improve(bnb, self->order, cost);
+		return;
+	}
+
+	uint32_t candidates[MAX_EXACT_VERTICES];
+	uint32_t lower_bound;
+	size_t num_candidates = list_candidates(graph, placed, cost, candidates, &lower_bound);
+
+	for (size_t i = 0; i < num_candidates; ++i)
+	{
+		if (lower_bound >= __atomic_load_n(&bnb->bound, __ATOMIC_RELAXED))
+		{
+			return;
+		}
+
+		uint32_t vertex = candidates[i];
+		self->order[depth] = vertex;
+		bnb_search(self, placed | (UINT64_C(1) << vertex), depth + 1, cost + edges_into(graph, vertex, placed));
+	}
+}
+
+/**
+ * @brief Searches the subtrees of the roots
+ * @details This is the start routine of the threads of the branch and bound. Every thread takes the next root until none is left.
+ * @param arg A pointer to the struct bnb_thread of this thread
+ * @return NULL
+ **/
+static void *bnb_roots(void *arg)
+{
+	struct bnb_thread *const self = arg;
+	struct bnb *const bnb = self->bnb;
+
+	memcpy(self->order, bnb->prefix, bnb->prefix_len * sizeof(uint32_t));
+	for (;;)
+	{
+		size_t i = __atomic_fetch_add(&bnb->next_root, 1, __ATOMIC_RELAXED);
+		if (i >= bnb->num_roots || __atomic_load_n(&bnb->quit, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+
+		uint32_t root = bnb->roots[i];
+		self->order[bnb->prefix_len] = root;
+		bnb_search(self, bnb->prefix_set | (UINT64_C(1) << root), bnb->prefix_len + 1,
+			bnb->prefix_cost + edges_into(bnb->graph, root, bnb->prefix_set));
+	}
+
+	return NULL;
+}
+
+/**
+ * @brief Solves a graph with the branch and bound
+ * @details The vertices that can always come first are placed before the search is split, so there is more than one root unless the
+ * graph is acyclic. See exact_feedback_arc_set for the parameters and return values.
+ **/
+static int solve_bnb(const struct graph *graph, size_t num_threads, struct shared_memory *memory, uint32_t *bound,
+	struct feedback_arc_set *arc_set)
+{
+	struct bnb *bnb = calloc(1, sizeof(struct bnb));
+	struct bnb_thread *threads = calloc(num_threads, sizeof(struct bnb_thread));
+	if (bnb == NULL || threads == NULL)
+	{
+		free(threads);
+		free(bnb);
+		return -1;
+	}
+
+	bnb->graph = graph;
+	bnb->memory = memory;
+	bnb->bound = *bound;
+	bnb->prefix_cost = graph->loops;
+	pthread_mutex_init(&bnb->lock, NULL);
+
+	uint32_t lower_bound;
+	while (bnb->prefix_len < graph->num_vertices)
+	{
+		bnb->num_roots = list_candidates(graph, bnb->prefix_set, bnb->prefix_cost, bnb->roots, &lower_bound);
+		if (bnb->num_roots > 1)
+		{
+			break;
+		}
+
+		uint32_t vertex = bnb->roots[0];
+		bnb->prefix[bnb->prefix_len++] = vertex;
+		bnb->prefix_cost += edges_into(graph, vertex, bnb->prefix_set);
+		bnb->prefix_set |= UINT64_C(1) << vertex;
+	}
+
+	if (bnb->prefix_len == graph->num_vertices)
+	{
+		bnb_improve(bnb, bnb->prefix, bnb->prefix_cost);
+	}
+	else if (lower_bound < bnb->bound)
+	{
+		/* The first thread is the calling thread itself, the roots of a missing one are taken by the others */
+		size_t started = 1;
+		for (size_t i = 0; i < num_threads; ++i)
+		{
+			threads[i].bnb = bnb;
+		}
+		for (; started < num_threads; ++started)
+		{
+			if (pthread_create(&threads[started].thread, NULL, &bnb_roots, &threads[started]) != 0)
+			{
+				break;
+			}
+		}
+
+		bnb_roots(&threads[0]);
+		for (size_t i = 1; i < started; ++i)
+		{
+			pthread_join(threads[i].thread, NULL);
+		}
+	}
+
+	int ret = 0;
+	if (bnb->quit)
+	{
+		errno = EINTR;
+		ret = -1;
+	}
+	else if (bnb->found)
+	{
+		uint32_t position[MAX_EXACT_VERTICES];
+		for (size_t i = 0; i < graph->num_vertices; ++i)
+		{
+			position[bnb->best_order[i]] = i;
+		}
+		fill_arc_set(graph, position, arc_set);
+		ret = 1;
+	}
+	*bound = bnb->bound;
+
+	pthread_mutex_destroy(&bnb->lock);
+	free(threads);
+	free(bnb);
+	return ret;
+}
+
+int exact_feedback_arc_set(const struct edge *edges, size_t num_edges, const uint32_t *vertices, size_t num_vertices, size_t num_threads,
+	struct shared_memory *memory, uint32_t *bound, struct feedback_arc_set *arc_set)
+{
+	if (num_vertices > MAX_EXACT_VERTICES || num_threads == 0 || *bound > MAX_NUM_EDGES + 1)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	struct graph graph;
+	if (build_graph(&graph, edges, num_edges, vertices, num_vertices) == -1)
+	{
+		return -1;
+	}
+
+	int ret = -1;
+	if (num_vertices <= MAX_DP_VERTICES)
+	{
+		ret = solve_dp(&graph, num_threads, memory, bound, arc_set);
+	}
+
+	/* The table of the dynamic program might not fit into memory */
+	if (ret == -1 && (num_vertices > MAX_DP_VERTICES || errno == ENOMEM))
+	{
+		ret = solve_bnb(&graph, num_threads, memory, bound, arc_set);
+	}
+
+	free_graph(&graph);
+	return ret;
+}
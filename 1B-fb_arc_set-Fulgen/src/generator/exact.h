@@ -0,0 +1,44 @@
+/**
+ * @file exact.h
+ * @author George Tokmaji <e11908523@student.tuwien.ac.at>
+ * @date 22.11.2020
+ *
+ * @brief Exact feedback arc set search
+ *
+ * This module finds a minimum feedback arc set of a small graph. A feedback arc set is the set of backward edges of an ordering of the
+ * vertices, so the search is over orderings. Graphs with up to MAX_DP_VERTICES vertices are solved with a dynamic program over vertex
+ * subsets: the best ordering of a subset S ends with some v in S, whose edges into S \ {v} are backward, so
+ * best(S) = min over v in S of best(S \ {v}) + |edges from v into S \ {v}|. The subsets of a layer (of equal popcount) only depend on the
+ * previous layer, so every layer is split between the threads. Larger graphs with up to MAX_EXACT_VERTICES vertices fall back to a
+ * branch and bound over the orderings, which needs a good initial bound to be fast.
+ **/
+
+#pragma once
+
+#include "../common/feedback_arc_set.h"
+#include "../common/shared_memory.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Finds a minimum feedback arc set
+ * @details Quit requests of the supervisor are polled regularly, the branch and bound also takes a smaller best size of the supervisor
+ * as its bound. Loops are always part of the set, duplicate edges are only left out together.
+ * @param edges The edges of the graph
+ * @param num_edges The number of edges
+ * @param vertices The distinct vertices of the graph
+ * @param num_vertices The number of vertices, at most MAX_EXACT_VERTICES
+ * @param num_threads The number of threads to use, at least 1
+ * @param memory A valid pointer to a shared memory struct
+ * @param bound Only sets with fewer edges are of interest, at most MAX_NUM_EDGES + 1. On return the size of the found set, or the bound
+ * the search ended with.
+ * @param arc_set A pointer to the feedback arc set to fill
+ * @return 1 if a set with fewer than *bound edges exists, arc_set then holds a minimum one
+ * @return 0 if there is none, so no set has fewer than *bound edges
+ * @return -1 if quitting has been requested. errno is set to EINTR.
+ * @return -1 if there are too many vertices. errno is set to EINVAL.
+ * @return -1 on error. Check errno for details.
+ **/
+int exact_feedback_arc_set(const struct edge *edges, size_t num_edges, const uint32_t *vertices, size_t num_vertices, size_t num_threads,
+	struct shared_memory *memory, uint32_t *bound, struct feedback_arc_set *arc_set);
@@ -1,11 +1,14 @@
 #include "../common/error.h"
 #include "../common/feedback_arc_set.h"
 #include "../common/shared_memory.h"
+#include "exact.h"
 
 #include <assert.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <signal.h>
 #include <stdarg.h>
 #include <stdlib.h>
@@ -13,38 +16,93 @@
 #include <time.h>
 #include <unistd.h>
 
+#define HEURISTIC_ROUNDS 10000 /**< The number of random orderings tried for the initial bound of the exact search **/
+
 const char *program_name;
 
-static void fisher_yates_shuffle(uint32_t *vertices, size_t size)
+/**
+ * @brief Shared state of all search threads of a generator
+ **/
+struct search
+{
+	struct shared_memory *memory; /**< The shared memory to write the sets to **/
+	const struct edge *edges; /**< The edges of the graph **/
+	size_t num_edges; /**< The number of edges **/
+	const uint32_t *vertices; /**< The vertices of the graph, copied by every thread before shuffling **/
+	size_t num_vertices; /**< The number of vertices **/
+	bool failed; /**< Whether a thread failed, which stops all of them. Only accessed atomically **/
+};
+
+/**
+ * @brief State of one search thread
+ **/
+struct search_thread
+{
+	pthread_t thread; /**< The thread **/
+	struct search *search; /**< The shared state **/
+	uint64_t random_state; /**< The xorshift state of this thread, never 0 **/
+};
+
+/**
+ * @brief Returns the next number of a xorshift64* generator
+ * @param state A pointer to the non-zero generator state, which is advanced
+ * @return A pseudo random number
+ **/
+static uint64_t next_random(uint64_t *state)
+{
+	uint64_t x = *state;
+	x ^= x >> 12;
+	x ^= x << 25;
+	x ^= x >> 27;
+	*state = x;
+	return x * UINT64_C(2685821657736338717);
+}
+
+static void fisher_yates_shuffle(uint32_t *vertices, size_t size, uint64_t *random_state)
 {
 	for (size_t i = size - 1; i >= 1; --i)
 	{
-		size_t j = random() % (i + 1);
+		size_t j = next_random(random_state) % (i + 1);
 		uint32_t temp = vertices[i];
 		vertices[i] = vertices[j];
 		vertices[j] = temp;
 	}
 }
 
-static void seed_random()
+static uint64_t seed_random()
 {
 	/* /dev/urandom provides a better entropy source. Use it if available. */
 	int fd;
 	if ((fd = open("/dev/urandom", O_RDONLY)) > -1)
 	{
-		unsigned int seed;
-		if (read(fd, &seed, sizeof(seed)) > -1)
+		uint64_t seed;
+		if (read(fd, &seed, sizeof(seed)) == sizeof(seed))
 		{
-			srandom(seed);
 			close(fd);
-			return;
+			return seed;
 		}
 
 		close(fd);
 	}
 
 	/* Fall back to a weak entropy source which might clash with other generators. */
-	srandom(time(NULL));
+	return (uint64_t) time(NULL) ^ ((uint64_t) getpid() << 32);
+}
+
+/**
+ * @brief Derives the xorshift state of a thread from the seed of the process
+ * @details Uses the splitmix64 finalizer, so the states of neighbouring threads are unrelated.
+ * @param seed The seed returned by seed_random
+ * @param index The index of the thread
+ * @return A non-zero xorshift state
+ **/
+static uint64_t thread_random_state(uint64_t seed, size_t index)
+{
+	uint64_t z = seed + (index + 1) * UINT64_C(0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+	z = (z ^ (z >> 27)) * UINT64_C(0x94D049BB133111EB);
+	z ^= z >> 31;
+	return z != 0 ? z : 1;
 }
 
 bool contains_vertex(uint32_t *vertices, size_t size, uint32_t vertex)
@@ -63,18 +121,300 @@ bool contains_vertex(uint32_t *vertices, size_t size, uint32_t vertex)
 	return false;
 }
 
+/**
+ * @brief Collects the backward edges of an ordering
+ * @param edges The edges of the graph
+ * @param num_edges The number of edges
+ * @param vertices The ordering of the vertices
+ * @param num_vertices The number of vertices
+ * @param max_size The maximum number of edges to collect, at most MAX_NUM_EDGES
+ * @param feedback_arc_set The feedback arc set to fill
+ * @return true if the ordering has at most max_size backward edges, false if collecting stopped there
+ **/
+static bool collect_backward_edges(const struct edge *edges, size_t num_edges, const uint32_t *vertices, size_t num_vertices,
+	size_t max_size, struct feedback_arc_set *feedback_arc_set)
+{
+	memset(feedback_arc_set, 0, sizeof(*feedback_arc_set));
+
+	for (size_t i = 0; i < num_edges; ++i)
+	{
+		bool found_v = false;
+		for (size_t j = 0; j < num_vertices; ++j)
+		{
+			if (!found_v)
+			{
+				if (vertices[j] == edges[i].v)
+				{
+					found_v = true;
+				}
+			}
+
+			else if (vertices[j] == edges[i].u)
+			{
+				/* More edges than allowed by the limit? Don't send it to the supervisor */
+				if (feedback_arc_set->size == max_size)
+				{
+					return false;
+				}
+
+				feedback_arc_set->edges[feedback_arc_set->size++] = edges[i];
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+/**
+ * @brief Searches for feedback arc sets and writes the improving ones to the shared memory
+ * @details This is the start routine of the search threads. A set is only written if it is smaller than both the best set of this
+ * thread and the best set read by the supervisor, so building a set stops as soon as it reaches that size.
+ * Runs until the supervisor requests to quit or a thread fails.
+ * @param arg A pointer to the struct search_thread of this thread
+ * @return NULL
+ **/
+static void *search(void *arg)
+{
+	struct search_thread *const self = arg;
+	struct search *const search = self->search;
+	struct shared_memory *const memory = search->memory;
+	const struct edge *const edges = search->edges;
+	const size_t num_edges = search->num_edges;
+	const size_t num_vertices = search->num_vertices;
+	struct feedback_arc_set feedback_arc_set;
+	uint32_t local_best = UINT32_MAX;
+	uint32_t *vertices;
+
+	if ((vertices = malloc(num_vertices * sizeof(uint32_t))) == NULL)
+	{
+		error("vertices: malloc failed: %s", strerror(errno));
+		__atomic_store_n(&search->failed, true, __ATOMIC_RELAXED);
+		return NULL;
+	}
+
+	memcpy(vertices, search->vertices, num_vertices * sizeof(uint32_t));
+
+	for (;;)
+	{
+		if (shared_memory_quit_requested(memory))
+		{
+			puts("Quit requested");
+			break;
+		}
+
+		if (__atomic_load_n(&search->failed, __ATOMIC_RELAXED))
+		{
+			break;
+		}
+
+		/* Only sets smaller than the best one read by the supervisor are of interest, so stop as soon as a set reaches that size */
+		uint32_t best_size = shared_memory_best_size(memory);
+		if (local_best < best_size)
+		{
+			best_size = local_best;
+		}
+		const size_t max_size = best_size > MAX_NUM_EDGES ? MAX_NUM_EDGES : (best_size > 0 ? best_size - 1 : 0);
+//#define TEST
+#ifdef TEST
+		(void) fisher_yates_shuffle;
+		uint32_t v[] = {3, 6, 1, 5, 0, 2, 4};
+		memcpy(vertices, v, sizeof(v));
+		assert(sizeof(v) / sizeof(uint32_t) == num_vertices);
+#else
+		fisher_yates_shuffle(vertices, num_vertices, &self->random_state);
+#endif
+		if (!collect_backward_edges(edges, num_edges, vertices, num_vertices, max_size, &feedback_arc_set))
+		{
+			goto skip;
+		}
+
+#ifdef TEST
+		for (uint8_t i = 0; i < feedback_arc_set.size; ++i)
+		{
+			printf("%" PRIu32 "-%" PRIu32 " ", feedback_arc_set.edges[i].u, feedback_arc_set.edges[i].v);
+		}
+		break;
+#else
+		/* The supervisor might have read a better set in the meantime */
+		if (feedback_arc_set.size >= shared_memory_best_size(memory))
+		{
+			goto skip;
+		}
+
+		if (shared_memory_write_feedback_arc_set(memory, &feedback_arc_set) == -1)
+		{
+			if (errno != EINTR)
+			{
+				error("Error writing feedback arc set: %s", strerror(errno));
+				__atomic_store_n(&search->failed, true, __ATOMIC_RELAXED);
+			}
+
+			break;
+		}
+
+		local_best = feedback_arc_set.size;
+
+	skip:
+		continue;
+#endif
+	}
+
+	free(vertices);
+	return NULL;
+}
+
+/**
+ * @brief Finds a minimum feedback arc set and writes it to the shared memory
+ * @details The best of HEURISTIC_ROUNDS random orderings is written first and bounds the exact search together with the best set of
+ * the supervisor, so it only has to prove that there is no smaller one if the heuristic already found the optimum.
+ * @param search The graph and the shared memory
+ * @param num_threads The number of threads of the exact search
+ * @return EXIT_SUCCESS if the search is done or quitting has been requested
+ * @return EXIT_FAILURE on error
+ **/
+static int search_exact(struct search *search, size_t num_threads)
+{
+	struct shared_memory *const memory = search->memory;
+	struct feedback_arc_set feedback_arc_set;
+	struct feedback_arc_set best_set;
+	uint32_t bound = MAX_NUM_EDGES + 1;
+	uint32_t *vertices;
+
+	if (search->num_vertices > MAX_EXACT_VERTICES)
+	{
+		error("The exact search supports at most %d vertices, the graph has %zu", MAX_EXACT_VERTICES, search->num_vertices);
+		return EXIT_FAILURE;
+	}
+
+	if ((vertices = malloc(search->num_vertices * sizeof(uint32_t))) == NULL)
+	{
+		error("vertices: malloc failed: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	memcpy(vertices, search->vertices, search->num_vertices * sizeof(uint32_t));
+	uint64_t random_state = thread_random_state(seed_random(), 0);
+
+	for (size_t round = 0; round < HEURISTIC_ROUNDS && bound > 0; ++round)
+	{
+		fisher_yates_shuffle(vertices, search->num_vertices, &random_state);
+		if (collect_backward_edges(search->edges, search->num_edges, vertices, search->num_vertices, bound - 1, &feedback_arc_set))
+		{
+			best_set = feedback_arc_set;
+			bound = feedback_arc_set.size;
+		}
+	}
+
+	free(vertices);
+
+	if (bound < shared_memory_best_size(memory) && shared_memory_write_feedback_arc_set(memory, &best_set) == -1)
+	{
+		goto write_error;
+	}
+
+	if (shared_memory_best_size(memory) < bound)
+	{
+		bound = shared_memory_best_size(memory);
+	}
+
+	switch (exact_feedback_arc_set(search->edges, search->num_edges, search->vertices, search->num_vertices, num_threads, memory, &bound,
+		&feedback_arc_set))
+	{
+	case 1:
+		if (shared_memory_write_feedback_arc_set(memory, &feedback_arc_set) == -1)
+		{
+			goto write_error;
+		}
+		break;
+
+	case 0:
+		break;
+
+	default:
+		if (errno == EINTR)
+		{
+			puts("Quit requested");
+			return EXIT_SUCCESS;
+		}
+
+		error("Exact search failed: %s", strerror(errno));
+		return EXIT_FAILURE;
+	}
+
+	if (bound > MAX_NUM_EDGES)
+	{
+		printf("No feedback arc set has at most %d edges\n", MAX_NUM_EDGES);
+	}
+	else
+	{
+		printf("A minimum feedback arc set has %" PRIu32 " edges\n", bound);
+	}
+
+	return EXIT_SUCCESS;
+
+write_error:
+	if (errno == EINTR)
+	{
+		puts("Quit requested");
+		return EXIT_SUCCESS;
+	}
+
+	error("Error writing feedback arc set: %s", strerror(errno));
+	return EXIT_FAILURE;
+}
+
+/**
+ * @brief Prints the usage to stderr
+ **/
+static void usage(void)
+{
+	fprintf(stderr, "Usage: %s [-t THREADS] [-x] EDGE...\n", program_name);
+}
+
 int main(int argc, char **argv)
 {
 	program_name = argv[0];
-	if (argc == 1)
+
+	size_t num_threads = 1;
+	bool exact = false;
+	int option;
+	while ((option = getopt(argc, argv, "t:x")) != -1)
+	{
+		char *end;
+		switch (option)
+		{
+		case 't':
+			errno = 0;
+			num_threads = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || end == optarg || num_threads == 0 || num_threads > MAX_THREADS)
+			{
+				error("Invalid number of threads '%s' (1 to %d allowed)", optarg, MAX_THREADS);
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+
+		case 'x':
+			exact = true;
+			break;
+
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind == argc)
 	{
 		error("No edges supplied");
+		usage();
 		return EXIT_FAILURE;
 	}
 
 	struct shared_memory *memory = NULL;
 
-	if ((memory = shared_memory_create(MATRICULAR_NUMBER, SHM_NAME, false, MAX_FEEDBACK_SETS)) == NULL)
+	if ((memory = shared_memory_create(MATRICULAR_NUMBER, SHM_NAME, false, 0)) == NULL)
 	{
 		error("Failed to open shared memory: %s", strerror(errno));
 		return EXIT_FAILURE;
@@ -82,26 +422,26 @@ int main(int argc, char **argv)
 
 	int ret = EXIT_SUCCESS;
 	struct edge *edges;
-	struct feedback_arc_set feedback_arc_set;
 	uint32_t *vertices;
+	struct search_thread *threads;
 	size_t num_vertices = 0;
-	const size_t num_edges = (size_t) argc - 1;
+	const size_t num_edges = (size_t) (argc - optind);
 
-	if ((edges = malloc((argc - 1) * sizeof(struct edge))) == NULL)
+	if ((edges = malloc(num_edges * sizeof(struct edge))) == NULL)
 	{
 		error("edges: malloc failed: %s", strerror(errno));
 		ret = EXIT_FAILURE;
 		goto cleanup_memory;
 	}
 
-	if ((vertices = malloc((argc - 1) * 2 * sizeof(uint32_t))) == NULL)
+	if ((vertices = malloc(num_edges * 2 * sizeof(uint32_t))) == NULL)
 	{
 		error("vertices: malloc failed: %s", strerror(errno));
 		ret = EXIT_FAILURE;
 		goto cleanup_edges;
 	}
 
-	for (int i = 1; i < argc; ++i)
+	for (int i = optind; i < argc; ++i)
 	{
 		uint32_t u, v;
 		if (sscanf(argv[i], "%" SCNu32 "-%" SCNu32, &u, &v) < 2)
@@ -111,8 +451,8 @@ int main(int argc, char **argv)
 			goto cleanup_vertices;
 		}
 
-		edges[i - 1].u = u;
-		edges[i - 1].v = v;
+		edges[i - optind].u = u;
+		edges[i - optind].v = v;
 
 		/* Make sure all vertices are only contained once */
 
@@ -127,78 +467,51 @@ int main(int argc, char **argv)
 		}
 	}
 
-	seed_random();
-
-	for (;;)
+	if (exact)
 	{
-		if (shared_memory_quit_requested(memory))
-		{
-			puts("Quit requested");
-			break;
-		}
+		struct search search_state = {.memory = memory, .edges = edges, .num_edges = num_edges, .vertices = vertices, .num_vertices = num_vertices, .failed = false};
+		ret = search_exact(&search_state, num_threads);
+		goto cleanup_vertices;
+	}
 
-		memset(&feedback_arc_set, 0, sizeof(feedback_arc_set));
-//#define TEST
-#ifdef TEST
-		(void) fisher_yates_shuffle;
-		uint32_t v[] = {3, 6, 1, 5, 0, 2, 4};
-		memcpy(vertices, v, sizeof(v));
-		assert(sizeof(v) / sizeof(uint32_t) == num_vertices);
-#else
-		fisher_yates_shuffle(vertices, num_vertices);
-#endif
+	if ((threads = malloc(num_threads * sizeof(struct search_thread))) == NULL)
+	{
+		error("threads: malloc failed: %s", strerror(errno));
+		ret = EXIT_FAILURE;
+		goto cleanup_vertices;
+	}
 
-		for (size_t i = 0; i < num_edges; ++i)
-		{
-			bool found_v = false;
-			for (size_t j = 0; j < num_vertices; ++j)
-			{
-				if (!found_v)
-				{
-					if (vertices[j] == edges[i].v)
-					{
-						found_v = true;
-					}
-				}
+	struct search search_state = {.memory = memory, .edges = edges, .num_edges = num_edges, .vertices = vertices, .num_vertices = num_vertices, .failed = false};
+	const uint64_t seed = seed_random();
+	size_t started = 0;
 
-				else if (vertices[j] == edges[i].u)
-				{
-					/* More edges than allowed by the limit? Don't send it to the supervisor */
-					if (feedback_arc_set.size == sizeof(feedback_arc_set.edges) / sizeof(feedback_arc_set.edges[0]))
-					{
-						goto skip;
-					}
-
-					feedback_arc_set.edges[feedback_arc_set.size++] = edges[i];
-					break;
-				}
-			}
-		}
+	for (; started < num_threads; ++started)
+	{
+		threads[started].search = &search_state;
+		threads[started].random_state = thread_random_state(seed, started);
 
-#ifdef TEST
-		for (uint8_t i = 0; i < feedback_arc_set.size; ++i)
+		/* The first thread is the main thread itself */
+		if (started > 0 && (errno = pthread_create(&threads[started].thread, NULL, &search, &threads[started])) != 0)
 		{
-			printf("%" PRIu32 "-%" PRIu32 " ", feedback_arc_set.edges[i].u, feedback_arc_set.edges[i].v);
-		}
-		break;
-#else
-		if (shared_memory_write_feedback_arc_set(memory, &feedback_arc_set) == -1)
-		{
-			if (errno != EINTR)
-			{
-				error("Error writing feedback arc set: %s", strerror(errno));
-				ret = EXIT_FAILURE;
-			}
-
+			error("Error creating thread: %s", strerror(errno));
+			__atomic_store_n(&search_state.failed, true, __ATOMIC_RELAXED);
 			break;
 		}
+	}
 
-	skip:
-		continue;
-#endif
+	search(&threads[0]);
+
+	for (size_t i = 1; i < started; ++i)
+	{
+		pthread_join(threads[i].thread, NULL);
 	}
 
+	if (search_state.failed)
+	{
+		ret = EXIT_FAILURE;
+	}
 
+	free(threads);
 cleanup_vertices:
 	free(vertices);
 cleanup_edges:
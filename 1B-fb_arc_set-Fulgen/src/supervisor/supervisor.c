@@ -17,7 +17,9 @@
 #include <inttypes.h>
 #include <signal.h>
 #include <stdarg.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 const char *program_name; /**< The program name used for error. **/
 static struct shared_memory *memory; /**< The used shared memory instance. Global static to avoid passing it to the signal handler. **/
@@ -49,12 +51,22 @@ static void signal_handler(int signal)
 	shared_memory_request_quit(memory);
 }
 
+/**
+ * @brief Prints the usage to stderr
+ **/
+static void usage(void)
+{
+	fprintf(stderr, "Usage: %s [-c CAPACITY]\n", program_name);
+}
+
 /**
  * Program entry point.
  * @brief This function first sets program_name to argv[0] for the error function. It then creates a shared memory datastructure instance
  * and proceeds to listen for any feedback arc sets written to it by generators. If the read feedback arc has less edges than the previously
  * read instance or none has been read before, it is printed to stdout and set as the new best. If the edge count is zero or SIGINT or SIGTERM
  * are received, the program terminates.
+ * The option -c sets how many feedback arc sets the circular buffer holds (MAX_FEEDBACK_SETS by default), the generators read it from the
+ * shared memory.
  * Errors are printed to stderr and cause EXIT_FAILURE to be returned
  * @param argc The argument count
  * @param argv The arguments
@@ -63,9 +75,39 @@ static void signal_handler(int signal)
  */
 int main(int argc, char **argv)
 {
-	(void) argc;
 	program_name = argv[0];
 
+	size_t capacity = MAX_FEEDBACK_SETS;
+	int option;
+	while ((option = getopt(argc, argv, "c:")) != -1)
+	{
+		char *end;
+		switch (option)
+		{
+		case 'c':
+			errno = 0;
+			capacity = strtoul(optarg, &end, 10);
+			if (errno != 0 || *end != '\0' || end == optarg || capacity == 0 || capacity > MAX_CAPACITY)
+			{
+				error("Invalid capacity '%s' (1 to %d allowed)", optarg, MAX_CAPACITY);
+				usage();
+				return EXIT_FAILURE;
+			}
+			break;
+
+		default:
+			usage();
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (optind != argc)
+	{
+		error("Too many arguments");
+		usage();
+		return EXIT_FAILURE;
+	}
+
 	struct feedback_arc_set best;
 	/* There can't be a feedback arc set with more edges than MAX_NUM_EDGES which is always <= UINT8_MAX,
 	 * so this works as a default comparision value. Not using MAX_NUM_EDGES + 1 as this would overflow
@@ -81,7 +123,7 @@ int main(int argc, char **argv)
 	sigaction(SIGINT, &act, NULL);
 	sigaction(SIGTERM, &act, NULL);
 
-	if ((memory = shared_memory_create(MATRICULAR_NUMBER, SHM_NAME, true, MAX_FEEDBACK_SETS)) == NULL)
+	if ((memory = shared_memory_create(MATRICULAR_NUMBER, SHM_NAME, true, capacity)) == NULL)
 	{
 		error("Error creating shared memory: %s", strerror(errno));
 		return EXIT_FAILURE;
@@ -105,6 +147,7 @@ int main(int argc, char **argv)
 		if (contestant.size < best.size)
 		{
 			best = contestant;
+			shared_memory_set_best_size(memory, best.size);
 
 			if (best.size == 0)
 			{
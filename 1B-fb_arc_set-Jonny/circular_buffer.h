@@ -6,38 +6,77 @@
  * @brief The circular_buffer file acts like a Semaphore and Shared_memory library which helps the 
  * generator and supervisor files.
  * 
+ * The buffer itself is a ring of the shmring module (../libshmring), this file only adds the 
+ * solution record and the names used by the generator and supervisor.
  **/
 
 #ifndef CIRCULAR_BUFFER_H
 #define CIRCULAR_BUFFER_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
-#define SHARED_MEMORY_MAX_DATA (1024)
+#include "shmring.h"
+
+#define SHARED_MEMORY_MAX_SOLUTIONS (16)
 
 //solutions bigger than 8 edges are generally not accepted
 #define MAX_SOLUTION_EDGE_COUNT 8
 
 
 
+/**
+ * typedef struct Edge.
+ * @brief A struct to hold the information from an Edge
+ *  
+ * @details Consits of 2 ints. One start vertice and one end vertice.
+ * 
+ */
+typedef struct Edge
+{
+    int start;
+    int end;
+} edge;
+
+
+
+/**
+ * typedef struct Solution.
+ * @brief A fixed-size record which holds one solution of a generator.
+ *  
+ * @details Consists of
+ * edge_count - the number of edges in the solution.
+ * edges - the edges which have to be removed, only the first edge_count are valid.
+ * 
+ */
+typedef struct Solution
+{
+    int edge_count;
+    edge edges[MAX_SOLUTION_EDGE_COUNT];
+} solution;
+
+
+
+
+/** Solution used size macro
+ * @brief The number of bytes of a solution that are valid, only those are copied through the buffer.
+ */
+#define SOLUTION_USED_SIZE(s) (offsetof(solution, edges) + (s)->edge_count * sizeof(edge))
+
+
+
 
 /** Shared memory struct
- * @brief The struct for the shared memory. Which is used for the circular buffer
+ * @brief The handle of the circular buffer in one process.
  * 
  * @details Consists of
- * buffer - which holds the edge data.
- * read_pos - the current read position.
- * write_pos - the current write position.
- * generators-Should_quit - bool which signals if the supervisor 
- * finished and therfore all generators should quit
+ * ring - the shmring which holds one solution per slot, the best edge count of the supervisor 
+ * and the flag which signals if the supervisor finished and therfore all generators should quit.
  * 
  */
 typedef struct shared_memory
 {
-    char buffer[SHARED_MEMORY_MAX_DATA];
-    int read_pos;
-    int write_pos;
-    bool generators_should_quit;
+    struct shmring *ring;
 } shared_memory;
 
 
@@ -46,8 +85,7 @@ typedef struct shared_memory
 /** open_circular_buffer function
  * @brief Helper functions which the supervisor and generators use to open the circular buffer.
  * 
- * @details The function call multiple internal functions to open the semaphores and shared memory 
- * accordingly.
+ * @details The supervisor creates the ring, the generators open it.
  * 
  * @param is_server This bool specifies wheter the server functions should be called or not. This is 
  * import because ther are some actions only the Server should call (e.g. ftruncate())
@@ -70,7 +108,7 @@ shared_memory *open_circular_buffer(bool is_server);
  * 
  * @return Returns 0 if everything was successful. Otherwise -1 is returned.
  */
-int write_circular_buffer(shared_memory *shm, const char *data);
+int write_circular_buffer(shared_memory *shm, const solution *data);
 
 
 
@@ -82,9 +120,11 @@ int write_circular_buffer(shared_memory *shm, const char *data);
  * 
  * @param shm The shared_memory struct which open_circular_buffer returned.
  * 
- * @return Returns the read solution from the circular buffer
+ * @param data The solution struct which the read solution is copied to.
+ * 
+ * @return Returns 0 if everything was successful. Otherwise -1 is returned.
  */
-char *read_circular_buffer(shared_memory *shm);
+int read_circular_buffer(shared_memory *shm, solution *data);
 
 
 
@@ -92,15 +132,51 @@ char *read_circular_buffer(shared_memory *shm);
 /** close_circular_buffer function
  * @brief Helper functions which the supervisor and generators use to close the circular buffer.
  * 
- * @details The function call multiple internal functions to close the semaphores and shared memory 
- * accordingly.
+ * @details The supervisor also shuts the ring down, which wakes up all waiting generators, and removes it.
  * 
  * @param shm The shared_memory struct which open_circular_buffer returned.
  * @param is_server This bool specifies wheter the server functions should be called or not. This is 
- * import because ther are some actions only the Server should call (e.g. sem_unlink())
+ * import because ther are some actions only the Server should call (e.g. shm_unlink())
  * 
  * @return The function returns 0 if everything was successful. Otherwise -1 is returned.
  */
 int close_circular_buffer(shared_memory *shm, bool is_server);
 
+
+
+
+/** generators_should_quit function
+ * @brief Helper functions which the generators use to check if they should quit.
+ * 
+ * @param shm The shared_memory struct which open_circular_buffer returned.
+ * 
+ * @return Returns true once the supervisor finished, otherwise false.
+ */
+bool generators_should_quit(shared_memory *shm);
+
+
+
+
+/** set_best_circular_buffer function
+ * @brief Helper functions which the supervisor uses to tell the generators its best edge count.
+ * 
+ * @param shm The shared_memory struct which open_circular_buffer returned.
+ * 
+ * @param edge_count The edge count of the best solution so far.
+ */
+void set_best_circular_buffer(shared_memory *shm, int edge_count);
+
+
+
+
+/** get_best_circular_buffer function
+ * @brief Helper functions which the generators use to read the best edge count of the supervisor.
+ * 
+ * @param shm The shared_memory struct which open_circular_buffer returned.
+ * 
+ * @return The edge count of the best solution of the supervisor, or MAX_SOLUTION_EDGE_COUNT + 1 
+ * if there is none yet.
+ */
+int get_best_circular_buffer(shared_memory *shm);
+
 #endif
\ No newline at end of file
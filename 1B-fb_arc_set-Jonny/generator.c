@@ -23,18 +23,35 @@
 //global program name
 char *myprog;
 
+//a local search starts over after this many steps plus STALE_STEPS_PER_EDGE steps per edge without improvement
+#define STALE_STEPS 1000
+#define STALE_STEPS_PER_EDGE 10
+
 /**
- * typedef struct Edge.
- * @brief A struct to hold the information from an Edge
- *  
- * @details Consits of 2 ints. One start vertice and one end vertice.
- * 
+ * typedef struct Search.
+ * @brief The state of the local search over the vertex orderings.
+ *
+ * @details permutation holds the vertex at each position and positions the position of each vertex. The edges of
+ * vertex v are incident_edges[incident_offsets[v]] up to incident_edges[incident_offsets[v + 1] - 1], loops are left
+ * out as they are never back edges. The back edges (start after end in the ordering) are the first back_count entries
+ * of back_edges, back_positions holds the position of each edge in it or -1.
  */
-typedef struct Edge
+typedef struct Search
 {
-    int start;
-    int end;
-} edge;
+    edge *edges;
+    int edge_count;
+    int vertices_count;
+    int *permutation;
+    int *positions;
+    int *incident_offsets;
+    int *incident_edges;
+    int *back_edges;
+    int *back_positions;
+    int back_count;
+    long steps;
+    long last_improvement;
+    int run_best;
+} search;
 
 void usage(void)
 {
@@ -113,27 +130,203 @@ void get_permutation(int *vertices, int vertices_count)
 }
 
 /**
- * get_index function.
- * @brief Returns the index of the target pemutation element.
- *  
- * @details Iterates through the permutations to find the index of the target element.
- * 
- * @param permutations The permutations which should be iterated through.
- * @param vertices_count The maximum amount of vertices to go though
- * @param target The target element which is compared to each element in permutations
- * @return Returns the index if the element was found. Otherwise returns -1.
+ * build_incidence function.
+ * @brief Fills incident_offsets and incident_edges of the search.
+ *
+ * @details The offsets are first used to count the degrees and then as the write positions, which moves them one vertex
+ * forward, so they are shifted back at the end.
+ *
+ * @param s The search with the edges and the allocated incidence arrays.
  */
-int get_index(int *permutations, int vertices_count, int target)
+void build_incidence(search *s)
 {
-    for (int i = 0; i < vertices_count; ++i)
+    int *offsets = s->incident_offsets;
+    memset(offsets, 0, (s->vertices_count + 1) * sizeof(int));
+    for (int i = 0; i < s->edge_count; ++i)
     {
-        if (permutations[i] == target)
+        if (s->edges[i].start != s->edges[i].end)
         {
-            return i;
+            ++offsets[s->edges[i].start + 1];
+            ++offsets[s->edges[i].end + 1];
         }
     }
+    for (int v = 0; v < s->vertices_count; ++v)
+    {
+        offsets[v + 1] += offsets[v];
+    }
 
-    return -1;
+    for (int i = 0; i < s->edge_count; ++i)
+    {
+        if (s->edges[i].start != s->edges[i].end)
+        {
+            s->incident_edges[offsets[s->edges[i].start]++] = i;
+            s->incident_edges[offsets[s->edges[i].end]++] = i;
+        }
+    }
+    for (int v = s->vertices_count; v > 0; --v)
+    {
+        offsets[v] = offsets[v - 1];
+    }
+    offsets[0] = 0;
+}
+
+/**
+ * toggle_back_edge function.
+ * @brief Adds an edge to the back edges if it isn't one, otherwise removes it.
+ *
+ * @details A removed edge is replaced by the last back edge.
+ *
+ * @param s The search.
+ * @param e The index of the edge.
+ */
+void toggle_back_edge(search *s, int e)
+{
+    if (s->back_positions[e] == -1)
+    {
+        s->back_positions[e] = s->back_count;
+        s->back_edges[s->back_count++] = e;
+        return;
+    }
+
+    int last = s->back_edges[--s->back_count];
+    s->back_edges[s->back_positions[e]] = last;
+    s->back_positions[last] = s->back_positions[e];
+    s->back_positions[e] = -1;
+}
+
+/**
+ * restart_search function.
+ * @brief Starts the search over with a new random permutation.
+ *
+ * @param s The search.
+ */
+void restart_search(search *s)
+{
+    get_permutation(s->permutation, s->vertices_count);
+    for (int i = 0; i < s->vertices_count; ++i)
+    {
+        s->positions[s->permutation[i]] = i;
+    }
+
+    s->back_count = 0;
+    for (int i = 0; i < s->edge_count; ++i)
+    {
+        s->back_positions[i] = -1;
+        if (s->positions[s->edges[i].start] > s->positions[s->edges[i].end])
+        {
+            toggle_back_edge(s, i);
+        }
+    }
+
+    s->run_best = s->back_count;
+    s->last_improvement = s->steps;
+}
+
+/**
+ * move_delta function.
+ * @brief Returns by how much the number of back edges changes if a vertex moves to another position.
+ *
+ * @details The vertices between the old and the new position move one position towards the old one, so only edges to
+ * them change their direction. Takes O(degree) time. If toggle is set these edges are also toggled.
+ *
+ * @param s The search.
+ * @param vertex The vertex to move.
+ * @param target The new position of the vertex.
+ * @param toggle Whether the edges changing their direction should be toggled.
+ * @return the change of the number of back edges
+ */
+int move_delta(search *s, int vertex, int target, bool toggle)
+{
+    int from = s->positions[vertex];
+    int low = target < from ? target : from + 1;
+    int high = target < from ? from - 1 : target;
+    int delta = 0;
+
+    for (int i = s->incident_offsets[vertex]; i < s->incident_offsets[vertex + 1]; ++i)
+    {
+        int e = s->incident_edges[i];
+        int other = s->edges[e].start == vertex ? s->edges[e].end : s->edges[e].start;
+        int other_position = s->positions[other];
+        if (other_position < low || other_position > high)
+        {
+            continue;
+        }
+
+        delta += s->back_positions[e] == -1 ? 1 : -1;
+        if (toggle)
+        {
+            toggle_back_edge(s, e);
+        }
+    }
+
+    return delta;
+}
+
+/**
+ * move_vertex function.
+ * @brief Moves a vertex to another position and updates the back edges.
+ *
+ * @param s The search.
+ * @param vertex The vertex to move.
+ * @param target The new position of the vertex.
+ */
+void move_vertex(search *s, int vertex, int target)
+{
+    move_delta(s, vertex, target, true);
+
+    int from = s->positions[vertex];
+    int step = target < from ? -1 : 1;
+    for (int i = from; i != target; i += step)
+    {
+        s->permutation[i] = s->permutation[i + step];
+        s->positions[s->permutation[i]] = i;
+    }
+    s->permutation[target] = vertex;
+    s->positions[vertex] = target;
+}
+
+/**
+ * search_step function.
+ * @brief Makes one step of the local search.
+ *
+ * @details A random back edge is taken and either its start is moved right before its end or its end right after its
+ * start. The move is only made if it doesn't increase the number of back edges. If the search didn't improve for a
+ * while it starts over with a new random permutation.
+ *
+ * @param s The search.
+ */
+void search_step(search *s)
+{
+    ++s->steps;
+    if (s->steps - s->last_improvement > STALE_STEPS + STALE_STEPS_PER_EDGE * (long)s->edge_count)
+    {
+        restart_search(s);
+        return;
+    }
+    if (s->back_count == 0)
+    {
+        return;
+    }
+
+    edge e = s->edges[s->back_edges[rand() % s->back_count]];
+    int vertex = e.start;
+    int target = s->positions[e.end];
+    if (rand() % 2)
+    {
+        vertex = e.end;
+        target = s->positions[e.start];
+    }
+
+    if (move_delta(s, vertex, target, false) <= 0)
+    {
+        move_vertex(s, vertex, target);
+    }
+
+    if (s->back_count < s->run_best)
+    {
+        s->run_best = s->back_count;
+        s->last_improvement = s->steps;
+    }
 }
 
 /**
@@ -142,8 +335,8 @@ int get_index(int *permutations, int vertices_count, int target)
  * and writes them to the circular buffer.
  *  
  * @details First the circular buffer is opened. After that it is made sure that the specified edges are correct. Otherwise a usage message
- * is printed. After the edges are parsed the generator continously generates solutions and writes them to the circular buffer if the solution
- * is somewhat reasonable (<= 8 edges). The generator also keeps tracks of its own minimum to make sure that only solutions which are lower than
+ * is printed. After the edges are parsed the generator continously improves a vertex ordering with a local search (see search_step), the
+ * back edges of the ordering are the solution. Solutions are written to the circular buffer if they are somewhat reasonable (<= 8 edges). The generator also keeps tracks of its own minimum to make sure that only solutions which are lower than
  * the current minimum are written to the buffer.
  * 
  * @param argc The argument counter.
@@ -163,8 +356,7 @@ int main(int argc, char **argv)
     int edge_count = argc - 1;
     edge edges[edge_count];
 
-    int solutions_counter = 0;
-    int solutions[edge_count];
+    solution output;
 
     for (int i = 1; i < argc; ++i)
     {
@@ -195,74 +387,53 @@ int main(int argc, char **argv)
 
     int vertices_count = get_max(edges, argc - 1);
     set_random();
-    int permutations[vertices_count];
-
-    int min = MAX_SOLUTION_EDGE_COUNT;
-    while (shm->generators_should_quit == false)
+    int permutation[vertices_count];
+    int positions[vertices_count];
+    int incident_offsets[vertices_count + 1];
+    int incident_edges[2 * edge_count];
+    int back_edges[edge_count];
+    int back_positions[edge_count];
+
+    search s = {
+        .edges = edges,
+        .edge_count = edge_count,
+        .vertices_count = vertices_count,
+        .permutation = permutation,
+        .positions = positions,
+        .incident_offsets = incident_offsets,
+        .incident_edges = incident_edges,
+        .back_edges = back_edges,
+        .back_positions = back_positions,
+        .steps = 0};
+    build_incidence(&s);
+    restart_search(&s);
+
+    //only solutions better than the own record are written, the first one may have the maximum size
+    int min = MAX_SOLUTION_EDGE_COUNT + 1;
+    while (generators_should_quit(shm) == false)
     {
-        solutions_counter = 0;
+        search_step(&s);
 
-        get_permutation(permutations, vertices_count);
-
-        for (int i = 0; i < edge_count; ++i)
+        //solutions which aren't better than the one of the supervisor aren't of interest either
+        int best = get_best_circular_buffer(shm);
+        if (best < min)
         {
-            int u = get_index(permutations, vertices_count, edges[i].start);
-            int v = get_index(permutations, vertices_count, edges[i].end);
-
-            if (u == -1 || v == -1)
-            {
-                exit(-1);
-            }
-
-            if (u > v)
-            {
-                solutions[solutions_counter] = i;
-                ++solutions_counter;
-            }
+            min = best;
         }
 
-        if (solutions_counter > min)
+        if (s.back_count >= min)
         {
             continue;
         }
 
-        min = solutions_counter;
-
-        //calcualte the toal length
-        int length = 2 * solutions_counter + 1;
-        for (int i = 0; i < solutions_counter; ++i)
-        {
-            char edge1[8];
-            char edge2[8];
-
-            memset(edge1, 0, 8);
-            memset(edge2, 0, 8);
-
-            sprintf(edge1, "%d", edges[solutions[i]].start);
-            sprintf(edge2, "%d", edges[solutions[i]].end);
-
-            length += strlen(edge1);
-            length += strlen(edge2);
-        }
-
-        char output[length];
-        output[0] = 0;
-
-        for (int i = 0; i < solutions_counter; ++i)
+        min = s.back_count;
+        output.edge_count = s.back_count;
+        for (int i = 0; i < s.back_count; ++i)
         {
-            char edge1[8];
-            char edge2[8];
-            sprintf(edge1, "%d", edges[solutions[i]].start);
-            sprintf(edge2, "%d", edges[solutions[i]].end);
-
-            strcat(output, edge1);
-            strcat(output, "-");
-            strcat(output, edge2);
-            strcat(output, " ");
-            //printf("%s-%s\n", edge1, edge2);
+            output.edges[i] = edges[s.back_edges[i]];
         }
 
-        if (write_circular_buffer(shm, output) == -1)
+        if (write_circular_buffer(shm, &output) == -1)
         {
             exit(EXIT_FAILURE);
         }
@@ -37,24 +37,21 @@ void usage(void)
     exit(EXIT_FAILURE);
 }
 
-/** countChar function
+/** print_solution function
  * @brief
- * Counts the occurances of a symbol in a char pointer
+ * Prints the edges of a solution
  * 
  * @details
- * Counter the occurances by iterating over the char pointer in a loop, looking at each symbol.
+ * Prints each edge as start-end, seperated by spaces.
 **/
-int countChar(const char *input, const char symbol)
+void print_solution(const solution *data)
 {
-    int occurences = 0;
-    for (int i = 0; input[i]; ++i)
+    printf("[%s] Solution with %d edges:", myprog, data->edge_count);
+    for (int i = 0; i < data->edge_count; ++i)
     {
-        if (input[i] == symbol)
-        {
-            ++occurences;
-        }
+        printf(" %d-%d", data->edges[i].start, data->edges[i].end);
     }
-    return occurences;
+    printf("\n");
 }
 
 /**
@@ -85,7 +82,7 @@ int main(int argc, char **argv)
     sa.sa_handler = handle_signal;
     sigaction(SIGINT, &sa, NULL);
 
-    char *data;
+    solution data;
     shared_memory *shm = open_circular_buffer(true);
     if (shm == NULL)
     {
@@ -97,24 +94,21 @@ int main(int argc, char **argv)
 
     while (!quit)
     {
-        data = read_circular_buffer(shm);
-        if (data == NULL)
+        if (read_circular_buffer(shm, &data) == -1)
         {
             break;
         }
-        int occurences = countChar(data, '-');
-        if (occurences == 0)
+        if (data.edge_count == 0)
         {
             printf("[%s] The graph is acyclic!\n", myprog);
-            free(data);
             break;
         }
-        if (occurences < minimal)
+        if (data.edge_count < minimal)
         {
-            minimal = occurences;
-            printf("[%s] Solution with %d edges: %s\n", myprog, occurences, data);
+            minimal = data.edge_count;
+            set_best_circular_buffer(shm, minimal);
+            print_solution(&data);
         }
-        free(data);
     }
 
     if (close_circular_buffer(shm, true) == -1)
@@ -31,11 +31,19 @@
 #include <semaphore.h>
 #include <limits.h>
 
+#include "shmring.h"
+#include "shmgraph.h"
+#include "shmpool.h"
+
 #define SHM_NAME "/11712763_shm"
+/** Name of the graph the supervisor publishes with -g FILE */
+#define GRAPH_NAME "/11712763_graph"
 #define BUF_SIZE (25)
-#define SEM_FREE "/11712763_free"
-#define SEM_USED "/11712763_used"
-#define SEM_MUTEX "/11712763_mutex"
+
+/** Maximum number of edges of a graph in job mode */
+#define MAX_JOB_EDGES (4096)
+/** Vertices of a graph in job mode have to be lower than this */
+#define MAX_JOB_VERTICES (65536)
 
 /**
  * @brief Represents a vertex by its index.
@@ -58,9 +66,10 @@ typedef struct {
 
 /**
  * @brief Container used for storing possible solutions.
- * @details Struct containing a edge-array with a capacity of 8 and a
+ * @details Struct containing a edge-array with a capacity of 8, a
  * counter for information on how many edges are currently stored in a
- * container. Maximum capacity of 8 is given by specification.
+ * container and the process id of the generator that found it. Maximum 
+ * capacity of 8 is given by specification.
  */
 typedef struct {
     /** edge array containing edges stored in the container */
@@ -69,31 +78,39 @@ typedef struct {
     /** Number of edges currently stored in the container */
     size_t counter;
 
+    /** Process id of the generator that wrote the solution */
+    pid_t generator;
+
+    /** Job (job_seq of the buffer) the solution belongs to, 0 without jobs */
+    unsigned int job;
+
 } edge_container;
 
 /**
- * @brief Shared memory for reading and writing possible solutions
- * @details Struct used as shared memory object by supervisor and generators.
- * Central part is an edge_container array which size is defined by BUF_SIZE.
- * Its size is BUF_SIZE*sizeof(edge_container)+16 = BUF_SIZE*136+16, so in the default
- * implementation with BUF_SIZE 25 the size in total is 3416 bytes.
+ * @brief Job area of the shared memory.
+ * @details The solutions are written to a shmring with BUF_SIZE slots of
+ * edge_containers, which also handles the termination and the number of
+ * generators. This struct is its application area: in job mode the supervisor
+ * publishes the current graph in it. job_seq is odd while the supervisor
+ * writes the graph and increases by two with every new one, so generators
+ * copy the graph and check that job_seq didn't change. The job graph makes
+ * up most of the size (MAX_JOB_EDGES*16 bytes).
  */
 typedef struct {
-    /** edge_container array containing possible solutions */
-    edge_container data[BUF_SIZE];
+    /** Sequence number of the current job, 0 if there is none */
+    unsigned int job_seq;
 
-    /** Next array position that has not been read yet */
-    unsigned int read_pos;
+    /** Number of edges of the current job */
+    size_t job_edges;
 
-    /** Next free array position to write to (if buffer is not full) */
-    unsigned int write_pos;
+    /** Number of vertices of the current job */
+    size_t job_vertices;
 
-    /** Flag to initiate shutdown/termination */
-    unsigned int terminate;
+    /** Edges of the current job */
+    edge job[MAX_JOB_EDGES];
 
-    /** Number of running generators (important for shutdown) */
-    unsigned int num_of_generators;
+} job_area;
 
-} circular_buffer;
+SHMRING_TYPED(solution_ring, edge_container)
 
 #endif
\ No newline at end of file
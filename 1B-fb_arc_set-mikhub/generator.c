@@ -1,14 +1,25 @@
 #include "fb_arc_set.h"
 
+typedef struct search_state search_state;
+
+static void run_jobs(void);
 static void generate_solutions(edge edges[]);
 static void fill_vertex_array(vertex vertices[]);
 static void generate_random_permutation(vertex vertices[]);
+static void build_incidence(search_state *s);
+static void restart_search(search_state *s);
+static void toggle_back_edge(search_state *s, size_t e);
+static long move_delta(search_state *s, vertex x, size_t target, bool toggle);
+static void move_vertex(search_state *s, vertex x, size_t target);
+static void search_step(search_state *s);
 static unsigned int get_random_seed(void);
+static long get_time_usec(void);
+static void parse_options(int argc, char* const* argv);
+static long parse_option_value(const char *arg, long max);
 static void parse_input(int argc, const char** argv, edge edges[]);
+static edge *attach_graph(void);
 static edge parse_edge(const char *arg);
-static void write_buffer(edge_container candidate);
-static void wait_write(void);
-static void signal_write(void);
+static void write_buffer(edge_container batch[], size_t count);
 static void initialize(void);
 static void shutdown(void);
 static void ERROR_EXIT(char* message, char* error_details);
@@ -27,41 +38,125 @@ static const char* PROGRAM_NAME;
  * its result to the circular buffer. It repeats this 
  * procedure until it is notified by the supervisor 
  * to terminate.
+ * Instead of a new random permutation for every solution, the
+ * generator refines its permutation with a local search that
+ * moves single vertices and starts over with a random one when
+ * it stops improving.
+ * Only solutions better than the best one of this generator
+ * are written. They are collected in a batch which is written
+ * at once, as soon as it holds -b SOLUTIONS solutions or its
+ * first solution is -t MICROSECONDS old.
+ * With -j the generator takes no edges but solves the graphs the
+ * supervisor publishes in job mode one after another, until the
+ * supervisor terminates.
+ * Without edges and -j the generator maps the graph the supervisor
+ * loaded with -g FILE, so nothing has to be parsed.
  */
 
+/** Default number of solutions after which a batch is written */
+#define DEFAULT_BATCH_SIZE (4)
+
+/** Default age in microseconds after which a batch is written */
+#define DEFAULT_BATCH_USEC (10000)
+
+/** Maximum number of solutions in a batch (a better solution has less edges,
+ * so there are never more than that) */
+#define MAX_BATCH_SIZE (8)
 
-/** Shared memory circular buffer file descriptor */
-static int shm_fd = -1;
+/** A local search starts over after STALE_STEPS plus STALE_STEPS_PER_EDGE
+ * steps per edge without improvement */
+#define STALE_STEPS (1000)
+#define STALE_STEPS_PER_EDGE (10)
 
-/** Circular buffer for writing and reading solutions */
-static circular_buffer *buf = NULL;
+/** Marks an edge that is not a back edge in back_positions */
+#define NO_BACK_EDGE (SIZE_MAX)
 
-/** Semaphore representing space used in the shared buffer, used for signaling 
- * the supervisor that it can read data. */
-static sem_t *sem_used = NULL;
-/** Semaphore representing free space in the shared buffer, used for signaling
- * the generator that it can write data. */
-static sem_t *sem_free = NULL;
-/** Semaphore used by generators to ensure mutual exclusion while writing.  */
-static sem_t *sem_mutex = NULL;
+/** Time in nanoseconds between two checks for a new job */
+#define JOB_POLL_NSEC (1000000)
+
+/**
+ * @brief State of the local search over the vertex permutations.
+ * @details order holds the vertex at each position and position the position
+ * of each vertex. The edges of vertex x are incident[offsets[x]] up to
+ * incident[offsets[x+1]-1], loops are left out as they are never back edges.
+ * The back edges (u after v in the permutation) are the first back_count
+ * entries of back_edges, back_positions holds the position of each edge in
+ * it or NO_BACK_EDGE.
+ */
+struct search_state {
+    edge *edges;
+    vertex *order;
+    size_t *position;
+    size_t *offsets;
+    size_t *incident;
+    size_t *back_edges;
+    size_t *back_positions;
+    size_t back_count;
+    unsigned long steps;
+    unsigned long last_improvement;
+    size_t run_best;
+};
+
+
+/** Circular buffer in shared memory for writing and reading solutions */
+static struct shmring *ring = NULL;
+
+/** Job area in the shared memory */
+static job_area *area = NULL;
+
+/** Graph the supervisor published, NULL if the edges are arguments */
+static struct shmgraph *graph = NULL;
+/** Labels of the vertex indices of graph, NULL if the edges are arguments */
+static const uint32_t *labels = NULL;
 
 /** Number of edges of input graph */
 static size_t num_of_edges;
 /** Number of vertices of input graph */
 static size_t num_of_vertices;
 
+/** Number of solutions after which a batch is written */
+static size_t batch_size = DEFAULT_BATCH_SIZE;
+/** Age in microseconds after which a batch is written */
+static long batch_usec = DEFAULT_BATCH_USEC;
+/** Whether the generator solves the jobs of the supervisor */
+static bool job_mode = false;
+/** Job the generator currently works on, 0 without jobs */
+static unsigned int current_job = 0;
+
 /**
  * @brief Generates solutions based on input graph, writes them to shared memory buffer.
- * @details Uses the global variables shmfd, buf, used_sem, free_sem, mutex_sem.
+ * @details Uses the global variable ring.
  */
 int main(int argc, const char** argv) {
     PROGRAM_NAME = argv[0];
 
+    // parse options before touching any resources
+    parse_options(argc, (char* const*) argv);
+
+    if (job_mode) {
+        if (optind != argc) {
+            USAGE();
+        }
+        initialize();
+        srand(get_random_seed());
+        run_jobs();
+        exit(EXIT_SUCCESS);
+    }
+
     // initialize resources
     initialize();
 
+    // without edges the graph of the supervisor is solved
+    if (optind == argc) {
+        edge *edges = attach_graph();
+        srand(get_random_seed());
+        generate_solutions(edges);
+        free(edges);
+        exit(EXIT_SUCCESS);
+    }
+
     // parse input
-    num_of_edges = argc-1;
+    num_of_edges = argc-optind;
     edge edges[num_of_edges];
     parse_input(argc, argv, edges);
 
@@ -73,34 +168,102 @@ int main(int argc, const char** argv) {
 }
 
 /**
- * @brief Generates solutions and writes them to shared memory buffer.
+ * @brief Solves the jobs published by the supervisor until it terminates.
+ * @details Polls job_seq for a new job, copies its graph and checks that the
+ * supervisor didn't change it meanwhile. Calls generate_solutions; uses global
+ * variables ring, area, num_of_edges, num_of_vertices, current_job.
+ * @see generate_solutions
+ */
+static void run_jobs() {
+    unsigned int seen = 0;
+    struct timespec poll = { .tv_sec = 0, .tv_nsec = JOB_POLL_NSEC };
+    while (shmring_alive(ring)) {
+        unsigned int seq = __atomic_load_n(&area->job_seq, __ATOMIC_ACQUIRE);
+        if (seq == seen || seq % 2 == 1) {
+            nanosleep(&poll, NULL);
+            continue;
+        }
+
+        num_of_edges = area->job_edges;
+        num_of_vertices = area->job_vertices;
+        if (num_of_edges == 0 || num_of_edges > MAX_JOB_EDGES || num_of_vertices > MAX_JOB_VERTICES) {
+            continue;
+        }
+        edge edges[num_of_edges];
+        memcpy(edges, area->job, num_of_edges * sizeof(edge));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&area->job_seq, __ATOMIC_RELAXED) != seq) {
+            continue;
+        }
+
+        seen = seq;
+        current_job = seq;
+        generate_solutions(edges);
+    }
+}
+
+/**
+ * @brief Generates solutions and writes the improving ones to shared memory buffer.
  * @param edges Array of edges of graph to generate solutions for
- * @details Calls write_buffer; uses global variables buf.
- * @see generate_random_permutation, write_buffer
+ * @details Every step of the local search yields a solution, the back edges of
+ * the current permutation. It is only kept if it has less edges than the best
+ * one so far. Kept solutions
+ * are collected in a batch which is written once it is full or old enough; an
+ * acyclic graph is written immediately. Returns when the supervisor publishes
+ * a new job (to_delete.job tells the supervisor which job a solution is for).
+ * Calls write_buffer; uses global variables ring, area, batch_size, batch_usec.
+ * @see search_step, write_buffer
  */
 static void generate_solutions(edge edges[]) {
-    while (buf->terminate == 0) {
-        vertex random_permutation[num_of_vertices];
-        fill_vertex_array(random_permutation);
-        generate_random_permutation(random_permutation);
-        
-        edge_container to_delete;
-
-        to_delete.counter = 0;
-        size_t delete_counter = 0;
-        for (size_t i = 0; i < num_of_edges && delete_counter < 7; i++)
-        {
-            size_t pos_u = random_permutation[edges[i].u];
-            size_t pos_v = random_permutation[edges[i].v];
-            if(pos_u > pos_v) {
-                to_delete.container[delete_counter++] = edges[i];
-                to_delete.counter = delete_counter;
+    edge_container batch[MAX_BATCH_SIZE];
+    size_t batch_counter = 0;
+    long batch_start = 0;
+    size_t limit = 7;
+    pid_t pid = getpid();
+
+    vertex order[num_of_vertices];
+    size_t position[num_of_vertices];
+    size_t offsets[num_of_vertices+1];
+    size_t incident[2*num_of_edges];
+    size_t back_edges[num_of_edges];
+    size_t back_positions[num_of_edges];
+    search_state s = {
+        .edges = edges, .order = order, .position = position,
+        .offsets = offsets, .incident = incident,
+        .back_edges = back_edges, .back_positions = back_positions,
+        .steps = 0
+    };
+    build_incidence(&s);
+    restart_search(&s);
+
+    while (shmring_alive(ring) && __atomic_load_n(&area->job_seq, __ATOMIC_RELAXED) == current_job) {
+        search_step(&s);
+
+        if (s.back_count < limit) {
+            edge_container to_delete;
+            to_delete.counter = s.back_count;
+            to_delete.generator = pid;
+            to_delete.job = current_job;
+            for (size_t i = 0; i < s.back_count; i++) {
+                to_delete.container[i] = edges[back_edges[i]];
+                if (labels != NULL) {
+                    to_delete.container[i].u = labels[to_delete.container[i].u];
+                    to_delete.container[i].v = labels[to_delete.container[i].v];
+                }
             }
+
+            limit = s.back_count;
+            if (batch_counter == 0) {
+                batch_start = get_time_usec();
+            }
+            batch[batch_counter++] = to_delete;
         }
-        if (delete_counter >= 7) {
+        if (batch_counter == 0) {
             continue;
-        } else {
-            write_buffer(to_delete);
+        }
+        if (limit == 0 || batch_counter >= batch_size || get_time_usec() - batch_start >= batch_usec) {
+            write_buffer(batch, batch_counter);
+            batch_counter = 0;
         }
     }
 }
@@ -130,6 +293,171 @@ static void generate_random_permutation(vertex vertices[]) {
     }
 }
 
+/**
+ * @brief Fills offsets and incident of the search state.
+ * @param s Search state with the edges and allocated incidence arrays
+ * @details The offsets are first used to count the degrees and then as
+ * write positions, which moves them one vertex forward, so they are
+ * shifted back at the end. Uses global variables num_of_edges,
+ * num_of_vertices.
+ */
+static void build_incidence(search_state *s) {
+    memset(s->offsets, 0, (num_of_vertices+1) * sizeof(size_t));
+    for (size_t i = 0; i < num_of_edges; i++) {
+        if (s->edges[i].u != s->edges[i].v) {
+            s->offsets[s->edges[i].u+1]++;
+            s->offsets[s->edges[i].v+1]++;
+        }
+    }
+    for (size_t x = 0; x < num_of_vertices; x++) {
+        s->offsets[x+1] += s->offsets[x];
+    }
+
+    for (size_t i = 0; i < num_of_edges; i++) {
+        if (s->edges[i].u != s->edges[i].v) {
+            s->incident[s->offsets[s->edges[i].u]++] = i;
+            s->incident[s->offsets[s->edges[i].v]++] = i;
+        }
+    }
+    for (size_t x = num_of_vertices; x > 0; x--) {
+        s->offsets[x] = s->offsets[x-1];
+    }
+    s->offsets[0] = 0;
+}
+
+/**
+ * @brief Starts the local search over with a new random permutation.
+ * @param s Search state
+ * @details Uses global variables num_of_edges, num_of_vertices.
+ */
+static void restart_search(search_state *s) {
+    fill_vertex_array(s->order);
+    generate_random_permutation(s->order);
+    for (size_t i = 0; i < num_of_vertices; i++) {
+        s->position[s->order[i]] = i;
+    }
+
+    s->back_count = 0;
+    for (size_t i = 0; i < num_of_edges; i++) {
+        s->back_positions[i] = NO_BACK_EDGE;
+        if (s->position[s->edges[i].u] > s->position[s->edges[i].v]) {
+            toggle_back_edge(s, i);
+        }
+    }
+
+    s->run_best = s->back_count;
+    s->last_improvement = s->steps;
+}
+
+/**
+ * @brief Adds an edge to the back edges if it is none, otherwise removes it.
+ * @param s Search state
+ * @param e Index of the edge
+ * @details A removed edge is replaced by the last back edge.
+ */
+static void toggle_back_edge(search_state *s, size_t e) {
+    if (s->back_positions[e] == NO_BACK_EDGE) {
+        s->back_positions[e] = s->back_count;
+        s->back_edges[s->back_count++] = e;
+        return;
+    }
+
+    size_t last = s->back_edges[--s->back_count];
+    s->back_edges[s->back_positions[e]] = last;
+    s->back_positions[last] = s->back_positions[e];
+    s->back_positions[e] = NO_BACK_EDGE;
+}
+
+/**
+ * @brief Returns by how much the number of back edges changes if a vertex
+ * moves to another position.
+ * @param s Search state
+ * @param x Vertex to move
+ * @param target New position of the vertex
+ * @param toggle Whether the edges changing their direction are toggled
+ * @return Change of the number of back edges
+ * @details The vertices between the old and the new position move one
+ * position towards the old one, so only edges to them change their
+ * direction. Takes O(degree) time.
+ */
+static long move_delta(search_state *s, vertex x, size_t target, bool toggle) {
+    size_t from = s->position[x];
+    size_t low = target < from ? target : from+1;
+    size_t high = target < from ? from-1 : target;
+    long delta = 0;
+
+    for (size_t i = s->offsets[x]; i < s->offsets[x+1]; i++) {
+        size_t e = s->incident[i];
+        vertex other = s->edges[e].u == x ? s->edges[e].v : s->edges[e].u;
+        if (s->position[other] < low || s->position[other] > high) {
+            continue;
+        }
+
+        delta += s->back_positions[e] == NO_BACK_EDGE ? 1 : -1;
+        if (toggle) {
+            toggle_back_edge(s, e);
+        }
+    }
+    return delta;
+}
+
+/**
+ * @brief Moves a vertex to another position and updates the back edges.
+ * @param s Search state
+ * @param x Vertex to move
+ * @param target New position of the vertex
+ */
+static void move_vertex(search_state *s, vertex x, size_t target) {
+    move_delta(s, x, target, true);
+
+    size_t from = s->position[x];
+    while (from != target) {
+        size_t next = target < from ? from-1 : from+1;
+        s->order[from] = s->order[next];
+        s->position[s->order[from]] = from;
+        from = next;
+    }
+    s->order[target] = x;
+    s->position[x] = target;
+}
+
+/**
+ * @brief Makes one step of the local search.
+ * @param s Search state
+ * @details A random back edge is taken and either its start vertex is moved
+ * right before its end vertex or its end vertex right after its start
+ * vertex. The move is only made if it does not increase the number of back
+ * edges. If the search did not improve for a while, it starts over with a
+ * new random permutation. Uses global variable num_of_edges.
+ */
+static void search_step(search_state *s) {
+    s->steps++;
+    if (s->steps - s->last_improvement > STALE_STEPS + STALE_STEPS_PER_EDGE * num_of_edges) {
+        restart_search(s);
+        return;
+    }
+    if (s->back_count == 0) {
+        return;
+    }
+
+    edge e = s->edges[s->back_edges[rand() % s->back_count]];
+    vertex x = e.u;
+    size_t target = s->position[e.v];
+    if (rand() % 2) {
+        x = e.v;
+        target = s->position[e.u];
+    }
+
+    if (move_delta(s, x, target, false) <= 0) {
+        move_vertex(s, x, target);
+    }
+
+    if (s->back_count < s->run_best) {
+        s->run_best = s->back_count;
+        s->last_improvement = s->steps;
+    }
+}
+
 /**
  * @brief Returns a random seed for usage in srand()
  * @details This is achieved by multiplying time(2),
@@ -140,26 +468,127 @@ static unsigned int get_random_seed() {
 }
 
 
+/**
+ * @brief Returns the time of the monotonic clock in microseconds.
+ */
+static long get_time_usec() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000L + now.tv_nsec / 1000;
+}
+
+/**
+ * @brief Parses the options -b SOLUTIONS, -t MICROSECONDS and -j.
+ * @param argc Argument counter from main function
+ * @param argv Argument array from main function
+ * @details Sets the global variables batch_size, batch_usec and job_mode, optind
+ * points to the first edge afterwards. Exits with usage on invalid options.
+ */
+static void parse_options(int argc, char* const* argv) {
+    int c;
+    bool b_set = false;
+    bool t_set = false;
+    while ((c = getopt(argc, argv, "b:t:j")) != -1) {
+        switch (c) {
+        case 'b':
+            if (b_set) {
+                USAGE();
+            }
+            b_set = true;
+            batch_size = parse_option_value(optarg, MAX_BATCH_SIZE);
+            if (batch_size == 0) {
+                fprintf(stderr, "[%s]: Batch size has to be between 1 and %d\n", PROGRAM_NAME, MAX_BATCH_SIZE);
+                USAGE();
+            }
+            break;
+        case 't':
+            if (t_set) {
+                USAGE();
+            }
+            t_set = true;
+            batch_usec = parse_option_value(optarg, LONG_MAX);
+            break;
+        case 'j':
+            job_mode = true;
+            break;
+        default:
+            USAGE();
+        }
+    }
+}
+
+/**
+ * @brief Parses a non-negative number not greater than max from an option argument.
+ * @param arg Option argument to parse
+ * @param max Largest allowed value
+ * @return Parsed number
+ * @details Exits with usage if the argument is not such a number.
+ */
+static long parse_option_value(const char *arg, long max) {
+    char *endptr;
+    errno = 0;
+    long value = strtol(arg, &endptr, 10);
+    if (endptr == arg || endptr[0] != '\0' || errno != 0 || value < 0 || value > max) {
+        fprintf(stderr, "[%s]: Invalid option value '%s'\n", PROGRAM_NAME, arg);
+        USAGE();
+    }
+    return value;
+}
+
 /**
  * @brief Parses a graph from the input args and fills edges array with it.
  * @param argc Argument counter from main function
  * @param argv Argument array from main function
  * @param edges Array to be filled with parsed edges
- * @details Additionally, it sets the global variable num_of_vertices 
+ * @details The edges start at optind. Additionally, it sets the global variable num_of_vertices 
  * correctly. Exits with an error if parsing goes wrong.
  */
 static void parse_input(int argc, const char** argv, edge edges[]) {
     // exit if no edges given
-    if(argc == 1){
+    if(argc == optind){
         USAGE();
     }
 
     // parse input
-    for (size_t i = 1; i < argc; i++){
-        edges[i-1] = parse_edge(argv[i]);
+    for (size_t i = optind; i < argc; i++){
+        edges[i-optind] = parse_edge(argv[i]);
     }
 }
 
+/**
+ * @brief Maps the graph the supervisor published and copies its edges.
+ * @return Edges of the graph with vertex indices, which the caller must free
+ * @details The search works on the vertex indices of the graph, so labels
+ * maps them back when a solution is written. Sets the global variables graph,
+ * labels, num_of_edges and num_of_vertices. Exits with an error if there is
+ * no graph.
+ */
+static edge *attach_graph() {
+    graph = shmgraph_open(GRAPH_NAME);
+    if (graph == NULL) {
+        if (errno == ENOENT) {
+            ERROR_MSG("No edges given and the supervisor wasn't started with -g FILE", NULL);
+            USAGE();
+        }
+        ERROR_EXIT("Error opening the graph in shared memory", strerror(errno));
+    }
+
+    const struct shmgraph_view *view = shmgraph_view(graph);
+    edge *edges = malloc(view->num_edges * sizeof(edge));
+    if (edges == NULL) {
+        ERROR_EXIT("Error allocating the edges", strerror(errno));
+    }
+    for (size_t i = 0; i < view->num_edges; i++) {
+        edges[i].u = view->edges[i].u;
+        edges[i].v = view->edges[i].v;
+    }
+
+    labels = view->labels;
+    num_of_edges = view->num_edges;
+    num_of_vertices = view->num_vertices;
+    return edges;
+}
+
 /**
  * @brief Parses an edge in the form "u-v" from an argument.
  * @param arg Argument to parse edge from
@@ -236,59 +665,27 @@ static edge parse_edge(const char* arg) {
 }
 
 /**
- * @brief Writes new solution to the circular buffer. Blocks
- * until there is space to write solution
- * @param edge_container containing a solution candidate
- * @details Calls wait_write, signal_write; uses global variables buf.
- * @see wait_write, signal_write
- */
-static void write_buffer(edge_container candidate) {
-    wait_write();
-    buf->data[buf->write_pos] = candidate;
-    buf->write_pos = (buf->write_pos + 1) % BUF_SIZE;
-    signal_write();
-}
-
-/**
- * @brief Blocks until there is space in the buffer to write and
- * until mutual exclusion is guaranteed.
- * @details Uses global variable sem_free and sem_mutex.
+ * @brief Writes a batch of solutions to the circular buffer. Blocks
+ * until there is space to write every solution
+ * @param batch Array of edge_container containing solution candidates
+ * @param count Number of solutions in the batch
+ * @details The slots for the whole batch are claimed at once. Exits once
+ * the supervisor shut the circular buffer down or a signal interrupted the
+ * wait. Uses global variable ring.
  */
-static void wait_write() {
-    if (sem_wait(sem_free) < 0) {
-        if (errno == EINTR) {
+static void write_buffer(edge_container batch[], size_t count) {
+    if (solution_ring_write_batch(ring, batch, count) < 0) {
+        if (errno == ECANCELED || errno == EINTR) {
             exit(EXIT_SUCCESS);
         }
-        ERROR_EXIT("Error while waiting for sem_free", strerror(errno));
-    }
-    if (buf->terminate) {
-        exit(EXIT_SUCCESS);
-    }
-    if (sem_wait(sem_mutex)) {
-        if (errno == EINTR) {
-            exit(EXIT_SUCCESS);
-        }
-        ERROR_EXIT("Error while waiting for sem_mutex", strerror(errno));
-    }
-}
-
-/**
- * @brief Informs generators that mutual exclusion section was left and
- * informs supervisors that there is new data to be read.
- * @details Uses global variable sem_mutex and sem_used.
- */
-static void signal_write() {
-    if (sem_post(sem_mutex) < 0) {
-        ERROR_EXIT("Error while posting sem_mutex", strerror(errno));
-    }
-    if (sem_post(sem_used) < 0) {
-        ERROR_EXIT("Error while posting sem_used", strerror(errno));
+        ERROR_EXIT("Error writing to the circular buffer", strerror(errno));
     }
 }
 
 /**
- * @brief Defines an exit function, opens and maps shared memory, opens semaphores.
- * @details Sets global variables shm_fd, buf, sem_used, sem_free, sem_mutex.  
+ * @brief Defines an exit function and opens the circular buffer in shared
+ * memory, which also counts this generator.
+ * @details Sets global variables ring, area.
  */
 static void initialize() {
     // exit cleanup function
@@ -296,80 +693,35 @@ static void initialize() {
         ERROR_EXIT("Error setting cleanup function", NULL);
     }
 
-    // open shared memory
-    shm_fd = shm_open(SHM_NAME, O_RDWR, 0600);
-    if (shm_fd < 0) {
+    // open the circular buffer
+    ring = shmring_open(SHM_NAME, sizeof(edge_container));
+    if (ring == NULL) {
         if (errno == ENOENT) {
             ERROR_MSG("Supervisor has to be started first!", NULL);
         }
         ERROR_EXIT("Error opening shared memory", strerror(errno));
     }
-
-    // map shared memory object
-    buf = mmap(NULL, sizeof(*buf), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (buf == MAP_FAILED) {
-        ERROR_EXIT("Error mapping shared memory", strerror(errno));
-    }
-    if (close(shm_fd) < 0) {
-        ERROR_EXIT("Error closing shared memory fd", strerror(errno));
-    }
-    shm_fd = -1;
-
-    // open semaphores
-    sem_used = sem_open(SEM_USED, 0);
-    if (sem_used == SEM_FAILED) {
-        ERROR_EXIT("Error opening used_sem", strerror(errno));
-    }
-    sem_free = sem_open(SEM_FREE, 0);
-    if (sem_free == SEM_FAILED) {
-        ERROR_EXIT("Error opening sem_free", strerror(errno));
-    }
-    sem_mutex = sem_open(SEM_MUTEX, 0);
-    if (sem_mutex == SEM_FAILED) {
-        ERROR_EXIT("Error opening sem_mutex", strerror(errno));
-    }
-
-    // increment generator counter in shm
-    buf->num_of_generators++;
+    area = shmring_extra(ring);
 }
 
 /**
- * @brief Exit function. Unmaps and closes shared memory, closes semaphores.
- * @details Uses global variables shm_fd, buf, sem_used, sem_free, sem_mutex.  
+ * @brief Exit function. Closes the circular buffer and the graph.
+ * @details Uses global variables ring, area, graph, labels.
  */
 static void shutdown() {
-    if (buf != NULL) {
-        buf->num_of_generators--;
-        if (munmap(buf, sizeof(*buf)) < 0) {
+    if (ring != NULL) {
+        if (shmring_close(ring) < 0) {
             ERROR_MSG("Error unmapping shared memory", strerror(errno));
         }
+        ring = NULL;
+        area = NULL;
     }
-
-    if (shm_fd != -1) {
-        if (close(shm_fd) < 0) {
-            ERROR_MSG("Error closing shared memory fd", strerror(errno));
-        }
-    }
-
-    if (sem_used != NULL) {
-        if (sem_close(sem_used) < 0) {
-            ERROR_MSG("Error closing sem_used", strerror(errno));
-        }
-    }
-
-    if (sem_free != NULL) {
-        if (sem_close(sem_free) < 0) {
-            ERROR_MSG("Error closing sem_free", strerror(errno));
-        }
-    }
-
-    if (sem_mutex != NULL) {
-        if (sem_post(sem_mutex) < 0) { // Resolve possible deadlocks
-            ERROR_MSG("Error while sem_post on sem_free", strerror(errno));
-        }
-        if (sem_close(sem_mutex) < 0) {
-            ERROR_MSG("Error closing sem_mutex", strerror(errno));
+    if (graph != NULL) {
+        if (shmgraph_close(graph) < 0) {
+            ERROR_MSG("Error unmapping the graph", strerror(errno));
         }
+        graph = NULL;
+        labels = NULL;
     }
 }
 
@@ -387,7 +739,9 @@ static void ERROR_MSG(char *message, char *error_details) {
 }
 
 static void USAGE() {
-    fprintf(stderr, "Usage: %s EDGE1 EDGE2 ...\n", PROGRAM_NAME);
+    fprintf(stderr, "Usage: %s [-b SOLUTIONS] [-t MICROSECONDS] EDGE1 EDGE2 ...\n", PROGRAM_NAME);
+    fprintf(stderr, "       %s [-b SOLUTIONS] [-t MICROSECONDS] -j\n", PROGRAM_NAME);
+    fprintf(stderr, "       %s [-b SOLUTIONS] [-t MICROSECONDS]   (graph of ./supervisor -g FILE)\n", PROGRAM_NAME);
     fprintf(stderr, "Example: %s 0-1 1-2 1-3 1-4 2-4 3-6 4-3 4-5 6-0\n", PROGRAM_NAME);
     exit(EXIT_FAILURE);
 }
\ No newline at end of file
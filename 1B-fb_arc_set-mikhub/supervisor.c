@@ -1,12 +1,21 @@
 #include "fb_arc_set.h"
 
 static void track_solutions(void);
-static edge_container read_buffer(void);
-static void wait_read(void);
-static void signal_read(void);
+static void run_jobs(FILE *jobs);
+static size_t parse_job(char *line, edge edges[], size_t *num_of_vertices);
+static void publish_job(const edge edges[], size_t num_of_edges, size_t num_of_vertices);
+static bool accept_candidate(edge_container *candidate);
+static void canonicalize(edge_container *solution);
+static bool insert_unique(const edge_container *solution);
+static void record_statistics(const edge_container *solution, bool unique);
+static void print_statistics(void);
+static bool read_buffer(edge_container *candidate, const struct timespec *deadline);
+static void parse_options(int argc, char* const* argv);
 static void initialize(void);
+static void spawn_generators(int argc, char const *argv[]);
 static void shutdown(void);
 static void handle_signal(int signal);
+static void handle_alarm(int signal);
 static void ERROR_EXIT(char* message, char* error_details);
 static void ERROR_MSG(char* message, char* error_details);
 static void USAGE(void);
@@ -17,44 +26,156 @@ static const char* PROGRAM_NAME;
  * @author Michael Huber 11712763
  * @date 12.11.2020
  * @brief OSUE Exercise 1B fb_arc_set
- * @details The supervisor sets up the shared memory and 
- * the semaphores and initializes the circular buffer 
- * required for the communication with the generators. 
+ * @details The supervisor creates the circular buffer in
+ * shared memory (a shmring) required for the communication
+ * with the generators. 
  * It then waits for the generators to write solutions 
  * to the circular buffer.
+ * Every solution is brought into a canonical form (edges 
+ * sorted) and looked up in a hash set, so repeats of a 
+ * solution are recognized. With -s SECONDS the supervisor 
+ * prints statistics every SECONDS seconds to stderr: the
+ * sizes of the unique solutions and how many solutions each
+ * generator wrote per second.
+ * With -j FILE the supervisor runs in job mode: every line of
+ * FILE is a graph (edges separated by whitespace), which is
+ * published in the shared memory for generators started with
+ * -j. A job ends after -T SECONDS or as soon as a solution with
+ * at most -q EDGES edges arrives, then its best solution is 
+ * printed and the next graph is published.
+ * With -g FILE the supervisor loads a graph file (a text or
+ * binary edge list, see shmgraph.h) once and publishes it in a
+ * read-only shared memory object, which generators started
+ * without edges map instead of parsing their arguments.
+ * With -n GENERATORS the supervisor starts the generators
+ * itself, with the arguments after the options (and -j in job
+ * mode), and stops them again when it exits. With -p it pins
+ * itself and every generator to a CPU of its own, the CPUs of
+ * its NUMA node first, and touches the whole shared memory
+ * before any generator can open it, so it lives on that node.
+ * The statistics show the CPU of every generator.
  */
 
+/** Number of slots of the hash set of seen solutions, must be a power of 
+ * two. The set is cleared once it is three quarters full. */
+#define DEDUP_SLOTS (4096)
 
-/** Shared memory circular buffer file descriptor */
-static int shm_fd = -1;
+/** Number of generators the statistics keep apart, the solutions of any
+ * further generators are only counted in the totals */
+#define MAX_GENERATORS (64)
 
-/** Circular buffer for writing and reading solutions */
-static circular_buffer *buf = NULL;
+/** Largest allowed statistics interval in seconds */
+#define MAX_INTERVAL (3600)
 
-/** Semaphore representing space used in the shared buffer, used for signaling 
- * the supervisor that it can read data. */
-static sem_t *sem_used = NULL;
-/** Semaphore representing free space in the shared buffer, used for signaling
- * the generator that it can write data. */
-static sem_t *sem_free = NULL;
-/** Semaphore used by generators to ensure mutual exclusion while writing.  */
-static sem_t *sem_mutex = NULL;
+/** Default time limit of a job in seconds */
+#define DEFAULT_JOB_SECONDS (10)
+
+/**
+ * @brief Slot of the hash set of seen solutions.
+ */
+typedef struct {
+    /** Whether the slot holds a solution */
+    bool used;
+
+    /** Hash of the canonical solution */
+    uint64_t hash;
+
+    /** The canonical solution */
+    edge_container solution;
+
+} dedup_slot;
+
+/**
+ * @brief Statistics of one generator since the last report.
+ */
+typedef struct {
+    /** Process id of the generator */
+    pid_t pid;
+
+    /** Number of solutions read */
+    size_t received;
+
+    /** Number of those that weren't seen before */
+    size_t unique;
+
+} generator_stats;
+
+
+/** Circular buffer in shared memory for writing and reading solutions */
+static struct shmring *ring = NULL;
+
+/** Job area in the shared memory */
+static job_area *area = NULL;
+
+/** Hash set of the solutions seen so far */
+static dedup_slot seen[DEDUP_SLOTS];
+/** Number of used slots in seen */
+static size_t seen_count = 0;
+
+/** Number of unique solutions per size */
+static size_t histogram[9];
+/** Statistics of the generators since the last report */
+static generator_stats generators[MAX_GENERATORS];
+/** Number of used entries in generators */
+static size_t generator_count = 0;
+/** Number of solutions read since the last report */
+static size_t received_total = 0;
+/** Number of unique solutions read since the last report */
+static size_t unique_total = 0;
+
+/** Seconds between two statistics reports, 0 if none are printed */
+static unsigned int report_interval = 0;
+/** Set by the alarm handler when a report is due */
+static volatile sig_atomic_t report_due = 0;
+
+/** Graph published with -g FILE, NULL without */
+static struct shmgraph *graph = NULL;
+/** Path of the graph file, NULL without -g */
+static const char *graph_path = NULL;
+
+/** Generators started with -n GENERATORS, NULL without */
+static struct shmpool *pool = NULL;
+/** Number of generators to start, 0 without -n */
+static size_t pool_size = 0;
+/** Whether the supervisor and the generators are pinned (-p) */
+static bool pin = false;
+
+/** Path of the job file, NULL without job mode */
+static const char *job_path = NULL;
+/** Time limit of a job in seconds */
+static long job_seconds = DEFAULT_JOB_SECONDS;
+/** A job ends as soon as a solution has at most that many edges */
+static size_t job_target = 0;
 
 /**
  * @brief Sets up shared memory, keeps track of best solutions.
- * @details Calls initialize, track_solutions.
- * @see initialize, track_solutions
+ * @details Calls parse_options, initialize, track_solutions.
+ * @see parse_options, initialize, track_solutions
  */
 int main(int argc, char const *argv[]) {
     PROGRAM_NAME = argv[0];
 
-    if (argc != 1){
+    parse_options(argc, (char* const*) argv);
+    if (optind != argc && pool_size == 0) {
         USAGE();
     }
 
+    FILE *jobs = NULL;
+    if (job_path != NULL && (jobs = fopen(job_path, "r")) == NULL) {
+        ERROR_EXIT("Error opening job file", strerror(errno));
+    }
+
     initialize();
+    if (pool_size > 0) {
+        spawn_generators(argc - optind, argv + optind);
+    }
 
-    track_solutions();
+    if (jobs != NULL) {
+        run_jobs(jobs);
+        fclose(jobs);
+    } else {
+        track_solutions();
+    }
 
     exit(EXIT_SUCCESS);
 }
@@ -62,16 +183,27 @@ int main(int argc, char const *argv[]) {
 /**
  * @brief Keeps track of the best solution produced by the generators.
  * @details Keeps track of the best solution and prints it every time it receives 
- * a better one. Calls read_buffer; uses global variables buf.
+ * a better one. Repeated solutions are only counted, a due statistics report is
+ * printed between two reads. Calls read_buffer, canonicalize, insert_unique,
+ * record_statistics, print_statistics; uses global variables ring, report_due.
  * @see read_buffer
  */
 static void track_solutions() {
     edge_container solution = { .counter = SIZE_MAX };
-    while(buf -> terminate == 0) {
-        edge_container candidate = read_buffer();
+    while(shmring_alive(ring)) {
+        if (report_due) {
+            report_due = 0;
+            print_statistics();
+        }
+
+        edge_container candidate;
+        if (!read_buffer(&candidate, NULL) || !accept_candidate(&candidate)) {
+            continue;
+        }
+
         if (candidate.counter == 0) {
             printf("The graph is acyclic!\n");
-            buf -> terminate = 1;
+            shmring_shutdown(ring);
         } else if (candidate.counter < solution.counter) {
             solution = candidate;
             printf("Solution with %zu edges:", solution.counter);
@@ -85,179 +217,544 @@ static void track_solutions() {
 }
 
 /**
- * @brief Reads new solution from the circular buffer and returns it. Blocks
- * until there is new data to read.
- * @details Calls wait_read, signal_read; uses global variables buf.
- * @see wait_read, signal_read
- * @return edge_container containing a solution candidate
+ * @brief Solves the graphs of the job file one after another.
+ * @param jobs The opened job file
+ * @details Publishes every graph and tracks the solutions of the generators 
+ * until the time limit or the target is reached, then prints the best one.
+ * Solutions of earlier jobs are dropped. Shuts the circular buffer down after
+ * the last job. Calls parse_job, publish_job, read_buffer, accept_candidate;
+ * uses global variables ring, area, job_seconds, job_target, seen, seen_count.
  */
-static edge_container read_buffer() {
-    wait_read();
-    edge_container candidate = buf->data[buf->read_pos];
-    buf->read_pos = (buf->read_pos + 1) % BUF_SIZE;
-    signal_read();
-    return candidate;
+static void run_jobs(FILE *jobs) {
+    static edge edges[MAX_JOB_EDGES];
+    char *line = NULL;
+    size_t line_size = 0;
+    size_t job_number = 0;
+    while (shmring_alive(ring) && getline(&line, &line_size, jobs) != -1) {
+        job_number++;
+        size_t num_of_vertices;
+        size_t num_of_edges = parse_job(line, edges, &num_of_vertices);
+        if (num_of_edges == 0) {
+            fprintf(stderr, "[%s]: Skipping job %zu (invalid or empty graph)\n", PROGRAM_NAME, job_number);
+            continue;
+        }
+
+        memset(seen, 0, sizeof(seen));
+        seen_count = 0;
+        publish_job(edges, num_of_edges, num_of_vertices);
+
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += job_seconds;
+
+        edge_container solution = { .counter = SIZE_MAX };
+        while (shmring_alive(ring) && (solution.counter == SIZE_MAX || solution.counter > job_target)) {
+            if (report_due) {
+                report_due = 0;
+                print_statistics();
+            }
+
+            edge_container candidate;
+            if (!read_buffer(&candidate, &deadline)) {
+                struct timespec now;
+                clock_gettime(CLOCK_REALTIME, &now);
+                if (now.tv_sec > deadline.tv_sec || (now.tv_sec == deadline.tv_sec && now.tv_nsec >= deadline.tv_nsec)) {
+                    break;
+                }
+                continue;
+            }
+            if (candidate.job != area->job_seq || !accept_candidate(&candidate)) {
+                continue;
+            }
+            if (candidate.counter < solution.counter) {
+                solution = candidate;
+            }
+        }
+
+        if (solution.counter == SIZE_MAX) {
+            printf("Job %zu: No solution found\n", job_number);
+        } else if (solution.counter == 0) {
+            printf("Job %zu: The graph is acyclic!\n", job_number);
+        } else {
+            printf("Job %zu: Solution with %zu edges:", job_number, solution.counter);
+            for (size_t i = 0; i < solution.counter; i++) {
+                printf(" %ld-%ld", solution.container[i].u, solution.container[i].v);
+            }
+            printf("\n");
+        }
+        fflush(stdout);
+    }
+    free(line);
+    shmring_shutdown(ring);
 }
 
 /**
- * @brief Blocks until there is new data in the buffer to read.
- * @details Uses global variable sem_used.
+ * @brief Parses a line of the job file.
+ * @param line Line to parse, gets modified
+ * @param edges Array of MAX_JOB_EDGES edges to be filled
+ * @param num_of_vertices Set to the number of vertices (highest index plus one)
+ * @return Number of edges, 0 if the line is empty or invalid
  */
-static void wait_read() {
-    if(sem_wait(sem_used) < 0){
-        if(errno != EINTR){
-            ERROR_EXIT("Error while sem_wait", strerror(errno));
+static size_t parse_job(char *line, edge edges[], size_t *num_of_vertices) {
+    size_t num_of_edges = 0;
+    *num_of_vertices = 0;
+    for (char *token = strtok(line, " \t\r\n"); token != NULL; token = strtok(NULL, " \t\r\n")) {
+        char *endptr;
+        errno = 0;
+        long u = strtol(token, &endptr, 10);
+        if (endptr == token || endptr[0] != '-' || u < 0 || u >= MAX_JOB_VERTICES) {
+            return 0;
+        }
+        char *second = endptr + 1;
+        long v = strtol(second, &endptr, 10);
+        if (endptr == second || endptr[0] != '\0' || v < 0 || v >= MAX_JOB_VERTICES || errno != 0) {
+            return 0;
+        }
+        if (num_of_edges == MAX_JOB_EDGES) {
+            return 0;
+        }
+
+        edges[num_of_edges].u = u;
+        edges[num_of_edges].v = v;
+        num_of_edges++;
+        if ((size_t) u + 1 > *num_of_vertices) {
+            *num_of_vertices = u + 1;
+        }
+        if ((size_t) v + 1 > *num_of_vertices) {
+            *num_of_vertices = v + 1;
         }
     }
-    if (buf->terminate) {
-        exit(EXIT_SUCCESS);
-    }
+    return num_of_edges;
 }
 
 /**
- * @brief Informs generators that data has been read and can be overwritten
- * with new data.
- * @details Uses global variable sem_free.
+ * @brief Publishes a graph as the current job in the shared memory.
+ * @param edges Edges of the graph
+ * @param num_of_edges Number of edges
+ * @param num_of_vertices Number of vertices
+ * @details job_seq is odd while the graph is written (see job_area).
+ * Uses global variable area.
  */
-static void signal_read() {
-    if(sem_post(sem_free) < 0){
-        ERROR_EXIT("Error while sem_post", strerror(errno));
-    }
+static void publish_job(const edge edges[], size_t num_of_edges, size_t num_of_vertices) {
+    unsigned int seq = area->job_seq;
+    __atomic_store_n(&area->job_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    area->job_edges = num_of_edges;
+    area->job_vertices = num_of_vertices;
+    memcpy(area->job, edges, num_of_edges * sizeof(edge));
+    __atomic_store_n(&area->job_seq, seq + 2, __ATOMIC_RELEASE);
 }
 
 /**
- * @brief Defines an exit function, creates and maps shared memory, sets
- * signal handler, initializes shared memory buffer, creates semaphores.
- * @details Sets global variables shm_fd, buf, sem_used, sem_free, sem_mutex.  
+ * @brief Canonicalizes a solution candidate and counts it in the statistics.
+ * @param candidate Solution candidate that was read
+ * @details Calls canonicalize, insert_unique, record_statistics.
+ * @return true if the candidate is valid and wasn't seen before
  */
-static void initialize() {
-    // exit cleanup function
-    if(atexit(shutdown) < 0) {
-        ERROR_EXIT("Error setting cleanup function", NULL);
+static bool accept_candidate(edge_container *candidate) {
+    if (candidate->counter > 8) {
+        return false;
     }
 
-    // create shared memory
-    shm_fd = shm_open(SHM_NAME, O_RDWR | O_CREAT | O_EXCL, 0600);
-    if (shm_fd < 0) {
-        ERROR_EXIT("Error creating shared memory", strerror(errno));
-    }
+    canonicalize(candidate);
+    bool unique = insert_unique(candidate);
+    record_statistics(candidate, unique);
+    return unique;
+}
 
-    // set size of shared memory
-    if (ftruncate(shm_fd, sizeof(circular_buffer)) < 0) {
-        ERROR_EXIT("Error setting size of shared memory", strerror(errno));
+/**
+ * @brief Sorts the edges of a solution, so equal sets of edges are equal
+ * containers.
+ * @param solution Solution to sort
+ * @details The unused edges are zeroed, so whole containers can be compared.
+ */
+static void canonicalize(edge_container *solution) {
+    for (size_t i = 1; i < solution->counter; i++) {
+        edge e = solution->container[i];
+        size_t j = i;
+        while (j > 0 && (solution->container[j-1].u > e.u ||
+                (solution->container[j-1].u == e.u && solution->container[j-1].v > e.v))) {
+            solution->container[j] = solution->container[j-1];
+            j--;
+        }
+        solution->container[j] = e;
     }
+    for (size_t i = solution->counter; i < 8; i++) {
+        solution->container[i].u = 0;
+        solution->container[i].v = 0;
+    }
+}
 
-    // map shared memory object
-    buf = mmap(NULL, sizeof(*buf), PROT_READ | PROT_WRITE, MAP_SHARED, shm_fd, 0);
-    if (buf == MAP_FAILED) {
-        ERROR_EXIT("Error mapping shared memory", strerror(errno));
+/**
+ * @brief Adds a canonical solution to the hash set of seen solutions.
+ * @param solution Canonical solution to add
+ * @details Uses FNV-1a over the edges and linear probing. The set is cleared
+ * once it is three quarters full, so very old solutions may count as unique
+ * again. Uses global variables seen, seen_count.
+ * @return true if the solution wasn't in the set before
+ */
+static bool insert_unique(const edge_container *solution) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < solution->counter; i++) {
+        hash = (hash ^ (uint64_t) solution->container[i].u) * 1099511628211ULL;
+        hash = (hash ^ (uint64_t) solution->container[i].v) * 1099511628211ULL;
     }
-    if (close(shm_fd) < 0) {
-        ERROR_MSG("Error closing shared memory fd", strerror(errno));
+
+    size_t i = hash & (DEDUP_SLOTS - 1);
+    while (seen[i].used) {
+        if (seen[i].hash == hash && seen[i].solution.counter == solution->counter &&
+                memcmp(seen[i].solution.container, solution->container, sizeof(solution->container)) == 0) {
+            return false;
+        }
+        i = (i + 1) & (DEDUP_SLOTS - 1);
     }
-    shm_fd = -1;
 
-    // set signal handler
-    struct sigaction sa = { .sa_handler = handle_signal };
-    if (sigaction(SIGINT, &sa, NULL) + sigaction(SIGTERM, &sa, NULL) < 0) {
-        ERROR_EXIT("Error setting signal handler", strerror(errno));
+    if (seen_count >= DEDUP_SLOTS / 4 * 3) {
+        memset(seen, 0, sizeof(seen));
+        seen_count = 0;
+        i = hash & (DEDUP_SLOTS - 1);
     }
+    seen[i].used = true;
+    seen[i].hash = hash;
+    seen[i].solution = *solution;
+    seen_count++;
+    return true;
+}
 
-    // initialize buffer
-    buf -> terminate = 0;
-    buf -> read_pos = 0;
-    buf -> write_pos = 0;
-    buf -> num_of_generators = 0;
+/**
+ * @brief Counts a solution in the histogram and the statistics of its generator.
+ * @param solution Solution that was read
+ * @param unique Whether it wasn't seen before
+ * @details Uses global variables histogram, generators, generator_count,
+ * received_total, unique_total.
+ */
+static void record_statistics(const edge_container *solution, bool unique) {
+    received_total++;
+    if (unique) {
+        unique_total++;
+        histogram[solution->counter]++;
+    }
 
-    // create semaphores
-    sem_used = sem_open(SEM_USED, O_CREAT | O_EXCL, 0600, 0);
-    if (sem_used == SEM_FAILED) {
-        ERROR_EXIT("Error creating used_sem", strerror(errno));
+    size_t i = 0;
+    while (i < generator_count && generators[i].pid != solution->generator) {
+        i++;
     }
-    sem_free = sem_open(SEM_FREE, O_CREAT | O_EXCL, 0600, BUF_SIZE);
-    if (sem_free == SEM_FAILED) {
-        ERROR_EXIT("Error creating sem_free", strerror(errno));
+    if (i == generator_count) {
+        if (generator_count == MAX_GENERATORS) {
+            return;
+        }
+        generators[generator_count].pid = solution->generator;
+        generators[generator_count].received = 0;
+        generators[generator_count].unique = 0;
+        generator_count++;
     }
-    sem_mutex = sem_open(SEM_MUTEX, O_CREAT | O_EXCL, 0600, 1);
-    if (sem_mutex == SEM_FAILED) {
-        ERROR_EXIT("Error creating sem_mutex", strerror(errno));
+    generators[i].received++;
+    if (unique) {
+        generators[i].unique++;
     }
 }
 
 /**
- * @brief Exit function. Unmaps, closes and unlinks shared memory, closes and unlinks semaphores.
- * @details Uses global variables shm_fd, buf, sem_used, sem_free, sem_mutex.  
+ * @brief Prints the statistics since the last report to stderr and resets them.
+ * @details The histogram counts the unique solutions since the start. Generators
+ * that didn't write anything since the last report are dropped, unless the
+ * supervisor started them. Uses global variables histogram, generators,
+ * generator_count, received_total, unique_total, report_interval, pool.
  */
-static void shutdown() {
-    if (buf != NULL) {
-        buf -> terminate = 1;
-
-        // Stop all waiting generators from waiting
-        if (sem_free != NULL) {
-            for (size_t i = 0; i < buf->num_of_generators; i++) {
-                if(sem_post(sem_free) < 0) {
-                    ERROR_MSG("Error while sem_post for sem_free", strerror(errno));
-                }
-            }
+static void print_statistics() {
+    fprintf(stderr, "[%s]: %.1f solutions/s (%.1f unique/s), sizes:", PROGRAM_NAME,
+            (double) received_total / report_interval, (double) unique_total / report_interval);
+    for (size_t i = 0; i <= 8; i++) {
+        if (histogram[i] > 0) {
+            fprintf(stderr, " %zu:%zu", i, histogram[i]);
         }
     }
+    fprintf(stderr, "\n");
 
-    // Close shared memory fd (if not already closed)
-    if (shm_fd != -1) {
-        if (close(shm_fd) < 0) {
-            ERROR_MSG("Error closing shared memory fd", strerror(errno));
+    size_t kept = 0;
+    for (size_t i = 0; i < generator_count; i++) {
+        ssize_t index = pool == NULL ? -1 : shmpool_find(pool, generators[i].pid);
+        if (generators[i].received == 0 && index == -1) {
+            continue;
+        }
+        fprintf(stderr, "[%s]:   generator %ld", PROGRAM_NAME, (long) generators[i].pid);
+        if (index != -1 && shmpool_cpu(pool, index) != -1) {
+            fprintf(stderr, " (cpu %d)", shmpool_cpu(pool, index));
         }
-        shm_fd = -1;
+        fprintf(stderr, ": %.1f solutions/s (%.1f unique/s)\n",
+                (double) generators[i].received / report_interval,
+                (double) generators[i].unique / report_interval);
+        generators[kept] = generators[i];
+        generators[kept].received = 0;
+        generators[kept].unique = 0;
+        kept++;
     }
+    generator_count = kept;
+    received_total = 0;
+    unique_total = 0;
+}
 
-    // Close and unlink semaphores
-    if (sem_used != NULL) {
-        if (sem_close(sem_used) < 0) {
-            ERROR_MSG("Error closing sem_used", strerror(errno));
+/**
+ * @brief Reads new solution from the circular buffer. Blocks until there is 
+ * new data to read, a signal arrives or the deadline passes.
+ * @param candidate Container the solution candidate is copied to
+ * @param deadline CLOCK_REALTIME time to give up at, NULL to wait forever
+ * @details Exits once the circular buffer was shut down. Uses global variable
+ * ring.
+ * @return true if a solution was read, false if the wait was interrupted
+ * or timed out
+ */
+static bool read_buffer(edge_container *candidate, const struct timespec *deadline) {
+    if (solution_ring_read(ring, candidate, deadline) < 0) {
+        if (errno == ECANCELED) {
+            exit(EXIT_SUCCESS);
         }
-        if (sem_unlink(SEM_USED) < 0) {
-            ERROR_MSG("Error unlinking SEM_USED", strerror(errno));
+        if (errno != EINTR && errno != ETIMEDOUT) {
+            ERROR_EXIT("Error reading the circular buffer", strerror(errno));
         }
+        return false;
     }
-    if (sem_free != NULL) {
-        if (sem_close(sem_free) < 0) {
-            ERROR_MSG("Error closing sem_free", strerror(errno));
-        }
-        if (sem_unlink(SEM_FREE) < 0) {
-            ERROR_MSG("Error unlinking SEM_FREE", strerror(errno));
+    return true;
+}
+
+/**
+ * @brief Parses the options -s SECONDS, -n GENERATORS, -p, -g FILE, -j FILE,
+ * -T SECONDS and -q EDGES.
+ * @param argc Argument counter from main function
+ * @param argv Argument array from main function
+ * @details Sets the global variables report_interval, pool_size, pin,
+ * graph_path, job_path, job_seconds and job_target. Exits with usage on invalid
+ * options, also if both -g and -j are given, as the jobs have their own graphs.
+ */
+static void parse_options(int argc, char* const* argv) {
+    int c;
+    bool s_set = false;
+    while ((c = getopt(argc, argv, "s:n:pg:j:T:q:")) != -1) {
+        char *endptr;
+        long value;
+        switch (c) {
+        case 'n':
+            errno = 0;
+            value = strtol(optarg, &endptr, 10);
+            if (endptr == optarg || endptr[0] != '\0' || errno != 0 || value < 1 || value > MAX_GENERATORS) {
+                fprintf(stderr, "[%s]: Number of generators has to be between 1 and %d\n", PROGRAM_NAME, MAX_GENERATORS);
+                USAGE();
+            }
+            pool_size = value;
+            break;
+        case 'p':
+            pin = true;
+            break;
+        case 'g':
+            graph_path = optarg;
+            break;
+        case 'j':
+            job_path = optarg;
+            break;
+        case 'T':
+            errno = 0;
+            value = strtol(optarg, &endptr, 10);
+            if (endptr == optarg || endptr[0] != '\0' || errno != 0 || value < 1 || value > MAX_INTERVAL) {
+                fprintf(stderr, "[%s]: Time limit has to be between 1 and %d seconds\n", PROGRAM_NAME, MAX_INTERVAL);
+                USAGE();
+            }
+            job_seconds = value;
+            break;
+        case 'q':
+            errno = 0;
+            value = strtol(optarg, &endptr, 10);
+            if (endptr == optarg || endptr[0] != '\0' || errno != 0 || value < 0 || value > 8) {
+                fprintf(stderr, "[%s]: Target has to be between 0 and 8 edges\n", PROGRAM_NAME);
+                USAGE();
+            }
+            job_target = value;
+            break;
+        case 's':
+            if (s_set) {
+                USAGE();
+            }
+            s_set = true;
+            errno = 0;
+            value = strtol(optarg, &endptr, 10);
+            if (endptr == optarg || endptr[0] != '\0' || errno != 0 || value < 1 || value > MAX_INTERVAL) {
+                fprintf(stderr, "[%s]: Interval has to be between 1 and %d seconds\n", PROGRAM_NAME, MAX_INTERVAL);
+                USAGE();
+            }
+            report_interval = value;
+            break;
+        default:
+            USAGE();
         }
     }
-    if (sem_mutex != NULL) {
-        if (sem_close(sem_mutex) < 0) {
-            ERROR_MSG("Error closing sem_mutex", strerror(errno));
+    if (graph_path != NULL && job_path != NULL) {
+        USAGE();
+    }
+}
+
+/**
+ * @brief Defines an exit function, publishes the graph, creates the circular
+ * buffer in shared memory and sets the signal handler.
+ * @details The graph is published before the circular buffer, so a generator
+ * that could open the buffer always finds the whole graph. The job area is
+ * part of the shared memory and starts zeroed, so job_seq is 0. With -p the
+ * supervisor pins itself first and has every page of the buffer touched, so
+ * both are allocated on its node. Sets global variables graph, ring, area.
+ * Starts the statistics alarm if report_interval is set.
+ */
+static void initialize() {
+    // exit cleanup function
+    if(atexit(shutdown) < 0) {
+        ERROR_EXIT("Error setting cleanup function", NULL);
+    }
+
+    // stay on one CPU, so the shared memory is allocated on its node
+    if (pin && shmpool_pin_self() < 0) {
+        ERROR_EXIT("Error pinning the supervisor", strerror(errno));
+    }
+
+    // load and publish the graph
+    if (graph_path != NULL) {
+        struct shmgraph_edge *edges;
+        size_t count;
+        if (shmgraph_load(graph_path, &edges, &count) < 0) {
+            ERROR_EXIT("Error loading the graph file", strerror(errno));
         }
-        if (sem_unlink(SEM_MUTEX) < 0) {
-            ERROR_MSG("Error unlinking SEM_MUTEX", strerror(errno));
+        graph = shmgraph_create(GRAPH_NAME, edges, count);
+        int err = errno;
+        free(edges);
+        if (graph == NULL) {
+            ERROR_EXIT("Error publishing the graph", strerror(err));
         }
     }
 
-    // Unmap shared memory
-    if (buf != NULL) {
-        buf -> terminate = 1;
-        if (munmap(buf, sizeof(*buf)) < 0) {
-            ERROR_MSG("Error unmapping shared memory", strerror(errno));
+    // create the circular buffer
+    struct shmring_config config = {
+        .record_size = sizeof(edge_container),
+        .capacity = BUF_SIZE,
+        .extra_size = sizeof(job_area),
+        .backend = SHMRING_DEFAULT,
+        .populate = pin
+    };
+    ring = shmring_create(SHM_NAME, &config);
+    if (ring == NULL) {
+        ERROR_EXIT("Error creating shared memory", strerror(errno));
+    }
+    area = shmring_extra(ring);
+
+    // set signal handler
+    struct sigaction sa = { .sa_handler = handle_signal };
+    if (sigaction(SIGINT, &sa, NULL) + sigaction(SIGTERM, &sa, NULL) < 0) {
+        ERROR_EXIT("Error setting signal handler", strerror(errno));
+    }
+
+    // start the statistics timer, without SA_RESTART so it interrupts the read
+    if (report_interval > 0) {
+        struct sigaction alarm_sa = { .sa_handler = handle_alarm };
+        if (sigaction(SIGALRM, &alarm_sa, NULL) < 0) {
+            ERROR_EXIT("Error setting alarm handler", strerror(errno));
         }
+        alarm(report_interval);
+    }
+}
+
+/**
+ * @brief Starts the generators.
+ * @param argc Number of arguments for the generators
+ * @param argv Arguments for the generators
+ * @details The generator is the program "generator" in the directory of the
+ * supervisor. It gets -j in job mode, then the arguments. Its solutions are
+ * counted in the statistics from the start, so a generator that doesn't find
+ * any shows up with 0 solutions/s. Sets global variables pool, generators,
+ * generator_count.
+ */
+static void spawn_generators(int argc, char const *argv[]) {
+    char path[PATH_MAX];
+    const char *slash = strrchr(PROGRAM_NAME, '/');
+    int length = slash == NULL ? 0 : (int) (slash - PROGRAM_NAME + 1);
+    if (snprintf(path, sizeof(path), "%.*sgenerator", length, PROGRAM_NAME) >= (int) sizeof(path)) {
+        ERROR_EXIT("Error starting the generators", strerror(ENAMETOOLONG));
+    }
+
+    char const *arguments[argc + 3];
+    size_t count = 0;
+    arguments[count++] = path;
+    if (job_path != NULL) {
+        arguments[count++] = "-j";
+    }
+    for (int i = 0; i < argc; i++) {
+        arguments[count++] = argv[i];
     }
+    arguments[count] = NULL;
+
+    struct shmpool_config config = {
+        .path = path,
+        .argv = (char* const*) arguments,
+        .count = pool_size,
+        .pin = pin
+    };
+    pool = shmpool_spawn(&config);
+    if (pool == NULL) {
+        ERROR_EXIT("Error starting the generators", strerror(errno));
+    }
+
+    for (size_t i = 0; i < pool_size; i++) {
+        generators[generator_count].pid = shmpool_pid(pool, i);
+        generators[generator_count].received = 0;
+        generators[generator_count].unique = 0;
+        generator_count++;
+    }
+}
 
-    // Unlink shared memory
-    if (shm_unlink(SHM_NAME) < 0) {
-        ERROR_MSG("Error unlinking shared memory", strerror(errno));
+/**
+ * @brief Exit function. Shuts the circular buffer down, which wakes up all
+ * waiting generators, removes the shared memory and the graph and stops the
+ * generators the supervisor started.
+ * @details The generators are stopped after the shutdown, so SIGTERM only
+ * ends the ones that are still searching. Uses global variables ring, area,
+ * graph, pool.
+ */
+static void shutdown() {
+    if (ring != NULL) {
+        if (shmring_close(ring) < 0) {
+            ERROR_MSG("Error removing shared memory", strerror(errno));
+        }
+        ring = NULL;
+        area = NULL;
+    }
+    if (graph != NULL) {
+        if (shmgraph_close(graph) < 0) {
+            ERROR_MSG("Error removing the graph", strerror(errno));
+        }
+        graph = NULL;
+    }
+    if (pool != NULL) {
+        int failed = shmpool_close(pool, SIGTERM);
+        if (failed < 0) {
+            ERROR_MSG("Error stopping the generators", strerror(errno));
+        } else if (failed > 0) {
+            fprintf(stderr, "[%s]: %d generators failed\n", PROGRAM_NAME, failed);
+        }
+        pool = NULL;
     }
 }
 
 /**
- * @brief Informs generators that they should terminate and then exits.
- * @details Sets terminate-flag of shared buffer to inform generators that they 
- * should terminate. Additionally increments sem_free semaphore to prevent deadlocking 
- * of blocking generators.Uses global variables shm_fd, buf, sem_used, sem_free, sem_mutex.  
+ * @brief Informs generators that they should terminate.
+ * @details Shuts the circular buffer down (which is async-signal-safe), so
+ * every blocked generator and the waiting supervisor wake up. Uses global
+ * variable ring.
  */
 static void handle_signal(int signal) {
-    buf->terminate = 1;
+    shmring_shutdown(ring);
+}
+
+/**
+ * @brief Marks a statistics report as due and restarts the alarm.
+ * @details Uses global variables report_due, report_interval.
+ */
+static void handle_alarm(int signal) {
+    report_due = 1;
+    alarm(report_interval);
 }
 
 static void ERROR_EXIT(char *message, char *error_details) {
@@ -274,6 +771,6 @@ static void ERROR_MSG(char *message, char *error_details) {
 }
 
 static void USAGE() {
-    fprintf(stderr, "Usage: ./supervisor\n");
+    fprintf(stderr, "Usage: ./supervisor [-s SECONDS] [-n GENERATORS] [-p] [-g FILE | -j FILE [-T SECONDS] [-q EDGES]] [GENERATOR_ARGUMENTS]\n");
     exit(EXIT_FAILURE);
 }
\ No newline at end of file
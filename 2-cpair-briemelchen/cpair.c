@@ -1,661 +1,1025 @@
-/**
- * @file cpair.c
- * @author briemelchen
- * @date 28.11.2020
- * @brief program which computes the closest pair of points in a given array of points.
- * @details the program reads the input line by line from stdin, where each line holds an point
- * x y whitespace seperated. After reading, if their are more then two points, the program
- * forks and starts 2 child processes, which execute the program recursivly using execlp.
- *  The parent-child-communication is implemented through
- * pipes, where the child processes stdin and stdout are redirected.
- *  The parent process then writes into each reading-pipe of the childs:
- * - if x <= mean(x) of a specific point, the first child process handles the point
- * - otherwise the second child handles the process.
- * The child processes then repeat these steps.
- * After that each parent process waits for his child's to finish.
- * If they are finished, it reads the closest point of each part (first/second child) and
- * calculates a third pair: the closest pair between the 2 parts.
- * After that the pair with the closest distance is written to stdout (so parents can read it or for the first 
- * parent to actually print it).
-  **/
-
-#include "cpair.h"
-
-/**
- * @brief reads the solution of the part proccessed by a specific child
- * @details reads from the according pipe-end and closes them afterwards.
- * The result of each child is saved in the passed p_pair struct.
- * @param child an integer marking the correct pipe: only 2 values 
- * are allowed: CHILD1_WRITE or CHILD2_WRITE @see cpair.h
- * All other values will make undefined behavior.
- * @param child_index an integer which specifices the index in point_sizes: 
- * should only be 1 or 2 (first/second child), all other values will bring undefined behavior.
- * @param pipes holding the file-descriptor of the pipes.
- * @param p_pair pointer to the point-pair (including the distance between them) where the solution should be stored
- * @param point_counts array holding 3 entries: 
- * [0] -> amount of points of the parent process
- * [1] -> amount of points of first child process
- * [2] -> amount of points of second child process
- * @return 0 on success, -1 if a failure occured.
- **/
-static int read_from_child(int child, int child_index, int pipes[4][2], p_pair *p_pair, int point_counts[3]);
-
-/**
- * @brief reads from the child processes, computes the closest pair between their points,
- * compares them and writes the closest pair to stdout.
- * @details waits for the child processes to finish and afterwards read their particular solution of their part.
- * After that, P3, the closest pair of points between the two parts is calculated.
- * Finally, the 3 solutions, closest pair of first-child, closest pair of second point and 
- * closest point between their points are compared and the pair with the shortest distance
- * is written to stdout.
- * @param pid_child1 process id of the first child
- * @param pid_child2 process id of the second child
- * @param total_points pointer to the total points known by the parent
- * @param points_child1 pointer to the points of the first child
- * @param points_child2 pointer to the points of the second child
- * @param point_counts array holding 3 entries: 
- * [0] -> amount of points of the parent process
- * [1] -> amount of points of first child process
- * [2] -> amount of points of second child process
- * @param pipes holding the file-descriptors of the pipes.
- * @return 0 on success, -1 if an error occured.
- **/
-static int read_and_compute(pid_t pid_child1, pid_t pid_child2, point *total_points, point *points_child1, point *points_child2,
-                            int point_counts[3], int pipes[4][2]);
-
-/**
- * @brief read all points from stdin (might be redirected)
- * @details reads all points and store them into the pointer. Updates array values
- * and calculates the mean over all x values.
- * @param total_points pointer to a pointer of points where the points should be stored.
- * Pointer to pointer is needed here, so realloc can be used in the function
- * @param point_counts array holding 3 entries: 
- * [0] -> amount of points of the parent process (will be updated)
- * [1] -> amount of points of first child process
- * [2] -> amount of points of second child process
- * @param point_sizes array holding 3 entries: 
- * [0] -> size of points able to hold in pointer of the parent process (will be updated)
- * [1] -> size of points able to hold in pointer of first child process
- * [2] -> size of points able to hold in pointer of second child process
- * @param mean pointer to a float, where the mean should be stored. Will hold the calculated mean
- * after method  execution.
- * @return 0 on success, -1 on failure
- **/
-static int read_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean);
-
-/**
- * @brief function is used to write points to child processes as parent process using pipes.
- * @details parent writes to the according pipe ends in the following manner:
- * - if x <= mean(x) the point x is written to the first childs pipe
- * - otherwise the point x is written to the second childs pipe.
- * In according pointers, the points of each child are stored additionaly in the parent process.
- * (needed for futher computation)
- * @param total_points pointer to the total points
- * @param points_child1 pointer to a pointer of points, which is used to store the points of the first child.
- * Pointer to pointer is necessary here, so realloc can be peformed inside the function.
- * @param points_child1 pointer to a pointer of points, which is used to store the points of the second child.
- * Pointer to pointer is necessary here, so realloc can be peformed inside the function.
- * @param point_counts array holding 3 entries: 
- * [0] -> amount of points of the parent process
- * [1] -> amount of points of first child process
- * [2] -> amount of points of second child process
- * @param point_sizes array holding 3 entries: 
- * [0] -> size of points able to hold in pointer of the parent process
- * [1] -> size of points able to hold in pointer of first child process
- * [2] -> size of points able to hold in pointer of second child process
- * @param pipes holding the file-descriptors of all points
- * @param mean the mean over all x values in total_points
- * @return 0 on success, -1 in case of failure
- **/
-static int parent_write(point *total_points, point **points_child1, point **points_child2,
-                        int point_counts[3], int point_sizes[3], int pipes[4][2], float mean);
-
-/**
- * @brief setups pipes
- * @details setups 4 pipes:
- * - pipe where child1 reads from, parent writes to
- * - pipe where child2 reads from, parent writes to
- * - pipe where child1 writes to, parent reads from
- * - pipe where child2 writes to, parent reads from
- * @param pipes 2D array where the pipe filedescritors are stored.
- * @return 0 on success, -1 on failure
- **/
-static int setup_pipes(int pipes[4][2]);
-
-/**
- * @brief closes pipes for child-processes and duplicates file descriptors.
- * @details following pipes are closed:
- * - write-end of read pipe for both children, because only parents write to them
- * - read-end of write pipe for both children, because only parents read from them
- * file-descriptors are duplicated:
- * - read-end of read pipe for child is replaced by stdin-fd, so the child reads from the pipe, not stdin.
- * - write-end of write pipe for child is replaced by stdout-fd, so the child writes to the pipe, not stdout.
- * Afterwards, the old fds are closed.
- * @param pipes holding the file-descriptors of the pipes.
- * @param child indicating which child performs the operation. 
- * Only CHILD1_READ and CHILD2_READ @see cpari.h are valid options, all other
- * will indicate undefined behavior.
- * @return 0 on success, -1 in case of an failure.
- **/
-static int dup_close_child(int pipes[4][2], int child);
-
-/**
- * @brief closes unnedded pipes for parent proccess.
- * @details following pipe-ends are closed:
- * - read-end of pipe from which child1 reads, and parent writes
- * - read-end of pipe from which child2 reads, and parent writes
- * - write-end of pipe to which child1 writes, and parent reads
- * - write-end of pipe from which child2 writes, and parent reads
- * @param pipes holding the file-descritors of the pipes
- * @return 0 on succcess, -1 in case of failure
- **/
-static int close_pipes_parent(int pipes[4][2]);
-
-/**
- * @brief checks if a given string is a valid point as specified.
- * @details checks if using regular expressions (line of 2 floating point numbers, seperated by whitespace)
- * @param str to be checked
- * @return true, if the point is valid, otherwise false
- **/
-static bool is_valid_point(const char *str);
-
-/**
- * @brief parses a string into an point struct
- * @details parses the string specified in input to a point.
- * Function should only be called, if is_valid_point has been called onto the same string in advance,
- * otherwise undefined behavior might occur.
- * @param input which should be parsed
- * @return point holding the x and y coordinate of the point
- **/
-static point string_to_point(char *input);
-
-/**
- * @brief calculates the distance between 2 points.
- * @details calculates using the pythagorean theorem: sqrt((x2-x1)^2 + (y2-y1)^2)
- * @param p1 first point
- * @param p2 second point
- * @returns the distancce between the 2 given points
- **/
-static float dist(point p1, point p2);
-
-/**
- * @brief compute the closest pair between the 2 parts processed by the childs.
- * @details computes the closest pair between 2 parts (mentioned in the assignment as "P3").
- * Iterates through all points of first part and compares them to the second part, if a better 
- * solution is found, the actual return value is overwritten.
- * @param child1_points pointer which points to the points of the first child (first part)
- * @param child2_points pointer which points to the points of the second child (second part)
- * @param point_counts array holding 3 entries: 
- * [0] -> amount of points of the parent process
- * [1] -> amount of points of first child process
- * [2] -> amount of points of second child process
- * @return p_pair containing the closest pair of points between the 2 parts and the distance between them.
- **/
-static p_pair compute_closest_pair(point *child1_points, point *child2_points, int point_counts[3]);
-
-/**
- * @brief frees pointer-resources
- * @details frees all passed parameters using free(), if they are not NULL
- * @param p1 pointer to points which should be freed
- * @param p2 pointer to points which should be freed
- * @param p3 pointer to points which should be freed
- **/
-static void clean_up(point *p1, point *p2, point *p3);
-
-/**
- * @brief prints the usage message of the program.
- * @details format: [USAGE:] PROGRAM_NAME
- **/
-static void usage(void);
-
-/**
- * @brief writes an error message and exits the program.
- * @details the error message should contain a proper message explaining the error.
- * If errno is set, the specific reason explaining errno will also be printed.
- * Exits with exit-code 1.
- * @param error_message holding the reason for the failure.
- **/
-static void error(char *error_message);
-
-static char *PROGRAM_NAME; //name of the program, argv[0]
-
-/**
- * @brief starting point of the program.
- * @details defines used structs, arrays and variables:
- *  - total_points: holding all points handled by the process
- *  - child1_points: holding all points of the first child process
- *  - child2_points: holding all points of the first child process
- *  - point_counts: array holding 3 entries: 
- *      [0] -> amount of points of the parent process
- *      [1] -> amount of points of first child process
- *      [2] -> amount of points of second child process
- *  - point_sizes: array holding 3 entries: 
- *      [0] -> size of points able to hold in pointer of the parent process
- *      [1] -> size of points able to hold in pointer of first child process
- *      [2] -> size of points able to hold in pointer of second child process
- *  - mean: mean over all x values.
- * After reading input, fork will be called to start 2 child programs, which will
- * recursivly execute the program. 
- * Calls according methods for parent/child processes.
- * @param argc argument counter, should only be 1
- * @param argv argument vector, should only hold program name
- * @return 0 on success, -1 if a failure occured.
- **/
-int main(int argc, char *argv[])
-{
-    PROGRAM_NAME = argv[0];
-    if (argc != 1)
-        usage();
-
-    int point_counts[3] = {0, 0, 0};
-    int point_sizes[3] = {4, 2, 2}; // init pointers with size 4/2/2
-    point *total_points = malloc(sizeof(point) * point_sizes[0]);
-    point *child1_points = malloc(sizeof(point) * point_sizes[1]);
-    point *child2_points = malloc(sizeof(point) * point_sizes[2]);
-    float mean = 0;
-    if (total_points == NULL || child1_points == NULL || child2_points == NULL)
-    {
-        clean_up(total_points, child1_points, child2_points);
-        error("memory allocation failed!");
-    }
-
-    if (read_input(&total_points, point_counts, point_sizes, &mean) == -1)
-    {
-        clean_up(total_points, child1_points, child2_points);
-        error("failed to read input ");
-    }
-    if (point_counts[0] <= 1) // only one epoint
-    {
-        clean_up(total_points, child1_points, child2_points);
-        exit(EXIT_SUCCESS);
-    }
-    else if (point_counts[0] == 2) // two points
-    {
-        fprintf(stdout, "%f %f\n%f %f\n", total_points[0].x, total_points[0].y, total_points[1].x, total_points[1].y);
-        fflush(stdout);
-        clean_up(total_points, child1_points, child2_points);
-        exit(EXIT_SUCCESS);
-    }
-    else // > 2 points
-    {
-        pid_t pid_child1, pid_child2;
-        int pipes[4][2];
-        if (setup_pipes(pipes) == -1)
-        {
-            clean_up(total_points, child1_points, child2_points);
-            error("failed to setup pipes");
-        }
-
-        switch (pid_child1 = fork())
-        {
-        case -1:
-            clean_up(total_points, child1_points, child2_points);
-            error("fork failed");
-            break;
-        case 0:
-            if (dup_close_child(pipes, CHILD1_READ) == -1)
-            {
-                clean_up(total_points, child1_points, child2_points);
-                error("failed to dup and/or close pipes!");
-            }
-            if (execlp(PROGRAM_NAME, PROGRAM_NAME, NULL) == -1)
-            {
-                clean_up(total_points, child1_points, child2_points);
-                error("execlp failed!");
-            }
-            break;
-
-        default:
-            switch (pid_child2 = fork())
-            {
-            case -1:
-                clean_up(total_points, child1_points, child2_points);
-                error("fork failed");
-                break;
-            case 0:
-                if (dup_close_child(pipes, CHILD2_READ) == -1)
-                {
-                    clean_up(total_points, child1_points, child2_points);
-                    error("failed to dup and/or close pipes!");
-                }
-                if (execlp(PROGRAM_NAME, PROGRAM_NAME, NULL) == -1)
-                {
-                    clean_up(total_points, child1_points, child2_points);
-                    error("execlp failed!");
-                }
-                break;
-            default:
-                if (close_pipes_parent(pipes) == -1)
-                {
-                    clean_up(total_points, child1_points, child2_points);
-                    error("failed to close pipes for parent!");
-                }
-                if (parent_write(total_points, &child1_points, &child2_points, point_counts, point_sizes, pipes, mean) == -1)
-                {
-                    clean_up(total_points, child1_points, child2_points);
-                    error("failed to write to child-pipes!");
-                }
-                if (read_and_compute(pid_child1, pid_child2, total_points, child1_points, child2_points, point_counts, pipes) == -1)
-                {
-                    clean_up(total_points, child1_points, child2_points);
-                    error("failed to read from childs");
-                }
-
-                break;
-            }
-            break;
-        }
-    }
-    clean_up(total_points, child1_points, child2_points);
-    exit(EXIT_SUCCESS);
-}
-
-/**************************************************READ-PARENT********************************************/
-static int read_from_child(int child, int child_index, int pipes[4][2], p_pair *p_pair, int point_counts[3])
-{
-    FILE *fchild = fdopen(pipes[child][READ], "r");
-    if (fchild == NULL)
-        return -1;
-
-    char *line = NULL;
-    size_t n = 0;
-    ssize_t result;
-    if (point_counts[child_index] >= 1)
-    {
-        if ((result = getline(&line, &n, fchild)) != -1)
-        {
-            point p = string_to_point(line);
-            p_pair->p1.x = p.x;
-            p_pair->p1.y = p.y;
-        }
-    }
-    if (point_counts[child_index] >= 2) // atleast 2 points are needed to get a valid solution
-    {
-
-        if ((result = getline(&line, &n, fchild)) != -1)
-        {
-            point p = string_to_point(line);
-            p_pair->p2.x = p.x;
-            p_pair->p2.y = p.y;
-        }
-        p_pair->dist = dist(p_pair->p1, p_pair->p2);
-    }
-    free(line);
-    if (ferror(fchild) < 0 || fclose(fchild) < 0)
-        return -1;
-    return 0;
-}
-
-static int read_and_compute(pid_t pid_child1, pid_t pid_child2,
-                            point *total_points, point *points_child1, point *points_child2,
-                            int point_counts[3], int pipes[4][2])
-{
-    int state;
-    while (waitpid(pid_child1, &state, 0) < 0)
-    {
-        if (errno == EINTR) // interrupted
-            continue;
-        return -1;
-    }
-
-    if (WEXITSTATUS(state) != EXIT_SUCCESS) // first child failed
-        return -1;
-
-    while (waitpid(pid_child2, &state, 0) < 0)
-    {
-        if (errno == EINTR) // interrupted
-            continue;
-        return -1;
-    }
-    if (WEXITSTATUS(state) != EXIT_SUCCESS) // second child failed
-        return -1;
-
-    p_pair ppair1 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
-    p_pair ppair2 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
-    p_pair ppair3 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
-
-    if (read_from_child(CHILD1_WRITE, 1, pipes, &ppair1, point_counts) < 0)
-        return -1;
-
-    if (read_from_child(CHILD2_WRITE, 2, pipes, &ppair2, point_counts) < 0)
-        return -1;
-
-    ppair3 = compute_closest_pair(points_child1, points_child2, point_counts);
-
-    if ((ppair1.dist < ppair2.dist) && (ppair1.dist < ppair3.dist))
-        fprintf(stdout, "%f %f\n%f %f\n", ppair1.p1.x, ppair1.p1.y, ppair1.p2.x, ppair1.p2.y);
-
-    else
-    {
-        if (ppair2.dist < ppair3.dist)
-            fprintf(stdout, "%f %f\n%f %f\n", ppair2.p1.x, ppair2.p1.y, ppair2.p2.x, ppair2.p2.y);
-        else
-            fprintf(stdout, "%f %f\n%f %f\n", ppair3.p1.x, ppair3.p1.y, ppair3.p2.x, ppair3.p2.y);
-    }
-    fflush(stdout);
-    return 0;
-}
-
-/***************************************PARENT-WRITE***********************************************/
-static int parent_write(point *total_points, point **points_child1, point **points_child2,
-                        int point_counts[3], int point_sizes[3], int pipes[4][2], float mean)
-{
-    FILE *f_child1 = fdopen(pipes[CHILD1_READ][WRITE], "a");
-    FILE *f_child2 = fdopen(pipes[CHILD2_READ][WRITE], "a");
-    for (size_t i = 0; i < point_counts[0]; i++)
-    {
-        point actual = total_points[i];
-        int needed_space = (snprintf(NULL, 0, "%f %f\n", actual.x, actual.y)) + 1; //size needed for buffer
-        char *buffer = malloc(needed_space);
-        if (buffer == NULL)
-            return -1;
-        snprintf(buffer, needed_space, "%f %f\n", actual.x, actual.y);
-
-        if (actual.x <= mean) // write to first child
-        {
-            point_counts[1]++;
-            if (point_counts[1] >= point_sizes[1]) // realloc necessary
-            {
-                point_sizes[1] *= 2;
-                if (((*points_child1) = realloc((*points_child1), (sizeof(point) * point_sizes[1]))) == NULL)
-                {
-                    free(buffer);
-                    return -1;
-                }
-            }
-            if (fprintf(f_child1, "%s", buffer) < 0) // write into pipe
-            {
-                free(buffer);
-                return -1;
-            }
-            (*points_child1)[point_counts[1] - 1] = actual; // store  point
-        }
-        else // write to second child
-        {
-            point_counts[2]++;
-            if (point_counts[2] >= point_sizes[2]) // realloc necessary
-            {
-                point_sizes[2] *= 2;
-                if (((*points_child2) = realloc((*points_child2), (sizeof(point) * point_sizes[2]))) == NULL)
-                {
-                    free(buffer);
-                    return -1;
-                }
-            }
-            if (fprintf(f_child2, "%s", buffer) < 0) // write into pipe
-            {
-                free(buffer);
-                return -1;
-            }
-            (*points_child2)[point_counts[2] - 1] = actual; // store point
-        }
-        free(buffer);
-    }
-
-    if (ferror(f_child1) || ferror(f_child2))
-        return -1;
-
-    if (fclose(f_child1) < 0 || fclose(f_child2) < 0) // closing write end of pipes
-        return -1;
-    return 0;
-}
-/*********************************************PIPE-SETUP***********************************************/
-static int close_pipes_parent(int pipes[4][2])
-{
-    if (close(pipes[CHILD1_READ][READ]) == -1)
-        return -1;
-    if (close(pipes[CHILD1_WRITE][WRITE]) == -1)
-        return -1;
-    if (close(pipes[CHILD2_READ][READ]) == -1)
-        return -1;
-    if (close(pipes[CHILD2_WRITE][WRITE]) == -1)
-        return -1;
-    return 0;
-}
-
-static int dup_close_child(int pipes[4][2], int child)
-{
-    if (close(pipes[CHILD1_READ][WRITE]) != 0)
-        return -1;
-    if (close(pipes[CHILD2_READ][WRITE]) != 0)
-        return -1;
-    if (close(pipes[CHILD1_WRITE][READ]) != 0)
-        return -1;
-    if (close(pipes[CHILD2_WRITE][READ]) != 0)
-        return -1;
-    if (close(pipes[child == 0 ? 2 : 0][READ]) != 0)
-        return -1;
-    if (close(pipes[child == 0 ? 3 : 1][WRITE]) != 0)
-        return -1;
-    if ((dup2(pipes[child][READ], STDIN_FILENO)) < 0)
-        return -1;
-    if ((dup2(pipes[child + 1][WRITE], STDOUT_FILENO)) < 0)
-        return -1;
-    if (close(pipes[child][READ]) != 0)
-        return -1;
-    if (close(pipes[child + 1][WRITE]) != 0)
-        return -1;
-    return 0;
-}
-
-static int setup_pipes(int pipes[4][2])
-{
-    if (pipe(pipes[CHILD1_READ]) == -1)
-        return -1;
-    if (pipe(pipes[CHILD1_WRITE]) == -1)
-        return -1;
-    if (pipe(pipes[CHILD2_READ]) == -1)
-        return -1;
-    if (pipe(pipes[CHILD2_WRITE]) == -1)
-        return -1;
-    return 0;
-}
-
-/****************************************INPUT-READ*********************************************************/
-static int read_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean)
-{
-    char *line = NULL;
-    size_t n = 0;
-    ssize_t result;
-    while ((result = getline(&line, &n, stdin)) != -1)
-    {
-        if (!is_valid_point(line))
-        {
-            free(line);
-            return -1;
-        }
-        point p = string_to_point(line);
-        point_counts[0]++;
-        if (point_counts[0] >= point_sizes[0]) //pointer is to small -> realloc needed
-        {
-            point_sizes[0] *= 2;
-            if (((*total_points) = realloc((*total_points), (sizeof(point) * point_sizes[0]))) == NULL)
-            {
-                free(line);
-                return -1;
-            }
-        }
-        (*total_points)[point_counts[0] - 1] = p;
-        (*mean) += (*total_points)[point_counts[0] - 1].x;
-    }
-    free(line);
-    (*mean) /= point_counts[0];
-    return 0;
-}
-
-/***********************************UTIL*****************************************************/
-static p_pair compute_closest_pair(point *child1_points, point *child2_points, int point_counts[3])
-{
-    p_pair ppair3 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
-
-    for (size_t i = 0; i < point_counts[1]; i++)
-    {
-        point temp1 = child1_points[i];
-        for (size_t j = 0; j < point_counts[2]; j++)
-        {
-            point temp2 = child2_points[j];
-            float new_dist = dist(temp1, temp2);
-            if (new_dist <= ppair3.dist) // better solution found
-            {
-                ppair3.p1 = temp1;
-                ppair3.p2 = temp2;
-                ppair3.dist = new_dist;
-            }
-        }
-    }
-    return ppair3;
-}
-
-static float dist(point p1, point p2)
-{
-    return sqrt((pow(p2.x - p1.x, 2) + pow(p2.y - p1.y, 2)));
-}
-
-static point string_to_point(char *input)
-{
-    // no error handling, checked in advance
-    point p;
-    input = strtok(input, " ");
-    p.x = strtof(input, NULL);
-    input = strtok(NULL, " ");
-    p.y = strtof(input, NULL);
-    return p;
-}
-
-static bool is_valid_point(const char *str)
-{
-    regex_t regex;
-    int return_val;
-    if (regcomp(&regex, "^[-+]?[0-9]*.?[0-9]+ [-+]?[0-9]*.?[0-9]+(\n)?$", REG_EXTENDED) != 0)
-    {
-        return false;
-    }
-    return_val = regexec(&regex, str, (size_t)0, NULL, 0);
-    regfree(&regex);
-    return return_val == 0;
-}
-
-static void clean_up(point *p1, point *p2, point *p3)
-{
-    if (p1 != NULL)
-        free(p1);
-    if (p2 != NULL)
-        free(p2);
-    if (p3 != NULL)
-        free(p3);
-}
-
-static void error(char *error_message)
-{
-    if (errno != 0)
-        fprintf(stderr, "[%s] ERROR: %s: %s.\n", PROGRAM_NAME, error_message, strerror(errno));
-    else
-        fprintf(stderr, "[%s] ERROR: %s.\n", PROGRAM_NAME, error_message);
-    exit(EXIT_FAILURE);
-}
-
-static void usage(void)
-{
-    fprintf(stderr, "Usage: %s\n", PROGRAM_NAME);
-    exit(EXIT_FAILURE);
-}
+/**
+ * @file cpair.c
+ * @author briemelchen
+ * @date 28.11.2020
+ * @brief program which computes the closest pair of points in a given array of points.
+ * @details the program reads the input line by line from stdin, where each line holds an point
+ * x y whitespace seperated. After reading, if their are more then two points, the program
+ * forks and starts 2 child processes, which execute the program recursivly using execlp.
+ *  The parent-child-communication is implemented through
+ * pipes, where the child processes stdin and stdout are redirected.
+ *  The parent process then writes into each reading-pipe of the childs:
+ * - if x <= mean(x) of a specific point, the first child process handles the point
+ * - otherwise the second child handles the process.
+ * The child processes then repeat these steps.
+ * After that each parent process waits for his child's to finish.
+ * If they are finished, it reads the closest point of each part (first/second child) and
+ * calculates a third pair: the closest pair between the 2 parts.
+ * The points are sorted by y (only by the first process, as the points are written to the children
+ * in their order), so the third pair is found in the strip around the mean by comparing each point 
+ * with at most 7 following points.
+ * After that the pair with the closest distance is written to stdout (so parents can read it or for the first 
+ * parent to actually print it).
+  **/
+
+#include "cpair.h"
+
+/**
+ * @brief reads the solution of the part proccessed by a specific child
+ * @details reads from the according pipe-end and closes them afterwards.
+ * The result of each child is saved in the passed p_pair struct.
+ * @param child an integer marking the correct pipe: only 2 values 
+ * are allowed: CHILD1_WRITE or CHILD2_WRITE @see cpair.h
+ * All other values will make undefined behavior.
+ * @param child_index an integer which specifices the index in point_sizes: 
+ * should only be 1 or 2 (first/second child), all other values will bring undefined behavior.
+ * @param pipes holding the file-descriptor of the pipes.
+ * @param p_pair pointer to the point-pair (including the distance between them) where the solution should be stored
+ * @param point_counts array holding 3 entries: 
+ * [0] -> amount of points of the parent process
+ * [1] -> amount of points of first child process
+ * [2] -> amount of points of second child process
+ * @return 0 on success, -1 if a failure occured.
+ **/
+static int read_from_child(int child, int child_index, int pipes[4][2], p_pair *p_pair, int point_counts[3]);
+
+/**
+ * @brief reads from the child processes, computes the closest pair between their points,
+ * compares them and writes the closest pair to stdout.
+ * @details waits for the child processes to finish and afterwards read their particular solution of their part.
+ * After that, P3, the closest pair of points between the two parts is calculated.
+ * Finally, the 3 solutions, closest pair of first-child, closest pair of second point and 
+ * closest point between their points are compared and the pair with the shortest distance
+ * is written to stdout.
+ * @param pid_child1 process id of the first child
+ * @param pid_child2 process id of the second child
+ * @param total_points pointer to the total points known by the parent
+ * @param points_child1 pointer to the points of the first child
+ * @param points_child2 pointer to the points of the second child
+ * @param point_counts array holding 3 entries: 
+ * [0] -> amount of points of the parent process
+ * [1] -> amount of points of first child process
+ * [2] -> amount of points of second child process
+ * @param pipes holding the file-descriptors of the pipes.
+ * @param mean the mean over all x values in total_points
+ * @return 0 on success, -1 if an error occured.
+ **/
+static int read_and_compute(pid_t pid_child1, pid_t pid_child2, point *total_points, point *points_child1, point *points_child2,
+                            int point_counts[3], int pipes[4][2], float mean);
+
+/**
+ * @brief read all points from stdin (might be redirected)
+ * @details reads all points and store them into the pointer. Updates array values
+ * and calculates the mean over all x values.
+ * @param total_points pointer to a pointer of points where the points should be stored.
+ * Pointer to pointer is needed here, so realloc can be used in the function
+ * @param point_counts array holding 3 entries: 
+ * [0] -> amount of points of the parent process (will be updated)
+ * [1] -> amount of points of first child process
+ * [2] -> amount of points of second child process
+ * @param point_sizes array holding 3 entries: 
+ * [0] -> size of points able to hold in pointer of the parent process (will be updated)
+ * [1] -> size of points able to hold in pointer of first child process
+ * [2] -> size of points able to hold in pointer of second child process
+ * @param mean pointer to a float, where the mean should be stored. Will hold the calculated mean
+ * after method  execution.
+ * @return 0 on success, -1 on failure
+ **/
+static int read_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean);
+
+/**
+ * @brief function is used to write points to child processes as parent process using pipes.
+ * @details parent writes to the according pipe ends in the following manner:
+ * - if x <= mean(x) the point x is written to the first childs pipe
+ * - otherwise the point x is written to the second childs pipe.
+ * In according pointers, the points of each child are stored additionaly in the parent process.
+ * (needed for futher computation)
+ * @param total_points pointer to the total points
+ * @param points_child1 pointer to a pointer of points, which is used to store the points of the first child.
+ * Pointer to pointer is necessary here, so realloc can be peformed inside the function.
+ * @param points_child1 pointer to a pointer of points, which is used to store the points of the second child.
+ * Pointer to pointer is necessary here, so realloc can be peformed inside the function.
+ * @param point_counts array holding 3 entries: 
+ * [0] -> amount of points of the parent process
+ * [1] -> amount of points of first child process
+ * [2] -> amount of points of second child process
+ * @param point_sizes array holding 3 entries: 
+ * [0] -> size of points able to hold in pointer of the parent process
+ * [1] -> size of points able to hold in pointer of first child process
+ * [2] -> size of points able to hold in pointer of second child process
+ * @param pipes holding the file-descriptors of all points
+ * @param mean the mean over all x values in total_points
+ * @return 0 on success, -1 in case of failure
+ **/
+static int parent_write(point *total_points, point **points_child1, point **points_child2,
+                        int point_counts[3], int point_sizes[3], int pipes[4][2], float mean);
+
+/**
+ * @brief setups pipes
+ * @details setups 4 pipes:
+ * - pipe where child1 reads from, parent writes to
+ * - pipe where child2 reads from, parent writes to
+ * - pipe where child1 writes to, parent reads from
+ * - pipe where child2 writes to, parent reads from
+ * @param pipes 2D array where the pipe filedescritors are stored.
+ * @return 0 on success, -1 on failure
+ **/
+static int setup_pipes(int pipes[4][2]);
+
+/**
+ * @brief closes pipes for child-processes and duplicates file descriptors.
+ * @details following pipes are closed:
+ * - write-end of read pipe for both children, because only parents write to them
+ * - read-end of write pipe for both children, because only parents read from them
+ * file-descriptors are duplicated:
+ * - read-end of read pipe for child is replaced by stdin-fd, so the child reads from the pipe, not stdin.
+ * - write-end of write pipe for child is replaced by stdout-fd, so the child writes to the pipe, not stdout.
+ * Afterwards, the old fds are closed.
+ * @param pipes holding the file-descriptors of the pipes.
+ * @param child indicating which child performs the operation. 
+ * Only CHILD1_READ and CHILD2_READ @see cpari.h are valid options, all other
+ * will indicate undefined behavior.
+ * @return 0 on success, -1 in case of an failure.
+ **/
+static int dup_close_child(int pipes[4][2], int child);
+
+/**
+ * @brief closes unnedded pipes for parent proccess.
+ * @details following pipe-ends are closed:
+ * - read-end of pipe from which child1 reads, and parent writes
+ * - read-end of pipe from which child2 reads, and parent writes
+ * - write-end of pipe to which child1 writes, and parent reads
+ * - write-end of pipe from which child2 writes, and parent reads
+ * @param pipes holding the file-descritors of the pipes
+ * @return 0 on succcess, -1 in case of failure
+ **/
+static int close_pipes_parent(int pipes[4][2]);
+
+/**
+ * @brief scans a line of the input into a point.
+ * @details checks by hand if the line holds 2 floating point numbers ([-+]?[0-9]*.?[0-9]+),
+ * seperated by whitespace, and parses them with strtof.
+ * @param line beginning of the line, the character at end must be writable (it is temporarily
+ * replaced by '\0', so strtof stops there)
+ * @param end end of the line (newline or end of the input)
+ * @param p pointer to the point where the result should be stored
+ * @return 0 if the line is valid, otherwise -1
+ **/
+static int scan_point(char *line, char *end, point *p);
+
+/**
+ * @brief maps binary input from stdin (packed float x, float y pairs).
+ * @details regular files are mapped privately with mmap (the points are sorted in place without changing
+ * the file), pipes are read in blocks of READ_BLOCK_SIZE bytes. Calculates the mean over all x values.
+ * @param total_points pointer to a pointer of points, which will point to the mapped points.
+ * @param point_counts array holding 3 entries: [0] -> amount of points of the parent process (will be updated)
+ * @param point_sizes array holding 3 entries: [0] -> size of points able to hold (will be updated)
+ * @param mean pointer to a float, where the mean should be stored.
+ * @return 0 on success, -1 on failure
+ **/
+static int map_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean);
+
+/**
+ * @brief parses a string into an point struct
+ * @details parses the string specified in input to a point.
+ * Function should only be called, if is_valid_point has been called onto the same string in advance,
+ * otherwise undefined behavior might occur.
+ * @param input which should be parsed
+ * @return point holding the x and y coordinate of the point
+ **/
+static point string_to_point(char *input);
+
+/**
+ * @brief calculates the squared distance between 2 points.
+ * @details calculates using the pythagorean theorem without the square root: (x2-x1)^2 + (y2-y1)^2,
+ * which compares the same as the distance itself.
+ * @param p1 first point
+ * @param p2 second point
+ * @returns the squared distance between the 2 given points
+ **/
+static float sq_dist(point p1, point p2);
+
+/**
+ * @brief finds the closest pair of a strip given as separate x and y arrays.
+ * @details the points are sorted by y, each point is compared to the following points until one is
+ * at least the current best distance above it. Only pairs closer than best count, of equally close
+ * pairs the first one is kept. Chooses a kernel at runtime: AVX2 (8 points at once) if the CPU supports it,
+ * NEON (4 points) on aarch64, otherwise one point at a time. All kernels find the same pair.
+ * @param x the x-coordinates of the strip
+ * @param y the y-coordinates of the strip (sorted)
+ * @param count amount of points of the strip
+ * @param best the squared distance a pair must be closer than
+ * @param pair the indices of the closest pair, only written if one is closer than best
+ * @returns the squared distance of the closest pair, best if there is none
+ **/
+static float strip_closest_pair(const float *x, const float *y, size_t count, float best, size_t pair[2]);
+
+/**
+ * @brief compute the closest pair between the 2 parts processed by the childs.
+ * @details computes the closest pair between 2 parts (mentioned in the assignment as "P3").
+ * Only points closer than delta (the best distance of the childs) to the mean can be part of a better pair.
+ * The strip of these points is sorted by y like the total points, so each point is only compared to the
+ * following points which are less than delta above it (at most 7), if a better solution is found,
+ * the actual solution is overwritten. The strip is stored as separate x and y arrays for strip_closest_pair
+ * and all distances are squared.
+ * @param total_points pointer to the total points (sorted by y)
+ * @param point_counts array holding 3 entries: 
+ * [0] -> amount of points of the parent process
+ * [1] -> amount of points of first child process
+ * [2] -> amount of points of second child process
+ * @param mean the mean over all x values in total_points
+ * @param delta the shortest squared distance found by the childs
+ * @param ppair3 pointer to the p_pair where the closest pair of points between the 2 parts and the distance 
+ * between them should be stored.
+ * @return 0 on success, -1 if a failure occured.
+ **/
+static int compute_closest_pair(point *total_points, int point_counts[3], float mean, float delta, p_pair *ppair3);
+
+/**
+ * @brief sorts the points by y, if they are not sorted already.
+ * @details uses qsort with compare_y.
+ * @param points pointer to the points
+ * @param count amount of points
+ **/
+static void sort_by_y(point *points, int count);
+
+/**
+ * @brief compares two points by their y-coordinate (for qsort)
+ * @param a pointer to the first point
+ * @param b pointer to the second point
+ * @return negative, zero or positive if the first point's y is smaller, equal or larger
+ **/
+static int compare_y(const void *a, const void *b);
+
+/**
+ * @brief frees pointer-resources
+ * @details frees all passed parameters using free(), if they are not NULL
+ * (points mapped by map_input are unmapped instead)
+ * @param p1 pointer to points which should be freed
+ * @param p2 pointer to points which should be freed
+ * @param p3 pointer to points which should be freed
+ **/
+static void clean_up(point *p1, point *p2, point *p3);
+
+/**
+ * @brief prints the usage message of the program.
+ * @details format: [USAGE:] PROGRAM_NAME [-b]
+ **/
+static void usage(void);
+
+/**
+ * @brief writes an error message and exits the program.
+ * @details the error message should contain a proper message explaining the error.
+ * If errno is set, the specific reason explaining errno will also be printed.
+ * Exits with exit-code 1.
+ * @param error_message holding the reason for the failure.
+ **/
+static void error(char *error_message);
+
+static char *PROGRAM_NAME; //name of the program, argv[0]
+static point *mapped_points = NULL; // points mapped by map_input, NULL if not mapped
+static size_t mapped_size = 0;      // size of the mapping of mapped_points in bytes
+
+/**
+ * @brief starting point of the program.
+ * @details defines used structs, arrays and variables:
+ *  - total_points: holding all points handled by the process
+ *  - child1_points: holding all points of the first child process
+ *  - child2_points: holding all points of the first child process
+ *  - point_counts: array holding 3 entries: 
+ *      [0] -> amount of points of the parent process
+ *      [1] -> amount of points of first child process
+ *      [2] -> amount of points of second child process
+ *  - point_sizes: array holding 3 entries: 
+ *      [0] -> size of points able to hold in pointer of the parent process
+ *      [1] -> size of points able to hold in pointer of first child process
+ *      [2] -> size of points able to hold in pointer of second child process
+ *  - mean: mean over all x values.
+ * After reading input, fork will be called to start 2 child programs, which will
+ * recursivly execute the program. 
+ * Calls according methods for parent/child processes.
+ * With -b stdin holds packed float x, float y pairs (the children still get text).
+ * @param argc argument counter, should only be 1 or 2
+ * @param argv argument vector, should only hold program name and optionally -b
+ * @return 0 on success, -1 if a failure occured.
+ **/
+int main(int argc, char *argv[])
+{
+    PROGRAM_NAME = argv[0];
+    bool binary = false;
+    int opt;
+    while ((opt = getopt(argc, argv, "b")) != -1)
+    {
+        if (opt == 'b')
+            binary = true;
+        else
+            usage();
+    }
+    if (optind != argc)
+        usage();
+
+    int point_counts[3] = {0, 0, 0};
+    int point_sizes[3] = {4, 2, 2}; // init pointers with size 4/2/2
+    point *total_points = malloc(sizeof(point) * point_sizes[0]);
+    point *child1_points = malloc(sizeof(point) * point_sizes[1]);
+    point *child2_points = malloc(sizeof(point) * point_sizes[2]);
+    float mean = 0;
+    if (total_points == NULL || child1_points == NULL || child2_points == NULL)
+    {
+        clean_up(total_points, child1_points, child2_points);
+        error("memory allocation failed!");
+    }
+
+    int read_result = binary ? map_input(&total_points, point_counts, point_sizes, &mean)
+                             : read_input(&total_points, point_counts, point_sizes, &mean);
+    if (read_result == -1)
+    {
+        clean_up(total_points, child1_points, child2_points);
+        error("failed to read input ");
+    }
+    sort_by_y(total_points, point_counts[0]);
+    if (point_counts[0] <= 1) // only one epoint
+    {
+        clean_up(total_points, child1_points, child2_points);
+        exit(EXIT_SUCCESS);
+    }
+    else if (point_counts[0] == 2) // two points
+    {
+        fprintf(stdout, "%f %f\n%f %f\n", total_points[0].x, total_points[0].y, total_points[1].x, total_points[1].y);
+        fflush(stdout);
+        clean_up(total_points, child1_points, child2_points);
+        exit(EXIT_SUCCESS);
+    }
+    else // > 2 points
+    {
+        pid_t pid_child1, pid_child2;
+        int pipes[4][2];
+        if (setup_pipes(pipes) == -1)
+        {
+            clean_up(total_points, child1_points, child2_points);
+            error("failed to setup pipes");
+        }
+
+        switch (pid_child1 = fork())
+        {
+        case -1:
+            clean_up(total_points, child1_points, child2_points);
+            error("fork failed");
+            break;
+        case 0:
+            if (dup_close_child(pipes, CHILD1_READ) == -1)
+            {
+                clean_up(total_points, child1_points, child2_points);
+                error("failed to dup and/or close pipes!");
+            }
+            if (execlp(PROGRAM_NAME, PROGRAM_NAME, NULL) == -1)
+            {
+                clean_up(total_points, child1_points, child2_points);
+                error("execlp failed!");
+            }
+            break;
+
+        default:
+            switch (pid_child2 = fork())
+            {
+            case -1:
+                clean_up(total_points, child1_points, child2_points);
+                error("fork failed");
+                break;
+            case 0:
+                if (dup_close_child(pipes, CHILD2_READ) == -1)
+                {
+                    clean_up(total_points, child1_points, child2_points);
+                    error("failed to dup and/or close pipes!");
+                }
+                if (execlp(PROGRAM_NAME, PROGRAM_NAME, NULL) == -1)
+                {
+                    clean_up(total_points, child1_points, child2_points);
+                    error("execlp failed!");
+                }
+                break;
+            default:
+                if (close_pipes_parent(pipes) == -1)
+                {
+                    clean_up(total_points, child1_points, child2_points);
+                    error("failed to close pipes for parent!");
+                }
+                if (parent_write(total_points, &child1_points, &child2_points, point_counts, point_sizes, pipes, mean) == -1)
+                {
+                    clean_up(total_points, child1_points, child2_points);
+                    error("failed to write to child-pipes!");
+                }
+                if (read_and_compute(pid_child1, pid_child2, total_points, child1_points, child2_points, point_counts, pipes, mean) == -1)
+                {
+                    clean_up(total_points, child1_points, child2_points);
+                    error("failed to read from childs");
+                }
+
+                break;
+            }
+            break;
+        }
+    }
+    clean_up(total_points, child1_points, child2_points);
+    exit(EXIT_SUCCESS);
+}
+
+/**************************************************READ-PARENT********************************************/
+static int read_from_child(int child, int child_index, int pipes[4][2], p_pair *p_pair, int point_counts[3])
+{
+    FILE *fchild = fdopen(pipes[child][READ], "r");
+    if (fchild == NULL)
+        return -1;
+
+    char *line = NULL;
+    size_t n = 0;
+    ssize_t result;
+    if (point_counts[child_index] >= 1)
+    {
+        if ((result = getline(&line, &n, fchild)) != -1)
+        {
+            point p = string_to_point(line);
+            p_pair->p1.x = p.x;
+            p_pair->p1.y = p.y;
+        }
+    }
+    if (point_counts[child_index] >= 2) // atleast 2 points are needed to get a valid solution
+    {
+
+        if ((result = getline(&line, &n, fchild)) != -1)
+        {
+            point p = string_to_point(line);
+            p_pair->p2.x = p.x;
+            p_pair->p2.y = p.y;
+        }
+        p_pair->dist = sq_dist(p_pair->p1, p_pair->p2);
+    }
+    free(line);
+    if (ferror(fchild) < 0 || fclose(fchild) < 0)
+        return -1;
+    return 0;
+}
+
+static int read_and_compute(pid_t pid_child1, pid_t pid_child2,
+                            point *total_points, point *points_child1, point *points_child2,
+                            int point_counts[3], int pipes[4][2], float mean)
+{
+    int state;
+    while (waitpid(pid_child1, &state, 0) < 0)
+    {
+        if (errno == EINTR) // interrupted
+            continue;
+        return -1;
+    }
+
+    if (WEXITSTATUS(state) != EXIT_SUCCESS) // first child failed
+        return -1;
+
+    while (waitpid(pid_child2, &state, 0) < 0)
+    {
+        if (errno == EINTR) // interrupted
+            continue;
+        return -1;
+    }
+    if (WEXITSTATUS(state) != EXIT_SUCCESS) // second child failed
+        return -1;
+
+    p_pair ppair1 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
+    p_pair ppair2 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
+    p_pair ppair3 = {.p1.x = FLT_MAX, .p1.y = FLT_MAX, .p2.x = FLT_MIN, .p2.y = FLT_MIN, .dist = FLT_MAX};
+
+    if (read_from_child(CHILD1_WRITE, 1, pipes, &ppair1, point_counts) < 0)
+        return -1;
+
+    if (read_from_child(CHILD2_WRITE, 2, pipes, &ppair2, point_counts) < 0)
+        return -1;
+
+    if (compute_closest_pair(total_points, point_counts, mean, fminf(ppair1.dist, ppair2.dist), &ppair3) < 0)
+        return -1;
+
+    if ((ppair1.dist < ppair2.dist) && (ppair1.dist < ppair3.dist))
+        fprintf(stdout, "%f %f\n%f %f\n", ppair1.p1.x, ppair1.p1.y, ppair1.p2.x, ppair1.p2.y);
+
+    else
+    {
+        if (ppair2.dist < ppair3.dist)
+            fprintf(stdout, "%f %f\n%f %f\n", ppair2.p1.x, ppair2.p1.y, ppair2.p2.x, ppair2.p2.y);
+        else
+            fprintf(stdout, "%f %f\n%f %f\n", ppair3.p1.x, ppair3.p1.y, ppair3.p2.x, ppair3.p2.y);
+    }
+    fflush(stdout);
+    return 0;
+}
+
+/***************************************PARENT-WRITE***********************************************/
+static int parent_write(point *total_points, point **points_child1, point **points_child2,
+                        int point_counts[3], int point_sizes[3], int pipes[4][2], float mean)
+{
+    FILE *f_child1 = fdopen(pipes[CHILD1_READ][WRITE], "a");
+    FILE *f_child2 = fdopen(pipes[CHILD2_READ][WRITE], "a");
+    for (size_t i = 0; i < point_counts[0]; i++)
+    {
+        point actual = total_points[i];
+        int needed_space = (snprintf(NULL, 0, "%f %f\n", actual.x, actual.y)) + 1; //size needed for buffer
+        char *buffer = malloc(needed_space);
+        if (buffer == NULL)
+            return -1;
+        snprintf(buffer, needed_space, "%f %f\n", actual.x, actual.y);
+
+        if (actual.x <= mean) // write to first child
+        {
+            point_counts[1]++;
+            if (point_counts[1] >= point_sizes[1]) // realloc necessary
+            {
+                point_sizes[1] *= 2;
+                if (((*points_child1) = realloc((*points_child1), (sizeof(point) * point_sizes[1]))) == NULL)
+                {
+                    free(buffer);
+                    return -1;
+                }
+            }
+            if (fprintf(f_child1, "%s", buffer) < 0) // write into pipe
+            {
+                free(buffer);
+                return -1;
+            }
+            (*points_child1)[point_counts[1] - 1] = actual; // store  point
+        }
+        else // write to second child
+        {
+            point_counts[2]++;
+            if (point_counts[2] >= point_sizes[2]) // realloc necessary
+            {
+                point_sizes[2] *= 2;
+                if (((*points_child2) = realloc((*points_child2), (sizeof(point) * point_sizes[2]))) == NULL)
+                {
+                    free(buffer);
+                    return -1;
+                }
+            }
+            if (fprintf(f_child2, "%s", buffer) < 0) // write into pipe
+            {
+                free(buffer);
+                return -1;
+            }
+            (*points_child2)[point_counts[2] - 1] = actual; // store point
+        }
+        free(buffer);
+    }
+
+    if (ferror(f_child1) || ferror(f_child2))
+        return -1;
+
+    if (fclose(f_child1) < 0 || fclose(f_child2) < 0) // closing write end of pipes
+        return -1;
+    return 0;
+}
+/*********************************************PIPE-SETUP***********************************************/
+static int close_pipes_parent(int pipes[4][2])
+{
+    if (close(pipes[CHILD1_READ][READ]) == -1)
+        return -1;
+    if (close(pipes[CHILD1_WRITE][WRITE]) == -1)
+        return -1;
+    if (close(pipes[CHILD2_READ][READ]) == -1)
+        return -1;
+    if (close(pipes[CHILD2_WRITE][WRITE]) == -1)
+        return -1;
+    return 0;
+}
+
+static int dup_close_child(int pipes[4][2], int child)
+{
+    if (close(pipes[CHILD1_READ][WRITE]) != 0)
+        return -1;
+    if (close(pipes[CHILD2_READ][WRITE]) != 0)
+        return -1;
+    if (close(pipes[CHILD1_WRITE][READ]) != 0)
+        return -1;
+    if (close(pipes[CHILD2_WRITE][READ]) != 0)
+        return -1;
+    if (close(pipes[child == 0 ? 2 : 0][READ]) != 0)
+        return -1;
+    if (close(pipes[child == 0 ? 3 : 1][WRITE]) != 0)
+        return -1;
+    if ((dup2(pipes[child][READ], STDIN_FILENO)) < 0)
+        return -1;
+    if ((dup2(pipes[child + 1][WRITE], STDOUT_FILENO)) < 0)
+        return -1;
+    if (close(pipes[child][READ]) != 0)
+        return -1;
+    if (close(pipes[child + 1][WRITE]) != 0)
+        return -1;
+    return 0;
+}
+
+static int setup_pipes(int pipes[4][2])
+{
+    if (pipe(pipes[CHILD1_READ]) == -1)
+        return -1;
+    if (pipe(pipes[CHILD1_WRITE]) == -1)
+        return -1;
+    if (pipe(pipes[CHILD2_READ]) == -1)
+        return -1;
+    if (pipe(pipes[CHILD2_WRITE]) == -1)
+        return -1;
+    return 0;
+}
+
+/****************************************INPUT-READ*********************************************************/
+static int read_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean)
+{
+    size_t buffer_size = READ_BLOCK_SIZE;
+    size_t filled = 0;
+    char *buffer = malloc(buffer_size + 1); // one more byte for the '\0' of scan_point
+    if (buffer == NULL)
+        return -1;
+
+    bool eof = false;
+    while (!eof)
+    {
+        if (filled == buffer_size) // a line doesn't fit into the buffer -> realloc needed
+        {
+            char *temp = realloc(buffer, buffer_size * 2 + 1);
+            if (temp == NULL)
+            {
+                free(buffer);
+                return -1;
+            }
+            buffer = temp;
+            buffer_size *= 2;
+        }
+        ssize_t result = read(STDIN_FILENO, buffer + filled, buffer_size - filled);
+        if (result == -1 && errno == EINTR)
+            continue;
+        if (result == -1)
+        {
+            free(buffer);
+            return -1;
+        }
+        eof = result == 0;
+        filled += result;
+
+        char *line = buffer;
+        char *end = buffer + filled;
+        while (line < end)
+        {
+            char *newline = memchr(line, '\n', end - line);
+            if (newline == NULL && !eof) // incomplete line, read the rest of it first
+                break;
+            char *line_end = newline == NULL ? end : newline;
+
+            point p;
+            if (scan_point(line, line_end, &p) == -1)
+            {
+                free(buffer);
+                return -1;
+            }
+            point_counts[0]++;
+            if (point_counts[0] >= point_sizes[0]) //pointer is to small -> realloc needed
+            {
+                point_sizes[0] *= 2;
+                if (((*total_points) = realloc((*total_points), (sizeof(point) * point_sizes[0]))) == NULL)
+                {
+                    free(buffer);
+                    return -1;
+                }
+            }
+            (*total_points)[point_counts[0] - 1] = p;
+            (*mean) += (*total_points)[point_counts[0] - 1].x;
+            line = newline == NULL ? end : newline + 1;
+        }
+        memmove(buffer, line, end - line);
+        filled = end - line;
+    }
+    free(buffer);
+    (*mean) /= point_counts[0];
+    return 0;
+}
+
+static int map_input(point **total_points, int point_counts[3], int point_sizes[3], float *mean)
+{
+    struct stat info;
+    if (fstat(STDIN_FILENO, &info) == -1)
+        return -1;
+
+    char *data;
+    size_t size = 0;
+    if (S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        if ((data = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, STDIN_FILENO, 0)) == MAP_FAILED)
+            return -1;
+        size = info.st_size;
+        mapped_points = (point *)data;
+        mapped_size = size;
+    }
+    else // pipes can't be mapped -> read them in blocks
+    {
+        size_t data_size = READ_BLOCK_SIZE;
+        if ((data = malloc(data_size)) == NULL)
+            return -1;
+        ssize_t result;
+        while ((result = read(STDIN_FILENO, data + size, data_size - size)) != 0)
+        {
+            if (result == -1 && errno == EINTR)
+                continue;
+            if (result == -1)
+            {
+                free(data);
+                return -1;
+            }
+            size += result;
+            if (size == data_size) // buffer is full -> realloc needed
+            {
+                char *temp = realloc(data, data_size * 2);
+                if (temp == NULL)
+                {
+                    free(data);
+                    return -1;
+                }
+                data = temp;
+                data_size *= 2;
+            }
+        }
+    }
+
+    if (size % sizeof(point) != 0 || size / sizeof(point) > INT_MAX) // truncated or too large input
+    {
+        clean_up((point *)data, NULL, NULL);
+        errno = EINVAL;
+        return -1;
+    }
+    free(*total_points);
+    *total_points = (point *)data;
+    point_counts[0] = size / sizeof(point);
+    point_sizes[0] = point_counts[0];
+    for (int i = 0; i < point_counts[0]; i++)
+        (*mean) += (*total_points)[i].x;
+    (*mean) /= point_counts[0];
+    return 0;
+}
+
+/***********************************UTIL*****************************************************/
+static int compute_closest_pair(point *total_points, int point_counts[3], float mean, float delta, p_pair *ppair3)
+{
+    float *strip_x = malloc(sizeof(float) * point_counts[0]);
+    float *strip_y = malloc(sizeof(float) * point_counts[0]);
+    if (strip_x == NULL || strip_y == NULL)
+    {
+        free(strip_x);
+        free(strip_y);
+        return -1;
+    }
+
+    size_t strip_count = 0;
+    for (size_t i = 0; i < point_counts[0]; i++)
+    {
+        float dx = total_points[i].x - mean;
+        if (dx * dx < delta) // close enough to the border
+        {
+            strip_x[strip_count] = total_points[i].x;
+            strip_y[strip_count++] = total_points[i].y;
+        }
+    }
+
+    size_t pair[2];
+    float new_dist = strip_closest_pair(strip_x, strip_y, strip_count, delta, pair);
+    if (new_dist < delta) // better solution found
+    {
+        ppair3->p1 = (point){.x = strip_x[pair[0]], .y = strip_y[pair[0]]};
+        ppair3->p2 = (point){.x = strip_x[pair[1]], .y = strip_y[pair[1]]};
+        ppair3->dist = new_dist;
+    }
+    free(strip_x);
+    free(strip_y);
+    return 0;
+}
+
+static void sort_by_y(point *points, int count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        if (points[i - 1].y > points[i].y) // not sorted yet
+        {
+            qsort(points, count, sizeof(point), compare_y);
+            return;
+        }
+    }
+}
+
+static int compare_y(const void *a, const void *b)
+{
+    float ya = ((const point *)a)->y;
+    float yb = ((const point *)b)->y;
+    return (ya > yb) - (ya < yb);
+}
+
+static float sq_dist(point p1, point p2)
+{
+    float dx = p2.x - p1.x;
+    float dy = p2.y - p1.y;
+    return dx * dx + dy * dy;
+}
+
+/***************************************STRIP-KERNEL***********************************************/
+/**
+ * @brief updates the best pair with the squared distances of point i to the points j to j+n-1 (in this order).
+ * @returns the new best squared distance
+ **/
+static float scan_block(const float *dists, size_t n, size_t i, size_t j, float best, size_t pair[2])
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        if (dists[k] < best)
+        {
+            best = dists[k];
+            pair[0] = i;
+            pair[1] = j + k;
+        }
+    }
+    return best;
+}
+
+/**
+ * @brief compares point i to the following points one at a time, until one is at least sqrt(best) above it.
+ * @returns the new best squared distance
+ **/
+static float scan_row(const float *x, const float *y, size_t i, size_t j, size_t count, float best, size_t pair[2])
+{
+    for (; j < count; j++)
+    {
+        float dy = y[j] - y[i];
+        if (dy * dy >= best) // all following points are even further above
+            break;
+        float dx = x[j] - x[i];
+        float new_dist = dx * dx + dy * dy;
+        if (new_dist < best)
+        {
+            best = new_dist;
+            pair[0] = i;
+            pair[1] = j;
+        }
+    }
+    return best;
+}
+
+#ifdef STRIP_KERNEL_AVX2
+/**
+ * @brief the AVX2 kernel of strip_closest_pair, 8 points at a time.
+ * @details the window is only checked at the start of a block, the later points of the block are further
+ * above and can't be closer. The last block is loaded with a mask and its missing lanes are infinitely far.
+ **/
+__attribute__((target("avx2"))) static float strip_closest_pair_avx2(const float *x, const float *y, size_t count,
+                                                                     float best, size_t pair[2])
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 infinity = _mm256_set1_ps(INFINITY);
+    for (size_t i = 0; i + 1 < count; i++)
+    {
+        __m256 xi = _mm256_set1_ps(x[i]);
+        __m256 yi = _mm256_set1_ps(y[i]);
+        for (size_t j = i + 1; j < count; j += 8)
+        {
+            float dy = y[j] - y[i];
+            if (dy * dy >= best)
+                break;
+            size_t n = count - j < 8 ? count - j : 8;
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)n), lane);
+            __m256 dxs = _mm256_sub_ps(_mm256_maskload_ps(x + j, mask), xi);
+            __m256 dys = _mm256_sub_ps(_mm256_maskload_ps(y + j, mask), yi);
+            __m256 dists = _mm256_add_ps(_mm256_mul_ps(dxs, dxs), _mm256_mul_ps(dys, dys));
+            dists = _mm256_blendv_ps(infinity, dists, _mm256_castsi256_ps(mask));
+            if (_mm256_movemask_ps(_mm256_cmp_ps(dists, _mm256_set1_ps(best), _CMP_LT_OQ)) != 0)
+            {
+                float lanes[8];
+                _mm256_storeu_ps(lanes, dists);
+                best = scan_block(lanes, n, i, j, best, pair);
+            }
+        }
+    }
+    return best;
+}
+#endif
+
+#ifdef STRIP_KERNEL_NEON
+/**
+ * @brief the NEON kernel of strip_closest_pair, 4 points at a time (the rest of a row one at a time).
+ **/
+static float strip_closest_pair_neon(const float *x, const float *y, size_t count, float best, size_t pair[2])
+{
+    for (size_t i = 0; i + 1 < count; i++)
+    {
+        float32x4_t xi = vdupq_n_f32(x[i]);
+        float32x4_t yi = vdupq_n_f32(y[i]);
+        size_t j = i + 1;
+        bool done = false;
+        for (; j + 4 <= count; j += 4)
+        {
+            float dy = y[j] - y[i];
+            if (dy * dy >= best)
+            {
+                done = true;
+                break;
+            }
+            float32x4_t dxs = vsubq_f32(vld1q_f32(x + j), xi);
+            float32x4_t dys = vsubq_f32(vld1q_f32(y + j), yi);
+            float32x4_t dists = vaddq_f32(vmulq_f32(dxs, dxs), vmulq_f32(dys, dys));
+            if (vmaxvq_u32(vcltq_f32(dists, vdupq_n_f32(best))) != 0)
+            {
+                float lanes[4];
+                vst1q_f32(lanes, dists);
+                best = scan_block(lanes, 4, i, j, best, pair);
+            }
+        }
+        if (!done)
+            best = scan_row(x, y, i, j, count, best, pair);
+    }
+    return best;
+}
+#endif
+
+static float strip_closest_pair(const float *x, const float *y, size_t count, float best, size_t pair[2])
+{
+#if defined(STRIP_KERNEL_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+        return strip_closest_pair_avx2(x, y, count, best, pair);
+#elif defined(STRIP_KERNEL_NEON)
+    return strip_closest_pair_neon(x, y, count, best, pair);
+#endif
+    for (size_t i = 0; i + 1 < count; i++)
+        best = scan_row(x, y, i, i + 1, count, best, pair);
+    return best;
+}
+
+static point string_to_point(char *input)
+{
+    // no error handling, checked in advance
+    point p;
+    input = strtok(input, " ");
+    p.x = strtof(input, NULL);
+    input = strtok(NULL, " ");
+    p.y = strtof(input, NULL);
+    return p;
+}
+
+static int scan_point(char *line, char *end, point *p)
+{
+    char *pos = line;
+    for (int i = 0; i < 2; i++)
+    {
+        char *number = pos;
+        if (pos < end && (*pos == '-' || *pos == '+'))
+            pos++;
+        while (pos < end && *pos >= '0' && *pos <= '9')
+            pos++;
+        if (pos < end && *pos == '.')
+            pos++;
+        char *digits = pos;
+        while (pos < end && *pos >= '0' && *pos <= '9')
+            pos++;
+        if (pos == digits && (pos == number || pos[-1] < '0' || pos[-1] > '9')) // has to end with a digit
+            return -1;
+        if (i == 0 && (pos == end || *pos++ != ' '))
+            return -1;
+    }
+    if (pos != end)
+        return -1;
+
+    char saved = *end;
+    *end = '\0';
+    char *y;
+    p->x = strtof(line, &y);
+    p->y = strtof(y + 1, NULL);
+    *end = saved;
+    return 0;
+}
+
+static void clean_up(point *p1, point *p2, point *p3)
+{
+    if (p1 != NULL && p1 == mapped_points)
+    {
+        munmap(p1, mapped_size);
+        mapped_points = NULL;
+    }
+    else if (p1 != NULL)
+        free(p1);
+    if (p2 != NULL)
+        free(p2);
+    if (p3 != NULL)
+        free(p3);
+}
+
+static void error(char *error_message)
+{
+    if (errno != 0)
+        fprintf(stderr, "[%s] ERROR: %s: %s.\n", PROGRAM_NAME, error_message, strerror(errno));
+    else
+        fprintf(stderr, "[%s] ERROR: %s.\n", PROGRAM_NAME, error_message);
+    exit(EXIT_FAILURE);
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "Usage: %s [-b]\n", PROGRAM_NAME);
+    exit(EXIT_FAILURE);
+}
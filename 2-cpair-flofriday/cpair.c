@@ -4,6 +4,13 @@
  * date: 27.11.2020
  * 
  * @brief Complete Implementation of the cpair task.
+ * @details The tree of the processes is only printed with -t. With -p the
+ * closest pair is computed in this process by the threads of the engine in
+ * parallel_cpair.h instead (-j sets the number of threads, the number of
+ * online processors by default). With -i FILE the points of the file are
+ * indexed once by point_index.h and queries and updates are read from stdin.
+ * With -b stdin contains packed float x, float y pairs, which are mapped
+ * directly as the point array (the children still get text).
  */
 
 #include <stdlib.h>
@@ -17,6 +24,13 @@
 #include <string.h>
 #include <assert.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "parallel_cpair.h"
+#include "point_index.h"
+#include "pair_kernel.h"
 
 /**
  * @brief The name of the executing program
@@ -24,14 +38,9 @@
 const char *procname;
 
 /**
- * Structure of a point
- * @brief The strucutre of a point in two dimensional space.
+ * @brief Indicates if the tree should be printed (option -t).
  */
-typedef struct Point
-{
-    float x;
-    float y;
-} Point;
+bool print_tree_enabled = false;
 
 /**
  * Remove newline.
@@ -104,18 +113,18 @@ int parse_point(Point *dst, char *line)
 }
 
 /**
- * Calculate the distance between two points
- * @brief Calculates the euclidean distance between two Points p1 and p2.
+ * Calculate the squared distance between two points
+ * @brief Calculates the squared euclidean distance between two Points p1 and
+ * p2, which is enough to compare distances.
  * @param p1 A pointer to the first point.
  * @param p2 A pointer to the second point.
- * @return The distance between the points.
+ * @return The squared distance between the points.
  */
-float calc_distance(Point *p1, Point *p2)
+float calc_distance_sq(Point *p1, Point *p2)
 {
     float a = p2->x - p1->x;
     float b = p2->y - p1->y;
-    float c = sqrt(a * a + b * b);
-    return c;
+    return a * a + b * b;
 }
 
 /** Calculate the arithmetic mean.
@@ -136,69 +145,522 @@ float arithmetic_mean(Point *points, size_t len)
 }
 
 /**
- * Parse points from stdin
- * @brief Parse the input of stdin. This function will allocate an array for the
+ * @brief The size of the blocks the text input is read in.
+ */
+#define READ_BLOCK_SIZE (1 << 20)
+
+/**
+ * @brief Set if the points were mapped from stdin by map_stdin.
+ */
+Point *mapped_points = NULL;
+
+/**
+ * @brief The size of the mapping of mapped_points in bytes.
+ */
+size_t mapped_size = 0;
+
+/**
+ * Free the points.
+ * @brief Unmaps the points if they were mapped by map_stdin, otherwise frees
+ * them.
+ * @param points The array of points.
+ */
+void free_points(Point *points)
+{
+    if (points != NULL && points == mapped_points)
+    {
+        munmap(points, mapped_size);
+        mapped_points = NULL;
+        return;
+    }
+    free(points);
+}
+
+/**
+ * Scan a float.
+ * @brief Parses a float of the form [+-]digits[.digits][e[+-]digits] from
+ * the text between pos and end without copying it. Other forms (and numbers
+ * with more than 19 significant digits) are parsed with strtof.
+ * @param pos The beginning of the number.
+ * @param end The end of the text.
+ * @param value A pointer to the float the value is stored in.
+ * @return A pointer to the first character after the number or NULL if there
+ * is no number.
+ */
+const char *scan_float(const char *pos, const char *end, float *value)
+{
+    static const double powers[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7,
+                                    1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14,
+                                    1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21,
+                                    1e22};
+    const char *p = pos;
+    bool negative = false;
+    if (p < end && (*p == '-' || *p == '+'))
+    {
+        negative = *p++ == '-';
+    }
+
+    // The significant digits are collected in mantissa
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool fast = true;
+    bool any = false;
+    for (; p < end && *p >= '0' && *p <= '9'; p++)
+    {
+        any = true;
+        if (mantissa == 0 && *p == '0')
+        {
+            continue;
+        }
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits++;
+        }
+        else
+        {
+            fast = false;
+        }
+    }
+    if (p < end && *p == '.')
+    {
+        for (p++; p < end && *p >= '0' && *p <= '9'; p++)
+        {
+            any = true;
+            if (mantissa == 0 && *p == '0')
+            {
+                exponent--;
+                continue;
+            }
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits++;
+                exponent--;
+            }
+            else
+            {
+                fast = false;
+            }
+        }
+    }
+    if (any && p < end && (*p == 'e' || *p == 'E'))
+    {
+        const char *e = p + 1;
+        bool negative_exp = false;
+        if (e < end && (*e == '-' || *e == '+'))
+        {
+            negative_exp = *e++ == '-';
+        }
+        int exp = 0;
+        bool exp_digits = false;
+        for (; e < end && *e >= '0' && *e <= '9'; e++)
+        {
+            exp = exp < 1000 ? exp * 10 + (*e - '0') : exp;
+            exp_digits = true;
+        }
+        if (exp_digits)
+        {
+            exponent += negative_exp ? -exp : exp;
+            p = e;
+        }
+    }
+
+    if (any && fast && mantissa < ((uint64_t)1 << 53) && exponent >= -22 &&
+        exponent <= 22)
+    {
+        double v = (double)mantissa;
+        v = exponent < 0 ? v / powers[-exponent] : v * powers[exponent];
+        *value = (float)(negative ? -v : v);
+        return p;
+    }
+
+    // Fall back to strtof for everything else (inf, nan, hex, long numbers)
+    char token[64];
+    size_t token_len = 0;
+    while (pos + token_len < end && pos[token_len] != ' ' &&
+           pos[token_len] != '\n' && token_len < sizeof(token) - 1)
+    {
+        token[token_len] = pos[token_len];
+        token_len++;
+    }
+    token[token_len] = '\0';
+    char *endptr;
+    *value = strtof(token, &endptr);
+    if (endptr == token)
+    {
+        return NULL;
+    }
+    return pos + (endptr - token);
+}
+
+/**
+ * Scan a line.
+ * @brief Parses a line with two space seperated floating point numbers (like
+ * parse_point) without copying it.
+ * @param dst A pointer to the point into which the data will be parsed.
+ * @param pos The beginning of the line.
+ * @param end The end of the line (the newline or the end of the input).
+ * @return Upon success 0, otherwise -1.
+ */
+int scan_line(Point *dst, const char *pos, const char *end)
+{
+    pos = scan_float(pos, end, &dst->x);
+    if (pos == NULL || pos == end || *pos != ' ')
+    {
+        return -1;
+    }
+    pos = scan_float(pos + 1, end, &dst->y);
+    if (pos != end)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Parse points from a file
+ * @brief Parse the input of a file. This function will allocate an array for the
  * points it parses and will adjust poinst so that points will be a pointer to
  * that array.
  * @details In case of an error this function writes an error message to 
  * stderr.
+ * The file is read with read in blocks of READ_BLOCK_SIZE bytes and the lines
+ * are parsed in the block by scan_line, the last incomplete line of a block is
+ * moved to the beginning of the buffer.
  * The caller must free the the array to which points points to.
+ * @param file The file to read the points from (nothing may be read from it
+ * before).
  * @param points A pointer to an (empty) Point array.
  * @param len The number of the parsed points.
  * @return Upon success 0, otherwise -1.
  */
-int parse_stdin(Point **points, size_t *len)
+int parse_file(FILE *file, Point **points, size_t *len)
 {
     // Create an dynamic array to store the points in.
     size_t cap = 2;
     *points = malloc(sizeof(Point) * cap);
-    if (points == NULL)
+    size_t buffer_cap = READ_BLOCK_SIZE;
+    char *buffer = malloc(buffer_cap);
+    if (*points == NULL || buffer == NULL)
     {
         fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n",
                 procname, strerror(errno));
+        free(*points);
+        free(buffer);
         return -1;
     }
 
-    // Read stdin line by line.
-    char *line = NULL;
-    size_t linecap = 0;
-    while (getline(&line, &linecap, stdin) != -1)
+    int fd = fileno(file);
+    size_t filled = 0;
+    bool eof = false;
+    while (!eof)
     {
-        // Resize the array if it isn't big enough
-        if (cap == *len)
+        // Grow the buffer if a line doesn't fit in it
+        if (filled == buffer_cap)
         {
-            cap *= 2;
-            Point *tmp = realloc(*points, sizeof(Point) * cap);
+            char *tmp = realloc(buffer, buffer_cap * 2);
             if (tmp == NULL)
             {
-                free(line);
-                free(*points);
                 fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n",
                         procname, strerror(errno));
+                free(buffer);
+                free(*points);
                 return -1;
             }
-            *points = tmp;
+            buffer = tmp;
+            buffer_cap *= 2;
         }
 
-        // Parse the point into the array
-        if (parse_point(&((*points)[*len]), line) != 0)
+        ssize_t n = read(fd, buffer + filled, buffer_cap - filled);
+        if (n == -1 && errno == EINTR)
         {
-            fprintf(stderr, "[%s] ERROR: Cannot parse line %lu \"%s\"\n",
-                    procname, *len, line);
-            free(line);
+            continue;
+        }
+        if (n == -1)
+        {
+            fprintf(stderr, "[%s] ERROR: Cannot read input: %s\n", procname,
+                    strerror(errno));
+            free(buffer);
             free(*points);
             return -1;
         }
+        eof = n == 0;
+        filled += n;
 
-        // Adjust the values for the next loop
-        (*len)++;
+        // Parse all complete lines (and the last line at the end of the input)
+        char *pos = buffer;
+        char *end = buffer + filled;
+        while (pos < end)
+        {
+            char *newline = memchr(pos, '\n', end - pos);
+            if (newline == NULL && !eof)
+            {
+                break;
+            }
+            char *line_end = newline == NULL ? end : newline;
+
+            // Resize the array if it isn't big enough
+            if (cap == *len)
+            {
+                cap *= 2;
+                Point *tmp = realloc(*points, sizeof(Point) * cap);
+                if (tmp == NULL)
+                {
+                    free(buffer);
+                    free(*points);
+                    fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n",
+                            procname, strerror(errno));
+                    return -1;
+                }
+                *points = tmp;
+            }
+
+            // Parse the point into the array
+            if (scan_line(&((*points)[*len]), pos, line_end) != 0)
+            {
+                fprintf(stderr, "[%s] ERROR: Cannot parse line %lu \"%.*s\"\n",
+                        procname, *len, (int)(line_end - pos), pos);
+                free(buffer);
+                free(*points);
+                return -1;
+            }
+
+            // Adjust the values for the next loop
+            (*len)++;
+            pos = newline == NULL ? end : newline + 1;
+        }
+        memmove(buffer, pos, end - pos);
+        filled = end - pos;
     }
 
-    // Free the line and return with a success value.
-    free(line);
+    free(buffer);
     return 0;
 }
 
+/**
+ * Map points from stdin
+ * @brief Uses the binary input of stdin (packed float x, float y pairs) as
+ * the point array. A regular file is mapped privately, so the points can be
+ * reordered without changing the file. Other inputs are read with read.
+ * @details In case of an error this function writes an error message to 
+ * stderr.
+ * The caller must free the array with free_points.
+ * @param points A pointer to an (empty) Point array.
+ * @param len The number of the points.
+ * @return Upon success 0, otherwise -1.
+ */
+int map_stdin(Point **points, size_t *len)
+{
+    struct stat info;
+    if (fstat(STDIN_FILENO, &info) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Cannot stat stdin: %s\n", procname,
+                strerror(errno));
+        return -1;
+    }
+
+    if (S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        if (info.st_size % sizeof(Point) != 0)
+        {
+            fprintf(stderr, "[%s] ERROR: The binary input is truncated\n",
+                    procname);
+            return -1;
+        }
+        void *map = mmap(NULL, info.st_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE, STDIN_FILENO, 0);
+        if (map == MAP_FAILED)
+        {
+            fprintf(stderr, "[%s] ERROR: Cannot map stdin: %s\n", procname,
+                    strerror(errno));
+            return -1;
+        }
+        mapped_points = map;
+        mapped_size = info.st_size;
+        *points = map;
+        *len = info.st_size / sizeof(Point);
+        return 0;
+    }
+
+    // Pipes (and empty files) are read in blocks
+    size_t cap = READ_BLOCK_SIZE;
+    size_t size = 0;
+    char *data = malloc(cap);
+    while (data != NULL)
+    {
+        if (size == cap)
+        {
+            char *tmp = realloc(data, cap * 2);
+            if (tmp == NULL)
+            {
+                break;
+            }
+            data = tmp;
+            cap *= 2;
+        }
+        ssize_t n = read(STDIN_FILENO, data + size, cap - size);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n == -1)
+        {
+            fprintf(stderr, "[%s] ERROR: Cannot read input: %s\n", procname,
+                    strerror(errno));
+            free(data);
+            return -1;
+        }
+        if (n == 0)
+        {
+            if (size % sizeof(Point) != 0)
+            {
+                fprintf(stderr, "[%s] ERROR: The binary input is truncated\n",
+                        procname);
+                free(data);
+                return -1;
+            }
+            *points = (Point *)data;
+            *len = size / sizeof(Point);
+            return 0;
+        }
+        size += n;
+    }
+    fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n", procname,
+            strerror(errno));
+    free(data);
+    return -1;
+}
+
+/**
+ * Parse points from stdin
+ * @brief Parse the input of stdin with parse_file.
+ * @param points A pointer to an (empty) Point array.
+ * @param len The number of the parsed points.
+ * @return Upon success 0, otherwise -1.
+ */
+int parse_stdin(Point **points, size_t *len)
+{
+    return parse_file(stdin, points, len);
+}
+
+/**
+ * Run the index mode.
+ * @brief Builds the grid index over the points of the file once and answers
+ * the commands read from stdin line by line:
+ * "pair" prints the closest pair, "nearest K X Y" prints the K nearest points
+ * of (X, Y) nearest first, "insert X Y" and "delete X Y" update the points.
+ * @param path The path of the file with the points.
+ * @return Upon success 0, otherwise -1.
+ */
+int run_index(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Cannot open %s: %s\n", procname, path,
+                strerror(errno));
+        return -1;
+    }
+    Point *points;
+    size_t points_len = 0;
+    int parsed = parse_file(file, &points, &points_len);
+    fclose(file);
+    if (parsed == -1)
+    {
+        return -1;
+    }
+
+    PointIndex *index = index_create(points, points_len);
+    free_points(points);
+    if (index == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n",
+                procname, strerror(errno));
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t linecap = 0;
+    int result = 0;
+    while (result == 0 && getline(&line, &linecap, stdin) != -1)
+    {
+        strip_newline(line);
+        Point point;
+        char *pos;
+        if (strncmp(line, "insert ", 7) == 0 &&
+            parse_point(&point, line + 7) == 0)
+        {
+            if (index_insert(index, point) == -1)
+            {
+                fprintf(stderr, "[%s] ERROR: Unable to allocate memmory\n",
+                        procname);
+                result = -1;
+            }
+        }
+        else if (strncmp(line, "delete ", 7) == 0 &&
+                 parse_point(&point, line + 7) == 0)
+        {
+            if (index_delete(index, point) == 1)
+            {
+                fprintf(stderr, "[%s] ERROR: There is no point \"%s\"\n",
+                        procname, line + 7);
+            }
+        }
+        else if (strcmp(line, "pair") == 0)
+        {
+            Point pair[2];
+            if (index_closest_pair(index, pair) == -1)
+            {
+                fprintf(stderr, "[%s] ERROR: There are less than two points\n",
+                        procname);
+            }
+            else
+            {
+                write_point(stdout, &pair[0]);
+                write_point(stdout, &pair[1]);
+            }
+        }
+        else if (strncmp(line, "nearest ", 8) == 0 &&
+                 strtol(line + 8, &pos, 10) > 0 && *pos == ' ' &&
+                 parse_point(&point, pos + 1) == 0)
+        {
+            // There can't be more results than points
+            size_t k = strtol(line + 8, NULL, 10);
+            if (k > index_size(index))
+            {
+                k = index_size(index);
+            }
+            Point *nearest = malloc(sizeof(Point) * (k > 0 ? k : 1));
+            long found = nearest == NULL ? -1
+                                         : index_nearest(index, point, k,
+                                                         nearest);
+            if (found == -1)
+            {
+                fprintf(stderr, "[%s] ERROR: Unable to allocate memmory\n",
+                        procname);
+                result = -1;
+            }
+            for (long i = 0; i < found; i++)
+            {
+                write_point(stdout, &nearest[i]);
+            }
+            free(nearest);
+        }
+        else
+        {
+            fprintf(stderr, "[%s] ERROR: Invalid command \"%s\"\n", procname,
+                    line);
+        }
+        fflush(stdout);
+    }
+
+    free(line);
+    index_free(index);
+    return result;
+}
+
 /**
  * Parse the input from a child
  * @brief Parse the point output of (only first 2 lines) of the child. 
@@ -283,8 +745,8 @@ int parse_children(FILE *lfile, FILE *rfile, Point *points)
 
     // Both children have a result so we need to find out which one has the
     // best result.
-    if (calc_distance(&right_res[0], &right_res[1]) <=
-        calc_distance(&left_res[0], &left_res[1]))
+    if (calc_distance_sq(&right_res[0], &right_res[1]) <=
+        calc_distance_sq(&left_res[0], &left_res[1]))
     {
         points[0] = right_res[0];
         points[1] = right_res[1];
@@ -298,63 +760,105 @@ int parse_children(FILE *lfile, FILE *rfile, Point *points)
     }
 }
 
+/**
+ * Compare two points by their y-value.
+ * @brief Comparison function for qsort to sort points by their y-value.
+ * @param a A pointer to the first point.
+ * @param b A pointer to the second point.
+ * @return A negative number, zero or a positive number if the first point is
+ * below, on the same height or above the second point.
+ */
+int compare_y(const void *a, const void *b)
+{
+    float ya = ((const Point *)a)->y;
+    float yb = ((const Point *)b)->y;
+    return (ya > yb) - (ya < yb);
+}
+
+/**
+ * Sort points by y.
+ * @brief Sorts the points by their y-value if they aren't sorted already.
+ * @details The points are sent to the children in this order, so only the
+ * first process actually sorts and every child receives its points sorted.
+ * @param points An array of all points.
+ * @param len The number of elements in points.
+ */
+void sort_by_y(Point *points, size_t len)
+{
+    for (size_t i = 1; i < len; i++)
+    {
+        if (points[i - 1].y > points[i].y)
+        {
+            qsort(points, len, sizeof(Point), compare_y);
+            return;
+        }
+    }
+}
+
 /**
  * Merge the two outputs of both children 
  * @brief Both children found the closest pair in their half. However, there
  * might be a pair of points that is even closer where each point is in a 
  * different half. Therefore this function checks if such a pair exists and if
  * so saves them in p1 and p2.
- * @param points An array of all points.
+ * @details Only points closer than delta to the mean can be part of such a 
+ * pair. As the points are sorted by y, this strip is sorted by y too and every
+ * point only needs to be compared to the following points which are less than 
+ * delta above it (at most 7). The strip is compared by the kernel of
+ * pair_kernel.h on the coordinates as separate arrays and squared distances.
+ * @param points An array of all points (sorted by y).
  * @param len The number of elements in points.
  * @param mean The arithmetic mean of all points
  * @param p1 A pointer to a pointer to the first point of the currently best
  * pair.
  * @param p2 A pointer to a pointer to the first point of the currently best
  * pair.
+ * @return Upon success 0, otherwise -1.
  */
-void merge(Point *points, size_t len, float mean, Point **p1, Point **p2)
+int merge(Point *points, size_t len, float mean, Point **p1, Point **p2)
 {
-    // Delta is the currently shortes distance
-    float delta = calc_distance(*p1, *p2);
-
-    // Calculate all points on the right side which are candidates (they are
-    // close enough to the border).
-    Point *right_close[len];
-    size_t cnt_close = 0;
+    // Delta is the currently shortes distance (squared)
+    float delta = calc_distance_sq(*p1, *p2);
+
+    // Collect all points that are close enough to the border (the mean)
+    Point **strip = malloc(sizeof(Point *) * len);
+    float *strip_x = malloc(sizeof(float) * len);
+    float *strip_y = malloc(sizeof(float) * len);
+    if (strip == NULL || strip_x == NULL || strip_y == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to allocate memmory: %s\n",
+                procname, strerror(errno));
+        free(strip);
+        free(strip_x);
+        free(strip_y);
+        return -1;
+    }
+    size_t strip_len = 0;
     for (size_t i = 0; i < len; i++)
     {
-        // Point needs to be right of the mean and cannot be more than delta
-        // away from the mean (which is the border between the childs).
-        if (points[i].x > mean && points[i].x - mean < delta)
+        float dx = points[i].x - mean;
+        if (dx * dx < delta)
         {
-            right_close[cnt_close] = &points[i];
-            cnt_close++;
+            strip[strip_len] = &points[i];
+            strip_x[strip_len] = points[i].x;
+            strip_y[strip_len] = points[i].y;
+            strip_len++;
         }
     }
 
-    for (size_t i1 = 0; i1 < len / 2; i1++)
+    // Only points less than delta above can be closer than delta
+    size_t pair[2];
+    if (closest_pair_sq(strip_x, strip_y, strip_len, true, delta, pair) < delta)
     {
-        // Ignore all right points and left points that are too far from
-        // the border
-        if (points[i1].x > mean || mean - points[i1].x > delta)
-        {
-            continue;
-        }
-
-        // Since we found a left candidate, loop over all right candidates and
-        // check if there is a better result than currently in delta.
-        for (size_t i2 = 0; i2 < cnt_close; i2++)
-        {
-            float tmp_delta = calc_distance(&points[i1], right_close[i2]);
-            if (tmp_delta < delta)
-            {
-                // Found a new better pair, so update delta and p1, p2.
-                delta = tmp_delta;
-                *p1 = &points[i1];
-                *p2 = right_close[i2];
-            }
-        }
+        // Found a new better pair, so update p1, p2.
+        *p1 = strip[pair[0]];
+        *p2 = strip[pair[1]];
     }
+
+    free(strip);
+    free(strip_x);
+    free(strip_y);
+    return 0;
 }
 
 /**
@@ -401,7 +905,7 @@ void print_branchline(size_t llen, size_t rlen)
 
 /**
  * Print the tree.
- * @brief Print the call-tree of this process to stdout.
+ * @brief Print the call-tree of this process to stdout (only with -t).
  * @details lf and rf streams must be pointed at either the first line of the
  * tree or empty line between the result and the tree.
  * lf and rf can be set to NULL, if points_len is less or equal to two.
@@ -413,6 +917,11 @@ void print_branchline(size_t llen, size_t rlen)
  */
 int print_tree(Point *points, size_t points_len, FILE *lf, FILE *rf)
 {
+    if (!print_tree_enabled)
+    {
+        return 0;
+    }
+
     // Special case with just 1 point
     if (points_len == 1)
     {
@@ -582,44 +1091,112 @@ void lazy_kill(int n)
  * @param arv The argument vector.
  * @return Upon success EXIT_SUCCESS is returned, otherwise EXIT_FAILURE.
  */
-int main(int argc, char const *argv[])
+int main(int argc, char *argv[])
 {
     // Handle arguments
     procname = argv[0];
-    if (argc != 1)
+    bool in_process = false;
+    bool binary = false;
+    const char *index_path = NULL;
+    long threads = sysconf(_SC_NPROCESSORS_ONLN);
+    int opt;
+    while ((opt = getopt(argc, argv, "tpj:i:b")) != -1)
     {
-        fprintf(stderr, "[%s] ERROR: %s does not accept any arguments.\n",
-                procname, procname);
+        char *end;
+        switch (opt)
+        {
+        case 'b':
+            binary = true;
+            break;
+        case 'i':
+            index_path = optarg;
+            break;
+        case 't':
+            print_tree_enabled = true;
+            break;
+        case 'p':
+            in_process = true;
+            break;
+        case 'j':
+            threads = strtol(optarg, &end, 10);
+            if (*end != '\0' || end == optarg || threads < 1 || threads > 1024)
+            {
+                fprintf(stderr, "[%s] ERROR: Invalid number of threads.\n",
+                        procname);
+                exit(EXIT_FAILURE);
+            }
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-b] [-t | -p [-j THREADS] | -i FILE]\n",
+                    procname);
+            exit(EXIT_FAILURE);
+        }
+    }
+    if (optind != argc || (print_tree_enabled && in_process) ||
+        (index_path != NULL && (print_tree_enabled || in_process)))
+    {
+        fprintf(stderr, "Usage: %s [-b] [-t | -p [-j THREADS] | -i FILE]\n",
+                procname);
         exit(EXIT_FAILURE);
     }
+    if (index_path != NULL)
+    {
+        exit(run_index(index_path) == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+    if (threads < 1)
+    {
+        threads = 1;
+    }
 
     // Parse input
     Point *points;
     size_t points_len = 0;
-    if (parse_stdin(&points, &points_len) == -1)
+    int parsed = binary ? map_stdin(&points, &points_len)
+                        : parse_stdin(&points, &points_len);
+    if (parsed == -1)
     {
         // No need to print an error as parse_stdin does this anyway.
         exit(EXIT_FAILURE);
     }
 
+    // The in-process engine computes everything in this process
+    if (in_process && points_len >= 2)
+    {
+        Point result[2];
+        if (parallel_closest_pair(points, points_len, threads, result) == -1)
+        {
+            fprintf(stderr, "[%s] ERROR: Cannot compute the closest pair: %s\n",
+                    procname, strerror(errno));
+            free_points(points);
+            exit(EXIT_FAILURE);
+        }
+        write_point(stdout, &result[0]);
+        write_point(stdout, &result[1]);
+        free_points(points);
+        exit(EXIT_SUCCESS);
+    }
+
+    // Sort the points by y, which is needed by merge
+    sort_by_y(points, points_len);
+
     switch (points_len)
     {
     case (0):
         fprintf(stderr, "[%s] ERROR: No points provided via stdin!\n",
                 procname);
-        free(points);
+        free_points(points);
         exit(EXIT_FAILURE);
         break;
     case (1):
         print_tree(points, points_len, NULL, NULL);
-        free(points);
+        free_points(points);
         exit(EXIT_SUCCESS);
         break;
     case (2):
         write_point(stdout, &points[0]);
         write_point(stdout, &points[1]);
         print_tree(points, points_len, NULL, NULL);
-        free(points);
+        free_points(points);
         exit(EXIT_SUCCESS);
         break;
     default:
@@ -636,7 +1213,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr, "[%s] ERROR: Cannot pipe: %s\n", procname,
                 strerror(errno));
-        free(points);
+        free_points(points);
         exit(EXIT_FAILURE);
     }
 
@@ -646,7 +1223,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr, "[%s] ERROR: Cannot fork: %s\n", procname,
                 strerror(errno));
-        free(points);
+        free_points(points);
         close(left_read_pipe[0]);
         close(left_read_pipe[1]);
         close(left_write_pipe[0]);
@@ -664,14 +1241,14 @@ int main(int argc, char const *argv[])
         {
             fprintf(stderr, "[%s] ERROR: Cannot dup2: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             exit(EXIT_FAILURE);
         }
         if (dup2(left_write_pipe[0], STDIN_FILENO) == -1)
         {
             fprintf(stderr, "[%s] ERROR: Cannot dup2: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             exit(EXIT_FAILURE);
         }
 
@@ -690,9 +1267,9 @@ int main(int argc, char const *argv[])
         close(left_write_pipe[0]);
 
         // Execute this program from the start
-        execlp(procname, procname, NULL);
+        execlp(procname, procname, print_tree_enabled ? "-t" : NULL, NULL);
         fprintf(stderr, "[%s] ERROR: Cannot exec: %s\n", procname, strerror(errno));
-        free(points);
+        free_points(points);
         exit(EXIT_FAILURE);
     }
 
@@ -702,7 +1279,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr, "[%s] ERROR: Cannot fork: %s\n", procname,
                 strerror(errno));
-        free(points);
+        free_points(points);
         close(left_read_pipe[0]);
         close(left_read_pipe[1]);
         close(left_write_pipe[0]);
@@ -721,14 +1298,14 @@ int main(int argc, char const *argv[])
         {
             fprintf(stderr, "[%s] ERROR: Cannot dup2: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             exit(EXIT_FAILURE);
         }
         if (dup2(right_write_pipe[0], STDIN_FILENO) == -1)
         {
             fprintf(stderr, "[%s] ERROR: Cannot dup2: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             exit(EXIT_FAILURE);
         }
         // Close all pipes meant for the other child
@@ -746,10 +1323,10 @@ int main(int argc, char const *argv[])
         close(right_write_pipe[0]);
 
         // Execute this program from the start
-        execlp(procname, procname, NULL);
+        execlp(procname, procname, print_tree_enabled ? "-t" : NULL, NULL);
         fprintf(stderr, "[%s] ERROR: Cannot exec: %s\n", procname,
                 strerror(errno));
-        free(points);
+        free_points(points);
         lazy_kill(1);
         exit(EXIT_FAILURE);
     }
@@ -771,7 +1348,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr, "[%s] ERROR: Cannot create file descriptor: %s\n",
                 procname, strerror(errno));
-        free(points);
+        free_points(points);
         close(left_read_pipe[0]);
         close(right_read_pipe[0]);
         close(left_write_pipe[1]);
@@ -797,7 +1374,7 @@ int main(int argc, char const *argv[])
             fprintf(stderr,
                     "[%s] ERROR: Unable to write to the left child: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             fclose(left_read_fd);
             fclose(right_read_fd);
             fclose(left_write_fd);
@@ -821,7 +1398,7 @@ int main(int argc, char const *argv[])
             fprintf(stderr,
                     "[%s] ERROR: Unable to write to the right child: %s\n",
                     procname, strerror(errno));
-            free(points);
+            free_points(points);
             fclose(left_read_fd);
             fclose(right_read_fd);
             fclose(left_write_fd);
@@ -856,7 +1433,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr,
                 "[%s] One child terminated with an error\n", procname);
-        free(points);
+        free_points(points);
         fclose(left_read_fd);
         fclose(right_read_fd);
         exit(EXIT_FAILURE);
@@ -865,7 +1442,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr,
                 "[%s] Both children terminated with an error\n", procname);
-        free(points);
+        free_points(points);
         fclose(left_read_fd);
         fclose(right_read_fd);
         exit(EXIT_FAILURE);
@@ -877,7 +1454,7 @@ int main(int argc, char const *argv[])
     {
         fprintf(stderr, "[%s] Both children terminated with zero output\n",
                 procname);
-        free(points);
+        free_points(points);
         fclose(right_read_fd);
         fclose(left_read_fd);
         exit(EXIT_FAILURE);
@@ -888,21 +1465,27 @@ int main(int argc, char const *argv[])
     result[1] = &child_result[1];
 
     // Merge the points and find the closest pair
-    merge(points, points_len, mean, &result[0], &result[1]);
+    if (merge(points, points_len, mean, &result[0], &result[1]) == -1)
+    {
+        free_points(points);
+        fclose(right_read_fd);
+        fclose(left_read_fd);
+        exit(EXIT_FAILURE);
+    }
 
     // Print the result to stdout
     write_point(stdout, result[0]);
     write_point(stdout, result[1]);
     if (print_tree(points, points_len, left_read_fd, right_read_fd) == -1)
     {
-        free(points);
+        free_points(points);
         fclose(right_read_fd);
         fclose(left_read_fd);
         exit(EXIT_FAILURE);
     }
 
     // Free all resources and exit
-    free(points);
+    free_points(points);
     fclose(right_read_fd);
     fclose(left_read_fd);
     return EXIT_SUCCESS;
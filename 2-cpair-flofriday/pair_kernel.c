@@ -0,0 +1,191 @@
+/**
+ * @file pair_kernel.c
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief Implementation of the squared distance kernel.
+ * @details Every kernel compares point i to a block of the following points
+ * at once. Only if the block holds a closer pair its lanes are scanned in
+ * order, so the vector kernels update best in the same order as the scalar
+ * one. The strip check is only tested at the start of a block: the points
+ * later in the block are further above, so they can't be closer than best.
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define PAIR_KERNEL_AVX2
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define PAIR_KERNEL_NEON
+#endif
+
+#include "pair_kernel.h"
+
+/**
+ * Compare a point to the rest of its row.
+ * @brief Compares point i to the points j to len-1, one at a time.
+ * @return The new best squared distance.
+ */
+static float scan_row(const float *x, const float *y, size_t i, size_t j,
+                      size_t len, bool sorted, float best, size_t pair[2])
+{
+    for (; j < len; j++)
+    {
+        float dy = y[j] - y[i];
+        if (sorted && dy * dy >= best)
+        {
+            break;
+        }
+        float dx = x[j] - x[i];
+        float dist = dx * dx + dy * dy;
+        if (dist < best)
+        {
+            best = dist;
+            pair[0] = i;
+            pair[1] = j;
+        }
+    }
+    return best;
+}
+
+/**
+ * Scan a block.
+ * @brief Updates the best pair with the squared distances of point i to the
+ * points j to j+n-1, in this order.
+ * @return The new best squared distance.
+ */
+static float scan_block(const float *dists, size_t n, size_t i, size_t j,
+                        float best, size_t pair[2])
+{
+    for (size_t k = 0; k < n; k++)
+    {
+        if (dists[k] < best)
+        {
+            best = dists[k];
+            pair[0] = i;
+            pair[1] = j + k;
+        }
+    }
+    return best;
+}
+
+/**
+ * The scalar kernel.
+ * @brief See closest_pair_sq.
+ */
+static float closest_scalar(const float *x, const float *y, size_t len,
+                            bool sorted, float best, size_t pair[2])
+{
+    for (size_t i = 0; i + 1 < len; i++)
+    {
+        best = scan_row(x, y, i, i + 1, len, sorted, best, pair);
+    }
+    return best;
+}
+
+#ifdef PAIR_KERNEL_AVX2
+/**
+ * The AVX2 kernel.
+ * @brief See closest_pair_sq, compares 8 points per step.
+ * @details The last block of a row is loaded with a mask, so nothing after
+ * the arrays is read, and its missing lanes get an infinite distance.
+ */
+__attribute__((target("avx2"))) static float
+closest_avx2(const float *x, const float *y, size_t len, bool sorted,
+             float best, size_t pair[2])
+{
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256 infinity = _mm256_set1_ps(INFINITY);
+    for (size_t i = 0; i + 1 < len; i++)
+    {
+        __m256 xi = _mm256_set1_ps(x[i]);
+        __m256 yi = _mm256_set1_ps(y[i]);
+        for (size_t j = i + 1; j < len; j += 8)
+        {
+            float dy = y[j] - y[i];
+            if (sorted && dy * dy >= best)
+            {
+                break;
+            }
+            size_t n = len - j < 8 ? len - j : 8;
+            __m256i mask = _mm256_cmpgt_epi32(_mm256_set1_epi32((int)n), lane);
+            __m256 dxs = _mm256_sub_ps(_mm256_maskload_ps(x + j, mask), xi);
+            __m256 dys = _mm256_sub_ps(_mm256_maskload_ps(y + j, mask), yi);
+            __m256 dists = _mm256_add_ps(_mm256_mul_ps(dxs, dxs),
+                                         _mm256_mul_ps(dys, dys));
+            dists = _mm256_blendv_ps(infinity, dists,
+                                     _mm256_castsi256_ps(mask));
+            __m256 closer = _mm256_cmp_ps(dists, _mm256_set1_ps(best),
+                                          _CMP_LT_OQ);
+            if (_mm256_movemask_ps(closer) != 0)
+            {
+                float lanes[8];
+                _mm256_storeu_ps(lanes, dists);
+                best = scan_block(lanes, n, i, j, best, pair);
+            }
+        }
+    }
+    return best;
+}
+#endif
+
+#ifdef PAIR_KERNEL_NEON
+/**
+ * The NEON kernel.
+ * @brief See closest_pair_sq, compares 4 points per step.
+ */
+static float closest_neon(const float *x, const float *y, size_t len,
+                          bool sorted, float best, size_t pair[2])
+{
+    for (size_t i = 0; i + 1 < len; i++)
+    {
+        float32x4_t xi = vdupq_n_f32(x[i]);
+        float32x4_t yi = vdupq_n_f32(y[i]);
+        size_t j = i + 1;
+        bool done = false;
+        for (; j + 4 <= len; j += 4)
+        {
+            float dy = y[j] - y[i];
+            if (sorted && dy * dy >= best)
+            {
+                done = true;
+                break;
+            }
+            float32x4_t dxs = vsubq_f32(vld1q_f32(x + j), xi);
+            float32x4_t dys = vsubq_f32(vld1q_f32(y + j), yi);
+            float32x4_t dists = vaddq_f32(vmulq_f32(dxs, dxs),
+                                          vmulq_f32(dys, dys));
+            uint32x4_t closer = vcltq_f32(dists, vdupq_n_f32(best));
+            if (vmaxvq_u32(closer) != 0)
+            {
+                float lanes[4];
+                vst1q_f32(lanes, dists);
+                best = scan_block(lanes, 4, i, j, best, pair);
+            }
+        }
+        if (!done)
+        {
+            best = scan_row(x, y, i, j, len, sorted, best, pair);
+        }
+    }
+    return best;
+}
+#endif
+
+float closest_pair_sq(const float *x, const float *y, size_t len, bool sorted,
+                      float best, size_t pair[2])
+{
+#if defined(PAIR_KERNEL_AVX2)
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return closest_avx2(x, y, len, sorted, best, pair);
+    }
+#elif defined(PAIR_KERNEL_NEON)
+    return closest_neon(x, y, len, sorted, best, pair);
+#endif
+    return closest_scalar(x, y, len, sorted, best, pair);
+}
@@ -0,0 +1,44 @@
+/**
+ * @file pair_kernel.h
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief Squared distance kernel for the brute force leaves and the strip
+ * checks of cpair.
+ * @details The points are given as two arrays x[] and y[] (structure of
+ * arrays), so one vector register holds the coordinates of several points.
+ * All comparisons are done on squared distances, the caller only takes the
+ * square root if it needs the distance itself. The kernel is chosen at
+ * runtime: AVX2 (8 points per step) if the CPU supports it, NEON (4 points)
+ * on aarch64 and a scalar loop otherwise. All of them find the same pair.
+ */
+
+#ifndef PAIR_KERNEL_H
+#define PAIR_KERNEL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * Find the closest pair.
+ * @brief Searches the pair (i, j) with i < j < len and the smallest squared
+ * distance below best.
+ * @details Pairs are compared in the order of i and then j, of equally close
+ * pairs the first one is kept. If sorted is set, the points are sorted by y
+ * and every point is only compared to the following points less than the
+ * current best distance above it (the strip check), otherwise all pairs are
+ * compared (the brute force leaf).
+ * @param x The x-values of the points.
+ * @param y The y-values of the points.
+ * @param len The number of points.
+ * @param sorted Whether the points are sorted by y.
+ * @param best The squared distance a pair must be closer than (INFINITY for
+ * any pair).
+ * @param pair The indices of the closest pair, only written if one is closer
+ * than best.
+ * @return The squared distance of the closest pair, best if there is none.
+ */
+float closest_pair_sq(const float *x, const float *y, size_t len, bool sorted,
+                      float best, size_t pair[2]);
+
+#endif
@@ -0,0 +1,521 @@
+/**
+ * @file parallel_cpair.c
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief Implementation of the in-process engine of cpair.
+ * @details Every task is an index range of the shared point array. A task
+ * that is too big is split into two subtasks, which are pushed onto the deque
+ * of the executing thread. Threads take tasks from the back of their own deque
+ * and steal from the front of the others. When the second subtask of a task is
+ * finished, the thread which finished it also merges the range of the task, so
+ * no thread ever waits for another one.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <pthread.h>
+
+#include "parallel_cpair.h"
+#include "pair_kernel.h"
+
+/**
+ * Structure of a pair
+ * @brief A pair of points and the squared distance between them.
+ */
+typedef struct Pair
+{
+    Point p1;
+    Point p2;
+    float dist_sq;
+} Pair;
+
+/**
+ * Structure of the scratch space
+ * @brief Arrays as long as the point array, the strip of a range uses the
+ * indices of the range: its points and their coordinates for the kernel.
+ */
+typedef struct Scratch
+{
+    Point *points;
+    float *x;
+    float *y;
+} Scratch;
+
+/**
+ * Structure of a task
+ * @brief A range of the point array whose closest pair is searched.
+ */
+typedef struct Task
+{
+    size_t lo;
+    size_t hi;
+    float mid_x;
+    struct Task *parent;
+    struct Task *children[2];
+    int pending;
+    Pair result;
+} Task;
+
+/**
+ * Structure of a deque
+ * @brief The tasks of one thread, the owner uses the back and thieves the
+ * front.
+ */
+typedef struct Deque
+{
+    pthread_mutex_t lock;
+    Task **tasks;
+    size_t head;
+    size_t tail;
+    size_t cap;
+} Deque;
+
+/**
+ * Structure of the pool
+ * @brief The state shared by all threads.
+ */
+typedef struct Pool
+{
+    Point *points;
+    Scratch tmp;
+    int threads;
+    Deque *deques;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    size_t queued;
+    bool done;
+    bool failed;
+    int error;
+    Task *root;
+} Pool;
+
+/**
+ * Argument of a thread
+ * @brief The pool and the index of the deque of the thread.
+ */
+typedef struct Worker
+{
+    Pool *pool;
+    int id;
+} Worker;
+
+/**
+ * Compare two points by their x-value.
+ * @brief Comparison function for qsort to sort points by their x-value.
+ */
+static int compare_x(const void *a, const void *b)
+{
+    float xa = ((const Point *)a)->x;
+    float xb = ((const Point *)b)->x;
+    return (xa > xb) - (xa < xb);
+}
+
+/**
+ * Solve a small range by brute force.
+ * @brief Compares all pairs of the range with the kernel and sorts it by y
+ * afterwards (insertion sort).
+ * @param points The point array.
+ * @param lo The first index of the range.
+ * @param hi The index after the range.
+ * @return The closest pair (with an infinite distance for one point).
+ */
+static Pair brute_force(Point *points, size_t lo, size_t hi)
+{
+    float x[BRUTE_FORCE_LIMIT], y[BRUTE_FORCE_LIMIT];
+    for (size_t i = lo; i < hi; i++)
+    {
+        x[i - lo] = points[i].x;
+        y[i - lo] = points[i].y;
+    }
+
+    size_t pair[2];
+    Pair best = {.dist_sq = closest_pair_sq(x, y, hi - lo, false, INFINITY,
+                                            pair)};
+    if (best.dist_sq < INFINITY)
+    {
+        best.p1 = points[lo + pair[0]];
+        best.p2 = points[lo + pair[1]];
+    }
+
+    for (size_t i = lo + 1; i < hi; i++)
+    {
+        Point point = points[i];
+        size_t j = i;
+        for (; j > lo && points[j - 1].y > point.y; j--)
+        {
+            points[j] = points[j - 1];
+        }
+        points[j] = point;
+    }
+    return best;
+}
+
+/**
+ * Combine two halves.
+ * @brief Merges both halves (sorted by y) of the range and searches the
+ * strip around mid_x for a pair closer than the pairs of the halves.
+ * @param points The point array.
+ * @param tmp The scratch arrays.
+ * @param lo The first index of the range.
+ * @param mid The first index of the second half.
+ * @param hi The index after the range.
+ * @param mid_x The x-value which divided the halves.
+ * @param left The closest pair of the first half.
+ * @param right The closest pair of the second half.
+ * @return The closest pair of the range.
+ */
+static Pair combine(Point *points, Scratch *tmp, size_t lo, size_t mid,
+                    size_t hi, float mid_x, Pair left, Pair right)
+{
+    Pair best = left.dist_sq <= right.dist_sq ? left : right;
+
+    // Merge both halves by y
+    Point *merged = tmp->points;
+    size_t i = lo, j = mid, k = lo;
+    while (i < mid && j < hi)
+    {
+        merged[k++] = points[j].y < points[i].y ? points[j++] : points[i++];
+    }
+    while (i < mid)
+    {
+        merged[k++] = points[i++];
+    }
+    while (j < hi)
+    {
+        merged[k++] = points[j++];
+    }
+    memcpy(points + lo, merged + lo, (hi - lo) * sizeof(Point));
+
+    // Collect the strip (still sorted by y) in the scratch arrays
+    size_t strip_len = lo;
+    for (size_t n = lo; n < hi; n++)
+    {
+        float dx = points[n].x - mid_x;
+        if (dx * dx < best.dist_sq)
+        {
+            tmp->points[strip_len] = points[n];
+            tmp->x[strip_len] = points[n].x;
+            tmp->y[strip_len] = points[n].y;
+            strip_len++;
+        }
+    }
+
+    // Only points less than delta above can be closer than delta (at most 7)
+    size_t pair[2];
+    float dist_sq = closest_pair_sq(tmp->x + lo, tmp->y + lo, strip_len - lo,
+                                    true, best.dist_sq, pair);
+    if (dist_sq < best.dist_sq)
+    {
+        best.p1 = tmp->points[lo + pair[0]];
+        best.p2 = tmp->points[lo + pair[1]];
+        best.dist_sq = dist_sq;
+    }
+    return best;
+}
+
+/**
+ * Solve a range sequentially.
+ * @brief Finds the closest pair of the range recursively and sorts the range
+ * by y.
+ * @param points The point array (the range sorted by x).
+ * @param tmp The scratch arrays.
+ * @param lo The first index of the range.
+ * @param hi The index after the range.
+ * @return The closest pair of the range.
+ */
+static Pair solve(Point *points, Scratch *tmp, size_t lo, size_t hi)
+{
+    if (hi - lo <= BRUTE_FORCE_LIMIT)
+    {
+        return brute_force(points, lo, hi);
+    }
+
+    size_t mid = lo + (hi - lo) / 2;
+    float mid_x = points[mid].x;
+    Pair left = solve(points, tmp, lo, mid);
+    Pair right = solve(points, tmp, mid, hi);
+    return combine(points, tmp, lo, mid, hi, mid_x, left, right);
+}
+
+/**
+ * Stop the pool.
+ * @brief Marks the pool as done (and failed if error is not 0) and wakes up
+ * all threads.
+ */
+static void stop(Pool *pool, int error)
+{
+    pthread_mutex_lock(&pool->lock);
+    if (error != 0 && !pool->failed)
+    {
+        pool->failed = true;
+        pool->error = error;
+    }
+    pool->done = true;
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+}
+
+/**
+ * Push a task.
+ * @brief Pushes the task to the back of the deque of the thread.
+ * @return Upon success 0, otherwise -1.
+ */
+static int push(Pool *pool, int id, Task *task)
+{
+    Deque *deque = &pool->deques[id];
+    pthread_mutex_lock(&deque->lock);
+    if (deque->tail == deque->cap)
+    {
+        // Move the tasks to the beginning or grow the array
+        if (deque->head > 0)
+        {
+            memmove(deque->tasks, deque->tasks + deque->head,
+                    (deque->tail - deque->head) * sizeof(Task *));
+            deque->tail -= deque->head;
+            deque->head = 0;
+        }
+        else
+        {
+            size_t cap = deque->cap == 0 ? 16 : deque->cap * 2;
+            Task **tasks = realloc(deque->tasks, cap * sizeof(Task *));
+            if (tasks == NULL)
+            {
+                pthread_mutex_unlock(&deque->lock);
+                return -1;
+            }
+            deque->tasks = tasks;
+            deque->cap = cap;
+        }
+    }
+    deque->tasks[deque->tail++] = task;
+    pthread_mutex_unlock(&deque->lock);
+
+    pthread_mutex_lock(&pool->lock);
+    pool->queued++;
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/**
+ * Take a task.
+ * @brief Takes a task from the back of the own deque or steals one from the
+ * front of another deque.
+ * @return The task or NULL if all deques are empty.
+ */
+static Task *take(Pool *pool, int id)
+{
+    Task *task = NULL;
+    for (int n = 0; n < pool->threads && task == NULL; n++)
+    {
+        Deque *deque = &pool->deques[(id + n) % pool->threads];
+        pthread_mutex_lock(&deque->lock);
+        if (deque->head < deque->tail)
+        {
+            task = n == 0 ? deque->tasks[--deque->tail]
+                          : deque->tasks[deque->head++];
+        }
+        if (deque->head == deque->tail)
+        {
+            deque->head = 0;
+            deque->tail = 0;
+        }
+        pthread_mutex_unlock(&deque->lock);
+    }
+
+    if (task != NULL)
+    {
+        pthread_mutex_lock(&pool->lock);
+        pool->queued--;
+        pthread_mutex_unlock(&pool->lock);
+    }
+    return task;
+}
+
+/**
+ * Complete a task.
+ * @brief Reports the result of a finished task to its parent. The thread
+ * that finishes the last subtask combines the parent, which then is reported
+ * to its parent too.
+ */
+static void complete(Pool *pool, Task *task)
+{
+    while (task->parent != NULL)
+    {
+        Task *parent = task->parent;
+        if (__atomic_sub_fetch(&parent->pending, 1, __ATOMIC_ACQ_REL) != 0)
+        {
+            return;
+        }
+
+        size_t mid = parent->children[1]->lo;
+        parent->result = combine(pool->points, &pool->tmp, parent->lo, mid,
+                                 parent->hi, parent->mid_x,
+                                 parent->children[0]->result,
+                                 parent->children[1]->result);
+        free(parent->children[0]);
+        free(parent->children[1]);
+        task = parent;
+    }
+    stop(pool, 0);
+}
+
+/**
+ * Run a task.
+ * @brief Solves small tasks sequentially and splits big tasks into two
+ * subtasks.
+ */
+static void run(Pool *pool, int id, Task *task)
+{
+    if (task->hi - task->lo <= TASK_LIMIT)
+    {
+        task->result = solve(pool->points, &pool->tmp, task->lo, task->hi);
+        complete(pool, task);
+        return;
+    }
+
+    size_t mid = task->lo + (task->hi - task->lo) / 2;
+    task->mid_x = pool->points[mid].x;
+    task->pending = 2;
+    for (int i = 0; i < 2; i++)
+    {
+        Task *child = calloc(1, sizeof(Task));
+        if (child == NULL)
+        {
+            stop(pool, errno);
+            return;
+        }
+        child->lo = i == 0 ? task->lo : mid;
+        child->hi = i == 0 ? mid : task->hi;
+        child->parent = task;
+        task->children[i] = child;
+    }
+    if (push(pool, id, task->children[1]) == -1 ||
+        push(pool, id, task->children[0]) == -1)
+    {
+        stop(pool, ENOMEM);
+    }
+}
+
+/**
+ * Thread function.
+ * @brief Runs tasks until the pool is done.
+ */
+static void *work(void *arg)
+{
+    Worker *worker = arg;
+    Pool *pool = worker->pool;
+    while (true)
+    {
+        Task *task = take(pool, worker->id);
+        if (task != NULL)
+        {
+            run(pool, worker->id, task);
+            continue;
+        }
+
+        pthread_mutex_lock(&pool->lock);
+        while (pool->queued == 0 && !pool->done)
+        {
+            pthread_cond_wait(&pool->cond, &pool->lock);
+        }
+        bool done = pool->done;
+        pthread_mutex_unlock(&pool->lock);
+        if (done)
+        {
+            return NULL;
+        }
+    }
+}
+
+int parallel_closest_pair(Point *points, size_t len, int threads,
+                          Point result[2])
+{
+    qsort(points, len, sizeof(Point), compare_x);
+
+    Pool pool = {.points = points, .threads = threads};
+    pool.tmp.points = malloc(len * sizeof(Point));
+    pool.tmp.x = malloc(len * sizeof(float));
+    pool.tmp.y = malloc(len * sizeof(float));
+    pool.deques = calloc(threads, sizeof(Deque));
+    pool.root = calloc(1, sizeof(Task));
+    Worker *workers = malloc(threads * sizeof(Worker));
+    pthread_t *ids = malloc(threads * sizeof(pthread_t));
+    if (pool.tmp.points == NULL || pool.tmp.x == NULL || pool.tmp.y == NULL ||
+        pool.deques == NULL || pool.root == NULL ||
+        workers == NULL || ids == NULL)
+    {
+        free(pool.tmp.points);
+        free(pool.tmp.x);
+        free(pool.tmp.y);
+        free(pool.deques);
+        free(pool.root);
+        free(workers);
+        free(ids);
+        errno = ENOMEM;
+        return -1;
+    }
+
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.cond, NULL);
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_init(&pool.deques[i].lock, NULL);
+        workers[i].pool = &pool;
+        workers[i].id = i;
+    }
+
+    // The calling thread is the first worker
+    pool.root->lo = 0;
+    pool.root->hi = len;
+    int started = 1;
+    if (push(&pool, 0, pool.root) == -1)
+    {
+        stop(&pool, ENOMEM);
+    }
+    for (; started < threads; started++)
+    {
+        int error = pthread_create(&ids[started], NULL, work,
+                                   &workers[started]);
+        if (error != 0)
+        {
+            stop(&pool, error);
+            break;
+        }
+    }
+    work(&workers[0]);
+    for (int i = 1; i < started; i++)
+    {
+        pthread_join(ids[i], NULL);
+    }
+
+    result[0] = pool.root->result.p1;
+    result[1] = pool.root->result.p2;
+    int error = pool.failed ? pool.error : 0;
+
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_mutex_destroy(&pool.deques[i].lock);
+        free(pool.deques[i].tasks);
+    }
+    pthread_cond_destroy(&pool.cond);
+    pthread_mutex_destroy(&pool.lock);
+    free(pool.root);
+    free(pool.deques);
+    free(pool.tmp.points);
+    free(pool.tmp.x);
+    free(pool.tmp.y);
+    free(workers);
+    free(ids);
+
+    if (error != 0)
+    {
+        errno = error;
+        return -1;
+    }
+    return 0;
+}
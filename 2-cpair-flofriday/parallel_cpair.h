@@ -0,0 +1,55 @@
+/**
+ * @file parallel_cpair.h
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief In-process engine of cpair that shares one point array between
+ * threads instead of piping the points to children.
+ */
+
+#ifndef PARALLEL_CPAIR_H
+#define PARALLEL_CPAIR_H
+
+#include <stddef.h>
+
+/**
+ * Structure of a point
+ * @brief The strucutre of a point in two dimensional space.
+ */
+typedef struct Point
+{
+    float x;
+    float y;
+} Point;
+
+/**
+ * Ranges with at most this many points are solved by brute force.
+ */
+#define BRUTE_FORCE_LIMIT 16
+
+/**
+ * Ranges with at most this many points are solved sequentially by one thread
+ * instead of being split into two tasks.
+ */
+#define TASK_LIMIT 8192
+
+/**
+ * Find the closest pair with threads.
+ * @brief Finds the closest pair of the points with the divide and conquer
+ * algorithm on a pool of threads.
+ * @details The points are sorted by x once, every range of the array is split
+ * in the middle and sorted by y while its halves are merged, so the strip
+ * around the middle is found in y order and every point of it is compared to
+ * at most 7 following points. Big ranges are split into tasks, which are
+ * executed by the threads with work stealing.
+ * The order of the points is changed.
+ * @param points An array of all points (at least two).
+ * @param len The number of elements in points.
+ * @param threads The number of threads (at least one).
+ * @param result An array of two points the closest pair is written to.
+ * @return Upon success 0, otherwise -1 (errno is set).
+ */
+int parallel_closest_pair(Point *points, size_t len, int threads,
+                          Point result[2]);
+
+#endif
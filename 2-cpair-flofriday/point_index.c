@@ -0,0 +1,674 @@
+/**
+ * @file point_index.c
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief Implementation of the grid index of cpair.
+ * @details The points are stored in an array (deleted slots are reused) and
+ * their ids are stored in the cell of their coordinates. The cells are kept in
+ * a hash table (open addressing), so points can be inserted anywhere without
+ * a fixed bounding box. The cell size is chosen so that there is about one
+ * point per cell and is adjusted by a rebuild when the number of points
+ * changed a lot.
+ */
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "point_index.h"
+
+/**
+ * @brief Marks that no point should be excluded from a search.
+ */
+#define NO_ID SIZE_MAX
+
+/**
+ * Structure of a cell
+ * @brief A cell of the grid with the ids of its points.
+ */
+typedef struct Cell
+{
+    long cx;
+    long cy;
+    size_t *ids;
+    size_t count;
+    size_t cap;
+    bool used;
+} Cell;
+
+/**
+ * Structure of a candidate
+ * @brief A point found by a search and its distance to the query.
+ */
+typedef struct Candidate
+{
+    float dist;
+    size_t id;
+} Candidate;
+
+struct PointIndex
+{
+    // The points, alive marks deleted slots
+    Point *points;
+    bool *alive;
+    size_t used;
+    size_t cap;
+    size_t count;
+    size_t *free_ids;
+    size_t free_len;
+
+    // The grid
+    float cell;
+    Cell *table;
+    size_t table_cap;
+    size_t cells;
+    long min_cx, max_cx, min_cy, max_cy;
+    size_t built_count;
+
+    // The closest pair, recomputed if best_valid is false
+    bool best_valid;
+    size_t best_a;
+    size_t best_b;
+    float best_dist;
+};
+
+/**
+ * Calculate the distance between two points
+ * @brief Calculates the euclidean distance between two Points p1 and p2.
+ */
+static float distance(const Point *p1, const Point *p2)
+{
+    float a = p2->x - p1->x;
+    float b = p2->y - p1->y;
+    return sqrtf(a * a + b * b);
+}
+
+/**
+ * Hash of a cell.
+ * @brief Mixes both cell coordinates into one hash value.
+ */
+static size_t hash_cell(long cx, long cy)
+{
+    uint64_t h = (uint64_t)cx * 0x9E3779B97F4A7C15ULL ^
+                 (uint64_t)cy * 0xC2B2AE3D27D4EB4FULL;
+    return (size_t)(h ^ (h >> 29));
+}
+
+/**
+ * Find a cell.
+ * @brief Looks up the cell in the hash table.
+ * @return The cell or NULL if it doesn't exist.
+ */
+static Cell *find_cell(PointIndex *index, long cx, long cy)
+{
+    size_t mask = index->table_cap - 1;
+    for (size_t i = hash_cell(cx, cy) & mask;; i = (i + 1) & mask)
+    {
+        Cell *cell = &index->table[i];
+        if (!cell->used)
+        {
+            return NULL;
+        }
+        if (cell->cx == cx && cell->cy == cy)
+        {
+            return cell;
+        }
+    }
+}
+
+/**
+ * Create a cell.
+ * @brief Returns the cell with the coordinates, which is created if it doesn't
+ * exist yet. The table is grown if it is half full.
+ * @return The cell or NULL if there wasn't enough memory.
+ */
+static Cell *get_cell(PointIndex *index, long cx, long cy)
+{
+    Cell *cell = find_cell(index, cx, cy);
+    if (cell != NULL)
+    {
+        return cell;
+    }
+
+    if (2 * (index->cells + 1) > index->table_cap)
+    {
+        size_t cap = index->table_cap * 2;
+        Cell *table = calloc(cap, sizeof(Cell));
+        if (table == NULL)
+        {
+            return NULL;
+        }
+        for (size_t i = 0; i < index->table_cap; i++)
+        {
+            Cell *old = &index->table[i];
+            if (!old->used)
+            {
+                continue;
+            }
+            size_t j = hash_cell(old->cx, old->cy) & (cap - 1);
+            while (table[j].used)
+            {
+                j = (j + 1) & (cap - 1);
+            }
+            table[j] = *old;
+        }
+        free(index->table);
+        index->table = table;
+        index->table_cap = cap;
+    }
+
+    size_t mask = index->table_cap - 1;
+    size_t i = hash_cell(cx, cy) & mask;
+    while (index->table[i].used)
+    {
+        i = (i + 1) & mask;
+    }
+    cell = &index->table[i];
+    cell->used = true;
+    cell->cx = cx;
+    cell->cy = cy;
+    index->cells++;
+
+    if (index->cells == 1)
+    {
+        index->min_cx = index->max_cx = cx;
+        index->min_cy = index->max_cy = cy;
+    }
+    index->min_cx = cx < index->min_cx ? cx : index->min_cx;
+    index->max_cx = cx > index->max_cx ? cx : index->max_cx;
+    index->min_cy = cy < index->min_cy ? cy : index->min_cy;
+    index->max_cy = cy > index->max_cy ? cy : index->max_cy;
+    return cell;
+}
+
+/**
+ * The cell coordinate of a value.
+ */
+static long cell_coord(const PointIndex *index, float v)
+{
+    return (long)floorf(v / index->cell);
+}
+
+/**
+ * Add a point to the grid.
+ * @brief Adds the id to the cell of its point.
+ * @return Upon success 0, otherwise -1.
+ */
+static int grid_add(PointIndex *index, size_t id)
+{
+    Point *point = &index->points[id];
+    Cell *cell = get_cell(index, cell_coord(index, point->x),
+                          cell_coord(index, point->y));
+    if (cell == NULL)
+    {
+        return -1;
+    }
+    if (cell->count == cell->cap)
+    {
+        size_t cap = cell->cap == 0 ? 2 : cell->cap * 2;
+        size_t *ids = realloc(cell->ids, cap * sizeof(size_t));
+        if (ids == NULL)
+        {
+            return -1;
+        }
+        cell->ids = ids;
+        cell->cap = cap;
+    }
+    cell->ids[cell->count++] = id;
+    return 0;
+}
+
+/**
+ * Build the grid.
+ * @brief Chooses the cell size for the current points (about one point per
+ * cell) and adds all points to a new grid.
+ * @return Upon success 0, otherwise -1.
+ */
+static int grid_build(PointIndex *index)
+{
+    float min_x = INFINITY, max_x = -INFINITY;
+    float min_y = INFINITY, max_y = -INFINITY;
+    for (size_t id = 0; id < index->used; id++)
+    {
+        if (!index->alive[id])
+        {
+            continue;
+        }
+        Point *p = &index->points[id];
+        min_x = fminf(min_x, p->x);
+        max_x = fmaxf(max_x, p->x);
+        min_y = fminf(min_y, p->y);
+        max_y = fmaxf(max_y, p->y);
+    }
+
+    float width = max_x - min_x;
+    float height = max_y - min_y;
+    size_t n = index->count > 0 ? index->count : 1;
+    float cell = 1;
+    if (width > 0 && height > 0)
+    {
+        cell = sqrtf(width * height / n);
+    }
+    else if (width > 0 || height > 0)
+    {
+        cell = fmaxf(width, height) / n;
+    }
+    index->cell = cell > 0 && isfinite(cell) ? cell : 1;
+
+    // Free the old grid
+    if (index->table != NULL)
+    {
+        for (size_t i = 0; i < index->table_cap; i++)
+        {
+            free(index->table[i].ids);
+        }
+        free(index->table);
+    }
+    index->table_cap = 16;
+    while (index->table_cap < 4 * n)
+    {
+        index->table_cap *= 2;
+    }
+    index->table = calloc(index->table_cap, sizeof(Cell));
+    index->cells = 0;
+    if (index->table == NULL)
+    {
+        index->table_cap = 0;
+        return -1;
+    }
+
+    for (size_t id = 0; id < index->used; id++)
+    {
+        if (index->alive[id] && grid_add(index, id) == -1)
+        {
+            return -1;
+        }
+    }
+    index->built_count = index->count;
+    return 0;
+}
+
+/**
+ * Add a candidate.
+ * @brief Adds the candidate to the max-heap of the k best candidates.
+ * @return The new number of candidates in the heap.
+ */
+static size_t heap_add(Candidate *heap, size_t len, size_t k, Candidate c)
+{
+    size_t i;
+    if (len < k)
+    {
+        // Sift up the new candidate
+        i = len++;
+        while (i > 0 && heap[(i - 1) / 2].dist < c.dist)
+        {
+            heap[i] = heap[(i - 1) / 2];
+            i = (i - 1) / 2;
+        }
+        heap[i] = c;
+        return len;
+    }
+    if (c.dist >= heap[0].dist)
+    {
+        return len;
+    }
+
+    // Replace the worst candidate and sift it down
+    i = 0;
+    while (2 * i + 1 < len)
+    {
+        size_t child = 2 * i + 1;
+        if (child + 1 < len && heap[child + 1].dist > heap[child].dist)
+        {
+            child++;
+        }
+        if (heap[child].dist <= c.dist)
+        {
+            break;
+        }
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = c;
+    return len;
+}
+
+/**
+ * Search a cell.
+ * @brief Adds all points of the cell closer than limit to the heap.
+ * @return The new number of candidates in the heap.
+ */
+static size_t search_cell(PointIndex *index, long cx, long cy, Point *query,
+                          size_t exclude, float limit, Candidate *heap,
+                          size_t len, size_t k)
+{
+    Cell *cell = find_cell(index, cx, cy);
+    if (cell == NULL)
+    {
+        return len;
+    }
+    for (size_t i = 0; i < cell->count; i++)
+    {
+        size_t id = cell->ids[i];
+        if (id == exclude)
+        {
+            continue;
+        }
+        Candidate c = {distance(query, &index->points[id]), id};
+        if (c.dist < limit)
+        {
+            len = heap_add(heap, len, k, c);
+        }
+    }
+    return len;
+}
+
+/**
+ * Search the nearest points.
+ * @brief Searches the rings of cells (clipped to the bounds of the grid)
+ * around the query until no point outside the searched rings can be better.
+ * @param index The index.
+ * @param query The point of the query.
+ * @param k The number of points to find.
+ * @param exclude An id which is ignored or NO_ID.
+ * @param limit Only points closer than limit are found.
+ * @param heap An array of k candidates, which is a max-heap afterwards.
+ * @return The number of candidates found.
+ */
+static size_t search(PointIndex *index, Point *query, size_t k,
+                     size_t exclude, float limit, Candidate *heap)
+{
+    if (index->cells == 0 || k == 0)
+    {
+        return 0;
+    }
+
+    long cx = cell_coord(index, query->x);
+    long cy = cell_coord(index, query->y);
+
+    // The rings closer than start don't contain any cells
+    long start = 0;
+    start = index->min_cx - cx > start ? index->min_cx - cx : start;
+    start = cx - index->max_cx > start ? cx - index->max_cx : start;
+    start = index->min_cy - cy > start ? index->min_cy - cy : start;
+    start = cy - index->max_cy > start ? cy - index->max_cy : start;
+
+    size_t len = 0;
+    for (long r = start;; r++)
+    {
+        long x0 = cx - r > index->min_cx ? cx - r : index->min_cx;
+        long x1 = cx + r < index->max_cx ? cx + r : index->max_cx;
+        long y0 = cy - r > index->min_cy ? cy - r : index->min_cy;
+        long y1 = cy + r < index->max_cy ? cy + r : index->max_cy;
+
+        // The rows at the top and bottom and the columns at both sides
+        for (long x = x0; x <= x1; x++)
+        {
+            if (cy - r >= index->min_cy)
+            {
+                len = search_cell(index, x, cy - r, query, exclude, limit,
+                                  heap, len, k);
+            }
+            if (r > 0 && cy + r <= index->max_cy)
+            {
+                len = search_cell(index, x, cy + r, query, exclude, limit,
+                                  heap, len, k);
+            }
+        }
+        for (long y = y0; y <= y1; y++)
+        {
+            if (y == cy - r || y == cy + r)
+            {
+                continue;
+            }
+            if (cx - r >= index->min_cx)
+            {
+                len = search_cell(index, cx - r, y, query, exclude, limit,
+                                  heap, len, k);
+            }
+            if (r > 0 && cx + r <= index->max_cx)
+            {
+                len = search_cell(index, cx + r, y, query, exclude, limit,
+                                  heap, len, k);
+            }
+        }
+
+        // Points outside of this ring are at least r cells away
+        float reach = r * index->cell;
+        if ((len == k && heap[0].dist <= reach) || reach >= limit)
+        {
+            break;
+        }
+        if (cx - r <= index->min_cx && cx + r >= index->max_cx &&
+            cy - r <= index->min_cy && cy + r >= index->max_cy)
+        {
+            break;
+        }
+    }
+    return len;
+}
+
+/**
+ * Recompute the closest pair.
+ * @brief Searches the nearest neighbour of every point, only points closer
+ * than the best pair so far are considered.
+ */
+static void recompute_best(PointIndex *index)
+{
+    index->best_dist = INFINITY;
+    for (size_t id = 0; id < index->used; id++)
+    {
+        if (!index->alive[id])
+        {
+            continue;
+        }
+        Candidate c;
+        if (search(index, &index->points[id], 1, id, index->best_dist, &c) == 1)
+        {
+            index->best_a = id;
+            index->best_b = c.id;
+            index->best_dist = c.dist;
+        }
+    }
+    index->best_valid = index->count >= 2;
+}
+
+PointIndex *index_create(const Point *points, size_t len)
+{
+    PointIndex *index = calloc(1, sizeof(PointIndex));
+    if (index == NULL)
+    {
+        return NULL;
+    }
+    index->cap = len > 16 ? len : 16;
+    index->points = malloc(index->cap * sizeof(Point));
+    index->alive = malloc(index->cap * sizeof(bool));
+    index->free_ids = malloc(index->cap * sizeof(size_t));
+    if (index->points == NULL || index->alive == NULL ||
+        index->free_ids == NULL)
+    {
+        index_free(index);
+        return NULL;
+    }
+    memcpy(index->points, points, len * sizeof(Point));
+    memset(index->alive, true, len * sizeof(bool));
+    index->used = len;
+    index->count = len;
+
+    if (grid_build(index) == -1)
+    {
+        index_free(index);
+        return NULL;
+    }
+    return index;
+}
+
+void index_free(PointIndex *index)
+{
+    if (index->table != NULL)
+    {
+        for (size_t i = 0; i < index->table_cap; i++)
+        {
+            free(index->table[i].ids);
+        }
+    }
+    free(index->table);
+    free(index->points);
+    free(index->alive);
+    free(index->free_ids);
+    free(index);
+}
+
+size_t index_size(const PointIndex *index)
+{
+    return index->count;
+}
+
+int index_insert(PointIndex *index, Point point)
+{
+    size_t id;
+    if (index->free_len > 0)
+    {
+        id = index->free_ids[--index->free_len];
+    }
+    else
+    {
+        if (index->used == index->cap)
+        {
+            size_t cap = index->cap * 2;
+            Point *points = realloc(index->points, cap * sizeof(Point));
+            if (points == NULL)
+            {
+                return -1;
+            }
+            index->points = points;
+            bool *alive = realloc(index->alive, cap * sizeof(bool));
+            if (alive == NULL)
+            {
+                return -1;
+            }
+            index->alive = alive;
+            size_t *free_ids = realloc(index->free_ids, cap * sizeof(size_t));
+            if (free_ids == NULL)
+            {
+                return -1;
+            }
+            index->free_ids = free_ids;
+            index->cap = cap;
+        }
+        id = index->used++;
+    }
+    index->points[id] = point;
+    index->alive[id] = true;
+    index->count++;
+    if (grid_add(index, id) == -1)
+    {
+        index->alive[id] = false;
+        index->count--;
+        index->free_ids[index->free_len++] = id;
+        return -1;
+    }
+
+    // Only a pair with the new point can be closer than the closest pair
+    if (index->best_valid)
+    {
+        Candidate c;
+        if (search(index, &point, 1, id, index->best_dist, &c) == 1)
+        {
+            index->best_a = id;
+            index->best_b = c.id;
+            index->best_dist = c.dist;
+        }
+    }
+
+    if (index->count > INDEX_REBUILD_FACTOR * index->built_count)
+    {
+        return grid_build(index);
+    }
+    return 0;
+}
+
+int index_delete(PointIndex *index, Point point)
+{
+    if (index->cells == 0)
+    {
+        return 1;
+    }
+    Cell *cell = find_cell(index, cell_coord(index, point.x),
+                           cell_coord(index, point.y));
+    if (cell == NULL)
+    {
+        return 1;
+    }
+
+    for (size_t i = 0; i < cell->count; i++)
+    {
+        size_t id = cell->ids[i];
+        if (index->points[id].x != point.x || index->points[id].y != point.y)
+        {
+            continue;
+        }
+
+        cell->ids[i] = cell->ids[--cell->count];
+        index->alive[id] = false;
+        index->free_ids[index->free_len++] = id;
+        index->count--;
+        if (id == index->best_a || id == index->best_b)
+        {
+            index->best_valid = false;
+        }
+
+        if (INDEX_REBUILD_FACTOR * index->count < index->built_count)
+        {
+            grid_build(index);
+        }
+        return 0;
+    }
+    return 1;
+}
+
+int index_closest_pair(PointIndex *index, Point result[2])
+{
+    if (index->count < 2)
+    {
+        return -1;
+    }
+    if (!index->best_valid)
+    {
+        recompute_best(index);
+    }
+    result[0] = index->points[index->best_a];
+    result[1] = index->points[index->best_b];
+    return 0;
+}
+
+/**
+ * Compare two candidates by their distance (for qsort).
+ */
+static int compare_candidates(const void *a, const void *b)
+{
+    float da = ((const Candidate *)a)->dist;
+    float db = ((const Candidate *)b)->dist;
+    return (da > db) - (da < db);
+}
+
+long index_nearest(PointIndex *index, Point point, size_t k, Point *result)
+{
+    Candidate *heap = malloc((k > 0 ? k : 1) * sizeof(Candidate));
+    if (heap == NULL)
+    {
+        return -1;
+    }
+    size_t len = search(index, &point, k, NO_ID, INFINITY, heap);
+
+    qsort(heap, len, sizeof(Candidate), compare_candidates);
+    for (size_t i = 0; i < len; i++)
+    {
+        result[i] = index->points[heap[i].id];
+    }
+    free(heap);
+    return (long)len;
+}
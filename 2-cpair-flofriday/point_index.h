@@ -0,0 +1,95 @@
+/**
+ * @file point_index.h
+ * @author flofriday <eXXXXXXXX@students.tuwien.ac.at>
+ * date: 27.11.2020
+ *
+ * @brief A uniform grid over a set of points, which answers closest pair and
+ * nearest neighbour queries while points are inserted and deleted.
+ */
+
+#ifndef POINT_INDEX_H
+#define POINT_INDEX_H
+
+#include <stddef.h>
+
+#include "parallel_cpair.h"
+
+/**
+ * @brief The grid is rebuilt with a new cell size when the number of points
+ * changed by this factor since the last build.
+ */
+#define INDEX_REBUILD_FACTOR 4
+
+/**
+ * @brief The opaque structure of the index.
+ */
+typedef struct PointIndex PointIndex;
+
+/**
+ * Create an index.
+ * @brief Builds the grid over the points (which are copied).
+ * @param points An array of points.
+ * @param len The number of elements in points.
+ * @return The index or NULL if there wasn't enough memory.
+ */
+PointIndex *index_create(const Point *points, size_t len);
+
+/**
+ * Free an index.
+ * @brief Frees all memory of the index.
+ * @param index The index.
+ */
+void index_free(PointIndex *index);
+
+/**
+ * The number of points.
+ * @param index The index.
+ * @return The number of points in the index.
+ */
+size_t index_size(const PointIndex *index);
+
+/**
+ * Insert a point.
+ * @brief Inserts the point into the grid and updates the closest pair with
+ * the nearest neighbour of the point.
+ * @param index The index.
+ * @param point The new point.
+ * @return Upon success 0, otherwise -1.
+ */
+int index_insert(PointIndex *index, Point point);
+
+/**
+ * Delete a point.
+ * @brief Deletes one point with the same coordinates. The closest pair is
+ * only recomputed (by the next query) if the point was part of it.
+ * @param index The index.
+ * @param point The point to delete.
+ * @return 0 if the point was deleted, 1 if there is no such point.
+ */
+int index_delete(PointIndex *index, Point point);
+
+/**
+ * Get the closest pair.
+ * @brief Returns the closest pair, which is recomputed with the grid if a
+ * point of it was deleted.
+ * @param index The index.
+ * @param result An array of two points the closest pair is written to.
+ * @return Upon success 0, -1 if there are less than two points.
+ */
+int index_closest_pair(PointIndex *index, Point result[2]);
+
+/**
+ * Find the nearest points.
+ * @brief Searches the rings of cells around the point until the k nearest
+ * points are known.
+ * @param index The index.
+ * @param point The point of the query (doesn't need to be in the index).
+ * @param k The number of points to find.
+ * @param result An array of k points the nearest points are written to
+ * (nearest first).
+ * @return The number of points found (less than k if the index is smaller),
+ * -1 if there wasn't enough memory.
+ */
+long index_nearest(PointIndex *index, Point point, size_t k, Point *result);
+
+#endif
@@ -0,0 +1,235 @@
+/**
+ * @file fft_kernel.c
+ * @author Jonny X <e12345678@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief The butterfly kernels of the iterative FFT.
+ *
+ * @details The kernels use the vector extension of GCC, which is compiled to AVX or SSE on x86
+ * and to NEON on ARM (a vector wider than the hardware is split into several registers).
+ * The loads and stores go through memcpy, the arrays don't need to be aligned.
+ **/
+
+#include "fft_kernel.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+// The number of values of a vector.
+#define DOUBLE_LANES 4
+#define FLOAT_LANES 8
+
+typedef double double_vector __attribute__((vector_size(DOUBLE_LANES * sizeof(double))));
+typedef float float_vector __attribute__((vector_size(FLOAT_LANES * sizeof(float))));
+
+/**
+ * @brief
+ * Computes butterflies in double precision.
+ *
+ * @details
+ * For every k: t = w[k] * odd[k], even[k] = even[k] + t, odd[k] = even[k] - t.
+**/
+static void butterflies_double(double *even_re, double *even_im, double *odd_re, double *odd_im,
+                               const double *tw_re, const double *tw_im, size_t count)
+{
+    size_t k = 0;
+    for (; k + DOUBLE_LANES <= count; k += DOUBLE_LANES)
+    {
+        double_vector er, ei, or, oi, wr, wi;
+        memcpy(&er, even_re + k, sizeof(er));
+        memcpy(&ei, even_im + k, sizeof(ei));
+        memcpy(&or, odd_re + k, sizeof(or));
+        memcpy(&oi, odd_im + k, sizeof(oi));
+        memcpy(&wr, tw_re + k, sizeof(wr));
+        memcpy(&wi, tw_im + k, sizeof(wi));
+
+        double_vector tr = wr * or - wi * oi;
+        double_vector ti = wr * oi + wi * or;
+        double_vector sum_re = er + tr;
+        double_vector sum_im = ei + ti;
+        double_vector diff_re = er - tr;
+        double_vector diff_im = ei - ti;
+
+        memcpy(even_re + k, &sum_re, sizeof(sum_re));
+        memcpy(even_im + k, &sum_im, sizeof(sum_im));
+        memcpy(odd_re + k, &diff_re, sizeof(diff_re));
+        memcpy(odd_im + k, &diff_im, sizeof(diff_im));
+    }
+
+    // The rest (and the first stages, which have less butterflies per block than a vector)
+    for (; k < count; k++)
+    {
+        double tr = tw_re[k] * odd_re[k] - tw_im[k] * odd_im[k];
+        double ti = tw_re[k] * odd_im[k] + tw_im[k] * odd_re[k];
+        odd_re[k] = even_re[k] - tr;
+        odd_im[k] = even_im[k] - ti;
+        even_re[k] += tr;
+        even_im[k] += ti;
+    }
+}
+
+/**
+ * @brief
+ * Computes butterflies in single precision.
+ *
+ * @details
+ * The same as butterflies_double with float values.
+**/
+static void butterflies_float(float *even_re, float *even_im, float *odd_re, float *odd_im,
+                              const float *tw_re, const float *tw_im, size_t count)
+{
+    size_t k = 0;
+    for (; k + FLOAT_LANES <= count; k += FLOAT_LANES)
+    {
+        float_vector er, ei, or, oi, wr, wi;
+        memcpy(&er, even_re + k, sizeof(er));
+        memcpy(&ei, even_im + k, sizeof(ei));
+        memcpy(&or, odd_re + k, sizeof(or));
+        memcpy(&oi, odd_im + k, sizeof(oi));
+        memcpy(&wr, tw_re + k, sizeof(wr));
+        memcpy(&wi, tw_im + k, sizeof(wi));
+
+        float_vector tr = wr * or - wi * oi;
+        float_vector ti = wr * oi + wi * or;
+        float_vector sum_re = er + tr;
+        float_vector sum_im = ei + ti;
+        float_vector diff_re = er - tr;
+        float_vector diff_im = ei - ti;
+
+        memcpy(even_re + k, &sum_re, sizeof(sum_re));
+        memcpy(even_im + k, &sum_im, sizeof(sum_im));
+        memcpy(odd_re + k, &diff_re, sizeof(diff_re));
+        memcpy(odd_im + k, &diff_im, sizeof(diff_im));
+    }
+
+    for (; k < count; k++)
+    {
+        float tr = tw_re[k] * odd_re[k] - tw_im[k] * odd_im[k];
+        float ti = tw_re[k] * odd_im[k] + tw_im[k] * odd_re[k];
+        odd_re[k] = even_re[k] - tr;
+        odd_im[k] = even_im[k] - ti;
+        even_re[k] += tr;
+        even_im[k] += ti;
+    }
+}
+
+int fft_data_alloc(struct fft_data *data, size_t n, enum fft_precision precision)
+{
+    size_t size = precision == FFT_DOUBLE ? sizeof(double) : sizeof(float);
+    data->precision = precision;
+    data->n = n;
+    data->owns_twiddles = true;
+    data->re = malloc(n * size);
+    data->im = malloc(n * size);
+    data->tw_re = malloc(n * size);
+    data->tw_im = malloc(n * size);
+    if (data->re == NULL || data->im == NULL || data->tw_re == NULL || data->tw_im == NULL)
+    {
+        fft_data_free(data);
+        return -1;
+    }
+
+    // The factors are always computed in double, the float ones are rounded afterwards
+    for (size_t half = 1; half < n; half *= 2)
+    {
+        for (size_t j = 0; j < half; j++)
+        {
+            double angle = -M_PI * j / half;
+            if (precision == FFT_DOUBLE)
+            {
+                ((double *)data->tw_re)[half - 1 + j] = cos(angle);
+                ((double *)data->tw_im)[half - 1 + j] = sin(angle);
+            }
+            else
+            {
+                ((float *)data->tw_re)[half - 1 + j] = cos(angle);
+                ((float *)data->tw_im)[half - 1 + j] = sin(angle);
+            }
+        }
+    }
+    return 0;
+}
+
+int fft_data_alloc_like(struct fft_data *data, const struct fft_data *plan)
+{
+    size_t size = plan->precision == FFT_DOUBLE ? sizeof(double) : sizeof(float);
+    *data = *plan;
+    data->owns_twiddles = false;
+    data->re = malloc(plan->n * size);
+    data->im = malloc(plan->n * size);
+    if (data->re == NULL || data->im == NULL)
+    {
+        fft_data_free(data);
+        return -1;
+    }
+    return 0;
+}
+
+void fft_data_free(struct fft_data *data)
+{
+    free(data->re);
+    free(data->im);
+    if (data->owns_twiddles)
+    {
+        free(data->tw_re);
+        free(data->tw_im);
+    }
+    data->re = data->im = data->tw_re = data->tw_im = NULL;
+}
+
+void fft_data_set(struct fft_data *data, size_t i, double re, double im)
+{
+    if (data->precision == FFT_DOUBLE)
+    {
+        ((double *)data->re)[i] = re;
+        ((double *)data->im)[i] = im;
+    }
+    else
+    {
+        ((float *)data->re)[i] = re;
+        ((float *)data->im)[i] = im;
+    }
+}
+
+void fft_data_get(const struct fft_data *data, size_t i, double *re, double *im)
+{
+    if (data->precision == FFT_DOUBLE)
+    {
+        *re = ((double *)data->re)[i];
+        *im = ((double *)data->im)[i];
+    }
+    else
+    {
+        *re = ((float *)data->re)[i];
+        *im = ((float *)data->im)[i];
+    }
+}
+
+void fft_data_swap(struct fft_data *data, size_t i, size_t j)
+{
+    double re_i, im_i, re_j, im_j;
+    fft_data_get(data, i, &re_i, &im_i);
+    fft_data_get(data, j, &re_j, &im_j);
+    fft_data_set(data, i, re_j, im_j);
+    fft_data_set(data, j, re_i, im_i);
+}
+
+void fft_butterflies(struct fft_data *data, size_t even, size_t half, size_t count)
+{
+    size_t twiddle = half - 1 + (even & (2 * half - 1));
+    if (data->precision == FFT_DOUBLE)
+    {
+        double *re = data->re;
+        double *im = data->im;
+        butterflies_double(re + even, im + even, re + even + half, im + even + half,
+                           (double *)data->tw_re + twiddle, (double *)data->tw_im + twiddle, count);
+    }
+    else
+    {
+        float *re = data->re;
+        float *im = data->im;
+        butterflies_float(re + even, im + even, re + even + half, im + even + half,
+                          (float *)data->tw_re + twiddle, (float *)data->tw_im + twiddle, count);
+    }
+}
@@ -0,0 +1,130 @@
+/**
+ * @file fft_kernel.h
+ * @author Jonny X <e12345678@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief The butterfly kernels of the iterative FFT.
+ *
+ * @details The values are stored as separate real and imaginary arrays (SoA) in float or double
+ * precision, so the kernels can process 4 (double) or 8 (float) butterflies with one vector
+ * operation. The twiddle factors of all stages are computed once per size when the data is
+ * allocated.
+ **/
+
+#ifndef FFT_KERNEL_H
+#define FFT_KERNEL_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+/**
+ * @brief
+ * The precision of the values and the kernels.
+**/
+enum fft_precision
+{
+    FFT_FLOAT,
+    FFT_DOUBLE
+};
+
+/**
+ * @brief
+ * The values of an FFT and its twiddle factors.
+ *
+ * @details
+ * re and im hold n values of the precision. The twiddle factors of the stage with blocks of
+ * 2 * half values are stored contiguously at tw_re[half - 1] to tw_re[2 * half - 2]
+ * (e^(-2*PI*i*j/(2*half)) for j < half), n - 1 factors in total. Data created with
+ * fft_data_alloc_like shares the twiddle factors of another one (the plan).
+**/
+struct fft_data
+{
+    enum fft_precision precision;
+    size_t n;
+    void *re;
+    void *im;
+    void *tw_re;
+    void *tw_im;
+    bool owns_twiddles;
+};
+
+/**
+ * @brief
+ * Allocates the values and computes the twiddle factors.
+ *
+ * @param data The data to initialize.
+ * @param n The number of values, a power of two.
+ * @param precision The precision of the values.
+ * @return Returns 0 if successfull, otherwise -1 and errno is set.
+**/
+int fft_data_alloc(struct fft_data *data, size_t n, enum fft_precision precision);
+
+/**
+ * @brief
+ * Allocates the values for the size and precision of a plan.
+ *
+ * @details
+ * The twiddle factors are shared with the plan, which must not be freed before this data.
+ *
+ * @param data The data to initialize.
+ * @param plan The data created with fft_data_alloc whose twiddle factors are used.
+ * @return Returns 0 if successfull, otherwise -1 and errno is set.
+**/
+int fft_data_alloc_like(struct fft_data *data, const struct fft_data *plan);
+
+/**
+ * @brief
+ * Frees the values and the twiddle factors (if they aren't shared).
+ *
+ * @param data The data to free.
+**/
+void fft_data_free(struct fft_data *data);
+
+/**
+ * @brief
+ * Sets a value.
+ *
+ * @param data The data.
+ * @param i The index of the value.
+ * @param re The real part.
+ * @param im The imaginary part.
+**/
+void fft_data_set(struct fft_data *data, size_t i, double re, double im);
+
+/**
+ * @brief
+ * Gets a value.
+ *
+ * @param data The data.
+ * @param i The index of the value.
+ * @param re The pointer the real part is written to.
+ * @param im The pointer the imaginary part is written to.
+**/
+void fft_data_get(const struct fft_data *data, size_t i, double *re, double *im);
+
+/**
+ * @brief
+ * Swaps two values.
+ *
+ * @param data The data.
+ * @param i The index of the first value.
+ * @param j The index of the second value.
+**/
+void fft_data_swap(struct fft_data *data, size_t i, size_t j);
+
+/**
+ * @brief
+ * Computes butterflies of a stage.
+ *
+ * @details
+ * Combines the values at even + k and even + half + k for k < count. The range must lie within
+ * the first half of one block of 2 * half values.
+ *
+ * @param data The data.
+ * @param even The index of the first even value.
+ * @param half Half of the block size of the stage.
+ * @param count The number of butterflies.
+**/
+void fft_butterflies(struct fft_data *data, size_t even, size_t half, size_t count);
+
+#endif
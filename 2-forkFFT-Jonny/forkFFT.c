@@ -4,11 +4,21 @@
  * @date 19.12.2020
  * version: 2.0.3
  *
- * @brief This programm calculcates the FFT recursively by calling itself. No arguments should
- * be provided as the program reads from stdin after the execution. You can of course als pipe a file 
- * as input. 
- * After the caclucation the program outputs all solutions and after the solutions a tree visuaizing the
- * call graph of the children.
+ * @brief This programm calculcates the FFT of the complex numbers it reads from stdin. You can of course
+ * als pipe a file as input.
+ * By default the FFT is calculated in the process with an iterative radix-2 Cooley-Tukey over one array,
+ * the stages are split between a pool of worker threads (one per core, or -p WORKERS). The butterflies
+ * are computed by the vectorised kernels of fft_kernel.c in double precision (or float with -f).
+ * With -i INPUT -o OUTPUT the program reads packed samples (pairs of 32 bit floats, real and imaginary part)
+ * from a file and writes the result in the same format to another one. Both files are memory-mapped and the
+ * FFT is calculated with the four-step algorithm in tiles, so files larger than the memory can be transformed.
+ * With -b the input is a sequence of frames separated by blank lines (or with -l LENGTH of frames with LENGTH
+ * values each), one plan is built for the frame length and applied to the frames in parallel.
+ * With -r the inputs are real samples (one value per line): n samples are packed into n/2 complex values, whose
+ * FFT is untangled into the n/2+1 bins of the real FFT (the others are their conjugates). -R is the inverse, it
+ * reads the n/2+1 bins and prints the n real samples, so -r, a filter and -R form a round trip.
+ * With -t the program calculates the FFT recursively by calling itself instead. After the caclucation it
+ * outputs all solutions and after the solutions a tree visuaizing the call graph of the children.
  **/
 
 #include <stdio.h>
@@ -22,11 +32,87 @@
 #include <errno.h>
 #include <string.h>
 #include <assert.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+
+#include "fft_kernel.h"
 
 #define PI 3.141592654
 
+// The smallest input for which the stages are split between the workers.
+#define PARALLEL_MIN 4096
+
+// The maximum number of worker threads.
+#define MAX_WORKERS 64
+
+// The size of a tile of the four-step FFT in bytes (about the size of the L2 cache).
+#define TILE_BYTES (1 << 20)
+
+// The number of frames the batch mode reads before it transforms them.
+#define BATCH_FRAMES 1024
+
+/**
+ * @brief
+ * What the default mode reads and prints.
+**/
+enum fft_mode
+{
+    FFT_COMPLEX,  // n complex values to n complex values
+    FFT_REAL,     // n real samples to n/2+1 complex bins (-r)
+    FFT_INVERSE   // n/2+1 complex bins to n real samples (-R)
+};
+
 static char *prog_name;
 
+/**
+ * @brief
+ * The state of an iterative FFT shared by all workers.
+ *
+ * @details
+ * data holds the n values (and the twiddle factors of every stage), they are brought into
+ * bit reversed order at the start and hold the result at the end. Each worker does its share
+ * of every stage and waits at the barrier before the next one starts.
+**/
+struct fft_job
+{
+    struct fft_data data;
+    size_t n;
+    size_t workers;
+    pthread_barrier_t barrier;
+};
+
+/**
+ * @brief
+ * A worker thread of the batch mode.
+ *
+ * @details
+ * job has its own values but the twiddle factors of the plan. The worker transforms the frames
+ * id, id + workers, ... of the count frames in place.
+**/
+struct batch_worker
+{
+    struct fft_job job;
+    double complex *frames;
+    size_t count;
+    size_t id;
+    size_t workers;
+    pthread_t thread;
+};
+
+/**
+ * @brief
+ * The arguments of a worker thread.
+**/
+struct fft_worker
+{
+    struct fft_job *job;
+    size_t id;
+    pthread_t thread;
+};
+
 /**
  * @brief
  * Prints the usage format to explain which arguments are expected. 
@@ -37,7 +123,7 @@ static char *prog_name;
 **/
 void usage(void)
 {
-    fprintf(stderr, "[%s] Usage: %s\n", prog_name, prog_name);
+    fprintf(stderr, "[%s] Usage: %s [-t] [-f] [-p WORKERS] [-r | -R] [-i INPUT -o OUTPUT] [-b] [-l LENGTH]\n", prog_name, prog_name);
     fprintf(stderr, "Example inputs after program start: 1 0 and 1 0\n");
     exit(EXIT_FAILURE);
 }
@@ -269,26 +355,16 @@ void wait_for_both_children(pid_t pid1, pid_t pid2)
 }
 
 /**
- * Program entry point.
- * @brief The program recursively calls itself to calculate the FFT by using the Cooley-Tukey algorithm.
+ * @brief
+ * Calculates the FFT recursively by calling itself (the -t mode).
  *  
  * @details The program first reads the inputs an forks if more than one input is provided. 
  * Each child repeats this process until only one input is provided. That result is returned
- * to the parent which uses this to calculate the FFT.
- * 
- * @param argc The argument counter.
- * @param argv The argument vector.
- * @return Returns EXIT_SUCCESS or EXIT_FAILURE.
+ * to the parent which uses this to calculate the FFT. Afterwards the tree of the calls is printed.
+ * Never returns, the process exits with EXIT_SUCCESS or EXIT_FAILURE.
  */
-int main(int argc, char **argv)
+void fork_fft(void)
 {
-    //Exit if arguments were provided
-    prog_name = argv[0];
-    if (argc != 1)
-    {
-        usage();
-    }
-
     //create char* line1 and line2 which are filled by the getline calls.
     char *line1 = NULL;
     size_t line1_cap = 0;
@@ -409,7 +485,7 @@ int main(int argc, char **argv)
         close(fd_read_from_child2[1]);
 
         //exec the programm (forkFFT)
-        execl(prog_name, prog_name, NULL);
+        execl(prog_name, prog_name, "-t", NULL);
 
         // program only gets here if exec failed -> Error: print error, free resources and exit with failure
         fprintf(stderr, "[%s] Error: Exec from child 1 failed: %s\n", prog_name, strerror(errno));
@@ -464,7 +540,7 @@ int main(int argc, char **argv)
         close(fd_read_from_child1[1]);
 
         //exec the programm (forkFFT)
-        execl(prog_name, prog_name, NULL);
+        execl(prog_name, prog_name, "-t", NULL);
 
         // program only gets here if exec failed -> Error: print error, free resources and exit with failure
         fprintf(stderr, "[%s] Error: Exec from child 1 failed (%s)\n", prog_name, strerror(errno));
@@ -802,4 +878,906 @@ int main(int argc, char **argv)
     free(line2);
 
     exit(EXIT_SUCCESS);
-}
\ No newline at end of file
+}
+
+/**
+ * @brief
+ * Calculates the share of a worker of the iterative FFT.
+ *
+ * @details
+ * First swaps the values of its share of the indices with their bit reversed index, then does
+ * its share of the butterflies of every stage. Before each stage all workers meet at the barrier
+ * so every stage reads the finished results of the one before.
+ *
+ * @param arg The struct fft_worker of this worker.
+ * @return Always NULL.
+**/
+void *fft_worker(void *arg)
+{
+    struct fft_worker *worker = arg;
+    struct fft_job *job = worker->job;
+    size_t n = job->n;
+
+    // Bit reversal: the swap of i and j is done by the worker of the smaller index
+    int bits = 0;
+    while (((size_t)1 << bits) < n)
+    {
+        bits++;
+    }
+    size_t from = n * worker->id / job->workers;
+    size_t to = n * (worker->id + 1) / job->workers;
+    for (size_t i = from; i < to; i++)
+    {
+        size_t j = 0;
+        for (int b = 0; b < bits; b++)
+        {
+            j |= ((i >> b) & 1) << (bits - 1 - b);
+        }
+        if (i < j)
+        {
+            fft_data_swap(&job->data, i, j);
+        }
+    }
+
+    // Every stage has n/2 butterflies which are split evenly between the workers
+    from = (n / 2) * worker->id / job->workers;
+    to = (n / 2) * (worker->id + 1) / job->workers;
+    for (size_t half = 1; half < n; half *= 2)
+    {
+        if (job->workers > 1)
+        {
+            pthread_barrier_wait(&job->barrier);
+        }
+
+        // The share is cut into runs of butterflies within one block for the kernel
+        for (size_t b = from; b < to;)
+        {
+            size_t j = b % half;
+            size_t count = half - j < to - b ? half - j : to - b;
+            fft_butterflies(&job->data, (b / half) * 2 * half + j, half, count);
+            b += count;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief
+ * Calculates the FFT of a job with a pool of workers.
+ *
+ * @details
+ * Small inputs are calculated by the calling thread alone, larger ones by up to workers threads
+ * (the calling thread is worker 0).
+ *
+ * @param job The job with the values, which are replaced by the result.
+ * @param workers The maximum number of worker threads.
+ * @return Returns 0 if successfull, otherwise -1.
+**/
+int run_fft(struct fft_job *job, size_t workers)
+{
+    // Small inputs are faster without the synchronisation
+    if (job->n >= PARALLEL_MIN && workers > 1)
+    {
+        job->workers = workers;
+    }
+
+    struct fft_worker pool[MAX_WORKERS];
+    size_t started = 1;
+    if (job->workers > 1)
+    {
+        if ((errno = pthread_barrier_init(&job->barrier, NULL, job->workers)) != 0)
+        {
+            fprintf(stderr, "[%s] Error pthread_barrier_init failed: %s\n", prog_name, strerror(errno));
+            return -1;
+        }
+        for (; started < job->workers; started++)
+        {
+            pool[started].job = job;
+            pool[started].id = started;
+            if ((errno = pthread_create(&pool[started].thread, NULL, fft_worker, &pool[started])) != 0)
+            {
+                // The barrier needs all workers, so this can't continue with fewer
+                fprintf(stderr, "[%s] Error pthread_create failed: %s\n", prog_name, strerror(errno));
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+
+    // The main thread is worker 0
+    pool[0].job = job;
+    pool[0].id = 0;
+    fft_worker(&pool[0]);
+    for (size_t i = 1; i < started; i++)
+    {
+        pthread_join(pool[i].thread, NULL);
+    }
+    if (job->workers > 1)
+    {
+        pthread_barrier_destroy(&job->barrier);
+    }
+    return 0;
+}
+
+/**
+ * @brief
+ * Computes the bins of a real FFT from the FFT of the packed samples.
+ *
+ * @details
+ * The n real samples x were packed into z[k] = x[2k] + i * x[2k+1], data holds the FFT Z of length n/2.
+ * With Z[n/2] = Z[0] and w = e^(-2*PI*i*k/n) the bins are
+ * X[k] = (Z[k] + conj(Z[n/2-k])) / 2 - i * w * (Z[k] - conj(Z[n/2-k])) / 2 for k <= n/2.
+ *
+ * @param data The FFT of the packed samples.
+ * @param bins The n/2+1 bins.
+**/
+void unpack_real(const struct fft_data *data, double complex *bins)
+{
+    size_t half = data->n;
+    for (size_t k = 0; k <= half; k++)
+    {
+        double re, im;
+        fft_data_get(data, k % half, &re, &im);
+        double complex a = re + I * im;
+        fft_data_get(data, (half - k) % half, &re, &im);
+        double complex b = re - I * im;
+        double complex w = cexp(-I * M_PI * k / half);
+        bins[k] = (a + b) / 2 - I * w * (a - b) / 2;
+    }
+}
+
+/**
+ * @brief
+ * Prepares the inverse of a real FFT.
+ *
+ * @details
+ * Undoes unpack_real: E = (X[k] + conj(X[n/2-k])) / 2 and O = (X[k] - conj(X[n/2-k])) / 2 * conj(w)
+ * are the FFTs of the even and odd samples, Z = E + i * O. data gets conj(Z), so the forward FFT of
+ * data is n/2 * conj(z) and no inverse kernels are needed.
+ *
+ * @param data The data of length n/2.
+ * @param bins The n/2+1 bins.
+**/
+void pack_inverse_real(struct fft_data *data, const float complex *bins)
+{
+    size_t half = data->n;
+    for (size_t k = 0; k < half; k++)
+    {
+        double complex a = bins[k];
+        double complex b = conj(bins[half - k]);
+        double complex w = cexp(I * M_PI * k / half);
+        double complex z = (a + b) / 2 + I * (a - b) / 2 * w;
+        fft_data_set(data, k, creal(z), -cimag(z));
+    }
+}
+
+/**
+ * @brief
+ * Calculates the FFT in the process (the default mode).
+ *
+ * @details
+ * Reads all inputs into one array, calculates the FFT iteratively with a pool of workers and
+ * prints the results in the same format as the -t mode (without the tree). With FFT_REAL the
+ * n real inputs are transformed as n/2 complex values and n/2+1 bins are printed, with FFT_INVERSE
+ * the n/2+1 bins are transformed as n/2 complex values and n real samples are printed.
+ *
+ * @param workers The maximum number of worker threads.
+ * @param precision The precision of the calculation.
+ * @param mode What is read and printed.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE.
+**/
+int iterative_fft(size_t workers, enum fft_precision precision, enum fft_mode mode)
+{
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t n = 0;
+    size_t cap = 16;
+    float complex *data = malloc(cap * sizeof(double complex));
+    if (data == NULL)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    // Read and parse all inputs
+    while (getline(&line, &line_cap, stdin) != -1)
+    {
+        if (n == cap)
+        {
+            cap *= 2;
+            float complex *data_temp = realloc(data, cap * sizeof(float complex));
+            if (data_temp == NULL)
+            {
+                fprintf(stderr, "[%s] Error realloc failed\n", prog_name);
+                free(data);
+                free(line);
+                return EXIT_FAILURE;
+            }
+            data = data_temp;
+        }
+        if (parse_input(line, &data[n]) == -1)
+        {
+            free(data);
+            free(line);
+            usage();
+        }
+        n++;
+    }
+    free(line);
+
+    if (n == 0)
+    {
+        fprintf(stderr, "[%s] Error no input provided\n", prog_name);
+        free(data);
+        return EXIT_FAILURE;
+    }
+
+    // The length of the FFT: n complex values, n real samples packed in pairs or n - 1 = n/2 bins pairs
+    size_t length = mode == FFT_COMPLEX ? n : mode == FFT_REAL ? n / 2 : n - 1;
+    if (length == 0 || (length & (length - 1)) != 0 || (mode == FFT_REAL && n % 2 != 0))
+    {
+        if (mode == FFT_INVERSE)
+        {
+            fprintf(stderr, "[%s] Error the number of bins is not a power of two plus one\n", prog_name);
+        }
+        else
+        {
+            fprintf(stderr, "[%s] Error the number of inputs is not a power of two\n", prog_name);
+        }
+        free(data);
+        return EXIT_FAILURE;
+    }
+    for (size_t k = 0; mode == FFT_REAL && k < n; k++)
+    {
+        if (cimagf(data[k]) != 0)
+        {
+            fprintf(stderr, "[%s] Error input %zu is not real\n", prog_name, k + 1);
+            free(data);
+            return EXIT_FAILURE;
+        }
+    }
+
+    // Move the inputs into the arrays of the kernels, which also computes the twiddle factors
+    struct fft_job job = {.n = length, .workers = 1};
+    if (fft_data_alloc(&job.data, length, precision) == -1)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        free(data);
+        return EXIT_FAILURE;
+    }
+    for (size_t k = 0; k < length; k++)
+    {
+        if (mode == FFT_COMPLEX)
+        {
+            fft_data_set(&job.data, k, crealf(data[k]), cimagf(data[k]));
+        }
+        else if (mode == FFT_REAL)
+        {
+            fft_data_set(&job.data, k, crealf(data[2 * k]), crealf(data[2 * k + 1]));
+        }
+    }
+    if (mode == FFT_INVERSE)
+    {
+        pack_inverse_real(&job.data, data);
+    }
+    free(data);
+
+    if (run_fft(&job, workers) == -1)
+    {
+        fft_data_free(&job.data);
+        return EXIT_FAILURE;
+    }
+
+    if (mode == FFT_REAL)
+    {
+        double complex *bins = malloc((length + 1) * sizeof(double complex));
+        if (bins == NULL)
+        {
+            fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+            fft_data_free(&job.data);
+            return EXIT_FAILURE;
+        }
+        unpack_real(&job.data, bins);
+        for (size_t k = 0; k <= length; k++)
+        {
+            fprintf(stdout, "%f %f\n", creal(bins[k]), cimag(bins[k]));
+        }
+        free(bins);
+    }
+    else
+    {
+        for (size_t k = 0; k < length; k++)
+        {
+            double re, im;
+            fft_data_get(&job.data, k, &re, &im);
+            if (mode == FFT_INVERSE)
+            {
+                // The result is n/2 * conj(z), z[k] = x[2k] + i * x[2k+1]
+                fprintf(stdout, "%f\n%f\n", re / length, -im / length);
+            }
+            else
+            {
+                fprintf(stdout, "%f %f\n", re, im);
+            }
+        }
+    }
+    fflush(stdout);
+
+    fft_data_free(&job.data);
+    return EXIT_SUCCESS;
+}
+
+/**
+ * @brief
+ * Calculates an FFT of the plan in the calling thread.
+ *
+ * @param job The plan with the values, which are replaced by the result.
+**/
+void run_plan(struct fft_job *job)
+{
+    struct fft_worker worker = {.job = job, .id = 0};
+    fft_worker(&worker);
+}
+
+/**
+ * @brief
+ * Maps a file of packed samples.
+ *
+ * @param path The path of the file.
+ * @param size The size of the file, if writable the file is created (or truncated) with this size,
+ * otherwise it is set to the size of the file.
+ * @param writable Whether the file is the output.
+ * @return Returns the mapping, or MAP_FAILED and errno is set.
+**/
+float *map_samples(const char *path, size_t *size, bool writable)
+{
+    int fd = open(path, writable ? O_RDWR | O_CREAT | O_TRUNC : O_RDONLY, 0644);
+    if (fd == -1)
+    {
+        return MAP_FAILED;
+    }
+
+    struct stat st;
+    if (writable ? ftruncate(fd, *size) == -1 : fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return MAP_FAILED;
+    }
+    if (!writable)
+    {
+        *size = st.st_size;
+    }
+    if (*size == 0)
+    {
+        close(fd);
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    float *map = mmap(NULL, *size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return map;
+}
+
+/**
+ * @brief
+ * Calculates the FFT of a file with the four-step algorithm (the -i/-o mode).
+ *
+ * @details
+ * The n = n1 * n2 input samples x[a + n1 * b] are seen as a matrix with n2 rows of n1 columns:
+ * 1) An FFT of length n2 over every column, multiplied by the twiddle factor e^(-2*PI*i*a*k2/n).
+ * 2) The matrix is transposed into a scratch file, so every row k2 is contiguous.
+ * 3) An FFT of length n1 over every row, whose result k1 is X[k2 + n2 * k1].
+ * The columns (and rows) are processed in tiles of about TILE_BYTES, so every row of the tile is read
+ * and written as a contiguous run. Only the tiles and two small plans (with the twiddle factors of
+ * n1 and n2) are in memory, the files are accessed through the page cache.
+ *
+ * @param input_path The file with the packed input samples.
+ * @param output_path The file the packed results are written to.
+ * @param precision The precision of the calculation.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE.
+**/
+int streaming_fft(const char *input_path, const char *output_path, enum fft_precision precision)
+{
+    int ret = EXIT_FAILURE;
+    size_t size = 0;
+    float *input = map_samples(input_path, &size, false);
+    if (input == MAP_FAILED)
+    {
+        fprintf(stderr, "[%s] Error unable to map %s: %s\n", prog_name, input_path, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    size_t n = size / (2 * sizeof(float));
+    if (size % (2 * sizeof(float)) != 0 || (n & (n - 1)) != 0)
+    {
+        fprintf(stderr, "[%s] Error the number of inputs is not a power of two\n", prog_name);
+        munmap(input, size);
+        return EXIT_FAILURE;
+    }
+
+    float *output = map_samples(output_path, &size, true);
+    if (output == MAP_FAILED)
+    {
+        fprintf(stderr, "[%s] Error unable to map %s: %s\n", prog_name, output_path, strerror(errno));
+        munmap(input, size);
+        return EXIT_FAILURE;
+    }
+
+    // The scratch file lives next to the output (/tmp may be in memory) and is gone once unmapped
+    char scratch_path[strlen(output_path) + 8];
+    snprintf(scratch_path, sizeof(scratch_path), "%s.XXXXXX", output_path);
+    int scratch_fd = mkstemp(scratch_path);
+    float *scratch = MAP_FAILED;
+    if (scratch_fd != -1)
+    {
+        unlink(scratch_path);
+        if (ftruncate(scratch_fd, size) == 0)
+        {
+            scratch = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, scratch_fd, 0);
+        }
+        close(scratch_fd);
+    }
+
+    int bits = 0;
+    while (((size_t)1 << bits) < n)
+    {
+        bits++;
+    }
+    size_t n1 = (size_t)1 << (bits / 2);
+    size_t n2 = n / n1;
+    struct fft_job columns = {.n = n2, .workers = 1};
+    struct fft_job rows = {.n = n1, .workers = 1};
+    size_t tile_columns = TILE_BYTES / (n2 * 2 * sizeof(double)) > 0 ? TILE_BYTES / (n2 * 2 * sizeof(double)) : 1;
+    size_t tile_rows = TILE_BYTES / (n1 * 2 * sizeof(double)) > 0 ? TILE_BYTES / (n1 * 2 * sizeof(double)) : 1;
+    tile_columns = tile_columns < n1 ? tile_columns : n1;
+    tile_rows = tile_rows < n2 ? tile_rows : n2;
+    size_t tile_size = tile_columns * n2 > tile_rows * n1 ? tile_columns * n2 : tile_rows * n1;
+    double *tile = malloc(tile_size * 2 * sizeof(double));
+
+    if (scratch == MAP_FAILED || tile == NULL || fft_data_alloc(&columns.data, n2, precision) == -1)
+    {
+        fprintf(stderr, "[%s] Error unable to allocate the scratch space: %s\n", prog_name, strerror(errno));
+        goto cleanup;
+    }
+    if (fft_data_alloc(&rows.data, n1, precision) == -1)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        fft_data_free(&columns.data);
+        goto cleanup;
+    }
+
+    // Step 1 and 2: columns a to a + count, read and written row by row
+    for (size_t a0 = 0; a0 < n1; a0 += tile_columns)
+    {
+        size_t count = n1 - a0 < tile_columns ? n1 - a0 : tile_columns;
+        for (size_t b = 0; b < n2; b++)
+        {
+            const float *row = input + 2 * (a0 + n1 * b);
+            for (size_t c = 0; c < count; c++)
+            {
+                tile[2 * (c * n2 + b)] = row[2 * c];
+                tile[2 * (c * n2 + b) + 1] = row[2 * c + 1];
+            }
+        }
+
+        for (size_t c = 0; c < count; c++)
+        {
+            double *column = tile + 2 * c * n2;
+            for (size_t b = 0; b < n2; b++)
+            {
+                fft_data_set(&columns.data, b, column[2 * b], column[2 * b + 1]);
+            }
+            run_plan(&columns);
+            for (size_t k2 = 0; k2 < n2; k2++)
+            {
+                double re, im;
+                fft_data_get(&columns.data, k2, &re, &im);
+                double angle = -2 * M_PI * (double)(((a0 + c) * k2) % n) / n;
+                column[2 * k2] = re * cos(angle) - im * sin(angle);
+                column[2 * k2 + 1] = re * sin(angle) + im * cos(angle);
+            }
+        }
+
+        for (size_t k2 = 0; k2 < n2; k2++)
+        {
+            float *row = scratch + 2 * (k2 * n1 + a0);
+            for (size_t c = 0; c < count; c++)
+            {
+                row[2 * c] = tile[2 * (c * n2 + k2)];
+                row[2 * c + 1] = tile[2 * (c * n2 + k2) + 1];
+            }
+        }
+    }
+
+    // The input isn't needed anymore, its pages can go
+    madvise(input, size, MADV_DONTNEED);
+
+    // Step 3: rows k2 to k2 + count, written to the output transposed
+    for (size_t k0 = 0; k0 < n2; k0 += tile_rows)
+    {
+        size_t count = n2 - k0 < tile_rows ? n2 - k0 : tile_rows;
+        for (size_t r = 0; r < count; r++)
+        {
+            const float *row = scratch + 2 * (k0 + r) * n1;
+            for (size_t a = 0; a < n1; a++)
+            {
+                fft_data_set(&rows.data, a, row[2 * a], row[2 * a + 1]);
+            }
+            run_plan(&rows);
+            for (size_t k1 = 0; k1 < n1; k1++)
+            {
+                fft_data_get(&rows.data, k1, &tile[2 * (r * n1 + k1)], &tile[2 * (r * n1 + k1) + 1]);
+            }
+        }
+
+        for (size_t k1 = 0; k1 < n1; k1++)
+        {
+            float *out = output + 2 * (k0 + n2 * k1);
+            for (size_t r = 0; r < count; r++)
+            {
+                out[2 * r] = tile[2 * (r * n1 + k1)];
+                out[2 * r + 1] = tile[2 * (r * n1 + k1) + 1];
+            }
+        }
+
+        // Drop the finished rows of the scratch file (only whole pages)
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t done = (2 * sizeof(float) * (k0 + count) * n1) / page * page;
+        size_t start = (2 * sizeof(float) * k0 * n1) / page * page;
+        if (done > start)
+        {
+            madvise((char *)scratch + start, done - start, MADV_DONTNEED);
+        }
+    }
+
+    fft_data_free(&columns.data);
+    fft_data_free(&rows.data);
+    if (msync(output, size, MS_SYNC) == -1)
+    {
+        fprintf(stderr, "[%s] Error unable to write %s: %s\n", prog_name, output_path, strerror(errno));
+        goto cleanup;
+    }
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    free(tile);
+    if (scratch != MAP_FAILED)
+    {
+        munmap(scratch, size);
+    }
+    munmap(output, size);
+    munmap(input, size);
+    return ret;
+}
+
+/**
+ * @brief
+ * Transforms the share of the frames of a batch worker.
+ *
+ * @param arg The struct batch_worker of this worker.
+ * @return Always NULL.
+**/
+void *batch_worker_run(void *arg)
+{
+    struct batch_worker *worker = arg;
+    size_t n = worker->job.n;
+    for (size_t f = worker->id; f < worker->count; f += worker->workers)
+    {
+        double complex *frame = worker->frames + f * n;
+        for (size_t k = 0; k < n; k++)
+        {
+            fft_data_set(&worker->job.data, k, creal(frame[k]), cimag(frame[k]));
+        }
+        run_plan(&worker->job);
+        for (size_t k = 0; k < n; k++)
+        {
+            double re, im;
+            fft_data_get(&worker->job.data, k, &re, &im);
+            frame[k] = re + I * im;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief
+ * Transforms and prints a batch of frames.
+ *
+ * @param pool The workers, with their values already allocated.
+ * @param workers The number of workers.
+ * @param frames The frames, which are replaced by their results.
+ * @param count The number of frames.
+ * @param first Whether these are the first frames of the output (no blank line before them).
+ * @return Returns 0 if successfull, otherwise -1.
+**/
+int run_batch(struct batch_worker *pool, size_t workers, double complex *frames, size_t count, bool first)
+{
+    size_t used = count < workers ? count : workers;
+    size_t started = 1;
+    for (size_t i = 0; i < used; i++)
+    {
+        pool[i].frames = frames;
+        pool[i].count = count;
+        pool[i].id = i;
+        pool[i].workers = used;
+    }
+    for (; started < used; started++)
+    {
+        if ((errno = pthread_create(&pool[started].thread, NULL, batch_worker_run, &pool[started])) != 0)
+        {
+            fprintf(stderr, "[%s] Error pthread_create failed: %s\n", prog_name, strerror(errno));
+            break;
+        }
+    }
+
+    // The main thread does its own share and the shares of the workers that couldn't be started
+    batch_worker_run(&pool[0]);
+    for (size_t i = started; i < used; i++)
+    {
+        batch_worker_run(&pool[i]);
+    }
+    for (size_t i = 1; i < started; i++)
+    {
+        pthread_join(pool[i].thread, NULL);
+    }
+
+    size_t n = pool[0].job.n;
+    for (size_t f = 0; f < count; f++)
+    {
+        if (!first || f > 0)
+        {
+            fprintf(stdout, "\n");
+        }
+        for (size_t k = 0; k < n; k++)
+        {
+            fprintf(stdout, "%f %f\n", creal(frames[f * n + k]), cimag(frames[f * n + k]));
+        }
+    }
+    return ferror(stdout) ? -1 : 0;
+}
+
+/**
+ * @brief
+ * Calculates the FFT of every frame on stdin (the -b mode).
+ *
+ * @details
+ * The frames are separated by blank lines, or if length is not 0 every length values are a frame
+ * (blank lines are ignored then). All frames must have the same length, which is a power of two.
+ * The plan (the twiddle factors for the length) is built with the first frame, afterwards the
+ * frames are read in batches of BATCH_FRAMES and transformed by the workers in parallel. The
+ * results are printed like the input, the throughput is printed to stderr.
+ *
+ * @param workers The maximum number of worker threads.
+ * @param precision The precision of the calculation.
+ * @param length The length of the frames, or 0 if they are separated by blank lines.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE.
+**/
+int batch_fft(size_t workers, enum fft_precision precision, size_t length)
+{
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    int ret = EXIT_FAILURE;
+    char *line = NULL;
+    size_t line_cap = 0;
+    size_t cap = 16;
+    size_t used = 0;
+    size_t filled = 0;
+    size_t count = 0;
+    size_t total = 0;
+    bool planned = false;
+    struct fft_data plan;
+    struct batch_worker pool[MAX_WORKERS];
+    size_t allocated = 0;
+    double complex *frames = malloc(cap * sizeof(double complex));
+    if (frames == NULL)
+    {
+        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    bool fixed = length != 0;
+    bool eof = false;
+    while (!eof)
+    {
+        eof = getline(&line, &line_cap, stdin) == -1;
+        bool blank = !eof && (line[0] == '\n' || line[0] == '\0');
+        if (!eof && !blank)
+        {
+            if (used == cap)
+            {
+                cap *= 2;
+                double complex *frames_temp = realloc(frames, cap * sizeof(double complex));
+                if (frames_temp == NULL)
+                {
+                    fprintf(stderr, "[%s] Error realloc failed\n", prog_name);
+                    goto cleanup;
+                }
+                frames = frames_temp;
+            }
+            float complex value;
+            if (parse_input(line, &value) == -1)
+            {
+                goto cleanup;
+            }
+            frames[used] = value;
+            used++;
+            filled++;
+        }
+
+        // A frame ends at a blank line, at the end of the input or after length values
+        bool frame_done = filled > 0 && (eof || (fixed ? filled == length : blank));
+        if (frame_done)
+        {
+            if (!planned)
+            {
+                if ((filled & (filled - 1)) != 0)
+                {
+                    fprintf(stderr, "[%s] Error the length of the frames is not a power of two\n", prog_name);
+                    goto cleanup;
+                }
+                length = filled;
+                if (fft_data_alloc(&plan, length, precision) == -1)
+                {
+                    fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+                    goto cleanup;
+                }
+                planned = true;
+                for (; allocated < workers; allocated++)
+                {
+                    pool[allocated].job.n = length;
+                    pool[allocated].job.workers = 1;
+                    if (fft_data_alloc_like(&pool[allocated].job.data, &plan) == -1)
+                    {
+                        fprintf(stderr, "[%s] Error malloc failed: %s\n", prog_name, strerror(errno));
+                        goto cleanup;
+                    }
+                }
+            }
+            else if (filled != length)
+            {
+                fprintf(stderr, "[%s] Error frame %zu has %zu values instead of %zu\n", prog_name, total + count + 1,
+                        filled, length);
+                goto cleanup;
+            }
+            filled = 0;
+            count++;
+        }
+
+        if (count > 0 && (count == BATCH_FRAMES || eof))
+        {
+            if (run_batch(pool, workers, frames, count, total == 0) == -1)
+            {
+                fprintf(stderr, "[%s] Error unable to write the results\n", prog_name);
+                goto cleanup;
+            }
+            total += count;
+            count = 0;
+            used = 0;
+        }
+    }
+    if (total == 0)
+    {
+        fprintf(stderr, "[%s] Error no input provided\n", prog_name);
+        goto cleanup;
+    }
+    fflush(stdout);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    fprintf(stderr, "[%s] %zu frames of %zu values in %.3f s (%.1f frames/s)\n", prog_name, total, length, seconds,
+            seconds > 0 ? total / seconds : 0);
+    ret = EXIT_SUCCESS;
+
+cleanup:
+    for (size_t i = 0; i < allocated; i++)
+    {
+        fft_data_free(&pool[i].job.data);
+    }
+    if (planned)
+    {
+        fft_data_free(&plan);
+    }
+    free(frames);
+    free(line);
+    return ret;
+}
+
+/**
+ * Program entry point.
+ * @brief Parses the options and calculates the FFT of the inputs on stdin.
+ *
+ * @details Without options the FFT is calculated iteratively in the process (in double precision,
+ * with -f in single precision, of real samples with -r and back to them with -R), with -i and -o it is calculated from file to file with the four-step
+ * algorithm, with -b or -l for every frame of the input and with -t the program recursively calls itself by using the Cooley-Tukey algorithm and
+ * prints the tree of the calls.
+ *
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE.
+ */
+int main(int argc, char **argv)
+{
+    prog_name = argv[0];
+    bool tree = false;
+    enum fft_precision precision = FFT_DOUBLE;
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t workers = cores > 0 ? cores : 1;
+    char *input_path = NULL;
+    char *output_path = NULL;
+    bool batch = false;
+    size_t frame_length = 0;
+    enum fft_mode mode = FFT_COMPLEX;
+
+    int c;
+    while ((c = getopt(argc, argv, "tfrRp:i:o:bl:")) != -1)
+    {
+        char *end;
+        switch (c)
+        {
+        case 't':
+            tree = true;
+            break;
+        case 'f':
+            precision = FFT_FLOAT;
+            break;
+        case 'r':
+        case 'R':
+            if (mode != FFT_COMPLEX)
+            {
+                usage();
+            }
+            mode = c == 'r' ? FFT_REAL : FFT_INVERSE;
+            break;
+        case 'i':
+            input_path = optarg;
+            break;
+        case 'o':
+            output_path = optarg;
+            break;
+        case 'b':
+            batch = true;
+            break;
+        case 'l':
+            errno = 0;
+            long length = strtol(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || length < 1 || (length & (length - 1)) != 0)
+            {
+                usage();
+            }
+            frame_length = length;
+            batch = true;
+            break;
+        case 'p':
+            errno = 0;
+            long value = strtol(optarg, &end, 10);
+            if (errno != 0 || *end != '\0' || value < 1 || value > MAX_WORKERS)
+            {
+                usage();
+            }
+            workers = value;
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc || (input_path == NULL) != (output_path == NULL) ||
+        tree + (input_path != NULL) + batch + (mode != FFT_COMPLEX) > 1)
+    {
+        usage();
+    }
+    workers = workers < MAX_WORKERS ? workers : MAX_WORKERS;
+
+    if (tree)
+    {
+        fork_fft();
+    }
+    if (input_path != NULL)
+    {
+        return streaming_fft(input_path, output_path, precision);
+    }
+    if (batch)
+    {
+        return batch_fft(workers, precision, frame_length);
+    }
+    return iterative_fft(workers, precision, mode);
+}
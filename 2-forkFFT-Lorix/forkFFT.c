@@ -6,6 +6,19 @@
  * @brief Fast Fourrier Transformation using forks.
  * 
  * This program computes the fast fourrier transformation using forks.
+ * The root reads text from stdin and writes text to stdout, the children are
+ * started with -b and exchange binary blocks (a block_header_t followed by the
+ * packed complex_t values) with their parent, so every level reads and writes
+ * its whole array at once without converting the floats to strings and back.
+ * With -r the root reads n real samples, packs them into n/2 complex values
+ * (the even samples as real, the odd ones as imaginary parts), so the tree only
+ * transforms half the values, and untangles the n/2+1 bins of the real FFT
+ * from the result. -R is the inverse: it reads the n/2+1 bins and writes the n
+ * real samples, so a filter can sit between -r and -R.
+ * With -s the root maps one shared anonymous region before it forks and the
+ * children are forked without exec: every child transforms its half of the
+ * region in place, the pipes only carry one byte telling the parent that the
+ * half is done, so no value is copied between the processes.
  */
 
 #include "forkFFT.h"
@@ -14,7 +27,9 @@
 #include <unistd.h> 
 #include <sys/wait.h>
 #include <sys/types.h>
+#include <sys/mman.h>
 #include <fcntl.h> 
+#include <sys/uio.h>
 #include <string.h> 
 #include <math.h>
 #include <ctype.h>
@@ -23,12 +38,17 @@
 
 static char * program = "<not yet encountered>";
 
+// 32 bytes: one AVX register, two NEON/SSE registers.
+#define VECTOR_SIZE (32)
+#define VECTOR_LANES ((int)(VECTOR_SIZE / sizeof(sample_t)))
+typedef sample_t sample_vector_t __attribute__((vector_size(VECTOR_SIZE)));
+
 /**
  * @brief This function writes helpful messages to stderr.
  * @details global variables: program
  */
 void usage(char * message) {
-    fprintf(stderr, "USAGE: %s \n", program);
+    fprintf(stderr, "USAGE: %s [-b | -r | -R] [-s]\n", program);
     exit(EXIT_FAILURE);
 }
 
@@ -68,7 +88,7 @@ static void spawn_child(info_t * info) {
             }
             close(pipes[0][0]);
             close(pipes[1][1]);
-            if(execlp(program,program,NULL) == -1){
+            if(execlp(program,program,"-b",NULL) == -1){
                 error_exit("Failed to execute program!");
             }
             assert(0);
@@ -90,7 +110,7 @@ static void spawn_child(info_t * info) {
 static void string_to_imaginary(char * buf, complex_t * num){
     char * endptr;
     errno = 0;
-    num -> real = strtof(buf, &endptr);
+    num -> real = strtod(buf, &endptr);
     if(errno == ERANGE || (errno != 0 && num -> real == 0)) {
         error_exit("Input is out of bounds!");
     }
@@ -98,7 +118,7 @@ static void string_to_imaginary(char * buf, complex_t * num){
         error_exit("Input is empty!");
     }
     if(*endptr == ' ') {
-        num -> imaginary = strtof(endptr, &endptr);
+        num -> imaginary = strtod(endptr, &endptr);
         if(errno == ERANGE || (errno != 0 && num -> real == 0)){
             error_exit("Input imaginary number is out of bounds!");
         }
@@ -116,26 +136,139 @@ static void string_to_imaginary(char * buf, complex_t * num){
 }
 
 /**
- * @brief completes the butterfly operation for two values and returns the value in them.
- * @param e Re[k] after the function R[k].
- * @param o Ro[k] after the function R[k+n/2].
- * @param k current position in Re and Ro.
+ * @brief completes the butterfly operations of a node.
+ * @details e and o are split into separate real and imaginary arrays first, so the
+ * butterflies run over contiguous samples with the vector extension of GCC
+ * (4 double or 8 float butterflies per AVX/NEON operation). The twiddle factors
+ * are computed once per call in double precision.
+ * @param e Re, the result of the even child.
+ * @param o Ro, the result of the odd child.
+ * @param result R, where the n results are stored.
  * @param n expected size of R.
+ * @return returns -1 if the memory couldn't be allocated else 0.
  */
-static void butterfly(complex_t * e, complex_t * o, int k, int n){
-    complex_t c = {.real=cos((-((2*PI)/n)) * k),.imaginary=sin((-((2*PI)/n)) * k)},x;;
-    x.real = c.real;
-    x.imaginary = c.imaginary;
-    
-    c.real = x.real * o->real - x.imaginary * o->imaginary;
-    c.imaginary = x.real * o->imaginary + x.imaginary * o->real;  
+static int butterflies(const complex_t * e, const complex_t * o, complex_t * result, int n){
+    int half = n/2;
+    sample_t * soa = malloc(6 * half * sizeof(sample_t));
+    if(soa == NULL){
+        return -1;
+    }
+    sample_t * restrict eRe = soa, * restrict eIm = soa + half;
+    sample_t * restrict oRe = soa + 2*half, * restrict oIm = soa + 3*half;
+    sample_t * restrict wRe = soa + 4*half, * restrict wIm = soa + 5*half;
+    for(int k = 0; k < half; k++){
+        eRe[k] = e[k].real;
+        eIm[k] = e[k].imaginary;
+        oRe[k] = o[k].real;
+        oIm[k] = o[k].imaginary;
+        wRe[k] = cos((-(2*PI)/n) * k);
+        wIm[k] = sin((-(2*PI)/n) * k);
+    }
+
+    // c = w * o, R[k] = e + c, R[k+n/2] = e - c (the real and imaginary parts in place)
+    int k = 0;
+    for(; k + VECTOR_LANES <= half; k += VECTOR_LANES){
+        sample_vector_t er, ei, or, oi, wr, wi;
+        memcpy(&er, eRe + k, VECTOR_SIZE);
+        memcpy(&ei, eIm + k, VECTOR_SIZE);
+        memcpy(&or, oRe + k, VECTOR_SIZE);
+        memcpy(&oi, oIm + k, VECTOR_SIZE);
+        memcpy(&wr, wRe + k, VECTOR_SIZE);
+        memcpy(&wi, wIm + k, VECTOR_SIZE);
+        sample_vector_t cr = wr * or - wi * oi;
+        sample_vector_t ci = wr * oi + wi * or;
+        sample_vector_t sum = er - cr;
+        memcpy(oRe + k, &sum, VECTOR_SIZE);
+        sum = ei - ci;
+        memcpy(oIm + k, &sum, VECTOR_SIZE);
+        sum = er + cr;
+        memcpy(eRe + k, &sum, VECTOR_SIZE);
+        sum = ei + ci;
+        memcpy(eIm + k, &sum, VECTOR_SIZE);
+    }
+    for(; k < half; k++){
+        sample_t cRe = wRe[k] * oRe[k] - wIm[k] * oIm[k];
+        sample_t cIm = wRe[k] * oIm[k] + wIm[k] * oRe[k];
+        oRe[k] = eRe[k] - cRe;
+        oIm[k] = eIm[k] - cIm;
+        eRe[k] = eRe[k] + cRe;
+        eIm[k] = eIm[k] + cIm;
+    }
 
-    o->real = e->real - c.real;
-    o->imaginary = e->imaginary - c.imaginary;
+    for(k = 0; k < half; k++){
+        result[k].real = eRe[k];
+        result[k].imaginary = eIm[k];
+        result[k+half].real = oRe[k];
+        result[k+half].imaginary = oIm[k];
+    }
+    free(soa);
+    return 0;
+}
+/**
+ * @brief packs n real samples into n/2 complex values, in place.
+ * @details throws an error if a sample has an imaginary part.
+ * @param values the samples, the first n/2 hold the packed values afterwards.
+ * @param n number of samples, even.
+ */
+static void pack_samples(complex_t * values, int n){
+    for(int k = 0; k < n; k++){
+        if(values[k].imaginary != 0){
+            free(values);
+            error_exit("Input has to be real!");
+        }
+    }
+    for(int k = 0; k < n/2; k++){
+        complex_t packed = {.real = values[2*k].real, .imaginary = values[2*k+1].real};
+        values[k] = packed;
+    }
+}
+
+/**
+ * @brief computes the bins of the real FFT of size n from the FFT of the packed samples.
+ * @details with Z[n/2] = Z[0] and w = e^(-2*PI*i*k/n):
+ * X[k] = (Z[k] + conj(Z[n/2-k]))/2 + w * (Z[k] - conj(Z[n/2-k]))/(2i) for k <= n/2.
+ * @param z the FFT of the packed samples, n/2 values.
+ * @param n number of samples.
+ * @return returns the n/2+1 bins (to be freed by the caller) or NULL if the memory couldn't be allocated.
+ */
+static complex_t * unpack_bins(const complex_t * z, int n){
+    int half = n/2;
+    complex_t * bins = malloc((half + 1) * sizeof(complex_t));
+    if(bins == NULL){
+        return NULL;
+    }
+    for(int k = 0; k <= half; k++){
+        complex_t a = z[k % half], b = z[(half - k) % half];
+        double eRe = (a.real + b.real) / 2, eIm = (a.imaginary - b.imaginary) / 2;
+        double oRe = (a.imaginary + b.imaginary) / 2, oIm = -(a.real - b.real) / 2;
+        double wRe = cos((-(2*PI)/n) * k), wIm = sin((-(2*PI)/n) * k);
+        bins[k].real = eRe + wRe * oRe - wIm * oIm;
+        bins[k].imaginary = eIm + wRe * oIm + wIm * oRe;
+    }
+    return bins;
+}
 
-    e->real = e->real + c.real;
-    e->imaginary = e->imaginary + c.imaginary;
+/**
+ * @brief the inverse of unpack_bins, computes the conjugate of the FFT of the packed samples.
+ * @details the FFT of the result is n/2 times the conjugate of the packed samples, so the
+ * forward FFT of the tree also calculates the inverse.
+ * @param bins the n/2+1 bins.
+ * @param z where the n/2 values are stored.
+ * @param n number of samples.
+ */
+static void pack_bins(const complex_t * bins, complex_t * z, int n){
+    int half = n/2;
+    for(int k = 0; k < half; k++){
+        complex_t a = bins[k], b = bins[half - k];
+        double eRe = (a.real + b.real) / 2, eIm = (a.imaginary - b.imaginary) / 2;
+        double dRe = (a.real - b.real) / 2, dIm = (a.imaginary + b.imaginary) / 2;
+        double wRe = cos(((2*PI)/n) * k), wIm = sin(((2*PI)/n) * k);
+        double oRe = wRe * dRe - wIm * dIm, oIm = wRe * dIm + wIm * dRe;
+        z[k].real = eRe - oIm;
+        z[k].imaginary = -(eIm + oRe);
+    }
 }
+
 /**
  * @brief wrapper for fgets to deal with EINTR.
  * @param buffer buffer to read into.
@@ -165,118 +298,478 @@ static int write_data(char * buffer, FILE *out){
 }
 
 /**
- * @brief Read data from children, performs calculations and writes result to stdout.
+ * @brief reads exactly size bytes from fd, deals with EINTR and short reads.
+ * @param fd fd to read from.
+ * @param buf buffer to read into.
+ * @param size number of bytes to read.
+ * @return returns -1 if something went wrong or the input ended early else 0.
+*/
+static int read_fully(int fd, void * buf, size_t size){
+    char * pos = buf;
+    while(size > 0){
+        ssize_t len = read(fd, pos, size);
+        if(len == -1 && errno == EINTR)continue;
+        if(len <= 0){
+            return -1;
+        }
+        pos += len;
+        size -= len;
+    }
+    return 0;
+}
+
+/**
+ * @brief reads a binary block.
+ * @param fd fd to read from.
+ * @param n number of values in the block.
+ * @return returns the values (to be freed by the caller) or NULL if something went wrong.
+*/
+static complex_t * read_block(int fd, int * n){
+    block_header_t header;
+    if(read_fully(fd, &header, sizeof(header)) == -1 || header.count > MAX_BLOCK_VALUES){
+        return NULL;
+    }
+    complex_t * values = malloc((header.count + 1) * sizeof(complex_t));
+    if(values == NULL){
+        return NULL;
+    }
+    if(read_fully(fd, values, header.count * sizeof(complex_t)) == -1){
+        free(values);
+        return NULL;
+    }
+    *n = header.count;
+    return values;
+}
+
+/**
+ * @brief writes a binary block, header and values with one writev if the pipe takes them.
+ * @param fd fd to write into.
+ * @param values values to write.
+ * @param n number of values.
+ * @return returns -1 if something went wrong else 0.
+*/
+static int write_block(int fd, complex_t * values, int n){
+    block_header_t header = {.count = n};
+    struct iovec iov[2] = {
+        {.iov_base = &header, .iov_len = sizeof(header)},
+        {.iov_base = values, .iov_len = n * sizeof(complex_t)}
+    };
+    int first = 0;
+    while(first < 2){
+        ssize_t len = writev(fd, iov + first, 2 - first);
+        if(len == -1 && errno == EINTR)continue;
+        if(len == -1){
+            return -1;
+        }
+        // Skip what was written, the pipe may only take part of a large block
+        while(first < 2 && (size_t) len >= iov[first].iov_len){
+            len -= iov[first].iov_len;
+            first++;
+        }
+        if(first < 2){
+            iov[first].iov_base = (char *) iov[first].iov_base + len;
+            iov[first].iov_len -= len;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief reads the text input into an array.
+ * @param first the first line, written to stdout unchanged if it is the only one.
+ * @param n number of values read.
+ * @return returns the values (to be freed by the caller).
+*/
+static complex_t * read_text(char * first, int * n){
+    char buffer[MAX_LINE_LENGTH];
+    int capacity = 16;
+    complex_t * values = malloc(capacity * sizeof(complex_t));
+    if(values == NULL){
+        error_exit("Failed to allocate!");
+    }
+    *n = 0;
+    while(read_data(buffer, stdin) != -1){
+        if(*n == 0){
+            strcpy(first, buffer);
+        }
+        if(*n == capacity){
+            capacity *= 2;
+            complex_t * tmp = realloc(values, capacity * sizeof(complex_t));
+            if(tmp == NULL){
+                free(values);
+                error_exit("Failed to allocate!");
+            }
+            values = tmp;
+        }
+        string_to_imaginary(buffer, &values[*n]);
+        (*n)++;
+    }
+    return values;
+}
+
+/**
+ * @brief Read data from children and performs calculations.
  * @param q fd from which to read Re from
  * @param t fd from which to read Ro from
  * @param n total expected output size.
+ * @return returns the n results (to be freed by the caller).
  */
-static void calculate_result(int q, int t, int n){
-    char buffer[MAX_LINE_LENGTH];
-    complex_t e, o;
-    complex_t result[n];
-    FILE * eIn = fdopen(q,"r");
-    FILE * oIn = fdopen(t,"r");
-    
-    for(int i = 0; i < n/2;i++){
-        if(read_data(buffer, eIn) == -1){
-            fclose(eIn);
-            fclose(oIn);
-            error_exit("Input has to be even and contain only valid floating point numbers!");
-        }
+static complex_t * calculate_result(int q, int t, int n){
+    int eSize = 0, oSize = 0;
+    complex_t * e = read_block(q, &eSize);
+    complex_t * o = read_block(t, &oSize);
+    close(q);
+    close(t);
+    if(e == NULL || o == NULL || eSize != n/2 || oSize != n/2){
+        free(e);
+        free(o);
+        error_exit("Failed to read the results of the children!");
+    }
 
-        string_to_imaginary(buffer, &e);
-        
-        if(read_data(buffer, oIn) == -1){
-            fclose(oIn);
-            fclose(eIn);
-            error_exit("Input has to be even and contain only valid floating point numbers");
-        };
-
-        string_to_imaginary(buffer, &o);
-        
-        butterfly(&e,&o,i,n);
-        result[i]=e;
-        result[i+n/2]=o;
-    }
-    fclose(eIn);
-    fclose(oIn);
+    complex_t * result = malloc(n * sizeof(complex_t));
+    if(result == NULL || butterflies(e, o, result, n) == -1){
+        free(e);
+        free(o);
+        free(result);
+        error_exit("Failed to allocate!");
+    }
+    free(e);
+    free(o);
+    return result;
+}
+
+/**
+ * @brief writes values as text to stdout.
+ * @param values values to write.
+ * @param n number of values.
+ * @param real whether only the real parts are written.
+ */
+static void write_text(const complex_t * values, int n, int real){
+    char buffer[MAX_LINE_LENGTH];
     for(int i = 0; i < n;i++){
-        snprintf(buffer, MAX_LINE_LENGTH, "%f %f*i\n",result[i].real,result[i].imaginary);
+        if(real){
+            snprintf(buffer, MAX_LINE_LENGTH, "%f\n",values[i].real);
+        } else {
+            snprintf(buffer, MAX_LINE_LENGTH, "%f %f*i\n",values[i].real,values[i].imaginary);
+        }
         write_data(buffer,stdout);
     }
 }
+
 /**
- * Main
-*/
-int main(int argc, char * argv[]){
-    program = argv[0];
+ * @brief waits for a child and checks that it terminated correctly.
+ * @param pid pid of the child.
+ * @return returns -1 if the child failed else 0.
+ */
+static int wait_child(pid_t pid){
+    int status;
+    while(waitpid(pid,&status,0) == -1){
+        if(errno != EINTR){
+            return -1;
+        }
+    }
+    if(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE){
+        return -1;
+    }
+    return 0;
+}
 
-    int size;
-    char bufferA[MAX_LINE_LENGTH];
-    char bufferB[MAX_LINE_LENGTH];
-    // Buffering two lines to check for termination condition
-    if(read_data(bufferA, stdin) == -1){
-        error_exit("Failed to read!");
+/**
+ * @brief calculates the FFT of the values with two children, which calculate the FFT of the even and the odd values.
+ * @param values the values, freed by this function.
+ * @param size number of values, 1 or even.
+ * @return returns the size results (to be freed by the caller).
+ */
+static complex_t * transform(complex_t * values, int size){
+    if(size == 1){
+        return values;
     }
-    if(read_data(bufferB, stdin) == -1){
-        //We can't get interrupted here!
-        write_data(bufferA,stdout);
-        exit(EXIT_SUCCESS);
+    if(size % 2 != 0){
+        free(values);
+        error_exit("Input has to be even!");
     }
+
+    // Splitting into the even and the odd values in place
+    complex_t * odd = malloc(size/2 * sizeof(complex_t));
+    if(odd == NULL){
+        free(values);
+        error_exit("Failed to allocate!");
+    }
+    for(int i = 0; i < size/2; i++){
+        odd[i] = values[2*i+1];
+        values[i] = values[2*i];
+    }
+
     // Forking and saving info in info_t
     info_t eInfo, oInfo;
+    fflush(stdout);
     spawn_child(&eInfo);
     spawn_child(&oInfo);
-    FILE * fileE = fdopen(eInfo.write, "w");
-    FILE * fileO = fdopen(oInfo.write, "w");
 
-    // Writing two buffered inputs
-    size = 2;
-    if(write_data(bufferA, fileE) == -1){
+    // Every child gets its half as one block, it reads the whole block before it answers
+    if(write_block(eInfo.write, values, size/2) == -1 || write_block(oInfo.write, odd, size/2) == -1){
+        free(values);
+        free(odd);
         error_exit("Failed to write");
     }
-    if(write_data(bufferB, fileO) == -1){
-        error_exit("Failed to write");
+    close(eInfo.write);
+    close(oInfo.write);
+    free(values);
+    free(odd);
+
+    // Reading the results before waiting, a large block doesn't fit into the pipe
+    complex_t * result = calculate_result(eInfo.read,oInfo.read,size);
+
+    // Checking if child processes terminated correctly
+    if(wait_child(eInfo.pid) == -1 || wait_child(oInfo.pid) == -1){
+        free(result);
+        error_exit("Child Process failed!");
     }
-    // works
-    while(read_data(bufferA,stdin) != -1){
-        if(write_data(bufferA,fileE) == -1){
-            error_exit("Failed to write");
-        }
-        if(read_data(bufferB, stdin)!=-1){
-            if(write_data(bufferB,fileO) == -1){
-                error_exit("Failed to write!");
+    return result;
+}
+
+static void transform_shared(complex_t * values, int size);
+
+/**
+ * @brief forks a child that transforms the size values in place and writes one byte to a pipe when it is done.
+ * @param values the values of the child inside the shared region.
+ * @param size number of values.
+ * @param info the read end of the pipe and the pid of the child are saved in here.
+ */
+static void spawn_shared(complex_t * values, int size, info_t * info){
+    int pipefd[2];
+    if(pipe(pipefd) == -1){
+        error_exit("Failed to pipe!");
+    }
+    fflush(stdout);
+    pid_t pid = fork();
+    switch(pid){
+        case -1:
+            error_exit("Failed to fork!");
+            break;
+        case 0:
+            close(pipefd[0]);
+            transform_shared(values, size);
+            char done = 1;
+            while(write(pipefd[1], &done, 1) == -1){
+                if(errno != EINTR){
+                    error_exit("Failed to write");
+                }
             }
-        } else {
-            close(oInfo.read);
-            close(eInfo.read);
-            fclose(fileE);
-            fclose(fileO);
+            exit(EXIT_SUCCESS);
+        default:
+            close(pipefd[1]);
+            info->read = pipefd[0];
+            info->write = -1;
+            info->pid = pid;
+            break;
+    }
+}
+
+/**
+ * @brief waits for the byte of a child spawned by spawn_shared.
+ * @param fd read end of the pipe to the child.
+ * @return returns -1 if the child exited without it else 0.
+ */
+static int wait_done(int fd){
+    char done;
+    ssize_t r;
+    while((r = read(fd, &done, 1)) == -1 && errno == EINTR){
+    }
+    close(fd);
+    return r == 1 ? 0 : -1;
+}
+
+/**
+ * @brief calculates the FFT of the values in place, the two children transform the even and the odd values in place too.
+ * @details the values are split into the even ones in the first and the odd ones in the second half, so the
+ * children get a contiguous range each. The butterflies then combine both halves into the same range.
+ * @param values the values inside the shared region.
+ * @param size number of values, 1 or even.
+ */
+static void transform_shared(complex_t * values, int size){
+    if(size == 1){
+        return;
+    }
+    if(size % 2 != 0){
+        error_exit("Input has to be even!");
+    }
+
+    complex_t * odd = malloc(size/2 * sizeof(complex_t));
+    if(odd == NULL){
+        error_exit("Failed to allocate!");
+    }
+    for(int i = 0; i < size/2; i++){
+        odd[i] = values[2*i+1];
+        values[i] = values[2*i];
+    }
+    memcpy(values + size/2, odd, size/2 * sizeof(complex_t));
+    free(odd);
+
+    info_t eInfo, oInfo;
+    spawn_shared(values, size/2, &eInfo);
+    spawn_shared(values + size/2, size/2, &oInfo);
+
+    int failed = wait_done(eInfo.read) == -1;
+    failed |= wait_done(oInfo.read) == -1;
+    if(wait_child(eInfo.pid) == -1 || wait_child(oInfo.pid) == -1 || failed){
+        error_exit("Child Process failed!");
+    }
+
+    // butterflies reads both halves before it writes the results
+    if(butterflies(values, values + size/2, values, size) == -1){
+        error_exit("Failed to allocate!");
+    }
+}
+
+/**
+ * @brief calculates the FFT of the values with transform or, for -s, with transform_shared in a shared region.
+ * @param values the values, freed by this function.
+ * @param size number of values, 1 or even.
+ * @param shared whether the children share one region instead of getting blocks over pipes.
+ * @return returns the size results (to be freed by the caller).
+ */
+static complex_t * run_transform(complex_t * values, int size, int shared){
+    if(!shared){
+        return transform(values, size);
+    }
+
+    // The children inherit the mapping, an exec would lose it
+    complex_t * region = mmap(NULL, size * sizeof(complex_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if(region == MAP_FAILED){
+        free(values);
+        error_exit("Failed to map!");
+    }
+    memcpy(region, values, size * sizeof(complex_t));
+    transform_shared(region, size);
+    memcpy(values, region, size * sizeof(complex_t));
+    munmap(region, size * sizeof(complex_t));
+    return values;
+}
+
+/**
+ * Main
+*/
+int main(int argc, char * argv[]){
+    program = argv[0];
+
+    // -b: stdin and stdout are binary blocks (only used between parent and children)
+    // -r: real samples to bins, -R: bins to real samples (only at the root)
+    // -s: the children work in one shared region (combines with -r and -R)
+    int binary = 0, real = 0, inverse = 0, shared = 0;
+    int c;
+    while((c = getopt(argc, argv, "brRs")) != -1){
+        switch(c) {
+            case 'b':
+                binary = 1;
+                break;
+            case 'r':
+                real = 1;
+                break;
+            case 'R':
+                inverse = 1;
+                break;
+            case 's':
+                shared = 1;
+                break;
+            default:
+                usage("Invalid option");
+        }
+    }
+    if(optind != argc){
+        usage("No arguments allowed");
+    }
+    if(binary + real + inverse > 1){
+        usage("Only one mode allowed");
+    }
+    if(binary && shared){
+        usage("Shared region only at the root");
+    }
+
+    int size;
+    char first[MAX_LINE_LENGTH];
+    complex_t * values;
+    if(binary){
+        if((values = read_block(STDIN_FILENO, &size)) == NULL){
+            error_exit("Failed to read!");
+        }
+    } else {
+        values = read_text(first, &size);
+    }
+    if(size == 0){
+        free(values);
+        error_exit("Failed to read!");
+    }
+
+    if(real){
+        // n real samples are n/2 complex values for the tree
+        if(size % 2 != 0){
+            free(values);
             error_exit("Input has to be even!");
         }
-        size+=2;
+        pack_samples(values, size);
+        complex_t * z = run_transform(values, size/2, shared);
+        complex_t * bins = unpack_bins(z, size);
+        free(z);
+        if(bins == NULL){
+            error_exit("Failed to allocate!");
+        }
+        write_text(bins, size/2 + 1, 0);
+        free(bins);
+        exit(EXIT_SUCCESS);
     }
-    fclose(fileE);
-    fclose(fileO);
-    // Checking if child processes terminated correctly
-    int status;
-    waitpid(eInfo.pid,&status,0);
-    if(WIFEXITED(status)){
-        if(WEXITSTATUS(status) == EXIT_FAILURE){
-            close(eInfo.read);
-            close(oInfo.read);
-            error_exit("Child Process failed!");
+    if(inverse){
+        // n/2+1 bins are n real samples, the FFT of the conjugate is n/2 times the conjugate
+        int n = 2 * (size - 1);
+        if(n == 0){
+            free(values);
+            error_exit("Input has to be at least two bins!");
+        }
+        complex_t * z = malloc(n/2 * sizeof(complex_t));
+        if(z == NULL){
+            free(values);
+            error_exit("Failed to allocate!");
+        }
+        pack_bins(values, z, n);
+        free(values);
+        z = run_transform(z, n/2, shared);
+        complex_t * samples = malloc(n * sizeof(complex_t));
+        if(samples == NULL){
+            free(z);
+            error_exit("Failed to allocate!");
+        }
+        for(int k = 0; k < n/2; k++){
+            samples[2*k].real = z[k].real / (n/2);
+            samples[2*k+1].real = -z[k].imaginary / (n/2);
         }
+        free(z);
+        write_text(samples, n, 1);
+        free(samples);
+        exit(EXIT_SUCCESS);
     }
-    waitpid(oInfo.pid,&status,0);
-    if(WIFEXITED(status)){
-        if(WEXITSTATUS(status) == EXIT_FAILURE){
-            close(eInfo.read);
-            close(oInfo.read);
-            error_exit("Child Process failed!");
+
+    if(size == 1){
+        if(binary){
+            if(write_block(STDOUT_FILENO, values, 1) == -1){
+                free(values);
+                error_exit("Failed to write!");
+            }
+        } else {
+            write_data(first,stdout);
         }
+        free(values);
+        exit(EXIT_SUCCESS);
     }
-    
-    calculate_result(eInfo.read,oInfo.read,size);
+
+    complex_t * result = run_transform(values, size, shared);
+    if(binary){
+        if(write_block(STDOUT_FILENO, result, size) == -1){
+            free(result);
+            error_exit("Failed to write!");
+        }
+    } else {
+        write_text(result, size, 0);
+    }
+    free(result);
     exit(EXIT_SUCCESS);
 }
@@ -6,17 +6,26 @@
  * @brief Header file containing structs used in forkFFT.c
  */
 #include <stdlib.h> 
+#include <stdint.h>
 #define MAX_LINE_LENGTH (128)
-#define PI (3.141592654)
+#define PI (3.14159265358979323846)
+// Type of the real and imaginary parts, make PRECISION=float for single precision.
+#ifndef SAMPLE_TYPE
+#define SAMPLE_TYPE double
+#endif
+// Upper bound for the number of values in one binary block.
+#define MAX_BLOCK_VALUES (1 << 24)
 
 /**
- * @brief stores two floats compromising the real and the imaginary part of a complex number.
+ * @brief stores two samples compromising the real and the imaginary part of a complex number.
  * @param real real part of complex number
  * @param imaginary imaginary part of complex number.
 */
+typedef SAMPLE_TYPE sample_t;
+
 typedef struct ComplexNumber {
-    float real;
-    float imaginary;
+    sample_t real;
+    sample_t imaginary;
 } complex_t;
 
 /**
@@ -30,3 +39,12 @@ typedef struct Info {
     int write;
     pid_t pid;
 } info_t;
+
+/**
+ * @brief header of a block in the binary protocol between parent and children.
+ * @details the header is followed by count packed complex_t values.
+ * @param count number of values in the block.
+*/
+typedef struct BlockHeader {
+    uint32_t count;
+} block_header_t;
@@ -0,0 +1,361 @@
+/**
+ * @file   external_sort.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The external merge sort of forksort, see external_sort.h.
+ **/
+
+#include "external_sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+
+/** The number of bytes requested from the input by one call to read. */
+#define READ_BLOCK_SIZE (1 << 16)
+
+/** The directory of the runs if TMPDIR isn't set and the name of a run within it. */
+#define DEFAULT_TMP_DIR "/tmp"
+#define RUN_NAME        "forksort-run-XXXXXX"
+
+//region TYPES
+/** Reads the input chunk by chunk, the part of a line after the end of a chunk is kept for the next one. */
+typedef struct {
+    int fd;
+    char *buffer;
+    size_t capacity;
+    size_t size;         // the number of bytes in the buffer
+    size_t newlines;     // the number of newlines in the buffer
+    size_t lastNewline;  // the position of the last newline in the buffer (only valid if newlines > 0)
+    size_t chunkEnd;     // the end of the current chunk incl. its final newline
+    int eof;
+} chunk_reader_t;
+
+/**
+ * A sorted run spilled to an unlinked temporary file.
+ * Every line of the run is terminated by a newline, the file is mapped to data for the merge.
+ */
+typedef struct {
+    FILE *file;
+    size_t size;
+    const char *data;
+    size_t position;     // the start of the current line
+    size_t length;       // the length of the current line without its newline
+} run_file_t;
+
+/** All runs of the input. */
+typedef struct {
+    run_file_t *runs;
+    size_t count;
+    size_t capacity;
+} run_list_t;
+//endregion
+
+//region CHUNKS
+/** Counts the newlines in buffer[from] to buffer[size - 1] and remembers the position of the last one. */
+static void countNewlines(chunk_reader_t *reader, size_t from)
+{
+    char *end = reader->buffer + reader->size;
+    for (char *c = memchr(reader->buffer + from, '\n', end - reader->buffer - from); c != NULL;
+         c = memchr(c + 1, '\n', end - c - 1))
+    {
+        reader->newlines++;
+        reader->lastNewline = c - reader->buffer;
+    }
+}
+
+/**
+ * @brief Reads the next chunk of the input and splits it into lines.
+ * @details Reads until the chunk and the pointers to its lines exceed the memory limit (and it contains a newline)
+ * or EOF is encountered. The chunk ends with its last complete line, the rest is kept for the next one.
+ * The last chunk contains everything up to EOF and sets reader->eof.
+ *
+ * @param reader      The reader of the input.
+ * @param memoryLimit The memory budget in bytes.
+ * @param chunk_out   The arena to initialize with the lines of the chunk, its lines have to be freed.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+static int readChunk(chunk_reader_t *reader, size_t memoryLimit, line_arena_t *chunk_out)
+{
+    while (!reader->eof &&
+           (reader->newlines == 0 || reader->size + reader->newlines * ARENA_LINE_OVERHEAD < memoryLimit))
+    {
+        if (reader->size + 1 >= reader->capacity) // room for the \0 of the last line
+        {
+            size_t capacity = reader->capacity == 0 ? READ_BLOCK_SIZE + 1 : reader->capacity * 2;
+            char *grown = realloc(reader->buffer, capacity);
+            if (grown == NULL)
+                return -1;
+            reader->buffer = grown;
+            reader->capacity = capacity;
+        }
+
+        size_t request = reader->capacity - 1 - reader->size;
+        ssize_t bytesRead = read(reader->fd, reader->buffer + reader->size,
+                                 request < READ_BLOCK_SIZE ? request : READ_BLOCK_SIZE);
+        if (bytesRead == -1 && errno == EINTR)
+            continue;
+        if (bytesRead == -1)
+            return -1;
+        if (bytesRead == 0)
+        {
+            reader->eof = 1;
+            break;
+        }
+
+        size_t from = reader->size;
+        reader->size += bytesRead;
+        countNewlines(reader, from);
+    }
+
+    chunk_out->data = reader->buffer;
+    if (reader->eof)
+    {
+        chunk_out->size = reader->size;
+        reader->chunkEnd = reader->size;
+    }
+    else
+    {
+        chunk_out->size = reader->lastNewline;
+        reader->chunkEnd = reader->lastNewline + 1;
+    }
+    chunk_out->data[chunk_out->size] = '\0';
+    return splitArena(chunk_out);
+}
+
+/** Moves the rest of the input after the current chunk to the start of the buffer. */
+static void nextChunk(chunk_reader_t *reader)
+{
+    memmove(reader->buffer, reader->buffer + reader->chunkEnd, reader->size - reader->chunkEnd);
+    reader->size -= reader->chunkEnd;
+    reader->newlines = 0; // the rest never contains a newline
+}
+//endregion
+
+//region RUNS
+/**
+ * @brief Writes the sorted lines of a chunk to a new unlinked temporary file and adds it to the runs.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+static int spillRun(run_list_t *runs, const line_arena_t *chunk)
+{
+    if (runs->count == runs->capacity)
+    {
+        size_t capacity = runs->capacity == 0 ? 16 : runs->capacity * 2;
+        run_file_t *grown = realloc(runs->runs, capacity * sizeof(run_file_t));
+        if (grown == NULL)
+            return -1;
+        runs->runs = grown;
+        runs->capacity = capacity;
+    }
+
+    const char *directory = getenv("TMPDIR");
+    if (directory == NULL || *directory == '\0')
+        directory = DEFAULT_TMP_DIR;
+    char path[strlen(directory) + sizeof(RUN_NAME) + 1];
+    sprintf(path, "%s/%s", directory, RUN_NAME);
+
+    int fd = mkstemp(path);
+    if (fd == -1)
+        return -1;
+    unlink(path);
+
+    FILE *file = fdopen(fd, "w+");
+    if (file == NULL)
+    {
+        close(fd);
+        return -1;
+    }
+
+    size_t size = 0;
+    for (size_t i = 0; i < chunk->count; i++)
+    {
+        size_t length = strlen(chunk->lines[i]);
+        fwrite(chunk->lines[i], 1, length, file);
+        fputc('\n', file);
+        size += length + 1;
+    }
+    if (fflush(file) == EOF || ferror(file))
+    {
+        fclose(file);
+        return -1;
+    }
+
+    run_file_t *run = &runs->runs[runs->count++];
+    run->file = file;
+    run->size = size;
+    run->data = NULL;
+    run->position = 0;
+    return 0;
+}
+
+/** Sets the length of the current line of a run (if it isn't exhausted). */
+static void loadLine(run_file_t *run)
+{
+    if (run->position < run->size)
+        run->length = (const char *) memchr(run->data + run->position, '\n', run->size - run->position) -
+                      (run->data + run->position);
+}
+
+/**
+ * @brief Indicates if the current line of run a comes before the one of run b.
+ * @details Exhausted runs come last, equal lines are ordered by the index of their run.
+ * The lines contain neither \0 nor \n, so comparing them with memcmp and by length gives the order of strcmp.
+ */
+static int runBefore(const run_file_t *runs, size_t a, size_t b)
+{
+    int aExhausted = runs[a].position >= runs[a].size;
+    int bExhausted = runs[b].position >= runs[b].size;
+    if (aExhausted || bExhausted)
+        return aExhausted == bExhausted ? a < b : bExhausted;
+
+    size_t lengthA = runs[a].length;
+    size_t lengthB = runs[b].length;
+    int order = memcmp(runs[a].data + runs[a].position, runs[b].data + runs[b].position,
+                       lengthA < lengthB ? lengthA : lengthB);
+    if (order == 0)
+        order = (lengthA > lengthB) - (lengthA < lengthB);
+    return order < 0 || (order == 0 && a < b);
+}
+
+/**
+ * @brief Builds the subtree of the loser tree at node and returns its winner.
+ * @details The tree has count leaves (the runs) at the positions count to 2 * count - 1, the inner node i has the
+ * children 2 * i and 2 * i + 1 and stores the loser of the match between their winners.
+ */
+static size_t buildLoserTree(const run_file_t *runs, size_t *tree, size_t count, size_t node)
+{
+    if (node >= count)
+        return node - count;
+
+    size_t left = buildLoserTree(runs, tree, count, 2 * node);
+    size_t right = buildLoserTree(runs, tree, count, 2 * node + 1);
+    if (runBefore(runs, left, right))
+    {
+        tree[node] = right;
+        return left;
+    }
+    tree[node] = left;
+    return right;
+}
+
+/**
+ * @brief Maps all runs and merges them into out with a loser tree.
+ * @details tree[0] holds the run with the smallest current line. After it was output the run advances and only
+ * replays the matches on the path from its leaf to the root, which costs log2(runs) comparisons per line.
+ * With unique a line equal to the previous output line is skipped, it is still mapped so it can be compared.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+static int mergeRunFiles(run_list_t *runs, FILE *out, int unique)
+{
+    size_t count = runs->count;
+    for (size_t r = 0; r < count; r++)
+    {
+        run_file_t *run = &runs->runs[r];
+        void *data = mmap(NULL, run->size, PROT_READ, MAP_PRIVATE, fileno(run->file), 0);
+        if (data == MAP_FAILED)
+            return -1;
+        madvise(data, run->size, MADV_SEQUENTIAL);
+        run->data = data;
+        loadLine(run);
+    }
+
+    size_t *tree = malloc(count * sizeof(size_t));
+    if (tree == NULL)
+        return -1;
+    tree[0] = buildLoserTree(runs->runs, tree, count, 1);
+
+    size_t written = 0;
+    const char *previous = NULL;
+    size_t previousLength = 0;
+    while (runs->runs[tree[0]].position < runs->runs[tree[0]].size)
+    {
+        size_t winner = tree[0];
+        run_file_t *run = &runs->runs[winner];
+        const char *line = run->data + run->position;
+        if (!unique || previous == NULL || previousLength != run->length || memcmp(previous, line, run->length) != 0)
+        {
+            if (written++ > 0)
+                fputc('\n', out);
+            fwrite(line, 1, run->length, out);
+            previous = line;
+            previousLength = run->length;
+        }
+
+        run->position += run->length + 1;
+        loadLine(run);
+        for (size_t node = (winner + count) / 2; node > 0; node /= 2)
+        {
+            if (runBefore(runs->runs, tree[node], winner))
+            {
+                size_t loser = winner;
+                winner = tree[node];
+                tree[node] = loser;
+            }
+        }
+        tree[0] = winner;
+    }
+    free(tree);
+
+    return fflush(out) == EOF || ferror(out) ? -1 : 0;
+}
+//endregion
+
+int externalSort(int fd, FILE *out, size_t memoryLimit, int threads, arena_sorter_t sorter, int unique)
+{
+    chunk_reader_t reader = {.fd = fd};
+    run_list_t runs = {0};
+    int result = -1;
+
+    while (1)
+    {
+        line_arena_t chunk;
+        if (readChunk(&reader, memoryLimit, &chunk) == -1)
+            break;
+        if (sorter(&chunk, threads) == -1)
+        {
+            free(chunk.lines);
+            break;
+        }
+        if (unique)
+            uniqueArena(&chunk);
+
+        // The whole input fit into the budget
+        if (reader.eof && runs.count == 0)
+        {
+            result = writeArena(&chunk, out);
+            free(chunk.lines);
+            break;
+        }
+
+        int spilled = spillRun(&runs, &chunk);
+        free(chunk.lines);
+        if (spilled == -1)
+            break;
+
+        if (reader.eof)
+        {
+            result = mergeRunFiles(&runs, out, unique);
+            break;
+        }
+        nextChunk(&reader);
+    }
+
+    int savedErrno = errno;
+    for (size_t r = 0; r < runs.count; r++)
+    {
+        if (runs.runs[r].data != NULL)
+            munmap((void *) runs.runs[r].data, runs.runs[r].size);
+        fclose(runs.runs[r].file);
+    }
+    free(runs.runs);
+    free(reader.buffer);
+    errno = savedErrno;
+    return result;
+}
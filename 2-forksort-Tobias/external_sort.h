@@ -0,0 +1,43 @@
+/**
+ * @file   external_sort.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The external merge sort of forksort for inputs larger than the memory budget.
+ *
+ * @details The input is read in chunks that fit into the budget. Every chunk is sorted by the in-process engine
+ * (parallel_sort.h) and spilled as a sorted run to an unlinked temporary file in $TMPDIR (/tmp by default).
+ * Afterwards all runs are memory-mapped and merged with a loser tree.
+ * If the whole input fits into the budget nothing is spilled.
+ **/
+
+#ifndef EXTERNAL_SORT_H
+#define EXTERNAL_SORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+#include "parallel_sort.h"
+
+/** The smallest memory budget accepted by externalSort. */
+#define MIN_MEMORY_LIMIT (1 << 16)
+
+/**
+ * @brief Sorts all lines read from fd with strcmp and outputs them within a memory budget.
+ * @details The budget covers the chunk of the input and the memory the sorter needs per line of it.
+ * A single line that doesn't fit into the budget is read into a larger chunk anyway.
+ * The output is the same as the one of sorter and writeArena. With unique every chunk is passed through uniqueArena
+ * before it is spilled and the merge drops lines equal to the one output before.
+ *
+ * @param fd          The file descriptor to read from.
+ * @param out         The FILE* to write the sorted lines to.
+ * @param memoryLimit The memory budget in bytes (at least MIN_MEMORY_LIMIT).
+ * @param threads     The number of threads used to sort a chunk (1 to MAX_THREADS).
+ * @param sorter      The engine used to sort a chunk (sortArena or sortArenaRadix).
+ * @param unique      Indicates if equal lines should only be output once.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int externalSort(int fd, FILE *out, size_t memoryLimit, int threads, arena_sorter_t sorter, int unique);
+
+#endif
@@ -14,7 +14,14 @@
  * for comparison until all children terminated.
  * The process does not know if it outputs the result to the console or to a parent process,
  * as stdout is redirected for children.
- * The program takes no arguments. All lines are read from stdin.
+ * With -p the lines are instead sorted in this process by the parallel engine of parallel_sort.h,
+ * -j sets its number of threads (the number of online processors by default).
+ * -m limits the memory used for the lines, larger inputs are sorted by the external merge sort of external_sort.h.
+ * -r sorts by MSD radix sort on prefix keys instead of merging sorted runs.
+ * -u outputs equal lines only once: every child is started with -u and a parent drops one of two equal lines
+ * of its children, so duplicates never travel up the tree (the in-process engines drop them after sorting).
+ * -k K only outputs the first K lines, they are selected by the streaming engine of top_k.h without forking.
+ * Without options the program forks as described above. All lines are read from stdin.
  **/
 /*        FDS
  *             outputPipe |
@@ -32,8 +39,13 @@
 #include <wait.h>
 #include <errno.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/stat.h>
 
+#include "parallel_sort.h"
+#include "external_sort.h"
+#include "top_k.h"
+
 
 //region ERROR
 #define TRY(result, message) try(result, message, __LINE__)
@@ -58,6 +70,11 @@
 # define ERROR_WRITE_PARENT   "Writing to parent failed"
 # define ERROR_CHILD_FAILURE  "Child terminated with error"
 # define ERROR_WAIT_FOR_CHILD "Waiting for child completion failed"
+
+# define ERROR_READ_INPUT  "Reading input failed"
+# define ERROR_SORT        "Sorting failed"
+# define ERROR_EXTERNAL    "External sorting failed"
+# define ERROR_TOP_K       "Selecting the first lines failed"
 //endregion
 //endregion
 
@@ -71,6 +88,11 @@
         TRY(fprintf(g_process_log, format, __VA_ARGS__), ERROR_LOGGING) \
 //endregion
 
+//region LINES
+#define LINE_RECORDS          2  // the current and the next line of the input or the current lines of both children
+#define LINE_INITIAL_CAPACITY 64 // the initial size of a line buffer, doubled whenever a line doesn't fit
+//endregion
+
 //region TYPES
 /** Convenience type to emulate a boolean value. */
 typedef enum {
@@ -110,6 +132,16 @@ typedef enum {
 
 /** Reuse pipe_end_e to also indicate the mode of a pipe. */
 typedef pipe_end_e pipe_mode_e;
+
+/**
+ * Represents a line read by tryReadLineFrom.
+ * Holds a buffer that is grown geometrically and reused for every line read into the record,
+ * the current line is stored in it (incl. \n if any and \0) and stays there until the next read.
+ */
+typedef struct {
+    char *data;
+    size_t capacity;
+} line_t;
 //endregion
 
 //region GLOBAL VARIABLES
@@ -123,16 +155,38 @@ child_process_t child2_g;
 
 /** A pointer to the logfile of the process if logging is enabled and was initialized. */
 FILE *g_process_log;
+
+/**
+ * The line records of the process. All lines are read into these records, a line lives in its record until it was
+ * forwarded or output, so the buffers only grow to the longest line read and are reused otherwise.
+ */
+line_t lines_g[LINE_RECORDS];
+
+/** Indicates if the lines should be sorted in-process (option -p) instead of forking. */
+bool inProcess_g = false;
+/** The number of threads of the in-process engine (option -j). */
+int threads_g = 0;
+/** The memory budget of the in-process engine in bytes (option -m), 0 if it is unlimited. */
+size_t memoryLimit_g = 0;
+/** The engine used to sort in-process, sortArenaRadix if option -r was specified. */
+arena_sorter_t sorter_g = sortArena;
+/** Indicates if equal lines should only be output once (option -u). */
+bool unique_g = false;
+/** The number of lines to output (option -k), 0 if all lines are output. */
+size_t topK_g = 0;
 //endregion
 
 //region FUNCTIONS DECLARATIONS
 static inline void tryOpenProcessLog(void);
 static inline void tryParseArguments(int argc, char **argv);
+static inline void trySortInProcess(void);
+static inline void trySelectTopK(void);
 
-static inline bool tryReadLineFrom(FILE* source, char **line_out, int *lineSize_out);
-static inline void tryReadLineAndExitOnEOF(char **line_out);
-static inline void tryForwardInputToChildren(char **currLine_in_out);
-static inline void tryReadAndOutputChildrenResultsOrdered(char **lineChild1, char **lineChild2);
+static inline bool tryReadLineFrom(FILE* source, line_t *line_out, int *lineSize_out);
+static inline void tryReadLineAndExitOnEOF(line_t *line_out);
+static inline void tryForwardInputToChildren(line_t *currLine_in_out);
+static inline void tryReadAndOutputChildrenResultsOrdered(line_t *lineChild1, line_t *lineChild2);
+static inline void freeLines(void);
 
 static inline void tryStartAndRunChild(child_process_t* childPtr);
 static inline void tryOpenChildrenAccess(pipe_mode_e mode);
@@ -155,6 +209,7 @@ static inline void try(int operationResult, const char *message, int line);
  *                        child1_g      - The first child of the process if any
  *                        child2_g      - The second child of the process if any
  *                        g_process_log - A pointer to the logfile of the process if logging is enabled and was initialized.
+ *                        lines_g       - The line records of the process
  *
  * @param argumentCounter The argument counter.
  * @param argumentValues  The argument values.
@@ -168,10 +223,13 @@ int main(int argc, char *argv[])
     LOG("%s", "Program started.\n\n");
 
     tryParseArguments(argc, argv);
+    if (topK_g != 0)
+        trySelectTopK();
+    if (inProcess_g)
+        trySortInProcess();
 
     LOG("%s", "Try reading first line...\n\n");
-    char *line = malloc(sizeof(char));
-    tryReadLineAndExitOnEOF(&line);
+    tryReadLineAndExitOnEOF(&lines_g[0]);
     LOG("%s", "Input seems to consist of multiple lines.\n\n");
 
     LOG("%s", "Try initializing children...\n\n");
@@ -181,14 +239,13 @@ int main(int argc, char *argv[])
 
     LOG("%s", "Try forwarding input to children...\n\n");
     tryOpenChildrenAccess(WRITE);
-    tryForwardInputToChildren(&line);
+    tryForwardInputToChildren(&lines_g[0]);
     tryCloseChildrenAccess(WRITE);
     LOG("%s", "Input successfully redirected and input pipes closed.\n\n");
 
     LOG("%s", "Try reading output of children and output result...\n\n");
     tryOpenChildrenAccess(READ);
-    char* line2 = malloc(sizeof(char));
-    tryReadAndOutputChildrenResultsOrdered(&line, &line2);
+    tryReadAndOutputChildrenResultsOrdered(&lines_g[0], &lines_g[1]);
     tryCloseChildrenAccess(READ);
     LOG("%s", "Result output succeeded.\n\n");
 
@@ -197,8 +254,7 @@ int main(int argc, char *argv[])
     tryWaitForChildCompletion(child2_g.pid);
     LOG("%s", "Children completed successfully.\n\n");
 
-    free(line);
-    free(line2);
+    freeLines();
 
     if (LOGGING)
         fclose(g_process_log);
@@ -208,21 +264,138 @@ int main(int argc, char *argv[])
 
 
 /**
- * @brief Verifies there are no arguments except the program name and sets it.
- * @details Terminates the program with EXIT_FAILURE if one or more arguments were specified by the user.
+ * @brief Sets the program name and parses the options.
+ * @details Terminates the program with EXIT_FAILURE if an invalid option or a positional argument was specified.
+ * -j, -m and -r are only allowed together with -p, -k not together with -p. MEM is a number of bytes optionally
+ * followed by K, M or G.
  *
  * global variables used: programName_g - The program name as specified in argumentValues[0]
+ *                        inProcess_g   - Indicates if the lines should be sorted in-process
+ *                        threads_g     - The number of threads of the in-process engine
+ *                        memoryLimit_g - The memory budget of the in-process engine
+ *                        sorter_g      - The engine used to sort in-process
+ *                        unique_g      - Indicates if equal lines should only be output once
+ *                        topK_g        - The number of lines to output
  */
 static inline void tryParseArguments(int argc, char **argv)
 {
-    if (argc != 1)
+    programName_g = argv[0];
+
+    bool valid = true;
+    int option;
+    while ((option = getopt(argc, argv, "pj:m:ruk:")) != -1)
     {
-        fprintf(stderr, "Invalid parameters. USAGE: %s\n", programName_g);
-        LOG("Invalid parameters. USAGE: %s\n", programName_g);
+        char *end;
+        switch (option)
+        {
+            case 'p':
+                inProcess_g = true;
+                break;
+            case 'j':
+                threads_g = (int) strtol(optarg, &end, 10);
+                if (*end != '\0' || threads_g < 1 || threads_g > MAX_THREADS)
+                    valid = false;
+                break;
+            case 'r':
+                sorter_g = sortArenaRadix;
+                break;
+            case 'u':
+                unique_g = true;
+                break;
+            case 'k':
+                topK_g = strtoull(optarg, &end, 10);
+                if (*end != '\0' || *optarg == '-' || topK_g == 0)
+                    valid = false;
+                break;
+            case 'm':
+                memoryLimit_g = strtoull(optarg, &end, 10);
+                if (*end != '\0' && end[1] == '\0')
+                {
+                    int shift = *end == 'K' ? 10 : *end == 'M' ? 20 : *end == 'G' ? 30 : -1;
+                    if (shift == -1 || memoryLimit_g > (SIZE_MAX >> shift))
+                        valid = false;
+                    memoryLimit_g <<= shift == -1 ? 0 : shift;
+                    end++;
+                }
+                if (*end != '\0' || *optarg == '-' || memoryLimit_g < MIN_MEMORY_LIMIT)
+                    valid = false;
+                break;
+            default:
+                valid = false;
+        }
+    }
+
+    if (!valid || optind != argc || ((threads_g != 0 || memoryLimit_g != 0 || sorter_g != sortArena) && !inProcess_g) ||
+        (topK_g != 0 && inProcess_g))
+    {
+        fprintf(stderr, "Invalid parameters. USAGE: %s [-u] [-k K | -p [-j THREADS] [-m MEM] [-r]]\n", programName_g);
+        LOG("Invalid parameters. USAGE: %s [-u] [-k K | -p [-j THREADS] [-m MEM] [-r]]\n", programName_g);
         exit(EXIT_FAILURE);
     }
+}
 
-    programName_g = argv[0];
+/**
+ * @brief Sorts all lines of stdin with the in-process engine, outputs them and terminates with EXIT_SUCCESS.
+ * @details The lines are output separated by newlines in the same order as the forking engine outputs them.
+ * Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate upon failure.
+ *
+ * If a memory budget was specified the lines are sorted by externalSort, which spills runs to temporary files
+ * if the input doesn't fit into it. With -u equal lines are dropped after sorting.
+ *
+ * global variables used: threads_g     - The number of threads of the in-process engine
+ *                        memoryLimit_g - The memory budget of the in-process engine
+ *                        sorter_g      - The engine used to sort in-process
+ *                        unique_g      - Indicates if equal lines should only be output once
+ */
+static inline void trySortInProcess(void)
+{
+    if (threads_g == 0)
+    {
+        long processors = sysconf(_SC_NPROCESSORS_ONLN);
+        threads_g = processors < 1 ? 1 : processors > MAX_THREADS ? MAX_THREADS : (int) processors;
+    }
+
+    if (memoryLimit_g != 0)
+    {
+        LOG("Sorting with %d threads within %zu bytes.\n", threads_g, memoryLimit_g);
+        TRY(externalSort(STDIN_FILENO, stdout, memoryLimit_g, threads_g, sorter_g, unique_g), ERROR_EXTERNAL);
+
+        if (LOGGING)
+            fclose(g_process_log);
+        exit(EXIT_SUCCESS);
+    }
+
+    line_arena_t arena;
+    TRY(readArena(STDIN_FILENO, &arena), ERROR_READ_INPUT);
+    LOG("Read %zu lines, sorting them with %d threads.\n", arena.count, threads_g);
+
+    TRY(sorter_g(&arena, threads_g), ERROR_SORT);
+    if (unique_g)
+        uniqueArena(&arena);
+    TRY(writeArena(&arena, stdout), ERROR_WRITE_PARENT);
+    freeArena(&arena);
+
+    if (LOGGING)
+        fclose(g_process_log);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief Outputs the first lines of stdin with the top-k engine and terminates with EXIT_SUCCESS.
+ * @details The lines are output like by the in-process engine, only the first topK_g of them.
+ * Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate upon failure.
+ *
+ * global variables used: topK_g   - The number of lines to output
+ *                        unique_g - Indicates if equal lines should only be output once
+ */
+static inline void trySelectTopK(void)
+{
+    LOG("Selecting the first %zu lines.\n", topK_g);
+    TRY(topKSort(STDIN_FILENO, stdout, topK_g, unique_g), ERROR_TOP_K);
+
+    if (LOGGING)
+        fclose(g_process_log);
+    exit(EXIT_SUCCESS);
 }
 
 //region ERROR HANDLING
@@ -297,22 +470,56 @@ static inline void tryOpenProcessLog(void)
 
 //region INPUT HANDLING
 /**
- * @brief Copies the contents of source to dest without a terminating newline if source contained one.
- * @details Terminates the program with EXIT_FAILURE if the call to strcpy fails by calling printErrnoAndTerminate.
+ * @brief Computes the length of a line without its terminating newline if it contains one.
  *
- * @param source The string to copy.
- * @param dest   The destination. Must be big enough to hold the full source.
- * @param size   The size of source incl. \0
+ * @param line The line.
+ * @param size The size of the line incl. \0
  *
- * @return returns dest for convenience
+ * @return The number of characters before the newline (or the \0 if there is none).
  */
-static inline char *tryCopyWithoutNewline(char *source, char *dest, int size)
+static inline int lengthWithoutNewline(const char *line, int size)
 {
-    TRY_PTR(strcpy(dest, source), "strcpy failed");
-    if (dest[size-2] == '\n')
-        dest[size-2] = '\0';
+    if (size >= 2 && line[size-2] == '\n')
+        return size - 2;
+
+    return size - 1;
+}
+
+/**
+ * @brief Makes sure the buffer of a line record can hold at least size characters.
+ * @details The capacity is doubled until it suffices, so reading a line of length L costs O(log L) calls to realloc
+ * in the lifetime of the record. Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate
+ * if realloc fails.
+ *
+ * @param line The line record.
+ * @param size The number of characters that must fit.
+ */
+static inline void tryReserveLine(line_t *line, size_t size)
+{
+    if (size <= line->capacity)
+        return;
+
+    size_t capacity = line->capacity == 0 ? LINE_INITIAL_CAPACITY : line->capacity;
+    while (capacity < size)
+        capacity *= 2;
+
+    TRY_PTR(line->data = realloc(line->data, capacity * sizeof(char)), ERROR_REALLOC);
+    line->capacity = capacity;
+}
 
-    return dest;
+/**
+ * @brief Frees the buffers of all line records.
+ *
+ * global variables used: lines_g - The line records of the process
+ */
+static inline void freeLines(void)
+{
+    for (int i = 0; i < LINE_RECORDS; i++)
+    {
+        free(lines_g[i].data);
+        lines_g[i].data = NULL;
+        lines_g[i].capacity = 0;
+    }
 }
 
 /**
@@ -320,18 +527,18 @@ static inline char *tryCopyWithoutNewline(char *source, char *dest, int size)
  * If the line is terminated by EOF instead of a newline it is printed to stdout and the program terminates with EXIT_SUCCESS.
  * @details Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate upon failure to read or print the line.
  *
- * @param line_out A pointer to a with malloc initialized memory-area. Will be resized to fit the line.
+ * @param line_out The line record to read the line into.
  */
-static inline void tryReadLineAndExitOnEOF(char **line_out)
+static inline void tryReadLineAndExitOnEOF(line_t *line_out)
 {
     bool terminatedByEOF = tryReadLineFrom(stdin, line_out, NULL);
 
     if(terminatedByEOF)
     {
-        TRY(fprintf(stdout, "%s", *line_out), ERROR_WRITE_PARENT);
+        TRY(fprintf(stdout, "%s", line_out->data), ERROR_WRITE_PARENT);
         LOG("%s", "Input was only a single line, process terminates.\n");
 
-        free(*line_out);
+        freeLines();
         exit(EXIT_SUCCESS);
     }
 }
@@ -339,46 +546,39 @@ static inline void tryReadLineAndExitOnEOF(char **line_out)
 /**
  * @brief Reads one line from source to line (including \n but excluding EOF).
  * Returns true if the line is terminated by EOF instead of a newline.
- * @details Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate upon failure to read the line
- * or reallocate memory.
+ * @details The buffer of the record is only grown if the line doesn't fit (see tryReserveLine).
+ * Terminates the program with EXIT_FAILURE by calling printErrnoAndTerminate upon failure to reallocate memory.
  *
  * @param source       The FILE* the line should be read from.
- * @param line_out     A pointer to a with malloc initialized memory-area. Will be resized to fit the line.
+ * @param line_out     The line record to read the line into, its previous line is overwritten.
  * @param lineSize_out Will contain the size of the line after functions completed (\0 included).
  *
  * @return true if the line was terminated by EOF, false if it was terminated by a newline.
  */
-static inline bool tryReadLineFrom(FILE* source, char **line_out, int *lineSize_out)
+static inline bool tryReadLineFrom(FILE* source, line_t *line_out, int *lineSize_out)
 {
-    int i = 0;
+    size_t i = 0;
     int nextChar;
-    do
+    while ((nextChar = getc(source)) != EOF) // don't write EOF to output
     {
-        TRY_PTR(*line_out = realloc(*line_out, (i + 1) * sizeof(char)), ERROR_REALLOC);
-
-        nextChar = fgetc(source);
-        if (nextChar == EOF)
-            break; // don't write EOF to output
+        tryReserveLine(line_out, i + 2); // room for the character and \0
+        line_out->data[i++] = (char) nextChar;
 
-        (*line_out)[i] = (char) nextChar;
-        i++;
+        if (nextChar == '\n') // do write \n to output
+            break;
     }
-    while(nextChar != '\n'); // do write \n to output
 
-    if (nextChar == '\n')
-        TRY_PTR(*line_out = realloc(*line_out, (i + 1) * sizeof(char)), ERROR_REALLOC);
+    tryReserveLine(line_out, i + 1);
+    line_out->data[i] = '\0';
 
-    (*line_out)[i] = '\0';
-
-    int size = i+1;
+    int size = (int) i + 1;
     if (lineSize_out != NULL)
         *lineSize_out = size;
 
-    bool terminatedByEOF = i == 0 || (*line_out)[i - 1] != '\n'; // line was terminated by EOF if the char before \0 is not \n
+    bool terminatedByEOF = i == 0 || line_out->data[i - 1] != '\n'; // line was terminated by EOF if the char before \0 is not \n
 
-    char lineWithoutNl[size];
-    tryCopyWithoutNewline(*line_out, lineWithoutNl, size);
-    LOG("Read line: %s - Terminated by EOF: %s\n", lineWithoutNl, terminatedByEOF ? "true" : "false");
+    LOG("Read line: %.*s - Terminated by EOF: %s\n", lengthWithoutNewline(line_out->data, size), line_out->data,
+        terminatedByEOF ? "true" : "false");
 
     return terminatedByEOF;
 }
@@ -389,40 +589,41 @@ static inline bool tryReadLineFrom(FILE* source, char **line_out, int *lineSize_
  *
  * global variables used: child1_g - The first child of the process if any
  *                        child2_g - The second child of the process if any
+ *                        lines_g  - The line records of the process
  *
- * @param currLine_in_out A pointer to the first line read by the program, will be resized and therefore needs to
- * be initialized with malloc.
+ * @param currLine_in_out The line record holding the first line read by the program. It and the other record
+ * of lines_g are reused for the following lines.
  */
-static inline void tryForwardInputToChildren(char **currLine_in_out)
+static inline void tryForwardInputToChildren(line_t *currLine_in_out)
 {
     child_process_t *children[2] = {&child1_g, &child2_g};
 
-    int nextLineSize;
-    char *nextLine = malloc(sizeof(char));
+    // The records of the current and the next line swap their roles after every line instead of copying it
+    line_t *currLine = currLine_in_out;
+    line_t *nextLine = currLine_in_out == &lines_g[0] ? &lines_g[1] : &lines_g[0];
 
     bool readEOF = false;
     for (int alternatingIndex = 0; !readEOF; alternatingIndex = !alternatingIndex)
     {
-        readEOF = tryReadLineFrom(stdin, &nextLine, &nextLineSize);
+        readEOF = tryReadLineFrom(stdin, nextLine, NULL);
         if (readEOF)
         {
-            *(strchr(*currLine_in_out, '\n')) = '\0'; //remove \n from currLine as it is the last line for the child (\n will always be in currLine here)
-            TRY(fprintf(children[!alternatingIndex]->inputPipe.access, "%s", *currLine_in_out), ERROR_WRITE_CHILD);
-            LOG("Wrote final line to child %d: %s\n", !alternatingIndex+1, *currLine_in_out);
-            TRY(fprintf(children[alternatingIndex]->inputPipe.access, "%s", nextLine), ERROR_WRITE_CHILD);
-            LOG("Wrote final line to child %d: %s\n", alternatingIndex+1, nextLine);
+            *(strchr(currLine->data, '\n')) = '\0'; //remove \n from currLine as it is the last line for the child (\n will always be in currLine here)
+            TRY(fprintf(children[!alternatingIndex]->inputPipe.access, "%s", currLine->data), ERROR_WRITE_CHILD);
+            LOG("Wrote final line to child %d: %s\n", !alternatingIndex+1, currLine->data);
+            TRY(fprintf(children[alternatingIndex]->inputPipe.access, "%s", nextLine->data), ERROR_WRITE_CHILD);
+            LOG("Wrote final line to child %d: %s\n", alternatingIndex+1, nextLine->data);
         }
         else
         {
-            TRY(fprintf(children[alternatingIndex]->inputPipe.access, "%s", *currLine_in_out), ERROR_WRITE_CHILD);
-            LOG("Wrote line line to child %d: %s\n", alternatingIndex+1, *currLine_in_out);
+            TRY(fprintf(children[alternatingIndex]->inputPipe.access, "%s", currLine->data), ERROR_WRITE_CHILD);
+            LOG("Wrote line line to child %d: %s\n", alternatingIndex+1, currLine->data);
 
-            TRY_PTR(*currLine_in_out = realloc(*currLine_in_out, nextLineSize), ERROR_REALLOC);
-            strcpy(*currLine_in_out, nextLine);
+            line_t *written = currLine;
+            currLine = nextLine;
+            nextLine = written;
         }
     }
-
-    free(nextLine);
 }
 
 //region tryReadAndOutputChildrenResultsOrdered
@@ -448,21 +649,20 @@ static inline FILE* getChildAccessById(int childId) {
  *                        child2_g - The second child of the process if any
  *
  * @param childId                  Indicates from which child the next line should be read; 1 for child1_g, 2 for child2_g
- * @param line_in_out              A pointer to the line that should be printed, will be resized and overwritten if a new line is read.
+ * @param line_in_out              The record of the line that should be printed, will be overwritten if a new line is read.
  * @param lineSize_in_out          The size of the given line. Will be overwritten if a new line is read.
  * @param isLastLineOfChild_in_out Indicates if the given line is the last line of the child. Will be overwritten if a new line is read.
  * @param withNewline              Indicates weather the line should be printed with a trailing newline.
  *
  * @return true if the last line of the child was output, false otherwise.
  */
-static inline bool tryOutputAndReadNextIfNotLast(int childId, char **line_in_out, int *lineSize_in_out,
+static inline bool tryOutputAndReadNextIfNotLast(int childId, line_t *line_in_out, int *lineSize_in_out,
                                                  bool *isLastLineOfChild_in_out, bool withNewline)
 {
-    char lineWithoutNl[*lineSize_in_out];
-    tryCopyWithoutNewline(*line_in_out, lineWithoutNl, *lineSize_in_out);
+    int length = lengthWithoutNewline(line_in_out->data, *lineSize_in_out);
 
-    LOG("Output line of child %d: %s - %s.\n", childId, lineWithoutNl, withNewline ? "NL" : "EOF");
-    TRY(fprintf(stdout, "%s%c", lineWithoutNl, withNewline ? '\n' : '\0'), ERROR_WRITE_PARENT);
+    LOG("Output line of child %d: %.*s - %s.\n", childId, length, line_in_out->data, withNewline ? "NL" : "EOF");
+    TRY(fprintf(stdout, "%.*s%c", length, line_in_out->data, withNewline ? '\n' : '\0'), ERROR_WRITE_PARENT);
     if (*isLastLineOfChild_in_out)
     {
         LOG("Completed output of child %d.\n\n", childId);
@@ -478,11 +678,11 @@ static inline bool tryOutputAndReadNextIfNotLast(int childId, char **line_in_out
  * @details Terminates the program with EXIT_FAILURE upon failure of any called function by calling printErrnoAndTerminate.
 
  * @param childId         1 to indicate child1_g, 2 to indicate child2_g
- * @param line            A pointer to the current line read from the child. Needs to be malloc initialized, will be reused.
+ * @param line            The record of the current line read from the child, will be reused.
  * @param terminatedByEOF Indicates if the current line was terminated by EOF
  * @param lineSize        The size of the current line. Will be reused.
  */
-static inline void tryOutputRemainingLinesOfChild(int childId, char **line, bool terminatedByEOF, int *lineSize)
+static inline void tryOutputRemainingLinesOfChild(int childId, line_t *line, bool terminatedByEOF, int *lineSize)
 {
     LOG("Output remaining lines of child %d.\n", childId);
 
@@ -491,18 +691,55 @@ static inline void tryOutputRemainingLinesOfChild(int childId, char **line, bool
         completed = tryOutputAndReadNextIfNotLast(childId, line, lineSize, &terminatedByEOF, !terminatedByEOF);
     }
 }
+
+/**
+ * @brief Indicates if two lines read from the children are equal, ignoring how they are terminated.
+ * @details The last line of a child is terminated by EOF (or \0) instead of a newline, so only the characters before
+ * the first \n or \0 are compared.
+ */
+static inline bool linesEqual(const line_t *line1, const line_t *line2)
+{
+    size_t length1 = strcspn(line1->data, "\n");
+    size_t length2 = strcspn(line2->data, "\n");
+    return length1 == length2 && memcmp(line1->data, line2->data, length1) == 0;
+}
+
+/**
+ * @brief Drops the given line and reads the next one from the specified child if there is one.
+ * @details Used with -u for a line equal to the current line of the other child.
+ * Terminates the program with EXIT_FAILURE upon failure of any called function by calling printErrnoAndTerminate.
+ *
+ * @param childId                  Indicates from which child the next line should be read; 1 for child1_g, 2 for child2_g
+ * @param line_in_out              The record of the line that is dropped, will be overwritten if a new line is read.
+ * @param lineSize_in_out          The size of the given line. Will be overwritten if a new line is read.
+ * @param isLastLineOfChild_in_out Indicates if the given line is the last line of the child. Will be overwritten if a new line is read.
+ *
+ * @return true if the last line of the child was dropped, false otherwise.
+ */
+static inline bool trySkipAndReadNextIfNotLast(int childId, line_t *line_in_out, int *lineSize_in_out,
+                                               bool *isLastLineOfChild_in_out)
+{
+    LOG("Drop duplicate line of child %d: %.*s.\n", childId, lengthWithoutNewline(line_in_out->data, *lineSize_in_out),
+        line_in_out->data);
+    if (*isLastLineOfChild_in_out)
+        return true;
+
+    *isLastLineOfChild_in_out = tryReadLineFrom(getChildAccessById(childId), line_in_out, lineSize_in_out);
+    return false;
+}
 //endregion
 /**
  * @brief Processes and outputs the output of both children line by line.
  * @details Reads the output of both children line by line, compares them, outputs the smaller one (alphabetically)
  * and reads the next line of the respective child (if any, otherwise all output of the child still providing lines it output)
- * for comparison until the output of both children was processed.
+ * for comparison until the output of both children was processed. With -u of two equal lines only the one of child2_g
+ * is output (the output of every child is unique already).
  * Terminates the program with EXIT_FAILURE upon failure of any called function by calling printErrnoAndTerminate.
 
- * @param lineChild1 A pointer to the current line read from child1_g. Needs to be malloc initialized, will be reused.
- * @param lineChild2 A pointer to the current line read from child2_g. Needs to be malloc initialized, will be reused.
+ * @param lineChild1 The record for the lines read from child1_g, will be reused.
+ * @param lineChild2 The record for the lines read from child2_g, will be reused.
  */
-static inline void tryReadAndOutputChildrenResultsOrdered(char **lineChild1, char **lineChild2)
+static inline void tryReadAndOutputChildrenResultsOrdered(line_t *lineChild1, line_t *lineChild2)
 {
     int c1lineSize;
     int c2lineSize;
@@ -514,14 +751,12 @@ static inline void tryReadAndOutputChildrenResultsOrdered(char **lineChild1, cha
 
     do
     {
-        char line1withoutNl[c1lineSize];
-        char line2withoutNl[c2lineSize];
-        tryCopyWithoutNewline(*lineChild1, line1withoutNl, c1lineSize);
-        tryCopyWithoutNewline(*lineChild2, line2withoutNl, c2lineSize);
-
-        LOG("\nCompare lines (c1: %s | c2: %s).\n", line1withoutNl, line2withoutNl);
+        LOG("\nCompare lines (c1: %.*s | c2: %.*s).\n", lengthWithoutNewline(lineChild1->data, c1lineSize), lineChild1->data,
+            lengthWithoutNewline(lineChild2->data, c2lineSize), lineChild2->data);
 
-        if (strcmp(*lineChild1, *lineChild2) < 0)
+        if (unique_g && linesEqual(lineChild1, lineChild2))
+            c1completed = trySkipAndReadNextIfNotLast(1, lineChild1, &c1lineSize, &c1readEOF);
+        else if (strcmp(lineChild1->data, lineChild2->data) < 0)
             c1completed = tryOutputAndReadNextIfNotLast(1, lineChild1, &c1lineSize, &c1readEOF, true);
         else
             c2completed = tryOutputAndReadNextIfNotLast(2, lineChild2, &c2lineSize, &c2readEOF, true);
@@ -599,7 +834,7 @@ static inline int redirectPipe(pipe_t *pipePtr, pipe_end_e pipeEnd, int targetFd
 //region CHILDREN
 /**
  * @brief Initializes and executes the child pointed to by childPtr.
- * @details Initializes input and output pipe of the child, forks and calls execlp for the child.
+ * @details Initializes input and output pipe of the child, forks and calls execlp for the child (with -u if it was given).
  * Also handles closing of unused pipe-ends in child & parent.
  * Terminates the program with EXIT_FAILURE upon failure of any called function by calling printErrnoAndTerminate.
  *
@@ -628,7 +863,7 @@ static inline void tryStartAndRunChild(child_process_t* childPtr)
             TRY(closePipeEnd(&child1_g.outputPipe, READ), ERROR_CLOSE_PIPE);
         }
 
-        TRY(execlp(programName_g, programName_g, NULL), ERROR_EXEC);
+        TRY(execlp(programName_g, programName_g, unique_g ? "-u" : NULL, NULL), ERROR_EXEC);
         // shouldn't be reached
     }
 
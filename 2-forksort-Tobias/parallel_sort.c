@@ -0,0 +1,607 @@
+/**
+ * @file   parallel_sort.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The in-process engine of forksort, see parallel_sort.h.
+ **/
+
+#include "parallel_sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <pthread.h>
+
+/** The initial size of the arena, it is doubled whenever it is full. */
+#define ARENA_INITIAL_SIZE (1 << 16)
+
+/** The number of samples per run and thread used to find the splitters of the merge. */
+#define SAMPLES_PER_THREAD 8
+
+/** The number of bytes of a line stored as prefix key by the radix engine and the number of buckets per byte. */
+#define PREFIX_BYTES  8
+#define RADIX_BUCKETS 256
+
+/** Buckets of the radix engine with less lines than this are sorted by insertion sort. */
+#define INSERTION_THRESHOLD 32
+
+//region TYPES
+/** A sorted run of lines: lines[start] to lines[end - 1]. */
+typedef struct {
+    size_t start;
+    size_t end;
+} run_t;
+
+/** The state shared by the threads of sortArena. */
+typedef struct {
+    char **lines;
+    char **merged;
+    run_t *runs;
+    size_t runCount;
+    size_t nextRun;        // the next run to sort, taken with an atomic increment
+    size_t **bounds;       // bounds[task][run]: first line of the run that belongs to the task
+    size_t *outputStart;   // outputStart[task]: position of the first merged line of the task
+    int tasks;
+} sort_job_t;
+
+/** A line and its prefix key: the first PREFIX_BYTES characters in big-endian order, padded with \0. */
+typedef struct {
+    uint64_t prefix;
+    char *line;
+} keyed_line_t;
+
+/** The state shared by the threads of sortArenaRadix. */
+typedef struct {
+    line_arena_t *arena;
+    keyed_line_t *keys;
+    keyed_line_t *scratch;
+    size_t bucketStart[RADIX_BUCKETS + 1]; // the buckets of the first character
+    size_t nextBucket;                     // the next bucket to sort, taken with an atomic increment
+    int threads;
+} radix_job_t;
+
+/** A thread of sortArena or sortArenaRadix. */
+typedef struct {
+    void *job;
+    int id;
+    pthread_t thread;
+} sort_worker_t;
+//endregion
+
+//region ARENA
+int readArena(int fd, line_arena_t *arena_out)
+{
+    size_t capacity = ARENA_INITIAL_SIZE;
+    size_t size = 0;
+    char *data = malloc(capacity);
+    if (data == NULL)
+        return -1;
+
+    while (1)
+    {
+        if (size == capacity)
+        {
+            char *grown = realloc(data, capacity * 2);
+            if (grown == NULL)
+            {
+                free(data);
+                return -1;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+
+        ssize_t bytesRead = read(fd, data + size, capacity - size);
+        if (bytesRead == -1 && errno == EINTR)
+            continue;
+        if (bytesRead == -1)
+        {
+            free(data);
+            return -1;
+        }
+        if (bytesRead == 0)
+            break;
+        size += bytesRead;
+    }
+
+    // Room for the \0 of the last line
+    if (size == capacity)
+    {
+        char *grown = realloc(data, capacity + 1);
+        if (grown == NULL)
+        {
+            free(data);
+            return -1;
+        }
+        data = grown;
+    }
+    data[size] = '\0';
+
+    arena_out->data = data;
+    arena_out->size = size;
+    if (splitArena(arena_out) == -1)
+    {
+        free(data);
+        return -1;
+    }
+    return 0;
+}
+
+int splitArena(line_arena_t *arena)
+{
+    char *data = arena->data;
+    size_t size = arena->size;
+
+    size_t count = 1;
+    for (char *c = memchr(data, '\n', size); c != NULL; c = memchr(c + 1, '\n', data + size - c - 1))
+        count++;
+
+    char **lines = malloc(count * sizeof(char *));
+    if (lines == NULL)
+        return -1;
+
+    size_t i = 0;
+    lines[i++] = data;
+    for (char *c = memchr(data, '\n', size); c != NULL; c = memchr(c + 1, '\n', data + size - c - 1))
+    {
+        *c = '\0';
+        lines[i++] = c + 1;
+    }
+
+    arena->lines = lines;
+    arena->count = count;
+    return 0;
+}
+
+void freeArena(line_arena_t *arena)
+{
+    free(arena->lines);
+    free(arena->data);
+    arena->lines = NULL;
+    arena->data = NULL;
+}
+
+void uniqueArena(line_arena_t *arena)
+{
+    size_t kept = 0;
+    for (size_t i = 0; i < arena->count; i++)
+    {
+        if (kept == 0 || strcmp(arena->lines[kept - 1], arena->lines[i]) != 0)
+            arena->lines[kept++] = arena->lines[i];
+    }
+    arena->count = kept;
+}
+
+int writeArena(const line_arena_t *arena, FILE *out)
+{
+    for (size_t i = 0; i < arena->count; i++)
+    {
+        if (fputs(arena->lines[i], out) == EOF)
+            return -1;
+        if (i + 1 < arena->count && fputc('\n', out) == EOF)
+            return -1;
+    }
+    return fflush(out) == EOF ? -1 : 0;
+}
+//endregion
+
+//region SORTING
+/** qsort comparator for an array of strings. */
+static int compareLines(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+/**
+ * @brief Finds the first line of a run that is not smaller than the splitter.
+ *
+ * @return The index of the line (run.end if all lines are smaller).
+ */
+static size_t lowerBound(char **lines, run_t run, const char *splitter)
+{
+    size_t low = run.start;
+    size_t high = run.end;
+    while (low < high)
+    {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(lines[middle], splitter) < 0)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    return low;
+}
+
+/**
+ * @brief Restores the heap property of a heap of run cursors starting at position i.
+ * @details The heap is ordered by the current line of every run, ties by the run index.
+ */
+static void siftDown(char **lines, size_t *heap, size_t *cursor, size_t heapSize, size_t i)
+{
+    while (1)
+    {
+        size_t smallest = i;
+        for (size_t child = 2 * i + 1; child <= 2 * i + 2 && child < heapSize; child++)
+        {
+            int order = strcmp(lines[cursor[heap[child]]], lines[cursor[heap[smallest]]]);
+            if (order < 0 || (order == 0 && heap[child] < heap[smallest]))
+                smallest = child;
+        }
+        if (smallest == i)
+            return;
+
+        size_t tmp = heap[i];
+        heap[i] = heap[smallest];
+        heap[smallest] = tmp;
+        i = smallest;
+    }
+}
+
+/**
+ * @brief Merges the parts of all runs that belong to a task into job->merged.
+ * @details A k-way merge with a binary heap over the runs that have lines in the part.
+ * heap, cursor and end are scratch arrays with one entry per run.
+ */
+static void mergeTask(sort_job_t *job, int task, size_t *heap, size_t *cursor, size_t *end)
+{
+    size_t heapSize = 0;
+    for (size_t r = 0; r < job->runCount; r++)
+    {
+        cursor[r] = job->bounds[task][r];
+        end[r] = job->bounds[task + 1][r];
+        if (cursor[r] < end[r])
+            heap[heapSize++] = r;
+    }
+    for (size_t i = heapSize; i-- > 0;)
+        siftDown(job->lines, heap, cursor, heapSize, i);
+
+    size_t out = job->outputStart[task];
+    while (heapSize > 0)
+    {
+        size_t r = heap[0];
+        job->merged[out++] = job->lines[cursor[r]++];
+        if (cursor[r] == end[r])
+            heap[0] = heap[--heapSize];
+        siftDown(job->lines, heap, cursor, heapSize, 0);
+    }
+}
+
+/** The threads of sortArena first sort runs until none is left, the merge is started separately. */
+static void *sortRuns(void *arg)
+{
+    sort_worker_t *worker = arg;
+    sort_job_t *job = worker->job;
+    for (size_t r = __atomic_fetch_add(&job->nextRun, 1, __ATOMIC_RELAXED); r < job->runCount;
+         r = __atomic_fetch_add(&job->nextRun, 1, __ATOMIC_RELAXED))
+    {
+        run_t run = job->runs[r];
+        qsort(job->lines + run.start, run.end - run.start, sizeof(char *), compareLines);
+    }
+    return NULL;
+}
+
+/** The threads of sortArena merge their task in the second phase. */
+static void *mergeRuns(void *arg)
+{
+    sort_worker_t *worker = arg;
+    sort_job_t *job = worker->job;
+    size_t *scratch = malloc(3 * job->runCount * sizeof(size_t));
+    if (scratch == NULL)
+        return (void *) -1;
+
+    mergeTask(job, worker->id, scratch, scratch + job->runCount, scratch + 2 * job->runCount);
+    free(scratch);
+    return NULL;
+}
+
+/**
+ * @brief Runs a function on all workers, worker 0 is the calling thread.
+ *
+ * @return 0 upon success, -1 if a thread couldn't be started or a worker failed.
+ */
+static int runWorkers(sort_worker_t *workers, int count, void *(*function)(void *))
+{
+    int started = 1;
+    int result = 0;
+    for (; started < count; started++)
+    {
+        if ((errno = pthread_create(&workers[started].thread, NULL, function, &workers[started])) != 0)
+        {
+            result = -1;
+            break;
+        }
+    }
+
+    if (function(&workers[0]) != NULL)
+        result = -1;
+    for (int i = 1; i < started; i++)
+    {
+        void *threadResult;
+        pthread_join(workers[i].thread, &threadResult);
+        if (threadResult != NULL)
+            result = -1;
+    }
+    return result;
+}
+
+/**
+ * @brief Picks the splitters of the merge and computes the part of every run that belongs to every task.
+ *
+ * @return 0 upon success, -1 upon failure.
+ */
+static int splitRuns(sort_job_t *job)
+{
+    size_t samplesPerRun = (size_t) job->tasks * SAMPLES_PER_THREAD;
+    size_t sampleCount = 0;
+    char **samples = malloc(job->runCount * samplesPerRun * sizeof(char *));
+    if (samples == NULL)
+        return -1;
+
+    for (size_t r = 0; r < job->runCount; r++)
+    {
+        run_t run = job->runs[r];
+        for (size_t s = 1; s <= samplesPerRun; s++)
+            samples[sampleCount++] = job->lines[run.start + s * (run.end - run.start) / (samplesPerRun + 1)];
+    }
+    qsort(samples, sampleCount, sizeof(char *), compareLines);
+
+    for (size_t r = 0; r < job->runCount; r++)
+    {
+        job->bounds[0][r] = job->runs[r].start;
+        job->bounds[job->tasks][r] = job->runs[r].end;
+    }
+    for (int t = 1; t < job->tasks; t++)
+    {
+        const char *splitter = samples[t * sampleCount / job->tasks];
+        for (size_t r = 0; r < job->runCount; r++)
+            job->bounds[t][r] = lowerBound(job->lines, job->runs[r], splitter);
+    }
+    free(samples);
+
+    // Every task writes its lines behind the ones of the tasks before it
+    size_t position = 0;
+    for (int t = 0; t < job->tasks; t++)
+    {
+        job->outputStart[t] = position;
+        for (size_t r = 0; r < job->runCount; r++)
+            position += job->bounds[t + 1][r] - job->bounds[t][r];
+    }
+    return 0;
+}
+
+int sortArena(line_arena_t *arena, int threads)
+{
+    sort_job_t job = {.lines = arena->lines};
+    job.runCount = (arena->count + RUN_LINES - 1) / RUN_LINES;
+    job.tasks = threads;
+    if (job.runCount <= 1)
+    {
+        qsort(arena->lines, arena->count, sizeof(char *), compareLines);
+        return 0;
+    }
+
+    int result = -1;
+    sort_worker_t workers[MAX_THREADS];
+    job.runs = malloc(job.runCount * sizeof(run_t));
+    job.merged = malloc(arena->count * sizeof(char *));
+    job.bounds = calloc(job.tasks + 1, sizeof(size_t *));
+    job.outputStart = malloc(job.tasks * sizeof(size_t));
+    if (job.runs == NULL || job.merged == NULL || job.bounds == NULL || job.outputStart == NULL)
+        goto cleanup;
+    for (int t = 0; t <= job.tasks; t++)
+    {
+        if ((job.bounds[t] = malloc(job.runCount * sizeof(size_t))) == NULL)
+            goto cleanup;
+    }
+
+    for (size_t r = 0; r < job.runCount; r++)
+    {
+        job.runs[r].start = r * RUN_LINES;
+        job.runs[r].end = r + 1 == job.runCount ? arena->count : (r + 1) * RUN_LINES;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].job = &job;
+        workers[t].id = t;
+    }
+
+    if (runWorkers(workers, threads, sortRuns) == -1 || splitRuns(&job) == -1 ||
+        runWorkers(workers, threads, mergeRuns) == -1)
+        goto cleanup;
+
+    free(arena->lines);
+    arena->lines = job.merged;
+    job.merged = NULL;
+    result = 0;
+
+cleanup:
+    if (job.bounds != NULL)
+    {
+        for (int t = 0; t <= job.tasks; t++)
+            free(job.bounds[t]);
+    }
+    free(job.bounds);
+    free(job.outputStart);
+    free(job.merged);
+    free(job.runs);
+    return result;
+}
+//endregion
+
+//region RADIX SORTING
+/** Loads the prefix key of a line. */
+static uint64_t loadPrefix(const char *line)
+{
+    uint64_t prefix = 0;
+    int ended = 0;
+    for (int i = 0; i < PREFIX_BYTES; i++)
+    {
+        unsigned char c = ended ? 0 : (unsigned char) line[i];
+        ended = c == '\0';
+        prefix = prefix << 8 | c;
+    }
+    return prefix;
+}
+
+/**
+ * @brief Compares two keyed lines in the order of strcmp.
+ * @details The prefixes decide unless they are equal. Equal prefixes ending in \0 belong to equal lines,
+ * otherwise both lines are longer than the prefix and the rest of them is compared with strcmp.
+ */
+static int compareKeyed(const keyed_line_t *a, const keyed_line_t *b)
+{
+    if (a->prefix != b->prefix)
+        return a->prefix < b->prefix ? -1 : 1;
+    if ((a->prefix & 0xff) == 0)
+        return 0;
+    return strcmp(a->line + PREFIX_BYTES, b->line + PREFIX_BYTES);
+}
+
+/** qsort comparator for an array of keyed lines. */
+static int compareKeyedLines(const void *a, const void *b)
+{
+    return compareKeyed(a, b);
+}
+
+/** Sorts a few keyed lines by insertion sort. */
+static void insertionSort(keyed_line_t *keys, size_t count)
+{
+    for (size_t i = 1; i < count; i++)
+    {
+        keyed_line_t key = keys[i];
+        size_t j = i;
+        for (; j > 0 && compareKeyed(&key, &keys[j - 1]) < 0; j--)
+            keys[j] = keys[j - 1];
+        keys[j] = key;
+    }
+}
+
+/**
+ * @brief Distributes keyed lines into the buckets of one byte of their prefix.
+ * @details A counting sort through scratch. bucketStart is set to the start of every bucket
+ * and bucketStart[RADIX_BUCKETS] to count.
+ */
+static void distribute(keyed_line_t *keys, keyed_line_t *scratch, size_t count, int byte, size_t *bucketStart)
+{
+    int shift = 8 * (PREFIX_BYTES - 1 - byte);
+    size_t position[RADIX_BUCKETS] = {0};
+    for (size_t i = 0; i < count; i++)
+        position[(keys[i].prefix >> shift) & 0xff]++;
+
+    size_t start = 0;
+    for (int b = 0; b < RADIX_BUCKETS; b++)
+    {
+        size_t size = position[b];
+        bucketStart[b] = position[b] = start;
+        start += size;
+    }
+    bucketStart[RADIX_BUCKETS] = count;
+
+    for (size_t i = 0; i < count; i++)
+        scratch[position[(keys[i].prefix >> shift) & 0xff]++] = keys[i];
+    memcpy(keys, scratch, count * sizeof(keyed_line_t));
+}
+
+/**
+ * @brief Sorts keyed lines whose prefixes are equal up to byte by MSD radix sort.
+ * @details Bucket 0 holds lines that ended before byte, they are equal and stay as they are.
+ * Lines with equal prefixes are sorted by the rest of them with strcmp, small buckets by insertion sort.
+ *
+ * @param keys    The keyed lines.
+ * @param scratch Room for count keyed lines.
+ * @param count   The number of keyed lines.
+ * @param byte    The byte of the prefix to distribute by.
+ */
+static void radixSort(keyed_line_t *keys, keyed_line_t *scratch, size_t count, int byte)
+{
+    if (count < INSERTION_THRESHOLD)
+    {
+        insertionSort(keys, count);
+        return;
+    }
+    if (byte == PREFIX_BYTES)
+    {
+        if ((keys[0].prefix & 0xff) != 0)
+            qsort(keys, count, sizeof(keyed_line_t), compareKeyedLines);
+        return;
+    }
+
+    size_t bucketStart[RADIX_BUCKETS + 1];
+    distribute(keys, scratch, count, byte, bucketStart);
+    for (int b = 1; b < RADIX_BUCKETS; b++)
+    {
+        size_t start = bucketStart[b];
+        radixSort(keys + start, scratch + start, bucketStart[b + 1] - start, byte + 1);
+    }
+}
+
+/** The threads of sortArenaRadix first load the keys of their share of the lines. */
+static void *loadKeys(void *arg)
+{
+    sort_worker_t *worker = arg;
+    radix_job_t *job = worker->job;
+    size_t count = job->arena->count;
+    size_t start = count * worker->id / job->threads;
+    size_t end = count * (worker->id + 1) / job->threads;
+    for (size_t i = start; i < end; i++)
+    {
+        job->keys[i].prefix = loadPrefix(job->arena->lines[i]);
+        job->keys[i].line = job->arena->lines[i];
+    }
+    return NULL;
+}
+
+/** Afterwards they sort the buckets of the first character until none is left. */
+static void *sortBuckets(void *arg)
+{
+    sort_worker_t *worker = arg;
+    radix_job_t *job = worker->job;
+    for (size_t b = __atomic_fetch_add(&job->nextBucket, 1, __ATOMIC_RELAXED); b < RADIX_BUCKETS;
+         b = __atomic_fetch_add(&job->nextBucket, 1, __ATOMIC_RELAXED))
+    {
+        size_t start = job->bucketStart[b];
+        radixSort(job->keys + start, job->scratch + start, job->bucketStart[b + 1] - start, 1);
+    }
+    return NULL;
+}
+
+int sortArenaRadix(line_arena_t *arena, int threads)
+{
+    radix_job_t job = {.arena = arena, .threads = threads};
+    sort_worker_t workers[MAX_THREADS];
+    job.keys = malloc(arena->count * sizeof(keyed_line_t));
+    job.scratch = malloc(arena->count * sizeof(keyed_line_t));
+    if (job.keys == NULL || job.scratch == NULL)
+    {
+        free(job.keys);
+        free(job.scratch);
+        return -1;
+    }
+    for (int t = 0; t < threads; t++)
+    {
+        workers[t].job = &job;
+        workers[t].id = t;
+    }
+
+    int result = runWorkers(workers, threads, loadKeys);
+    if (result == 0)
+    {
+        // Bucket 0 holds the empty lines, which are already sorted
+        distribute(job.keys, job.scratch, arena->count, 0, job.bucketStart);
+        job.nextBucket = 1;
+        result = runWorkers(workers, threads, sortBuckets);
+    }
+    if (result == 0)
+    {
+        for (size_t i = 0; i < arena->count; i++)
+            arena->lines[i] = job.keys[i].line;
+    }
+
+    free(job.keys);
+    free(job.scratch);
+    return result;
+}
+//endregion
@@ -0,0 +1,119 @@
+/**
+ * @file   parallel_sort.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The in-process engine of forksort.
+ *
+ * @details Instead of forking two children per level the whole input is read into one arena and split into lines.
+ * Fixed-size runs of lines are sorted on a pool of threads, afterwards the runs are merged by a parallel k-way merge:
+ * splitter lines cut every run into one part per thread and every thread merges its parts of all runs.
+ * The order is the same as the one of the forking engine (strcmp).
+ *
+ * The radix engine (sortArenaRadix) stores an 8 byte big-endian prefix of every line next to its pointer and sorts
+ * them by MSD radix sort, the buckets of the first character on a pool of threads. strcmp is only used for lines
+ * with equal prefixes.
+ **/
+
+#ifndef PARALLEL_SORT_H
+#define PARALLEL_SORT_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/** The number of lines of a run that is sorted by one thread. */
+#define RUN_LINES (1 << 14)
+
+/** The maximum number of threads. */
+#define MAX_THREADS 64
+
+/**
+ * The most memory an engine needs per line besides its characters:
+ * the lines array and the merged array (sortArena) or two arrays of prefix keys and pointers (sortArenaRadix).
+ */
+#define ARENA_LINE_OVERHEAD (sizeof(char *) + 2 * (sizeof(uint64_t) + sizeof(char *)))
+
+/**
+ * Holds the whole input and the lines in it.
+ * The newlines in data are replaced by \0, so every entry of lines is a string within data.
+ */
+typedef struct {
+    char *data;
+    size_t size;
+    char **lines;
+    size_t count;
+} line_arena_t;
+
+/**
+ * @brief Reads everything from fd into an arena and splits it into lines.
+ * @details The input is split at every newline, the part after the last newline (empty if the input ends with one)
+ * is a line as well, just like the forking engine reads it.
+ *
+ * @param fd        The file descriptor to read from.
+ * @param arena_out The arena to initialize.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int readArena(int fd, line_arena_t *arena_out);
+
+/**
+ * @brief Splits the data of an arena into lines.
+ * @details Every newline in data is replaced by \0 and the lines array is allocated, data[size] must be \0.
+ * The lines are split as by readArena.
+ *
+ * @param arena The arena whose data and size are set.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int splitArena(line_arena_t *arena);
+
+/**
+ * @brief Frees the data and lines of an arena.
+ *
+ * @param arena The arena to free.
+ */
+void freeArena(line_arena_t *arena);
+
+/**
+ * @brief Sorts the lines of an arena with strcmp.
+ *
+ * @param arena   The arena whose lines should be sorted.
+ * @param threads The number of threads to use (1 to MAX_THREADS).
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int sortArena(line_arena_t *arena, int threads);
+
+/**
+ * @brief Sorts the lines of an arena in the order of strcmp by MSD radix sort on prefix keys.
+ *
+ * @param arena   The arena whose lines should be sorted.
+ * @param threads The number of threads to use (1 to MAX_THREADS).
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int sortArenaRadix(line_arena_t *arena, int threads);
+
+/** The signature of sortArena and sortArenaRadix. */
+typedef int (*arena_sorter_t)(line_arena_t *arena, int threads);
+
+/**
+ * @brief Removes equal lines of a sorted arena, only the first one of every group is kept.
+ * @details The lines array is compacted in place, data is untouched.
+ *
+ * @param arena The sorted arena.
+ */
+void uniqueArena(line_arena_t *arena);
+
+/**
+ * @brief Outputs the lines of an arena separated by newlines (no newline after the last one).
+ *
+ * @param arena The arena to output.
+ * @param out   The FILE* to write to.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int writeArena(const line_arena_t *arena, FILE *out);
+
+#endif
@@ -0,0 +1,323 @@
+/**
+ * @file   top_k.c
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The top-k engine of forksort, see top_k.h.
+ **/
+
+#include "top_k.h"
+#include "parallel_sort.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+
+/** The number of bytes requested from the input by one call to read. */
+#define READ_BLOCK_SIZE (1 << 16)
+
+/** The initial number of lines the heap has room for (if k is larger), it is doubled whenever it is full. */
+#define HEAP_INITIAL_CAPACITY 64
+
+//region TYPES
+/**
+ * The k smallest lines read so far.
+ * lines is a max-heap (lines[0] is the largest line), every line is a copy owned by the heap.
+ * With unique slots is a hash set of the same pointers with linear probing, its size is a power of two and at least
+ * twice the number of lines, so there always is an empty slot.
+ */
+typedef struct {
+    char **lines;
+    size_t count;
+    size_t capacity;
+    size_t k;
+    int unique;
+    char **slots;
+    size_t slotCount;
+} top_k_t;
+
+/** The part of a line read so far that continues beyond the end of a block, terminated by \0 when it is complete. */
+typedef struct {
+    char *data;
+    size_t size;
+    size_t capacity;
+} pending_line_t;
+//endregion
+
+//region HASH SET
+/** FNV-1a over the characters of a line. */
+static size_t hashLine(const char *line)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (const unsigned char *c = (const unsigned char *) line; *c != '\0'; c++)
+        hash = (hash ^ *c) * 1099511628211ULL;
+    return (size_t) hash;
+}
+
+/** Indicates if a line equal to the given one is in the set. */
+static int setContains(const top_k_t *top, const char *line)
+{
+    if (top->slots == NULL)
+        return 0;
+
+    size_t mask = top->slotCount - 1;
+    for (size_t i = hashLine(line) & mask; top->slots[i] != NULL; i = (i + 1) & mask)
+    {
+        if (strcmp(top->slots[i], line) == 0)
+            return 1;
+    }
+    return 0;
+}
+
+/** Inserts a line of the heap, the set must have room for it. */
+static void setInsert(top_k_t *top, char *line)
+{
+    size_t mask = top->slotCount - 1;
+    size_t i = hashLine(line) & mask;
+    while (top->slots[i] != NULL)
+        i = (i + 1) & mask;
+    top->slots[i] = line;
+}
+
+/**
+ * @brief Removes a line of the heap (the pointer itself, which must be in the set).
+ * @details The following lines of the probe sequence are shifted back into the gap if their slot comes before it,
+ * so no lookup ever stops at the gap too early.
+ */
+static void setRemove(top_k_t *top, const char *line)
+{
+    size_t mask = top->slotCount - 1;
+    size_t gap = hashLine(line) & mask;
+    while (top->slots[gap] != line)
+        gap = (gap + 1) & mask;
+    top->slots[gap] = NULL;
+
+    for (size_t i = (gap + 1) & mask; top->slots[i] != NULL; i = (i + 1) & mask)
+    {
+        size_t home = hashLine(top->slots[i]) & mask;
+        if (((i - home) & mask) >= ((i - gap) & mask))
+        {
+            top->slots[gap] = top->slots[i];
+            top->slots[i] = NULL;
+            gap = i;
+        }
+    }
+}
+
+/** Doubles the number of slots if the set would be more than half full with one more line. */
+static int setReserve(top_k_t *top)
+{
+    if (2 * (top->count + 1) <= top->slotCount)
+        return 0;
+
+    size_t slotCount = top->slotCount == 0 ? 2 * HEAP_INITIAL_CAPACITY : 2 * top->slotCount;
+    char **slots = calloc(slotCount, sizeof(char *));
+    if (slots == NULL)
+        return -1;
+
+    free(top->slots);
+    top->slots = slots;
+    top->slotCount = slotCount;
+    for (size_t i = 0; i < top->count; i++)
+        setInsert(top, top->lines[i]);
+    return 0;
+}
+//endregion
+
+//region HEAP
+/** Swaps two lines of the heap. */
+static void swapLines(char **lines, size_t a, size_t b)
+{
+    char *line = lines[a];
+    lines[a] = lines[b];
+    lines[b] = line;
+}
+
+/** Moves the line at i up until its parent is larger. */
+static void siftUp(char **lines, size_t i)
+{
+    while (i > 0 && strcmp(lines[(i - 1) / 2], lines[i]) < 0)
+    {
+        swapLines(lines, (i - 1) / 2, i);
+        i = (i - 1) / 2;
+    }
+}
+
+/** Moves the line at i down until both its children are smaller. */
+static void siftDown(char **lines, size_t count, size_t i)
+{
+    while (1)
+    {
+        size_t largest = i;
+        size_t left = 2 * i + 1;
+        size_t right = left + 1;
+        if (left < count && strcmp(lines[left], lines[largest]) > 0)
+            largest = left;
+        if (right < count && strcmp(lines[right], lines[largest]) > 0)
+            largest = right;
+        if (largest == i)
+            return;
+
+        swapLines(lines, i, largest);
+        i = largest;
+    }
+}
+
+/**
+ * @brief Offers a line to the heap.
+ * @details A line that comes after the largest line of a full heap (or equals a line of the heap with unique) is
+ * dropped without being copied. Otherwise a copy is added, replacing the largest line if the heap is full.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+static int offerLine(top_k_t *top, const char *line, size_t length)
+{
+    if (top->count == top->k && strcmp(line, top->lines[0]) >= 0)
+        return 0;
+    if (top->unique && setContains(top, line))
+        return 0;
+
+    if (top->count < top->k && top->count == top->capacity)
+    {
+        size_t capacity = top->capacity == 0 ? HEAP_INITIAL_CAPACITY : 2 * top->capacity;
+        capacity = capacity < top->k ? capacity : top->k;
+        char **lines = realloc(top->lines, capacity * sizeof(char *));
+        if (lines == NULL)
+            return -1;
+        top->lines = lines;
+        top->capacity = capacity;
+    }
+    if (top->unique && top->count < top->k && setReserve(top) == -1)
+        return -1;
+
+    char *copy = malloc(length + 1);
+    if (copy == NULL)
+        return -1;
+    memcpy(copy, line, length + 1);
+
+    if (top->count == top->k)
+    {
+        if (top->unique)
+            setRemove(top, top->lines[0]);
+        free(top->lines[0]);
+        top->lines[0] = copy;
+        siftDown(top->lines, top->count, 0);
+    }
+    else
+    {
+        top->lines[top->count++] = copy;
+        siftUp(top->lines, top->count - 1);
+    }
+
+    if (top->unique)
+        setInsert(top, copy);
+    return 0;
+}
+//endregion
+
+//region INPUT
+/** Appends characters to the pending line. */
+static int appendPending(pending_line_t *pending, const char *data, size_t size)
+{
+    if (pending->size + size + 1 > pending->capacity)
+    {
+        size_t capacity = pending->capacity == 0 ? READ_BLOCK_SIZE : pending->capacity;
+        while (capacity < pending->size + size + 1)
+            capacity *= 2;
+        char *grown = realloc(pending->data, capacity);
+        if (grown == NULL)
+            return -1;
+        pending->data = grown;
+        pending->capacity = capacity;
+    }
+    memcpy(pending->data + pending->size, data, size);
+    pending->size += size;
+    pending->data[pending->size] = '\0';
+    return 0;
+}
+
+/**
+ * @brief Reads fd block by block and offers every line to the heap.
+ * @details A line within a block is offered in place (its newline is replaced by \0), only a line that continues
+ * beyond the end of a block is collected in the pending line.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+static int offerLines(top_k_t *top, int fd)
+{
+    char block[READ_BLOCK_SIZE];
+    pending_line_t pending = {0};
+    int result = -1;
+
+    while (1)
+    {
+        ssize_t size = read(fd, block, sizeof(block));
+        if (size == -1 && errno == EINTR)
+            continue;
+        if (size == -1)
+            goto cleanup;
+        if (size == 0)
+            break;
+
+        size_t start = 0;
+        char *newline;
+        while ((newline = memchr(block + start, '\n', size - start)) != NULL)
+        {
+            size_t end = newline - block;
+            *newline = '\0';
+            if (pending.size > 0)
+            {
+                if (appendPending(&pending, block + start, end - start) == -1 ||
+                    offerLine(top, pending.data, pending.size) == -1)
+                    goto cleanup;
+                pending.size = 0;
+            }
+            else if (offerLine(top, block + start, end - start) == -1)
+            {
+                goto cleanup;
+            }
+            start = end + 1;
+        }
+        if (appendPending(&pending, block + start, size - start) == -1)
+            goto cleanup;
+    }
+
+    // The part after the last newline is a line as well, even if it is empty
+    if (appendPending(&pending, "", 0) == -1 || offerLine(top, pending.data, pending.size) == -1)
+        goto cleanup;
+    result = 0;
+
+cleanup:
+    free(pending.data);
+    return result;
+}
+//endregion
+
+/** qsort comparator for an array of strings. */
+static int compareLines(const void *a, const void *b)
+{
+    return strcmp(*(char *const *) a, *(char *const *) b);
+}
+
+int topKSort(int fd, FILE *out, size_t k, int unique)
+{
+    top_k_t top = {.k = k, .unique = unique};
+    int result = offerLines(&top, fd);
+
+    if (result == 0)
+    {
+        qsort(top.lines, top.count, sizeof(char *), compareLines);
+        line_arena_t arena = {.lines = top.lines, .count = top.count};
+        result = writeArena(&arena, out);
+    }
+
+    int savedErrno = errno;
+    for (size_t i = 0; i < top.count; i++)
+        free(top.lines[i]);
+    free(top.lines);
+    free(top.slots);
+    errno = savedErrno;
+    return result;
+}
@@ -0,0 +1,34 @@
+/**
+ * @file   top_k.h
+ * @author Tobias de Vries (e01525369)
+ * @date   20.12.2020
+ *
+ * @brief The top-k engine of forksort, which only outputs the first k lines of the sorted input.
+ *
+ * @details The lines are streamed through a max-heap of at most k lines: a line that comes before the largest line of
+ * the heap replaces it, any other line is dropped right away. So the input is never held in memory and sorting costs
+ * O(N log k) comparisons. With unique a hash set of the lines in the heap drops lines that are in it already, the
+ * output is the first k distinct lines then.
+ **/
+
+#ifndef TOP_K_H
+#define TOP_K_H
+
+#include <stdio.h>
+#include <stddef.h>
+
+/**
+ * @brief Outputs the first k lines read from fd in the order of strcmp.
+ * @details The input is split into lines as by readArena, the output is the same as the one of writeArena
+ * (separated by newlines, no newline after the last one).
+ *
+ * @param fd     The file descriptor to read from.
+ * @param out    The FILE* to write the lines to.
+ * @param k      The number of lines to output (at least 1).
+ * @param unique Indicates if equal lines should only be output once.
+ *
+ * @return 0 upon success, -1 upon failure (errno is set).
+ */
+int topKSort(int fd, FILE *out, size_t k, int unique);
+
+#endif
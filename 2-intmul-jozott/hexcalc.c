@@ -6,6 +6,9 @@
  * @date 15.12.2020
  * @section File Overview
  * hexcalc is responsible for calculate the result of the combination of each child process.
+ * The hex strings are converted to arrays of 64 bit limbs (least significant first) for the calculation,
+ * the carries are computed with __int128 in a single pass. Results are converted back to hex strings.
+ * The conversions and the validation of the input work on 8 characters per 64 bit word, so a limb takes two steps.
  */
 
 #include <stdlib.h>
@@ -13,6 +16,8 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <ctype.h>
+#include <stdint.h>
 
 #include "hexcalc.h"
 
@@ -25,94 +30,378 @@
         exit(EXIT_FAILURE);                                                                              \
     }
 
+#define HEX_DIGITS "0123456789abcdef"
+
+/**
+ * @brief The number of hex digits of one limb.
+ */
+#define LIMB_DIGITS 16
+
+typedef uint64_t limb_t;
+__extension__ typedef unsigned __int128 dlimb_t;
+
+/**
+ * @brief A word with the byte b in each of its 8 bytes.
+ */
+#define BYTES(b) ((uint64_t)(b) * 0x0101010101010101ULL)
+
 /**
- * @brief Adds a, b, and the overflow of the early addition.
- * The overlow is stored in the overflow pointer
- * 
- * @return The character which represents the result for this digit.
+ * @brief A word with the 16 bit value h in each of its 4 halfwords.
  */
-static char addHexChar(char a, char b, char *overflow)
+#define HALVES(h) ((uint64_t)(h) * 0x0001000100010001ULL)
+
+/**
+ * @brief Returns the value of a hex character (0 if it isn't one).
+ */
+static int hexValue(char c)
 {
-    char sa[] = {a, '\0'};
-    char sb[] = {b, '\0'};
+    const char *digit = strchr(HEX_DIGITS, tolower((unsigned char)c));
+    return digit == NULL || c == '\0' ? 0 : digit - HEX_DIGITS;
+}
 
-    long ia = strtol(sa, NULL, 16);
-    long ib = strtol(sb, NULL, 16);
-    long io = strtol(overflow, NULL, 16);
-    long sum = ia + ib + io;
+/**
+ * @brief Loads 8 characters into a word, the first one is its least significant byte.
+ */
+static uint64_t loadChars(char *s)
+{
+    uint64_t w = 0;
+    for (int i = 7; i >= 0; i--)
+        w = (w << 8) | (unsigned char)s[i];
 
-    //new overflow
-    int no = (int)sum / 16;
-    sprintf(overflow, "%x", no);
+    return w;
+}
 
-    int result = sum % 16;
-    char sres[] = {' ', '\0'};
-    sprintf(sres, "%x", result);
+/**
+ * @brief Stores a word as 8 characters, its least significant byte is the first one.
+ */
+static void storeChars(char *s, uint64_t w)
+{
+    for (int i = 0; i < 8; i++)
+        s[i] = (char)(w >> (8 * i));
+}
 
-    return sres[0];
+/**
+ * @brief Returns a word with the top bit set in every byte of w (8 characters) that is a hex digit of either case.
+ * Adding 0x80 - lo sets the top bit of every byte >= lo, the top bits are cleared before so no byte carries into the next.
+ */
+static uint64_t hexMask(uint64_t w)
+{
+    uint64_t low = w & BYTES(0x7f);
+    uint64_t lower = low | BYTES(0x20);
+    uint64_t digit = (low + BYTES(0x80 - '0')) & ~(low + BYTES(0x80 - '9' - 1));
+    uint64_t letter = (lower + BYTES(0x80 - 'a')) & ~(lower + BYTES(0x80 - 'f' - 1));
+    return (digit | letter) & ~w & BYTES(0x80);
 }
 
 /**
- * @brief Adds two strings (hex base) bye iterating from back to front
- * and using the addHexChar() function.
- * 
- * The result is stored in the first operand.
+ * @brief Returns the value of 8 hex digits (loaded by loadChars). Every byte is mapped to its value (letters have bit 6 set
+ * and their low nibble plus 9 as value), then the nibbles are merged to bytes, the bytes to halfwords and those to the result.
  */
-static void addHexString(char *result, char *b)
+static uint32_t parse8Digits(uint64_t w)
+{
+    w = (w & BYTES(0x0f)) + ((w >> 6) & BYTES(0x01)) * 9;
+    w = ((w << 4) | (w >> 8)) & HALVES(0x00ff);
+    w = ((w << 8) | (w >> 16)) & 0x0000ffff0000ffffULL;
+    return (uint32_t)((w << 16) | (w >> 32));
+}
+
+/**
+ * @brief Returns the 8 hex digits of v (for storeChars), the inverse of parse8Digits(): the digits are spread to one byte each,
+ * then '0' is added to every byte and 'a' - '0' - 10 to those >= 10.
+ */
+static uint64_t format8Digits(uint32_t v)
+{
+    uint64_t w = (v >> 16) | ((uint64_t)(v & 0xffff) << 32);
+    w = ((w >> 8) & 0x000000ff000000ffULL) | ((w & 0x000000ff000000ffULL) << 16);
+    w = ((w >> 4) & HALVES(0x000f)) | ((w & HALVES(0x000f)) << 8);
+    return w + BYTES('0') + (((w + BYTES(6)) >> 4) & BYTES(0x01)) * ('a' - '0' - 10);
+}
+
+size_t hexInvalid(char *hex, size_t len)
 {
-    size_t count = strlen(result);
-    int diff = count - strlen(b);
+    size_t i = 0;
+    while (i + 8 <= len && hexMask(loadChars(hex + i)) == BYTES(0x80))
+        i += 8;
 
-    char overflow[] = {'0', '\0'};
+    while (i < len && isxdigit((unsigned char)hex[i]))
+        i++;
 
-    for (int i = count - 1; i >= 0; i--)
+    return i;
+}
+
+/**
+ * @brief Returns the number of limbs needed for the given number of hex digits.
+ */
+static size_t limbsForDigits(size_t digits)
+{
+    return (digits + LIMB_DIGITS - 1) / LIMB_DIGITS;
+}
+
+/**
+ * @brief Converts the hex string (digits characters) to the given array of count limbs.
+ * Whole limbs are taken 16 digits at a time from the end, the remaining high digits one by one.
+ */
+static void hexToLimbs(char *hex, size_t digits, limb_t *limbs, size_t count)
+{
+    memset(limbs, 0, count * sizeof(limb_t));
+
+    size_t whole = digits / LIMB_DIGITS;
+    for (size_t i = 0; i < whole; i++)
     {
-        char cb = i - diff >= 0 ? b[i - diff] : '0';
-        char r = addHexChar(result[i], cb, overflow);
-        result[i] = r;
+        char *limb = hex + digits - (i + 1) * LIMB_DIGITS;
+        limbs[i] = ((limb_t)parse8Digits(loadChars(limb)) << 32) | parse8Digits(loadChars(limb + 8));
     }
+    for (size_t i = 0; i < digits % LIMB_DIGITS; i++)
+        limbs[whole] = (limbs[whole] << 4) | hexValue(hex[i]);
+}
+
+/**
+ * @brief Converts count limbs to a hex string with exactly digits characters. Uses malloc for the string.
+ */
+static char *limbsToHex(limb_t *limbs, size_t count, size_t digits)
+{
+    char *hex = malloc(digits + 1);
+    if (hex == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
 
-    if (overflow[0] != '0')
+    size_t whole = digits / LIMB_DIGITS;
+    for (size_t i = 0; i < whole; i++)
     {
-        if ((result = realloc(result, count + 1)) == NULL)
-            EXIT_ERR("Could not reallocate memory", 1);
+        limb_t limb = i < count ? limbs[i] : 0;
+        char *digit = hex + digits - (i + 1) * LIMB_DIGITS;
+        storeChars(digit, format8Digits((uint32_t)(limb >> 32)));
+        storeChars(digit + 8, format8Digits((uint32_t)limb));
+    }
 
-        // memcpy(result + 1, result, count);
-        strcpy(result + 1, result);
-        result[0] = overflow[0];
-        result[count + 1] = '\0';
+    limb_t high = whole < count ? limbs[whole] : 0;
+    for (size_t i = digits % LIMB_DIGITS; i > 0; i--)
+    {
+        hex[i - 1] = HEX_DIGITS[high & 0xf];
+        high >>= 4;
     }
+    hex[digits] = '\0';
+
+    return hex;
 }
 
 /**
- * @brief adds zeros to the tail of a string. The number is given by the count.
+ * @brief Returns limb i of a multiplied with 2^bit (bit < 64), a has count limbs.
  */
-static void addZerosToHex(char **a, size_t count)
+static limb_t shiftedLimb(limb_t *a, size_t count, size_t i, unsigned int bit)
 {
-    size_t len = strlen(*a);
-    size_t total = len + count;
-    char *result = malloc(total + 1 * sizeof(char));
-    memset(result, '0', total);
-    memcpy(result, *a, len);
-    result[total] = '\0';
+    limb_t low = i < count ? a[i] : 0;
+    if (bit == 0)
+        return low;
 
-    *a = result;
+    limb_t high = i > 0 ? a[i - 1] >> (64 - bit) : 0;
+    return (low << bit) | high;
 }
 
-int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len)
+/**
+ * @brief Adds (sign 1) or subtracts (sign -1) a multiplied with 2^bits to/from the result in a single pass.
+ * The result has count limbs, a has acount limbs. The final carry/borrow is dropped.
+ */
+static void addShifted(limb_t *result, size_t count, limb_t *a, size_t acount, size_t bits, int sign)
 {
+    size_t offset = bits / 64;
+    unsigned int bit = bits % 64;
 
-    addZerosToHex(hh, len);
-    addZerosToHex(&hl, len / 2);
-    addZerosToHex(&lh, len / 2);
+    limb_t carry = 0;
+    for (size_t i = 0; offset + i < count && (i <= acount || carry != 0); i++)
+    {
+        limb_t limb = shiftedLimb(a, acount, i, bit);
+        dlimb_t t = sign > 0 ? (dlimb_t)result[offset + i] + limb + carry
+                             : (dlimb_t)result[offset + i] - limb - carry;
+        result[offset + i] = (limb_t)t;
+        carry = sign > 0 ? (limb_t)(t >> 64) : (limb_t)(t >> 64) & 1;
+    }
+}
 
-    addHexString(*hh, hl);
-    addHexString(*hh, lh);
-    addHexString(*hh, ll);
+/**
+ * @brief Adds (sign 1) or subtracts (sign -1) the first digits characters of hex multiplied with 16^shift to/from the result.
+ */
+static void addDigitsShifted(limb_t *result, size_t count, char *hex, size_t digits, size_t shift, int sign)
+{
+    size_t hcount = limbsForDigits(digits);
+    limb_t *limbs = malloc((hcount + 1) * sizeof(limb_t));
+    if (limbs == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    hexToLimbs(hex, digits, limbs, hcount);
+    addShifted(result, count, limbs, hcount, 4 * shift, sign);
+    free(limbs);
+}
+
+/**
+ * @brief Adds (sign 1) or subtracts (sign -1) the hex string multiplied with 16^shift to/from the result.
+ * The hex string ends with '\0' or '\n'.
+ */
+static void addHexShifted(limb_t *result, size_t count, char *hex, size_t shift, int sign)
+{
+    addDigitsShifted(result, count, hex, strcspn(hex, "\n"), shift, sign);
+}
+
+/**
+ * @brief Allocates count limbs set to 0.
+ */
+static limb_t *zeroLimbs(size_t count)
+{
+    limb_t *limbs = calloc(count, sizeof(limb_t));
+    if (limbs == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    return limbs;
+}
+
+char *calcQuadProduct(char *hh, char *hl, char *lh, char *ll, size_t len)
+{
+    size_t count = limbsForDigits(2 * len);
+    limb_t *result = zeroLimbs(count);
+
+    addHexShifted(result, count, ll, 0, 1);
+    addHexShifted(result, count, hl, len / 2, 1);
+    addHexShifted(result, count, lh, len / 2, 1);
+    addHexShifted(result, count, hh, len, 1);
+
+    char *hex = limbsToHex(result, count, 2 * len);
+    free(result);
+
+    return hex;
+}
+
+int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len)
+{
+    char *result = calcQuadProduct(*hh, hl, lh, ll, len);
+
+    free(*hh);
+    *hh = result;
 
     free(hl);
     free(lh);
 
-    size_t hhlen = strlen(*hh);
-    return hhlen;
+    return 2 * len;
+}
+
+int addHalves(char *h, char *l, size_t len, char **sum)
+{
+    size_t count = limbsForDigits(len) + 1;
+    limb_t *limbs = zeroLimbs(count);
+
+    addDigitsShifted(limbs, count, h, len, 0, 1);
+    addDigitsShifted(limbs, count, l, len, 0, 1);
+    *sum = limbsToHex(limbs, count, len);
+
+    size_t carryBit = 4 * len;
+    int carry = (limbs[carryBit / 64] >> (carryBit % 64)) & 1;
+    free(limbs);
+
+    return carry;
+}
+
+char *calcKaratsubaResult(char *hh, char *ll, char *mid, char *sa, int ca, char *sb, int cb, size_t len)
+{
+    size_t half = len / 2;
+
+    // one limb more, as all additions are done before the subtractions
+    size_t count = limbsForDigits(2 * len) + 1;
+    limb_t *result = zeroLimbs(count);
+
+    // (Ah + Al) * (Bh + Bl) = sa * sb + (ca * sb + cb * sa) * 16^half + ca * cb * 16^len
+    addHexShifted(result, count, ll, 0, 1);
+    addHexShifted(result, count, hh, len, 1);
+    addHexShifted(result, count, mid, half, 1);
+    if (ca)
+        addHexShifted(result, count, sb, len, 1);
+    if (cb)
+        addHexShifted(result, count, sa, len, 1);
+    if (ca && cb)
+        addHexShifted(result, count, "1", len + half, 1);
+    addHexShifted(result, count, hh, half, -1);
+    addHexShifted(result, count, ll, half, -1);
+
+    char *hex = limbsToHex(result, count, 2 * len);
+    free(result);
+
+    return hex;
+}
+
+/**
+ * @brief Schoolbook multiplication of a and b (count limbs each), every row is added with its carry in one pass.
+ * The product has 2 * count limbs.
+ */
+static void mulSchoolbook(limb_t *a, limb_t *b, size_t count, limb_t *product)
+{
+    memset(product, 0, 2 * count * sizeof(limb_t));
+    for (size_t i = 0; i < count; i++)
+    {
+        limb_t carry = 0;
+        for (size_t j = 0; j < count; j++)
+        {
+            dlimb_t t = (dlimb_t)a[i] * b[j] + product[i + j] + carry;
+            product[i + j] = (limb_t)t;
+            carry = (limb_t)(t >> 64);
+        }
+        product[i + count] = carry;
+    }
+}
+
+/**
+ * @brief Sequential karatsuba multiplication of a and b (count limbs each), up to LOCAL_DIGITS digits mulSchoolbook() is used.
+ * The product has 2 * count limbs.
+ */
+static void mulKaratsuba(limb_t *a, limb_t *b, size_t count, limb_t *product)
+{
+    if (count <= limbsForDigits(LOCAL_DIGITS))
+    {
+        mulSchoolbook(a, b, count, product);
+        return;
+    }
+
+    // a = ah * 2^(64 * low) + al, the sums of the halves have one limb more
+    size_t low = count / 2;
+    size_t high = count - low;
+    size_t scount = high + 1;
+
+    limb_t *sa = zeroLimbs(scount);
+    limb_t *sb = zeroLimbs(scount);
+    limb_t *mid = malloc(2 * scount * sizeof(limb_t));
+    if (mid == NULL)
+        EXIT_ERR("Could not allocate memory", 1);
+
+    memcpy(sa, a + low, high * sizeof(limb_t));
+    memcpy(sb, b + low, high * sizeof(limb_t));
+    addShifted(sa, scount, a, low, 0, 1);
+    addShifted(sb, scount, b, low, 0, 1);
+
+    // al * bl and ah * bh are stored directly in the product
+    mulKaratsuba(a, b, low, product);
+    mulKaratsuba(a + low, b + low, high, product + 2 * low);
+    mulKaratsuba(sa, sb, scount, mid);
+
+    addShifted(mid, 2 * scount, product, 2 * low, 0, -1);
+    addShifted(mid, 2 * scount, product + 2 * low, 2 * high, 0, -1);
+    addShifted(product, 2 * count, mid, 2 * scount, 64 * low, 1);
+
+    free(sa);
+    free(sb);
+    free(mid);
+}
+
+char *multiplyLocal(char *a, char *b, size_t len)
+{
+    size_t count = limbsForDigits(len);
+    limb_t *la = zeroLimbs(count);
+    limb_t *lb = zeroLimbs(count);
+    limb_t *product = zeroLimbs(2 * count);
+
+    hexToLimbs(a, len, la, count);
+    hexToLimbs(b, len, lb, count);
+    mulKaratsuba(la, lb, count, product);
+
+    char *hex = limbsToHex(product, 2 * count, 2 * len);
+    free(la);
+    free(lb);
+    free(product);
+
+    return hex;
 }
\ No newline at end of file
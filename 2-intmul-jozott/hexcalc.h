@@ -10,7 +10,54 @@
 
 #include <stdlib.h>
 
+/**
+ * @brief The default cutoff: numbers of up to this many hex digits are multiplied by the process itself (32 limbs).
+ * Up to this size the local multiplication uses the schoolbook method.
+ */
+#define LOCAL_DIGITS 512
+
+/**
+ * @brief Validates the first len characters of hex (digits of either case), 8 characters at a time.
+ * 
+ * @return The index of the first character that is no hex digit, len if there is none.
+ */
+size_t hexInvalid(char *hex, size_t len);
+
 /**
  * @brief The function manages the procedure of the result calculation of all child processes.
+ * The result with 2 * len digits replaces hh, hl and lh are freed.
+ * 
+ * @return The length of the result.
+ */
+int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len);
+
+/**
+ * @brief Combines the results of the 4 children like calcQuadResult(), but leaves them untouched.
+ * 
+ * @return The result with 2 * len digits (malloc).
+ */
+char *calcQuadProduct(char *hh, char *hl, char *lh, char *ll, size_t len);
+
+/**
+ * @brief Multiplies a and b (both len digits) on 64 bit limbs without forking: karatsuba down to LOCAL_DIGITS digits,
+ * then the schoolbook method.
+ * 
+ * @return The product with 2 * len digits (malloc).
+ */
+char *multiplyLocal(char *a, char *b, size_t len);
+
+/**
+ * @brief Adds the two halves h and l (both of length len, they don't need to be terminated) of a number for the karatsuba child.
+ * The sum without its carry is stored in sum (malloc, length len).
+ * 
+ * @return The carry of the sum (0 or 1).
+ */
+int addHalves(char *h, char *l, size_t len, char **sum);
+
+/**
+ * @brief Combines the results of the 3 karatsuba children: hh = Ah * Bh, ll = Al * Bl and mid = sa * sb,
+ * where ca * 16^(len/2) + sa = Ah + Al and cb * 16^(len/2) + sb = Bh + Bl.
+ * 
+ * @return The result with 2 * len digits (malloc).
  */
-int calcQuadResult(char **hh, char *hl, char *lh, char *ll, size_t len);
\ No newline at end of file
+char *calcKaratsubaResult(char *hh, char *ll, char *mid, char *sa, int ca, char *sb, int cb, size_t len);
\ No newline at end of file
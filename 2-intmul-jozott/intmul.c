@@ -6,6 +6,11 @@
  * @date 15.12.2020
  * @section File Overview
  * intmul is responsible for the procedure of forking and piping between all processes.
+ * With "-k" the karatsuba method is used: only 3 children compute Ah * Bh, Al * Bl and (Ah + Al) * (Bh + Bl).
+ * With "-c DIGITS" numbers of up to DIGITS digits (default LOCAL_DIGITS) are multiplied without forking. Only about as many
+ * processes as there are cores multiply in parallel, every child gets its share of the process budget by "-p" (internal).
+ * With "-s" the children are forked without exec and share one anonymous mapping with the parent: they read their halves from
+ * the memory they inherited and write their products into their slot of the mapping, the pipes only notify the parent.
  */
 
 #include <unistd.h>
@@ -16,6 +21,8 @@
 #include <time.h>
 #include <sys/types.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
 
 #include "hexcalc.h"
 #include "treerep.h"
@@ -29,6 +36,20 @@
         wait_handler(1);                                                                                 \
     }
 
+/**
+ * @brief The size of the blocks stdin is read in.
+ */
+#define INPUT_BLOCK_SIZE (1 << 16)
+
+/**
+ * @brief A half of a number: a view into the input of the process, which is not terminated.
+ */
+struct half
+{
+    char *digits;
+    size_t len;
+};
+
 /**
  * @brief File descriptors for the pipe from an child in direction to the parent.
  */
@@ -36,6 +57,39 @@ int pipeout[4][2];
 
 int treerep;
 
+/**
+ * @brief Set by "-k". The number of children is 3 instead of 4 then.
+ */
+int karatsuba;
+int children;
+
+/**
+ * @brief Set by "-c". Numbers of up to cutoff digits are multiplied by multiplyLocal().
+ */
+long cutoff;
+
+/**
+ * @brief Set by "-p" (the number of cores by default). The number of processes this process and its children may use.
+ * If it is smaller than the number of children, the process multiplies locally.
+ */
+long processes;
+
+/**
+ * @brief Set by "-s". The products of the children are passed in a shared anonymous mapping instead of the pipes.
+ */
+int shared;
+
+/**
+ * @brief In a child forked by fork_shared(), the write end of the pipe on which it notifies its parent (-1 otherwise).
+ */
+int notifyfd = -1;
+
+/**
+ * @brief The sums of the halves (without their carries) for the third child in the karatsuba mode.
+ */
+char *sumA, *sumB;
+int carryA, carryB;
+
 /**
  * @brief Handles the waiting for all child processes.
  * 
@@ -62,74 +116,105 @@ static void wait_handler(int err)
 /**
  * @brief Looks for two string from stdin. 
  * 
- * @details Calls EXIT_ERR() if input is not valid. Stores strings in given pointerpointer.
+ * @details Calls EXIT_ERR() if input is not valid. stdin is read in blocks of INPUT_BLOCK_SIZE bytes into one buffer (stored in input,
+ * free it after the strings) until the second newline, the strings are pointers into it and end with '\0' instead of the newline.
  * 
  * @return returns the length of one string.
  */
-static size_t get_values(char **a, char **b)
+static size_t get_values(char **input, char **a, char **b)
 {
-    size_t hexlen = 0;
+    char *buffer = NULL;
+    size_t size = 0, capacity = 0, scanned = 0;
+    size_t ends[2];
+    int lines = 0;
 
-    char *line;
-    size_t linecap = 0;
-    ssize_t linelen;
-    while ((linelen = getline(&line, &linecap, stdin)) != -1)
+    while (lines < 2)
     {
-
-        if (linelen == 1)
-            EXIT_ERR("Length of number was 0", 0)
-        if (hexlen != 0 && linelen - 1 != hexlen)
-            EXIT_ERR("Numbers of different lengths", 0)
-
-        if (hexlen == 0)
+        if (capacity - size < INPUT_BLOCK_SIZE)
         {
-            *a = malloc(linelen);
-            strcpy(*a, line);
-            hexlen = linelen - 1;
-            if (hexlen % 2 != 0 && hexlen != 1)
-                EXIT_ERR("number is not even", 0);
+            capacity = capacity + INPUT_BLOCK_SIZE > 2 * capacity ? capacity + INPUT_BLOCK_SIZE : 2 * capacity;
+            if ((buffer = realloc(buffer, capacity)) == NULL)
+                EXIT_ERR("Could not allocate memory", 1)
         }
-        else
-        {
-            *b = malloc(linelen);
-            strcpy(*b, line);
+
+        ssize_t readlen = read(STDIN_FILENO, buffer + size, capacity - size);
+        if (readlen == -1 && errno == EINTR)
+            continue;
+        if (readlen == -1)
+            EXIT_ERR("cannot read input", 1)
+        if (readlen == 0)
             break;
+        size += readlen;
+
+        char *newline;
+        while (lines < 2 && (newline = memchr(buffer + scanned, '\n', size - scanned)) != NULL)
+        {
+            ends[lines++] = newline - buffer;
+            scanned = newline - buffer + 1;
         }
     }
 
+    // the last line may end without newline, there is always room for its terminator
+    if (lines < 2 && scanned < size)
+        ends[lines++] = size;
+    if (lines < 2)
+        EXIT_ERR("Expected two numbers", 0)
+
+    size_t hexlen = ends[0];
+    if (hexlen == 0)
+        EXIT_ERR("Length of number was 0", 0)
+    if (ends[1] - ends[0] - 1 != hexlen)
+        EXIT_ERR("Numbers of different lengths", 0)
+    if (hexlen % 2 != 0 && hexlen != 1)
+        EXIT_ERR("number is not even", 0);
+
+    *input = buffer;
+    *a = buffer;
+    *b = buffer + hexlen + 1;
+    if (hexInvalid(*a, hexlen) != hexlen || hexInvalid(*b, hexlen) != hexlen)
+        EXIT_ERR("Number is no hex string", 0)
+
+    a[0][hexlen] = '\0';
+    b[0][hexlen] = '\0';
+
     return hexlen;
 }
 
 /**
- * @brief Splits given string line into two and stores them in the pointerpointer. Uses malloc so its important to free them.
- * Each string is ending with '\n'.
+ * @brief Splits given string line into two views, which point into the line and are not terminated.
  */
-static void gen_half_strlines(size_t len, char *A, char **Ah, char **Al)
+static void gen_halves(size_t len, char *A, struct half *Ah, struct half *Al)
 {
-    int lh = len / 2;
-    int ll = len - lh;
-
-    *Ah = malloc(lh + 2);
-    *Al = malloc(ll + 2);
-
-    memcpy(*Ah, A, lh);
-    memcpy(*Al, A + lh, ll);
-    Ah[0][lh] = '\n';
-    Ah[0][lh + 1] = '\0';
-    Al[0][ll] = '\n';
-    Al[0][ll + 1] = '\0';
+    Ah->digits = A;
+    Ah->len = len / 2;
+    Al->digits = A + Ah->len;
+    Al->len = len - Ah->len;
 }
 
 /**
- * @brief Writes data to pipe (given through the file descriptor)
+ * @brief Writes the digits of the half and a newline to the pipe (given through the file descriptor)
  */
-static void write_to_pipe(int fd, char *data)
+static void write_to_pipe(int fd, struct half data)
 {
-    FILE *f = fdopen(fd, "w");
-    if (fputs(data, f) == -1)
-        EXIT_ERR("cannot write to pipe", 1);
-
-    fflush(f);
+    struct iovec parts[2] = {{data.digits, data.len}, {"\n", 1}};
+    int part = 0;
+    while (part < 2)
+    {
+        ssize_t written = writev(fd, parts + part, 2 - part);
+        if (written == -1 && errno == EINTR)
+            continue;
+        if (written == -1)
+            EXIT_ERR("cannot write to pipe", 1);
+
+        // skip what was written, a part might only be written partially
+        for (; part < 2 && (size_t)written >= parts[part].iov_len; part++)
+            written -= parts[part].iov_len;
+        if (part < 2)
+        {
+            parts[part].iov_base = (char *)parts[part].iov_base + written;
+            parts[part].iov_len -= written;
+        }
+    }
 }
 
 /**
@@ -138,7 +223,7 @@ static void write_to_pipe(int fd, char *data)
 static void read_from_pipes(char *results[4])
 {
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < children; i++)
     {
         FILE *out = fdopen(pipeout[i][0], "r");
         size_t lencap = 0;
@@ -151,31 +236,35 @@ static void read_from_pipes(char *results[4])
 }
 
 /**
- * @brief Creates 4 childprocesses with in and out pipe. 
+ * @brief Creates 4 (karatsuba: 3) childprocesses with in and out pipe. 
  * It also redirects the readend of the inpipe to the stdin and the writeend of the outpipe to the stdout.
  * After forking and piping the parent process writes the data to the child processes.
  */
 static void fork_and_pipe(int hexlen, char *A, char *B)
 {
-    char *Ah;
-    char *Al;
-    char *Bh;
-    char *Bl;
+    struct half Ah, Al, Bh, Bl;
+    gen_halves(hexlen, A, &Ah, &Al);
+    gen_halves(hexlen, B, &Bh, &Bl);
 
-    gen_half_strlines(hexlen, A, &Ah, &Al);
-    gen_half_strlines(hexlen, B, &Bh, &Bl);
-
-    free(A);
-    free(B);
+    // Sa = Ah + Al and Sb = Bh + Bl
+    struct half Sa, Sb;
+    if (karatsuba)
+    {
+        carryA = addHalves(Ah.digits, Al.digits, hexlen / 2, &sumA);
+        carryB = addHalves(Bh.digits, Bl.digits, hexlen / 2, &sumB);
+        Sa = (struct half){sumA, hexlen / 2};
+        Sb = (struct half){sumB, hexlen / 2};
+    }
 
     // Ah * Bh = cid1
     // Ah * Bl = cid2
     // Al * Bh = cid3
     // Al * Bl = cid4
+    // (karatsuba: Ah * Bh, Al * Bl, Sa * Sb)
     pid_t cdi[4];
     int pipein[4][2];
 
-    for (int i = 0; i < 4; i++)
+    for (int i = 0; i < children; i++)
     {
         pipe(pipein[i]);
         pipe(pipeout[i]);
@@ -197,10 +286,16 @@ static void fork_and_pipe(int hexlen, char *A, char *B)
             close(pipein[i][0]);
             close(pipeout[i][1]);
 
+            char cutoffArg[32], processesArg[32];
+            sprintf(cutoffArg, "%ld", cutoff);
+            sprintf(processesArg, "%ld", processes / children);
+
             if (treerep)
                 execlp("./intmul", "./intmul", "-t", NULL);
+            else if (karatsuba)
+                execlp("./intmul", "./intmul", "-k", "-c", cutoffArg, "-p", processesArg, NULL);
             else
-                execlp("./intmul", "./intmul", NULL);
+                execlp("./intmul", "./intmul", "-c", cutoffArg, "-p", processesArg, NULL);
 
             EXIT_ERR("Could not execute", 1);
             break;
@@ -210,6 +305,14 @@ static void fork_and_pipe(int hexlen, char *A, char *B)
 
             int pfd = pipein[i][1];
 
+            if (karatsuba)
+            {
+                write_to_pipe(pfd, i == 0 ? Ah : i == 1 ? Al : Sa);
+                write_to_pipe(pfd, i == 0 ? Bh : i == 1 ? Bl : Sb);
+                close(pfd);
+                break;
+            }
+
             switch (i)
             {
             case 0:
@@ -229,73 +332,274 @@ static void fork_and_pipe(int hexlen, char *A, char *B)
                 write_to_pipe(pfd, Bl);
                 break;
             };
+            close(pfd);
             break;
         }
     }
+}
 
-    free(Ah);
-    free(Al);
-    free(Bh);
-    free(Bl);
+/**
+ * @brief Returns whether numbers of length hexlen are multiplied by multiplyLocal() with the given process budget.
+ */
+static int multiplies_locally(size_t hexlen, long budget)
+{
+    return hexlen == 1 || hexlen <= (size_t)cutoff || budget < children;
 }
 
 /**
- * @brief Reads 2 hex strings from stdin, if the length of them is 1, they are going to be added and printed to stdout as hex string.
+ * @brief Returns the size of the shared mapping multiply_shared() needs for numbers of length hexlen and the given process budget.
+ * 
+ * @details Every child gets a slot of hexlen + 1 characters (its product and '\0'), followed by the space of all its children.
+ */
+static size_t shared_size(size_t hexlen, long budget)
+{
+    if (multiplies_locally(hexlen, budget))
+        return 0;
+
+    return children * (hexlen + 1 + shared_size(hexlen / 2, budget / children));
+}
+
+static char *multiply_shared(char *A, char *B, size_t hexlen, long budget, char *scratch);
+
+/**
+ * @brief Forks a child, which multiplies A and B (length hexlen, not terminated) by multiply_shared() with the space at scratch and writes
+ * the product with '\0' to slot. Then it writes one byte to the pipe and exits.
+ * 
+ * @return The reading end of the pipe.
+ */
+static int fork_shared(char *A, char *B, size_t hexlen, long budget, char *slot, char *scratch)
+{
+    int notify[2];
+    if (pipe(notify) == -1)
+        EXIT_ERR("cannot create pipe", 1)
+
+    switch (fork())
+    {
+    case -1:
+        EXIT_ERR("Cannot fork!", 1);
+        break;
+    case 0:
+        // the pipe of the parent to its own parent must not be kept open by its children
+        if (notifyfd != -1)
+            close(notifyfd);
+        notifyfd = notify[1];
+        close(notify[0]);
+
+        char *product = multiply_shared(A, B, hexlen, budget, scratch);
+        memcpy(slot, product, 2 * hexlen + 1);
+        free(product);
+
+        char done = 1;
+        while (write(notifyfd, &done, 1) == -1)
+        {
+            if (errno != EINTR)
+                EXIT_ERR("cannot write to pipe", 1);
+        }
+        exit(EXIT_SUCCESS);
+    default:
+        close(notify[1]);
+        break;
+    }
+
+    return notify[0];
+}
+
+/**
+ * @brief Reads the notification of a child from the reading end of its pipe, calls EXIT_ERR() if the child died without one.
+ */
+static void wait_shared(int fd)
+{
+    char done;
+    ssize_t readlen;
+    while ((readlen = read(fd, &done, 1)) == -1 && errno == EINTR)
+        ;
+    if (readlen != 1)
+        EXIT_ERR("child did not finish its product", 0)
+
+    close(fd);
+}
+
+/**
+ * @brief Multiplies A and B (length hexlen, not terminated) for "-s": locally if multiplies_locally(), otherwise by children forked with
+ * fork_shared(). The products of the children are placed at the start of scratch, the space of their children behind them.
+ * 
+ * @return The product with 2 * hexlen digits (malloc).
+ */
+static char *multiply_shared(char *A, char *B, size_t hexlen, long budget, char *scratch)
+{
+    if (hexlen % 2 != 0 && hexlen != 1)
+        EXIT_ERR("number is not even", 0);
+    if (multiplies_locally(hexlen, budget))
+        return multiplyLocal(A, B, hexlen);
+
+    struct half Ah, Al, Bh, Bl;
+    gen_halves(hexlen, A, &Ah, &Al);
+    gen_halves(hexlen, B, &Bh, &Bl);
+
+    char *sa = NULL, *sb = NULL;
+    int ca = 0, cb = 0;
+    if (karatsuba)
+    {
+        ca = addHalves(Ah.digits, Al.digits, hexlen / 2, &sa);
+        cb = addHalves(Bh.digits, Bl.digits, hexlen / 2, &sb);
+    }
+
+    // the same children as in fork_and_pipe()
+    char *left[4] = {Ah.digits, Ah.digits, Al.digits, Al.digits};
+    char *right[4] = {Bh.digits, Bl.digits, Bh.digits, Bl.digits};
+    if (karatsuba)
+    {
+        left[1] = Al.digits;
+        left[2] = sa;
+        right[2] = sb;
+    }
+
+    size_t slot = hexlen + 1;
+    size_t below = shared_size(hexlen / 2, budget / children);
+    char *results[4];
+    int notify[4];
+    for (int i = 0; i < children; i++)
+    {
+        results[i] = scratch + i * slot;
+        notify[i] = fork_shared(left[i], right[i], hexlen / 2, budget / children, results[i], scratch + children * slot + i * below);
+    }
+    for (int i = 0; i < children; i++)
+        wait_shared(notify[i]);
+    wait_handler(0);
+
+    char *result = karatsuba ? calcKaratsubaResult(results[0], results[1], results[2], sa, ca, sb, cb, hexlen)
+                             : calcQuadProduct(results[0], results[1], results[2], results[3], hexlen);
+    free(sa);
+    free(sb);
+
+    return result;
+}
+
+/**
+ * @brief Parses the number of the option argument, calls EXIT_ERR() if it isn't a non negative number.
+ */
+static long parse_number(char *arg)
+{
+    char *end;
+    errno = 0;
+    long value = arg == NULL ? -1 : strtol(arg, &end, 10);
+    if (value < 0 || errno != 0 || end == arg || *end != '\0')
+        EXIT_ERR("Usage: intmul [-t|-k] [-c DIGITS] [-s]", 0)
+
+    return value;
+}
+
+/**
+ * @brief Reads 2 hex strings from stdin, if the length of them is at most the cutoff (or the process budget is used up),
+ * they are multiplied by multiplyLocal() and printed to stdout as hex string.
  * Otherwise fork_and_pipe() is called. After all child processes are finished, the process reads from the pipeout (result of the child processes).
  * Then it calls calcQuadResult() from hexcalc.c, where the caculation for the result is managed.
  * Last but not least, the result is printed to stdout.
  * 
  * If the flag "-t" is set, an treerepresentation of all child processes is printed instead of the result. It ueses process_to_string() and read_and_print() from treerep.c 
+ * If the flag "-k" is set, the result is calculated with 3 children by calcKaratsubaResult() (not combinable with "-t").
+ * If the flag "-s" is set, the result is calculated by multiply_shared() in one shared mapping (not combinable with "-t").
  */
 int main(int argc, char *argv[])
 {
     treerep = 0;
-    if (argc > 1 && strcmp(argv[1], "-t") == 0)
-        treerep = 1;
+    karatsuba = 0;
+    shared = 0;
+    cutoff = LOCAL_DIGITS;
+    processes = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-t") == 0)
+            treerep = 1;
+        else if (strcmp(argv[i], "-k") == 0)
+            karatsuba = 1;
+        else if (strcmp(argv[i], "-s") == 0)
+            shared = 1;
+        else if (strcmp(argv[i], "-c") == 0)
+            cutoff = parse_number(argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0)
+            processes = parse_number(argv[++i]);
+        else
+            EXIT_ERR("Usage: intmul [-t|-k] [-c DIGITS] [-s]", 0)
+    }
+    if (treerep && (karatsuba || shared))
+        EXIT_ERR("Usage: intmul [-t|-k] [-c DIGITS] [-s]", 0)
+    children = karatsuba ? 3 : 4;
 
+    char *input;
     char *A;
     char *B;
 
-    size_t hexlen = get_values(&A, &B);
-
-    A[hexlen] = '\0';
-    B[hexlen] = '\0';
+    size_t hexlen = get_values(&input, &A, &B);
 
     char *pname;
     if (treerep)
         process_to_string(&pname, A, B);
 
-    if (hexlen == 1)
+    // the tree shows the recursion down to single digits
+    if (hexlen == 1 && treerep)
     {
-        if (treerep)
-            fprintf(stdout, "%s\n", pname);
-        else
-        {
-            unsigned int a = strtol(A, NULL, 16);
-            unsigned int b = strtol(B, NULL, 16);
-            fprintf(stdout, "%X\n", (a * b));
-            fflush(stdout);
-        }
+        fprintf(stdout, "%s\n", pname);
+        exit(EXIT_SUCCESS);
+    }
+    if (multiplies_locally(hexlen, processes) && !treerep)
+    {
+        char *result = multiplyLocal(A, B, hexlen);
+        fprintf(stdout, "%s\n", result);
+        fflush(stdout);
+        free(result);
         exit(EXIT_SUCCESS);
     }
 
-    fork_and_pipe(hexlen, A, B);
+    if (shared)
+    {
+        // the whole tree uses this one mapping, the children inherit it with the input
+        size_t size = shared_size(hexlen, processes);
+        char *region = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        if (region == MAP_FAILED)
+            EXIT_ERR("cannot map shared memory", 1)
+
+        char *result = multiply_shared(A, B, hexlen, processes, region);
+        fprintf(stdout, "%s\n", result);
+        fflush(stdout);
+        free(result);
+        munmap(region, size);
+        free(input);
+        exit(EXIT_SUCCESS);
+    }
 
-    wait_handler(0);
+    fork_and_pipe(hexlen, A, B);
+    free(input);
 
+    // the results are read before waiting, children with large results would block on the full pipe otherwise
     if (treerep)
+    {
         read_and_print(pipeout, pname);
+        wait_handler(0);
+    }
     else
     {
         char *results[4];
         read_from_pipes(results);
+        wait_handler(0);
 
-        calcQuadResult(results, results[1], results[2], results[3], hexlen);
-
-        fprintf(stdout, "%s\n", results[0]);
+        if (karatsuba)
+        {
+            char *result = calcKaratsubaResult(results[0], results[1], results[2], sumA, carryA, sumB, carryB, hexlen);
+            fprintf(stdout, "%s\n", result);
+            free(result);
+            for (int i = 0; i < children; i++)
+                free(results[i]);
+            free(sumA);
+            free(sumB);
+        }
+        else
+        {
+            calcQuadResult(results, results[1], results[2], results[3], hexlen);
+            fprintf(stdout, "%s\n", results[0]);
+            free(results[0]);
+        }
         fflush(stdout);
-
-        free(results[0]);
     }
 
     exit(EXIT_SUCCESS);
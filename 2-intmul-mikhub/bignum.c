@@ -0,0 +1,480 @@
+#include "bignum.h"
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/**
+ * @file bignum.c
+ * @author Michael Huber 11712763
+ * @date 20.12.2020
+ * @brief Arithmetic on big integers stored as arrays of 64 bit limbs (see bignum.h)
+ */
+
+/** Double limb for products and carries */
+__extension__ typedef unsigned __int128 dlimb_t;
+
+/** Number of coefficient bits of the number theoretic transform */
+#define NTT_BITS 16
+
+/** Number of coefficients of one limb */
+#define NTT_COEFFS (64 / NTT_BITS)
+
+/** Number of primes the convolution is computed with */
+#define NTT_PRIMES 2
+
+/**
+ * Primes p = k * 2^m + 1 (with 3 as primitive root) allowing transforms of length up to 2^23, 
+ * their product is larger than any coefficient of the convolution (< 2^22 * 2^32)
+ */
+static const uint32_t ntt_primes[NTT_PRIMES] = { 998244353, 469762049 };
+
+/** Prime with the constants for the montgomery multiplication (R = 2^32) */
+typedef struct {
+    uint32_t p;
+    uint32_t p_neg_inv;
+    uint32_t r2;
+} ntt_prime_t;
+
+/** Word with the byte b in each of its 8 bytes */
+#define BYTES(b) ((uint64_t)(b) * 0x0101010101010101ULL)
+
+/** Word with the 16 bit value h in each of its 4 halfwords */
+#define HALVES(h) ((uint64_t)(h) * 0x0001000100010001ULL)
+
+/**
+ * @brief Converts a hex char to the corresponding integer
+ * @param c Hex char to be converted
+ */
+static int hextoint(char c) {
+    if (c >= 'a') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A') {
+        return c - 'A' + 10;
+    }
+    return c - '0';
+}
+
+/**
+ * @brief Returns whether a char is a hex digit (either case)
+ * @param c Char to be checked
+ */
+static bool is_hex(char c) {
+    return (c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+/**
+ * @brief Loads 8 chars into a word, the first char is its least significant byte
+ * @param s Chars to be loaded
+ */
+static uint64_t load_chars(const char* s) {
+    uint64_t w = 0;
+    for (int i = 7; i >= 0; i--)
+    {
+        w = (w << 8) | (unsigned char)s[i];
+    }
+    return w;
+}
+
+/**
+ * @brief Stores a word as 8 chars, its least significant byte is the first char
+ * @param s String the chars are written to
+ * @param w Word to be stored
+ */
+static void store_chars(char* s, uint64_t w) {
+    for (int i = 0; i < 8; i++)
+    {
+        s[i] = (char)(w >> (8 * i));
+    }
+}
+
+/**
+ * @brief Returns a word with the top bit set in every byte of w that is a hex digit (either case)
+ * @details The range checks are done on all 8 bytes at once: adding 0x80 - lo sets the top bit of 
+ * every byte >= lo. The top bits are cleared before, so no addition carries into the next byte.
+ * @param w 8 chars loaded with load_chars
+ */
+static uint64_t hex_mask(uint64_t w) {
+    uint64_t low = w & BYTES(0x7f);
+    uint64_t lower = low | BYTES(0x20);
+    uint64_t digit = (low + BYTES(0x80 - '0')) & ~(low + BYTES(0x80 - '9' - 1));
+    uint64_t letter = (lower + BYTES(0x80 - 'a')) & ~(lower + BYTES(0x80 - 'f' - 1));
+    return (digit | letter) & ~w & BYTES(0x80);
+}
+
+/**
+ * @brief Converts 8 hex digits loaded with load_chars to their value
+ * @details Every byte is mapped to its value (letters have bit 6 set and the value of their low 
+ * nibble plus 9), then neighbouring values are merged: nibbles to bytes, bytes to halfwords and 
+ * halfwords to the result.
+ * @param w 8 valid hex digits, the most significant one in the least significant byte
+ */
+static uint32_t parse_8_digits(uint64_t w) {
+    w = (w & BYTES(0x0f)) + ((w >> 6) & BYTES(0x01)) * 9;
+    w = ((w << 4) | (w >> 8)) & HALVES(0x00ff);
+    w = ((w << 8) | (w >> 16)) & 0x0000ffff0000ffffULL;
+    return (uint32_t)((w << 16) | (w >> 32));
+}
+
+/**
+ * @brief Converts a value to 8 lowercase hex digits to be stored with store_chars
+ * @details The inverse of parse_8_digits: the halfwords, bytes and nibbles are spread to one byte 
+ * per digit, then '0' is added to every byte and 'a' - '0' - 10 to those >= 10.
+ * @param v Value to be converted
+ */
+static uint64_t format_8_digits(uint32_t v) {
+    uint64_t w = (v >> 16) | ((uint64_t)(v & 0xffff) << 32);
+    w = ((w >> 8) & 0x000000ff000000ffULL) | ((w & 0x000000ff000000ffULL) << 16);
+    w = ((w >> 4) & HALVES(0x000f)) | ((w & HALVES(0x000f)) << 8);
+    return w + BYTES('0') + (((w + BYTES(6)) >> 4) & BYTES(0x01)) * ('a' - '0' - 10);
+}
+
+/**
+ * @brief Returns limb i of a * 2^bit (0 <= bit < 64) for i <= an
+ * @param a Number of an limbs
+ * @param an Number of limbs of a
+ * @param i Index of the limb
+ * @param bit Number of bits a is shifted by
+ */
+static limb_t shifted_limb(const limb_t* a, size_t an, size_t i, unsigned int bit) {
+    limb_t low = i < an ? a[i] : 0;
+    if (bit == 0) {
+        return low;
+    }
+    limb_t high = i > 0 ? a[i-1] >> (64 - bit) : 0;
+    return (low << bit) | high;
+}
+
+size_t limbs_for_digits(size_t digits) {
+    return (digits + LIMB_DIGITS - 1) / LIMB_DIGITS;
+}
+
+size_t hex_valid_digits(const char* hex, size_t digits) {
+    size_t k = 0;
+    while (k + 8 <= digits && hex_mask(load_chars(hex + k)) == BYTES(0x80))
+    {
+        k += 8;
+    }
+    while (k < digits && is_hex(hex[k]))
+    {
+        k++;
+    }
+    return k;
+}
+
+void hex_to_limbs(const char* hex, size_t digits, limb_t* limbs, size_t n) {
+    memset(limbs, 0, n * sizeof(limb_t));
+
+    // whole limbs (16 digits) from the end of the string, then the remaining high digits
+    size_t whole = digits / LIMB_DIGITS;
+    for (size_t i = 0; i < whole; i++)
+    {
+        const char* limb = hex + digits - (i + 1) * LIMB_DIGITS;
+        limbs[i] = (limb_t)parse_8_digits(load_chars(limb)) << 32 | parse_8_digits(load_chars(limb + 8));
+    }
+    for (size_t k = 0; k < digits % LIMB_DIGITS; k++)
+    {
+        limbs[whole] = (limbs[whole] << 4) | hextoint(hex[k]);
+    }
+}
+
+void limbs_to_hex(const limb_t* limbs, size_t n, char* hex, size_t digits) {
+    size_t whole = digits / LIMB_DIGITS;
+    for (size_t i = 0; i < whole; i++)
+    {
+        limb_t limb = i < n ? limbs[i] : 0;
+        char* digit = hex + digits - (i + 1) * LIMB_DIGITS;
+        store_chars(digit, format_8_digits((uint32_t)(limb >> 32)));
+        store_chars(digit + 8, format_8_digits((uint32_t)limb));
+    }
+
+    limb_t high = whole < n ? limbs[whole] : 0;
+    for (size_t k = digits % LIMB_DIGITS; k > 0; k--)
+    {
+        hex[k-1] = "0123456789abcdef"[high & 0xf];
+        high >>= 4;
+    }
+}
+
+void limbs_mul(const limb_t* a, size_t an, const limb_t* b, size_t bn, limb_t* result) {
+    memset(result, 0, (an + bn) * sizeof(limb_t));
+    for (size_t i = 0; i < an; i++)
+    {
+        limb_t carry = 0;
+        for (size_t j = 0; j < bn; j++)
+        {
+            dlimb_t t = (dlimb_t)a[i] * b[j] + result[i+j] + carry;
+            result[i+j] = (limb_t)t;
+            carry = (limb_t)(t >> 64);
+        }
+        result[i+bn] = carry;
+    }
+}
+
+int limbs_mul_karatsuba(const limb_t* a, const limb_t* b, size_t n, limb_t* result) {
+    if (n <= SCHOOLBOOK_LIMBS) {
+        limbs_mul(a, n, b, n, result);
+        return 0;
+    }
+
+    // a = a1 * 2^(64*m) + a0 with m low limbs and h >= m high limbs (b likewise)
+    size_t m = n / 2;
+    size_t h = n - m;
+    size_t k = h + 1;
+
+    // sa = a0 + a1 and sb = b0 + b1 (k limbs each), z1 = sa * sb (2*k limbs)
+    limb_t* tmp = malloc(4 * k * sizeof(limb_t));
+    if (tmp == NULL) {
+        return -1;
+    }
+    limb_t* sa = tmp;
+    limb_t* sb = tmp + k;
+    limb_t* z1 = tmp + 2*k;
+
+    memcpy(sa, a + m, h * sizeof(limb_t));
+    memcpy(sb, b + m, h * sizeof(limb_t));
+    sa[h] = 0;
+    sb[h] = 0;
+    limbs_add_shifted(sa, k, a, m, 0);
+    limbs_add_shifted(sb, k, b, m, 0);
+
+    // z0 = a0 * b0 and z2 = a1 * b1 are stored directly in the result
+    if (limbs_mul_karatsuba(a, b, m, result) < 0 ||
+        limbs_mul_karatsuba(a + m, b + m, h, result + 2*m) < 0 ||
+        limbs_mul_karatsuba(sa, sb, k, z1) < 0) {
+        free(tmp);
+        return -1;
+    }
+
+    // middle part z1 - z0 - z2 is never negative
+    limbs_sub_shifted(z1, 2*k, result, 2*m, 0);
+    limbs_sub_shifted(z1, 2*k, result + 2*m, 2*h, 0);
+    limbs_add_shifted(result, 2*n, z1, 2*k, 64*m);
+
+    free(tmp);
+    return 0;
+}
+
+/**
+ * @brief Computes base^exp mod p
+ */
+static uint32_t pow_mod(uint64_t base, uint64_t exp, uint32_t p) {
+    uint64_t result = 1;
+    base %= p;
+    while (exp > 0) {
+        if (exp & 1) {
+            result = result * base % p;
+        }
+        base = base * base % p;
+        exp >>= 1;
+    }
+    return (uint32_t)result;
+}
+
+/**
+ * @brief Computes the montgomery constants of a prime
+ */
+static ntt_prime_t ntt_prime(uint32_t p) {
+    // newton iteration for p^-1 mod 2^32, every step doubles the correct bits
+    uint32_t inv = p;
+    for (int i = 0; i < 4; i++) {
+        inv *= 2 - p * inv;
+    }
+    uint64_t r = ((uint64_t)1 << 32) % p;
+    ntt_prime_t prime = { p, -inv, (uint32_t)(r * r % p) };
+    return prime;
+}
+
+/**
+ * @brief Montgomery reduction: returns t * 2^-32 mod p for t < p * 2^32
+ */
+static inline uint32_t mont_reduce(uint64_t t, const ntt_prime_t* prime) {
+    uint32_t m = (uint32_t)t * prime->p_neg_inv;
+    uint64_t r = (t + (uint64_t)m * prime->p) >> 32;
+    return r >= prime->p ? (uint32_t)(r - prime->p) : (uint32_t)r;
+}
+
+/**
+ * @brief Returns a * b * 2^-32 mod p
+ */
+static inline uint32_t mont_mul(uint32_t a, uint32_t b, const ntt_prime_t* prime) {
+    return mont_reduce((uint64_t)a * b, prime);
+}
+
+/**
+ * @brief Returns the montgomery form v * 2^32 mod p
+ */
+static inline uint32_t to_mont(uint32_t v, const ntt_prime_t* prime) {
+    return mont_mul(v, prime->r2, prime);
+}
+
+/**
+ * @brief In place forward number theoretic transform (iterative, radix 2)
+ * @param x Array of len coefficients (all smaller than p)
+ * @param len Length of the transform (power of two)
+ * @param prime Prime the transform is computed modulo
+ * @param twiddles Powers 0..len/2-1 of the len-th root of unity in montgomery form
+ */
+static void ntt(uint32_t* x, size_t len, const ntt_prime_t* prime, const uint32_t* twiddles) {
+    // bit reversal permutation
+    for (size_t i = 1, j = 0; i < len; i++)
+    {
+        size_t bit = len >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j ^= bit;
+        if (i < j) {
+            uint32_t t = x[i];
+            x[i] = x[j];
+            x[j] = t;
+        }
+    }
+
+    uint32_t p = prime->p;
+    for (size_t half = 1; half < len; half <<= 1)
+    {
+        size_t step = len / (2 * half);
+        for (size_t start = 0; start < len; start += 2 * half)
+        {
+            uint32_t* lo = x + start;
+            uint32_t* hi = x + start + half;
+            for (size_t k = 0; k < half; k++)
+            {
+                uint32_t u = lo[k];
+                uint32_t v = mont_mul(hi[k], twiddles[k * step], prime);
+                lo[k] = u + v >= p ? u + v - p : u + v;
+                hi[k] = u >= v ? u - v : u + p - v;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Splits n limbs into coefficients of NTT_BITS bits (least significant first)
+ */
+static void limbs_to_coeffs(const limb_t* a, size_t n, uint32_t* coeffs, size_t len) {
+    memset(coeffs, 0, len * sizeof(uint32_t));
+    for (size_t i = 0; i < n * NTT_COEFFS; i++)
+    {
+        coeffs[i] = (a[i / NTT_COEFFS] >> (NTT_BITS * (i % NTT_COEFFS))) & ((1 << NTT_BITS) - 1);
+    }
+}
+
+int limbs_mul_ntt(const limb_t* a, const limb_t* b, size_t n, limb_t* result) {
+    size_t coeffs = n * NTT_COEFFS;
+    size_t len = 1;
+    while (len < 2 * coeffs) {
+        len <<= 1;
+    }
+
+    uint32_t* tmp = malloc((NTT_PRIMES * len + len + len / 2) * sizeof(uint32_t));
+    if (tmp == NULL) {
+        return -1;
+    }
+    uint32_t* fb = tmp + NTT_PRIMES * len;
+    uint32_t* twiddles = fb + len;
+
+    // cyclic convolution modulo every prime, the result of prime i is stored in tmp + i*len
+    for (size_t i = 0; i < NTT_PRIMES; i++)
+    {
+        ntt_prime_t prime = ntt_prime(ntt_primes[i]);
+        uint32_t root = to_mont(pow_mod(3, (prime.p - 1) / len, prime.p), &prime);
+        twiddles[0] = to_mont(1, &prime);
+        for (size_t k = 1; k < len / 2; k++)
+        {
+            twiddles[k] = mont_mul(twiddles[k-1], root, &prime);
+        }
+
+        uint32_t* fa = tmp + i * len;
+        limbs_to_coeffs(a, n, fa, len);
+        limbs_to_coeffs(b, n, fb, len);
+        ntt(fa, len, &prime, twiddles);
+        ntt(fb, len, &prime, twiddles);
+
+        // the products carry a factor 2^-32, which is removed together with the division by len
+        for (size_t k = 0; k < len; k++)
+        {
+            fa[k] = mont_mul(fa[k], fb[k], &prime);
+        }
+
+        // inverse transform: forward transform with the elements 1..len-1 reversed
+        ntt(fa, len, &prime, twiddles);
+        for (size_t k = 1; k < len - k; k++)
+        {
+            uint32_t t = fa[k];
+            fa[k] = fa[len-k];
+            fa[len-k] = t;
+        }
+        uint32_t scale = to_mont(to_mont(pow_mod(len, prime.p - 2, prime.p), &prime), &prime);
+        for (size_t k = 0; k < len; k++)
+        {
+            fa[k] = mont_mul(fa[k], scale, &prime);
+        }
+    }
+
+    // chinese remainder theorem: x = r0 + p0 * ((r1 - r0) * p0^-1 mod p1) < p0 * p1
+    const uint64_t p0 = ntt_primes[0], p1 = ntt_primes[1];
+    const uint64_t p0_inv = pow_mod(p0, p1 - 2, p1);
+
+    memset(result, 0, 2 * n * sizeof(limb_t));
+    uint64_t carry = 0;
+    for (size_t k = 0; k < 2 * coeffs; k++)
+    {
+        uint64_t r0 = tmp[k], r1 = tmp[len+k];
+        uint64_t value = r0 + p0 * ((r1 + p1 - r0 % p1) * p0_inv % p1) + carry;
+
+        result[k / NTT_COEFFS] |= (value & ((1 << NTT_BITS) - 1)) << (NTT_BITS * (k % NTT_COEFFS));
+        carry = value >> NTT_BITS;
+    }
+
+    free(tmp);
+    return 0;
+}
+
+int limbs_mul_fast(const limb_t* a, const limb_t* b, size_t n, limb_t* result, size_t ntt_limbs) {
+    if (n >= ntt_limbs && n <= NTT_MAX_LIMBS) {
+        return limbs_mul_ntt(a, b, n, result);
+    }
+    return limbs_mul_karatsuba(a, b, n, result);
+}
+
+limb_t limbs_add_shifted(limb_t* r, size_t rn, const limb_t* a, size_t an, size_t bits) {
+    size_t offset = bits / 64;
+    unsigned int bit = bits % 64;
+
+    // a * 2^bit has an+1 limbs, the carry continues through the rest of r
+    limb_t carry = 0;
+    size_t i = 0;
+    for (; i <= an && offset + i < rn; i++)
+    {
+        dlimb_t t = (dlimb_t)r[offset+i] + shifted_limb(a, an, i, bit) + carry;
+        r[offset+i] = (limb_t)t;
+        carry = (limb_t)(t >> 64);
+    }
+    for (; carry != 0 && offset + i < rn; i++)
+    {
+        carry = ++r[offset+i] == 0;
+    }
+    return carry;
+}
+
+limb_t limbs_sub_shifted(limb_t* r, size_t rn, const limb_t* a, size_t an, size_t bits) {
+    size_t offset = bits / 64;
+    unsigned int bit = bits % 64;
+
+    limb_t borrow = 0;
+    size_t i = 0;
+    for (; i <= an && offset + i < rn; i++)
+    {
+        dlimb_t t = (dlimb_t)r[offset+i] - shifted_limb(a, an, i, bit) - borrow;
+        r[offset+i] = (limb_t)t;
+        borrow = (limb_t)(t >> 64) & 1;
+    }
+    for (; borrow != 0 && offset + i < rn; i++)
+    {
+        borrow = r[offset+i]-- == 0;
+    }
+    return borrow;
+}
@@ -0,0 +1,132 @@
+#ifndef _BIGNUM_H_
+#define _BIGNUM_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @file bignum.h
+ * @author Michael Huber 11712763
+ * @date 20.12.2020
+ * @brief Arithmetic on big integers stored as arrays of 64 bit limbs
+ * @details The limbs are stored least significant first. Hex strings are only used for input
+ * and output, all arithmetic is done on whole limbs (with __int128 for the carries). The hex
+ * conversions work on 8 chars per 64 bit word (SWAR), so one limb takes two steps.
+ */
+
+/** Limb of a big integer */
+typedef uint64_t limb_t;
+
+/** Number of hex digits of one limb */
+#define LIMB_DIGITS 16
+
+/** Maximum number of limbs multiplied locally with the schoolbook method */
+#define SCHOOLBOOK_LIMBS 32
+
+/** Default minimum number of limbs multiplied with the number theoretic transform */
+#define NTT_LIMBS 8192
+
+/** Maximum number of limbs the number theoretic transform can multiply */
+#define NTT_MAX_LIMBS (1 << 20)
+
+/**
+ * @brief Returns the number of limbs needed for a number of hex digits
+ * @param digits Number of hex digits
+ */
+size_t limbs_for_digits(size_t digits);
+
+/**
+ * @brief Validates a hex string (both cases), 8 chars at a time
+ * @param hex Hex string (does not need to be terminated)
+ * @param digits Number of chars to be validated
+ * @return Index of the first char that is no hex digit, digits if there is none
+ */
+size_t hex_valid_digits(const char* hex, size_t digits);
+
+/**
+ * @brief Converts a hex string to limbs
+ * @param hex Hex string of valid digits (does not need to be terminated)
+ * @param digits Number of digits of the hex string
+ * @param limbs Array of n limbs the number is written to
+ * @param n Number of limbs, at least limbs_for_digits(digits)
+ */
+void hex_to_limbs(const char* hex, size_t digits, limb_t* limbs, size_t n);
+
+/**
+ * @brief Converts limbs to a hex string with exactly the given number of digits (lowercase,
+ * padded with zeros, not terminated)
+ * @param limbs Array of n limbs
+ * @param n Number of limbs
+ * @param hex String the digits are written to
+ * @param digits Number of digits to write
+ */
+void limbs_to_hex(const limb_t* limbs, size_t n, char* hex, size_t digits);
+
+/**
+ * @brief Multiplies two numbers with the schoolbook method
+ * @param a First number (an limbs)
+ * @param an Number of limbs of a
+ * @param b Second number (bn limbs)
+ * @param bn Number of limbs of b
+ * @param result Array of an+bn limbs the product is written to
+ */
+void limbs_mul(const limb_t* a, size_t an, const limb_t* b, size_t bn, limb_t* result);
+
+/**
+ * @brief Multiplies two numbers of equal length with the karatsuba method, numbers of up to 
+ * SCHOOLBOOK_LIMBS limbs are multiplied with limbs_mul
+ * @param a First number (n limbs)
+ * @param b Second number (n limbs)
+ * @param n Number of limbs of a and b
+ * @param result Array of 2*n limbs the product is written to
+ * @return 0 on success, -1 if the temporary memory could not be allocated
+ */
+int limbs_mul_karatsuba(const limb_t* a, const limb_t* b, size_t n, limb_t* result);
+
+/**
+ * @brief Multiplies two numbers of equal length with a number theoretic transform
+ * @details The limbs are split into 16 bit coefficients, the convolution is computed modulo three 
+ * NTT friendly primes and recombined with the chinese remainder theorem.
+ * @param a First number (n limbs)
+ * @param b Second number (n limbs)
+ * @param n Number of limbs of a and b, at most NTT_MAX_LIMBS
+ * @param result Array of 2*n limbs the product is written to
+ * @return 0 on success, -1 if the temporary memory could not be allocated
+ */
+int limbs_mul_ntt(const limb_t* a, const limb_t* b, size_t n, limb_t* result);
+
+/**
+ * @brief Multiplies two numbers of equal length with the fastest method for their length: 
+ * number theoretic transform from ntt_limbs limbs on, karatsuba below
+ * @param a First number (n limbs)
+ * @param b Second number (n limbs)
+ * @param n Number of limbs of a and b
+ * @param result Array of 2*n limbs the product is written to
+ * @param ntt_limbs Minimum number of limbs multiplied with the number theoretic transform
+ * @return 0 on success, -1 if the temporary memory could not be allocated
+ */
+int limbs_mul_fast(const limb_t* a, const limb_t* b, size_t n, limb_t* result, size_t ntt_limbs);
+
+/**
+ * @brief Adds a number multiplied with 2^bits to another one: r += a * 2^bits
+ * @param r Number of rn limbs the sum is stored in
+ * @param rn Number of limbs of r
+ * @param a Number of an limbs to be added
+ * @param an Number of limbs of a
+ * @param bits Number of bits a is shifted by
+ * @return Carry out of r (0 or 1)
+ */
+limb_t limbs_add_shifted(limb_t* r, size_t rn, const limb_t* a, size_t an, size_t bits);
+
+/**
+ * @brief Subtracts a number multiplied with 2^bits from another one: r -= a * 2^bits
+ * @param r Number of rn limbs the difference is stored in
+ * @param rn Number of limbs of r
+ * @param a Number of an limbs to be subtracted
+ * @param an Number of limbs of a
+ * @param bits Number of bits a is shifted by
+ * @return Borrow out of r (0 or 1)
+ */
+limb_t limbs_sub_shifted(limb_t* r, size_t rn, const limb_t* a, size_t an, size_t bits);
+
+#endif
@@ -6,23 +6,24 @@ static void close_pipes(void);
 static void close_unused_pipes(void);
 
 // utils
-static int hextoint(char c);
-static char inttohex(int n);
 static void cleanup(void);
 static const char* PROGRAM_NAME;
 
 // main
 static size_t readinput(void);
-static void base_case(char cA, char cB);
+static void base_case(size_t len);
 static void invoke_child(int i);
 static void write_to_children(int len);
 static void wait_for_children(void);
 static void read_from_children_and_print_combined_result(int len);
+static void add_halves(void);
+static void combine_results(char** child_results, ssize_t* child_results_len, int len, char* result);
 
 // error handling
 static void ERROR_EXIT(char* message, char* error_details);
 static void ERROR_MSG(char* message, char* error_details);
 static void USAGE(void);
+static long parse_number(const char* arg);
 
 /**
  * @file intmul.c
@@ -32,6 +33,15 @@ static void USAGE(void);
  * @details The program takes two hexadecimal integers A and B with an equal number of digits as 
  * input, multiplies them and prints the result. The input is read from stdin and consists of two 
  * lines: the first line is the integer A and the second line is the integer B.
+ * With -k the karatsuba method is used, which only needs 3 children per level: Ah*Bh, Al*Bl and
+ * (Ah+Al)*(Bh+Bl), the middle part of the result is the last product minus the other two.
+ * The numbers are converted to 64 bit limbs (bignum.h) for all calculations. Numbers of up to 
+ * DIGITS digits (-c, default SCHOOLBOOK_LIMBS limbs) are multiplied by the process itself with the
+ * karatsuba kernel of bignum.c. Only about as many processes as there are cores multiply in 
+ * parallel: every child gets its share of the process budget (-p, internal option) and multiplies 
+ * locally as soon as the budget is too small for another level of children.
+ * Local multiplications of at least DIGITS digits (-n, default NTT_LIMBS limbs) use the number 
+ * theoretic transform of bignum.c instead of karatsuba.
  */
 
 /** Struct for storing input numbers */
@@ -43,8 +53,24 @@ static child_process_t children[NUM_CHILDREN];
 /** Array for storing all pipe ends (to be able to close them in a loop) */
 static pipe_end_t pipe_ends[NUM_PIPE_ENDS];
 
+/** Struct for storing the sums of the halves (karatsuba mode) */
+static karatsuba_sums_t sums;
+
+/** Number of children and pipe ends used (depends on the mode) */
+static size_t num_children = NUM_CHILDREN;
+static size_t num_pipe_ends = NUM_PIPE_ENDS;
+
 /** Booleans set by options */
-static bool tree, parent;
+static bool tree, parent, karatsuba;
+
+/** Numbers of up to cutoff digits are multiplied locally (-c) */
+static long cutoff = SCHOOLBOOK_LIMBS*LIMB_DIGITS;
+
+/** Number of processes this process and its descendants may use for multiplying (-p) */
+static long processes = 0;
+
+/** Local multiplications of at least ntt_digits digits use the number theoretic transform (-n) */
+static long ntt_digits = NTT_LIMBS*LIMB_DIGITS;
 
 /**
  * @brief Sets up cleanup function, parses options, calls functions to fork children and
@@ -63,9 +89,29 @@ int main(int argc, char* const *argv) {
 
     // parse options
     int count_t = 0;
+    int count_k = 0;
+    int count_c = 0;
+    int count_p = 0;
+    int count_n = 0;
     int c;  
-    while((c = getopt(argc, argv, "tT")) != -1 ) {
+    while((c = getopt(argc, argv, "tTkc:p:n:")) != -1 ) {
         switch (c) {
+            case 'n':
+                ntt_digits = parse_number(optarg);
+                count_n++;
+                break;
+            case 'c':
+                cutoff = parse_number(optarg);
+                count_c++;
+                break;
+            case 'p':
+                processes = parse_number(optarg);
+                count_p++;
+                break;
+            case 'k':
+                karatsuba = true;
+                count_k++;
+                break;
             case 't':
                 parent = true;
                 tree = true;
@@ -84,26 +130,47 @@ int main(int argc, char* const *argv) {
         }
     }
 
-    // Wrong usage
-    if (count_t > 1 || argc > 2 || (argc > 1 && count_t > 1)) {
+    // Wrong usage (the tree is only supported with 4 children)
+    if (count_t > 1 || count_k > 1 || count_c > 1 || count_p > 1 || count_n > 1 || optind != argc || (tree && karatsuba)) {
         USAGE();
     }
 
+    // the top process may use all cores
+    if (count_p == 0) {
+        processes = sysconf(_SC_NPROCESSORS_ONLN);
+        if (processes < 1) {
+            processes = 1;
+        }
+    }
+
+    if (karatsuba) {
+        num_children = NUM_KARATSUBA_CHILDREN;
+        num_pipe_ends = 4*NUM_KARATSUBA_CHILDREN;
+    }
+
     // initialize input struct
+    numbers.buffer = NULL;
     numbers.A = NULL;
     numbers.B = NULL;
+    sums.A = NULL;
+    sums.B = NULL;
 
     // read in number
     size_t len = readinput(); // freeing is done in cleanup function
 
-    // recursion base case
-    if (len == 1) {
-        base_case(numbers.A[0], numbers.B[0]);
+    // recursion base case (the tree shows the recursion down to single digits)
+    if (len == 1 || (!tree && ((long)len <= cutoff || processes < (long)num_children))) {
+        base_case(len);
     } 
     
-    // fork 4 children
+    // sums of the halves for the third child
+    if (karatsuba) {
+        add_halves();
+    }
+
+    // fork 4 (karatsuba: 3) children
     create_pipes();
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         pid_t pid = fork();
         if (pid == -1) {
@@ -135,32 +202,63 @@ int main(int argc, char* const *argv) {
 /**
  * @brief Reads the first two lines of stdin, validates if they are valid hex strings, have even length
  * and puts them into the numbers struct
- * @details Fills the global struct numbers
+ * @details Fills the global struct numbers: stdin is read in blocks of INPUT_BLOCK_SIZE bytes into
+ * numbers.buffer until the second newline, A and B point into the buffer (terminated instead of the
+ * newlines). Anything after the second line is not read.
  */
 static size_t readinput(void){
 
-    numbers.A = NULL;
-    size_t len1, buflen1;
-    if((len1 = getline(&(numbers.A), &buflen1, stdin)) < 0) {
-        ERROR_EXIT("Reading of first line failed", strerror(errno));
-    }
+    size_t size = 0, capacity = 0, scanned = 0;
+    size_t ends[2];
+    int lines = 0;
 
-    numbers.B = NULL;
-    size_t len2, buflen2;
-    if((len2 = getline(&(numbers.B), &buflen2, stdin)) < 0) {
-        ERROR_EXIT("Reading of second line failed", strerror(errno));
-    }
+    while (lines < 2) {
+        if (capacity - size < INPUT_BLOCK_SIZE) {
+            capacity = capacity + INPUT_BLOCK_SIZE > 2*capacity ? capacity + INPUT_BLOCK_SIZE : 2*capacity;
+            char* buffer = realloc(numbers.buffer, capacity);
+            if (buffer == NULL) {
+                ERROR_EXIT("Error while allocating input", strerror(errno));
+            }
+            numbers.buffer = buffer;
+        }
 
-    if (numbers.A[len1-1] == '\n') {
-        numbers.A[len1-1] = '\0';
-        len1 = len1-1;
+        ssize_t read_len = read(STDIN_FILENO, numbers.buffer + size, capacity - size);
+        if (read_len < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            ERROR_EXIT("Reading of input failed", strerror(errno));
+        }
+        if (read_len == 0) {
+            break;
+        }
+        size += read_len;
+
+        char* newline;
+        while (lines < 2 && (newline = memchr(numbers.buffer + scanned, '\n', size - scanned)) != NULL) {
+            ends[lines++] = newline - numbers.buffer;
+            scanned = ends[lines-1] + 1;
+        }
     }
 
-    if (numbers.B[len2-1] == '\n') {
-        numbers.B[len2-1] = '\0';
-        len2 = len2-1;
+    // the last line may end without newline, there is always room for its terminator
+    if (lines < 2 && scanned < size) {
+        ends[lines++] = size;
+    }
+    if (lines < 1) {
+        ERROR_EXIT("Reading of first line failed", NULL);
+    }
+    if (lines < 2) {
+        ERROR_EXIT("Reading of second line failed", NULL);
     }
 
+    numbers.A = numbers.buffer;
+    numbers.B = numbers.buffer + ends[0] + 1;
+    numbers.A[ends[0]] = '\0';
+    numbers.B[ends[1] - ends[0] - 1] = '\0';
+    size_t len1 = ends[0];
+    size_t len2 = ends[1] - ends[0] - 1;
+
     if (len1 != len2) {
         ERROR_EXIT("Numbers do not have equal length", NULL);
     }
@@ -175,39 +273,57 @@ static size_t readinput(void){
         ERROR_EXIT("Input length is not a power of two", NULL);
     }
 
-    for (size_t i = 0; i < len; i++)
-    {
-        if(isxdigit(numbers.A[i]) == false) {
-            char errormsg[64];
-            snprintf(errormsg, 64, "Digit %c (value %d) of line 1 is no hex digit", numbers.A[i], (unsigned int)numbers.A[i]);
-            ERROR_EXIT(errormsg, NULL);
-        }
-        if(isxdigit(numbers.B[i]) == false) {
-            char errormsg[64];
-            snprintf(errormsg, 64, "Digit %c (value %d) of line 2 is no hex digit", numbers.B[i], (unsigned int)numbers.B[i]);
-            ERROR_EXIT(errormsg, NULL);
-        }
+    // the first invalid digit is reported, of line 1 if both lines have one at the same index
+    size_t invalidA = hex_valid_digits(numbers.A, len);
+    size_t invalidB = hex_valid_digits(numbers.B, len);
+    if (invalidA < len && invalidA <= invalidB) {
+        char errormsg[64];
+        snprintf(errormsg, 64, "Digit %c (value %d) of line 1 is no hex digit", numbers.A[invalidA], (unsigned int)numbers.A[invalidA]);
+        ERROR_EXIT(errormsg, NULL);
+    }
+    if (invalidB < len) {
+        char errormsg[64];
+        snprintf(errormsg, 64, "Digit %c (value %d) of line 2 is no hex digit", numbers.B[invalidB], (unsigned int)numbers.B[invalidB]);
+        ERROR_EXIT(errormsg, NULL);
     }
 
     return len;
 }
 
 /**
- * @brief Recursion base case - multiplies two one-digit hex numbers and prints the result to stdout
- * @param cA First hex char
- * @param cB Second hex char
+ * @brief Recursion base case - multiplies the input numbers with the karatsuba or NTT kernel and prints 
+ * the result (2*len digits) to stdout
+ * @details Uses the global struct numbers
+ * @param len Length of the input
  */
-static void base_case(char cA, char cB) {
-    int A = hextoint(cA);
-    int B = hextoint(cB);
-    int result = A * B;
+static void base_case(size_t len) {
+    size_t n = limbs_for_digits(len);
+    limb_t* limbs = malloc(4*n * sizeof(limb_t));
+    char* result = malloc(2*len+1);
+    if (limbs == NULL || result == NULL) {
+        ERROR_EXIT("Error while allocating base case", strerror(errno));
+    }
+    limb_t* A = limbs;
+    limb_t* B = limbs + n;
+    limb_t* product = limbs + 2*n;
+
+    hex_to_limbs(numbers.A, len, A, n);
+    hex_to_limbs(numbers.B, len, B, n);
+    if (limbs_mul_fast(A, B, n, product, limbs_for_digits(ntt_digits)) < 0) {
+        ERROR_EXIT("Error while multiplying", strerror(errno));
+    }
 
-    fprintf(stdout, "%02x\n", result);
+    limbs_to_hex(product, 2*n, result, 2*len);
+    result[2*len] = '\0';
+
+    fprintf(stdout, "%s\n", result);
+    free(result);
+    free(limbs);
     if (tree) {
         int padwidth = (TREE_COLUMN_WIDTH/4-11);
         int padding1 = padwidth/2;
         int padding2 = padwidth % 2 == 0 ? padwidth/2 : padwidth/2 + 1;
-        fprintf(stdout, "%*sINTMUL(%c,%c)%*s$", padding1, " ", cA, cB, padding2, " ");
+        fprintf(stdout, "%*sINTMUL(%c,%c)%*s$", padding1, " ", numbers.A[0], numbers.B[0], padding2, " ");
         fflush(stdout);
     }
     exit(EXIT_SUCCESS);
@@ -218,7 +334,7 @@ static void base_case(char cA, char cB) {
  * @details Fills the global arrays children and pipe_ends
  */ 
 static void create_pipes(void) {
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         int par_to_child[2], child_to_par[2];
 
@@ -258,10 +374,25 @@ static void invoke_child(int i) {
     // close all pipes in child process
     close_pipes();
 
-    // recursive call
-    char* option = NULL;
-    if (tree) option = "-T";
-    if(execlp(PROGRAM_NAME, PROGRAM_NAME, option, NULL) < 0){
+    // recursive call with the cutoff and the share of the process budget
+    char cutoff_arg[32], processes_arg[32], ntt_arg[32];
+    snprintf(cutoff_arg, sizeof(cutoff_arg), "%ld", cutoff);
+    snprintf(ntt_arg, sizeof(ntt_arg), "%ld", ntt_digits);
+    snprintf(processes_arg, sizeof(processes_arg), "%ld", processes / (long)num_children);
+
+    char* args[10];
+    int argi = 0;
+    args[argi++] = (char*)PROGRAM_NAME;
+    if (tree) args[argi++] = "-T";
+    if (karatsuba) args[argi++] = "-k";
+    args[argi++] = "-c";
+    args[argi++] = cutoff_arg;
+    args[argi++] = "-p";
+    args[argi++] = processes_arg;
+    args[argi++] = "-n";
+    args[argi++] = ntt_arg;
+    args[argi] = NULL;
+    if(execvp(PROGRAM_NAME, args) < 0){
         ERROR_EXIT("Error while execlp child AhBh", strerror(errno));
     }
 }
@@ -271,7 +402,7 @@ static void invoke_child(int i) {
  * @details Uses global array pipe_ends to access pipes
  */
 static void close_pipes(void) {
-    for (size_t i = 0; i < NUM_PIPE_ENDS; i++)
+    for (size_t i = 0; i < num_pipe_ends; i++)
     {
         if(close(pipe_ends[i]) < 0) {
             ERROR_EXIT("Error while closing pipe", strerror(errno));
@@ -285,7 +416,7 @@ static void close_pipes(void) {
  * @details Uses the global array children to access pipes
  */
 static void close_unused_pipes() {
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         if (close(children[i].pipes[IN].ends[READ]) + close(children[i].pipes[OUT].ends[WRITE]) < 0) {
             ERROR_EXIT("Error while closing unused pipe ends", strerror(errno));
@@ -301,7 +432,7 @@ static void close_unused_pipes() {
 static void write_to_children(int len) { 
     // open files for writing to children
     FILE* in[NUM_CHILDREN];
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         in[i] = fdopen(children[i].pipes[IN].ends[WRITE], "w");
     }
@@ -314,15 +445,21 @@ static void write_to_children(int len) {
     char* Bl = numbers.B + half_len;
 
     // write parts to each child
-    for (size_t i = 0; i < NUM_CHILDREN; i++) {
-        if (i == AhBh || i == AhBl) fprintf(in[i], "%.*s\n", half_len, Ah);
-        if (i == AlBh || i == AlBl) fprintf(in[i], "%.*s\n", half_len, Al);
-        if (i == AhBh || i == AlBh) fprintf(in[i], "%.*s\n", half_len, Bh);
-        if (i == AhBl || i == AlBl) fprintf(in[i], "%.*s\n", half_len, Bl);
+    if (karatsuba) {
+        fprintf(in[KARATSUBA_HH], "%.*s\n%.*s\n", half_len, Ah, half_len, Bh);
+        fprintf(in[KARATSUBA_LL], "%.*s\n%.*s\n", half_len, Al, half_len, Bl);
+        fprintf(in[KARATSUBA_SUM], "%s\n%s\n", sums.A, sums.B);
+    } else {
+        for (size_t i = 0; i < NUM_CHILDREN; i++) {
+            if (i == AhBh || i == AhBl) fprintf(in[i], "%.*s\n", half_len, Ah);
+            if (i == AlBh || i == AlBl) fprintf(in[i], "%.*s\n", half_len, Al);
+            if (i == AhBh || i == AlBh) fprintf(in[i], "%.*s\n", half_len, Bh);
+            if (i == AhBl || i == AlBl) fprintf(in[i], "%.*s\n", half_len, Bl);
+        }
     }
     
     // close input files
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         if (fclose(in[i]) < 0) {
             ERROR_MSG("Error while closing input files", strerror(errno));
@@ -336,7 +473,7 @@ static void write_to_children(int len) {
  */ 
 static void wait_for_children() {
     // wait for children
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         int status;
         if (waitpid(children[i].pid, &status, 0) < 0) {
@@ -357,7 +494,7 @@ static void wait_for_children() {
 static void read_from_children_and_print_combined_result(int len) {
     // open files for reading from childs
     FILE* out[NUM_CHILDREN];
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         out[i] = fdopen(children[i].pipes[OUT].ends[READ], "r");
     }
@@ -365,7 +502,7 @@ static void read_from_children_and_print_combined_result(int len) {
     // read each child result
     char* child_results[NUM_CHILDREN];
     ssize_t child_results_len[NUM_CHILDREN];
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         child_results[i] = NULL;
         ssize_t result_len = 0;
@@ -380,61 +517,23 @@ static void read_from_children_and_print_combined_result(int len) {
         child_results_len[i] = result_len;
     }
 
-    // combine children results
-    int half_len = len/2;
+    // combine children results (the result can have at most 2*input-length digits)
     int double_len = 2*len;
-
-    // the result can have at most 2*input-length digits
-    char result[double_len+1];
-    memset(result, 0, double_len);
-    result[double_len] = '\0';
-
-    int index[NUM_CHILDREN];
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
-    {
-        index[i] = child_results_len[i]-1;
-    }
-
-    int carry = 0;
-    for (int i = double_len-1; i >= 0; i--)
-    {
-        if(i >= len+half_len) {
-        // Al*Bl 
-        // (for first n/2 digits can be just copied)
-            result[i] = index[AlBl] < 0 ? 0 : child_results[AlBl][index[AlBl]--];
-        } else if (i >= len) {
-        // Ah*Bl * 16^n/2 + Al*Bh * 16^n/2 + Al*Bl 
-        // (for next n/2 digits AhBl and AlBh need to be taken into account)
-            int n0 = index[AlBl] < 0 ? 0 : hextoint(child_results[AlBl][index[AlBl]--]);
-            int n1 = index[AlBh] < 0 ? 0 : hextoint(child_results[AlBh][index[AlBh]--]);
-            int n2 = index[AhBl] < 0 ? 0 : hextoint(child_results[AhBl][index[AhBl]--]);
-
-            int n = n0 + n1 + n2 + carry;
-            
-            result[i] = inttohex(n % 16);
-            carry = n / 16;
-        } else {
-        // Ah*Bh * 16^n + Ah*Bl * 16^n/2 + Al*Bh * 16^n/2 + Al*Bl
-        // (for the remaining digits all subresults have to be combined)
-            int n0 = index[AlBl] < 0 ? 0 : hextoint(child_results[AlBl][index[AlBl]--]);
-            int n1 = index[AlBh] < 0 ? 0 : hextoint(child_results[AlBh][index[AlBh]--]);
-            int n2 = index[AhBl] < 0 ? 0 : hextoint(child_results[AhBl][index[AhBl]--]);
-            int n3 = index[AhBh] < 0 ? 0 : hextoint(child_results[AhBh][index[AhBh]--]);
-
-            int n = n0 + n1 + n2 + n3 + carry;
-            
-            result[i] = inttohex(n % 16);
-            carry = n / 16;
-        }
+    char* result = malloc(double_len+1);
+    if (result == NULL) {
+        ERROR_EXIT("Error while allocating result", strerror(errno));
     }
+    combine_results(child_results, child_results_len, len, result);
+    result[double_len] = '\0';
 
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         free(child_results[i]);
     }
 
     // print result to stdout
     fprintf(stdout, "%s\n", result);
+    free(result);
 
     /* BONUS{ */
     if (tree) {
@@ -499,7 +598,7 @@ static void read_from_children_and_print_combined_result(int len) {
     }
     /* }BONUS */
     
-    for (size_t i = 0; i < NUM_CHILDREN; i++)
+    for (size_t i = 0; i < num_children; i++)
     {
         if(fclose(out[i]) < 0) {
             ERROR_EXIT("Error while closing output file", strerror(errno));
@@ -508,52 +607,143 @@ static void read_from_children_and_print_combined_result(int len) {
 }
 
 /**
- * @brief Frees the allocated input numbers (if not already freed)
- * @details Uses the global array numbers to free content
- */ 
-static void cleanup(void) {
-    // free numbers
-    if (numbers.A != NULL) {
-        free(numbers.A);
-    }
-    if (numbers.B != NULL) {
-        free(numbers.B);
-    }
+ * @brief Adds the two halves of a number
+ * @param number Number with 2*half_len digits
+ * @param half_len Length of a half
+ * @param sum String the sum (without carry) is written to (half_len digits)
+ * @return The carry of the sum (0 or 1)
+ */
+static int add_half(const char* number, size_t half_len, char* sum) {
+    size_t n = limbs_for_digits(half_len);
+    limb_t high[n+1], low[n];
+    hex_to_limbs(number, half_len, high, n+1);
+    hex_to_limbs(number+half_len, half_len, low, n);
+    limbs_add_shifted(high, n+1, low, n, 0);
+
+    size_t carry_bit = 4*half_len;
+    limbs_to_hex(high, n+1, sum, half_len);
+    return (high[carry_bit/64] >> (carry_bit%64)) & 1;
 }
 
 /**
- * @brief Converts a hex char to the corresponding decimal integer
- * @param c Hex char to be converted
+ * @brief Adds the halves of both numbers for the third child of the karatsuba mode
+ * @details Fills the global struct sums, the sums have the length of a half and the carry is stored separately
+ * (so the child gets an input with a power of two length again)
  */
-static int hextoint(char c){
-    int value;
-    if (c >= 'A') {
-        if (c >= 'a') {
-            value = (c - 'a' + 10);
-        } else {
-            value = (c - 'A' + 10);
+static void add_halves(void) {
+    size_t half_len = strlen(numbers.A)/2;
+    sums.A = malloc(half_len+1);
+    sums.B = malloc(half_len+1);
+    if (sums.A == NULL || sums.B == NULL) {
+        ERROR_EXIT("Error while allocating sums", strerror(errno));
+    }
+    sums.A[half_len] = '\0';
+    sums.B[half_len] = '\0';
+
+    sums.carryA = add_half(numbers.A, half_len, sums.A);
+    sums.carryB = add_half(numbers.B, half_len, sums.B);
+}
+
+/**
+ * @brief Converts a hex string to a newly allocated array of limbs
+ * @param hex Hex string
+ * @param digits Number of digits
+ * @param n Is set to the number of limbs
+ */
+static limb_t* to_limbs(const char* hex, size_t digits, size_t* n) {
+    *n = limbs_for_digits(digits);
+    limb_t* limbs = malloc((*n > 0 ? *n : 1) * sizeof(limb_t));
+    if (limbs == NULL) {
+        ERROR_EXIT("Error while allocating limbs", strerror(errno));
+    }
+    hex_to_limbs(hex, digits, limbs, *n);
+    return limbs;
+}
+
+/**
+ * @brief Combines the results of the children
+ * @details With 4 children the result is AhBh * 16^n + (AhBl + AlBh) * 16^n/2 + AlBl.
+ * In the karatsuba mode with S = (Ah+Al)*(Bh+Bl) the result is AhBh * 16^n + (S - AhBh - AlBl) * 16^n/2 + AlBl.
+ * The child only computed the product of the sums without carries, so S is 
+ * sums.A*sums.B + (carryA*sums.B + carryB*sums.A) * 16^n/2 + carryA*carryB * 16^n.
+ * All additions are done before the subtractions, so no intermediate result is negative.
+ * Uses the global struct sums.
+ * @param child_results Results of the children
+ * @param child_results_len Lengths of the results
+ * @param len Length of parent input
+ * @param result String of 2*len digits the result is written to
+ */
+static void combine_results(char** child_results, ssize_t* child_results_len, int len, char* result) {
+    size_t half_bits = 4*(len/2);
+    size_t len_bits = 4*len;
+
+    // one more limb, as the middle part is added before the subtraction
+    size_t n = limbs_for_digits(2*len) + 1;
+    limb_t* sum = calloc(n, sizeof(limb_t));
+    if (sum == NULL) {
+        ERROR_EXIT("Error while allocating result", strerror(errno));
+    }
+
+    limb_t* parts[NUM_CHILDREN];
+    size_t parts_len[NUM_CHILDREN];
+    for (size_t i = 0; i < num_children; i++)
+    {
+        parts[i] = to_limbs(child_results[i], child_results_len[i], &parts_len[i]);
+    }
+
+    if (karatsuba) {
+        limbs_add_shifted(sum, n, parts[KARATSUBA_LL], parts_len[KARATSUBA_LL], 0);
+        limbs_add_shifted(sum, n, parts[KARATSUBA_HH], parts_len[KARATSUBA_HH], len_bits);
+        limbs_add_shifted(sum, n, parts[KARATSUBA_SUM], parts_len[KARATSUBA_SUM], half_bits);
+        if (sums.carryA) {
+            size_t sum_len;
+            limb_t* sumB = to_limbs(sums.B, len/2, &sum_len);
+            limbs_add_shifted(sum, n, sumB, sum_len, len_bits);
+            free(sumB);
+        }
+        if (sums.carryB) {
+            size_t sum_len;
+            limb_t* sumA = to_limbs(sums.A, len/2, &sum_len);
+            limbs_add_shifted(sum, n, sumA, sum_len, len_bits);
+            free(sumA);
         }
+        if (sums.carryA && sums.carryB) {
+            limb_t one = 1;
+            limbs_add_shifted(sum, n, &one, 1, len_bits + half_bits);
+        }
+        limbs_sub_shifted(sum, n, parts[KARATSUBA_HH], parts_len[KARATSUBA_HH], half_bits);
+        limbs_sub_shifted(sum, n, parts[KARATSUBA_LL], parts_len[KARATSUBA_LL], half_bits);
     } else {
-        value = (c - '0');
+        limbs_add_shifted(sum, n, parts[AlBl], parts_len[AlBl], 0);
+        limbs_add_shifted(sum, n, parts[AhBl], parts_len[AhBl], half_bits);
+        limbs_add_shifted(sum, n, parts[AlBh], parts_len[AlBh], half_bits);
+        limbs_add_shifted(sum, n, parts[AhBh], parts_len[AhBh], len_bits);
     }
-    return value;
+
+    limbs_to_hex(sum, n, result, 2*len);
+
+    for (size_t i = 0; i < num_children; i++)
+    {
+        free(parts[i]);
+    }
+    free(sum);
 }
 
 /**
- * @brief Converts an int 0<=n<=15 to the corresponding hex char
- * @param n Integer to be converted
- */
-static char inttohex(int n) {
-    char c;
-    if (n>15 || n<0) {
-        ERROR_MSG("invalid hex number", NULL);
-        return -1;
-    } else if (n<10) {
-        c = '0'+n;
-    } else {
-        c = 'a'+(n-10);
+ * @brief Frees the allocated input numbers and sums (if not already freed)
+ * @details Uses the global structs numbers and sums to free content
+ */ 
+static void cleanup(void) {
+    // free numbers (A and B point into the buffer)
+    if (numbers.buffer != NULL) {
+        free(numbers.buffer);
+    }
+    if (sums.A != NULL) {
+        free(sums.A);
+    }
+    if (sums.B != NULL) {
+        free(sums.B);
     }
-    return c;
 }
 
 static void ERROR_EXIT(char *message, char *error_details) {
@@ -570,6 +760,20 @@ static void ERROR_MSG(char *message, char *error_details) {
 }
 
 void USAGE(void) {
-    fprintf(stderr, "Usage: %s [-t]", PROGRAM_NAME);
+    fprintf(stderr, "Usage: %s [-t|-k] [-c DIGITS] [-n DIGITS]", PROGRAM_NAME);
     exit(EXIT_FAILURE);
+}
+
+/**
+ * @brief Parses a non negative number of an option argument, prints the usage if it is invalid
+ * @param arg Option argument
+ */
+static long parse_number(const char* arg) {
+    char* end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || end == arg || *end != '\0' || value < 0) {
+        USAGE();
+    }
+    return value;
 }
\ No newline at end of file
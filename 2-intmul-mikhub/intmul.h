@@ -13,8 +13,11 @@
 #include <errno.h>
 #include <getopt.h>
 
-/** Number of children to fork (always 4 with intmul) */
+#include "bignum.h"
+
+/** Number of children to fork (4 with intmul, 3 with the karatsuba mode) */
 #define NUM_CHILDREN 4
+#define NUM_KARATSUBA_CHILDREN 3
 /** Number of pipe ends needed for children */
 #define NUM_PIPE_ENDS 4*NUM_CHILDREN
 
@@ -32,6 +35,11 @@
 #define AlBh 2
 #define AlBl 3
 
+/** Child indices of the karatsuba mode */
+#define KARATSUBA_HH 0
+#define KARATSUBA_LL 1
+#define KARATSUBA_SUM 2
+
 /* BONUS{ */
 
 /** Width of a tree leaf [Width of "INTMUL(X,Y)" is 11 + 5 Padding] */
@@ -55,10 +63,25 @@ typedef struct {
     pipe_t pipes[2];
 } child_process_t;
 
-/** Struct for storing input numbers */
+/** Size of the blocks stdin is read in */
+#define INPUT_BLOCK_SIZE (1 << 16)
+
+/** Struct for storing input numbers, A and B are views into the buffer holding both lines */
 typedef struct {
+    char* buffer;
     char* A;
     char* B;
 } intmul_input_t;
 
+/** 
+ * Struct for storing the sums of the halves in the karatsuba mode:
+ * Ah + Al = carryA * 16^(len/2) + A (B likewise)
+ */
+typedef struct {
+    char* A;
+    char* B;
+    int carryA;
+    int carryB;
+} karatsuba_sums_t;
+
 #endif
\ No newline at end of file
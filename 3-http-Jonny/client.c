@@ -13,11 +13,18 @@
 #include <stdbool.h>
 #include <unistd.h>
 #include <string.h>
+#include <fcntl.h>
 #include <sys/socket.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <netdb.h>
 #include <errno.h>
 
+// the response header has to fit into this many bytes
+#define HEADER_SIZE (8 * 1024)
+// splice moves at most this many bytes at once (the default capacity of a pipe)
+#define SPLICE_SIZE (64 * 1024)
+
 static char *prog_name;
 
 /**
@@ -89,13 +96,61 @@ void parse_arguments(char *path_opt, char *url_opt, char* host, char* output_pat
 
 }
 
+/**
+ * @brief
+ * reads the header from the socket
+ * 
+ * @details
+ * Peeks at the received bytes and only consumes them up to the empty line that ends the header,
+ * so the content stays in the socket (and can be spliced from there).
+ * @param socket_fd The socket from which should be read.
+ * @param buffer The buffer the header is written to.
+ * @param size The size of the buffer.
+ * @return Returns the length of the header or -1 if the header could not be read or does not fit.
+**/
+ssize_t read_header(int socket_fd, char *buffer, size_t size)
+{
+    size_t len = 0;
+    while (len < size)
+    {
+        ssize_t peeked = recv(socket_fd, buffer + len, size - len, MSG_PEEK);
+        if (peeked <= 0)
+        {
+            return -1;
+        }
+
+        // the empty line may begin in the bytes which were consumed already
+        size_t end = 0;
+        for (size_t i = len >= 3 ? len - 3 : 0; i + 4 <= len + peeked; i++)
+        {
+            if (memcmp(buffer + i, "\r\n\r\n", 4) == 0)
+            {
+                end = i + 4;
+                break;
+            }
+        }
+
+        size_t take = end > 0 ? end - len : (size_t) peeked;
+        if (recv(socket_fd, buffer + len, take, MSG_WAITALL) != (ssize_t) take)
+        {
+            return -1;
+        }
+        len += take;
+        if (end > 0)
+        {
+            return len;
+        }
+    }
+    return -1;
+}
+
 /**
  * @brief
  * reads, parses and validates the header
  * 
  * @details
  * reads the header line by line and check if the version matches. Parses the status code and message and cheks them.
- * @param socket_file The FIle* from which should be read.
+ * @param socket_file The FIle* from which should be read (the header read with read_header).
  * @return Returns 0 if everything was successfull. Otherwise returns the exit code with which the program should exit.
 **/
 int read_header_and_validate(FILE *socket_file)
@@ -140,6 +195,68 @@ int read_header_and_validate(FILE *socket_file)
     return 0;
 }
 
+/**
+ * @brief
+ * moves the content part of the http response into a file without copying it
+ * 
+ * @details
+ * Moves the content with splice from the socket into a pipe and from there into the output file, so
+ * it never has to be copied to user space. Only works if output_file is a regular file.
+ * @param socket_fd The socket from which should be read.
+ * @param output_file The FILE* to which sholuld be written.
+ * @return Returns 0 if everything was moved, 1 if splice can not be used for the output file (the rest
+ * has to be copied) or -1 on failure.
+**/
+int splice_content(int socket_fd, FILE *output_file){
+    struct stat st;
+    if (fstat(fileno(output_file), &st) == -1 || !S_ISREG(st.st_mode))
+    {
+        return 1;
+    }
+    int pipe_fd[2];
+    if (pipe(pipe_fd) == -1)
+    {
+        return 1;
+    }
+    fflush(output_file);
+
+    int ret = 0;
+    ssize_t in;
+    while ((in = splice(socket_fd, NULL, pipe_fd[1], NULL, SPLICE_SIZE, SPLICE_F_MOVE | SPLICE_F_MORE)) > 0)
+    {
+        while (in > 0)
+        {
+            ssize_t out = splice(pipe_fd[0], NULL, fileno(output_file), NULL, in, SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out <= 0)
+            {
+                break;
+            }
+            in -= out;
+        }
+        if (in > 0)
+        {
+            // some file systems do not support splice, write what is in the pipe and copy the rest
+            ret = errno == EINVAL ? 1 : -1;
+            char buffer[8 * 1024];
+            ssize_t read_bytes;
+            while (ret == 1 && in > 0 && (read_bytes = read(pipe_fd[0], buffer, sizeof(buffer))) > 0)
+            {
+                fwrite(buffer, sizeof(char), read_bytes, output_file);
+                in -= read_bytes;
+            }
+            break;
+        }
+    }
+    if (in < 0)
+    {
+        ret = -1;
+    }
+
+    close(pipe_fd[0]);
+    close(pipe_fd[1]);
+    return ret;
+}
+
 /**
  * @brief
  * reads the content part of the http response
@@ -354,15 +471,41 @@ int main(int argc, char *argv[])
     
     send_get_request(host, request_path, socket_file);
 
+    // Read the header straight from the socket, so the content is still there afterwards
+    char header[HEADER_SIZE];
+    ssize_t header_len = read_header(socket_fd, header, sizeof(header));
+    FILE *header_file = header_len > 0 ? fmemopen(header, header_len, "r") : NULL;
+    if (header_file == NULL)
+    {
+        fprintf(stderr, "[%s] Protocol error!\n", prog_name);
+        safe_close_output_file(output_file);
+        fclose(socket_file);
+        exit(2);
+    }
+
     // Read and validate header. If value != 0 an error occurred
-    int exit_code = read_header_and_validate(socket_file);
+    int exit_code = read_header_and_validate(header_file);
+    fclose(header_file);
     if(exit_code != 0){
         //free resources
         safe_close_output_file(output_file);
         fclose(socket_file);
         exit(exit_code);
     }
-    read_content(socket_file, output_file);
+
+    // splice the content into regular files and copy it otherwise
+    int spliced = splice_content(socket_fd, output_file);
+    if (spliced == 1)
+    {
+        read_content(socket_file, output_file);
+    }
+    else if (spliced == -1)
+    {
+        fprintf(stderr, "[%s] Error splice failed (%s)\n", prog_name, strerror(errno));
+        safe_close_output_file(output_file);
+        fclose(socket_file);
+        exit(EXIT_FAILURE);
+    }
 
     //free resources
     safe_close_output_file(output_file);
@@ -22,6 +22,11 @@
 #include <time.h>
 #include <signal.h> 
 #include <assert.h>
+#include <sys/wait.h>
+
+#include "httpparse.h"
+
+#define MAX_WORKERS 1024
 
 static char *prog_name;
 volatile sig_atomic_t quit = 0;
@@ -48,60 +53,39 @@ void handle_signal(int signal) { quit = 1; }
 **/
 void usage(void)
 {
-    fprintf(stderr, "[%s] Usage: %s [-p PORT] [-i INDEX] DOC_ROOT\n", prog_name, prog_name);
+    fprintf(stderr, "[%s] Usage: %s [-p PORT] [-i INDEX] [-w WORKERS] DOC_ROOT\n", prog_name, prog_name);
     exit(EXIT_FAILURE);
 }
 
 /**
  * @brief
- * Parses the header of the client
+ * Checks the parsed header of the client
  * 
  * @details
- * Parses the header and returns the status code.
- * @param connect_file 
- * @param buffer 
- * @param buffer_cap 
- * @param index_filename 
- * @param doc_dir 
- * @param full_path 
+ * Checks the request line of the header and returns the status code. If the header is valid the path of the
+ * requested file is written to full_path, with index_filename appended if a directory was requested.
+ * @param req The header parsed by httpparse_read
+ * @param index_filename The file which is sent if a directory is requested.
+ * @param doc_dir The directory from which the files are served.
+ * @param full_path The buffer for the path, it must be large enough for doc_dir, the path and index_filename.
  * @return Returns the status code
 **/
-int parse_header(FILE *connect_file, char *buffer, size_t *buffer_cap, char *index_filename, char *doc_dir, char* full_path){
-    char first_line[strlen(buffer) + 1];
-    strcpy(first_line, buffer);
-    
-    // split by space. eg: GET /index.html HTTP/1.1 -> 
-    // request_method="GET" 
-    // path="/index.html" 
-    // version="HTTP/1.1" 
-    // empty="\r\n"
-    char* request_method = strtok(first_line, " ");
-    char* path = strtok(NULL, " ");
-    char* version = strtok(NULL, " ");
-    char* empty = strtok(NULL, "\r\n");    
-    //fprintf(stderr, "request_method=%s path=%s version=%s empty=%s\n", request_method, path, version, empty);
-
-    strcpy(full_path, doc_dir);
-    strcat(full_path, path);
-    //fprintf(stderr, "FULL PATH=%s\n", full_path);
-
-    //if last symbol is / -> add index.html as the file (directory was specified)
-    if(path[strlen(path)-1] == '/'){
-        strcat(full_path, "index.html");
-    }
-
-    
-    //fprintf(stderr, "version=(%s)\n", version);
+int parse_header(const struct httpparse_request *req, char *index_filename, char *doc_dir, char* full_path){
     //return the appropriate status code
-    if(request_method == NULL || path == NULL || version == NULL || empty != NULL){
+    if(!httpparse_equals(req->version, "HTTP/1.1") || req->path.ptr[0] != '/'){
         return 400;
     }
-    else if(strcmp(version, "HTTP/1.1\r\n") != 0){
-        return 400;
-    }
-    else if(strcmp(request_method, "GET") != 0){
+    if(!httpparse_equals(req->method, "GET")){
         return 501;
     }
+
+    strcpy(full_path, doc_dir);
+    strncat(full_path, req->path.ptr, req->path.len);
+
+    //if last symbol is / -> add the index file (directory was specified)
+    if(req->path.ptr[req->path.len - 1] == '/'){
+        strcat(full_path, index_filename);
+    }
     return 200;
 }
 
@@ -133,14 +117,21 @@ int get_file_size(char *path){
  * 
  * @details
  * Returns the current time formated according to GMT format. Example: Sun, 11 Nov 18 22:55:00 GMT
- * @return Returns the current time as a char*. This pointer needs to be freed by the caller.
+ * The string is kept in a static buffer and only formatted again if the second changed since the last call,
+ * so sending many responses per second costs neither strftime nor malloc.
+ * @return Returns the current time as a const char*. The buffer is owned by the function and must not be freed.
 **/
-char* get_current_time(){
-    char *buffer = malloc(100);
-    time_t rawtime = time(NULL);
-    struct tm *time_info = gmtime(&rawtime);
+const char* get_current_time(){
+    static char buffer[100];
+    static time_t formatted = (time_t) -1;
 
-    strftime(buffer, 100, "%a, %d %b %y %T %Z", time_info);
+    time_t rawtime = time(NULL);
+    if(rawtime != formatted){
+        struct tm time_info;
+        gmtime_r(&rawtime, &time_info);
+        strftime(buffer, sizeof(buffer), "%a, %d %b %y %T %Z", &time_info);
+        formatted = rawtime;
+    }
     return buffer;
 }
 
@@ -156,7 +147,7 @@ char* get_current_time(){
 **/
 void write_header(int status_code, char* path, FILE* file){
     int content_length = get_file_size(path);
-    char *date = get_current_time();
+    const char *date = get_current_time();
     char *status_message = "OK";
     char *content_type = "";
 
@@ -179,7 +170,6 @@ void write_header(int status_code, char* path, FILE* file){
     if(fprintf(file, "HTTP/1.1 %d %s\r\nDate: %s\r\n%sContent-Length: %d\r\nConnection: close\r\n\r\n", status_code, status_message, date, content_type, content_length) < 0){
         fprintf(stderr, "[%s] Error fprintf failed\n", prog_name);
     }
-    free(date);
     fflush(file);
 }
 
@@ -279,9 +269,10 @@ int open_next_connection(int socket_fd, FILE **connect_file){
  * @details
  * OPens a new connection to which clients can connect and request files
  * @param port The port where the server should be set up.
+ * @param reuse_port If true SO_REUSEPORT is set so multiple workers can bind the same port.
  * @return Returns the socket_fd on success and -1 on failure
 **/
-int setup_server(char *port){
+int setup_server(char *port, bool reuse_port){
     //setup addrinfo struct with host and port information
     struct addrinfo hints, *ai;
     memset(&hints, 0, sizeof hints);
@@ -304,6 +295,10 @@ int setup_server(char *port){
     //option to reuse port immediatley
     int optval = 1;
     setsockopt(socket_fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval);
+    if (reuse_port && setsockopt(socket_fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) < 0) {
+        fprintf(stderr, "[%s] Error setsockopt SO_REUSEPORT failed\n", prog_name);
+        return -1;
+    }
 
     if (bind(socket_fd, ai->ai_addr, ai->ai_addrlen) < 0) {
         fprintf(stderr, "[%s] Error bind failed\n", prog_name);
@@ -323,6 +318,178 @@ int setup_server(char *port){
 
 
 
+/**
+ * @brief
+ * Serves the clients until a signal occurs.
+ * 
+ * @details
+ * Opens the server socket and answers one request after the other until quit is set.
+ * @param port The port where the server should be set up.
+ * @param index_filename The file which is sent if a directory is requested.
+ * @param doc_dir The directory from which the files are served.
+ * @param reuse_port If true the socket is opened with SO_REUSEPORT.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE if the socket could not be opened.
+**/
+int serve(char *port, char *index_filename, char *doc_dir, bool reuse_port)
+{
+    int socket_fd = setup_server(port, reuse_port);
+    if(socket_fd == -1){
+        fprintf(stderr, "[%s] Could not open open socket\n", prog_name);
+        return EXIT_FAILURE;
+    }
+    while(!quit){
+        FILE* connect_file = NULL;
+        int connection = open_next_connection(socket_fd, &connect_file);
+        if(connection == -1){
+            fprintf(stderr, "[%s] Error opening connection\n", prog_name);
+            continue;
+        }
+        // Signal occured. continue -> quit is 1 and exit the loop
+        if(connect_file == NULL){
+            continue;
+        }
+
+        // Read and parse the whole header in place, nothing of it is allocated
+        struct httpparse_arena arena;
+        struct httpparse_request req;
+        arena.len = 0;
+        enum httpparse_result result = httpparse_read(fileno(connect_file), &arena, &req);
+        if(result == HTTPPARSE_CLOSED){
+            fprintf(stderr, "[%s] Error reading the header failed (%s)\n", prog_name, strerror(errno));
+            fclose(connect_file);
+            continue;
+        }
+
+        char full_path[strlen(doc_dir) + HTTPPARSE_ARENA_SIZE + strlen(index_filename) + 1];
+        strcpy(full_path, "");
+        int status_code = result == HTTPPARSE_OK ? parse_header(&req, index_filename, doc_dir, full_path) : 400;
+
+        // Open the specified file which should be transmitted
+        FILE *input_file = status_code == 200 ? fopen(full_path, "r") : NULL;
+        if(status_code == 200){
+            if(input_file == NULL){
+                status_code = 404;
+                //fprintf(stderr, "[%s] Status code 404: File (%s) not found (%s)\n", prog_name, full_path, strerror(errno));
+            }
+        }
+        fprintf(stderr, "[%s] Status-code [%d], File-path (%s) \n", prog_name, status_code, full_path);
+
+        // Write the normal header and content if the status code is 200. Otherwise write the error header and no content
+        if(status_code == 200){
+            write_header(status_code, full_path, connect_file);
+            write_content(input_file, connect_file);
+            //write_content(input_file, stderr);
+        }
+        else{
+            write_error_header(status_code, connect_file);
+        }
+
+
+        // Free resources
+        if(input_file != NULL){
+            fclose(input_file);
+        }
+        fclose(connect_file);
+    }
+
+    // Free resources
+    close(socket_fd);
+
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * @brief
+ * Starts a worker process.
+ * 
+ * @details
+ * Forks a child which serves the clients on its own SO_REUSEPORT socket. The program is terminated if fork fails.
+ * @param port The port where the server should be set up.
+ * @param index_filename The file which is sent if a directory is requested.
+ * @param doc_dir The directory from which the files are served.
+ * @return Returns the pid of the worker.
+**/
+pid_t start_worker(char *port, char *index_filename, char *doc_dir)
+{
+    pid_t pid = fork();
+    if (pid == -1){
+        fprintf(stderr, "[%s] Error fork failed (%s)\n", prog_name, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+    if (pid == 0){
+        exit(serve(port, index_filename, doc_dir, true));
+    }
+    return pid;
+}
+
+
+/**
+ * @brief
+ * Runs and supervises multiple workers.
+ * 
+ * @details
+ * Starts worker_count workers on the same port and restarts a worker if it crashes or exits. A worker which fails
+ * within a second after its start could not open its socket, so in that case all workers are stopped instead.
+ * When a signal occurs SIGTERM is sent to all workers and the function waits until they answered their current
+ * request.
+ * @param port The port where the server should be set up.
+ * @param index_filename The file which is sent if a directory is requested.
+ * @param doc_dir The directory from which the files are served.
+ * @param worker_count The number of workers.
+ * @return Returns EXIT_SUCCESS or EXIT_FAILURE if a worker failed to start.
+**/
+int run_workers(char *port, char *index_filename, char *doc_dir, long worker_count)
+{
+    pid_t workers[worker_count];
+    time_t started[worker_count];
+    int exit_code = EXIT_SUCCESS;
+
+    for (long i = 0; i < worker_count; i++){
+        workers[i] = start_worker(port, index_filename, doc_dir);
+        started[i] = time(NULL);
+    }
+
+    while(!quit){
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1){
+            if (errno == EINTR){
+                continue;
+            }
+            break;
+        }
+
+        for (long i = 0; i < worker_count; i++){
+            if (workers[i] != pid){
+                continue;
+            }
+            workers[i] = -1;
+            if (quit){
+                break;
+            }
+            if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS && time(NULL) - started[i] < 1){
+                fprintf(stderr, "[%s] Error worker failed to start\n", prog_name);
+                quit = 1;
+                exit_code = EXIT_FAILURE;
+                break;
+            }
+            fprintf(stderr, "[%s] Worker %d exited, restarting it\n", prog_name, (int)pid);
+            workers[i] = start_worker(port, index_filename, doc_dir);
+            started[i] = time(NULL);
+        }
+    }
+
+    for (long i = 0; i < worker_count; i++){
+        if (workers[i] > 0){
+            kill(workers[i], SIGTERM);
+        }
+    }
+    while(wait(NULL) != -1 || errno == EINTR);
+
+    return exit_code;
+}
+
 /**
  * Program entry point
  * @brief
@@ -342,12 +509,14 @@ int main(int argc, char *argv[])
     prog_name = argv[0];
     int opt;
     bool p_flag = false;
+    bool w_flag = false;
+    long worker_count = 1;
 
     //assign default values
     port = "8080";
     index_filename = "index.html";
 
-    while ((opt = getopt(argc, argv, "p:i:")) != -1)
+    while ((opt = getopt(argc, argv, "p:i:w:")) != -1)
     {
         switch (opt)
         {
@@ -374,6 +543,19 @@ int main(int argc, char *argv[])
 
             index_filename = optarg;
             break;
+        case 'w':
+            if (w_flag == true)
+            {
+                usage();
+            }
+            w_flag = true;
+
+            char *worker_end = NULL;
+            worker_count = strtol(optarg, &worker_end, 10);
+            if(worker_end == optarg || *worker_end != '\0' || worker_count < 1 || worker_count > MAX_WORKERS){
+                usage();
+            }
+            break;
         default:
             usage();
             break;
@@ -396,75 +578,8 @@ int main(int argc, char *argv[])
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
 
-    int socket_fd = setup_server(port);
-    if(socket_fd == -1){
-        fprintf(stderr, "[%s] Could not open open socket\n", prog_name);
-        exit(EXIT_FAILURE);
+    if (worker_count > 1){
+        exit(run_workers(port, index_filename, doc_dir, worker_count));
     }
-    char *buffer = NULL;
-    size_t buffer_cap = 0;
-
-    while(!quit){
-        FILE* connect_file = NULL;
-        int connection = open_next_connection(socket_fd, &connect_file);
-        if(connection == -1){
-            fprintf(stderr, "[%s] Error opening connection\n", prog_name);
-            continue;
-        }
-        // Signal occured. continue -> quit is 1 and exit the loop
-        if(connect_file == NULL){
-            continue;
-        }
-
-        // Read first line
-        if(getline(&buffer, &buffer_cap, connect_file) == -1){
-            fprintf(stderr, "[%s] Error getline failed (%s)\n", prog_name, strerror(errno));
-            fclose(connect_file);
-            continue;
-        }
-        
-        char full_path[strlen(doc_dir) + strlen(buffer) + strlen(index_filename)];
-        strcpy(full_path, "");
-        int status_code = parse_header(connect_file, buffer, &buffer_cap, index_filename, doc_dir, full_path);
-
-        // Read the rest after the header but as we dont need the information we just discard it.
-        while(getline(&buffer, &buffer_cap, connect_file) != -1){
-            if(strcmp(buffer, "\r\n") == 0){
-                break;
-            }
-        }
-        //fprintf(stderr, "FULL PATH=%s\n", full_path);
-
-        // Open the specified file which should be transmitted
-        FILE *input_file = fopen(full_path, "r");
-        if(status_code == 200){
-            if(input_file == NULL){
-                status_code = 404;
-                //fprintf(stderr, "[%s] Status code 404: File (%s) not found (%s)\n", prog_name, full_path, strerror(errno));
-            }
-        }
-        fprintf(stderr, "[%s] Status-code [%d], File-path (%s) \n", prog_name, status_code, full_path);
-
-        // Write the normal header and content if the status code is 200. Otherwise write the error header and no content
-        if(status_code == 200){
-            write_header(status_code, full_path, connect_file);
-            write_content(input_file, connect_file);
-            //write_content(input_file, stderr);
-        }
-        else{
-            write_error_header(status_code, connect_file);
-        }
-
-
-        // Free resources
-        if(input_file != NULL){
-            fclose(input_file);
-        }
-        fclose(connect_file);
-    }
-
-    // Free resources
-    free(buffer);
-    
-    exit(EXIT_SUCCESS);
+    exit(serve(port, index_filename, doc_dir, false));
 }
\ No newline at end of file
@@ -10,8 +10,12 @@
  * If the response value does not start with the Protocol specified by HTTP_PROTOCOL or this is not followed by a status-code,
  * the program terminates with exit-code 2.
  * Otherwise, if the response status is not 200 (HTTP-OK) the program terminates with exit-code 3.
- * The program synopsis is as follows: client [-l] [-p PORT] [ -o FILE | -d DIR ] URL
+ * The program synopsis is as follows: client [-l] [-p PORT] [-s SEGMENTS] [ -o FILE | -d DIR ] URL
  * The optional option -l indicates that additional log messages should be written to the target.
+ * The optional option -s splits the resource into up to SEGMENTS byte-ranges, which are fetched over as many concurrent
+ * connections and written at their offsets into the (preallocated) target. The length of the resource is probed with a
+ * one byte range first; if the server does not support ranges the resource is fetched in one piece.
+ * The option -s requires -o or -d and can not be combined with -l.
  * The optional option -p can be used to specify a port manually. If omitted the standard http-port 80 will be used.
  * The optional options -o or -d can be used to either specify a file the response body should be written to (will be created/overwritten),
  * or a directory in which a file matching the resources name will be created (if the resource is a directory the file is named index.html).
@@ -27,6 +31,10 @@
 #include <sys/socket.h>
 #include <netdb.h>
 #include <values.h>
+#include <pthread.h>
+#include <strings.h>
+#include <unistd.h>
+#include <fcntl.h>
 
 
 /** Macro to ensure adding a terminating NULL argument (sentinel) at the end of the argument list is not forgotten. */
@@ -46,8 +54,14 @@
 #define SOCKET_PROTOCOL        0
 #define SOCKET_CONNECTION_TYPE SOCK_STREAM
 
-#define HTTP_OK       200
-#define HTTP_PROTOCOL "HTTP/1.1"
+#define HTTP_OK              200
+#define HTTP_PARTIAL_CONTENT 206
+#define HTTP_PROTOCOL        "HTTP/1.1"
+
+#define MAX_SEGMENTS        16           // Upper bound of the -s option
+#define MIN_SEGMENT_SIZE    (256 * 1024) // Smaller resources are split into fewer segments
+#define SEGMENT_BUFFER_SIZE (64 * 1024)  // Bytes read from a connection before they are written with pwrite
+#define RANGE_VALUE_SIZE    64           // Enough for "bytes=<start>-<end>" with two 64 bit numbers
 
 #define ERROR_PROTOCOL_STATUS   2 // If changed update program description
 #define INVALID_RESPONSE_STATUS 3 // If changed update program description
@@ -61,7 +75,7 @@
 #define TRY_PTR(result, message) tryPtr(result, message, __LINE__)
 
 //region MESSAGES
-#define USAGE_ERROR_FORMAT "%s\nSYNOPSIS: %s [-p PORT] [-o FILE | -d DIR] URL\n"
+#define USAGE_ERROR_FORMAT "%s\nSYNOPSIS: %s [-l] [-p PORT] [-s SEGMENTS] [-o FILE | -d DIR] URL\n"
 
 #define ERROR_LOGGING                 "Writing to log failed"
 #define ERROR_CONNECT                 "Could not connect to the server"
@@ -74,6 +88,13 @@
 #define ERROR_RESPONSE_PROTOCOL       "Protocol error!"
 #define ERROR_OPEN_SERVER_STREAM      "Could not create stream to server"
 #define ERROR_INVALID_ARGUMENT_NUMBER "Invalid number of arguments"
+#define ERROR_INVALID_SEGMENTS        "SEGMENTS must be a number between 1 and 16"
+#define ERROR_SEGMENTS_TARGET         "-s requires -o or -d and can not be combined with -l"
+#define ERROR_PREALLOCATE             "Could not preallocate the target file"
+#define ERROR_WRITE_SEGMENT           "Could not write a segment to the target file"
+#define ERROR_READ_SEGMENT            "Could not read a segment from the server"
+#define ERROR_SEGMENT_RANGE           "Server responded with a different range than requested"
+#define ERROR_START_THREAD            "Could not start a segment thread"
 //endregion
 //endregion
 
@@ -99,7 +120,14 @@ typedef struct {
     char* programName;
     char* requestedResource;
     FILE* target;
+    long segments;
 } program_settings_t;
+
+/** A byte-range of the resource, fetched by one segment thread. */
+typedef struct {
+    long long start;
+    long long end; // inclusive
+} segment_t;
 //endregion
 
 //region GLOBAL VARIABLES
@@ -123,6 +151,12 @@ static inline void tryOpenConnection(FILE **serverStream_out);
 static inline void trySendRequest(FILE *serverStream, char *request);
 static inline void ensureValidResponse(char *response);
 
+static inline bool tryProbeLength(long long *length_out);
+static inline void tryDownloadSegments(long long length);
+static void *downloadSegment(void *segment);
+static inline void trySendRangeRequest(FILE *serverStream, long long start, long long end);
+static inline long tryReadResponseHeader(FILE *serverStream, segment_t *range_out, long long *total_out);
+
 static inline void try(int operationResult, const char *message, int line);
 static inline void tryPtr(void *operationResult, const char *message, int line);
 static inline void printErrnoAndTerminate(const char *additionalMessage, int line);
@@ -132,6 +166,7 @@ static inline bool endsWith(const char *string, char character);
 static inline void tryConcat(char **result_out, const char *str, ...);
 static inline void tryPrintLine(FILE *target, const char *stringPtr);
 static inline void tryReadStream(FILE *stream, char **result_out);
+static inline void tryWriteAt(int fd, const char *buffer, size_t length, long long offset);
 //endregion
 
 
@@ -153,6 +188,15 @@ int main(int argc, char *argv[])
     LOG("Port: %s\nFull url: %s\nHost: %s\nFilePath: %s",
         settings_g.port, settings_g.url, settings_g.host, settings_g.requestedResource);
 
+    long long length;
+    if (settings_g.segments > 1 && tryProbeLength(&length))
+    {
+        tryDownloadSegments(length);
+        free(settings_g.host);
+        fclose(settings_g.target);
+        return EXIT_SUCCESS;
+    }
+
     FILE *serverStream;
     tryOpenConnection(&serverStream);
 
@@ -279,7 +323,10 @@ static inline void tryParseArguments(int argc, char **argv)
     bool directorySpecified = false;
     char *directory;
 
-    while ((opt = getopt(argc, argv, "lp:o:d:")) != -1)
+    bool segmentsSpecified = false;
+    char *end;
+
+    while ((opt = getopt(argc, argv, "lp:s:o:d:")) != -1)
     {
         switch (opt)
         {
@@ -298,6 +345,16 @@ static inline void tryParseArguments(int argc, char **argv)
                 settings_g.port = optarg;
                 break;
 
+            case 's':
+                if (segmentsSpecified)
+                    printUsageErrorAndTerminate(ERROR_INVALID_ARGUMENT_NUMBER);
+
+                segmentsSpecified = true;
+                settings_g.segments = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || settings_g.segments < 1 || settings_g.segments > MAX_SEGMENTS)
+                    printUsageErrorAndTerminate(ERROR_INVALID_SEGMENTS);
+                break;
+
             case 'o':
                 if (fileSpecified || directorySpecified)
                     printUsageErrorAndTerminate(ERROR_INVALID_ARGUMENT_NUMBER);
@@ -325,6 +382,11 @@ static inline void tryParseArguments(int argc, char **argv)
     if (portSpecified == false)
         settings_g.port = DEFAULT_PORT;
 
+    if (segmentsSpecified == false)
+        settings_g.segments = 1;
+    else if (logEnabled_g || (!fileSpecified && !directorySpecified))
+        printUsageErrorAndTerminate(ERROR_SEGMENTS_TARGET); // Segments are written at their offsets into a file
+
     settings_g.url = argv[optind];
     if (strncmp(settings_g.url, URL_START, strlen(URL_START)) != 0)
         printUsageErrorAndTerminate(ERROR_INVALID_URL);
@@ -462,6 +524,184 @@ static inline void ensureValidResponse(char *response)
 }
 //endregion
 
+//region SEGMENTED DOWNLOAD
+/**
+ * @brief Probes the length of the resource by requesting its first byte and stores it in length_out.
+ * @details Returns false if the server does not answer with a single range (e.g. because it does not support ranges or
+ * the status is not success), in which case the resource should be fetched in one piece.
+ * Terminates the program with EXIT_FAILURE upon failure of any method.
+ *
+ * @param length_out A pointer to where the length of the resource should be saved.
+ * @return true if the length was probed, false otherwise.
+ */
+static inline bool tryProbeLength(long long *length_out)
+{
+    FILE *serverStream;
+    tryOpenConnection(&serverStream);
+    trySendRangeRequest(serverStream, 0, 0);
+
+    segment_t range;
+    long status = tryReadResponseHeader(serverStream, &range, length_out);
+    fclose(serverStream);
+
+    return status == HTTP_PARTIAL_CONTENT && range.start == 0 && *length_out >= 0;
+}
+
+/**
+ * @brief Downloads the resource in segments over concurrent connections into settings_g.target.
+ * @details The target is preallocated with the full length, so the segments can be written at their offsets in any
+ * order. Uses up to settings_g.segments segments, but none smaller than MIN_SEGMENT_SIZE.
+ * Terminates the program with EXIT_FAILURE upon failure of any segment.
+ *
+ * Global variables used: settings_g
+ *
+ * @param length The length of the resource.
+ */
+static inline void tryDownloadSegments(long long length)
+{
+    int fd = fileno(settings_g.target);
+    if (length > 0)
+    {
+        // Fall back to ftruncate on file systems that can't preallocate
+        errno = posix_fallocate(fd, 0, length);
+        if (errno != 0)
+            TRY(ftruncate(fd, length), ERROR_PREALLOCATE);
+    }
+
+    long count = settings_g.segments;
+    if (length / MIN_SEGMENT_SIZE < count)
+        count = length / MIN_SEGMENT_SIZE > 0 ? length / MIN_SEGMENT_SIZE : 1;
+
+    segment_t segments[count];
+    pthread_t threads[count];
+    for (long i = 0; i < count; i++)
+    {
+        segments[i].start = length * i / count;
+        segments[i].end = length * (i + 1) / count - 1;
+        if (segments[i].end < segments[i].start)
+            continue; // Nothing to fetch for an empty resource
+
+        errno = pthread_create(&threads[i], NULL, downloadSegment, &segments[i]);
+        if (errno != 0)
+            printErrnoAndTerminate(ERROR_START_THREAD, __LINE__);
+    }
+
+    for (long i = 0; i < count; i++)
+    {
+        if (segments[i].end >= segments[i].start)
+            pthread_join(threads[i], NULL);
+    }
+}
+
+/**
+ * @brief Fetches one segment over its own connection and writes it at its offset into settings_g.target.
+ * @details This is the start routine of the segment threads. Terminates the program with EXIT_FAILURE upon failure,
+ * or if the server answers with a different range.
+ *
+ * Global variables used: settings_g
+ *
+ * @param segment The segment_t to fetch.
+ * @return Always NULL.
+ */
+static void *downloadSegment(void *segment)
+{
+    segment_t *requested = segment;
+
+    FILE *serverStream;
+    tryOpenConnection(&serverStream);
+    trySendRangeRequest(serverStream, requested->start, requested->end);
+
+    segment_t range;
+    long long total;
+    if (tryReadResponseHeader(serverStream, &range, &total) != HTTP_PARTIAL_CONTENT ||
+        range.start != requested->start || range.end != requested->end)
+        printErrnoAndTerminate(ERROR_SEGMENT_RANGE, __LINE__);
+
+    int fd = fileno(settings_g.target);
+    char buffer[SEGMENT_BUFFER_SIZE];
+    long long offset = range.start;
+    while (offset <= range.end)
+    {
+        long long left = range.end - offset + 1;
+        size_t read = fread(buffer, 1, left < SEGMENT_BUFFER_SIZE ? left : SEGMENT_BUFFER_SIZE, serverStream);
+        if (read == 0)
+            printErrnoAndTerminate(ERROR_READ_SEGMENT, __LINE__);
+
+        tryWriteAt(fd, buffer, read, offset);
+        offset += read;
+    }
+
+    fclose(serverStream); // Also closes socket fd
+    return NULL;
+}
+
+/**
+ * @brief Tries to send a GET-Request for the byte-range from start to end (inclusive) of the requested resource.
+ * Terminates the program with EXIT_FAILURE upon failure.
+ * @details Global variables used: settings_g
+ *
+ * @param serverStream A stream to the server the request should be written to.
+ * @param start        The first byte of the range.
+ * @param end          The last byte of the range.
+ */
+static inline void trySendRangeRequest(FILE *serverStream, long long start, long long end)
+{
+    char range[RANGE_VALUE_SIZE];
+    snprintf(range, sizeof(range), "bytes=%lld-%lld", start, end);
+
+    char *request; // Must be an allocated string with 0 termination
+    TRY_PTR(request = calloc(1, 1), "calloc failed");
+
+    tryCreateGetRequest(settings_g.requestedResource, HTTP_PROTOCOL, &request);
+    tryAddRequestHeader("Host", settings_g.host, false, &request);
+    tryAddRequestHeader("Range", range, false, &request);
+    tryAddRequestHeader("Connection", "close", true, &request);
+
+    trySendRequest(serverStream, request);
+    free(request);
+}
+
+/**
+ * @brief Reads the header of a response up to the empty line and returns its status.
+ * @details The body can be read from serverStream afterwards. If the header contains a Content-Range, its range and
+ * complete length are stored in range_out and total_out; otherwise total_out is set to -1.
+ * Terminates the program with ERROR_PROTOCOL_STATUS if the response does not start with HTTP_PROTOCOL followed by a
+ * status code and with EXIT_FAILURE upon failure of any method.
+ *
+ * @param serverStream The stream to read the response from.
+ * @param range_out    A pointer to where the range of the body should be saved.
+ * @param total_out    A pointer to where the complete length of the resource should be saved.
+ * @return The status of the response.
+ */
+static inline long tryReadResponseHeader(FILE *serverStream, segment_t *range_out, long long *total_out)
+{
+    char *line = NULL;
+    size_t capacity = 0;
+    *total_out = -1;
+
+    if (getline(&line, &capacity, serverStream) == -1 ||
+        strncmp(line, HTTP_PROTOCOL, strlen(HTTP_PROTOCOL)) != 0)
+        terminateWithProtocolError();
+
+    char *nextChar;
+    char *statusStart = line + strlen(HTTP_PROTOCOL) + 1;
+    long status = strtol(statusStart, &nextChar, 10);
+    if (nextChar == statusStart || *nextChar != ' ' || status == LONG_MIN || status == LONG_MAX)
+        terminateWithProtocolError();
+
+    while (getline(&line, &capacity, serverStream) != -1 && strcmp(line, "\r\n") != 0)
+    {
+        if (strncasecmp(line, "Content-Range:", strlen("Content-Range:")) == 0 &&
+            sscanf(line + strlen("Content-Range:"), " bytes %lld-%lld/%lld",
+                   &range_out->start, &range_out->end, total_out) != 3)
+            *total_out = -1;
+    }
+
+    free(line);
+    return status;
+}
+//endregion
+
 //region UTILITY
 //region HTTP
 /**
@@ -523,6 +763,27 @@ static inline void tryReadStream(FILE *stream, char **result_out)
     (*result_out)[i] = '\0';
 }
 
+/**
+ * @brief Writes length bytes of buffer at offset into the file fd, using pwrite until everything is written.
+ * @details Terminates with EXIT_FAILURE by calling printErrnoAndTerminate if pwrite fails.
+ *
+ * @param fd     The file to write to.
+ * @param buffer The bytes to write.
+ * @param length The number of bytes to write.
+ * @param offset The offset in the file to write the bytes at.
+ */
+static inline void tryWriteAt(int fd, const char *buffer, size_t length, long long offset)
+{
+    while (length > 0)
+    {
+        ssize_t written;
+        TRY(written = pwrite(fd, buffer, length, offset), ERROR_WRITE_SEGMENT);
+        buffer += written;
+        length -= written;
+        offset += written;
+    }
+}
+
 /**
  * @brief Prints the string pointed to by stringPtr to the specified target using fputc
  * until one of the following characters is encountered: '\r', '\n' or '\0'.
@@ -11,8 +11,13 @@
  * the server responds with 400 Bad Request. If the request-method is not GET, 501 Not Implemented is returned.
  * Otherwise, a header indicating success (200 OK) and the content of the requested file are returned
  * if the file can be opened by the server and 404 Not found if the server can't open it.
- * The program synopsis is as follows: server [-l] [-p PORT] [-i INDEX] DOC_ROOT
+ * Connections are kept alive until the client sends 'Connection: close', KEEP_ALIVE_TIMEOUT seconds pass without a new
+ * request or KEEP_ALIVE_MAX requests were answered. Pipelined requests are answered in the order they were received.
+ * The program synopsis is as follows: server [-l] [-p PORT] [-i INDEX] [-w WORKERS] [-b BACKLOG] DOC_ROOT
  * The optional option -l indicates that additional log messages should be written to stdout.
+ * The optional option -b sets the length of the queue of pending connections. If omitted DEFAULT_BACKLOG is used.
+ * The optional option -w starts WORKERS pre-forked worker processes, each with its own SO_REUSEPORT socket, which are
+ * supervised and restarted if they crash. If omitted DEFAULT_WORKERS is used.
  * The optional option -p can be used to specify a port manually. If omitted DEFAULT_PORT will be used.
  * The optional option -i can be used to specify the default filename in case the client requests a directory path.
  * If omitted the default filename for this case is as specified in DEFAULT_INDEX.
@@ -32,6 +37,11 @@
 #include <netdb.h>
 #include <time.h>
 #include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <strings.h>
+#include <limits.h>
+#include <sys/time.h>
 
 
 /** Macro to ensure adding a terminating NULL argument (sentinel) at the end of the argument list is not forgotten. */
@@ -41,13 +51,18 @@
 #define MAX_RFC822_STRING 28 // aaa, dd bbb yy hh:mm:ss GMT\0
 
 //region OPTIONS
-#define CONNECTION_MODE    "r+"
+#define CONNECTION_READ_MODE  "r"
+#define CONNECTION_WRITE_MODE "w"
 #define TARGET_FILE_OPTION "r"
 
 #define DEFAULT_PORT  "8080"
 #define DEFAULT_INDEX "index.html"
+#define DEFAULT_WORKERS 1
+#define MAX_WORKERS     1024
 
-#define BACKLOG                1
+#define DEFAULT_BACKLOG        SOMAXCONN
+#define KEEP_ALIVE_TIMEOUT     5   // seconds a connection may stay idle between requests
+#define KEEP_ALIVE_MAX         100 // requests answered over one connection before it is closed
 #define SOCKET_DOMAIN          AF_INET
 #define ADDR_INFO_FLAGS        AI_PASSIVE
 #define SOCKET_PROTOCOL        0
@@ -56,6 +71,7 @@
 #define SOCKET_OPTION_LVL   SOL_SOCKET
 #define SOCKET_OPTION_NAME  SO_REUSEADDR
 #define SOCKET_OPTION_VALUE 1
+#define SOCKET_OPTION_NAME_WORKERS SO_REUSEPORT
 
 #define HTTP_GET      "GET"
 #define HTTP_PROTOCOL "HTTP/1.1"
@@ -69,7 +85,7 @@
 #define TRY_PTR(result, message) tryPtr(result, message, __LINE__)
 
 //region MESSAGES
-#define USAGE_ERROR_FORMAT "%s\nSYNOPSIS: %s [-p PORT] [-i INDEX] DOC_ROOT\n"
+#define USAGE_ERROR_FORMAT "%s\nSYNOPSIS: %s [-l] [-p PORT] [-i INDEX] [-w WORKERS] [-b BACKLOG] DOC_ROOT\n"
 
 #define ERROR_BIND                    "Could not bind to the socket"
 #define ERROR_CONNECT                 "Could not connect to the client"
@@ -79,6 +95,10 @@
 #define ERROR_SEND_RESPONSE           "Could not send response"
 #define ERROR_SOCKET_CREATION         "Creating socket file descriptor failed"
 #define ERROR_UNKNOWN_ARGUMENT        "Unknown argument"
+#define ERROR_INVALID_WORKERS         "WORKERS must be a number between 1 and 1024"
+#define ERROR_INVALID_BACKLOG         "BACKLOG must be a positive number"
+#define ERROR_FORK                    "Could not fork a worker"
+#define ERROR_WORKER_START            "A worker failed to start"
 #define ERROR_DETERMINING_FILESIZE    "Could not determine the size of requested file"
 #define ERROR_INVALID_ARGUMENT_NUMBER "Invalid number of arguments"
 //endregion
@@ -104,6 +124,8 @@ typedef struct {
     char* root;
     char* index;
     char* programName;
+    long workers;
+    long backlog;
 } program_settings_t;
 //endregion
 
@@ -123,13 +145,19 @@ static inline void tryParseArguments(int argc, char **argv);
 static inline void initializeSignalHandler(int signal, void (*handler)(int), struct sigaction *sa_out);
 
 static inline void tryStartListening(int *socketFd_out);
+static inline void tryServeRequests(void);
+static inline void tryServeConnection(int connectionFd);
+static inline pid_t tryStartWorker(void);
+static inline int superviseWorkers(void);
 static inline void trySend(FILE *connection, char *data);
-static inline void trySendEmptyResponse(FILE *connection, char *statusCode, char *statusDesc);
+static inline void trySendBytes(FILE *connection, char *data, size_t length);
+static inline void trySendEmptyResponse(FILE *connection, char *statusCode, char *statusDesc, bool keepAlive);
 static inline char *tryProcessRequest(char *request, FILE *connection);
-static inline void trySendFile(FILE *connection, char *requestedFilePath);
+static inline void trySendFile(FILE *connection, char *requestedFilePath, bool keepAlive);
+static inline void tryAddConnectionHeader(bool keepAlive, char **response_out);
 
 static inline void tryCreateResponseHeader(char *protocol, char *statusCode, char *statusDesc, char **response_out);
-static inline void tryAddResponseHeader(char *header, char *value, bool last, char **response_out);
+static inline void tryAddResponseHeader(char *header, const char *value, bool last, char **response_out);
 
 static inline void try(int operationResult, const char *message, int line);
 static inline void tryPtr(void *operationResult, const char *message, int line);
@@ -138,9 +166,10 @@ static inline void printErrnoAndTerminate(const char *additionalMessage, int lin
 static inline bool endsWith(const char *string, char character);
 static inline void tryConcat(char **result_out, const char *str, ...);
 static inline void tryGetSize(FILE *file, char (*size_out)[MAX_LONG_STRING]);
-static inline void tryReadFile(FILE *file, char **content_out);
+static inline void tryReadFile(FILE *file, char **content_out, size_t *length_out);
 static inline void tryReadRequest(FILE *connection, char **request_out);
-static inline void getDateInRFC822(char (*date_out)[MAX_RFC822_STRING]);
+static inline bool requestsClose(const char *request);
+static inline const char *getDateInRFC822(void);
 //endregion
 
 
@@ -174,34 +203,186 @@ int main(int argc, char *argv[])
     initializeSignalHandler(SIGINT, initiateTermination, &sigInt);
     initializeSignalHandler(SIGTERM, initiateTermination, &sigTerm);
 
+    // A client closing a kept-alive connection early must not kill the server
+    struct sigaction sigPipe;
+    initializeSignalHandler(SIGPIPE, SIG_IGN, &sigPipe);
+
     tryParseArguments(argc, argv);
 
+    if (settings_g.workers > 1)
+        return superviseWorkers();
+
+    tryServeRequests();
+    return EXIT_SUCCESS;
+}
+
+
+/**
+ * @brief Listens on the socket and answers requests until shutdown is initiated.
+ * @details A request that is already being answered when the shutdown is initiated is still finished.
+ *
+ * global variables used: shutdownInitiated_g - to determine when to stop serving
+ */
+static inline void tryServeRequests(void)
+{
     int socketFd;
     tryStartListening(&socketFd);
 
     while(!shutdownInitiated_g)
     {
         int connectionFd;
-        TRY(connectionFd = accept(socketFd, NULL, NULL), ERROR_CONNECT);
+        if ((connectionFd = accept(socketFd, NULL, NULL)) < 0 && errno == EINTR)
+            continue;
+        TRY(connectionFd, ERROR_CONNECT);
 
-        FILE *connection;
-        TRY_PTR(connection = fdopen(connectionFd, CONNECTION_MODE), ERROR_CONNECT);
+        tryServeConnection(connectionFd);
+    }
 
+    close(socketFd);
+}
+
+/**
+ * @brief Answers the requests of one client until the connection should be closed.
+ * @details The connection is read and written through two separate streams, so that pipelined requests already
+ * buffered by the reading stream are not lost when a response is written. Requests are answered one after the other
+ * in the order they arrived. The connection is closed if the client requests it, if it stays idle for
+ * KEEP_ALIVE_TIMEOUT seconds, after KEEP_ALIVE_MAX requests, after a malformed or unsupported request or once shutdown
+ * is initiated. The last response carries 'Connection: close'.
+ * Terminates the program with EXIT_FAILURE upon failure of any called method.
+ *
+ * global variables used: shutdownInitiated_g - to stop keeping the connection alive
+ *
+ * @param connectionFd The file descriptor of the accepted connection.
+ */
+static inline void tryServeConnection(int connectionFd)
+{
+    struct timeval timeout = {.tv_sec = KEEP_ALIVE_TIMEOUT, .tv_usec = 0};
+    TRY(setsockopt(connectionFd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof timeout), ERROR_CONNECT);
+
+    FILE *connectionIn;
+    FILE *connectionOut;
+    TRY_PTR(connectionIn = fdopen(connectionFd, CONNECTION_READ_MODE), ERROR_CONNECT);
+    int writeFd;
+    TRY(writeFd = dup(connectionFd), ERROR_CONNECT);
+    TRY_PTR(connectionOut = fdopen(writeFd, CONNECTION_WRITE_MODE), ERROR_CONNECT);
+
+    bool keepAlive = true;
+    for (int served = 0; keepAlive && !shutdownInitiated_g; served++)
+    {
         char *request;
         TRY_PTR(request = calloc(1, 1), "calloc failed");
-        tryReadRequest(connection, &request);
+        tryReadRequest(connectionIn, &request);
+
+        // EOF, idle timeout or a signal before a new request arrived
+        if (request[0] == '\0')
+        {
+            free(request);
+            break;
+        }
 
         LOG("Request:\n%s", request);
 
-        char *requestedFilePath = tryProcessRequest(request, connection);
+        keepAlive = served + 1 < KEEP_ALIVE_MAX && !requestsClose(request) && !shutdownInitiated_g;
+
+        char *requestedFilePath = tryProcessRequest(request, connectionOut);
         if (requestedFilePath != NULL)
-            trySendFile(connection, requestedFilePath);
+            trySendFile(connectionOut, requestedFilePath, keepAlive);
+        else
+            keepAlive = false;
 
         free(request);
-        fclose(connection);
     }
 
-    return EXIT_SUCCESS;
+    fclose(connectionOut);
+    fclose(connectionIn);
+}
+
+/**
+ * @brief Forks a worker process which serves requests until it receives SIGTERM.
+ * @details Terminates the program with EXIT_FAILURE if forking fails.
+ *
+ * @return The pid of the worker.
+ */
+static inline pid_t tryStartWorker(void)
+{
+    pid_t pid;
+    TRY(pid = fork(), ERROR_FORK);
+
+    if (pid == 0)
+    {
+        tryServeRequests();
+        exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+/**
+ * @brief Pre-forks settings_g.workers workers and restarts them if they exit while the server is running.
+ * @details Every worker binds its own socket with SO_REUSEPORT, so the kernel balances the connections between them.
+ * If a worker fails with EXIT_FAILURE within a second of being started it can't start at all (e.g. the port is in
+ * use), so all workers are stopped instead of restarting it over and over.
+ * Once shutdown is initiated SIGTERM is forwarded to all workers and the function waits until they finished their
+ * current requests.
+ *
+ * global variables used: settings_g - for the number of workers
+ *                        shutdownInitiated_g - to determine when to stop the workers
+ *
+ * @return EXIT_SUCCESS upon a regular shutdown, EXIT_FAILURE if a worker failed to start.
+ */
+static inline int superviseWorkers(void)
+{
+    pid_t workers[settings_g.workers];
+    time_t startTimes[settings_g.workers];
+    int exitCode = EXIT_SUCCESS;
+
+    for (long i = 0; i < settings_g.workers; i++)
+    {
+        workers[i] = tryStartWorker();
+        startTimes[i] = time(NULL);
+    }
+
+    while (!shutdownInitiated_g)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (long i = 0; i < settings_g.workers; i++)
+        {
+            if (workers[i] != pid)
+                continue;
+
+            workers[i] = -1;
+            if (shutdownInitiated_g)
+                break;
+
+            if (WIFEXITED(status) && WEXITSTATUS(status) == EXIT_FAILURE && time(NULL) - startTimes[i] < 1)
+            {
+                fprintf(stderr, "%s: %s\n", settings_g.programName, ERROR_WORKER_START);
+                shutdownInitiated_g = true;
+                exitCode = EXIT_FAILURE;
+                break;
+            }
+
+            LOG("Worker %d exited, restarting it\n", pid);
+            workers[i] = tryStartWorker();
+            startTimes[i] = time(NULL);
+        }
+    }
+
+    for (long i = 0; i < settings_g.workers; i++)
+    {
+        if (workers[i] > 0)
+            kill(workers[i], SIGTERM);
+    }
+    while (wait(NULL) >= 0 || errno == EINTR);
+
+    return exitCode;
 }
 
 
@@ -292,8 +473,10 @@ static inline void tryParseArguments(int argc, char **argv)
     int opt;
     bool portSpecified = false;
     bool indexSpecified = false;
+    bool workersSpecified = false;
+    bool backlogSpecified = false;
 
-    while ((opt = getopt(argc, argv, "lp:i:")) != -1)
+    while ((opt = getopt(argc, argv, "lp:i:w:b:")) != -1)
     {
         switch (opt)
         {
@@ -320,6 +503,28 @@ static inline void tryParseArguments(int argc, char **argv)
                 settings_g.index = optarg;
                 break;
 
+            case 'w':
+                if (workersSpecified)
+                    printUsageErrorAndTerminate(ERROR_INVALID_ARGUMENT_NUMBER);
+
+                workersSpecified = true;
+                char *end;
+                settings_g.workers = strtol(optarg, &end, 10);
+                if (end == optarg || *end != '\0' || settings_g.workers < 1 || settings_g.workers > MAX_WORKERS)
+                    printUsageErrorAndTerminate(ERROR_INVALID_WORKERS);
+                break;
+
+            case 'b':
+                if (backlogSpecified)
+                    printUsageErrorAndTerminate(ERROR_INVALID_ARGUMENT_NUMBER);
+
+                backlogSpecified = true;
+                char *backlogEnd;
+                settings_g.backlog = strtol(optarg, &backlogEnd, 10);
+                if (backlogEnd == optarg || *backlogEnd != '\0' || settings_g.backlog < 1 || settings_g.backlog > INT_MAX)
+                    printUsageErrorAndTerminate(ERROR_INVALID_BACKLOG);
+                break;
+
             default:
                 printUsageErrorAndTerminate(ERROR_UNKNOWN_ARGUMENT);
         }
@@ -334,6 +539,12 @@ static inline void tryParseArguments(int argc, char **argv)
     if (indexSpecified == false)
         settings_g.index = DEFAULT_INDEX;
 
+    if (workersSpecified == false)
+        settings_g.workers = DEFAULT_WORKERS;
+
+    if (backlogSpecified == false)
+        settings_g.backlog = DEFAULT_BACKLOG;
+
     settings_g.root = argv[optind];
 }
 //endregion
@@ -342,6 +553,7 @@ static inline void tryParseArguments(int argc, char **argv)
 /**
  * @brief Tries to create & bind a socket and then starts listening for incoming requests.
  * @details Terminates the program with EXIT_FAILURE upon failure of any called method.
+ * If more than one worker is used the socket is created with SO_REUSEPORT, so every worker can bind its own socket.
  *
  * Global variables used: settings_g
  *
@@ -369,9 +581,13 @@ static inline void tryStartListening(int *socketFd_out)
 
     int optionValue = SOCKET_OPTION_VALUE;
     setsockopt(*socketFd_out, SOCKET_OPTION_LVL, SOCKET_OPTION_NAME, &optionValue, sizeof optionValue);
+    if (settings_g.workers > 1)
+        TRY(setsockopt(*socketFd_out, SOCKET_OPTION_LVL, SOCKET_OPTION_NAME_WORKERS, &optionValue, sizeof optionValue),
+            ERROR_SOCKET_CREATION);
 
     TRY(bind(*socketFd_out, addressInfo->ai_addr, addressInfo->ai_addrlen), ERROR_BIND);
-    TRY(listen(*socketFd_out, BACKLOG), ERROR_LISTENING);
+    TRY(listen(*socketFd_out, settings_g.backlog), ERROR_LISTENING);
+    freeaddrinfo(addressInfo);
 }
 
 /**
@@ -388,21 +604,40 @@ static inline void trySend(FILE *connection, char *data)
     TRY(fflush(connection), ERROR_SEND_RESPONSE);
 }
 
+/**
+ * @brief Tries to write length bytes of data to the specified connection. Terminates the program with EXIT_FAILURE
+ * upon failure.
+ * @details Unlike trySend the data may contain '\0' bytes. Calls fflush on the connection after writing the data.
+ *
+ * @param connection A stream the data should be written to.
+ * @param data       The data to write.
+ * @param length     The number of bytes to write.
+ */
+static inline void trySendBytes(FILE *connection, char *data, size_t length)
+{
+    if (fwrite(data, 1, length, connection) != length)
+        printErrnoAndTerminate(ERROR_SEND_RESPONSE, __LINE__);
+    TRY(fflush(connection), ERROR_SEND_RESPONSE);
+}
+
 /**
  * @brief Creates a response header with the specified status-code, status description and the protocol version as specified in HTTP_PROTOCOL,
- * adds the Header 'Connection: close' and writes the headers to the specified connection.
+ * adds the Connection header and writes the headers to the specified connection.
  * @details Terminates the program with EXIT_FAILURE upon failure of any called method.
  *
  * @param connection The connection to a client to write the headers to.
  * @param statusCode The status-code to set.
  * @param statusDesc THe status-description to set.
+ * @param keepAlive  Whether the connection stays open after this response.
  */
-static inline void trySendEmptyResponse(FILE *connection, char *statusCode, char *statusDesc) {
+static inline void trySendEmptyResponse(FILE *connection, char *statusCode, char *statusDesc, bool keepAlive) {
     char *response;
     TRY_PTR(response = calloc(1, 1), "calloc failed");
 
     tryCreateResponseHeader(HTTP_PROTOCOL, statusCode, statusDesc, &response);
-    tryAddResponseHeader("Connection", "close", true, &response);
+    if (keepAlive)
+        TRY_CONCAT(&response, "Content-Length: 0\r\n");
+    tryAddConnectionHeader(keepAlive, &response);
     trySend(connection, response);
 
     free(response);
@@ -430,10 +665,10 @@ static inline char *tryProcessRequest(char *request, FILE *connection)
     if (requestMethod == NULL || filePath == NULL || protocol == NULL ||
         strcmp(protocol, HTTP_PROTOCOL) != 0 || request[0] != '\n')
     {
-        trySendEmptyResponse(connection, "400", "Bad Request");
+        trySendEmptyResponse(connection, "400", "Bad Request", false);
     }
     else if (strcmp(requestMethod, HTTP_GET) != 0) {
-        trySendEmptyResponse(connection, "501", "Not implemented");
+        trySendEmptyResponse(connection, "501", "Not implemented", false);
     }
     else
         return filePath;
@@ -472,8 +707,9 @@ static inline void tryGetMimeType(char* fileName, char **type_out)
  *
  * @param connection        The stream to write the response to.
  * @param requestedFilePath The path of the requested resource relative to settings_g.root.
+ * @param keepAlive         Whether the connection stays open after this response.
  */
-static inline void trySendFile(FILE *connection, char *requestedFilePath)
+static inline void trySendFile(FILE *connection, char *requestedFilePath, bool keepAlive)
 {
     LOG("Requested file-path: %s\n", requestedFilePath);
 
@@ -485,16 +721,14 @@ static inline void trySendFile(FILE *connection, char *requestedFilePath)
 
     FILE *requestedFile;
     if ((requestedFile = fopen(filePath, TARGET_FILE_OPTION)) == NULL)
-        trySendEmptyResponse(connection, "404", "Not Found");
+        trySendEmptyResponse(connection, "404", "Not Found", keepAlive);
     else
     {
         char *response;
         TRY_PTR(response = calloc(1, 1), "calloc failed");
         tryCreateResponseHeader(HTTP_PROTOCOL, "200", "OK", &response);
 
-        char date[MAX_RFC822_STRING];
-        getDateInRFC822(&date);
-        tryAddResponseHeader("Date", date, false, &response);
+        tryAddResponseHeader("Date", getDateInRFC822(), false, &response);
 
         char fileSizeStr[MAX_LONG_STRING];
         tryGetSize(requestedFile, &fileSizeStr);
@@ -506,16 +740,17 @@ static inline void trySendFile(FILE *connection, char *requestedFilePath)
         if (strcmp(mimeType, "") != 0)
             tryAddResponseHeader("Content-Type", mimeType, false, &response);
 
-        tryAddResponseHeader("Connection", "close", true, &response);
+        tryAddConnectionHeader(keepAlive, &response);
         LOG("Response-Header:\n%s", response);
         trySend(connection, response);
         free(response);
 
         char *fileContent;
+        size_t fileLength;
         TRY_PTR(fileContent = malloc(1), "malloc failed");
-        tryReadFile(requestedFile, &fileContent);
+        tryReadFile(requestedFile, &fileContent, &fileLength);
         LOG("Response-Body:\n%s\n\n", fileContent);
-        trySend(connection, fileContent);
+        trySendBytes(connection, fileContent, fileLength);
 
         free(mimeType);
         free(fileContent);
@@ -528,18 +763,28 @@ static inline void trySendFile(FILE *connection, char *requestedFilePath)
 
 //region UTILITY
 /**
- * @brief Writes the current UTC time in RFC822 format to the array pointed to by date_out.
- * @param date_out A pointer to an array in which the result is to be stored.
+ * @brief Returns the current UTC time in RFC822 format.
+ * @details The result is kept in a static buffer that is only formatted again once the second changed,
+ * so answering many requests per second does not call gmtime & strftime for each of them.
+ *
+ * @return A pointer to the formatted date. Valid until the next call, must not be freed.
  */
-static inline void getDateInRFC822(char (*date_out)[MAX_RFC822_STRING])
+static inline const char *getDateInRFC822(void)
 {
-    time_t localTime;
-    struct tm *utcTimePtr;
+    static char date[MAX_RFC822_STRING];
+    static time_t formattedTime = (time_t) -1;
 
+    time_t localTime;
     time(&localTime);
-    utcTimePtr = gmtime(&localTime);
 
-    strftime(*date_out, MAX_RFC822_STRING, "%a, %d %b %y %H:%M:%S %Z", utcTimePtr);
+    if (localTime != formattedTime)
+    {
+        struct tm utcTime;
+        gmtime_r(&localTime, &utcTime);
+        strftime(date, MAX_RFC822_STRING, "%a, %d %b %y %H:%M:%S %Z", &utcTime);
+        formattedTime = localTime;
+    }
+    return date;
 }
 
 //region HTTP
@@ -566,9 +811,29 @@ static inline void tryCreateResponseHeader(char *protocol, char *statusCode, cha
  * @param last         Indicates if this header finishes the header-section.
  * @param response_out A pointer to where the result should be stored. Must be an allocated, 0 initialized address-space.
  */
-static inline void tryAddResponseHeader(char *header, char *value, bool last, char **response_out) {
+static inline void tryAddResponseHeader(char *header, const char *value, bool last, char **response_out) {
     TRY_CONCAT(response_out, header, ": ", value, "\r\n", last ? "\r\n" : "");
 }
+
+/**
+ * @brief Adds the Connection header (and the Keep-Alive header if the connection stays open) as the last header.
+ * @details Terminates the program with EXIT_FAILURE if concatenating fails.
+ *
+ * @param keepAlive    Whether the connection stays open after the response.
+ * @param response_out A pointer to where the result should be stored. Must be an allocated, 0 initialized address-space.
+ */
+static inline void tryAddConnectionHeader(bool keepAlive, char **response_out) {
+    if (!keepAlive)
+    {
+        tryAddResponseHeader("Connection", "close", true, response_out);
+        return;
+    }
+
+    char keepAliveValue[sizeof "timeout=, max=" + 2 * MAX_LONG_STRING];
+    snprintf(keepAliveValue, sizeof keepAliveValue, "timeout=%d, max=%d", KEEP_ALIVE_TIMEOUT, KEEP_ALIVE_MAX);
+    tryAddResponseHeader("Connection", "keep-alive", false, response_out);
+    tryAddResponseHeader("Keep-Alive", keepAliveValue, true, response_out);
+}
 //endregion
 
 //region STREAMS
@@ -590,21 +855,30 @@ static inline void tryGetSize(FILE *file, char (*size_out)[MAX_LONG_STRING])
 /**
  * @brief Reads from the specified file until EOF or is read and stores the result in content_out.
  * @details content_out must be a pointer to an allocated address-space. Will be reallocated.
+ * The content is '\0' terminated, but as binary files may contain '\0' bytes the length is stored in length_out.
  * If reallocating content_out fails, the program calls printErrnoAndTerminate
  * and thereby terminates the program with EXIT_FAILURE.
  *
  * @param file        The file to read.
  * @param content_out A pointer to where the read data should be stored. Must be an allocated address-space.
+ * @param length_out  A pointer to where the number of read bytes should be stored.
  */
-static inline void tryReadFile(FILE *file, char **content_out)
+static inline void tryReadFile(FILE *file, char **content_out, size_t *length_out)
 {
-    int i = 0;
-    for (int character; (character = fgetc(file)) != EOF; i++)
+    size_t length = 0;
+    size_t capacity = 0;
+    do
     {
-        TRY_PTR(*content_out = realloc(*content_out, i + 2), "realloc failed.");
-        (*content_out)[i] = (char) character;
-    }
-    (*content_out)[i] = '\0';
+        if (length == capacity)
+        {
+            capacity = capacity == 0 ? BUFSIZ : capacity * 2;
+            TRY_PTR(*content_out = realloc(*content_out, capacity + 1), "realloc failed.");
+        }
+        length += fread(*content_out + length, 1, capacity - length, file);
+    } while (!feof(file) && !ferror(file));
+
+    (*content_out)[length] = '\0';
+    *length_out = length;
 }
 
 /**
@@ -632,6 +906,28 @@ static inline void tryReadRequest(FILE *connection, char **request_out)
 //endregion
 
 //region STRINGS
+/**
+ * @brief Determines whether the headers of the given request contain 'Connection: close'.
+ * @details Header names and values are compared case-insensitively.
+ *
+ * @param request The complete request-header-section.
+ * @return true (1) if the client asks to close the connection, false (0) otherwise.
+ */
+static inline bool requestsClose(const char *request) {
+    for (const char *line = strstr(request, "\r\n"); line != NULL; line = strstr(line, "\r\n"))
+    {
+        line += strlen("\r\n");
+        if (strncasecmp(line, "Connection:", strlen("Connection:")) != 0)
+            continue;
+
+        const char *value = line + strlen("Connection:");
+        value += strspn(value, " \t");
+        if (strncasecmp(value, "close", strlen("close")) == 0)
+            return true;
+    }
+    return false;
+}
+
 /**
  * @brief Determines whether a given string ends with a given character or not.
  *
@@ -13,7 +13,7 @@
  * If neither o nor d is sepcified, the received content is written to stdout.
  * Along with the mentioned options, the program needs a given URL, where the HTTP-GET request should be performed.
  * Headers supported by the client:
- * Accept-Encoding: gzip -> indicates the Client understands gzip encoding
+ * Accept-Encoding: br, zstd, gzip -> indicates the Client understands these encodings (those compiled in)
  * Connection: close -> Connection should be closed after transmitting
  **/
 #include "client.h"
@@ -37,10 +37,10 @@ static int setup_socket(char *host, char *port, int *sockfd);
  *          If the server can encode, the file is decoded by the client (@see gziputil.h), otherwise plain data is read.
  * @param out File to which should be written (specified by options or stdout)
  * @param sockfile file which is associated with the sockets file-descriptor
- * @param encoded true, if the server sends encoded content, otherwise false.
+ * @param encoding the encoding of the content the server sends, ENCODING_IDENTITY if it is plain.
  * @return 0 on success, -1 on failure.
  **/
-static int read_response_write(FILE *out, FILE *sockfile, bool encoded);
+static int read_response_write(FILE *out, FILE *sockfile, enum encoding encoding);
 
 /**
  * @brief cleanup function to cleanup resources.
@@ -208,7 +208,8 @@ int main(int argc, char *argv[])
     }
     else
     {
-        if (fprintf(sockfile, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nAccept-Encoding: gzip\r\n\r\n", path, host) < 0)
+        if (fprintf(sockfile, "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: close\r\nAccept-Encoding: %s\r\n\r\n", path, host,
+                    encoding_accept_header()) < 0)
         {
             cleanup(path, host, d_path, sockfile, out);
             error("fprintf failed while writing to socket!", strerror(errno), PROGRAM_NAME);
@@ -241,27 +242,33 @@ int main(int argc, char *argv[])
         }
     }
 
-    bool encoded = false;
+    enum encoding encoding = ENCODING_IDENTITY;
     
     // skipping header
     while ((nread = getline(&line, &len, sockfile)) != -1 && (strcmp(line, "\r\n") != 0))
     {
-        if (strncmp(line, "Content-Encoding", 16) == 0) // server sent he can encode
+        if (strncmp(line, "Content-Encoding:", 17) == 0) // server encoded the content
         {
-            if (strstr(line, "gzip") != NULL) // server can encode in gzip
-                encoded = true;
+            encoding = encoding_from_name(line + 17, strcspn(line + 17, "\r\n"));
         }
     }
     // this is needed, because we don't have to implement Transfer-Encoding, and therefore it should only
     // encode files, if we connect to the lab-host!
     if (strcmp(host, "pan.vmars.tuwien.ac.at") != 0)
     {
-        encoded = false;
+        encoding = ENCODING_IDENTITY;
+    }
+    if (encoding == ENCODING_COUNT) // not one we asked for
+    {
+        free(line);
+        cleanup(path, host, d_path, sockfile, out);
+        fprintf(stderr, "Unsupported content encoding!");
+        exit(1);
     }
 
     free(line);
 
-    if (read_response_write(out, sockfile, encoded) < 0)
+    if (read_response_write(out, sockfile, encoding) < 0)
     {
         cleanup(path, host, d_path, sockfile, out);
         error("An error occured while writing/reading from socket", strerror(errno), PROGRAM_NAME);
@@ -281,11 +288,11 @@ int main(int argc, char *argv[])
     return EXIT_SUCCESS;
 }
 
-static int read_response_write(FILE *out, FILE *sockfile, bool encoded)
+static int read_response_write(FILE *out, FILE *sockfile, enum encoding encoding)
 {
-    if (encoded)
+    if (encoding != ENCODING_IDENTITY)
     {
-        if (decompress_gzip(out, sockfile) < 0)
+        if (decompress_content(out, sockfile, encoding) < 0)
         {
             return -1;
         }
@@ -0,0 +1,313 @@
+/**
+ * @file encoding.c
+ * @date 14.02.2021
+ * @brief Implementation of the content coding negotiation and compression
+ */
+
+#include <stdbool.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <zlib.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/encode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "encoding.h"
+
+/** The brotli quality, 9 is close to the ratio of 11 at a fraction of its time */
+#define BROTLI_QUALITY 9
+/** The zstd level, still faster than gzip while compressing better */
+#define ZSTD_LEVEL 9
+/** The quality identity has if the client doesn't mention it */
+#define IDENTITY_DEFAULT_Q 1
+
+static const char *const names[ENCODING_COUNT] = {"br", "zstd", "gzip", "identity"};
+static const char *const suffixes[ENCODING_COUNT] = {".br", ".zst", ".gz", ""};
+
+/**
+ * @brief Returns true for the whitespace allowed around list elements and parameters.
+ */
+static bool is_space(char c) {
+    return c == ' ' || c == '\t';
+}
+
+/**
+ * @brief Strips the whitespace around the span str/len.
+ */
+static void trim(const char **str, size_t *len) {
+    while (*len > 0 && is_space(**str)) {
+        (*str)++;
+        (*len)--;
+    }
+    while (*len > 0 && is_space((*str)[*len - 1])) {
+        (*len)--;
+    }
+}
+
+/**
+ * @brief Parses a quality value ("0", "0.5", "1.000", ...) into thousandths.
+ * @return 0 on success, -1 if it is malformed
+ */
+static int parse_quality(const char *str, size_t len, unsigned short *q) {
+    if (len == 0 || (str[0] != '0' && str[0] != '1') || (len > 1 && str[1] != '.') || len > 5) {
+        return -1;
+    }
+    unsigned value = 0;
+    for (size_t i = 2; i < 5; i++) {
+        char c = i < len ? str[i] : '0';
+        if (c < '0' || c > '9') {
+            return -1;
+        }
+        value = value * 10 + (c - '0');
+    }
+    if (str[0] == '1' && value != 0) {
+        return -1;
+    }
+    *q = str[0] == '1' ? 1000 : value;
+    return 0;
+}
+
+/**
+ * @brief Parses the parameters of a list element, only q is looked at.
+ * @return 0 on success, -1 if the quality is malformed
+ */
+static int parse_parameters(const char *str, size_t len, unsigned short *q) {
+    *q = 1000;
+    while (len > 0) {
+        size_t param_len = 0;
+        while (param_len < len && str[param_len] != ';') {
+            param_len++;
+        }
+        const char *param = str;
+        size_t trimmed = param_len;
+        trim(&param, &trimmed);
+        if (trimmed >= 2 && (param[0] == 'q' || param[0] == 'Q') && param[1] == '=') {
+            if (parse_quality(param + 2, trimmed - 2, q) == -1) {
+                return -1;
+            }
+        }
+        str += param_len;
+        len -= param_len;
+        if (len > 0) {
+            // Skip the semicolon
+            str++;
+            len--;
+        }
+    }
+    return 0;
+}
+
+void encoding_parse_accept(struct encoding_accept *accept, const char *value, size_t len) {
+    bool listed[ENCODING_COUNT] = {false};
+    bool has_star = false;
+    unsigned short star_q = 0;
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        accept->q[e] = 0;
+    }
+
+    while (value != NULL && len > 0) {
+        size_t element_len = 0;
+        while (element_len < len && value[element_len] != ',') {
+            element_len++;
+        }
+        const char *element = value;
+        value += element_len;
+        len -= element_len;
+        if (len > 0) {
+            // Skip the comma
+            value++;
+            len--;
+        }
+
+        size_t name_len = 0;
+        while (name_len < element_len && element[name_len] != ';') {
+            name_len++;
+        }
+        unsigned short q;
+        if (parse_parameters(element + name_len, element_len - name_len, &q) == -1) {
+            continue;
+        }
+        const char *name = element;
+        trim(&name, &name_len);
+        if (name_len == 1 && name[0] == '*') {
+            has_star = true;
+            star_q = q;
+            continue;
+        }
+        enum encoding e = encoding_from_name(name, name_len);
+        if (e == ENCODING_COUNT && name_len == 6 && strncasecmp(name, "x-gzip", 6) == 0) {
+            e = ENCODING_GZIP;
+        }
+        if (e != ENCODING_COUNT) {
+            listed[e] = true;
+            accept->q[e] = q;
+        }
+    }
+
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        if (!listed[e] && has_star) {
+            accept->q[e] = star_q;
+        }
+    }
+    if (!listed[ENCODING_IDENTITY] && !has_star) {
+        accept->q[ENCODING_IDENTITY] = IDENTITY_DEFAULT_Q;
+    }
+}
+
+enum encoding encoding_choose(const struct encoding_accept *accept, unsigned available) {
+    enum encoding best = ENCODING_IDENTITY;
+    unsigned short best_q = 0;
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        if ((available & ENCODING_BIT(e)) != 0 && accept->q[e] > best_q) {
+            best = e;
+            best_q = accept->q[e];
+        }
+    }
+    return best;
+}
+
+const char *encoding_name(enum encoding encoding) {
+    return names[encoding];
+}
+
+const char *encoding_suffix(enum encoding encoding) {
+    return suffixes[encoding];
+}
+
+enum encoding encoding_from_name(const char *name, size_t len) {
+    trim(&name, &len);
+    for (int e = 0; e < ENCODING_COUNT; e++) {
+        size_t name_len = 0;
+        while (names[e][name_len] != '\0') {
+            name_len++;
+        }
+        if (len == name_len && strncasecmp(name, names[e], len) == 0) {
+            return e;
+        }
+    }
+    return ENCODING_COUNT;
+}
+
+const char *encoding_accept_header(void) {
+#if defined(HAVE_BROTLI) && defined(HAVE_ZSTD)
+    return "br, zstd, gzip";
+#elif defined(HAVE_BROTLI)
+    return "br, gzip";
+#elif defined(HAVE_ZSTD)
+    return "zstd, gzip";
+#else
+    return "gzip";
+#endif
+}
+
+/**
+ * @brief Compresses in into a single gzip member.
+ */
+static int compress_gzip(const uint8_t *in, size_t len, uint8_t **out, size_t *out_len) {
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // 16 + MAX_WBITS writes the gzip header and trailer
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK) {
+        return -1;
+    }
+    size_t cap = deflateBound(&stream, len);
+    *out = malloc(cap > 0 ? cap : 1);
+    if (*out == NULL) {
+        deflateEnd(&stream);
+        return -1;
+    }
+
+    // avail_in is only an unsigned int, so huge files are fed in pieces
+    stream.next_in = (Bytef *)in;
+    stream.avail_in = 0;
+    stream.next_out = *out;
+    stream.avail_out = 0;
+    size_t left = len;
+    size_t space = cap;
+    int err;
+    do {
+        if (stream.avail_in == 0) {
+            stream.avail_in = left > UINT32_MAX ? UINT32_MAX : left;
+            left -= stream.avail_in;
+        }
+        if (stream.avail_out == 0) {
+            stream.avail_out = space > UINT32_MAX ? UINT32_MAX : space;
+            space -= stream.avail_out;
+        }
+        err = deflate(&stream, left == 0 ? Z_FINISH : Z_NO_FLUSH);
+    } while (err == Z_OK);
+    deflateEnd(&stream);
+    if (err != Z_STREAM_END) {
+        free(*out);
+        return -1;
+    }
+    *out_len = stream.next_out - *out;
+    return 0;
+}
+
+#ifdef HAVE_BROTLI
+/**
+ * @brief Compresses in into one brotli stream.
+ */
+static int compress_brotli(const uint8_t *in, size_t len, uint8_t **out, size_t *out_len) {
+    size_t cap = BrotliEncoderMaxCompressedSize(len);
+    if (cap == 0) {
+        return -1;
+    }
+    *out = malloc(cap);
+    if (*out == NULL) {
+        return -1;
+    }
+    *out_len = cap;
+    if (!BrotliEncoderCompress(BROTLI_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_GENERIC, len, in,
+                               out_len, *out)) {
+        free(*out);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Compresses in into one zstd frame.
+ */
+static int compress_zstd(const uint8_t *in, size_t len, uint8_t **out, size_t *out_len) {
+    size_t cap = ZSTD_compressBound(len);
+    *out = malloc(cap);
+    if (*out == NULL) {
+        return -1;
+    }
+    *out_len = ZSTD_compress(*out, cap, in, len, ZSTD_LEVEL);
+    if (ZSTD_isError(*out_len)) {
+        free(*out);
+        return -1;
+    }
+    return 0;
+}
+#endif
+
+int encoding_compress(enum encoding encoding, const uint8_t *in, size_t len, uint8_t **out,
+                      size_t *out_len) {
+    switch (encoding) {
+    case ENCODING_GZIP:
+        return compress_gzip(in, len, out, out_len);
+#ifdef HAVE_BROTLI
+    case ENCODING_BROTLI:
+        return compress_brotli(in, len, out, out_len);
+#endif
+#ifdef HAVE_ZSTD
+    case ENCODING_ZSTD:
+        return compress_zstd(in, len, out, out_len);
+#endif
+    default:
+        return -1;
+    }
+}
@@ -0,0 +1,326 @@
+ /**
+  * @author briemelchen
+  * @date 03.01.2020
+  * @brief implementation of @see filecache.h.
+  * @details the cache is a hash-table with a doubly linked LRU-list. Every directory containing
+  * a cached file is watched with inotify, events are read if the SIGIO handler set the
+  * pending flag.
+ **/
+
+#include "filecache.h"
+#include "util.h"
+
+#define FILE_CACHE_WATCHES 64 // maximum amount of watched directories
+#define FILE_CACHE_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                           IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/**
+ * @brief a watched directory.
+ **/
+typedef struct
+{
+    int wd;
+    char *dir;
+} watch_t;
+
+/**
+ * @brief the file cache.
+ **/
+static struct
+{
+    int inotify_fd;
+    size_t count;
+    file_cache_entry_t *head;
+    file_cache_entry_t *tail;
+    file_cache_entry_t *buckets[FILE_CACHE_BUCKETS];
+    watch_t watches[FILE_CACHE_WATCHES];
+    size_t watch_count;
+} file_cache = {.inotify_fd = -1};
+
+static volatile sig_atomic_t events_pending; // set by the SIGIO handler
+
+/**
+ * @brief SIGIO handler: informs the cache that inotify events can be read.
+ * @param signal signal
+ **/
+static void handle_sigio(int signal);
+
+/**
+ * @brief computes the bucket of a path in the cache's hash-table.
+ * @details uses the djb2 hash-function.
+ * @param path path of the file
+ * @return index of the bucket
+ **/
+static size_t file_cache_bucket(const char *path);
+
+/**
+ * @brief removes an entry from the cache, closes the file and frees the entry.
+ * @param entry which should be removed
+ **/
+static void file_cache_remove(file_cache_entry_t *entry);
+
+/**
+ * @brief removes all entries whose path equals prefix or lies in the directory prefix.
+ * @param prefix path of a file or directory
+ * @param len length of prefix
+ **/
+static void file_cache_invalidate(const char *prefix, size_t len);
+
+/**
+ * @brief reads all pending inotify events and invalidates the affected entries.
+ * @details if the event-queue overflowed, the whole cache is cleared.
+ **/
+static void file_cache_process_events(void);
+
+/**
+ * @brief starts watching a directory, if it is not watched yet.
+ * @details if there are already FILE_CACHE_WATCHES watches, all entries and watches
+ * except the first one (the doc-root) are removed first.
+ * @param dir path of the directory
+ * @param len length of the path
+ * @return 0 on success, -1 on failure
+ **/
+static int file_cache_watch(const char *dir, size_t len);
+
+/**
+ * @brief removes all entries and their watches, only the doc-root stays watched.
+ **/
+static void file_cache_clear(void);
+
+int file_cache_init(const char *doc_root)
+{
+    events_pending = 0;
+    if ((file_cache.inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC)) == -1)
+        return -1;
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigio;
+    sa.sa_flags = SA_RESTART; // a send should not be interrupted by a changed file
+    if (sigaction(SIGIO, &sa, NULL) == -1 ||
+        fcntl(file_cache.inotify_fd, F_SETOWN, getpid()) == -1 ||
+        fcntl(file_cache.inotify_fd, F_SETFL, O_NONBLOCK | O_ASYNC) == -1 ||
+        file_cache_watch(doc_root, strlen(doc_root)) == -1)
+    {
+        close(file_cache.inotify_fd);
+        file_cache.inotify_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void file_cache_free(void)
+{
+    while (file_cache.head != NULL)
+        file_cache_remove(file_cache.head);
+    for (size_t i = 0; i < file_cache.watch_count; i++)
+        free(file_cache.watches[i].dir);
+    file_cache.watch_count = 0;
+    if (file_cache.inotify_fd != -1)
+        close(file_cache.inotify_fd);
+    file_cache.inotify_fd = -1;
+}
+
+const file_cache_entry_t *file_cache_open(const char *path)
+{
+    if (events_pending)
+        file_cache_process_events();
+
+    size_t bucket = file_cache_bucket(path);
+    file_cache_entry_t *entry = file_cache.buckets[bucket];
+    while (entry != NULL && strcmp(entry->path, path) != 0)
+        entry = entry->bucket_next;
+
+    if (entry != NULL)
+    {
+        if (entry != file_cache.head) // move to the head of the LRU-list
+        {
+            entry->prev->next = entry->next;
+            if (entry->next != NULL)
+                entry->next->prev = entry->prev;
+            else
+                file_cache.tail = entry->prev;
+            entry->prev = NULL;
+            entry->next = file_cache.head;
+            file_cache.head->prev = entry;
+            file_cache.head = entry;
+        }
+        return entry;
+    }
+
+    // miss: watch the directory before opening, so no change can be missed
+    const char *slash = strrchr(path, '/');
+    if (slash != NULL && slash != path && file_cache_watch(path, slash - path) == -1)
+        return NULL;
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        close(fd);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode))
+    {
+        close(fd);
+        errno = EISDIR;
+        return NULL;
+    }
+
+    if ((entry = malloc(sizeof(file_cache_entry_t))) == NULL ||
+        (entry->path = strdup(path)) == NULL)
+    {
+        free(entry);
+        close(fd);
+        return NULL;
+    }
+    entry->fd = fd;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    entry->mime_type = get_mime_type(entry->path);
+
+    if (file_cache.count == FILE_CACHE_ENTRIES) // evict least recently used
+        file_cache_remove(file_cache.tail);
+
+    entry->bucket_next = file_cache.buckets[bucket];
+    file_cache.buckets[bucket] = entry;
+    entry->prev = NULL;
+    entry->next = file_cache.head;
+    if (file_cache.head != NULL)
+        file_cache.head->prev = entry;
+    else
+        file_cache.tail = entry;
+    file_cache.head = entry;
+    file_cache.count++;
+    return entry;
+}
+
+static void handle_sigio(int signal)
+{
+    events_pending = 1;
+}
+
+static size_t file_cache_bucket(const char *path)
+{
+    size_t hash = 5381;
+    while (*path)
+        hash = hash * 33 + (unsigned char)*path++;
+    return hash % FILE_CACHE_BUCKETS;
+}
+
+static void file_cache_remove(file_cache_entry_t *entry)
+{
+    file_cache_entry_t **link = &file_cache.buckets[file_cache_bucket(entry->path)];
+    while (*link != entry)
+        link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        file_cache.head = entry->next;
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        file_cache.tail = entry->prev;
+
+    file_cache.count--;
+    close(entry->fd);
+    free(entry->path);
+    free(entry);
+}
+
+static void file_cache_invalidate(const char *prefix, size_t len)
+{
+    file_cache_entry_t *entry = file_cache.head;
+    while (entry != NULL)
+    {
+        file_cache_entry_t *next = entry->next;
+        if (strncmp(entry->path, prefix, len) == 0 &&
+            (entry->path[len] == '\0' || entry->path[len] == '/'))
+            file_cache_remove(entry);
+        entry = next;
+    }
+}
+
+static void file_cache_process_events(void)
+{
+    events_pending = 0; // reset first, so events arriving meanwhile are not lost
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(file_cache.inotify_fd, buffer, sizeof(buffer))) > 0)
+    {
+        for (char *ptr = buffer; ptr < buffer + len;)
+        {
+            const struct inotify_event *event = (const struct inotify_event *)ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                file_cache_clear();
+                continue;
+            }
+            // the same directory may be watched under different names, all get invalidated
+            for (long i = 0; i < (long)file_cache.watch_count; i++)
+            {
+                if (file_cache.watches[i].wd != event->wd)
+                    continue;
+                const char *dir = file_cache.watches[i].dir;
+                if (event->len > 0)
+                {
+                    char changed[strlen(dir) + 1 + strlen(event->name) + 1];
+                    sprintf(changed, "%s/%s", dir, event->name);
+                    file_cache_invalidate(changed, strlen(changed));
+                }
+                else
+                {
+                    file_cache_invalidate(dir, strlen(dir));
+                }
+                if (event->mask & IN_IGNORED) // directory was removed, forget the watch
+                {
+                    free(file_cache.watches[i].dir);
+                    file_cache.watches[i--] = file_cache.watches[--file_cache.watch_count];
+                }
+            }
+        }
+    }
+}
+
+static int file_cache_watch(const char *dir, size_t len)
+{
+    for (size_t i = 0; i < file_cache.watch_count; i++)
+    {
+        if (strlen(file_cache.watches[i].dir) == len && strncmp(file_cache.watches[i].dir, dir, len) == 0)
+            return 0;
+    }
+    if (file_cache.watch_count == FILE_CACHE_WATCHES)
+        file_cache_clear();
+
+    char *copy = strndup(dir, len);
+    if (copy == NULL)
+        return -1;
+    int wd = inotify_add_watch(file_cache.inotify_fd, copy, FILE_CACHE_EVENTS);
+    if (wd == -1)
+    {
+        free(copy);
+        return -1;
+    }
+    file_cache.watches[file_cache.watch_count].wd = wd;
+    file_cache.watches[file_cache.watch_count].dir = copy;
+    file_cache.watch_count++;
+    return 0;
+}
+
+static void file_cache_clear(void)
+{
+    while (file_cache.head != NULL)
+        file_cache_remove(file_cache.head);
+    while (file_cache.watch_count > 1)
+    {
+        watch_t *watch = &file_cache.watches[--file_cache.watch_count];
+        inotify_rm_watch(file_cache.inotify_fd, watch->wd);
+        free(watch->dir);
+    }
+}
@@ -0,0 +1,72 @@
+/**
+ * @author briemelchen
+ * @date 03.01.2020
+ * @brief Module which caches open file descriptors of requested files.
+ * @details For every resolved path the cache keeps an open file descriptor together with
+ * the size, modification time and mime-type of the file, so that a hot file can be sent
+ * without opening, seeking or stat-ing it again.
+ * The cache is bounded by FILE_CACHE_ENTRIES, the least recently used entry is closed first.
+ * Entries are invalidated using inotify: the doc-root and every directory containing a cached
+ * file are watched. The inotify descriptor signals new events with SIGIO, so events are only
+ * read if something changed.
+ * For implementation details @see filecache.c
+ **/
+
+#ifndef file_cache_h
+#define file_cache_h
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+#define FILE_CACHE_ENTRIES 128 // maximum amount of open files kept in the cache
+#define FILE_CACHE_BUCKETS 256 // amount of hash-buckets of the cache
+
+/**
+ * @brief a cached file.
+ * @details fd, size, mtime and mime_type may be used by the caller, the other members
+ * are used by the cache. The fd is shared by all requests, so only positional i/o
+ * (pread, sendfile with an offset) should be used on it.
+ **/
+typedef struct file_cache_entry
+{
+    char *path;
+    int fd;
+    off_t size;
+    struct timespec mtime;
+    char *mime_type;
+    struct file_cache_entry *prev;
+    struct file_cache_entry *next;
+    struct file_cache_entry *bucket_next;
+} file_cache_entry_t;
+
+/**
+ * @brief sets up the cache and starts watching the doc-root.
+ * @details installs a handler for SIGIO. Has to be called (in every process) before
+ * file_cache_open is used.
+ * @param doc_root root directory of the documents
+ * @return 0 on success, -1 on failure (errno is set)
+ **/
+int file_cache_init(const char *doc_root);
+
+/**
+ * @brief closes all cached files and stops watching the directories.
+ **/
+void file_cache_free(void);
+
+/**
+ * @brief returns the cache entry of a file, opening the file if it is not cached yet.
+ * @details pending inotify events are processed first, so a file which changed is opened
+ * again. Only regular files are cached, for other files errno is set to EISDIR.
+ * The entry stays valid until the next call of file_cache_open or file_cache_free.
+ * @param path resolved path of the file
+ * @return the entry on success, NULL on failure (errno is set)
+ **/
+const file_cache_entry_t *file_cache_open(const char *path);
+#endif
@@ -0,0 +1,486 @@
+/**
+ * @file gzdecode.c
+ * @date 22.01.2021
+ * @brief Implementation of the streaming body decoder
+ * @details The decoder is a small state machine over the input buffer: it either hands body
+ * bytes to the decompressor of the coding or collects one framing line (chunk size, chunk end or
+ * trailer) at a time.
+ */
+
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <zlib.h>
+
+#ifdef HAVE_BROTLI
+#include <brotli/decode.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+#include "gzdecode.h"
+
+/**
+ * @brief What the decoder expects next
+ */
+enum state {
+    /** Body bytes of a body that is not chunked */
+    STATE_BODY,
+    /** The line with the size of the next chunk */
+    STATE_SIZE,
+    /** The bytes of a chunk */
+    STATE_DATA,
+    /** The empty line after the bytes of a chunk */
+    STATE_DATA_END,
+    /** The lines of the trailer, up to the empty line */
+    STATE_TRAILER,
+    /** The body is complete */
+    STATE_DONE
+};
+
+/**
+ * @brief The state of decoding one body
+ */
+struct decoder {
+    enum encoding encoding;
+    z_stream stream;
+#ifdef HAVE_BROTLI
+    BrotliDecoderState *brotli;
+    /** Whether the brotli stream ended, nothing may follow it */
+    bool brotli_done;
+#endif
+#ifdef HAVE_ZSTD
+    ZSTD_DStream *zstd;
+#endif
+    /** Whether the decompressor got bytes of a member (or frame) that did not end yet */
+    bool in_member;
+    gzdecode_read_fn read;
+    void *source;
+    int out;
+    enum state state;
+    /** Bytes left in the body if it has a length, otherwise -1 */
+    long long left;
+    /** Bytes left in the current chunk */
+    unsigned long long chunk_left;
+    /** The framing line collected so far, without the line end */
+    char line[GZDECODE_LINE_SIZE];
+    size_t line_len;
+    /** The input buffer, in[start] up to in[end] are not consumed yet */
+    uint8_t *in;
+    size_t in_size;
+    size_t start;
+    size_t end;
+    uint8_t output[GZDECODE_OUTPUT_SIZE];
+    size_t output_len;
+};
+
+/**
+ * @brief Writes the collected output to the output descriptor.
+ * @return 0 on success, -1 on failure
+ */
+static int flush_output(struct decoder *d) {
+    size_t written = 0;
+    while (written < d->output_len) {
+        ssize_t n = write(d->out, d->output + written, d->output_len - written);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1) {
+            return -1;
+        }
+        written += n;
+    }
+    d->output_len = 0;
+    return 0;
+}
+
+/**
+ * @brief Inflates len bytes of gzip data, writing every full output block.
+ */
+static enum gzdecode_result inflate_data(struct decoder *d, uint8_t *data, size_t len) {
+    d->stream.next_in = data;
+    d->stream.avail_in = len;
+    while (true) {
+        if (d->stream.avail_in > 0) {
+            d->in_member = true;
+        }
+        d->stream.next_out = d->output + d->output_len;
+        d->stream.avail_out = GZDECODE_OUTPUT_SIZE - d->output_len;
+        int err = inflate(&d->stream, Z_NO_FLUSH);
+        d->output_len = GZDECODE_OUTPUT_SIZE - d->stream.avail_out;
+        if (err == Z_STREAM_END) {
+            // Another gzip member may follow
+            inflateReset(&d->stream);
+            d->in_member = false;
+        } else if (err != Z_OK && err != Z_BUF_ERROR) {
+            return GZDECODE_BAD_DATA;
+        }
+
+        bool full = d->output_len == GZDECODE_OUTPUT_SIZE;
+        if (full && flush_output(d) == -1) {
+            return GZDECODE_ERROR;
+        }
+        // zlib may hold back output if the block was full
+        if (!full && d->stream.avail_in == 0) {
+            return GZDECODE_OK;
+        }
+    }
+}
+
+#ifdef HAVE_BROTLI
+/**
+ * @brief Decompresses len bytes of brotli data, writing every full output block.
+ */
+static enum gzdecode_result brotli_data(struct decoder *d, uint8_t *data, size_t len) {
+    const uint8_t *next_in = data;
+    size_t avail_in = len;
+    if (d->brotli_done && len > 0) {
+        return GZDECODE_BAD_DATA;
+    }
+    while (true) {
+        if (avail_in > 0) {
+            d->in_member = true;
+        }
+        uint8_t *next_out = d->output + d->output_len;
+        size_t avail_out = GZDECODE_OUTPUT_SIZE - d->output_len;
+        BrotliDecoderResult result =
+            BrotliDecoderDecompressStream(d->brotli, &avail_in, &next_in, &avail_out, &next_out, NULL);
+        d->output_len = GZDECODE_OUTPUT_SIZE - avail_out;
+        if (result == BROTLI_DECODER_RESULT_ERROR ||
+            (result == BROTLI_DECODER_RESULT_SUCCESS && avail_in > 0)) {
+            return GZDECODE_BAD_DATA;
+        }
+        if (result == BROTLI_DECODER_RESULT_SUCCESS) {
+            d->brotli_done = true;
+            d->in_member = false;
+        }
+
+        bool full = d->output_len == GZDECODE_OUTPUT_SIZE;
+        if (full && flush_output(d) == -1) {
+            return GZDECODE_ERROR;
+        }
+        if (result != BROTLI_DECODER_RESULT_NEEDS_MORE_OUTPUT && avail_in == 0) {
+            return GZDECODE_OK;
+        }
+    }
+}
+#endif
+
+#ifdef HAVE_ZSTD
+/**
+ * @brief Decompresses len bytes of zstd data, writing every full output block.
+ */
+static enum gzdecode_result zstd_data(struct decoder *d, uint8_t *data, size_t len) {
+    ZSTD_inBuffer in = {.src = data, .size = len, .pos = 0};
+    while (true) {
+        ZSTD_outBuffer out = {.dst = d->output, .size = GZDECODE_OUTPUT_SIZE, .pos = d->output_len};
+        bool had_input = in.pos < in.size;
+        size_t hint = ZSTD_decompressStream(d->zstd, &out, &in);
+        d->output_len = out.pos;
+        if (ZSTD_isError(hint)) {
+            return GZDECODE_BAD_DATA;
+        }
+        // 0 means the frame ended and everything of it was written out
+        if (had_input || hint == 0) {
+            d->in_member = hint != 0;
+        }
+
+        bool full = d->output_len == GZDECODE_OUTPUT_SIZE;
+        if (full && flush_output(d) == -1) {
+            return GZDECODE_ERROR;
+        }
+        // zstd may hold back output if the block was full
+        if (!full && in.pos == in.size) {
+            return GZDECODE_OK;
+        }
+    }
+}
+#endif
+
+/**
+ * @brief Decompresses len bytes of data with the decompressor of the coding.
+ */
+static enum gzdecode_result decompress_data(struct decoder *d, uint8_t *data, size_t len) {
+    switch (d->encoding) {
+#ifdef HAVE_BROTLI
+    case ENCODING_BROTLI:
+        return brotli_data(d, data, len);
+#endif
+#ifdef HAVE_ZSTD
+    case ENCODING_ZSTD:
+        return zstd_data(d, data, len);
+#endif
+    default:
+        return inflate_data(d, data, len);
+    }
+}
+
+/**
+ * @brief Reads more input into the empty input buffer.
+ * @details The buffer is grown if the last read filled it completely, a body with a length is
+ * never read beyond its end.
+ * @return The number of bytes read, 0 at the end of the source and -1 on failure
+ */
+static ssize_t fill_input(struct decoder *d) {
+    if (d->end == d->in_size && d->in_size < GZDECODE_MAX_INPUT) {
+        // Nothing has to be kept, so the old buffer is not copied
+        uint8_t *in = malloc(d->in_size * 2);
+        if (in != NULL) {
+            free(d->in);
+            d->in = in;
+            d->in_size *= 2;
+        }
+    }
+    d->start = 0;
+    d->end = 0;
+
+    size_t len = d->in_size;
+    if (d->state == STATE_BODY && d->left >= 0 && (unsigned long long)d->left < len) {
+        len = d->left;
+    }
+    if (len == 0) {
+        return 0;
+    }
+    ssize_t n;
+    do {
+        n = d->read(d->source, d->in, len);
+    } while (n == -1 && errno == EINTR);
+    if (n > 0) {
+        d->end = n;
+        if (d->state == STATE_BODY && d->left >= 0) {
+            d->left -= n;
+        }
+    }
+    return n;
+}
+
+/**
+ * @brief Parses the size of a chunk at the start of line, chunk extensions are ignored.
+ * @return 0 on success, -1 if the line does not start with a valid size
+ */
+static int parse_chunk_size(const char *line, size_t len, unsigned long long *size) {
+    *size = 0;
+    size_t i;
+    for (i = 0; i < len; i++) {
+        char c = line[i];
+        int digit;
+        if (c >= '0' && c <= '9') {
+            digit = c - '0';
+        } else if (c >= 'a' && c <= 'f') {
+            digit = c - 'a' + 10;
+        } else if (c >= 'A' && c <= 'F') {
+            digit = c - 'A' + 10;
+        } else {
+            break;
+        }
+        // A size that doesn't fit can't be counted down
+        if (*size > (ULLONG_MAX >> 4)) {
+            return -1;
+        }
+        *size = (*size << 4) | digit;
+    }
+    if (i == 0 || (i < len && line[i] != ';' && line[i] != ' ' && line[i] != '\t')) {
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Handles a complete framing line depending on the state.
+ */
+static enum gzdecode_result handle_line(struct decoder *d) {
+    char *line = d->line;
+    size_t len = d->line_len;
+    if (len > 0 && line[len - 1] == '\r') {
+        len--;
+    }
+    d->line_len = 0;
+
+    switch (d->state) {
+    case STATE_SIZE:
+        if (parse_chunk_size(line, len, &d->chunk_left) == -1) {
+            return GZDECODE_BAD_FRAMING;
+        }
+        d->state = d->chunk_left == 0 ? STATE_TRAILER : STATE_DATA;
+        return GZDECODE_OK;
+    case STATE_DATA_END:
+        if (len != 0) {
+            return GZDECODE_BAD_FRAMING;
+        }
+        d->state = STATE_SIZE;
+        return GZDECODE_OK;
+    case STATE_TRAILER:
+        if (len == 0) {
+            d->state = STATE_DONE;
+        }
+        return GZDECODE_OK;
+    default:
+        return GZDECODE_BAD_FRAMING;
+    }
+}
+
+/**
+ * @brief Consumes the available input up to the end of the current framing line.
+ */
+static enum gzdecode_result consume_line(struct decoder *d) {
+    while (d->start < d->end) {
+        char c = d->in[d->start++];
+        if (c == '\n') {
+            return handle_line(d);
+        }
+        if (d->line_len == GZDECODE_LINE_SIZE) {
+            return GZDECODE_BAD_FRAMING;
+        }
+        d->line[d->line_len++] = c;
+    }
+    return GZDECODE_OK;
+}
+
+/**
+ * @brief Consumes the available body bytes, which belong to the current chunk if chunked.
+ */
+static enum gzdecode_result consume_data(struct decoder *d) {
+    size_t len = d->end - d->start;
+    if (d->state == STATE_DATA && d->chunk_left < len) {
+        len = d->chunk_left;
+    }
+    enum gzdecode_result result = decompress_data(d, d->in + d->start, len);
+    d->start += len;
+    if (d->state == STATE_DATA) {
+        d->chunk_left -= len;
+        if (d->chunk_left == 0) {
+            d->state = STATE_DATA_END;
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief Runs the decoder until the body is complete or fails.
+ */
+static enum gzdecode_result run(struct decoder *d) {
+    while (d->state != STATE_DONE) {
+        if (d->start == d->end) {
+            ssize_t n = fill_input(d);
+            if (n == -1) {
+                return GZDECODE_ERROR;
+            }
+            if (n == 0) {
+                // Only a body without length and chunks ends with the source
+                if (d->state != STATE_BODY || d->left > 0) {
+                    return GZDECODE_TRUNCATED;
+                }
+                d->state = STATE_DONE;
+                break;
+            }
+        }
+
+        enum gzdecode_result result;
+        if (d->state == STATE_BODY || d->state == STATE_DATA) {
+            result = consume_data(d);
+        } else {
+            result = consume_line(d);
+        }
+        if (result != GZDECODE_OK) {
+            return result;
+        }
+    }
+
+    if (d->in_member) {
+        return GZDECODE_TRUNCATED;
+    }
+    return flush_output(d) == -1 ? GZDECODE_ERROR : GZDECODE_OK;
+}
+
+/**
+ * @brief Sets up the decompressor of the coding, runs the decoder and frees the decompressor.
+ */
+static enum gzdecode_result run_coding(struct decoder *d) {
+    enum gzdecode_result result = GZDECODE_ERROR;
+    switch (d->encoding) {
+    case ENCODING_GZIP:
+        d->stream.zalloc = Z_NULL;
+        d->stream.zfree = Z_NULL;
+        d->stream.opaque = Z_NULL;
+        d->stream.next_in = Z_NULL;
+        d->stream.avail_in = 0;
+        if (inflateInit2(&d->stream, 16 + MAX_WBITS) == Z_OK) {
+            result = run(d);
+            inflateEnd(&d->stream);
+        }
+        return result;
+#ifdef HAVE_BROTLI
+    case ENCODING_BROTLI:
+        d->brotli_done = false;
+        d->brotli = BrotliDecoderCreateInstance(NULL, NULL, NULL);
+        if (d->brotli != NULL) {
+            result = run(d);
+            BrotliDecoderDestroyInstance(d->brotli);
+        }
+        return result;
+#endif
+#ifdef HAVE_ZSTD
+    case ENCODING_ZSTD:
+        d->zstd = ZSTD_createDStream();
+        if (d->zstd != NULL) {
+            result = run(d);
+            ZSTD_freeDStream(d->zstd);
+        }
+        return result;
+#endif
+    default:
+        return GZDECODE_UNSUPPORTED;
+    }
+}
+
+enum gzdecode_result gzdecode_copy(int out, gzdecode_read_fn read, void *source, enum encoding encoding,
+                                   bool chunked, long long length) {
+    struct decoder *d = malloc(sizeof(*d));
+    if (d == NULL) {
+        return GZDECODE_ERROR;
+    }
+    d->in = malloc(GZDECODE_MIN_INPUT);
+    if (d->in == NULL) {
+        free(d);
+        return GZDECODE_ERROR;
+    }
+    d->in_size = GZDECODE_MIN_INPUT;
+    d->start = 0;
+    d->end = 0;
+    d->output_len = 0;
+    d->line_len = 0;
+    d->chunk_left = 0;
+    d->in_member = false;
+    d->read = read;
+    d->source = source;
+    d->out = out;
+    d->state = chunked ? STATE_SIZE : STATE_BODY;
+    d->left = chunked || length < 0 ? -1 : length;
+    d->encoding = encoding;
+    enum gzdecode_result result = run_coding(d);
+
+    free(d->in);
+    free(d);
+    return result;
+}
+
+const char *gzdecode_strerror(enum gzdecode_result result) {
+    switch (result) {
+    case GZDECODE_OK:
+        return "Success";
+    case GZDECODE_BAD_DATA:
+        return "Invalid compressed data";
+    case GZDECODE_BAD_FRAMING:
+        return "Invalid chunk framing";
+    case GZDECODE_TRUNCATED:
+        return "Body ended early";
+    case GZDECODE_ERROR:
+        return "Input/output error";
+    case GZDECODE_UNSUPPORTED:
+        return "Unsupported content encoding";
+    }
+    return "Unknown error";
+}
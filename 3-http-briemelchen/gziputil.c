@@ -8,6 +8,80 @@
 
 #include "gziputil.h"
 
+/**
+ * @brief an entry of the compressed-file cache.
+ * @details entries are stored in a hash-table (bucket_next) and in a doubly linked
+ * LRU-list (prev, next), where the head is the most recently used entry.
+ **/
+typedef struct cache_entry
+{
+    char *path;
+    enum encoding encoding;
+    off_t size;
+    struct timespec mtime;
+    char *content;
+    size_t content_size;
+    struct cache_entry *prev;
+    struct cache_entry *next;
+    struct cache_entry *bucket_next;
+} cache_entry_t;
+
+#define BLOCK_FREE 0   // slot of the pool is unused
+#define BLOCK_QUEUED 1 // block is waiting for or being deflated
+#define BLOCK_DONE 2   // block is deflated and can be written
+#define BLOCK_FAILED 3 // deflating the block failed
+
+/**
+ * @brief a block of the input, which is deflated by one thread of the pool.
+ **/
+typedef struct
+{
+    Bytef in[GZIP_BLOCK_SIZE];
+    size_t in_len;
+    Bytef dict[GZIP_DICT_SIZE]; // tail of the previous block
+    size_t dict_len;
+    Bytef *out; // raw deflate data, allocated by the deflating thread
+    size_t out_len;
+    uLong crc; // crc32 of in
+    bool last; // the last block finishes the deflate stream
+    int state;
+} gzip_block_t;
+
+/**
+ * @brief the pool of threads deflating the blocks of one file.
+ * @details the blocks are kept in a ring of slots and identified by their sequence number, a slot is
+ * reused once its block has been written. All fields except the content of the blocks are protected by lock.
+ **/
+typedef struct
+{
+    pthread_mutex_t lock;
+    pthread_cond_t queued; // signaled if a block was queued or the pool stops
+    pthread_cond_t done;   // signaled if a block was deflated
+    gzip_block_t *blocks;
+    size_t slots;
+    size_t next_read; // sequence number of the next block which is read
+    size_t next_job;  // sequence number of the next block which is deflated
+    bool stop;
+} gzip_pool_t;
+
+/**
+ * @brief amount of threads used by compress_gzip.
+ **/
+static int threads = 1;
+
+/**
+ * @brief the compressed-file cache.
+ **/
+static struct
+{
+    size_t budget;
+    size_t used;
+    cache_entry_t *head;
+    cache_entry_t *tail;
+    cache_entry_t *buckets[GZIP_CACHE_BUCKETS];
+    char *uncached; // content of the last file which did not fit into the cache
+} cache;
+
 /**
  * @brief set's up a given z_stream struct for deflating(compressing)
  * @details initalies needed values for the struct.
@@ -17,15 +91,110 @@
 static int setup_zstream_deflate(z_stream *stream);
 
 /**
- * @brief set's up a given z_stream struct for inflating(decompressing)
- * @details initalies needed values for the struct.
- * @param stream pointer to the z_stream which should be setted up.
- * @return return-code of inflateInit2
+ * @brief reads from the socket for the gzip decoder (@see gzdecode.h).
+ * @param socket the FILE of the socket.
+ * @param buf buffer to read into.
+ * @param len size of the buffer.
+ * @return amount of read bytes, 0 on EOF and -1 on error.
+ **/
+static ssize_t read_socket(void *socket, void *buf, size_t len);
+
+/**
+ * @brief compresses a file by deflating blocks of it in parallel (@see compress_gzip).
+ * @param source file which reading and compressing should be peformed from.
+ * @param dest file where the compressed content should be written to, CAN be NULL.
+ * @param content_size pointer to an integer, where the size of the compressed file should be written.
+ * @return Z_STREAM_END on success, otherwise a negative value.
  **/
-static int setup_zstream_inflate(z_stream *stream);
+static int compress_gzip_parallel(FILE *source, FILE *dest, int *content_size);
+
+/**
+ * @brief start routine of the threads of the pool.
+ * @details takes the queued blocks in order of their sequence number and deflates them, until the pool stops.
+ * @param arg the pool (gzip_pool_t).
+ * @return NULL
+ **/
+static void *deflate_worker(void *arg);
+
+/**
+ * @brief deflates one block into raw deflate data, using its dictionary.
+ * @details all blocks but the last one end with a sync flush, so they end on a byte boundary
+ * and can be concatenated. Also computes the crc32 of the block.
+ * @param block the block which should be deflated.
+ * @return 0 on success, -1 on failure.
+ **/
+static int deflate_block(gzip_block_t *block);
+
+/**
+ * @brief waits for a block to be deflated and writes it to dest.
+ * @details afterwards the slot of the block is free again.
+ * @param pool the pool.
+ * @param seq the sequence number of the block.
+ * @param dest file where the block should be written to, CAN be NULL.
+ * @param content_size pointer to the size of the compressed file, which is updated.
+ * @param crc pointer to the crc32 of the file so far, which is updated.
+ * @return 0 on success, -1 on failure.
+ **/
+static int write_block(gzip_pool_t *pool, size_t seq, FILE *dest, int *content_size, uLong *crc);
+
+/**
+ * @brief writes raw bytes of the gzip header/trailer to dest and updates the content size.
+ * @return 0 on success, -1 on failure.
+ **/
+static int write_bytes(FILE *dest, const Bytef *bytes, size_t len, int *content_size);
+
+/**
+ * @brief computes the bucket of a path in the cache's hash-table.
+ * @details uses djb2 as hash-function.
+ * @param path the path which should be hashed.
+ * @return index of the bucket
+ **/
+static size_t cache_bucket(const char *path);
+
+/**
+ * @brief reads the whole file into memory and compresses it with brotli or zstd (@see encoding.h).
+ * @param source file which should be compressed.
+ * @param encoding the coding which should be used.
+ * @param compressed pointer where the malloc'ed compressed content is stored.
+ * @param compressed_size pointer where the size of the compressed content is stored.
+ * @return 0 on success, -1 on failure.
+ **/
+static int compress_other(FILE *source, enum encoding encoding, char **compressed, size_t *compressed_size);
+
+/**
+ * @brief removes an entry from the cache and frees it.
+ * @param entry the entry which should be removed.
+ **/
+static void cache_remove(cache_entry_t *entry);
+
+/**
+ * @brief inserts a freshly compressed file at the head of the cache.
+ * @details evicts the least recently used entries until the budget is kept.
+ * @param path the key of the entry.
+ * @param encoding the coding of the content, also part of the key.
+ * @param st the stat of the uncompressed file.
+ * @param content the compressed content, ownership is transfered to the cache.
+ * @param content_size size of the compressed content.
+ * @return 0 on success, -1 if no memory could be allocated.
+ **/
+static int cache_insert(const char *path, enum encoding encoding, const struct stat *st, char *content,
+                        size_t content_size);
+
+void gzip_set_threads(int amount)
+{
+    if (amount == 0)
+        amount = sysconf(_SC_NPROCESSORS_ONLN);
+    if (amount < 1)
+        amount = 1;
+    threads = amount > GZIP_MAX_THREADS ? GZIP_MAX_THREADS : amount;
+}
 
 int compress_gzip(FILE *source, FILE *dest, int *content_size)
 {
+    struct stat st;
+    if (threads > 1 && fstat(fileno(source), &st) == 0 && st.st_size > GZIP_BLOCK_SIZE)
+        return compress_gzip_parallel(source, dest, content_size);
+
     int return_value, state;
     // in/out buffers used for deflate
     Bytef in[GZIP_CHUNK_SIZE], out[GZIP_CHUNK_SIZE];
@@ -79,50 +248,201 @@ int compress_gzip(FILE *source, FILE *dest, int *content_size)
     return return_value;
 }
 
-int decompress_gzip(FILE *outF, FILE *socket)
+static int compress_gzip_parallel(FILE *source, FILE *dest, int *content_size)
 {
-    int return_value, amount_inflated;
-    Bytef in[GZIP_CHUNK_SIZE], out[GZIP_CHUNK_SIZE];
-    z_stream stream;
-    return_value = setup_zstream_inflate(&stream);
+    gzip_pool_t pool = {.next_read = 0, .next_job = 0, .stop = false};
+    pool.slots = 2 * threads; // so the threads never wait for a block to be written
+    pool.blocks = calloc(pool.slots, sizeof(gzip_block_t));
+    if (pool.blocks == NULL)
+        return Z_MEM_ERROR;
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.queued, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    pthread_t workers[threads];
+    int started = 0;
+    while (started < threads && pthread_create(&workers[started], NULL, deflate_worker, &pool) == 0)
+        started++;
 
-    do //decompress till whole file has been decompressed (indicated by inflate!)
+    // gzip header: magic, deflate, no flags, no mtime, no extra flags, OS unix
+    const Bytef header[] = {0x1f, 0x8b, 8, 0, 0, 0, 0, 0, 0, 3};
+    int return_value = started > 0 && write_bytes(dest, header, sizeof(header), content_size) == 0 ? Z_STREAM_END : Z_ERRNO;
+    uLong crc = crc32(0L, Z_NULL, 0);
+    uLong total = 0;
+    size_t seq = 0;
+    bool last = false;
+    while (!last && return_value == Z_STREAM_END)
     {
-        stream.avail_in = fread(in, 1, GZIP_CHUNK_SIZE, socket);
-        if (ferror(socket))
+        // the slot can only be reused, once its previous block was written
+        if (seq >= pool.slots && write_block(&pool, seq - pool.slots, dest, content_size, &crc) != 0)
         {
-            inflateEnd(&stream);
-            return Z_ERRNO;
+            return_value = Z_ERRNO;
+            break;
         }
-        if (stream.avail_in == 0)
+        gzip_block_t *block = &pool.blocks[seq % pool.slots];
+        block->in_len = fread(block->in, 1, GZIP_BLOCK_SIZE, source);
+        if (ferror(source))
+        {
+            return_value = Z_ERRNO;
             break;
-        stream.next_in = in;
-        do // generate output as long there is something to inflate
+        }
+        // a file of whole blocks ends with an empty block
+        last = block->in_len < GZIP_BLOCK_SIZE;
+        block->last = last;
+        block->dict_len = 0;
+        if (seq > 0)
         {
-            stream.avail_out = GZIP_CHUNK_SIZE;
-            stream.next_out = out;
-            return_value = inflate(&stream, Z_NO_FLUSH);
-            // inflating failed
-            if (return_value == Z_NEED_DICT || return_value == Z_DATA_ERROR || return_value == Z_MEM_ERROR)
-            {
-                inflateEnd(&stream);
-                return return_value;
-            }
-            amount_inflated = GZIP_CHUNK_SIZE - stream.avail_out;
-            if (fwrite(out, 1, amount_inflated, outF) != amount_inflated || ferror(outF)) // write to output
-            {
-                inflateEnd(&stream);
-                return Z_ERRNO;
-            }
+            gzip_block_t *previous = &pool.blocks[(seq - 1) % pool.slots];
+            block->dict_len = previous->in_len < GZIP_DICT_SIZE ? previous->in_len : GZIP_DICT_SIZE;
+            memcpy(block->dict, previous->in + previous->in_len - block->dict_len, block->dict_len);
+        }
+        total += block->in_len;
 
-        } while (stream.avail_out == 0);
+        pthread_mutex_lock(&pool.lock);
+        block->state = BLOCK_QUEUED;
+        pool.next_read++;
+        pthread_cond_signal(&pool.queued);
+        pthread_mutex_unlock(&pool.lock);
+        seq++;
+    }
+    for (size_t i = seq > pool.slots ? seq - pool.slots : 0; return_value == Z_STREAM_END && i < seq; i++)
+    {
+        if (write_block(&pool, i, dest, content_size, &crc) != 0)
+            return_value = Z_ERRNO;
+    }
+
+    pthread_mutex_lock(&pool.lock);
+    pool.stop = true;
+    pthread_cond_broadcast(&pool.queued);
+    pthread_mutex_unlock(&pool.lock);
+    for (int i = 0; i < started; i++)
+        pthread_join(workers[i], NULL);
+    for (size_t i = 0; i < pool.slots; i++)
+        free(pool.blocks[i].out);
+    free(pool.blocks);
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.queued);
+    pthread_cond_destroy(&pool.done);
+
+    // gzip trailer: crc32 and size modulo 2^32, little endian
+    Bytef trailer[8];
+    for (int i = 0; i < 4; i++)
+    {
+        trailer[i] = (crc >> (8 * i)) & 0xff;
+        trailer[4 + i] = (total >> (8 * i)) & 0xff;
+    }
+    if (return_value == Z_STREAM_END && write_bytes(dest, trailer, sizeof(trailer), content_size) != 0)
+        return_value = Z_ERRNO;
+    rewind(source); // rewind, because maybe file is needed again in same process
+    return return_value;
+}
+
+static void *deflate_worker(void *arg)
+{
+    gzip_pool_t *pool = arg;
+    pthread_mutex_lock(&pool->lock);
+    while (true)
+    {
+        while (!pool->stop && pool->next_job == pool->next_read)
+            pthread_cond_wait(&pool->queued, &pool->lock);
+        if (pool->stop)
+            break;
+        gzip_block_t *block = &pool->blocks[pool->next_job++ % pool->slots];
+        pthread_mutex_unlock(&pool->lock);
+
+        int state = deflate_block(block) == 0 ? BLOCK_DONE : BLOCK_FAILED;
 
-    } while (return_value != Z_STREAM_END);
+        pthread_mutex_lock(&pool->lock);
+        block->state = state;
+        pthread_cond_broadcast(&pool->done);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    return NULL;
+}
 
-    inflateEnd(&stream);
+static int deflate_block(gzip_block_t *block)
+{
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    // negative window bits -> raw deflate, the gzip header and trailer are written once for the whole file
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+        return -1;
+    if (block->dict_len > 0 && deflateSetDictionary(&stream, block->dict, block->dict_len) != Z_OK)
+    {
+        deflateEnd(&stream);
+        return -1;
+    }
+
+    size_t out_size = deflateBound(&stream, block->in_len) + 16; // room for the sync flush marker
+    block->out = malloc(out_size);
+    if (block->out == NULL)
+    {
+        deflateEnd(&stream);
+        return -1;
+    }
+    stream.next_in = block->in;
+    stream.avail_in = block->in_len;
+    stream.next_out = block->out;
+    stream.avail_out = out_size;
+    int return_value = deflate(&stream, block->last ? Z_FINISH : Z_SYNC_FLUSH);
+    block->out_len = out_size - stream.avail_out;
+    bool complete = stream.avail_in == 0 && (block->last ? return_value == Z_STREAM_END : return_value == Z_OK);
+    deflateEnd(&stream);
+
+    block->crc = crc32(0L, block->in, block->in_len);
+    return complete ? 0 : -1;
+}
+
+static int write_block(gzip_pool_t *pool, size_t seq, FILE *dest, int *content_size, uLong *crc)
+{
+    gzip_block_t *block = &pool->blocks[seq % pool->slots];
+    pthread_mutex_lock(&pool->lock);
+    while (block->state == BLOCK_QUEUED)
+        pthread_cond_wait(&pool->done, &pool->lock);
+    int state = block->state;
+    pthread_mutex_unlock(&pool->lock);
+    if (state != BLOCK_DONE)
+        return -1;
+
+    int return_value = write_bytes(dest, block->out, block->out_len, content_size);
+    *crc = crc32_combine(*crc, block->crc, block->in_len);
+    free(block->out);
+    block->out = NULL;
+    block->state = BLOCK_FREE;
     return return_value;
 }
 
+static int write_bytes(FILE *dest, const Bytef *bytes, size_t len, int *content_size)
+{
+    if (dest != NULL && (fwrite(bytes, 1, len, dest) != len || ferror(dest)))
+        return -1;
+    *content_size += len;
+    return 0;
+}
+
+int decompress_content(FILE *outF, FILE *socket, enum encoding encoding)
+{
+    if (fflush(outF) == EOF)
+        return Z_ERRNO;
+    // the body runs till the server closes the connection
+    enum gzdecode_result result = gzdecode_copy(fileno(outF), read_socket, socket, encoding, false, -1);
+    if (result == GZDECODE_ERROR)
+        return Z_ERRNO;
+    if (result != GZDECODE_OK)
+        return Z_DATA_ERROR;
+    return Z_STREAM_END;
+}
+
+static ssize_t read_socket(void *socket, void *buf, size_t len)
+{
+    size_t amount_read = fread(buf, 1, len, socket);
+    if (amount_read == 0 && ferror((FILE *)socket))
+        return -1;
+    return amount_read;
+}
+
 static int setup_zstream_deflate(z_stream *stream)
 {
 
@@ -134,15 +454,184 @@ static int setup_zstream_deflate(z_stream *stream)
     return deflateInit2(stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
 }
 
-static int setup_zstream_inflate(z_stream *stream)
+void gzip_cache_init(size_t budget)
 {
+    memset(&cache, 0, sizeof(cache));
+    cache.budget = budget;
+}
 
-    // set to NULL so zlib uses the default routines
-    stream->zalloc = Z_NULL;
-    stream->zfree = Z_NULL;
-    stream->opaque = Z_NULL;
-    stream->avail_in = 0;
-    stream->next_in = Z_NULL;
-    // 31 because 15 + 16(marks gzip)
-    return inflateInit2(stream, 31);
-}
\ No newline at end of file
+void gzip_cache_free(void)
+{
+    while (cache.head != NULL)
+        cache_remove(cache.head);
+    free(cache.uncached);
+    cache.uncached = NULL;
+}
+
+int compress_cached(const char *path, enum encoding encoding, FILE *source, const Bytef **content, int *content_size)
+{
+    struct stat st;
+    if (fstat(fileno(source), &st) == -1)
+        return Z_ERRNO;
+
+    // lookup the cache, entry is only valid if the file did not change
+    cache_entry_t *entry = cache.buckets[cache_bucket(path)];
+    while (entry != NULL && (entry->encoding != encoding || strcmp(entry->path, path) != 0))
+        entry = entry->bucket_next;
+    if (entry != NULL)
+    {
+        if (entry->size == st.st_size && entry->mtime.tv_sec == st.st_mtim.tv_sec &&
+            entry->mtime.tv_nsec == st.st_mtim.tv_nsec)
+        {
+            // move to the head of the LRU-list
+            if (entry != cache.head)
+            {
+                entry->prev->next = entry->next;
+                if (entry->next != NULL)
+                    entry->next->prev = entry->prev;
+                else
+                    cache.tail = entry->prev;
+                entry->prev = NULL;
+                entry->next = cache.head;
+                cache.head->prev = entry;
+                cache.head = entry;
+            }
+            *content = (Bytef *)entry->content;
+            *content_size = entry->content_size;
+            return 0;
+        }
+        cache_remove(entry); // stale
+    }
+
+    // miss: compress file into memory
+    char *compressed = NULL;
+    size_t compressed_size = 0;
+    if (encoding != ENCODING_GZIP)
+    {
+        if (compress_other(source, encoding, &compressed, &compressed_size) != 0)
+            return Z_ERRNO;
+    }
+    else
+    {
+        FILE *memory = open_memstream(&compressed, &compressed_size);
+        if (memory == NULL)
+            return Z_ERRNO;
+        int size = 0;
+        int return_value = compress_gzip(source, memory, &size);
+        if (fclose(memory) != 0 || return_value < 0)
+        {
+            free(compressed);
+            return Z_ERRNO;
+        }
+    }
+
+    free(cache.uncached);
+    cache.uncached = NULL;
+    if (compressed_size > cache.budget)
+    {
+        cache.uncached = compressed; // too large, keep only until the next call
+    }
+    else if (cache_insert(path, encoding, &st, compressed, compressed_size) != 0)
+    {
+        return Z_MEM_ERROR;
+    }
+    *content = (Bytef *)compressed;
+    *content_size = compressed_size;
+    return 0;
+}
+
+static int compress_other(FILE *source, enum encoding encoding, char **compressed, size_t *compressed_size)
+{
+    char *raw = NULL;
+    size_t raw_size = 0;
+    FILE *memory = open_memstream(&raw, &raw_size);
+    if (memory == NULL)
+        return -1;
+    char buffer[GZIP_CHUNK_SIZE];
+    size_t amount_read;
+    while ((amount_read = fread(buffer, 1, sizeof(buffer), source)) > 0)
+    {
+        if (fwrite(buffer, 1, amount_read, memory) != amount_read)
+            break;
+    }
+    bool failed = ferror(source) || ferror(memory);
+    if (fclose(memory) != 0 || failed)
+    {
+        free(raw);
+        return -1;
+    }
+    rewind(source); // same as compress_gzip, the file may be needed again
+
+    uint8_t *out;
+    size_t out_len;
+    int return_value = encoding_compress(encoding, (uint8_t *)raw, raw_size, &out, &out_len);
+    free(raw);
+    if (return_value != 0)
+        return -1;
+    *compressed = (char *)out;
+    *compressed_size = out_len;
+    return 0;
+}
+
+static size_t cache_bucket(const char *path)
+{
+    size_t hash = 5381;
+    while (*path)
+        hash = hash * 33 + (unsigned char)*path++;
+    return hash % GZIP_CACHE_BUCKETS;
+}
+
+static void cache_remove(cache_entry_t *entry)
+{
+    cache_entry_t **link = &cache.buckets[cache_bucket(entry->path)];
+    while (*link != entry)
+        link = &(*link)->bucket_next;
+    *link = entry->bucket_next;
+
+    if (entry->prev != NULL)
+        entry->prev->next = entry->next;
+    else
+        cache.head = entry->next;
+    if (entry->next != NULL)
+        entry->next->prev = entry->prev;
+    else
+        cache.tail = entry->prev;
+
+    cache.used -= entry->content_size;
+    free(entry->path);
+    free(entry->content);
+    free(entry);
+}
+
+static int cache_insert(const char *path, enum encoding encoding, const struct stat *st, char *content,
+                        size_t content_size)
+{
+    cache_entry_t *entry = malloc(sizeof(cache_entry_t));
+    if (entry == NULL || (entry->path = strdup(path)) == NULL)
+    {
+        free(entry);
+        free(content);
+        return -1;
+    }
+    entry->encoding = encoding;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+    entry->content = content;
+    entry->content_size = content_size;
+
+    while (cache.used + content_size > cache.budget) // evict least recently used
+        cache_remove(cache.tail);
+
+    size_t bucket = cache_bucket(path);
+    entry->bucket_next = cache.buckets[bucket];
+    cache.buckets[bucket] = entry;
+    entry->prev = NULL;
+    entry->next = cache.head;
+    if (cache.head != NULL)
+        cache.head->prev = entry;
+    else
+        cache.tail = entry;
+    cache.head = entry;
+    cache.used += content_size;
+    return 0;
+}
\ No newline at end of file
@@ -1,8 +1,9 @@
 /**
  * @author briemelchen
  * @date 03.01.2020
- * @brief Module which offers function to compress/decompress data(files) using gzip.
+ * @brief Module which offers function to compress/decompress data(files) using gzip, brotli or zstd.
  * @details zlib is used as libary offering does functionality to inflate/deflate data.
+ * Brotli and zstd are used through @see encoding.h, if the Makefile found their libaries.
  * Implementation relies on the zlib documentation, manuals and examples (https://zlib.net/)
  * Because files should be encoded to gzip, it is not sufficient to use zlib's compress and decompress,
  * because gzip needs specific window-bits. 
@@ -14,14 +15,39 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <pthread.h>
 #include <zlib.h>
 
-#define GZIP_CHUNK_SIZE 256 // chunk size for compress/decompres data
+#include "encoding.h"
+#include "gzdecode.h"
+
+#define GZIP_CHUNK_SIZE 16384 // chunk size for compress/decompres data
+#define GZIP_BLOCK_SIZE (128 * 1024) // size of the blocks which are deflated in parallel
+#define GZIP_DICT_SIZE (32 * 1024) // tail of the previous block used as dictionary (deflate's window)
+#define GZIP_MAX_THREADS 64 // maximum amount of compressing threads
+#define GZIP_CACHE_BUDGET (32 * 1024 * 1024) // default amount of compressed bytes kept in the cache
+#define GZIP_CACHE_BUCKETS 256 // amount of hash-buckets of the cache
+
+/**
+ * @brief sets the amount of threads used by compress_gzip.
+ * @details 0 uses one thread per online processor. With a single thread (or for files not larger than
+ *          GZIP_BLOCK_SIZE) the file is deflated as one stream, otherwise @see compress_gzip.
+ * @param threads amount of threads, at most GZIP_MAX_THREADS.
+ **/
+void gzip_set_threads(int threads);
 
 /**
  * @brief compresses a file into gzip-format and may writes the compressed content to another file (in our case socket!)
  * @details uses zlib libary and the provied deflate functions to perform the compressing.
  *          the compressing is performed using a compromiss between speed and compress.
+ *          If more than one thread is set (@see gzip_set_threads), the file is split into blocks of
+ *          GZIP_BLOCK_SIZE bytes, which are deflated in parallel by a pool of threads (like pigz does).
+ *          Every block uses the last GZIP_DICT_SIZE bytes of the previous block as dictionary, so the
+ *          ratio stays close to a single stream. The raw deflate blocks are concatenated behind one gzip header,
+ *          followed by the CRC32 of the whole file (combined from the CRC32s of the blocks) and its size.
  *          If the dest-file param is non-null, the compressed content is written  to the file.
  * @param source file which reading and compressing should be peformed from.
  * @param dest file where the compressed content should be written to. CAN be NULL, than only the
@@ -32,12 +58,48 @@
 int compress_gzip(FILE *source, FILE *dest, int *content_size);
 
 /**
- * @brief decompresses a file from gzip to plain-text/binary and writes it to an given out file. 
- * @details uses zlib libary and the provied inflate functions to perform the decompressing.
+ * @brief decompresses a file from gzip, brotli or zstd to plain-text/binary and writes it to an given out file. 
+ * @details uses the streaming decoder of gzdecode.h, which reads the socket with adaptively
+ *          sized buffers and writes the output in page-sized blocks.
  *          Decompresses whole file till EOF is reached.
  * @param outF file where the decoded content should be written to
- * @param socket where the gzip content should be read from
+ * @param socket where the compressed content should be read from
+ * @param encoding the content coding of the content (not identity)
+ * @return Z_STREAM_END on success, otherwise a negative value is returned.
+ **/
+int decompress_content(FILE *out, FILE *socket, enum encoding encoding);
+
+/**
+ * @brief sets up the cache for compressed files.
+ * @details the cache stores the compressed content of a file together with its path, coding, size and
+ *          modification time, so that a file only has to be compressed again if it changed.
+ *          If the compressed content of all cached files exceeds the budget, the least recently
+ *          used files are removed. A budget of 0 disables caching.
+ *          Has to be called before compress_cached is used.
+ * @param budget maximum amount of compressed bytes kept in memory.
+ **/
+void gzip_cache_init(size_t budget);
+
+/**
+ * @brief frees all resources used by the cache.
+ * @details after this call, content returned by compress_cached is invalid.
+ **/
+void gzip_cache_free(void);
+
+/**
+ * @brief returns the compressed content of a file, either from the cache or freshly compressed.
+ * @details the file is identified by its path, the coding, size and modification time (fstat on the source),
+ *          so a changed file is never served from the cache. On a miss, the file is compressed
+ *          (gzip using compress_gzip, brotli and zstd using encoding_compress) and (if it fits into the
+ *          budget) stored in the cache.
+ *          The returned content is owned by the cache and stays valid until the next call of
+ *          compress_cached or gzip_cache_free.
+ * @param path path of the file, used as key of the cache.
+ * @param encoding the coding which should be used, one of ENCODING_COMPILED but not identity.
+ * @param source the opened file which should be compressed.
+ * @param content pointer where the pointer to the compressed content is stored.
+ * @param content_size pointer to an integer, where the size of the compressed content is stored.
  * @return 0 on success, otherwise a value non equal to 0 is returned.
  **/
-int decompress_gzip(FILE *out, FILE *socket);
-#endif
\ No newline at end of file
+int compress_cached(const char *path, enum encoding encoding, FILE *source, const Bytef **content, int *content_size);
+#endif
\ No newline at end of file
@@ -0,0 +1,186 @@
+/**
+ * @file httpparse.c
+ * @date 20.01.2021
+ * @brief Implementation of the allocation free request header parser
+ * @details The parser walks the header once, line by line, and only records where the parts
+ * of every line start and end.
+ */
+
+#include <errno.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#include "httpparse.h"
+
+/**
+ * @brief Searches the arena for the empty line ending the header, starting at from.
+ * @return The length of the header including the empty line or 0 if it is not complete yet
+ */
+static size_t find_end(const struct httpparse_arena *arena, size_t from) {
+    for (size_t i = from; i < arena->len; i++) {
+        if (arena->data[i] != '\n') {
+            continue;
+        }
+        if (i + 1 < arena->len && arena->data[i + 1] == '\n') {
+            return i + 2;
+        }
+        if (i + 2 < arena->len && arena->data[i + 1] == '\r' && arena->data[i + 2] == '\n') {
+            return i + 3;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Returns true if c may appear in a method or a header field name.
+ */
+static bool is_token(char c) {
+    return c > ' ' && c < 127 && strchr("()<>@,;:\\\"/[]?={}", c) == NULL;
+}
+
+/**
+ * @brief Strips spaces and tabs from both ends of the span.
+ */
+static struct httpparse_span trim(const char *start, const char *end) {
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+    struct httpparse_span span = {start, end - start};
+    return span;
+}
+
+/**
+ * @brief Splits the request line between start and end into method, path and version.
+ * @return HTTPPARSE_OK or HTTPPARSE_BAD
+ */
+static enum httpparse_result parse_request_line(const char *start, const char *end,
+                                                struct httpparse_request *req) {
+    const char *method_end = memchr(start, ' ', end - start);
+    if (method_end == NULL || method_end == start) {
+        return HTTPPARSE_BAD;
+    }
+    for (const char *c = start; c < method_end; c++) {
+        if (!is_token(*c)) {
+            return HTTPPARSE_BAD;
+        }
+    }
+
+    const char *path = method_end + 1;
+    const char *path_end = memchr(path, ' ', end - path);
+    if (path_end == NULL || path_end == path) {
+        return HTTPPARSE_BAD;
+    }
+
+    // exactly three fields, the version must not contain another space
+    const char *version = path_end + 1;
+    if (version == end || memchr(version, ' ', end - version) != NULL) {
+        return HTTPPARSE_BAD;
+    }
+
+    req->method.ptr = start;
+    req->method.len = method_end - start;
+    req->path.ptr = path;
+    req->path.len = path_end - path;
+    req->version.ptr = version;
+    req->version.len = end - version;
+    return HTTPPARSE_OK;
+}
+
+enum httpparse_result httpparse_parse(const char *buf, size_t len, struct httpparse_request *req) {
+    const char *pos = buf;
+    const char *buf_end = buf + len;
+    bool first = true;
+    req->header_count = 0;
+
+    while (pos < buf_end) {
+        const char *line_end = memchr(pos, '\n', buf_end - pos);
+        if (line_end == NULL) {
+            return HTTPPARSE_BAD;
+        }
+        const char *next = line_end + 1;
+        if (line_end > pos && line_end[-1] == '\r') {
+            line_end--;
+        }
+
+        if (first) {
+            enum httpparse_result result = parse_request_line(pos, line_end, req);
+            if (result != HTTPPARSE_OK) {
+                return result;
+            }
+            first = false;
+        } else if (line_end == pos) {
+            // the empty line ends the header
+            return next == buf_end ? HTTPPARSE_OK : HTTPPARSE_BAD;
+        } else {
+            const char *colon = memchr(pos, ':', line_end - pos);
+            if (colon == NULL || colon == pos) {
+                return HTTPPARSE_BAD;
+            }
+            for (const char *c = pos; c < colon; c++) {
+                if (!is_token(*c)) {
+                    return HTTPPARSE_BAD;
+                }
+            }
+            if (req->header_count == HTTPPARSE_MAX_HEADERS) {
+                return HTTPPARSE_TOO_LARGE;
+            }
+            struct httpparse_header *header = &req->headers[req->header_count++];
+            header->name.ptr = pos;
+            header->name.len = colon - pos;
+            header->value = trim(colon + 1, line_end);
+        }
+        pos = next;
+    }
+    return HTTPPARSE_BAD;
+}
+
+enum httpparse_result httpparse_read(int fd, struct httpparse_arena *arena, struct httpparse_request *req) {
+    arena->end = find_end(arena, 0);
+    while (arena->end == 0) {
+        if (arena->len == HTTPPARSE_ARENA_SIZE) {
+            return HTTPPARSE_TOO_LARGE;
+        }
+        ssize_t n = read(fd, arena->data + arena->len, HTTPPARSE_ARENA_SIZE - arena->len);
+        if (n <= 0) {
+            if (n == 0) {
+                errno = 0;
+            }
+            return HTTPPARSE_CLOSED;
+        }
+
+        // the end may start with the last two bytes that were already there
+        size_t from = arena->len > 2 ? arena->len - 2 : 0;
+        arena->len += n;
+        arena->end = find_end(arena, from);
+    }
+    return httpparse_parse(arena->data, arena->end, req);
+}
+
+bool httpparse_equals(struct httpparse_span span, const char *str) {
+    return strlen(str) == span.len && memcmp(span.ptr, str, span.len) == 0;
+}
+
+bool httpparse_contains(struct httpparse_span span, const char *str) {
+    size_t len = strlen(str);
+    for (size_t i = 0; i + len <= span.len; i++) {
+        if (memcmp(span.ptr + i, str, len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const struct httpparse_span *httpparse_find_header(const struct httpparse_request *req, const char *name) {
+    size_t len = strlen(name);
+    for (size_t i = 0; i < req->header_count; i++) {
+        const struct httpparse_header *header = &req->headers[i];
+        if (header->name.len == len && strncasecmp(header->name.ptr, name, len) == 0) {
+            return &header->value;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,108 @@
+/**
+ * @file httpparse.h
+ * @date 20.01.2021
+ * @brief Allocation free parser for HTTP/1.1 request headers
+ * @details The request header is read into a fixed arena of HTTPPARSE_ARENA_SIZE bytes and
+ * parsed in place: the method, the path, the version and every header field are returned as
+ * spans pointing into the arena, nothing is copied and nothing is allocated. A header that
+ * does not fit into the arena, or has more than HTTPPARSE_MAX_HEADERS fields, is rejected as
+ * soon as this is known, so a client can neither make the server allocate memory nor keep it
+ * busy with an endless header.
+ * The same module is used by 3-http-Jonny, 3-http-briemelchen and 3-http-mikhub, keep the
+ * copies in sync.
+ */
+
+#ifndef HTTPPARSE_H
+#define HTTPPARSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HTTPPARSE_ARENA_SIZE 8192
+#define HTTPPARSE_MAX_HEADERS 64
+
+/**
+ * @brief A span of characters inside the arena, it is not null terminated
+ */
+struct httpparse_span {
+    const char *ptr;
+    size_t len;
+};
+
+/**
+ * @brief A header field, the value is stripped of surrounding whitespace
+ */
+struct httpparse_header {
+    struct httpparse_span name;
+    struct httpparse_span value;
+};
+
+/**
+ * @brief A parsed request header, all spans point into the arena it was read into
+ */
+struct httpparse_request {
+    struct httpparse_span method;
+    struct httpparse_span path;
+    struct httpparse_span version;
+    struct httpparse_header headers[HTTPPARSE_MAX_HEADERS];
+    size_t header_count;
+};
+
+/**
+ * @brief The buffer a request header is read into, one per connection
+ * @details len is the number of bytes read, end the length of the header including the
+ * terminating empty line once it was found.
+ */
+struct httpparse_arena {
+    char data[HTTPPARSE_ARENA_SIZE];
+    size_t len;
+    size_t end;
+};
+
+/**
+ * @brief The results of reading and parsing a request header
+ */
+enum httpparse_result {
+    /** The header was complete and valid */
+    HTTPPARSE_OK,
+    /** The header is malformed */
+    HTTPPARSE_BAD,
+    /** The header does not fit into the arena or has too many fields */
+    HTTPPARSE_TOO_LARGE,
+    /** The connection was closed or failed before the header was complete (errno is set on failure) */
+    HTTPPARSE_CLOSED
+};
+
+/**
+ * @brief Reads a request header from the socket fd into the arena and parses it into req.
+ * @details Reads directly from the descriptor until the empty line ending the header was
+ * received, bytes following the header stay in the arena behind arena->end. The arena has to be
+ * emptied (len set to 0) before it is used for the first time.
+ * @return The result of reading and parsing
+ */
+enum httpparse_result httpparse_read(int fd, struct httpparse_arena *arena, struct httpparse_request *req);
+
+/**
+ * @brief Parses the complete request header of len bytes at buf into req.
+ * @details buf has to end with the empty line that terminates the header. Lines may end with
+ * CRLF or a bare LF.
+ * @return HTTPPARSE_OK, HTTPPARSE_BAD or HTTPPARSE_TOO_LARGE
+ */
+enum httpparse_result httpparse_parse(const char *buf, size_t len, struct httpparse_request *req);
+
+/**
+ * @brief Returns true if the span is equal to the null terminated string str.
+ */
+bool httpparse_equals(struct httpparse_span span, const char *str);
+
+/**
+ * @brief Returns true if the span contains the null terminated string str.
+ */
+bool httpparse_contains(struct httpparse_span span, const char *str);
+
+/**
+ * @brief Returns the value of the first header field called name (case insensitive) or NULL.
+ */
+const struct httpparse_span *httpparse_find_header(const struct httpparse_request *req, const char *name);
+
+#endif
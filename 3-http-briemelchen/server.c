@@ -7,9 +7,15 @@
  * -p specifies the port, where the server should listen to (default 8080)
  * -i specifiees the index-filename of the server which should be
  * sent, if no specific file is requested (default index.html)
+ * -c specifies the amount of bytes used to cache compressed files (default GZIP_CACHE_BUDGET)
+ * -w specifies the number of pre-forked worker processes (default 1)
+ * -t specifies the number of threads compressing a large file in parallel (default: one per processor)
  * The positional argument DOC_ROOT specifies the path to the root directory which
  * contain files that can be requested.
- * The server can encode files into gzip, using the in @see gziputils specified routines.
+ * The server can encode files into gzip, brotli or zstd, using the in @see gziputils specified routines.
+ * The coding is negotiated with Accept-Encoding (@see encoding.h), precompressed siblings of a file
+ * (index.html.br, index.html.zst, index.html.gz) are sent instead of compressing the file.
+ * Opened files are kept in the cache of @see filecache, so hot files are neither opened nor stat-ed again.
  **/
 #include "server.h"
 
@@ -23,10 +29,36 @@
  * After setting up the struct, the socket sys-call is made; Afterwards binding starts
  * and the listen-sys call is invoked (using a backlog of 5).
  * Finally setsockopt is used, to bypass "Already in Use "error.
+ * If reuse_port is set, SO_REUSEPORT is set aswell, so that every worker can bind its own socket.
  * @param port where the server should listen to
+ * @param reuse_port true if multiple workers share the port
  * @return the socket's file descriptor on success, otherwise -1
  * */
-static int setup_socket(char *port);
+static int setup_socket(char *port, bool reuse_port);
+
+/**
+ * @brief forks a worker, which handles requests on its own socket until it receives a signal
+ * @details exits the program if fork fails. The worker exits with 1 if its socket can't be set up.
+ * @param port where the worker should listen to
+ * @param doc_root root directory of the documents
+ * @param index_file index-filename
+ * @return the worker's pid
+ **/
+static pid_t start_worker(char *port, char *doc_root, char *index_file);
+
+/**
+ * @brief starts the workers and restarts them, if they exit while the server is running.
+ * @details A worker which exits with 1 within the first second couldn't set up its socket,
+ * in that case all workers are stopped instead of restarting it forever.
+ * After the quit-flag is set, SIGTERM is sent to all workers and the function waits until
+ * they answered their current requests.
+ * @param port where the workers should listen to
+ * @param doc_root root directory of the documents
+ * @param index_file index-filename
+ * @param workers number of workers
+ * @return 0 on success, 1 if a worker failed to start
+ **/
+static int run_workers(char *port, char *doc_root, char *index_file, long workers);
 
 /**
  * @brief handles ingoing requests and responses appropriate
@@ -40,19 +72,6 @@ static int setup_socket(char *port);
  **/
 static void accept_and_response(int sockfd, char *doc_root, char *index_file);
 
-/**
- * @brief Checks the first-line of a HTTP-request header on validty and parses it.
- * @details checks the header for the following format:
- * METHOD PATH HTTPVERSION . If  one of it is missing, or additional fields are given,
- * the connection will be closed afterwards.
- * Method and requested path are parsed and returned using pointers to pointers.
- * @param line of the http header
- * @param method pointer to a pointer where the request-method is been stored
- * @param resource_path pointer to a pointer where the path to the resources should be stored
- * @return true on success (valid header),  false otherwise
- **/
-static bool get_request(char *line, char **method, char **resource_path);
-
 /**
  * @brief extracts the full path to the requested file
  * @details concats the requested file and the doc_root, so that the full path can be
@@ -65,7 +84,7 @@ static bool get_request(char *line, char **method, char **resource_path);
 static char *get_full_path(char *doc_root, char *requested_file, char *index_file);
 
 /**
- * @brief sends the correct response header to the client.
+ * @brief formats the correct response header for the client.
  * @details the server supports the following status-codes:
  * 400 is sent, if the request header was invalid
  * 404 is sent, if the requested file does not exist.
@@ -75,37 +94,58 @@ static char *get_full_path(char *doc_root, char *requested_file, char *index_fil
  * On success, a few other content-header are sent:
  * "Date: date" as specified in RFC 822
  * "Content-Length: length" the size of the transmitted file
- * "Content-Encoding: gzip" if the client told the server that it supports it
+ * "Content-Encoding: coding" if the content is compressed with the negotiated coding
+ * "Vary: Accept-Encoding" as the content depends on the codings the client accepts
  * "Content-Type: Mime-Type" is supported only for html/htm, css and js files
- * @param connection_file the file to the socket-connection
+ * The header is only written into the buffer, @see send_response sends it together with the content.
+ * @param header the buffer where the header is written to
+ * @param header_size the size of the buffer (HEADER_SIZE)
  * @param res_code the computed response-code: 200, 400, 404 or 501
  * @param mime_type of the file, NULL if non-supported mime-type
- * @param gzip true,if the client supports gzip, else false
+ * @param encoding the coding of the content, ENCODING_IDENTITY if it is not compressed
  * @param file_size the size of the file which should be transmitted
- * @return 0 on success, -1 on failure
+ * @return the length of the header on success, -1 on failure
  * */
-static int send_header(FILE *connection_file, int res_code, char *mime_type, bool gzip, int file_size);
+static int format_header(char *header, size_t header_size, int res_code, char *mime_type, enum encoding encoding,
+                         int file_size);
 
 /**
- * @brief sends the content of the file which should be transmitted.
+ * @brief sends the header and the content of the file which should be transmitted.
  * @details sends the file either as plain-text/bits or as gzip-compressed (@see gziputils.h/c)
- * The writing is performed using fwrite, so binary-data can be sent as well (e.g. JPEG files)
- * @param connection_file the socket's connection-file, where the content should be written to
- * @param requested_file the file requested  by the client
- * @param gzip indicates if sending should be performed using compression (if gzip true), otherwise plain-data will be sent
- * @param size the file size
+ * If the content is compressed, the header and the already compressed bytes (@see compress_cached)
+ * are written with a single sendmsg, so small responses leave in as few segments as possible.
+ * Otherwise the header is sent with MSG_MORE and the file is copied to the socket by the kernel using
+ * sendfile, starting at offset 0, so the shared file descriptor of the file cache is not moved. With
+ * MSG_MORE the kernel holds the header back and sends it together with the first bytes of the file.
+ * @param connection_file the socket's connection-file, where the response should be written to
+ * @param header the formatted header (@see format_header)
+ * @param header_len the length of the header
+ * @param req_fd the file descriptor of the file requested by the client, -1 if there is no content
+ * @param compressed the compressed content or NULL, if plain-data (or a precompressed sibling) should be sent
+ * @param size the file size, 0 if there is no content
  * @return 0 on success, -1 on failue
  **/
-static int send_content(FILE *connection_file, FILE *req_file, bool gzip, int size);
+static int send_response(FILE *connection_file, const char *header, int header_len, int req_fd,
+                         const Bytef *compressed, int size);
 
 /**
- * @brief skips the request header and checks if the client supports gzip-encoding
- * @details checking is done by looking for the "Accept-Encoding" field in the header
- * and checks if it contains "gzip"
- * @param connection_file socket's connection file of the current communication
- * @return true, if the client supports encoding, otherwise false
+ * @brief finds the precompressed siblings (path.br, path.zst and path.gz) of a file.
+ * @details only regular files which are at least as new as the file itself are taken.
+ * @param path the full path of the file
+ * @param file the cache entry of the file
+ * @return the set of codings (ENCODING_BIT) which have a sibling
+ **/
+static unsigned find_siblings(const char *path, const file_cache_entry_t *file);
+
+/**
+ * @brief writes all buffers of iov to the socket, continuing after partial writes.
+ * @param fd the socket
+ * @param iov the buffers which should be written, are modified while writing
+ * @param iovcnt amount of buffers
+ * @param flags flags for sendmsg e.g. MSG_MORE
+ * @return 0 on success, -1 on failure
  **/
-static bool check_encoding_skip_header(FILE *connection_file);
+static int send_all(int fd, struct iovec *iov, int iovcnt, int flags);
 
 /**
  * @brief setups the signal-handling
@@ -125,7 +165,7 @@ static void handle_signal(int signal);
 /**
  * @brief prints the usage message to stderr and exits the program
  * @details usage message has format:
- * Usage: PROGR_NAME [-p PORT] [-i INDEX] DOC_ROOT
+ * Usage: PROGR_NAME [-p PORT] [-i INDEX] [-c CACHE_BYTES] [-w WORKERS] [-t THREADS] DOC_ROOT
  * Exit's with exit-code 1
  **/
 static void usage(void);
@@ -152,8 +192,9 @@ int main(int argc, char *argv[])
     quit = false;
     char c;
     char *port = NULL, *index_file = NULL, *doc_root = NULL;
-    int p_count = 0, i_count = 0;
-    while ((c = getopt(argc, argv, "i:p:")) != -1)
+    char *cache_budget = NULL, *workers = NULL, *threads = NULL;
+    int p_count = 0, i_count = 0, c_count = 0, w_count = 0, t_count = 0;
+    while ((c = getopt(argc, argv, "i:p:c:w:t:")) != -1)
     {
         switch (c)
         {
@@ -165,14 +206,38 @@ int main(int argc, char *argv[])
             i_count++;
             index_file = optarg;
             break;
+        case 'c':
+            c_count++;
+            cache_budget = optarg;
+            break;
+        case 'w':
+            w_count++;
+            workers = optarg;
+            break;
+        case 't':
+            t_count++;
+            threads = optarg;
+            break;
         default:
             usage();
             break;
         }
     }
     // checking options and arguments
-    if (p_count > 1 || i_count > 1)
+    if (p_count > 1 || i_count > 1 || c_count > 1 || w_count > 1 || t_count > 1)
+        usage();
+    if (c_count == 1 && !is_valid_port(cache_budget)) // only digits allowed
         usage();
+    long worker_count = w_count == 1 ? strtol(workers, NULL, 10) : 1;
+    if (w_count == 1 && (*workers == '\0' || !is_valid_port(workers) ||
+                         worker_count < 1 || worker_count > MAX_WORKERS))
+        usage();
+    long thread_count = t_count == 1 ? strtol(threads, NULL, 10) : 0;
+    if (t_count == 1 && (*threads == '\0' || !is_valid_port(threads) ||
+                         thread_count < 1 || thread_count > GZIP_MAX_THREADS))
+        usage();
+    gzip_set_threads(thread_count);
+    gzip_cache_init(c_count == 1 ? strtoul(cache_budget, NULL, 10) : GZIP_CACHE_BUDGET);
     if (p_count == 0)
         port = DEFAULT_PORT;
     if (!is_valid_port(port))
@@ -183,11 +248,93 @@ int main(int argc, char *argv[])
         usage();
     doc_root = argv[optind];
     setup_signal_handler();
+    if (worker_count > 1)
+    {
+        int ret = run_workers(port, doc_root, index_file, worker_count);
+        gzip_cache_free();
+        return ret;
+    }
     //set up socket and start accepting requests
     int sockfd;
-    if ((sockfd = setup_socket(port)) == -1)
+    if ((sockfd = setup_socket(port, false)) == -1)
         error("Failed to setup socket!", strerror(errno), PROGRAM_NAME);
+    if (file_cache_init(doc_root) == -1)
+        error("Failed to setup file cache!", strerror(errno), PROGRAM_NAME);
     accept_and_response(sockfd, doc_root, index_file);
+    file_cache_free();
+    gzip_cache_free();
+}
+
+static pid_t start_worker(char *port, char *doc_root, char *index_file)
+{
+    pid_t pid = fork();
+    if (pid < 0)
+        error("fork failed!", strerror(errno), PROGRAM_NAME);
+    if (pid == 0)
+    {
+        int sockfd;
+        if ((sockfd = setup_socket(port, true)) == -1)
+            error("Failed to setup socket!", strerror(errno), PROGRAM_NAME);
+        if (file_cache_init(doc_root) == -1) // every worker has its own cache
+            error("Failed to setup file cache!", strerror(errno), PROGRAM_NAME);
+        accept_and_response(sockfd, doc_root, index_file);
+        close(sockfd);
+        file_cache_free();
+        gzip_cache_free();
+        exit(EXIT_SUCCESS);
+    }
+    return pid;
+}
+
+static int run_workers(char *port, char *doc_root, char *index_file, long workers)
+{
+    pid_t pids[workers];
+    time_t started[workers];
+    int ret = EXIT_SUCCESS;
+
+    for (long i = 0; i < workers; i++)
+    {
+        pids[i] = start_worker(port, doc_root, index_file);
+        started[i] = time(NULL);
+    }
+
+    while (!quit)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+        {
+            if (errno == EINTR) // signal, check loop-condition
+                continue;
+            break;
+        }
+        for (long i = 0; i < workers; i++)
+        {
+            if (pids[i] != pid)
+                continue;
+            pids[i] = -1;
+            if (quit)
+                break;
+            if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS && time(NULL) - started[i] < 1)
+            {
+                error_m("worker failed to start!", NULL, PROGRAM_NAME);
+                quit = 1;
+                ret = EXIT_FAILURE;
+                break;
+            }
+            pids[i] = start_worker(port, doc_root, index_file); // crashed or exited, replace it
+            started[i] = time(NULL);
+        }
+    }
+
+    for (long i = 0; i < workers; i++)
+    {
+        if (pids[i] > 0)
+            kill(pids[i], SIGTERM);
+    }
+    while (wait(NULL) >= 0 || errno == EINTR)
+        ;
+    return ret;
 }
 
 static void accept_and_response(int sockfd, char *doc_root, char *index_file)
@@ -212,27 +359,12 @@ static void accept_and_response(int sockfd, char *doc_root, char *index_file)
             error("fdopen failed!", strerror(errno), PROGRAM_NAME);
         }
 
-        // checking and parsing request header
-        char *line = NULL;
-        size_t len = 0;
-        ssize_t nread;
-        char *request_method = NULL;
-        char *resource_path = NULL;
-        char *dup = NULL;
-        if ((nread = getline(&line, &len, connection)) != -1)
-        {
-            dup = strdup(line);
-            if (!get_request(dup, &request_method, &resource_path))
-            {
-                res_code = 400;
-            }
-        }
-        free(line);
-
-        // skip header and check if encoding is  desired
-        bool gzip = check_encoding_skip_header(connection);
-
-        if (request_method == NULL || resource_path == NULL)
+        // reading and parsing the whole request header in place, @see httpparse.h
+        struct httpparse_arena arena;
+        struct httpparse_request req;
+        arena.len = 0;
+        enum httpparse_result result = httpparse_read(connfd, &arena, &req);
+        if (result == HTTPPARSE_CLOSED)
         {
             if (fclose(connection) < 0)
             {
@@ -241,118 +373,183 @@ static void accept_and_response(int sockfd, char *doc_root, char *index_file)
             continue;
         }
 
-        if (strcmp(request_method, "GET") != 0 && res_code == 200) // non GET method is requested
+        if (result != HTTPPARSE_OK || !httpparse_equals(req.version, "HTTP/1.1")) // malformed or oversized
+            res_code = 400;
+        else if (!httpparse_equals(req.method, "GET")) // non GET method is requested
             res_code = 501;
 
+        // check which encodings are accepted
+        const struct httpparse_span *accept_encoding = result == HTTPPARSE_OK ? httpparse_find_header(&req, "Accept-Encoding") : NULL;
+        struct encoding_accept accept;
+        encoding_parse_accept(&accept, accept_encoding != NULL ? accept_encoding->ptr : NULL,
+                              accept_encoding != NULL ? accept_encoding->len : 0);
+
+        // the path is the only part of the header which is needed as a string
+        size_t path_len = result == HTTPPARSE_OK ? req.path.len : 0;
+        char resource_path[path_len + 2];
+        memcpy(resource_path, path_len > 0 ? req.path.ptr : "/", path_len > 0 ? path_len : 1);
+        resource_path[path_len > 0 ? path_len : 1] = '\0';
+
         char *full_file_path;
         if ((full_file_path = get_full_path(doc_root, resource_path, index_file)) == NULL)
         {
             error("Extracting full path failed!", strerror(errno), PROGRAM_NAME);
         }
-        FILE *req_file = NULL;
+        const file_cache_entry_t *req_file = NULL;
         if (res_code == 200)
         {
-            req_file = fopen(full_file_path, "r");
+            req_file = file_cache_open(full_file_path);
             if (req_file == NULL)
             {
-                if ((errno == ENOENT || errno == ENOTDIR)) // File not found
+                if ((errno == ENOENT || errno == ENOTDIR || errno == EISDIR)) // File not found
                     res_code = 404;
                 else
                     error("Failed to open file!", strerror(errno), PROGRAM_NAME);
             }
         }
 
+        // choose the encoding, a precompressed sibling is sent like a plain file
+        char *mime_type = NULL;
+        enum encoding encoding = ENCODING_IDENTITY;
+        bool sibling = false;
+        if (res_code == 200)
+        {
+            mime_type = req_file->mime_type;
+            unsigned siblings = find_siblings(full_file_path, req_file);
+            encoding = encoding_choose(&accept, ENCODING_COMPILED | siblings);
+            if ((siblings & ENCODING_BIT(encoding)) != 0)
+            {
+                // the entry of the file is invalid after the sibling is opened
+                const char *suffix = encoding_suffix(encoding);
+                char sibling_path[strlen(full_file_path) + strlen(suffix) + 1];
+                sprintf(sibling_path, "%s%s", full_file_path, suffix);
+                req_file = file_cache_open(sibling_path);
+                sibling = req_file != NULL;
+                if (!sibling) // removed meanwhile
+                {
+                    encoding = encoding_choose(&accept, ENCODING_COMPILED);
+                    req_file = file_cache_open(full_file_path);
+                    if (req_file == NULL)
+                        res_code = 404;
+                }
+            }
+        }
+
         int content_size = 0;
+        const Bytef *compressed = NULL;
         if (res_code == 200)
         {
             // get content size either encoded-size or plain-size
-            if (gzip)
+            if (encoding != ENCODING_IDENTITY && !sibling)
             {
-                if (compress_gzip(req_file, NULL, &content_size) < 0)
+                // the stream shares the offset with the cached fd, which is only used with offsets
+                FILE *source = fdopen(fcntl(req_file->fd, F_DUPFD, 0), "r");
+                if (source == NULL)
+                    error("fdopen failed!", strerror(errno), PROGRAM_NAME);
+                rewind(source);
+                if (compress_cached(full_file_path, encoding, source, &compressed, &content_size) != 0)
                 {
-                    error("Error while deflating using zlib!", strerror(errno), PROGRAM_NAME);
+                    error("Error while compressing!", encoding_name(encoding), PROGRAM_NAME);
                 }
+                fclose(source);
             }
             else
             {
-                if ((content_size = get_file_size(req_file)) < 0)
-                {
-                    error("Error while getting filesize!", strerror(errno), PROGRAM_NAME);
-                }
+                content_size = req_file->size;
             }
         }
 
-        // sending header
-        if (send_header(connection, res_code, get_mime_type(full_file_path), gzip, content_size) == -1)
+        char header[HEADER_SIZE];
+        int header_len = format_header(header, sizeof(header), res_code, mime_type, encoding, content_size);
+        if (header_len == -1)
         {
-            error("Failed to send header", strerror(errno), PROGRAM_NAME);
+            error("Failed to create header", strerror(errno), PROGRAM_NAME);
         }
 
-        if (res_code == 200)
-        {
-            // send content if and only if 200 is used as response code
-            if (send_content(connection, req_file, gzip, content_size) < 0)
-                error("Failed to send content!", "", PROGRAM_NAME);
-        }
+        // send content if and only if 200 is used as response code
+        if (send_response(connection, header, header_len, res_code == 200 ? req_file->fd : -1,
+                          compressed, res_code == 200 ? content_size : 0) < 0)
+            error("Failed to send response!", strerror(errno), PROGRAM_NAME);
 
-        printf("REQUEST-METHOD:%s, REQUESTED-FILE:%s, RESPONSE-CODE:%d, ENCODED: %s\n",
-               request_method, full_file_path, res_code, gzip ? "Y" : "N");
+        printf("REQUEST-METHOD:%.*s, REQUESTED-FILE:%s, RESPONSE-CODE:%d, ENCODED: %s\n",
+               result == HTTPPARSE_OK ? (int)req.method.len : 0, result == HTTPPARSE_OK ? req.method.ptr : "",
+               full_file_path, res_code, encoding != ENCODING_IDENTITY ? "Y" : "N");
         fflush(stdout);
         if (fclose(connection) < 0)
             error("fclose failed!", strerror(errno), PROGRAM_NAME);
-        if (req_file != NULL)
-        {
-            if (fclose(req_file) < 0)
-                error("fclose failed!", strerror(errno), PROGRAM_NAME);
-        }
 
         free(full_file_path);
-        free(dup);
     }
 }
 
-static bool check_encoding_skip_header(FILE *connection_file)
+static int send_response(FILE *connection_file, const char *header, int header_len, int req_fd,
+                         const Bytef *compressed, int size)
 {
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t nread;
-    int re_value = false;
-    while ((nread = getline(&line, &len, connection_file)) != -1 && (strcmp(line, "\r\n") != 0))
+    int fd = fileno(connection_file);
+    struct iovec iov[2] = {
+        {.iov_base = (void *)header, .iov_len = header_len},
+        {.iov_base = (void *)compressed, .iov_len = size}};
+
+    if (req_fd == -1 || compressed != NULL)
+        return send_all(fd, iov, size > 0 ? 2 : 1, 0);
+
+    if (send_all(fd, iov, 1, MSG_MORE) == -1) // the header leaves together with the file
+        return -1;
+    off_t offset = 0;
+    while (offset < size)
     {
-        if (strncmp(line, "Accept-Encoding", 15) == 0)
-        {
-            if (strstr(line, "gzip") != NULL)
-                re_value = true;
-        }
+        ssize_t sent = sendfile(fd, req_fd, &offset, size - offset);
+        if (sent <= 0)
+            return -1;
     }
-    free(line);
-    return re_value;
+    return 0;
 }
 
-static int send_content(FILE *connection_file, FILE *req_file, bool gzip, int size)
+static unsigned find_siblings(const char *path, const file_cache_entry_t *file)
 {
-
-    if (gzip)
+    unsigned found = 0;
+    char sibling_path[strlen(path) + 8];
+    for (int e = 0; e < ENCODING_IDENTITY; e++)
     {
-        compress_gzip(req_file, connection_file, &size);
+        sprintf(sibling_path, "%s%s", path, encoding_suffix(e));
+        struct stat st;
+        if (stat(sibling_path, &st) == 0 && S_ISREG(st.st_mode) &&
+            (st.st_mtim.tv_sec > file->mtime.tv_sec ||
+             (st.st_mtim.tv_sec == file->mtime.tv_sec && st.st_mtim.tv_nsec >= file->mtime.tv_nsec)))
+            found |= ENCODING_BIT(e);
     }
-    else
+    return found;
+}
+
+static int send_all(int fd, struct iovec *iov, int iovcnt, int flags)
+{
+    struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+    while (msg.msg_iovlen > 0)
     {
-        char buffer[size];
-        memset(buffer, 0, size);
-        int res = fread(buffer, 1, size, req_file);
-        if (res < 0)
-            return -1;
-        buffer[res] = '\0';
-        if (fwrite(buffer, 1, res, connection_file) != res)
+        ssize_t sent = sendmsg(fd, &msg, flags);
+        if (sent == -1)
+        {
+            if (errno == EINTR)
+                continue;
             return -1;
+        }
+        while (msg.msg_iovlen > 0 && (size_t)sent >= msg.msg_iov->iov_len) // skip written buffers
+        {
+            sent -= msg.msg_iov->iov_len;
+            msg.msg_iov++;
+            msg.msg_iovlen--;
+        }
+        if (msg.msg_iovlen > 0)
+        {
+            msg.msg_iov->iov_base = (char *)msg.msg_iov->iov_base + sent;
+            msg.msg_iov->iov_len -= sent;
+        }
     }
-    if (ferror(req_file) || ferror(connection_file))
-        return -1;
     return 0;
 }
 
-static int send_header(FILE *connection_file, int res_code, char *mime_type, bool gzip, int file_size)
+static int format_header(char *header, size_t header_size, int res_code, char *mime_type, enum encoding encoding,
+                         int file_size)
 {
     char date[256];
     time_t t;
@@ -362,34 +559,37 @@ static int send_header(FILE *connection_file, int res_code, char *mime_type, boo
     if (strftime(date, sizeof(date), "%a, %d %b %g %T GMT", tmp) == 0)
         return -1;
 
-    if (date == NULL || file_size == -1)
+    if (file_size == -1)
         return -1;
 
+    int len;
     switch (res_code)
     {
     case 200:
-        fprintf(connection_file, "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Length: %d\r\nConnection: close\r\n", date, file_size);
-        if (mime_type != NULL)
-            fprintf(connection_file, "Content-Type: %s\r\n", mime_type);
-        if (gzip)
-            fprintf(connection_file, "Content-Encoding: gzip\r\n");
-        fprintf(connection_file, "\r\n");
+        len = snprintf(header, header_size, "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Length: %d\r\nConnection: close\r\n%s%s%s%s%s%sVary: Accept-Encoding\r\n\r\n",
+                       date, file_size,
+                       mime_type != NULL ? "Content-Type: " : "", mime_type != NULL ? mime_type : "",
+                       mime_type != NULL ? "\r\n" : "",
+                       encoding != ENCODING_IDENTITY ? "Content-Encoding: " : "",
+                       encoding != ENCODING_IDENTITY ? encoding_name(encoding) : "",
+                       encoding != ENCODING_IDENTITY ? "\r\n" : "");
         break;
     case 400:
-        fprintf(connection_file, "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
+        len = snprintf(header, header_size, "HTTP/1.1 400 Bad Request\r\nConnection: close\r\n\r\n");
         break;
     case 404:
-        fprintf(connection_file, "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
+        len = snprintf(header, header_size, "HTTP/1.1 404 Not Found\r\nConnection: close\r\n\r\n");
         break;
     case 501:
-        fprintf(connection_file, "HTTP/1.1 501 Not Implemented\r\nConnection: close\r\n\r\n");
+        len = snprintf(header, header_size, "HTTP/1.1 501 Not Implemented\r\nConnection: close\r\n\r\n");
         break;
     default:
         return -1;
         break;
     }
-    fflush(connection_file);
-    return 0;
+    if (len < 0 || (size_t)len >= header_size)
+        return -1;
+    return len;
 }
 
 static char *get_full_path(char *doc_root, char *requested_file, char *index_file)
@@ -407,26 +607,7 @@ static char *get_full_path(char *doc_root, char *requested_file, char *index_fil
     return full;
 }
 
-static bool get_request(char *line, char **method, char **resource_path)
-{
-    *method = strtok(line, " ");
-    *resource_path = strtok(NULL, " ");
-    char *http_v = strtok(NULL, " ");
-    if (*method == NULL || *resource_path == NULL || http_v == NULL)
-    {
-        printf("HERE");
-        return false;
-    }
-    if (strncmp(http_v, "HTTP/1.1", strlen("HTTP/1.1")) != 0)
-        return false;
-
-    if (strtok(NULL, " ") != NULL) // additional values given -> malformed request!
-        return false;
-
-    return true;
-}
-
-static int setup_socket(char *port)
+static int setup_socket(char *port, bool reuse_port)
 {
     struct addrinfo hints, *ai;
     memset(&hints, 0, sizeof(hints));
@@ -452,6 +633,11 @@ static int setup_socket(char *port)
         freeaddrinfo(ai);
         return -1;
     }
+    if (reuse_port && setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) < 0)
+    {
+        freeaddrinfo(ai);
+        return -1;
+    }
     if (bind(sockfd, ai->ai_addr, ai->ai_addrlen) < 0)
     {
         freeaddrinfo(ai);
@@ -485,6 +671,6 @@ static void handle_signal(int signal)
 
 static void usage(void)
 {
-    fprintf(stderr, "Usage: %s [-p PORT] [-i INDEX] DOC_ROOT \n", PROGRAM_NAME);
+    fprintf(stderr, "Usage: %s [-p PORT] [-i INDEX] [-c CACHE_BYTES] [-w WORKERS] [-t THREADS] DOC_ROOT \n", PROGRAM_NAME);
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
\ No newline at end of file
@@ -10,9 +10,17 @@
 
 #include "util.h"
 #include "gziputil.h" 
+#include "filecache.h"
+#include "httpparse.h"
+#include <sys/sendfile.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
 #include <signal.h>
+#include <sys/wait.h>
 
 #define DEFAULT_FILE "index.html" // default index file, if no other is specified
 #define DEFAULT_PORT "8080" // default port, if no other is specified
+#define MAX_WORKERS 1024    // maximum number of worker processes
+#define HEADER_SIZE 512     // size of the buffer a response header is formatted in
 
-#endif
\ No newline at end of file
+#endif
\ No newline at end of file
@@ -7,6 +7,14 @@
  * 
  * Implementation of a simple HTTP client with just the use of the C standard 
  * library.
+ * Several URLs can be fetched at once: a few worker threads take the URLs one
+ * after the other. Connections the server keeps alive are put back into a 
+ * pool of idle connections per host and resolved addresses are cached, so
+ * repeated requests to the same host skip both the DNS lookup and the
+ * handshake.
+ * With -v every transfer is timed, per URL and over the whole batch.
+ * With -2 HTTP/2 is spoken with prior knowledge instead: a worker takes all
+ * URLs of a host and requests them on streams of a single connection.
  */
 
 #include <stdlib.h>
@@ -15,11 +23,20 @@
 #include <stdbool.h>
 #include <assert.h>
 #include <string.h>
+#include <strings.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <getopt.h>
+#include <pthread.h>
+#include <time.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <sys/socket.h>
 #include <netdb.h>
-#include <zlib.h>
+
+#include "gzdecode.h"
+#include "h2.h"
 
 /**
  * Internal buffer size.
@@ -27,11 +44,152 @@
  **/
 #define BUFFER_SIZE 1024
 
+/**
+ * Maximum size of a response header.
+ **/
+#define HEADER_SIZE 8192
+
+/**
+ * Splice size.
+ * @brief The maximum number of bytes moved by one splice call, the default
+ * capacity of a pipe.
+ **/
+#define SPLICE_SIZE (64 * 1024)
+
+/**
+ * Default number of connections.
+ * @brief Number of URLs fetched at the same time if -c is not given.
+ **/
+#define DEFAULT_CONNECTIONS 4
+
+/**
+ * Maximum number of connections.
+ **/
+#define MAX_CONNECTIONS 64
+
+/**
+ * Lifetime of a resolved address.
+ * @brief getaddrinfo does not tell the TTL of the DNS record, so a cached 
+ * address is resolved again after this many seconds.
+ **/
+#define RESOLVE_TTL 60
+
+/**
+ * Number of hosts whose address is cached.
+ **/
+#define RESOLVE_CACHE_SIZE 16
+
+/**
+ * Flow control window of the HTTP/2 client.
+ * @brief The window of the connection and of every stream, given back once
+ * half of it is used, so the server rarely waits for a WINDOW_UPDATE.
+ **/
+#define H2_CLIENT_WINDOW (16 * 1024 * 1024)
+
+/**
+ * Streams opened before the server's SETTINGS arrived.
+ * @brief The limit is unknown until then and some servers reset streams
+ * above it, the first request may already be on its way though.
+ **/
+#define H2_DEFAULT_STREAMS 1
+
+/**
+ * Phases of a transfer.
+ * @brief Every phase is stamped when it ends, PHASE_START when the fetch
+ * begins.
+ **/
+enum phase
+{
+    PHASE_START,
+    PHASE_RESOLVED,
+    PHASE_CONNECTED,
+    PHASE_SENT,
+    PHASE_FIRST_BYTE,
+    PHASE_HEADERS,
+    PHASE_BODY,
+    PHASE_COUNT
+};
+
+/**
+ * Names of the phases.
+ * @brief The name of a phase describes the time since the previous stamp.
+ **/
+static const char *phase_names[PHASE_COUNT] = {
+    "start", "dns", "connect", "send", "wait", "header", "body"};
+
+/**
+ * Timing of a transfer.
+ * @brief The monotonic timestamps of the phases and the number of bytes
+ * received from the server. A reused connection needs neither a DNS lookup
+ * nor a handshake, so those phases take no time.
+ **/
+struct timing
+{
+    struct timespec at[PHASE_COUNT];
+    long long received;
+};
+
 /**
  * The name of the current program.
  */
 const char *prog_name;
 
+/**
+ * A resolved host.
+ * @brief The address is used for new connections until expires.
+ **/
+struct resolved
+{
+    char *host;
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    time_t expires;
+};
+
+/**
+ * A connection to a server.
+ * @brief After a response the connection is put into the pool of idle 
+ * connections, if the server allows it.
+ * @details Requests are written straight to fd. Response headers are read
+ * straight from fd too, bodies either through the buffered stream in or,
+ * spliced, from fd again. So the buffer of in is empty between responses.
+ **/
+struct connection
+{
+    char *host;
+    int fd;
+    FILE *in;
+    bool reusable;
+};
+
+/**
+ * A batch of URLs.
+ * @brief The URLs are shared by all workers, next is the index of the next
+ * URL to fetch (with -2 taken marks the URLs a worker already took for its
+ * host). The idle connections (oldest first) and the resolved 
+ * addresses are shared too. All three are protected by lock.
+ **/
+struct batch
+{
+    char **urls;
+    int *results;
+    struct timing *timings;
+    size_t count;
+    size_t next;
+    struct connection idle[MAX_CONNECTIONS];
+    size_t idle_count;
+    struct resolved resolved[RESOLVE_CACHE_SIZE];
+    size_t resolved_count;
+    pthread_mutex_t lock;
+    char *port;
+    char *filename;
+    char *dirname;
+    bool keep_alive;
+    bool timing;
+    bool h2;
+    bool *taken;
+};
+
 /**
  * Print usage.
  * @brief Print the usage of the client.
@@ -39,137 +197,240 @@ const char *prog_name;
  */
 static void usage(void)
 {
-    fprintf(stderr, "[%s] USAGE: %s [-p PORT] [-o FILE | -d DIR] URL\n",
+    fprintf(stderr,
+            "[%s] USAGE: %s [-p PORT] [-c CONNECTIONS] [-o FILE | -d DIR] "
+            "[-i LIST] [-v] [-2] URL...\n",
             prog_name, prog_name);
 }
 
 /**
- * @brief Copy a file.
- * @details Copies in chunks of the size BUFFER_SIZE.
- * @param dst The destination file.
- * @param src The source file.
+ * @brief Stamp the end of a phase.
+ * @param t The timing of the transfer.
+ * @param phase The phase that ended just now.
  */
-static void copy_file(FILE *dst, FILE *src)
+static void stamp(struct timing *t, enum phase phase)
 {
-    uint8_t buf[BUFFER_SIZE];
-    while (!feof(src))
+    clock_gettime(CLOCK_MONOTONIC, &t->at[phase]);
+}
+
+/**
+ * @brief Calculate the time between two stamps.
+ * @return The time from begin to end in milliseconds.
+ */
+static double elapsed_ms(const struct timespec *begin, const struct timespec *end)
+{
+    return (end->tv_sec - begin->tv_sec) * 1e3 +
+           (end->tv_nsec - begin->tv_nsec) / 1e6;
+}
+
+/**
+ * @brief Calculate a throughput.
+ * @return The throughput in MB/s, 0 if no time passed.
+ */
+static double throughput(long long bytes, double ms)
+{
+    return ms > 0 ? bytes / (ms * 1e3) : 0;
+}
+
+/**
+ * @brief Calculate how much to read next.
+ * @param length The number of bytes left or -1 if unknown.
+ * @return The number of bytes to read, at most BUFFER_SIZE.
+ */
+static size_t next_read(long long length)
+{
+    if (length >= 0 && length < BUFFER_SIZE)
     {
-        size_t read = fread(buf, sizeof(uint8_t), BUFFER_SIZE, src);
-        fwrite(buf, sizeof(uint8_t), read, dst);
+        return length;
     }
+    return BUFFER_SIZE;
 }
 
 /**
- * @brief Compy a file and gzip decompress it on the way.
+ * @brief Copy a file.
  * @details Copies in chunks of the size BUFFER_SIZE.
  * @param dst The destination file.
  * @param src The source file.
+ * @param length The number of bytes to copy or -1 to copy until the end of 
+ * src.
+ * @param received Incremented by the number of bytes read from src.
+ * @return 0 if all bytes were copied, otherwise -1.
  */
-static void copy_compressed_file(FILE *dst, FILE *src)
+static int copy_file(FILE *dst, FILE *src, long long length,
+                     long long *received)
 {
-    // Open the source file with zlib
-    int fd = dup(fileno(src));
-    gzFile gzsrc = gzdopen(fd, "r");
-    if (gzsrc == NULL)
-    {
-        fprintf(stderr, "gzdopen failed\n");
-        return;
-    }
-
     uint8_t buf[BUFFER_SIZE];
-    while (!gzeof(gzsrc))
+    while (length != 0 && !feof(src) && !ferror(src))
     {
-        size_t read = gzread(gzsrc, buf, BUFFER_SIZE);
-        if (read == -1)
+        size_t read = fread(buf, sizeof(uint8_t), next_read(length), src);
+        fwrite(buf, sizeof(uint8_t), read, dst);
+        *received += read;
+        if (length > 0)
         {
-            fprintf(stderr, "gzfread failed\n");
-            break;
+            length -= read;
         }
-        fwrite(buf, sizeof(uint8_t), read, dst);
     }
-    gzclose(gzsrc);
+    return length > 0 ? -1 : 0;
 }
 
 /**
- * @brief Copy a compressed and chunk-encoded file.
- * @details May use the global variable prog_name and will write to stderr on 
- * failure.
+ * @brief Move a body from a socket to a file without copying it.
+ * @details splice needs a pipe on one end, so the bytes go from the socket
+ * into a pipe and from there into the file, all inside the kernel. Only 
+ * works if dst is a regular file and nothing of the body was read from src 
+ * already. If the file system can't splice, the bytes already in the pipe are
+ * written to dst and the caller has to copy the rest.
  * @param dst The destination file.
- * @param src The source file.
+ * @param src The socket to read from.
+ * @param length The number of bytes to move or -1 to move until the end of 
+ * src, updated to the number of bytes left.
+ * @param received Incremented by the number of bytes read from src.
+ * @return 0 if all bytes were moved, 1 if splice can't be used for dst and
+ * otherwise -1.
  */
-static void copy_chunked_compressed_file(FILE *dst, FILE *src)
+static int splice_file(FILE *dst, int src, long long *length,
+                       long long *received)
 {
-    while (true)
+    struct stat st;
+    if (fstat(fileno(dst), &st) == -1 || !S_ISREG(st.st_mode))
     {
-        // Read the chunk size
-        char hex_size[10];
-        int hex_size_len = 0;
-        for (hex_size_len = 0; hex_size_len < 10; hex_size_len++)
+        return 1;
+    }
+    int pipefd[2];
+    if (pipe(pipefd) == -1)
+    {
+        return 1;
+    }
+    fflush(dst);
+
+    int ret = 0;
+    while (*length != 0 && ret == 0)
+    {
+        size_t want = SPLICE_SIZE;
+        if (*length > 0 && *length < SPLICE_SIZE)
         {
-            fread(hex_size + hex_size_len, sizeof(char), 1, src);
-            if (hex_size[hex_size_len] == '\n')
-            {
-                break;
-            }
+            want = *length;
         }
-        char *endptr;
-        long size = strtol(hex_size, &endptr, 16);
-        if (endptr != hex_size + (hex_size_len - 1))
+        ssize_t in = splice(src, NULL, pipefd[1], NULL, want,
+                            SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (in == -1 && errno == EINTR)
         {
-            fprintf(stderr, "strtol failed\n");
-            return;
+            continue;
         }
-        if (size == 0)
+        if (in <= 0)
         {
-            // This is the idicator that the response ended
+            // The end of the body without a length is the end of src
+            ret = in == 0 && *length < 0 ? 0 : -1;
             break;
         }
-
-        uint8_t chunk[size];
-        fread(chunk, sizeof(uint8_t), size, src);
-
-        // Decompress the chunk
-        z_stream stream;
-        stream.zalloc = Z_NULL;
-        stream.zfree = Z_NULL;
-        stream.opaque = Z_NULL;
-        int err = inflateInit2(&stream, 16 + MAX_WBITS);
-        if (err != Z_OK)
+        *received += in;
+        if (*length > 0)
         {
-            fprintf(stderr, "[%s] ERROR: Decompression Init returned: %d\n",
-                    prog_name, err);
-            return;
+            *length -= in;
         }
-        stream.next_in = chunk;
-        stream.avail_in = size;
-        uint8_t output[size];
 
-        // Read some bytes and write them to the output file
-        while (stream.avail_in > 0)
+        while (in > 0)
         {
-            stream.next_out = output;
-            stream.avail_out = size;
-            err = inflate(&stream, true);
-            if (err < 0)
+            ssize_t out = splice(pipefd[0], NULL, fileno(dst), NULL, in,
+                                 SPLICE_F_MOVE | SPLICE_F_MORE);
+            if (out == -1 && errno == EINTR)
+            {
+                continue;
+            }
+            if (out == -1 && errno == EINVAL)
             {
-                fprintf(stderr, "[%s] ERROR: Decompression returned: %d\n",
-                        prog_name, err);
-                return;
+                // Not every file system supports splice, empty the pipe
+                uint8_t buf[BUFFER_SIZE];
+                while (in > 0)
+                {
+                    ssize_t n = read(pipefd[0], buf,
+                                     in < BUFFER_SIZE ? in : BUFFER_SIZE);
+                    if (n <= 0)
+                    {
+                        break;
+                    }
+                    fwrite(buf, sizeof(uint8_t), n, dst);
+                    in -= n;
+                }
+                ret = in == 0 ? 1 : -1;
+                break;
+            }
+            if (out <= 0)
+            {
+                ret = -1;
+                break;
             }
-            fwrite(output, sizeof(uint8_t), size - stream.avail_out, dst);
+            in -= out;
         }
-        inflateEnd(&stream);
+    }
 
-        // Read the chunk end
-        uint8_t chunkend[2];
-        fread(chunkend, sizeof(uint8_t), 2, src);
-        if (chunkend[0] != '\r' || chunkend[1] != '\n')
-        {
-            fprintf(stderr, "[%s] WARNING: Chunk ended wrong: %x %x\n",
-                    prog_name, chunkend[0], chunkend[1]);
-            return;
-        }
+    close(pipefd[0]);
+    close(pipefd[1]);
+    return ret;
+}
+
+/**
+ * A socket read by the body decoder.
+ * @brief Counts the bytes read, before they are decompressed.
+ **/
+struct counted_socket
+{
+    int fd;
+    long long *received;
+};
+
+/**
+ * @brief Read from a socket for the body decoder.
+ * @param source A pointer to the counted_socket.
+ * @param buf The buffer to read into.
+ * @param len The size of the buffer.
+ * @return The same as read.
+ */
+static ssize_t read_socket(void *source, void *buf, size_t len)
+{
+    struct counted_socket *sock = source;
+    ssize_t n = read(sock->fd, buf, len);
+    if (n > 0)
+    {
+        *sock->received += n;
+    }
+    return n;
+}
+
+/**
+ * @brief Copy a body and decompress it on the way.
+ * @details The body is read directly from the socket, so nothing of it may
+ * be buffered in the FILE of the connection. Only reads the body, so the
+ * connection can be used for another response afterwards. May use the global
+ * variable prog_name and will write to stderr on failure.
+ * @param dst The destination file.
+ * @param src The socket to read from.
+ * @param encoding The content coding of the body.
+ * @param chunked Whether the body is chunk-encoded.
+ * @param length The number of compressed bytes or -1 to read until the end 
+ * of src, ignored if the body is chunked.
+ * @param received Incremented by the number of bytes read from src.
+ * @return 0 if the whole body was copied, otherwise -1.
+ */
+static int copy_compressed_file(FILE *dst, int src, enum encoding encoding,
+                                bool chunked, long long length,
+                                long long *received)
+{
+    if (fflush(dst) == EOF)
+    {
+        return -1;
+    }
+    struct counted_socket sock = {.fd = src, .received = received};
+    enum gzdecode_result result =
+        gzdecode_copy(fileno(dst), read_socket, &sock, encoding, chunked,
+                      length);
+    if (result != GZDECODE_OK)
+    {
+        fprintf(stderr, "[%s] ERROR: Decompression failed: %s\n",
+                prog_name, gzdecode_strerror(result));
+        return -1;
     }
+    return 0;
 }
 
 /**
@@ -276,104 +537,359 @@ static FILE *open_output(char *file, char *dir, char *res)
 }
 
 /**
- * @brief Create a connection to the server, so that this client can send
- * the server a request to the server.
- * @details This function does just create the connection but does not send 
- * any request to the server.
+ * @brief Resolve a host.
+ * @details The address is taken from the cache of the batch if it was
+ * resolved less than RESOLVE_TTL seconds ago, otherwise getaddrinfo is
+ * called (without holding the lock) and the result is cached, replacing the
+ * entry that expires first if the cache is full.
  * This function will write to stderr error messages if an error occours.
- * @param host The host as a string to connect to.
- * @param port The port as a string to connect to.
- * @return Upon success a file to send the request to, otherwiese NULL.
+ * @param b The batch with the cache.
+ * @param host The host to resolve.
+ * @param addr The destination to save the address.
+ * @param addrlen The destination to save the length of the address.
+ * @return Upon success 0, otherwise -1.
  */
-static FILE *create_connection(char *host, char *port)
+static int resolve(struct batch *b, char *host, struct sockaddr_storage *addr,
+                   socklen_t *addrlen)
 {
+    time_t now = time(NULL);
+    pthread_mutex_lock(&b->lock);
+    for (size_t i = 0; i < b->resolved_count; i++)
+    {
+        struct resolved *r = &b->resolved[i];
+        if (r->expires > now && strcmp(r->host, host) == 0)
+        {
+            *addr = r->addr;
+            *addrlen = r->addrlen;
+            pthread_mutex_unlock(&b->lock);
+            return 0;
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+
     struct addrinfo hints, *ai;
     memset(&hints, 0, sizeof(hints));
     hints.ai_family = AF_INET;
     hints.ai_socktype = SOCK_STREAM;
 
     int ai_err;
-    if ((ai_err = getaddrinfo(host, port, &hints, &ai)) != 0)
+    if ((ai_err = getaddrinfo(host, b->port, &hints, &ai)) != 0)
     {
         fprintf(stderr, "[%s] ERROR: Unable to get addr info: %s\n",
                 prog_name, gai_strerror(ai_err));
-        return NULL;
+        return -1;
+    }
+    memcpy(addr, ai->ai_addr, ai->ai_addrlen);
+    *addrlen = ai->ai_addrlen;
+    freeaddrinfo(ai);
+
+    // Cache the address, an entry of the same host can only be expired
+    char *copy = strdup(host);
+    if (copy == NULL)
+    {
+        return 0;
+    }
+    pthread_mutex_lock(&b->lock);
+    struct resolved *r = NULL;
+    for (size_t i = 0; i < b->resolved_count; i++)
+    {
+        if (strcmp(b->resolved[i].host, host) == 0)
+        {
+            r = &b->resolved[i];
+            break;
+        }
+        if (r == NULL || b->resolved[i].expires < r->expires)
+        {
+            r = &b->resolved[i];
+        }
+    }
+    if (b->resolved_count < RESOLVE_CACHE_SIZE &&
+        (r == NULL || strcmp(r->host, host) != 0))
+    {
+        r = &b->resolved[b->resolved_count++];
+    }
+    else
+    {
+        free(r->host);
     }
+    r->host = copy;
+    r->addr = *addr;
+    r->addrlen = *addrlen;
+    r->expires = now + RESOLVE_TTL;
+    pthread_mutex_unlock(&b->lock);
+    return 0;
+}
 
-    int sockfd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+/**
+ * @brief Create a connection to the server, so that this client can send
+ * the server a request to the server.
+ * @details This function does just create the connection but does not send
+ * any request to the server.
+ * This function will write to stderr error messages if an error occours.
+ * @param addr The address to connect to.
+ * @param addrlen The length of the address.
+ * @return Upon success the socket to send the request to, otherwiese -1.
+ */
+static int create_connection(struct sockaddr_storage *addr, socklen_t addrlen)
+{
+    int sockfd = socket(addr->ss_family, SOCK_STREAM, 0);
     if (sockfd == -1)
     {
         fprintf(stderr, "[%s] ERROR: Unable to create a socket: %s\n",
                 prog_name, strerror(errno));
-        freeaddrinfo(ai);
-        return NULL;
+        return -1;
     }
 
-    if (connect(sockfd, ai->ai_addr, ai->ai_addrlen) == -1)
+    if (connect(sockfd, (struct sockaddr *)addr, addrlen) == -1)
     {
         fprintf(stderr, "[%s] ERROR: Unable to connect: %s\n",
                 prog_name, strerror(errno));
-        freeaddrinfo(ai);
-        return NULL;
+        close(sockfd);
+        return -1;
+    }
+
+    return sockfd;
+}
+
+/**
+ * @brief Close a connection.
+ * @param conn The connection to close, it may be closed already.
+ */
+static void close_connection(struct connection *conn)
+{
+    if (conn->in != NULL)
+    {
+        // Closes fd as well
+        fclose(conn->in);
+    }
+    free(conn->host);
+    conn->host = NULL;
+    conn->in = NULL;
+    conn->fd = -1;
+    conn->reusable = false;
+}
+
+/**
+ * @brief Open a connection to a host.
+ * @details This function will write to stderr error messages if an error
+ * occours.
+ * @param b The batch with the resolved addresses.
+ * @param conn The connection to open, it must be closed.
+ * @param host The host as a string to connect to.
+ * @param t The timing of the transfer, the lookup and the handshake are
+ * stamped.
+ * @return Upon success 0, otherwise -1.
+ */
+static int open_connection(struct batch *b, struct connection *conn,
+                           char *host, struct timing *t)
+{
+    struct sockaddr_storage addr;
+    socklen_t addrlen;
+    if (resolve(b, host, &addr, &addrlen) == -1)
+    {
+        return -1;
     }
+    stamp(t, PHASE_RESOLVED);
+    conn->fd = create_connection(&addr, addrlen);
+    if (conn->fd == -1)
+    {
+        return -1;
+    }
+    stamp(t, PHASE_CONNECTED);
 
-    FILE *sockfile = fdopen(sockfd, "r+");
-    if (sockfile == NULL)
+    conn->in = fdopen(conn->fd, "r");
+    conn->host = strdup(host);
+    if (conn->in == NULL || conn->host == NULL)
     {
         fprintf(stderr, "[%s] ERROR: Unable to fdopen: %s\n",
                 prog_name, strerror(errno));
-        freeaddrinfo(ai);
-        return NULL;
+        if (conn->in == NULL)
+        {
+            close(conn->fd);
+        }
+        close_connection(conn);
+        return -1;
     }
-    setvbuf(sockfile, NULL, _IONBF, 0);
+    conn->reusable = false;
+    return 0;
+}
 
-    freeaddrinfo(ai);
-    return sockfile;
+/**
+ * @brief Take an idle connection to a host out of the pool.
+ * @details The most recently used connection is taken, as it is the least
+ * likely to be closed by the server already.
+ * @param b The batch with the pool.
+ * @param host The host the connection has to be open to.
+ * @param conn The destination to save the connection.
+ * @return true if there was an idle connection, otherwise false.
+ */
+static bool take_connection(struct batch *b, char *host,
+                            struct connection *conn)
+{
+    bool found = false;
+    pthread_mutex_lock(&b->lock);
+    for (size_t i = b->idle_count; i-- > 0;)
+    {
+        if (strcmp(b->idle[i].host, host) == 0)
+        {
+            *conn = b->idle[i];
+            memmove(&b->idle[i], &b->idle[i + 1],
+                    (b->idle_count - i - 1) * sizeof(struct connection));
+            b->idle_count--;
+            found = true;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+    return found;
+}
+
+/**
+ * @brief Put a connection into the pool of idle connections.
+ * @details If the pool is full, the oldest idle connection is closed.
+ * @param b The batch with the pool.
+ * @param conn The connection, it belongs to the pool afterwards.
+ */
+static void put_connection(struct batch *b, struct connection *conn)
+{
+    struct connection oldest = {.host = NULL, .fd = -1, .in = NULL};
+    pthread_mutex_lock(&b->lock);
+    if (b->idle_count == MAX_CONNECTIONS)
+    {
+        oldest = b->idle[0];
+        memmove(&b->idle[0], &b->idle[1],
+                (MAX_CONNECTIONS - 1) * sizeof(struct connection));
+        b->idle_count--;
+    }
+    b->idle[b->idle_count++] = *conn;
+    pthread_mutex_unlock(&b->lock);
+    close_connection(&oldest);
 }
 
 /**
  * @brief Send a HTTP/1.1 GET request to a server.
- * @details This function sends a complete request to the server and after this 
- * call conn_file should not be written to.
- * @param conn_file A file to wirte the request to.
+ * @details This function sends a complete request to the server.
+ * @param fd The socket to wirte the request to.
  * @param host The hostname as a string.
  * @param resource The resource to request.
+ * @param keep_alive Whether the connection should stay open afterwards.
  */
-static void send_request(FILE *conn_file, char *host, char *resource)
+static void send_request(int fd, char *host, char *resource, bool keep_alive)
 {
-    fprintf(conn_file, "\
+    dprintf(fd, "\
 GET %s HTTP/1.1\r\n\
 Host: %s\r\n\
-Accept-Encoding: gzip\r\n\
-Connection: close\r\n\r\n",
+Accept-Encoding: %s\r\n\
+Connection: %s\r\n\r\n",
             resource,
-            host);
-    fflush(conn_file);
+            host,
+            encoding_accept_header(),
+            keep_alive ? "keep-alive" : "close");
+}
+
+/**
+ * @brief Read a response header from a socket.
+ * @details Peeks at the received bytes and only consumes them up to the 
+ * empty line ending the header, so the body stays in the socket.
+ * @param fd The socket to read from.
+ * @param buf The destination for the header.
+ * @param size The size of buf.
+ * @param t The timing of the transfer, the first byte is stamped.
+ * @return The length of the header, 0 if the connection was closed before 
+ * anything was received and -1 on errors or if the header does not fit into
+ * buf.
+ */
+static ssize_t read_header(int fd, char *buf, size_t size, struct timing *t)
+{
+    size_t len = 0;
+    while (len < size)
+    {
+        ssize_t n = recv(fd, buf + len, size - len, MSG_PEEK);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return n == 0 && len == 0 ? 0 : -1;
+        }
+        if (len == 0)
+        {
+            stamp(t, PHASE_FIRST_BYTE);
+        }
+
+        // The empty line may begin in the bytes consumed already
+        size_t end = 0;
+        for (size_t i = len >= 3 ? len - 3 : 0; i + 4 <= len + n; i++)
+        {
+            if (memcmp(buf + i, "\r\n\r\n", 4) == 0)
+            {
+                end = i + 4;
+                break;
+            }
+        }
+
+        size_t take = end > 0 ? end - len : (size_t)n;
+        if (recv(fd, buf + len, take, MSG_WAITALL) != (ssize_t)take)
+        {
+            return -1;
+        }
+        len += take;
+        if (end > 0)
+        {
+            return len;
+        }
+    }
+    return -1;
 }
 
 /**
  * @brief Parse the response from the server and wirte the payload to a file. 
- * In the case the server send a gziped or chunk-encoded payload this function 
+ * In the case the server send a compressed or chunk-encoded payload this function 
  * will decode it before writing it.
  * @details May write errors to stderr.
+ * Uncompressed bodies are spliced into regular files.
  * @param out_file The file to write the payload to.
- * @param conn_file A file to read the request from.
+ * @param conn The connection to read the response from, reusable is set to
+ * whether the response was read completely and the server keeps the 
+ * connection open, so it can be used for another request.
+ * @param t The timing of the transfer, the phases from the first byte on are
+ * stamped and the bytes received are counted.
  * @return Upon success 0, in case of HTTP/1.1 violations 2, in case the server
  * responded with a non 200 status 3 and otherwise 1.
  */
-static int read_response(FILE *out_file, FILE *conn_file)
+static int read_response(FILE *out_file, struct connection *conn,
+                         struct timing *t)
 {
+    conn->reusable = false;
+    FILE *conn_file = conn->in;
+
+    // The header is parsed from memory, so the body is still in the socket
+    char header[HEADER_SIZE];
+    ssize_t header_len = read_header(conn->fd, header, sizeof(header), t);
+    FILE *header_file = NULL;
+    if (header_len > 0)
+    {
+        stamp(t, PHASE_HEADERS);
+        t->received += header_len;
+        header_file = fmemopen(header, header_len, "r");
+    }
+
     size_t cap = 0;
     char *line = NULL;
 
     // Read and parse the first line as it contains special information that
     // must be parsed
-    if (getline(&line, &cap, conn_file) == -1)
+    if (header_file == NULL || getline(&line, &cap, header_file) == -1)
     {
         // No line was sent by the server
         fprintf(stderr, "[%s] ERROR: Protocol error!\n",
                 prog_name);
         free(line);
+        if (header_file != NULL)
+        {
+            fclose(header_file);
+        }
         return 2;
     }
 
@@ -385,6 +901,7 @@ static int read_response(FILE *out_file, FILE *conn_file)
         fprintf(stderr, "[%s] ERROR: Protocol error!\n",
                 prog_name);
         free(line);
+        fclose(header_file);
         return 2;
     }
 
@@ -395,6 +912,7 @@ static int read_response(FILE *out_file, FILE *conn_file)
         fprintf(stderr, "[%s] ERROR: Protocol error!\n",
                 prog_name);
         free(line);
+        fclose(header_file);
         return 2;
     }
 
@@ -407,6 +925,7 @@ static int read_response(FILE *out_file, FILE *conn_file)
                 prog_name);
 
         free(line);
+        fclose(header_file);
         return 2;
     }
 
@@ -416,19 +935,23 @@ static int read_response(FILE *out_file, FILE *conn_file)
         fprintf(stderr, "[%s] STATUS: %s %s\n",
                 prog_name, status_code, status_text);
         free(line);
+        fclose(header_file);
         return 3;
     }
 
     // Read the rest of the headers line by line
-    bool is_compressed = false;
+    enum encoding encoding = ENCODING_IDENTITY;
     bool is_chunked = false;
+    bool is_closing = false;
+    long long length = -1;
     while (true)
     {
-        if (getline(&line, &cap, conn_file) == -1)
+        if (getline(&line, &cap, header_file) == -1)
         {
             fprintf(stderr, "[%s] ERROR: No content.\n",
                     prog_name);
             free(line);
+            fclose(header_file);
             return 1;
         };
 
@@ -437,9 +960,18 @@ static int read_response(FILE *out_file, FILE *conn_file)
             break;
         }
 
-        if (strncmp(line, "Content-Encoding: gzip", strlen("Content-Encoding: gzip")) == 0)
+        if (strncasecmp(line, "Content-Encoding:", strlen("Content-Encoding:")) == 0)
         {
-            is_compressed = true;
+            char *value = line + strlen("Content-Encoding:");
+            encoding = encoding_from_name(value, strcspn(value, "\r\n"));
+            if (encoding == ENCODING_COUNT)
+            {
+                fprintf(stderr, "[%s] ERROR: Unsupported content encoding:%s",
+                        prog_name, value);
+                free(line);
+                fclose(header_file);
+                return 1;
+            }
         }
 
         if (strncmp(line, "Transfer-Encoding", strlen("Transfer-Encoding")) == 0 &&
@@ -447,44 +979,1173 @@ static int read_response(FILE *out_file, FILE *conn_file)
         {
             is_chunked = true;
         }
+
+        if (strncasecmp(line, "Content-Length:", strlen("Content-Length:")) == 0)
+        {
+            length = strtoll(line + strlen("Content-Length:"), NULL, 10);
+        }
+
+        if (strncasecmp(line, "Connection:", strlen("Connection:")) == 0 &&
+            strstr(line, "close") != NULL)
+        {
+            is_closing = true;
+        }
     }
     free(line);
+    fclose(header_file);
 
     // Read the rest of the response as binary data
-    if (is_compressed && is_chunked)
+    bool is_compressed = encoding != ENCODING_IDENTITY;
+    int ret;
+    if (is_compressed)
     {
-        copy_chunked_compressed_file(out_file, conn_file);
+        ret = copy_compressed_file(out_file, conn->fd, encoding, is_chunked,
+                                   length, &t->received);
     }
-    else if (is_compressed)
+    else if (is_chunked)
     {
-        copy_compressed_file(out_file, conn_file);
+        ret = copy_file(out_file, conn_file, -1, &t->received);
     }
     else
     {
-        copy_file(out_file, conn_file);
+        // Plain bodies go straight from the socket into the file
+        ret = splice_file(out_file, conn->fd, &length, &t->received);
+        if (ret == 1)
+        {
+            ret = copy_file(out_file, conn_file, length, &t->received);
+        }
     }
+    stamp(t, PHASE_BODY);
 
+    // Without a length (or chunks) the body ended with the connection
+    bool delimited = (is_chunked && is_compressed) || (!is_chunked && length >= 0);
+    conn->reusable = ret == 0 && delimited && !is_closing && !ferror(conn_file);
     return 0;
 }
 
 /**
- * @brief The entrypoint of the client. Execution of the client always starts
- * and ends here.
- * @details Uses the global variable prog_name.
- * @param argc The argument counter
- * @param argc The argument vector
- * @return Upon success EXIT_SUCCESS, on HTTP protocol violation 2, upon 
- * unsuccessful requests 3 and on all other errors EXIT_FAILURE.
+ * @brief Print the timing of a transfer.
+ * @details Prints the time every phase took and the throughput from the
+ * start of the fetch to the end of the body to stderr.
+ * @param url The URL that was fetched.
+ * @param t The timing of the completed transfer.
  */
-int main(int argc, char *argv[])
+static void print_timing(char *url, struct timing *t)
 {
-    prog_name = argv[0];
-    bool has_p = false;
-    char *port = "80";
-    char *filename = NULL;
-    char *dirname = NULL;
-    int c;
-    while ((c = getopt(argc, argv, "p:o:d:")) != -1)
+    char phases[PHASE_COUNT * 32] = "";
+    size_t len = 0;
+    for (int p = PHASE_START + 1; p < PHASE_COUNT; p++)
+    {
+        len += snprintf(phases + len, sizeof(phases) - len, "%s %.3f ",
+                        phase_names[p], elapsed_ms(&t->at[p - 1], &t->at[p]));
+    }
+    double total = elapsed_ms(&t->at[PHASE_START], &t->at[PHASE_BODY]);
+    fprintf(stderr, "[%s] TIMING: %s: %stotal %.3f ms, %lld bytes, "
+                    "%.2f MB/s\n",
+            prog_name, url, phases, total, t->received,
+            throughput(t->received, total));
+}
+
+/**
+ * @brief Compare two doubles for qsort.
+ */
+static int compare_double(const void *a, const void *b)
+{
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Print the timing of a whole batch.
+ * @details Prints the median, the 90th and 99th percentile and the maximum
+ * of every phase over the successful transfers, and the bytes received by
+ * all of them together with the throughput over the time the batch took to
+ * stderr.
+ * @param b The batch, all of its URLs are fetched.
+ * @param begin The time the batch started.
+ * @param end The time the last worker finished.
+ */
+static void print_batch_timing(struct batch *b, struct timespec *begin,
+                               struct timespec *end)
+{
+    double *values = malloc(b->count * sizeof(double));
+    if (values == NULL)
+    {
+        return;
+    }
+
+    // The phases, and last the total of every transfer
+    long long received = 0;
+    size_t done = 0;
+    for (int p = PHASE_START + 1; p <= PHASE_COUNT; p++)
+    {
+        done = 0;
+        received = 0;
+        for (size_t i = 0; i < b->count; i++)
+        {
+            if (b->results[i] != 0)
+            {
+                continue;
+            }
+            struct timing *t = &b->timings[i];
+            values[done++] = p < PHASE_COUNT
+                                 ? elapsed_ms(&t->at[p - 1], &t->at[p])
+                                 : elapsed_ms(&t->at[PHASE_START], &t->at[PHASE_BODY]);
+            received += t->received;
+        }
+        if (done == 0)
+        {
+            break;
+        }
+
+        // Nearest rank percentiles
+        qsort(values, done, sizeof(double), compare_double);
+        fprintf(stderr, "[%s] TIMING: %-7s p50 %.3f p90 %.3f p99 %.3f "
+                        "max %.3f ms\n",
+                prog_name, p < PHASE_COUNT ? phase_names[p] : "total",
+                values[(50 * done + 99) / 100 - 1],
+                values[(90 * done + 99) / 100 - 1],
+                values[(99 * done + 99) / 100 - 1], values[done - 1]);
+    }
+    free(values);
+
+    double wall = elapsed_ms(begin, end);
+    fprintf(stderr, "[%s] TIMING: %zu of %zu transfers, %lld bytes in "
+                    "%.3f ms, %.2f MB/s\n",
+            prog_name, done, b->count, received, wall,
+            throughput(received, wall));
+}
+
+/**
+ * @brief Fetch one URL and write the payload to its output file.
+ * @details Takes an idle connection to the host out of the pool if there is
+ * one. An idle connection may have been closed by the server in the
+ * meantime, in that case the request is sent again on a new connection.
+ * Afterwards the connection is put back into the pool if the server keeps it
+ * open. May use the global variable prog_name and will write to stderr on
+ * failure.
+ * @param b The batch the URL belongs to.
+ * @param url The URL to fetch.
+ * @param t The destination for the timing of the transfer.
+ * @return The same codes as read_response.
+ */
+static int fetch(struct batch *b, char *url, struct timing *t)
+{
+    memset(t, 0, sizeof(*t));
+    stamp(t, PHASE_START);
+
+    // Parse the url
+    size_t url_len = strlen(url);
+    char url_host[url_len + 1];
+    char url_resource[url_len + 2];
+    if (parse_url(url_host, url_resource, url) == -1)
+    {
+        return EXIT_FAILURE;
+    }
+
+    // Create the output file
+    FILE *out_file = open_output(b->filename, b->dirname, url_resource);
+    if (out_file == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to open output file: %s\n",
+                prog_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    struct connection conn = {.host = NULL, .fd = -1, .in = NULL, .reusable = false};
+    bool reused = take_connection(b, url_host, &conn);
+    if (reused)
+    {
+        t->at[PHASE_RESOLVED] = t->at[PHASE_START];
+        t->at[PHASE_CONNECTED] = t->at[PHASE_START];
+    }
+    else if (open_connection(b, &conn, url_host, t) == -1)
+    {
+        fclose(out_file);
+        return EXIT_FAILURE;
+    }
+
+    // Send the request
+    send_request(conn.fd, url_host, url_resource, b->keep_alive);
+    stamp(t, PHASE_SENT);
+    if (reused)
+    {
+        char c;
+        if (recv(conn.fd, &c, 1, MSG_PEEK) <= 0)
+        {
+            close_connection(&conn);
+            if (open_connection(b, &conn, url_host, t) == -1)
+            {
+                fclose(out_file);
+                return EXIT_FAILURE;
+            }
+            send_request(conn.fd, url_host, url_resource, b->keep_alive);
+            stamp(t, PHASE_SENT);
+        }
+    }
+
+    // Read the response
+    int exit_code = read_response(out_file, &conn, t);
+    if (exit_code == 0 && conn.reusable)
+    {
+        put_connection(b, &conn);
+    }
+    else
+    {
+        close_connection(&conn);
+    }
+    fclose(out_file);
+    if (b->timing && exit_code == 0)
+    {
+        print_timing(url, t);
+    }
+    return exit_code;
+}
+
+/**
+ * @brief Check whether two URLs name the same host (and port).
+ * @details URLs without the http scheme never match, so they are fetched on
+ * their own and fail there.
+ */
+static bool same_host(const char *a, const char *b)
+{
+    if (strncmp(a, "http://", 7) != 0 || strncmp(b, "http://", 7) != 0)
+    {
+        return false;
+    }
+    size_t len = strcspn(a + 7, "/?");
+    return len == strcspn(b + 7, "/?") && strncmp(a + 7, b + 7, len) == 0;
+}
+
+/**
+ * @brief Take all URLs of the next host.
+ * @details Takes the first URL no worker has taken yet and every other URL 
+ * of its host, so each host is fetched over one HTTP/2 connection.
+ * @param b The batch.
+ * @param indices The destination for the indices of the URLs.
+ * @return The number of URLs taken, 0 if all URLs are taken.
+ */
+static size_t take_host(struct batch *b, size_t *indices)
+{
+    size_t count = 0;
+    pthread_mutex_lock(&b->lock);
+    while (b->next < b->count && b->taken[b->next])
+    {
+        b->next++;
+    }
+    for (size_t i = b->next; i < b->count; i++)
+    {
+        if (!b->taken[i] &&
+            (count == 0 || same_host(b->urls[indices[0]], b->urls[i])))
+        {
+            b->taken[i] = true;
+            indices[count++] = i;
+        }
+    }
+    pthread_mutex_unlock(&b->lock);
+    return count;
+}
+
+/**
+ * An URL fetched over HTTP/2.
+ * @brief The stream of the URL and the state of its response.
+ * @details id is 0 while no stream is open for the URL. Compressed bodies 
+ * are collected in body and decoded once the stream ended, uncompressed ones
+ * are written to out right away. unacked counts the bytes received since
+ * the last WINDOW_UPDATE of the stream.
+ **/
+struct h2_transfer
+{
+    size_t index;
+    char *resource;
+    FILE *out;
+    struct timing *t;
+    uint32_t id;
+    bool done;
+    bool responded;
+    int result;
+    enum encoding encoding;
+    uint8_t *body;
+    size_t body_len;
+    size_t body_cap;
+    int64_t unacked;
+};
+
+/**
+ * A HTTP/2 connection of the client.
+ * @brief The header decoder, the settings of the server and the streams
+ * that may still be opened.
+ * @details After GOAWAY no streams are opened anymore. Once the server
+ * refused a stream, no more streams than were open at that time are opened
+ * at once (refused_limit), as the server counts them differently. A header
+ * block is collected in block until its last CONTINUATION frame.
+ **/
+struct h2_session
+{
+    int fd;
+    struct h2_hpack hpack;
+    struct h2_settings peer;
+    bool settings;
+    uint32_t next_id;
+    bool goaway;
+    uint32_t last_id;
+    size_t active;
+    size_t refused_limit;
+    int64_t unacked;
+    uint8_t *block;
+    size_t block_len;
+    uint32_t block_stream;
+    bool block_end;
+};
+
+/**
+ * @brief Send a buffer completely.
+ * @return Upon success 0, otherwise -1.
+ */
+static int send_all(int fd, const void *buf, size_t len)
+{
+    size_t sent = 0;
+    while (sent < len)
+    {
+        ssize_t n = send(fd, (const uint8_t *)buf + sent, len - sent,
+                         MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -1;
+        }
+        sent += n;
+    }
+    return 0;
+}
+
+/**
+ * @brief Send a WINDOW_UPDATE frame.
+ * @return Upon success 0, otherwise -1.
+ */
+static int send_window_update(int fd, uint32_t stream, uint32_t increment)
+{
+    uint8_t frame[H2_FRAME_HEADER + 4];
+    h2_write_frame(frame, 4, H2_WINDOW_UPDATE, 0, stream);
+    h2_put32(frame + H2_FRAME_HEADER, increment);
+    return send_all(fd, frame, sizeof(frame));
+}
+
+/**
+ * @brief Receive exactly len bytes.
+ * @return Upon success 0, otherwise -1 (also at the end of the connection).
+ */
+static int recv_all(int fd, void *buf, size_t len)
+{
+    size_t got = 0;
+    while (got < len)
+    {
+        ssize_t n = recv(fd, (uint8_t *)buf + got, len - got, 0);
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -1;
+        }
+        got += n;
+    }
+    return 0;
+}
+
+/**
+ * A body in memory read by the body decoder.
+ **/
+struct memory_source
+{
+    const uint8_t *data;
+    size_t len;
+    size_t pos;
+};
+
+/**
+ * @brief Read from a body in memory for the body decoder.
+ * @param source A pointer to the memory_source.
+ * @param buf The buffer to read into.
+ * @param len The size of the buffer.
+ * @return The number of bytes read, 0 at the end of the body.
+ */
+static ssize_t read_memory(void *source, void *buf, size_t len)
+{
+    struct memory_source *mem = source;
+    if (len > mem->len - mem->pos)
+    {
+        len = mem->len - mem->pos;
+    }
+    memcpy(buf, mem->data + mem->pos, len);
+    mem->pos += len;
+    return len;
+}
+
+/**
+ * @brief Open a stream for an URL.
+ * @details Sends the request as a single HEADERS frame that also ends the
+ * stream, GET has no body.
+ * @param s The connection.
+ * @param tr The URL, its stream id is set.
+ * @param host The host of the URL.
+ * @param setup The timing of the connection, the lookup and the handshake
+ * are copied to the transfer.
+ * @return Upon success 0, otherwise -1.
+ */
+static int open_stream(struct h2_session *s, struct h2_transfer *tr,
+                       const char *host, const struct timing *setup)
+{
+    uint8_t frame[H2_FRAME_HEADER + HEADER_SIZE];
+    uint8_t *block = frame + H2_FRAME_HEADER;
+    const char *fields[][2] = {
+        {":method", "GET"},
+        {":scheme", "http"},
+        {":path", tr->resource},
+        {":authority", host},
+        {"accept-encoding", encoding_accept_header()},
+    };
+    size_t len = 0;
+    for (size_t i = 0; i < sizeof(fields) / sizeof(fields[0]); i++)
+    {
+        size_t n = h2_hpack_encode(block + len, HEADER_SIZE - len,
+                                   fields[i][0], fields[i][1]);
+        if (n == 0)
+        {
+            fprintf(stderr, "[%s] ERROR: Request too large.\n", prog_name);
+            return -1;
+        }
+        len += n;
+    }
+
+    tr->id = s->next_id;
+    s->next_id += 2;
+    h2_write_frame(frame, len, H2_HEADERS,
+                   H2_FLAG_END_HEADERS | H2_FLAG_END_STREAM, tr->id);
+    if (send_all(s->fd, frame, H2_FRAME_HEADER + len) == -1)
+    {
+        return -1;
+    }
+    s->active++;
+    tr->t->at[PHASE_RESOLVED] = setup->at[PHASE_RESOLVED];
+    tr->t->at[PHASE_CONNECTED] = setup->at[PHASE_CONNECTED];
+    stamp(tr->t, PHASE_SENT);
+    return 0;
+}
+
+/**
+ * @brief Give an URL back to be requested again.
+ * @details Used for streams the server refused or will not process, before
+ * anything of their response arrived.
+ */
+static void retry_transfer(struct h2_session *s, struct h2_transfer *tr)
+{
+    tr->id = 0;
+    s->active--;
+}
+
+/**
+ * @brief End the stream of an URL.
+ * @details Decodes a compressed body into the output, closes the output and
+ * stores the result in the batch. May use the global variable prog_name and
+ * will write to stderr on failure.
+ * @param b The batch the URL belongs to.
+ * @param s The connection of the stream.
+ * @param tr The URL.
+ * @param result The result so far, the same codes as read_response.
+ */
+static void finish_transfer(struct batch *b, struct h2_session *s,
+                            struct h2_transfer *tr, int result)
+{
+    if (result == 0 && tr->result != 0)
+    {
+        result = tr->result;
+    }
+    if (result == 0 && !tr->responded)
+    {
+        fprintf(stderr, "[%s] ERROR: Protocol error!\n", prog_name);
+        result = 2;
+    }
+    if (result == 0 && tr->encoding != ENCODING_IDENTITY)
+    {
+        struct memory_source mem = {.data = tr->body, .len = tr->body_len};
+        enum gzdecode_result decoded = GZDECODE_ERROR;
+        if (fflush(tr->out) != EOF)
+        {
+            decoded = gzdecode_copy(fileno(tr->out), read_memory, &mem,
+                                    tr->encoding, false, tr->body_len);
+        }
+        if (decoded != GZDECODE_OK)
+        {
+            fprintf(stderr, "[%s] ERROR: Decompression failed: %s\n",
+                    prog_name, gzdecode_strerror(decoded));
+            result = 1;
+        }
+    }
+    stamp(tr->t, PHASE_BODY);
+
+    free(tr->body);
+    tr->body = NULL;
+    fclose(tr->out);
+    tr->out = NULL;
+    tr->done = true;
+    if (tr->id != 0)
+    {
+        s->active--;
+    }
+    b->results[tr->index] = result;
+    if (b->timing && result == 0)
+    {
+        print_timing(b->urls[tr->index], tr->t);
+    }
+}
+
+/**
+ * @brief Collect a field of a response header block.
+ * @details Called by h2_hpack_decode for every field.
+ * @param arg The h2_transfer of the stream.
+ */
+static void collect_response_field(void *arg, const char *name,
+                                   size_t name_len, const char *value,
+                                   size_t value_len)
+{
+    struct h2_transfer *tr = arg;
+    if (name_len == strlen(":status") &&
+        memcmp(name, ":status", name_len) == 0)
+    {
+        tr->responded = true;
+        if (value_len != 3 || memcmp(value, "200", 3) != 0)
+        {
+            fprintf(stderr, "[%s] STATUS: %.*s\n",
+                    prog_name, (int)value_len, value);
+            tr->result = 3;
+        }
+    }
+    else if (name_len == strlen("content-encoding") &&
+             memcmp(name, "content-encoding", name_len) == 0)
+    {
+        tr->encoding = encoding_from_name(value, value_len);
+        if (tr->encoding == ENCODING_COUNT)
+        {
+            fprintf(stderr, "[%s] ERROR: Unsupported content encoding: %.*s\n",
+                    prog_name, (int)value_len, value);
+            tr->encoding = ENCODING_IDENTITY;
+            tr->result = 1;
+        }
+    }
+}
+
+/**
+ * @brief Find the URL of a stream.
+ * @return The URL, or NULL if the stream is not open.
+ */
+static struct h2_transfer *find_transfer(struct h2_transfer *transfers,
+                                         size_t count, uint32_t id)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!transfers[i].done && transfers[i].id == id && id != 0)
+        {
+            return &transfers[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Handle a complete response header block.
+ * @details The first block of a stream is the response header, later ones 
+ * are trailers and only decoded.
+ * @return Upon success 0, -1 if the block can't be decoded.
+ */
+static int end_response_headers(struct batch *b, struct h2_session *s,
+                                struct h2_transfer *transfers, size_t count)
+{
+    struct h2_transfer *tr = find_transfer(transfers, count, s->block_stream);
+    struct h2_transfer ignored = {.responded = true};
+    bool first = tr != NULL && !tr->responded;
+    enum h2_error err = h2_hpack_decode(&s->hpack, s->block, s->block_len,
+                                        collect_response_field,
+                                        first ? tr : &ignored);
+    s->block_len = 0;
+    if (err != H2_NO_ERROR)
+    {
+        return -1;
+    }
+    if (first)
+    {
+        stamp(tr->t, PHASE_HEADERS);
+    }
+    if (tr != NULL && s->block_end)
+    {
+        finish_transfer(b, s, tr, 0);
+    }
+    return 0;
+}
+
+/**
+ * @brief Handle a frame received from the server.
+ * @details Bodies are written or collected, the flow control windows are 
+ * given back once half of them is used.
+ * May use the global variable prog_name and will write to stderr on failure.
+ * @param b The batch.
+ * @param s The connection.
+ * @param transfers The URLs of the connection.
+ * @param count The number of URLs.
+ * @param frame The header of the frame.
+ * @param payload The payload of the frame.
+ * @return Upon success 0, -1 if the connection can't be used anymore.
+ */
+static int handle_frame(struct batch *b, struct h2_session *s,
+                        struct h2_transfer *transfers, size_t count,
+                        const struct h2_frame *frame, uint8_t *payload)
+{
+    struct h2_transfer *tr = find_transfer(transfers, count, frame->stream);
+    if (tr != NULL)
+    {
+        tr->t->received += H2_FRAME_HEADER + frame->length;
+        if (!tr->responded && tr->t->at[PHASE_FIRST_BYTE].tv_sec == 0 &&
+            tr->t->at[PHASE_FIRST_BYTE].tv_nsec == 0)
+        {
+            stamp(tr->t, PHASE_FIRST_BYTE);
+        }
+    }
+    if (s->block_len > 0 && frame->type != H2_CONTINUATION)
+    {
+        return -1;
+    }
+
+    size_t start = 0;
+    size_t pad = 0;
+    if ((frame->type == H2_DATA || frame->type == H2_HEADERS) &&
+        (frame->flags & H2_FLAG_PADDED) != 0)
+    {
+        if (frame->length < 1)
+        {
+            return -1;
+        }
+        pad = payload[0];
+        start = 1;
+    }
+    if (frame->type == H2_HEADERS && (frame->flags & H2_FLAG_PRIORITY) != 0)
+    {
+        start += 5;
+    }
+    if (start + pad > frame->length)
+    {
+        return -1;
+    }
+    size_t len = frame->length - start - pad;
+
+    switch (frame->type)
+    {
+    case H2_DATA:
+        s->unacked += frame->length;
+        if (s->unacked >= H2_CLIENT_WINDOW / 2)
+        {
+            if (send_window_update(s->fd, 0, s->unacked) == -1)
+            {
+                return -1;
+            }
+            s->unacked = 0;
+        }
+        if (tr == NULL)
+        {
+            return 0;
+        }
+        if (tr->result == 0 && tr->encoding == ENCODING_IDENTITY)
+        {
+            fwrite(payload + start, sizeof(uint8_t), len, tr->out);
+        }
+        else if (tr->result == 0)
+        {
+            if (tr->body_len + len > tr->body_cap)
+            {
+                size_t cap = tr->body_cap == 0 ? GZDECODE_MIN_INPUT
+                                               : tr->body_cap;
+                while (cap < tr->body_len + len)
+                {
+                    cap *= 2;
+                }
+                uint8_t *body = realloc(tr->body, cap);
+                if (body == NULL)
+                {
+                    fprintf(stderr, "[%s] ERROR: Out of memory.\n",
+                            prog_name);
+                    tr->result = 1;
+                }
+                else
+                {
+                    tr->body = body;
+                    tr->body_cap = cap;
+                }
+            }
+            if (tr->result == 0)
+            {
+                memcpy(tr->body + tr->body_len, payload + start, len);
+                tr->body_len += len;
+            }
+        }
+        if ((frame->flags & H2_FLAG_END_STREAM) != 0)
+        {
+            finish_transfer(b, s, tr, 0);
+            return 0;
+        }
+        tr->unacked += frame->length;
+        if (tr->unacked >= H2_CLIENT_WINDOW / 2)
+        {
+            if (send_window_update(s->fd, tr->id, tr->unacked) == -1)
+            {
+                return -1;
+            }
+            tr->unacked = 0;
+        }
+        return 0;
+
+    case H2_HEADERS:
+    case H2_CONTINUATION:
+        if (frame->type == H2_HEADERS)
+        {
+            s->block_stream = frame->stream;
+            s->block_end = (frame->flags & H2_FLAG_END_STREAM) != 0;
+        }
+        else if (s->block_len == 0 || frame->stream != s->block_stream)
+        {
+            return -1;
+        }
+        if (len > HEADER_SIZE * 8 - s->block_len)
+        {
+            return -1;
+        }
+        if (s->block == NULL)
+        {
+            s->block = malloc(HEADER_SIZE * 8);
+            if (s->block == NULL)
+            {
+                return -1;
+            }
+        }
+        memcpy(s->block + s->block_len, payload + start, len);
+        s->block_len += len;
+        if ((frame->flags & H2_FLAG_END_HEADERS) == 0)
+        {
+            // An empty fragment still expects its CONTINUATION
+            if (s->block_len == 0)
+            {
+                return -1;
+            }
+            return 0;
+        }
+        return end_response_headers(b, s, transfers, count);
+
+    case H2_RST_STREAM:
+        if (tr == NULL || frame->length != 4)
+        {
+            return frame->length == 4 ? 0 : -1;
+        }
+        if (h2_get32(payload) == H2_REFUSED_STREAM && !tr->responded)
+        {
+            retry_transfer(s, tr);
+            s->refused_limit = s->active > 0 ? s->active : 1;
+            return 0;
+        }
+        fprintf(stderr, "[%s] ERROR: Stream reset by the server (%u).\n",
+                prog_name, h2_get32(payload));
+        finish_transfer(b, s, tr, 2);
+        return 0;
+
+    case H2_SETTINGS:
+        if ((frame->flags & H2_FLAG_ACK) != 0)
+        {
+            return 0;
+        }
+        if (h2_settings_apply(&s->peer, payload, frame->length) != H2_NO_ERROR)
+        {
+            return -1;
+        }
+        s->settings = true;
+        uint8_t ack[H2_FRAME_HEADER];
+        h2_write_frame(ack, 0, H2_SETTINGS, H2_FLAG_ACK, 0);
+        return send_all(s->fd, ack, sizeof(ack));
+
+    case H2_PING:
+        if ((frame->flags & H2_FLAG_ACK) != 0 || frame->length != 8)
+        {
+            return frame->length == 8 ? 0 : -1;
+        }
+        uint8_t pong[H2_FRAME_HEADER + 8];
+        h2_write_frame(pong, 8, H2_PING, H2_FLAG_ACK, 0);
+        memcpy(pong + H2_FRAME_HEADER, payload, 8);
+        return send_all(s->fd, pong, sizeof(pong));
+
+    case H2_GOAWAY:
+        if (frame->length < 8)
+        {
+            return -1;
+        }
+        s->goaway = true;
+        s->last_id = h2_get32(payload) & 0x7fffffff;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!transfers[i].done && transfers[i].id > s->last_id)
+            {
+                retry_transfer(s, &transfers[i]);
+            }
+        }
+        return 0;
+
+    case H2_PUSH_PROMISE:
+        // Push is disabled in our settings
+        return -1;
+
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Fetch URLs of one host over one HTTP/2 connection.
+ * @details Opens a connection with prior knowledge and requests the URLs on
+ * streams, as many at the same time as the server allows (until its
+ * SETTINGS arrived at most H2_DEFAULT_STREAMS). URLs the server refused or
+ * will not process after GOAWAY are left for the next connection.
+ * May use the global variable prog_name and will write to stderr on failure.
+ * @param b The batch.
+ * @param transfers The URLs of the host.
+ * @param count The number of URLs.
+ * @param host The host.
+ * @return The number of URLs whose result is known now.
+ */
+static size_t run_session(struct batch *b, struct h2_transfer *transfers,
+                          size_t count, char *host)
+{
+    size_t finished = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        finished += transfers[i].done ? 1 : 0;
+    }
+
+    struct timing setup;
+    struct connection conn = {.host = NULL, .fd = -1, .in = NULL};
+    if (open_connection(b, &conn, host, &setup) == -1)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (!transfers[i].done)
+            {
+                finish_transfer(b, NULL, &transfers[i], EXIT_FAILURE);
+            }
+        }
+        return count;
+    }
+
+    struct h2_session s = {.fd = conn.fd, .next_id = 1,
+                           .refused_limit = SIZE_MAX};
+    h2_hpack_init(&s.hpack, H2_DEFAULT_TABLE_SIZE);
+    h2_settings_init(&s.peer);
+
+    // The preface, our settings and a larger window for the connection
+    uint8_t preface[H2_PREFACE_LEN + 2 * H2_FRAME_HEADER + 12 + 4];
+    uint8_t *pos = preface;
+    memcpy(pos, H2_PREFACE, H2_PREFACE_LEN);
+    pos += H2_PREFACE_LEN;
+    h2_write_frame(pos, 12, H2_SETTINGS, 0, 0);
+    h2_write_setting(pos + H2_FRAME_HEADER, H2_ENABLE_PUSH, 0);
+    h2_write_setting(pos + H2_FRAME_HEADER + 6, H2_INITIAL_WINDOW_SIZE,
+                     H2_CLIENT_WINDOW);
+    pos += H2_FRAME_HEADER + 12;
+    h2_write_frame(pos, 4, H2_WINDOW_UPDATE, 0, 0);
+    h2_put32(pos + H2_FRAME_HEADER, H2_CLIENT_WINDOW - H2_DEFAULT_WINDOW);
+    bool failed = send_all(s.fd, preface, sizeof(preface)) == -1;
+
+    uint8_t frame_buf[H2_FRAME_HEADER + H2_DEFAULT_FRAME_SIZE];
+    while (!failed)
+    {
+        size_t limit = s.settings ? s.peer.values[H2_MAX_CONCURRENT_STREAMS]
+                                  : H2_DEFAULT_STREAMS;
+        if (limit > s.refused_limit)
+        {
+            limit = s.refused_limit;
+        }
+        for (size_t i = 0; i < count && !s.goaway && s.active < limit &&
+                           s.next_id <= H2_MAX_WINDOW;
+             i++)
+        {
+            if (!transfers[i].done && transfers[i].id == 0 &&
+                open_stream(&s, &transfers[i], host, &setup) == -1)
+            {
+                failed = true;
+                break;
+            }
+        }
+        if (failed || s.active == 0)
+        {
+            break;
+        }
+
+        struct h2_frame frame;
+        if (recv_all(s.fd, frame_buf, H2_FRAME_HEADER) == -1)
+        {
+            failed = true;
+            break;
+        }
+        h2_read_frame(frame_buf, &frame);
+        if (frame.length > H2_DEFAULT_FRAME_SIZE ||
+            recv_all(s.fd, frame_buf + H2_FRAME_HEADER, frame.length) == -1 ||
+            handle_frame(b, &s, transfers, count, &frame,
+                         frame_buf + H2_FRAME_HEADER) == -1)
+        {
+            failed = true;
+        }
+    }
+
+    // Streams in flight are lost with the connection
+    if (failed)
+    {
+        fprintf(stderr, "[%s] ERROR: Protocol error!\n", prog_name);
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        if (!transfers[i].done && transfers[i].id != 0)
+        {
+            finish_transfer(b, &s, &transfers[i], 2);
+        }
+    }
+    h2_hpack_destroy(&s.hpack);
+    free(s.block);
+    close_connection(&conn);
+
+    size_t now_finished = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        now_finished += transfers[i].done ? 1 : 0;
+    }
+    return now_finished - finished;
+}
+
+/**
+ * @brief Fetch URLs of one host over HTTP/2.
+ * @details Opens the outputs and runs connections until every URL has a 
+ * result. A connection that finished none of them fails the rest, so a 
+ * server that refuses everything can't keep the client busy.
+ * May use the global variable prog_name and will write to stderr on failure.
+ * @param b The batch.
+ * @param indices The indices of the URLs, all of the same host.
+ * @param count The number of URLs.
+ */
+static void fetch_host(struct batch *b, size_t *indices, size_t count)
+{
+    struct h2_transfer transfers[count];
+    size_t url_len = strlen(b->urls[indices[0]]);
+    char host[url_len + 1];
+    size_t left = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        struct h2_transfer *tr = &transfers[i];
+        memset(tr, 0, sizeof(*tr));
+        tr->index = indices[i];
+        tr->t = &b->timings[tr->index];
+        tr->encoding = ENCODING_IDENTITY;
+        memset(tr->t, 0, sizeof(*tr->t));
+        stamp(tr->t, PHASE_START);
+
+        char *url = b->urls[tr->index];
+        char url_host[strlen(url) + 1];
+        tr->resource = malloc(strlen(url) + 2);
+        if (tr->resource == NULL || parse_url(url_host, tr->resource, url) == -1)
+        {
+            b->results[tr->index] = EXIT_FAILURE;
+            tr->done = true;
+            continue;
+        }
+        strcpy(host, url_host);
+        tr->out = open_output(b->filename, b->dirname, tr->resource);
+        if (tr->out == NULL)
+        {
+            fprintf(stderr, "[%s] ERROR: Unable to open output file: %s\n",
+                    prog_name, strerror(errno));
+            b->results[tr->index] = EXIT_FAILURE;
+            tr->done = true;
+            continue;
+        }
+        left++;
+    }
+
+    while (left > 0)
+    {
+        size_t finished = run_session(b, transfers, count, host);
+        if (finished == 0)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                if (!transfers[i].done)
+                {
+                    fprintf(stderr, "[%s] ERROR: The server refused %s.\n",
+                            prog_name, b->urls[transfers[i].index]);
+                    finish_transfer(b, NULL, &transfers[i], EXIT_FAILURE);
+                }
+            }
+            break;
+        }
+        left -= finished;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        free(transfers[i].resource);
+    }
+}
+
+/**
+ * @brief Fetch URLs of a batch until all are taken.
+ * @details This is the start routine of the worker threads. With -2 a
+ * worker takes a whole host at once.
+ * @param arg The batch.
+ * @return Always NULL, the results are stored in the batch.
+ */
+static void *worker(void *arg)
+{
+    struct batch *b = arg;
+
+    if (b->h2)
+    {
+        size_t indices[b->count];
+        size_t count;
+        while ((count = take_host(b, indices)) > 0)
+        {
+            fetch_host(b, indices, count);
+        }
+        return NULL;
+    }
+    while (true)
+    {
+        pthread_mutex_lock(&b->lock);
+        size_t i = b->next;
+        if (i < b->count)
+        {
+            b->next++;
+        }
+        pthread_mutex_unlock(&b->lock);
+        if (i >= b->count)
+        {
+            break;
+        }
+        b->results[i] = fetch(b, b->urls[i], &b->timings[i]);
+    }
+    return NULL;
+}
+
+/**
+ * @brief Add an URL to a list.
+ * @param urls The list, which is grown if needed.
+ * @param count The number of URLs in the list.
+ * @param cap The capacity of the list.
+ * @param url The URL to add, it is not copied.
+ * @return Upon success 0, otherwise -1.
+ */
+static int add_url(char ***urls, size_t *count, size_t *cap, char *url)
+{
+    if (*count == *cap)
+    {
+        size_t new_cap = *cap == 0 ? 16 : *cap * 2;
+        char **new_urls = realloc(*urls, new_cap * sizeof(char *));
+        if (new_urls == NULL)
+        {
+            return -1;
+        }
+        *urls = new_urls;
+        *cap = new_cap;
+    }
+    (*urls)[(*count)++] = url;
+    return 0;
+}
+
+/**
+ * @brief Read a list of URLs from a file.
+ * @details Every line is one URL, empty lines are skipped. The URLs are
+ * copied and have to be freed by the caller.
+ * @param filename The file to read, "-" for stdin.
+ * @param urls The list to add the URLs to.
+ * @param count The number of URLs in the list.
+ * @param cap The capacity of the list.
+ * @return Upon success 0, otherwise -1.
+ */
+static int read_list(char *filename, char ***urls, size_t *count, size_t *cap)
+{
+    FILE *list = strcmp(filename, "-") == 0 ? stdin : fopen(filename, "r");
+    if (list == NULL)
+    {
+        return -1;
+    }
+
+    char *line = NULL;
+    size_t line_cap = 0;
+    ssize_t len;
+    int ret = 0;
+    while ((len = getline(&line, &line_cap, list)) != -1)
+    {
+        while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+        {
+            line[--len] = '\0';
+        }
+        if (len == 0)
+        {
+            continue;
+        }
+        char *url = strdup(line);
+        if (url == NULL || add_url(urls, count, cap, url) == -1)
+        {
+            free(url);
+            ret = -1;
+            break;
+        }
+    }
+    if (ferror(list))
+    {
+        ret = -1;
+    }
+
+    free(line);
+    if (list != stdin)
+    {
+        fclose(list);
+    }
+    return ret;
+}
+
+/**
+ * @brief The entrypoint of the client. Execution of the client always starts
+ * and ends here.
+ * @details Uses the global variable prog_name. The URLs are given as
+ * arguments or with -i in a file, more than one URL need an output directory.
+ * -v (or --timing) prints the timing of every transfer and, if there are
+ * several, percentiles over all of them. -2 fetches over HTTP/2.
+ * @param argc The argument counter
+ * @param argc The argument vector
+ * @return Upon success EXIT_SUCCESS, on HTTP protocol violation 2, upon
+ * unsuccessful requests 3 and on all other errors EXIT_FAILURE. If several
+ * URLs are fetched, the code of the first failed one is returned.
+ */
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+    bool has_p = false;
+    char *port = "80";
+    char *filename = NULL;
+    char *dirname = NULL;
+    char *listname = NULL;
+    long connections = DEFAULT_CONNECTIONS;
+    bool timing = false;
+    bool h2 = false;
+    char *endptr;
+    int c;
+    static const struct option long_options[] = {
+        {"timing", no_argument, NULL, 'v'},
+        {NULL, 0, NULL, 0}};
+    while ((c = getopt_long(argc, argv, "p:o:d:c:i:v2", long_options, NULL)) != -1)
     {
         switch (c)
         {
@@ -519,6 +2180,33 @@ int main(int argc, char *argv[])
             }
             dirname = optarg;
             break;
+        case 'c':
+            connections = strtol(optarg, &endptr, 10);
+            if (*optarg == '\0' || *endptr != '\0' || connections < 1 ||
+                connections > MAX_CONNECTIONS)
+            {
+                fprintf(stderr, "[%s] ERROR: -c must be between 1 and %d.\n",
+                        prog_name, MAX_CONNECTIONS);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            break;
+        case 'i':
+            if (listname != NULL)
+            {
+                fprintf(stderr, "[%s] ERROR: -i can only appear once.\n",
+                        prog_name);
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            listname = optarg;
+            break;
+        case 'v':
+            timing = true;
+            break;
+        case '2':
+            h2 = true;
+            break;
         case '?':
             exit(EXIT_FAILURE);
             break;
@@ -535,55 +2223,117 @@ int main(int argc, char *argv[])
         }
     }
 
-    // Read the url
-    if (optind != argc - 1)
+    // Collect the urls, the ones from the list are copied
+    char **urls = NULL;
+    size_t url_count = 0, url_cap = 0;
+    for (int i = optind; i < argc; i++)
     {
-        usage();
+        if (add_url(&urls, &url_count, &url_cap, argv[i]) == -1)
+        {
+            fprintf(stderr, "[%s] ERROR: Out of memory.\n", prog_name);
+            exit(EXIT_FAILURE);
+        }
+    }
+    size_t arg_count = url_count;
+    if (listname != NULL &&
+        read_list(listname, &urls, &url_count, &url_cap) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to read %s: %s\n",
+                prog_name, listname, strerror(errno));
         exit(EXIT_FAILURE);
     }
-    char *url = argv[optind];
-    size_t url_len = strlen(url);
-
-    // Parse the url
-    char url_host[url_len];
-    char url_resource[url_len];
-    if (parse_url(url_host, url_resource, url) == -1)
+    if (url_count == 0)
     {
+        usage();
         exit(EXIT_FAILURE);
     }
-
-    // Create the output file
-    FILE *out_file = open_output(filename, dirname, url_resource);
-    if (out_file == NULL)
+    if (url_count > 1 && dirname == NULL)
     {
-        fprintf(stderr, "[%s] ERROR: Unable to open output file: %s\n",
-                prog_name, strerror(errno));
+        fprintf(stderr, "[%s] ERROR: Several URLs need -d.\n", prog_name);
+        usage();
         exit(EXIT_FAILURE);
     }
 
-    // Create the socket
-    FILE *conn_file = create_connection(url_host, port);
-    if (conn_file == NULL)
+    // Writing to a connection the server closed must not kill the client
+    signal(SIGPIPE, SIG_IGN);
+
+    int results[url_count];
+    struct timing *timings = malloc(url_count * sizeof(struct timing));
+    bool *taken = calloc(url_count, sizeof(bool));
+    if (timings == NULL || taken == NULL)
     {
-        fclose(out_file);
+        fprintf(stderr, "[%s] ERROR: Out of memory.\n", prog_name);
         exit(EXIT_FAILURE);
     }
+    struct batch b = {
+        .urls = urls,
+        .results = results,
+        .timings = timings,
+        .count = url_count,
+        .next = 0,
+        .port = port,
+        .filename = filename,
+        .dirname = dirname,
+        .keep_alive = url_count > 1,
+        .timing = timing,
+        .h2 = h2,
+        .taken = taken,
+        .idle_count = 0,
+        .resolved_count = 0,
+    };
+    pthread_mutex_init(&b.lock, NULL);
 
-    // Send the request
-    send_request(conn_file, url_host, url_resource);
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
 
-    // Read the response
-    int exit_code;
-    if ((exit_code = read_response(out_file, conn_file)) != 0)
+    // A single worker runs in the main thread
+    long worker_count = (size_t)connections < url_count ? connections : (long)url_count;
+    pthread_t threads[worker_count];
+    long started = 0;
+    for (long i = 1; i < worker_count; i++)
     {
-        fclose(conn_file);
-        fclose(out_file);
-        exit(exit_code);
+        if (pthread_create(&threads[i], NULL, worker, &b) != 0)
+        {
+            break;
+        }
+        started++;
+    }
+    worker(&b);
+    for (long i = 1; i <= started; i++)
+    {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_mutex_destroy(&b.lock);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    if (timing && url_count > 1)
+    {
+        print_batch_timing(&b, &begin, &end);
     }
 
     // Free all resources
-    fclose(conn_file);
-    fclose(out_file);
+    for (size_t i = 0; i < b.idle_count; i++)
+    {
+        close_connection(&b.idle[i]);
+    }
+    for (size_t i = 0; i < b.resolved_count; i++)
+    {
+        free(b.resolved[i].host);
+    }
+    int exit_code = EXIT_SUCCESS;
+    for (size_t i = 0; i < url_count; i++)
+    {
+        if (exit_code == EXIT_SUCCESS)
+        {
+            exit_code = results[i];
+        }
+        if (i >= arg_count)
+        {
+            free(urls[i]);
+        }
+    }
+    free(urls);
+    free(timings);
+    free(taken);
 
-    exit(EXIT_SUCCESS);
+    exit(exit_code);
 }
@@ -0,0 +1,110 @@
+/**
+ * @file encoding.h
+ * @date 14.02.2021
+ * @brief Content codings: negotiating them with Accept-Encoding and compressing a body with them
+ * @details The server parses the Accept-Encoding header of a request once into the quality of
+ * every coding and then chooses among the codings it can offer for the requested file: those
+ * compiled in (ENCODING_COMPILED) plus every precompressed sibling (index.html.br,
+ * index.html.zst, index.html.gz) that is at least as new as the file. The highest quality wins,
+ * of equally good codings the first one of enum encoding. gzip is always available, brotli and
+ * zstd only if the Makefile found their libraries (HAVE_BROTLI, HAVE_ZSTD).
+ * The same module is used by 3-http-flofriday and 3-http-briemelchen, keep the copies in sync.
+ */
+
+#ifndef ENCODING_H
+#define ENCODING_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The content codings, in the order the server prefers them if the client likes several
+ * of them equally
+ */
+enum encoding {
+    ENCODING_BROTLI,
+    ENCODING_ZSTD,
+    ENCODING_GZIP,
+    ENCODING_IDENTITY,
+    ENCODING_COUNT
+};
+
+/**
+ * @brief The bit of a coding in a set of codings
+ */
+#define ENCODING_BIT(e) (1u << (e))
+
+#ifdef HAVE_BROTLI
+#define ENCODING_BROTLI_COMPILED ENCODING_BIT(ENCODING_BROTLI)
+#else
+#define ENCODING_BROTLI_COMPILED 0u
+#endif
+
+#ifdef HAVE_ZSTD
+#define ENCODING_ZSTD_COMPILED ENCODING_BIT(ENCODING_ZSTD)
+#else
+#define ENCODING_ZSTD_COMPILED 0u
+#endif
+
+/**
+ * @brief The codings this build can compress and decompress, identity included
+ */
+#define ENCODING_COMPILED                                                                      \
+    (ENCODING_BROTLI_COMPILED | ENCODING_ZSTD_COMPILED | ENCODING_BIT(ENCODING_GZIP) |         \
+     ENCODING_BIT(ENCODING_IDENTITY))
+
+/**
+ * @brief The quality a client gave every coding, in thousandths (q=0.5 is 500)
+ */
+struct encoding_accept {
+    unsigned short q[ENCODING_COUNT];
+};
+
+/**
+ * @brief Parses the value of an Accept-Encoding header, value may be NULL if there is none.
+ * @details Without a header only identity is acceptable. A coding that is not listed gets the
+ * quality of "*" if there is one, identity is acceptable with the lowest quality unless it or
+ * "*" is excluded with q=0. "x-gzip" is taken as gzip, unknown codings and elements with a
+ * malformed quality are ignored.
+ */
+void encoding_parse_accept(struct encoding_accept *accept, const char *value, size_t len);
+
+/**
+ * @brief Chooses the coding out of the set available the client likes best.
+ * @details Falls back to identity if the client accepts none of them, even if it excluded
+ * identity, so the server never has to answer 406 Not Acceptable.
+ */
+enum encoding encoding_choose(const struct encoding_accept *accept, unsigned available);
+
+/**
+ * @brief Returns the name of a coding as used in Content-Encoding ("br", "zstd", "gzip" or
+ * "identity").
+ */
+const char *encoding_name(enum encoding encoding);
+
+/**
+ * @brief Returns the suffix of the precompressed sibling of a file (".br", ".zst", ".gz"), or
+ * "" for identity.
+ */
+const char *encoding_suffix(enum encoding encoding);
+
+/**
+ * @brief Returns the coding called name (len bytes, case insensitive, surrounding whitespace
+ * ignored), or ENCODING_COUNT if it is unknown.
+ */
+enum encoding encoding_from_name(const char *name, size_t len);
+
+/**
+ * @brief Returns the value of Accept-Encoding for a request, listing every coding compiled in.
+ */
+const char *encoding_accept_header(void);
+
+/**
+ * @brief Compresses len bytes of in with a compiled coding other than identity.
+ * @details The output is allocated with malloc and belongs to the caller.
+ * @return 0 on success, -1 if the coding is not compiled in or compressing failed
+ */
+int encoding_compress(enum encoding encoding, const uint8_t *in, size_t len, uint8_t **out,
+                      size_t *out_len);
+
+#endif
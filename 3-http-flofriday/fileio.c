@@ -0,0 +1,179 @@
+/**
+ * @file fileio.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Implementation of the fileio module.
+ **/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "fileio.h"
+
+/**
+ * Run jobs.
+ * @brief The function of every worker thread.
+ * @details Takes pending jobs one after another, runs them and appends them
+ * to the finished jobs until the pool is stopped.
+ * @param arg The pool.
+ * @return Always NULL.
+ */
+static void *work(void *arg)
+{
+    struct fileio *pool = arg;
+
+    pthread_mutex_lock(&pool->mutex);
+    while (true)
+    {
+        while (pool->pending_head == NULL && !pool->stopping)
+        {
+            pthread_cond_wait(&pool->pending_cond, &pool->mutex);
+        }
+        if (pool->stopping)
+        {
+            break;
+        }
+
+        struct fileio_job *job = pool->pending_head;
+        pool->pending_head = job->next;
+        if (pool->pending_head == NULL)
+        {
+            pool->pending_tail = NULL;
+        }
+        pthread_mutex_unlock(&pool->mutex);
+
+        job->run(job);
+
+        pthread_mutex_lock(&pool->mutex);
+        job->next = NULL;
+        if (pool->done_tail != NULL)
+        {
+            pool->done_tail->next = job;
+        }
+        else
+        {
+            pool->done_head = job;
+        }
+        pool->done_tail = job;
+
+        // Wake up the event loop, a full counter is readable anyway
+        uint64_t one = 1;
+        while (write(pool->eventfd, &one, sizeof(one)) == -1 && errno == EINTR)
+        {
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return NULL;
+}
+
+struct fileio *fileio_create(size_t threads)
+{
+    struct fileio *pool = calloc(1, sizeof(struct fileio));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    pool->threads = malloc(threads * sizeof(pthread_t));
+    pool->eventfd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (pool->threads == NULL || pool->eventfd == -1)
+    {
+        int err = errno;
+        if (pool->eventfd != -1)
+        {
+            close(pool->eventfd);
+        }
+        free(pool->threads);
+        free(pool);
+        errno = err;
+        return NULL;
+    }
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->pending_cond, NULL);
+
+    for (; pool->thread_count < threads; pool->thread_count++)
+    {
+        int err = pthread_create(&pool->threads[pool->thread_count], NULL,
+                                 work, pool);
+        if (err != 0)
+        {
+            fileio_destroy(pool, NULL);
+            errno = err;
+            return NULL;
+        }
+    }
+    return pool;
+}
+
+void fileio_destroy(struct fileio *pool, void (*discard)(struct fileio_job *job))
+{
+    pthread_mutex_lock(&pool->mutex);
+    pool->stopping = true;
+    pthread_cond_broadcast(&pool->pending_cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for (size_t i = 0; i < pool->thread_count; i++)
+    {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    struct fileio_job *lists[] = {pool->pending_head, pool->done_head};
+    for (size_t i = 0; i < sizeof(lists) / sizeof(lists[0]); i++)
+    {
+        struct fileio_job *job = lists[i];
+        while (job != NULL)
+        {
+            struct fileio_job *next = job->next;
+            discard(job);
+            job = next;
+        }
+    }
+
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_cond_destroy(&pool->pending_cond);
+    close(pool->eventfd);
+    free(pool->threads);
+    free(pool);
+}
+
+void fileio_submit(struct fileio *pool, struct fileio_job *job)
+{
+    job->next = NULL;
+    pthread_mutex_lock(&pool->mutex);
+    if (pool->pending_tail != NULL)
+    {
+        pool->pending_tail->next = job;
+    }
+    else
+    {
+        pool->pending_head = job;
+    }
+    pool->pending_tail = job;
+    pthread_cond_signal(&pool->pending_cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+struct fileio_job *fileio_complete(struct fileio *pool)
+{
+    // Reset the counter first, so a job finished after the queue was found
+    // empty makes the eventfd readable again
+    uint64_t count;
+    while (read(pool->eventfd, &count, sizeof(count)) == -1 && errno == EINTR)
+    {
+    }
+
+    pthread_mutex_lock(&pool->mutex);
+    struct fileio_job *job = pool->done_head;
+    if (job != NULL)
+    {
+        pool->done_head = job->next;
+        if (pool->done_head == NULL)
+        {
+            pool->done_tail = NULL;
+        }
+    }
+    pthread_mutex_unlock(&pool->mutex);
+    return job;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file fileio.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Provides a thread pool for blocking file operations.
+ *
+ * The fileio module. Opening, stating and compressing a file that is not in
+ * the page cache blocks until the disk answered, which would stall every
+ * other connection of the event loop. Such jobs are handed to a fixed number
+ * of worker threads instead. Finished jobs are queued and signaled through an
+ * eventfd, which the event loop watches like any socket.
+ **/
+
+#ifndef FILEIO_H
+#define FILEIO_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+/**
+ * Structure of a job
+ * @brief The function a worker runs and the link in the queues.
+ * @details Embed it as the first member of a structure holding the arguments
+ * and results of the job. Workers only call run, everything else belongs to
+ * the thread that submitted the job.
+ */
+struct fileio_job
+{
+    void (*run)(struct fileio_job *job);
+    void *owner;
+    struct fileio_job *next;
+};
+
+/**
+ * Structure of the pool
+ * @brief The worker threads, the queue of pending jobs and the queue of
+ * finished jobs.
+ */
+struct fileio
+{
+    pthread_t *threads;
+    size_t thread_count;
+    int eventfd;
+    bool stopping;
+    pthread_mutex_t mutex;
+    pthread_cond_t pending_cond;
+    struct fileio_job *pending_head;
+    struct fileio_job *pending_tail;
+    struct fileio_job *done_head;
+    struct fileio_job *done_tail;
+};
+
+/**
+ * Create a pool.
+ * @brief Start the worker threads.
+ * @details The caller must call fileio_destroy to stop and free the pool.
+ * @param threads The number of worker threads, at least 1.
+ * @return Upon success a pointer to the pool, otherwise NULL.
+ */
+struct fileio *fileio_create(size_t threads);
+
+/**
+ * Destroy a pool.
+ * @brief Stop the worker threads and free the pool.
+ * @details Jobs currently running are finished first. Jobs that are still
+ * pending or were not collected with fileio_complete are passed to discard.
+ * @param pool The pool to destroy.
+ * @param discard Frees a job that is not collected anymore.
+ */
+void fileio_destroy(struct fileio *pool, void (*discard)(struct fileio_job *job));
+
+/**
+ * Submit a job.
+ * @brief Queue a job for the next idle worker.
+ * @param pool The pool to run the job.
+ * @param job The job, it belongs to the pool until it is returned by
+ * fileio_complete.
+ */
+void fileio_submit(struct fileio *pool, struct fileio_job *job);
+
+/**
+ * Collect a finished job.
+ * @brief Take the oldest finished job out of the pool.
+ * @details Call it whenever the eventfd of the pool is readable, until it
+ * returns NULL.
+ * @param pool The pool whose jobs are collected.
+ * @return The finished job, or NULL if no job is finished.
+ */
+struct fileio_job *fileio_complete(struct fileio *pool);
+
+#endif
@@ -0,0 +1,326 @@
+/**
+ * @file gzcache.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Implementation of the gzcache module.
+ **/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "gzcache.h"
+
+/**
+ * Hash a path.
+ * @brief A simple djb2 string hash.
+ * @param path The string to hash.
+ * @return The index of the bucket for the path.
+ */
+static size_t hash_path(const char *path)
+{
+    size_t hash = 5381;
+    while (*path != '\0')
+    {
+        hash = hash * 33 + (unsigned char)*path++;
+    }
+    return hash % GZCACHE_BUCKETS;
+}
+
+/**
+ * Compare two timestamps.
+ * @return A negative number, zero or a positive number if a is older, equal
+ * or newer than b.
+ */
+static int compare_time(const struct timespec *a, const struct timespec *b)
+{
+    if (a->tv_sec != b->tv_sec)
+    {
+        return a->tv_sec < b->tv_sec ? -1 : 1;
+    }
+    if (a->tv_nsec != b->tv_nsec)
+    {
+        return a->tv_nsec < b->tv_nsec ? -1 : 1;
+    }
+    return 0;
+}
+
+/**
+ * Free an entry.
+ * @brief Free the entry and all buffers it owns.
+ */
+static void free_entry(struct gzcache_entry *entry)
+{
+    free(entry->path);
+    free(entry->data);
+    free(entry);
+}
+
+/**
+ * Remove an entry from the cache.
+ * @brief Unlink the entry from the hash table and the LRU list.
+ * @details The entry is freed if nobody references it anymore.
+ */
+static void remove_entry(struct gzcache *cache, struct gzcache_entry *entry)
+{
+    struct gzcache_entry **link = &cache->buckets[hash_path(entry->path)];
+    while (*link != entry)
+    {
+        link = &(*link)->hnext;
+    }
+    *link = entry->hnext;
+
+    if (entry->prev != NULL)
+    {
+        entry->prev->next = entry->next;
+    }
+    else
+    {
+        cache->head = entry->next;
+    }
+    if (entry->next != NULL)
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        cache->tail = entry->prev;
+    }
+
+    cache->used -= entry->len;
+    entry->cached = false;
+    if (entry->refs == 0)
+    {
+        free_entry(entry);
+    }
+}
+
+/**
+ * Mark an entry as used.
+ * @brief Move the entry to the head of the LRU list.
+ */
+static void touch_entry(struct gzcache *cache, struct gzcache_entry *entry)
+{
+    if (cache->head == entry)
+    {
+        return;
+    }
+
+    entry->prev->next = entry->next;
+    if (entry->next != NULL)
+    {
+        entry->next->prev = entry->prev;
+    }
+    else
+    {
+        cache->tail = entry->prev;
+    }
+
+    entry->prev = NULL;
+    entry->next = cache->head;
+    cache->head->prev = entry;
+    cache->head = entry;
+}
+
+/**
+ * Create the name of the mirror file.
+ * @details The caller must free the returned string.
+ * @return Upon success the path with the suffix of the coding appended,
+ * otherwise NULL.
+ */
+static char *mirror_path(const char *path, enum encoding encoding)
+{
+    const char *suffix = encoding_suffix(encoding);
+    char *mirror = malloc(strlen(path) + strlen(suffix) + 1);
+    if (mirror == NULL)
+    {
+        return NULL;
+    }
+    strcpy(mirror, path);
+    strcat(mirror, suffix);
+    return mirror;
+}
+
+/**
+ * Write a mirror file.
+ * @brief Store the compressed bytes in a sibling next to the original.
+ * @details The file is written to a temporary name first and then renamed,
+ * so that readers never see a partially written file. Errors are ignored as
+ * the mirror is only an optimization.
+ */
+static void store_mirror(const char *path, enum encoding encoding,
+                         const uint8_t *data, size_t len)
+{
+    char *mirror = mirror_path(path, encoding);
+    if (mirror == NULL)
+    {
+        return;
+    }
+    // The pid keeps multiple workers from writing to the same temporary file
+    char tmp[strlen(mirror) + 32];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", mirror, (int)getpid());
+
+    FILE *out = fopen(tmp, "w");
+    if (out != NULL)
+    {
+        bool ok = fwrite(data, sizeof(uint8_t), len, out) == len;
+        if (fclose(out) != 0 || !ok || rename(tmp, mirror) == -1)
+        {
+            unlink(tmp);
+        }
+    }
+    free(mirror);
+}
+
+/**
+ * Add an entry to the cache.
+ * @brief Create an entry and link it into the hash table and LRU list.
+ * @details Takes ownership of data. An older entry for the same path and
+ * coding is replaced. Entries larger than the budget are returned but not
+ * cached.
+ * @return Upon success the new entry with one reference, otherwise NULL.
+ */
+static struct gzcache_entry *add_entry(struct gzcache *cache,
+                                       const char *path,
+                                       enum encoding encoding,
+                                       const struct stat *st, uint8_t *data,
+                                       size_t len)
+{
+    struct gzcache_entry *entry = calloc(1, sizeof(struct gzcache_entry));
+    if (entry == NULL)
+    {
+        free(data);
+        return NULL;
+    }
+    entry->path = strdup(path);
+    if (entry->path == NULL)
+    {
+        free(data);
+        free(entry);
+        return NULL;
+    }
+    entry->encoding = encoding;
+    entry->size = st->st_size;
+    entry->mtime = st->st_mtim;
+    entry->data = data;
+    entry->len = len;
+    entry->refs = 1;
+
+    size_t bucket = hash_path(path);
+    struct gzcache_entry *old = cache->buckets[bucket];
+    while (old != NULL &&
+           (old->encoding != encoding || strcmp(old->path, path) != 0))
+    {
+        old = old->hnext;
+    }
+    if (old != NULL)
+    {
+        remove_entry(cache, old);
+    }
+
+    if (len > cache->budget)
+    {
+        return entry;
+    }
+
+    // Evict the least recently used entries until the new one fits
+    while (cache->used + len > cache->budget)
+    {
+        remove_entry(cache, cache->tail);
+    }
+
+    entry->hnext = cache->buckets[bucket];
+    cache->buckets[bucket] = entry;
+
+    entry->next = cache->head;
+    if (cache->head != NULL)
+    {
+        cache->head->prev = entry;
+    }
+    else
+    {
+        cache->tail = entry;
+    }
+    cache->head = entry;
+
+    cache->used += len;
+    entry->cached = true;
+    return entry;
+}
+
+struct gzcache *gzcache_create(size_t budget, bool mirror)
+{
+    struct gzcache *cache = calloc(1, sizeof(struct gzcache));
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+    cache->budget = budget;
+    cache->mirror = mirror;
+    return cache;
+}
+
+void gzcache_destroy(struct gzcache *cache)
+{
+    while (cache->head != NULL)
+    {
+        remove_entry(cache, cache->head);
+    }
+    free(cache);
+}
+
+/**
+ * @details Updates the hit and miss counters of the cache.
+ */
+struct gzcache_entry *gzcache_lookup(struct gzcache *cache, const char *path,
+                                     enum encoding encoding,
+                                     const struct stat *st)
+{
+    struct gzcache_entry *entry = cache->buckets[hash_path(path)];
+    while (entry != NULL &&
+           (entry->encoding != encoding || strcmp(entry->path, path) != 0))
+    {
+        entry = entry->hnext;
+    }
+
+    if (entry != NULL)
+    {
+        if (entry->size == st->st_size &&
+            compare_time(&entry->mtime, &st->st_mtim) == 0)
+        {
+            cache->hits++;
+            touch_entry(cache, entry);
+            entry->refs++;
+            return entry;
+        }
+
+        // The file changed since it was compressed
+        remove_entry(cache, entry);
+    }
+
+    cache->misses++;
+    return NULL;
+}
+
+struct gzcache_entry *gzcache_insert(struct gzcache *cache, const char *path,
+                                     enum encoding encoding,
+                                     const struct stat *st, uint8_t *data,
+                                     size_t len)
+{
+    if (cache->mirror)
+    {
+        store_mirror(path, encoding, data, len);
+    }
+    return add_entry(cache, path, encoding, st, data, len);
+}
+
+void gzcache_release(struct gzcache_entry *entry)
+{
+    entry->refs--;
+    if (entry->refs == 0 && !entry->cached)
+    {
+        free_entry(entry);
+    }
+}
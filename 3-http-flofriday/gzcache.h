@@ -0,0 +1,132 @@
+/**
+ * @file gzcache.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Provides an in-memory cache for compressed files.
+ *
+ * The gzcache module. Compressed documents are stored per content coding
+ * together with the size and modification time of the original file, so that
+ * a file only has to be compressed again after it changed. The least recently
+ * used entries are evicted once the configured byte budget is exceeded.
+ * Optionally every compressed file is also mirrored to a precompressed sibling
+ * next to the original (".gz", ".br" or ".zst"), which the server then sends
+ * straight from the disk.
+ **/
+
+#ifndef GZCACHE_H
+#define GZCACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#include "encoding.h"
+
+/**
+ * @brief The number of hash buckets of the cache.
+ */
+#define GZCACHE_BUCKETS (1024)
+
+/**
+ * Structure of a cache entry
+ * @brief A compressed file and the key under which it was stored.
+ * @details Entries are reference counted, so that an entry that is evicted
+ * while a connection still sends it stays valid until it gets released.
+ */
+struct gzcache_entry
+{
+    char *path;
+    enum encoding encoding;
+    off_t size;
+    struct timespec mtime;
+    uint8_t *data;
+    size_t len;
+    int refs;
+    bool cached;
+    struct gzcache_entry *prev;
+    struct gzcache_entry *next;
+    struct gzcache_entry *hnext;
+};
+
+/**
+ * Structure of the cache
+ * @brief The hash table and the LRU list of all cached entries.
+ * @details The head of the LRU list is the most recently used entry.
+ */
+struct gzcache
+{
+    size_t budget;
+    size_t used;
+    bool mirror;
+    size_t hits;
+    size_t misses;
+    struct gzcache_entry *head;
+    struct gzcache_entry *tail;
+    struct gzcache_entry *buckets[GZCACHE_BUCKETS];
+};
+
+/**
+ * Create a cache.
+ * @brief Allocate an empty cache.
+ * @details The caller must call gzcache_destroy to free the cache.
+ * @param budget The maximum number of compressed bytes kept in memory. With a
+ * budget of 0 nothing gets cached.
+ * @param mirror If true compressed files are also written to siblings next
+ * to the original files.
+ * @return Upon success a pointer to the cache, otherwise NULL.
+ */
+struct gzcache *gzcache_create(size_t budget, bool mirror);
+
+/**
+ * Destroy a cache.
+ * @brief Free the cache and all entries that are not referenced anymore.
+ * @details Entries still referenced are freed by their last gzcache_release.
+ * @param cache The cache to destroy.
+ */
+void gzcache_destroy(struct gzcache *cache);
+
+/**
+ * Look up a compressed file.
+ * @brief Find the version of a file compressed with encoding whose size and
+ * modification time match st.
+ * @details Stale entries are dropped.
+ * The returned entry must be released with gzcache_release.
+ * @param cache The cache to search.
+ * @param path The path of the uncompressed file.
+ * @param encoding The content coding of the compressed file.
+ * @param st The current stat of the uncompressed file.
+ * @return The entry if found, otherwise NULL.
+ */
+struct gzcache_entry *gzcache_lookup(struct gzcache *cache, const char *path,
+                                     enum encoding encoding,
+                                     const struct stat *st);
+
+/**
+ * Insert a compressed file.
+ * @brief Store a freshly compressed file in the cache.
+ * @details The cache takes ownership of data, even on failure. Entries that
+ * don't fit into the budget are returned but not cached.
+ * The returned entry must be released with gzcache_release.
+ * @param cache The cache to insert into.
+ * @param path The path of the uncompressed file.
+ * @param encoding The content coding data is compressed with.
+ * @param st The stat of the uncompressed file at the time of compression.
+ * @param data The compressed bytes, allocated with malloc.
+ * @param len The number of compressed bytes.
+ * @return Upon success the new entry, otherwise NULL.
+ */
+struct gzcache_entry *gzcache_insert(struct gzcache *cache, const char *path,
+                                     enum encoding encoding,
+                                     const struct stat *st, uint8_t *data,
+                                     size_t len);
+
+/**
+ * Release an entry.
+ * @brief Drop a reference obtained by gzcache_lookup or gzcache_insert.
+ * @param entry The entry to release.
+ */
+void gzcache_release(struct gzcache_entry *entry);
+
+#endif
@@ -0,0 +1,73 @@
+/**
+ * @file gzdecode.h
+ * @date 22.01.2021
+ * @brief Streaming decoder for gzip, brotli and zstd encoded response bodies
+ * @details Decodes a body that is delimited by a length, by chunked transfer encoding or by the
+ * end of the connection, in one pass: the chunk framing is parsed incrementally straight out of
+ * the input buffer and the chunk data is handed to zlib (or the brotli or zstd decoder, if they
+ * are compiled in, see encoding.h) without being copied. The input buffer
+ * starts at GZDECODE_MIN_INPUT bytes and doubles (up to GZDECODE_MAX_INPUT) whenever a read
+ * fills it completely, so a fast connection is read with few large reads. The output is written
+ * in blocks of GZDECODE_OUTPUT_SIZE bytes, a multiple of the page size. All buffers live on the
+ * heap and are allocated once per body, the chunk sizes the server sends are only counted down,
+ * so a hostile chunk size can neither blow the stack nor make the decoder allocate memory.
+ * The same module is used by 3-http-flofriday and 3-http-briemelchen, keep the copies in sync.
+ */
+
+#ifndef GZDECODE_H
+#define GZDECODE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "encoding.h"
+
+#define GZDECODE_MIN_INPUT (16 * 1024)
+#define GZDECODE_MAX_INPUT (256 * 1024)
+#define GZDECODE_OUTPUT_SIZE (64 * 1024)
+#define GZDECODE_LINE_SIZE 256
+
+/**
+ * @brief Reads at most len bytes from source into buf
+ * @return The number of bytes read, 0 at the end of the source and -1 on failure
+ */
+typedef ssize_t (*gzdecode_read_fn)(void *source, void *buf, size_t len);
+
+/**
+ * @brief The results of decoding a body
+ */
+enum gzdecode_result {
+    /** The whole body was decoded */
+    GZDECODE_OK,
+    /** The body is not valid data of its coding */
+    GZDECODE_BAD_DATA,
+    /** The chunk framing is malformed */
+    GZDECODE_BAD_FRAMING,
+    /** The body ended before it was complete */
+    GZDECODE_TRUNCATED,
+    /** Reading, writing or allocating failed (errno is set) */
+    GZDECODE_ERROR,
+    /** The coding is not compiled in */
+    GZDECODE_UNSUPPORTED
+};
+
+/**
+ * @brief Decodes a body with the content coding encoding from source and writes the decoded bytes
+ * to the descriptor out.
+ * @details If chunked is set, the body is chunked transfer encoded and ends with the last chunk
+ * and its trailer; otherwise it is length bytes long, or runs until the end of source if length is
+ * negative. Several gzip members or zstd frames following each other are decoded one after the
+ * other, a brotli body is a single stream. Reads never go beyond the end of a body with a length,
+ * a chunked body has to be the last data in source.
+ * @return The result of decoding
+ */
+enum gzdecode_result gzdecode_copy(int out, gzdecode_read_fn read, void *source, enum encoding encoding,
+                                   bool chunked, long long length);
+
+/**
+ * @brief Returns a description of the result.
+ */
+const char *gzdecode_strerror(enum gzdecode_result result);
+
+#endif
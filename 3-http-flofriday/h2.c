@@ -0,0 +1,759 @@
+/**
+ * @file h2.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.02.2021
+ *
+ * @brief Implementation of the h2 module.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "h2.h"
+
+/**
+ * @brief The number of entries of the static table.
+ */
+#define H2_STATIC_ENTRIES 61
+
+/**
+ * @brief The longest Huffman code in bits.
+ */
+#define H2_HUFFMAN_BITS 30
+
+/**
+ * @brief The symbol that ends a Huffman string, it must never be decoded.
+ */
+#define H2_HUFFMAN_EOS 256
+
+/**
+ * @brief The size every entry of the dynamic table adds besides its strings.
+ */
+#define H2_ENTRY_OVERHEAD 32
+
+/**
+ * @brief The static table of RFC 7541, index 1 is the first entry.
+ */
+static const struct h2_field static_table[H2_STATIC_ENTRIES] = {
+    {":authority", ""},
+    {":method", "GET"},
+    {":method", "POST"},
+    {":path", "/"},
+    {":path", "/index.html"},
+    {":scheme", "http"},
+    {":scheme", "https"},
+    {":status", "200"},
+    {":status", "204"},
+    {":status", "206"},
+    {":status", "304"},
+    {":status", "400"},
+    {":status", "404"},
+    {":status", "500"},
+    {"accept-charset", ""},
+    {"accept-encoding", "gzip, deflate"},
+    {"accept-language", ""},
+    {"accept-ranges", ""},
+    {"accept", ""},
+    {"access-control-allow-origin", ""},
+    {"age", ""},
+    {"allow", ""},
+    {"authorization", ""},
+    {"cache-control", ""},
+    {"content-disposition", ""},
+    {"content-encoding", ""},
+    {"content-language", ""},
+    {"content-length", ""},
+    {"content-location", ""},
+    {"content-range", ""},
+    {"content-type", ""},
+    {"cookie", ""},
+    {"date", ""},
+    {"etag", ""},
+    {"expect", ""},
+    {"expires", ""},
+    {"from", ""},
+    {"host", ""},
+    {"if-match", ""},
+    {"if-modified-since", ""},
+    {"if-none-match", ""},
+    {"if-range", ""},
+    {"if-unmodified-since", ""},
+    {"last-modified", ""},
+    {"link", ""},
+    {"location", ""},
+    {"max-forwards", ""},
+    {"proxy-authenticate", ""},
+    {"proxy-authorization", ""},
+    {"range", ""},
+    {"referer", ""},
+    {"refresh", ""},
+    {"retry-after", ""},
+    {"server", ""},
+    {"set-cookie", ""},
+    {"strict-transport-security", ""},
+    {"transfer-encoding", ""},
+    {"user-agent", ""},
+    {"vary", ""},
+    {"via", ""},
+    {"www-authenticate", ""},
+};
+
+/**
+ * @brief The number of Huffman codes of every length.
+ * @details The code of RFC 7541 is canonical, so the counts and the order of
+ * the symbols are enough to decode it (like inflate does).
+ */
+static const uint8_t huffman_counts[H2_HUFFMAN_BITS + 1] = {
+    0, 0, 0, 0, 0, 10, 26, 32, 6, 0, 5, 3, 2, 6, 2, 3, 0, 0, 0, 3, 8, 13, 26, 29, 12, 4, 15, 19, 29, 0, 4,
+};
+
+/**
+ * @brief The symbols ordered by the length of their code and then by value,
+ * the codes of one length are consecutive.
+ */
+static const uint16_t huffman_symbols[257] = {
+    48, 49, 50, 97, 99, 101, 105, 111, 115, 116, 32, 37,
+    45, 46, 47, 51, 52, 53, 54, 55, 56, 57, 61, 65,
+    95, 98, 100, 102, 103, 104, 108, 109, 110, 112, 114, 117,
+    58, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76,
+    77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 89,
+    106, 107, 113, 118, 119, 120, 121, 122, 38, 42, 44, 59,
+    88, 90, 33, 34, 40, 41, 63, 39, 43, 124, 35, 62,
+    0, 36, 64, 91, 93, 126, 94, 125, 60, 96, 123, 92,
+    195, 208, 128, 130, 131, 162, 184, 194, 224, 226, 153, 161,
+    167, 172, 176, 177, 179, 209, 216, 217, 227, 229, 230, 129,
+    132, 133, 134, 136, 146, 154, 156, 160, 163, 164, 169, 170,
+    173, 178, 181, 185, 186, 187, 189, 190, 196, 198, 228, 232,
+    233, 1, 135, 137, 138, 139, 140, 141, 143, 147, 149, 150,
+    151, 152, 155, 157, 158, 165, 166, 168, 174, 175, 180, 182,
+    183, 188, 191, 197, 231, 239, 9, 142, 144, 145, 148, 159,
+    171, 206, 215, 225, 236, 237, 199, 207, 234, 235, 192, 193,
+    200, 201, 202, 205, 210, 213, 218, 219, 238, 240, 242, 243,
+    255, 203, 204, 211, 212, 214, 221, 222, 223, 241, 244, 245,
+    246, 247, 248, 250, 251, 252, 253, 254, 2, 3, 4, 5,
+    6, 7, 8, 11, 12, 14, 15, 16, 17, 18, 19, 20,
+    21, 23, 24, 25, 26, 27, 28, 29, 30, 31, 127, 220,
+    249, 10, 13, 22, 256,
+};
+
+uint32_t h2_get32(const uint8_t *in)
+{
+    return (uint32_t)in[0] << 24 | (uint32_t)in[1] << 16 |
+           (uint32_t)in[2] << 8 | in[3];
+}
+
+void h2_put32(uint8_t *out, uint32_t value)
+{
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+void h2_read_frame(const uint8_t *in, struct h2_frame *frame)
+{
+    frame->length = (uint32_t)in[0] << 16 | (uint32_t)in[1] << 8 | in[2];
+    frame->type = in[3];
+    frame->flags = in[4];
+    frame->stream = h2_get32(in + 5) & 0x7fffffff;
+}
+
+void h2_write_frame(uint8_t *out, uint32_t length, uint8_t type,
+                    uint8_t flags, uint32_t stream)
+{
+    out[0] = length >> 16;
+    out[1] = length >> 8;
+    out[2] = length;
+    out[3] = type;
+    out[4] = flags;
+    h2_put32(out + 5, stream);
+}
+
+void h2_write_setting(uint8_t *out, enum h2_setting_id id, uint32_t value)
+{
+    out[0] = id >> 8;
+    out[1] = id;
+    h2_put32(out + 2, value);
+}
+
+void h2_settings_init(struct h2_settings *settings)
+{
+    settings->values[0] = 0;
+    settings->values[H2_HEADER_TABLE_SIZE] = H2_DEFAULT_TABLE_SIZE;
+    settings->values[H2_ENABLE_PUSH] = 1;
+    settings->values[H2_MAX_CONCURRENT_STREAMS] = UINT32_MAX;
+    settings->values[H2_INITIAL_WINDOW_SIZE] = H2_DEFAULT_WINDOW;
+    settings->values[H2_MAX_FRAME_SIZE] = H2_DEFAULT_FRAME_SIZE;
+    settings->values[H2_MAX_HEADER_LIST_SIZE] = UINT32_MAX;
+}
+
+enum h2_error h2_settings_apply(struct h2_settings *settings,
+                                const uint8_t *payload, size_t len)
+{
+    if (len % 6 != 0)
+    {
+        return H2_FRAME_SIZE_ERROR;
+    }
+    for (size_t i = 0; i < len; i += 6)
+    {
+        unsigned id = (unsigned)payload[i] << 8 | payload[i + 1];
+        uint32_t value = h2_get32(payload + i + 2);
+        if ((id == H2_ENABLE_PUSH && value > 1) ||
+            (id == H2_MAX_FRAME_SIZE &&
+             (value < H2_DEFAULT_FRAME_SIZE || value > 0xffffff)))
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        if (id == H2_INITIAL_WINDOW_SIZE && value > H2_MAX_WINDOW)
+        {
+            return H2_FLOW_CONTROL_ERROR;
+        }
+        if (id > 0 && id < H2_SETTING_COUNT)
+        {
+            settings->values[id] = value;
+        }
+    }
+    return H2_NO_ERROR;
+}
+
+/**
+ * Decode a base64url character.
+ * @return The value of the character, or -1 if it is none.
+ */
+static int base64url_value(char c)
+{
+    if (c >= 'A' && c <= 'Z')
+    {
+        return c - 'A';
+    }
+    if (c >= 'a' && c <= 'z')
+    {
+        return c - 'a' + 26;
+    }
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0' + 52;
+    }
+    if (c == '-')
+    {
+        return 62;
+    }
+    if (c == '_')
+    {
+        return 63;
+    }
+    return -1;
+}
+
+long h2_base64url_decode(const char *in, size_t len, uint8_t *out)
+{
+    while (len > 0 && in[len - 1] == '=')
+    {
+        len--;
+    }
+    if (len % 4 == 1)
+    {
+        return -1;
+    }
+
+    long n = 0;
+    uint32_t bits = 0;
+    int count = 0;
+    for (size_t i = 0; i < len; i++)
+    {
+        int value = base64url_value(in[i]);
+        if (value == -1)
+        {
+            return -1;
+        }
+        bits = bits << 6 | value;
+        count += 6;
+        if (count >= 8)
+        {
+            count -= 8;
+            out[n++] = bits >> count;
+        }
+    }
+    return n;
+}
+
+void h2_hpack_init(struct h2_hpack *hpack, size_t limit)
+{
+    hpack->entries = NULL;
+    hpack->count = 0;
+    hpack->cap = 0;
+    hpack->size = 0;
+    hpack->max_size = limit;
+    hpack->limit = limit;
+}
+
+void h2_hpack_destroy(struct h2_hpack *hpack)
+{
+    for (size_t i = 0; i < hpack->count; i++)
+    {
+        free(hpack->entries[i].name);
+    }
+    free(hpack->entries);
+    hpack->entries = NULL;
+    hpack->count = 0;
+    hpack->size = 0;
+}
+
+/**
+ * Evict entries.
+ * @brief Remove the oldest entries until the table is at most max bytes.
+ */
+static void evict_entries(struct h2_hpack *hpack, size_t max)
+{
+    while (hpack->count > 0 && hpack->size > max)
+    {
+        struct h2_hpack_entry *entry = &hpack->entries[--hpack->count];
+        hpack->size -= entry->name_len + entry->value_len + H2_ENTRY_OVERHEAD;
+        free(entry->name);
+    }
+}
+
+/**
+ * Add an entry.
+ * @brief Insert a field as the newest entry of the dynamic table, evicting
+ * older ones to make room.
+ * @details Takes ownership of strings, which holds the name followed by the
+ * value. A field larger than the whole table empties it and is dropped.
+ * @return Upon success 0, otherwise -1 (out of memory).
+ */
+static int add_entry(struct h2_hpack *hpack, char *strings, size_t name_len,
+                     size_t value_len)
+{
+    size_t size = name_len + value_len + H2_ENTRY_OVERHEAD;
+    if (size > hpack->max_size)
+    {
+        evict_entries(hpack, 0);
+        free(strings);
+        return 0;
+    }
+    evict_entries(hpack, hpack->max_size - size);
+
+    if (hpack->count == hpack->cap)
+    {
+        size_t cap = hpack->cap == 0 ? 16 : hpack->cap * 2;
+        struct h2_hpack_entry *entries =
+            realloc(hpack->entries, cap * sizeof(struct h2_hpack_entry));
+        if (entries == NULL)
+        {
+            free(strings);
+            return -1;
+        }
+        hpack->entries = entries;
+        hpack->cap = cap;
+    }
+    memmove(hpack->entries + 1, hpack->entries,
+            hpack->count * sizeof(struct h2_hpack_entry));
+    hpack->entries[0].name = strings;
+    hpack->entries[0].name_len = name_len;
+    hpack->entries[0].value = strings + name_len;
+    hpack->entries[0].value_len = value_len;
+    hpack->count++;
+    hpack->size += size;
+    return 0;
+}
+
+/**
+ * Look up an index.
+ * @brief Find the field of an index of the static or the dynamic table.
+ * @return Upon success 0, otherwise -1 (the index is not in the tables).
+ */
+static int lookup_index(struct h2_hpack *hpack, size_t index,
+                        const char **name, size_t *name_len,
+                        const char **value, size_t *value_len)
+{
+    if (index == 0)
+    {
+        return -1;
+    }
+    if (index <= H2_STATIC_ENTRIES)
+    {
+        *name = static_table[index - 1].name;
+        *name_len = strlen(*name);
+        *value = static_table[index - 1].value;
+        *value_len = strlen(*value);
+        return 0;
+    }
+    index -= H2_STATIC_ENTRIES + 1;
+    if (index >= hpack->count)
+    {
+        return -1;
+    }
+    *name = hpack->entries[index].name;
+    *name_len = hpack->entries[index].name_len;
+    *value = hpack->entries[index].value;
+    *value_len = hpack->entries[index].value_len;
+    return 0;
+}
+
+/**
+ * Decode an integer.
+ * @brief Decode an integer with a prefix of the given number of bits in the
+ * first byte.
+ * @param pos The position in the block, advanced past the integer.
+ * @param end The end of the block.
+ * @param prefix The number of bits of the first byte that belong to it.
+ * @param value The destination.
+ * @return Upon success 0, otherwise -1.
+ */
+static int decode_int(const uint8_t **pos, const uint8_t *end, int prefix,
+                      size_t *value)
+{
+    if (*pos == end)
+    {
+        return -1;
+    }
+    size_t max = (1u << prefix) - 1;
+    size_t v = *(*pos)++ & max;
+    if (v < max)
+    {
+        *value = v;
+        return 0;
+    }
+
+    // Larger values don't fit into any block we accept anyway
+    for (int shift = 0; *pos < end && shift <= 28; shift += 7)
+    {
+        uint8_t b = *(*pos)++;
+        v += (size_t)(b & 0x7f) << shift;
+        if ((b & 0x80) == 0)
+        {
+            *value = v;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Decode a Huffman string.
+ * @brief Decode len bytes into out, which holds at least len * 8 / 5 bytes
+ * (the shortest code has 5 bits).
+ * @details The string may end with at most 7 bits of padding, which must be
+ * the start of the code of EOS (all ones).
+ * @return The length of the decoded string, or -1 if it is invalid.
+ */
+static long huffman_decode(const uint8_t *in, size_t len, char *out)
+{
+    size_t total = len * 8;
+    size_t bit = 0;
+    long n = 0;
+    while (bit < total)
+    {
+        size_t start = bit;
+        bool ones = true;
+        int code = 0, first = 0, index = 0;
+        int symbol = -1;
+        for (int bits = 1; bits <= H2_HUFFMAN_BITS && bit < total; bits++)
+        {
+            int b = (in[bit / 8] >> (7 - bit % 8)) & 1;
+            bit++;
+            ones = ones && b == 1;
+            code |= b;
+            int count = huffman_counts[bits];
+            if (code - count < first)
+            {
+                symbol = huffman_symbols[index + (code - first)];
+                break;
+            }
+            index += count;
+            first = (first + count) << 1;
+            code <<= 1;
+        }
+
+        if (symbol == -1)
+        {
+            // Only padding may be left
+            return bit == total && bit - start < 8 && ones ? n : -1;
+        }
+        if (symbol == H2_HUFFMAN_EOS)
+        {
+            return -1;
+        }
+        out[n++] = symbol;
+    }
+    return n;
+}
+
+/**
+ * Structure of a decoded string
+ * @brief The text either points into the block or, if it was Huffman coded,
+ * to the decoded text, which has to be freed.
+ */
+struct hpack_string
+{
+    const char *text;
+    size_t len;
+    char *decoded;
+};
+
+/**
+ * Decode a string.
+ * @param pos The position in the block, advanced past the string.
+ * @param end The end of the block.
+ * @param str The destination.
+ * @return H2_NO_ERROR, H2_COMPRESSION_ERROR or H2_INTERNAL_ERROR.
+ */
+static enum h2_error decode_string(const uint8_t **pos, const uint8_t *end,
+                                   struct hpack_string *str)
+{
+    str->decoded = NULL;
+    if (*pos == end)
+    {
+        return H2_COMPRESSION_ERROR;
+    }
+    bool huffman = (**pos & 0x80) != 0;
+    size_t len;
+    if (decode_int(pos, end, 7, &len) == -1 || len > (size_t)(end - *pos))
+    {
+        return H2_COMPRESSION_ERROR;
+    }
+    const uint8_t *text = *pos;
+    *pos += len;
+    if (!huffman)
+    {
+        str->text = (const char *)text;
+        str->len = len;
+        return H2_NO_ERROR;
+    }
+
+    str->decoded = malloc(len * 8 / 5 + 1);
+    if (str->decoded == NULL)
+    {
+        return H2_INTERNAL_ERROR;
+    }
+    long n = huffman_decode(text, len, str->decoded);
+    if (n == -1)
+    {
+        free(str->decoded);
+        str->decoded = NULL;
+        return H2_COMPRESSION_ERROR;
+    }
+    str->text = str->decoded;
+    str->len = n;
+    return H2_NO_ERROR;
+}
+
+/**
+ * Decode a literal field.
+ * @brief Decode the name (an index or a string) and the value of a literal
+ * and pass it to field, and add it to the dynamic table if it is indexed.
+ * @param prefix The bits of the name index in the first byte.
+ * @param indexed Whether the field is added to the dynamic table.
+ * @return H2_NO_ERROR, H2_COMPRESSION_ERROR or H2_INTERNAL_ERROR.
+ */
+static enum h2_error decode_literal(struct h2_hpack *hpack,
+                                    const uint8_t **pos, const uint8_t *end,
+                                    int prefix, bool indexed,
+                                    h2_field_fn field, void *arg)
+{
+    size_t index;
+    if (decode_int(pos, end, prefix, &index) == -1)
+    {
+        return H2_COMPRESSION_ERROR;
+    }
+
+    struct hpack_string name = {NULL, 0, NULL};
+    const char *unused;
+    size_t unused_len;
+    enum h2_error err = H2_NO_ERROR;
+    if (index == 0)
+    {
+        err = decode_string(pos, end, &name);
+    }
+    else if (lookup_index(hpack, index, &name.text, &name.len, &unused,
+                          &unused_len) == -1)
+    {
+        err = H2_COMPRESSION_ERROR;
+    }
+    if (err != H2_NO_ERROR)
+    {
+        return err;
+    }
+
+    struct hpack_string value;
+    err = decode_string(pos, end, &value);
+    if (err != H2_NO_ERROR)
+    {
+        free(name.decoded);
+        return err;
+    }
+
+    // The name may be an entry that adding the field evicts, so the entry
+    // gets copies of both
+    char *strings = NULL;
+    if (indexed)
+    {
+        strings = malloc(name.len + value.len + 1);
+        if (strings == NULL)
+        {
+            err = H2_INTERNAL_ERROR;
+        }
+        else
+        {
+            memcpy(strings, name.text, name.len);
+            memcpy(strings + name.len, value.text, value.len);
+        }
+    }
+    if (err == H2_NO_ERROR)
+    {
+        field(arg, name.text, name.len, value.text, value.len);
+    }
+    size_t name_len = name.len, value_len = value.len;
+    free(name.decoded);
+    free(value.decoded);
+    if (strings != NULL && add_entry(hpack, strings, name_len, value_len) == -1)
+    {
+        err = H2_INTERNAL_ERROR;
+    }
+    return err;
+}
+
+enum h2_error h2_hpack_decode(struct h2_hpack *hpack, const uint8_t *block,
+                              size_t len, h2_field_fn field, void *arg)
+{
+    const uint8_t *pos = block;
+    const uint8_t *end = block + len;
+    bool fields = false;
+    while (pos < end)
+    {
+        uint8_t b = *pos;
+        enum h2_error err = H2_NO_ERROR;
+        if ((b & 0x80) != 0)
+        {
+            // Indexed field
+            size_t index;
+            const char *name, *value;
+            size_t name_len, value_len;
+            if (decode_int(&pos, end, 7, &index) == -1 ||
+                lookup_index(hpack, index, &name, &name_len, &value,
+                             &value_len) == -1)
+            {
+                return H2_COMPRESSION_ERROR;
+            }
+            field(arg, name, name_len, value, value_len);
+        }
+        else if ((b & 0xc0) == 0x40)
+        {
+            // Literal with incremental indexing
+            err = decode_literal(hpack, &pos, end, 6, true, field, arg);
+        }
+        else if ((b & 0xe0) == 0x20)
+        {
+            // Dynamic table size update, only allowed in front of the fields
+            size_t size;
+            if (fields || decode_int(&pos, end, 5, &size) == -1 ||
+                size > hpack->limit)
+            {
+                return H2_COMPRESSION_ERROR;
+            }
+            hpack->max_size = size;
+            evict_entries(hpack, size);
+            continue;
+        }
+        else
+        {
+            // Literal without indexing or never indexed
+            err = decode_literal(hpack, &pos, end, 4, false, field, arg);
+        }
+        if (err != H2_NO_ERROR)
+        {
+            return err;
+        }
+        fields = true;
+    }
+    return H2_NO_ERROR;
+}
+
+/**
+ * Encode an integer.
+ * @brief Write an integer with a prefix of the given number of bits, the
+ * other bits of the first byte are taken from first.
+ * @return The number of bytes written, 0 if they don't fit into cap.
+ */
+static size_t encode_int(uint8_t *out, size_t cap, uint8_t first, int prefix,
+                         size_t value)
+{
+    size_t max = (1u << prefix) - 1;
+    if (cap == 0)
+    {
+        return 0;
+    }
+    if (value < max)
+    {
+        out[0] = first | value;
+        return 1;
+    }
+    out[0] = first | max;
+    value -= max;
+    size_t n = 1;
+    for (; value >= 0x80; value >>= 7)
+    {
+        if (n == cap)
+        {
+            return 0;
+        }
+        out[n++] = 0x80 | (value & 0x7f);
+    }
+    if (n == cap)
+    {
+        return 0;
+    }
+    out[n++] = value;
+    return n;
+}
+
+/**
+ * Encode a string.
+ * @brief Write a string as it is, without Huffman coding.
+ * @return The number of bytes written, 0 if they don't fit into cap.
+ */
+static size_t encode_string(uint8_t *out, size_t cap, const char *text)
+{
+    size_t len = strlen(text);
+    size_t n = encode_int(out, cap, 0x00, 7, len);
+    if (n == 0 || cap - n < len)
+    {
+        return 0;
+    }
+    memcpy(out + n, text, len);
+    return n + len;
+}
+
+size_t h2_hpack_encode(uint8_t *out, size_t cap, const char *name,
+                       const char *value)
+{
+    size_t name_index = 0;
+    for (size_t i = 0; i < H2_STATIC_ENTRIES; i++)
+    {
+        if (strcmp(static_table[i].name, name) != 0)
+        {
+            continue;
+        }
+        if (strcmp(static_table[i].value, value) == 0)
+        {
+            return encode_int(out, cap, 0x80, 7, i + 1);
+        }
+        if (name_index == 0)
+        {
+            name_index = i + 1;
+        }
+    }
+
+    size_t n = encode_int(out, cap, 0x00, 4, name_index);
+    if (n > 0 && name_index == 0)
+    {
+        size_t len = encode_string(out + n, cap - n, name);
+        n = len == 0 ? 0 : n + len;
+    }
+    if (n > 0)
+    {
+        size_t len = encode_string(out + n, cap - n, value);
+        n = len == 0 ? 0 : n + len;
+    }
+    return n;
+}
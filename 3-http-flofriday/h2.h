@@ -0,0 +1,283 @@
+/**
+ * @file h2.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 21.02.2021
+ *
+ * @brief Provides the framing and header compression of HTTP/2.
+ *
+ * The h2 module. It only knows the wire format (RFC 7540 and RFC 7541) and
+ * holds no connection state, the server and the client drive their streams
+ * themselves. Header blocks are decoded with the static table, the dynamic
+ * table and Huffman coded strings, as a peer may use all of them. Header
+ * fields are encoded with the static table only and never indexed, so the
+ * encoder needs no state and the peer's dynamic table stays empty.
+ **/
+
+#ifndef H2_H
+#define H2_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The connection preface a client sends first.
+ */
+#define H2_PREFACE "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n"
+#define H2_PREFACE_LEN 24
+
+/**
+ * @brief The length of a frame header.
+ */
+#define H2_FRAME_HEADER 9
+
+/**
+ * @brief The maximum frame payload every peer accepts, larger frames have to
+ * be allowed with SETTINGS_MAX_FRAME_SIZE first.
+ */
+#define H2_DEFAULT_FRAME_SIZE 16384
+
+/**
+ * @brief The initial flow control window of the connection and every stream.
+ */
+#define H2_DEFAULT_WINDOW 65535
+
+/**
+ * @brief The largest flow control window allowed.
+ */
+#define H2_MAX_WINDOW 0x7fffffff
+
+/**
+ * @brief The initial size of the dynamic table of a decoder.
+ */
+#define H2_DEFAULT_TABLE_SIZE 4096
+
+/**
+ * @brief The frame types.
+ */
+enum h2_type
+{
+    H2_DATA,
+    H2_HEADERS,
+    H2_PRIORITY,
+    H2_RST_STREAM,
+    H2_SETTINGS,
+    H2_PUSH_PROMISE,
+    H2_PING,
+    H2_GOAWAY,
+    H2_WINDOW_UPDATE,
+    H2_CONTINUATION,
+};
+
+/**
+ * @brief The frame flags, ACK is used by SETTINGS and PING.
+ */
+#define H2_FLAG_END_STREAM 0x1
+#define H2_FLAG_ACK 0x1
+#define H2_FLAG_END_HEADERS 0x4
+#define H2_FLAG_PADDED 0x8
+#define H2_FLAG_PRIORITY 0x20
+
+/**
+ * @brief The error codes of RST_STREAM and GOAWAY.
+ */
+enum h2_error
+{
+    H2_NO_ERROR,
+    H2_PROTOCOL_ERROR,
+    H2_INTERNAL_ERROR,
+    H2_FLOW_CONTROL_ERROR,
+    H2_SETTINGS_TIMEOUT,
+    H2_STREAM_CLOSED,
+    H2_FRAME_SIZE_ERROR,
+    H2_REFUSED_STREAM,
+    H2_CANCEL,
+    H2_COMPRESSION_ERROR,
+    H2_CONNECT_ERROR,
+    H2_ENHANCE_YOUR_CALM,
+    H2_INADEQUATE_SECURITY,
+    H2_HTTP_1_1_REQUIRED,
+};
+
+/**
+ * @brief The identifiers of the settings.
+ */
+enum h2_setting_id
+{
+    H2_HEADER_TABLE_SIZE = 1,
+    H2_ENABLE_PUSH,
+    H2_MAX_CONCURRENT_STREAMS,
+    H2_INITIAL_WINDOW_SIZE,
+    H2_MAX_FRAME_SIZE,
+    H2_MAX_HEADER_LIST_SIZE,
+    H2_SETTING_COUNT,
+};
+
+/**
+ * Structure of a frame header
+ * @brief The fields of the 9 bytes in front of every frame payload.
+ */
+struct h2_frame
+{
+    uint32_t length;
+    uint8_t type;
+    uint8_t flags;
+    uint32_t stream;
+};
+
+/**
+ * Structure of the settings of a peer
+ * @brief The values indexed by enum h2_setting_id, index 0 is unused.
+ */
+struct h2_settings
+{
+    uint32_t values[H2_SETTING_COUNT];
+};
+
+/**
+ * Structure of an entry of the static table
+ * @brief A header field, both strings are terminated.
+ */
+struct h2_field
+{
+    const char *name;
+    const char *value;
+};
+
+/**
+ * Structure of a decoder
+ * @brief The dynamic table, newest entry first.
+ * @details The strings of the entries are allocated together, value follows
+ * name.
+ */
+struct h2_hpack
+{
+    struct h2_hpack_entry
+    {
+        char *name;
+        size_t name_len;
+        char *value;
+        size_t value_len;
+    } *entries;
+    size_t count;
+    size_t cap;
+    size_t size;
+    size_t max_size;
+    size_t limit;
+};
+
+/**
+ * @brief Receives every header field of a decoded block in order, neither
+ * string is terminated.
+ */
+typedef void (*h2_field_fn)(void *arg, const char *name, size_t name_len,
+                            const char *value, size_t value_len);
+
+/**
+ * Read a 32 bit number.
+ * @brief Read a big endian number from 4 bytes.
+ */
+uint32_t h2_get32(const uint8_t *in);
+
+/**
+ * Write a 32 bit number.
+ * @brief Write a number as 4 big endian bytes.
+ */
+void h2_put32(uint8_t *out, uint32_t value);
+
+/**
+ * Parse a frame header.
+ * @brief Read the H2_FRAME_HEADER bytes at in into frame.
+ * @details The reserved bit of the stream identifier is ignored.
+ */
+void h2_read_frame(const uint8_t *in, struct h2_frame *frame);
+
+/**
+ * Write a frame header.
+ * @brief Write the H2_FRAME_HEADER bytes of a frame to out.
+ */
+void h2_write_frame(uint8_t *out, uint32_t length, uint8_t type,
+                    uint8_t flags, uint32_t stream);
+
+/**
+ * Write a setting.
+ * @brief Write the 6 bytes of a setting in a SETTINGS payload to out.
+ */
+void h2_write_setting(uint8_t *out, enum h2_setting_id id, uint32_t value);
+
+/**
+ * Initialize settings.
+ * @brief Set all values to the ones a peer has before its first SETTINGS.
+ */
+void h2_settings_init(struct h2_settings *settings);
+
+/**
+ * Apply a SETTINGS payload.
+ * @brief Store every setting of the payload, unknown ones are ignored.
+ * @param settings The settings to update.
+ * @param payload The payload of the frame.
+ * @param len The length of the payload.
+ * @return H2_NO_ERROR, or the error of the connection if the payload or a
+ * value is invalid.
+ */
+enum h2_error h2_settings_apply(struct h2_settings *settings,
+                                const uint8_t *payload, size_t len);
+
+/**
+ * Decode base64url.
+ * @brief Decode the value of an HTTP2-Settings header, padding is optional.
+ * @param in The text.
+ * @param len The length of the text.
+ * @param out The destination, at least len * 3 / 4 bytes.
+ * @return The number of decoded bytes, or -1 if the text is invalid.
+ */
+long h2_base64url_decode(const char *in, size_t len, uint8_t *out);
+
+/**
+ * Create a decoder.
+ * @brief Start with an empty dynamic table.
+ * @param hpack The decoder to initialize.
+ * @param limit The largest size of the dynamic table the encoder of the peer
+ * may choose (our SETTINGS_HEADER_TABLE_SIZE).
+ */
+void h2_hpack_init(struct h2_hpack *hpack, size_t limit);
+
+/**
+ * Destroy a decoder.
+ * @brief Free the dynamic table.
+ */
+void h2_hpack_destroy(struct h2_hpack *hpack);
+
+/**
+ * Decode a header block.
+ * @brief Decode the complete block (the fragments of HEADERS and all its
+ * CONTINUATION frames) and pass every field to field.
+ * @details The block must always be decoded, even for a stream that is
+ * refused, so the dynamic table stays the same as the one of the peer.
+ * @param hpack The decoder of the connection.
+ * @param block The block.
+ * @param len The length of the block.
+ * @param field The function that receives the fields.
+ * @param arg Passed to field.
+ * @return H2_NO_ERROR, or H2_COMPRESSION_ERROR (the connection can't be used
+ * anymore) or H2_INTERNAL_ERROR if memory ran out.
+ */
+enum h2_error h2_hpack_decode(struct h2_hpack *hpack, const uint8_t *block,
+                              size_t len, h2_field_fn field, void *arg);
+
+/**
+ * Encode a header field.
+ * @brief Append a field to a header block.
+ * @details A field of the static table is written as its index, otherwise the
+ * field is a literal without indexing, its name an index if the static table
+ * has it. The name must be lowercase.
+ * @param out The destination.
+ * @param cap The number of bytes left at out.
+ * @param name The name, terminated.
+ * @param value The value, terminated.
+ * @return The number of bytes written, 0 if they don't fit into cap.
+ */
+size_t h2_hpack_encode(uint8_t *out, size_t cap, const char *name,
+                       const char *value);
+
+#endif
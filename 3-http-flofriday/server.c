@@ -24,6 +24,18 @@
 #include <time.h>
 #include <zlib.h>
 #include <fcntl.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/sendfile.h>
+#include <sys/uio.h>
+#include <sys/wait.h>
+#include <poll.h>
+
+#include "encoding.h"
+#include "fileio.h"
+#include "gzcache.h"
+#include "h2.h"
+#include "uring.h"
 
 /**
  * Internal buffer size.
@@ -31,6 +43,370 @@
  **/
 #define BUFFER_SIZE 1024
 
+/**
+ * Maximum request header size.
+ * @brief Requests with a larger header are answered with 400 Bad Request.
+ **/
+#define REQUEST_SIZE 8192
+
+/**
+ * Maximum response header size.
+ * @brief The size of the buffer every response header is rendered into.
+ **/
+#define HEADER_SIZE 512
+
+/**
+ * Maximum number of events handled per epoll_wait call.
+ **/
+#define MAX_EVENTS 64
+
+/**
+ * Idle timeout.
+ * @brief Connections without any progress for this many seconds are closed.
+ **/
+#define IDLE_TIMEOUT 10
+
+/**
+ * Default gzip cache budget.
+ * @brief The number of compressed bytes kept in memory if not set with -c.
+ **/
+#define DEFAULT_CACHE_BUDGET (64 * 1024 * 1024)
+
+/**
+ * Default number of disk threads.
+ * @brief The number of threads that open and compress files if not set with
+ * -t.
+ **/
+#define DEFAULT_DISK_THREADS 4
+
+/**
+ * Drain timeout.
+ * @brief On shutdown, responses still in flight get this many seconds to 
+ * finish.
+ **/
+#define DRAIN_TIMEOUT 5
+
+/**
+ * Maximum number of byte ranges.
+ * @brief Requests with more ranges are answered with the whole file, so a 
+ * client cannot make the server send small overlapping parts over and over.
+ **/
+#define MAX_RANGES 16
+
+/**
+ * Size of the header of a part of a multipart/byteranges body.
+ **/
+#define PART_HEADER_SIZE 256
+
+/**
+ * The boundary between the parts of a multipart/byteranges body.
+ **/
+#define RANGE_BOUNDARY "3d6b6a416f9b5cf1e3f6c0d2a9b7e85f"
+
+/**
+ * Streaming threshold.
+ * @brief Compressed responses for files larger than this which are not cached
+ * yet are deflated while they are sent instead of up front.
+ **/
+#define STREAM_THRESHOLD (1024 * 1024)
+
+/**
+ * Streaming window.
+ * @brief The number of uncompressed bytes deflated into one chunk.
+ **/
+#define STREAM_WINDOW (32 * 1024)
+
+/**
+ * Number of io_uring submission queue entries.
+ **/
+#define URING_ENTRIES 256
+
+/**
+ * Provided buffers.
+ * @brief The number and size of the buffers the kernel reads requests into 
+ * in io_uring mode, and the id of their group.
+ **/
+#define URING_BUFFERS 64
+#define URING_BUFFER_SIZE 4096
+#define URING_BUFFER_GROUP 0
+
+/**
+ * Splice window.
+ * @brief The number of file bytes moved through the pipe of a connection at 
+ * once in io_uring mode, the default capacity of a pipe.
+ **/
+#define SPLICE_WINDOW (64 * 1024)
+
+/**
+ * HTTP/2 streams.
+ * @brief The number of streams a client may have open on one HTTP/2 
+ * connection at the same time, more are refused.
+ **/
+#define H2_MAX_STREAMS 100
+
+/**
+ * HTTP/2 header block size.
+ * @brief The largest header block (HEADERS and all its CONTINUATION frames)
+ * of a request, a larger one ends the connection.
+ **/
+#define H2_BLOCK_SIZE (64 * 1024)
+
+/**
+ * HTTP/2 output limit.
+ * @brief No more frames are read or queued while this many bytes wait to be
+ * sent, so a client that doesn't read can't grow the buffer.
+ **/
+#define H2_OUT_LIMIT (64 * 1024)
+
+/**
+ * The operations of a connection in io_uring mode.
+ * @brief Stored in the lowest bits of the user data of an entry, next to the
+ * (16 byte aligned) connection.
+ **/
+enum uring_op
+{
+    URING_RECV,
+    URING_SEND,
+    URING_SPLICE_IN,
+    URING_SPLICE_OUT,
+};
+#define URING_OP_MASK 3
+
+/**
+ * The server's own entries in io_uring mode.
+ * @brief Their user data is smaller than any connection pointer.
+ **/
+enum uring_tag
+{
+    URING_ACCEPT = 1,
+    URING_JOBS,
+    URING_TICK,
+    URING_CANCEL,
+    URING_TAGS = 16,
+};
+
+/**
+ * The states a connection walks through.
+ * @brief Each connection is a small state machine driven by the event loop.
+ **/
+enum conn_state
+{
+    STATE_READ_HEADER,
+    STATE_OPEN_FILE,
+    STATE_WAIT_FILE,
+    STATE_SEND_HEADER,
+    STATE_SEND_BODY,
+    STATE_H2,
+    STATE_CLOSE,
+};
+
+/**
+ * A streamed compressed body.
+ * @brief The deflate state and the buffer of the chunk currently sent.
+ * @details The whole body is a single gzip stream.
+ **/
+struct gzstream
+{
+    z_stream zs;
+    uint8_t in[STREAM_WINDOW];
+    uint8_t *out;
+    size_t out_cap;
+    size_t out_len;
+    size_t out_sent;
+    bool done;
+};
+
+/**
+ * A blocking file operation.
+ * @brief Opening and stating the requested file, or compressing it.
+ * @details Runs on a disk thread, so a file that has to be read from the 
+ * disk first doesn't stall the event loop. The connection it belongs to is 
+ * the owner of the job, which is NULL if the connection was closed meanwhile.
+ * Opening also chooses the content coding (unless ranges were requested) and
+ * opens the precompressed sibling instead if there is one for it, which is
+ * then marked with variant.
+ * A job for a HTTP/2 stream also knows its stream, and h2 tells the disk
+ * thread that large files can't be compressed while they are sent.
+ **/
+struct file_job
+{
+    struct fileio_job job;
+    struct h2_stream *stream;
+    bool h2;
+    char *filename;
+    int fd;
+    struct stat st;
+    struct encoding_accept accept;
+    bool ranged;
+    enum encoding encoding;
+    bool variant;
+    bool failed;
+    uint8_t *data;
+    ssize_t data_len;
+};
+
+/**
+ * A byte range of a file.
+ * @brief Both positions are inclusive. While parsing first or last may be -1,
+ * if it was omitted in the request, they are resolved against the size of 
+ * the file before the response is rendered.
+ **/
+struct byte_range
+{
+    off_t first;
+    off_t last;
+};
+
+/**
+ * A HTTP/2 stream.
+ * @brief One request of a HTTP/2 connection and the body of its response.
+ * @details A stream lives from its HEADERS until the last DATA frame was 
+ * sent or the client reset it, job is the file job working for it meanwhile.
+ * Once responded is set the HEADERS are queued and the body waits for flow
+ * control, window is what the client still allows on this stream.
+ **/
+struct h2_stream
+{
+    uint32_t id;
+    struct file_job *job;
+    char *filename;
+    struct encoding_accept accept;
+    enum encoding encoding;
+    bool responded;
+    bool reset;
+    struct gzcache_entry *gz_entry;
+    int body_fd;
+    size_t body_len;
+    size_t body_sent;
+    int64_t window;
+    struct h2_stream *next;
+};
+
+/**
+ * The HTTP/2 state of a connection.
+ * @brief The frames read but not handled yet, the header decoder, the 
+ * settings of the client, the flow control window of the connection, the open
+ * streams and the frames waiting to be sent.
+ * @details Frames are queued in out. A DATA frame of a file is sent with 
+ * sendfile instead: its header is rendered into segment_header and the 
+ * stream it belongs to is sending until segment bytes of the file followed.
+ * Such a frame is only started while out is empty, so frames leave in the 
+ * order they were queued. The streams are served round robin, a stream goes
+ * to the end of the list after each of its DATA frames.
+ **/
+struct h2_conn
+{
+    uint8_t in[H2_FRAME_HEADER + H2_DEFAULT_FRAME_SIZE];
+    size_t in_len;
+    bool preface;
+
+    uint8_t *block;
+    size_t block_len;
+    uint32_t block_stream;
+    bool continuation;
+    struct h2_hpack hpack;
+    struct h2_settings peer;
+
+    int64_t window;
+    uint32_t last_stream;
+    size_t stream_count;
+    size_t jobs;
+    struct h2_stream *streams;
+
+    uint8_t *out;
+    size_t out_len;
+    size_t out_sent;
+    size_t out_cap;
+    struct h2_stream *sending;
+    uint8_t segment_header[H2_FRAME_HEADER];
+    size_t segment_header_sent;
+    size_t segment;
+    size_t segment_sent;
+
+    bool goaway;
+    bool closing;
+};
+
+/**
+ * A client connection.
+ * @brief Holds everything needed to serve one request after another on a 
+ * single non-blocking socket.
+ **/
+struct connection
+{
+    int fd;
+    enum conn_state state;
+    time_t last_active;
+    bool want_write;
+    bool paused;
+    bool keep_alive;
+    struct encoding_accept accept;
+    enum encoding encoding;
+    char *filename;
+
+    char request[REQUEST_SIZE + 1];
+    size_t request_len;
+    size_t request_end;
+
+    char header[HEADER_SIZE];
+    size_t header_len;
+    size_t header_sent;
+
+    struct gzcache_entry *gz_entry;
+    struct gzstream *gz_stream;
+    struct file_job *job;
+    int body_fd;
+    off_t body_start;
+    size_t body_len;
+    size_t body_sent;
+
+    struct byte_range ranges[MAX_RANGES];
+    size_t range_count;
+    size_t range_index;
+    off_t file_size;
+    char part_header[PART_HEADER_SIZE];
+    size_t part_len;
+    size_t part_sent;
+
+    int pipe_fds[2];
+    size_t pipe_len;
+    int inflight;
+    size_t *send_progress;
+    struct iovec send_iov[2];
+    struct msghdr send_msg;
+
+    bool upgrade;
+    struct h2_settings upgrade_settings;
+    struct h2_conn *h2;
+
+    struct connection *prev;
+    struct connection *next;
+};
+
+/**
+ * The server.
+ * @brief The listening socket, the epoll instance and all open connections.
+ **/
+struct server
+{
+    char *port;
+    bool reuse_port;
+    size_t cache_budget;
+    bool cache_mirror;
+    size_t disk_threads;
+    bool use_uring;
+    bool h2;
+    int sockfd;
+    int epollfd;
+    char *index;
+    char *doc_root;
+    struct gzcache *cache;
+    struct fileio *io;
+    struct uring *ring;
+    struct __kernel_timespec tick;
+    struct connection *connections;
+};
+
 /**
  * The name of the current program.
  */
@@ -61,7 +437,8 @@ static void handle_signal(int signal)
  */
 static void usage(void)
 {
-    fprintf(stderr, "[%s] server [-p PORT] [-i INDEX] DOC_ROOT\n", prog_name);
+    fprintf(stderr, "[%s] server [-p PORT] [-i INDEX] [-c CACHE_BYTES] [-g] [-t THREADS] [-u] [-2] [-w WORKERS] DOC_ROOT\n",
+            prog_name);
 }
 
 /**
@@ -74,7 +451,7 @@ static void usage(void)
  * @param data The byte buffer to which the files content is written.
  * @return Upon success the number of bytes read otherwise -1.
  */
-static size_t read_file(FILE *input, uint8_t **data)
+static ssize_t read_file(FILE *input, uint8_t **data)
 {
     size_t len = 0;
     size_t cap = BUFFER_SIZE;
@@ -104,66 +481,40 @@ static size_t read_file(FILE *input, uint8_t **data)
 }
 
 /**
- * Read a file gzip compressed into memmory.
+ * Read a file compressed into memmory.
  * @brief The input file will be read into memmory and compressed with the 
- * gzip algorithm.
+ * given content coding.
  * @details Data can be NULL pointer as this function will allocate the needed 
  * memory anyway.
  * The caller must free the data buffer after use.
  * May use the global variable prog_name.
  * @param input The file to be read.
+ * @param encoding The coding to compress with, compiled in and not identity.
  * @param data The byte buffer to which the files content is written.
- * @return The number of bytes after the compression.
  * @return Upon success the number of bytes read after the compression
  * otherwise -1.
  */
-static size_t compress_file(FILE *input, uint8_t **data)
+static ssize_t compress_file(FILE *input, enum encoding encoding,
+                             uint8_t **data)
 {
     // Read the file
     uint8_t *raw;
-    size_t raw_len = read_file(input, &raw);
-
-    size_t data_len = sizeof(uint8_t) * compressBound(raw_len) + 128;
-    *data = malloc(data_len);
-    if (*data == NULL)
+    ssize_t raw_len = read_file(input, &raw);
+    if (raw_len < 0)
     {
-        free(raw);
         return -1;
     }
 
-    // Setup zlib for using gzip
-    z_stream stream;
-    stream.zalloc = Z_NULL;
-    stream.zfree = Z_NULL;
-    stream.opaque = Z_NULL;
-    int err = deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 16 + MAX_WBITS,
-                           8, Z_DEFAULT_STRATEGY);
-    if (err != Z_OK)
-    {
-        fprintf(stderr, "[%s] ERROR: Compression Init returned: %d\n",
-                prog_name, err);
-        free(raw);
-        return 0;
-    }
-
-    // Compress the data
-    stream.next_in = raw;
-    stream.avail_in = raw_len;
-    stream.next_out = *data;
-    stream.avail_out = data_len;
-    err = deflate(&stream, true);
-    if (err != Z_OK)
+    size_t data_len;
+    int err = encoding_compress(encoding, raw, raw_len, data, &data_len);
+    free(raw);
+    if (err == -1)
     {
-        fprintf(stderr, "[%s] ERROR: Compression returned: %d\n", prog_name,
-                err);
-        free(raw);
-        return 0;
+        fprintf(stderr, "[%s] ERROR: Compression with %s failed\n",
+                prog_name, encoding_name(encoding));
+        return -1;
     }
-
-    deflateEnd(&stream);
-    free(raw);
-
-    return data_len - stream.avail_out;
+    return data_len;
 }
 
 /**
@@ -171,10 +522,13 @@ static size_t compress_file(FILE *input, uint8_t **data)
  * @brief Create socket to call accept upon.
  * @details May use the global variable prog_name.
  * @param port The port as a string.
+ * @param reuse_port If true SO_REUSEPORT is set, so that multiple workers can 
+ * bind their own socket to the same port and the kernel balances the 
+ * connections between them.
  * @return Upon success a filedescriptor is returned, on error a negative 
  * integer will be returned.
  */
-static int create_socket(char *port)
+static int create_socket(char *port, bool reuse_port)
 {
     struct addrinfo hints, *ai;
     memset(&hints, 0, sizeof hints);
@@ -200,6 +554,15 @@ static int create_socket(char *port)
     }
     int optval = 1;
     setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof optval);
+    if (reuse_port &&
+        setsockopt(sockfd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof optval) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to set SO_REUSEPORT: %s\n",
+                prog_name, strerror(errno));
+        close(sockfd);
+        freeaddrinfo(ai);
+        return -1;
+    }
 
     if (bind(sockfd, ai->ai_addr, ai->ai_addrlen) < 0)
     {
@@ -209,7 +572,7 @@ static int create_socket(char *port)
         return -1;
     }
 
-    if (listen(sockfd, 32) == -1)
+    if (listen(sockfd, SOMAXCONN) == -1)
     {
         fprintf(stderr, "[%s] ERROR: Unable to listen to the socket: %s\n",
                 prog_name, strerror(errno));
@@ -221,6 +584,49 @@ static int create_socket(char *port)
     return sockfd;
 }
 
+/**
+ * Find the content type.
+ * @param filename The name of the file.
+ * @return The content type for the extention of the file or NULL if it is 
+ * unknown.
+ */
+static const char *content_type(const char *filename)
+{
+    char *extention = strrchr(filename, '.');
+    if (extention == NULL)
+    {
+        // No extention, no content type
+        return NULL;
+    }
+    else if (strcmp(extention, ".html") == 0 || strcmp(extention, ".htm") == 0)
+    {
+        return "text/html";
+    }
+    else if (strcmp(extention, ".css") == 0)
+    {
+        return "text/css";
+    }
+    else if (strcmp(extention, ".js") == 0)
+    {
+        return "application/javascript";
+    }
+    return NULL;
+}
+
+/**
+ * Format the current time.
+ * @brief Writes the current time as it is used in the Date header.
+ * @param text The buffer to write to.
+ * @param size The size of the buffer.
+ */
+static void format_date(char *text, size_t size)
+{
+    time_t t = time(NULL);
+    struct tm *tmp;
+    tmp = gmtime(&t);
+    strftime(text, size, "%a, %d %b %y %T %Z", tmp);
+}
+
 /**
  * Write a error header.
  * @brief Writes a HTTP/1.1 minimal header to a file, used for writing error responses.
@@ -241,45 +647,99 @@ static void write_error_header(FILE *conn_file, char *status)
  * @param filename The name of the file to be served, used to set the
  * Content-Type header.
  * @param filesize The size in bytes of the payload.
- * @param compress A flag to indicate if the content following this header will 
- * be gzip compressed.
+ * @param encoding The content coding of the content following this header.
+ * @param chunked A flag to indicate if the content is sent with chunked 
+ * transfer encoding, in which case filesize is ignored.
+ * @param keep_alive A flag to indicate if the connection stays open after the
+ * response.
  */
-static void write_success_header(FILE *conn_file, char *filename, size_t filesize, bool compress)
+static void write_success_header(FILE *conn_file, char *filename, size_t filesize,
+                                 enum encoding encoding, bool chunked,
+                                 bool keep_alive)
 {
     // Find out the time
     char time_text[200];
-    time_t t = time(NULL);
-    struct tm *tmp;
-    tmp = gmtime(&t);
-    strftime(time_text, sizeof(time_text), "%a, %d %b %y %T %Z", tmp);
+    format_date(time_text, sizeof(time_text));
 
     fprintf(conn_file,
             "\
 HTTP/1.1 200 OK\r\n\
 Date: %s\r\n\
-Content-Length: %lu\r\n\
-Connection: close\r\n",
-            time_text, filesize);
+Connection: %s\r\n",
+            time_text, keep_alive ? "keep-alive" : "close");
+
+    if (chunked)
+    {
+        fprintf(conn_file, "Transfer-Encoding: chunked\r\n");
+    }
+    else
+    {
+        fprintf(conn_file, "Content-Length: %lu\r\n", filesize);
+    }
 
     // Find out the contenttype
-    char *extention = strrchr(filename, '.');
-    if (strcmp(extention, ".html") == 0 || strcmp(extention, ".htm") == 0)
+    const char *type = content_type(filename);
+    if (type != NULL)
     {
-        fprintf(conn_file, "Content-Type: text/html\r\n");
+        fprintf(conn_file, "Content-Type: %s\r\n", type);
     }
-    else if (strcmp(extention, ".css") == 0)
+
+    // Tell if we compress, only the uncompressed file can be requested in 
+    // ranges. Caches must not hand the body to a client that accepts other 
+    // codings.
+    if (encoding != ENCODING_IDENTITY)
     {
-        fprintf(conn_file, "Content-Type: text/css\r\n");
+        fprintf(conn_file, "Content-Encoding: %s\r\n", encoding_name(encoding));
     }
-    else if (strcmp(extention, ".js") == 0)
+    else
     {
-        fprintf(conn_file, "Content-Type: application/javascript\r\n");
+        fprintf(conn_file, "Accept-Ranges: bytes\r\n");
     }
+    fprintf(conn_file, "Vary: Accept-Encoding\r\n");
+
+    // End the header
+    fprintf(conn_file, "\r\n");
+}
+
+/**
+ * Write a partial content header.
+ * @brief Writes a HTTP/1.1 206 header for the resolved ranges of the 
+ * connection.
+ * @details A single range is described with Content-Range, multiple ranges
+ * are sent as multipart/byteranges body.
+ * @param conn_file The file to write to.
+ * @param conn The connection whose ranges are sent.
+ */
+static void write_partial_header(FILE *conn_file, struct connection *conn)
+{
+    char time_text[200];
+    format_date(time_text, sizeof(time_text));
+
+    fprintf(conn_file,
+            "\
+HTTP/1.1 206 Partial Content\r\n\
+Date: %s\r\n\
+Connection: %s\r\n\
+Content-Length: %lu\r\n\
+Accept-Ranges: bytes\r\n",
+            time_text, conn->keep_alive ? "keep-alive" : "close",
+            conn->body_len);
 
-    // Tell if we compress
-    if (compress)
+    if (conn->range_count == 1)
     {
-        fprintf(conn_file, "Content-Encoding: gzip\r\n");
+        fprintf(conn_file, "Content-Range: bytes %lld-%lld/%lld\r\n",
+                (long long)conn->ranges[0].first,
+                (long long)conn->ranges[0].last, (long long)conn->file_size);
+        const char *type = content_type(conn->filename);
+        if (type != NULL)
+        {
+            fprintf(conn_file, "Content-Type: %s\r\n", type);
+        }
+    }
+    else
+    {
+        fprintf(conn_file,
+                "Content-Type: multipart/byteranges; boundary=" RANGE_BOUNDARY "\r\n");
     }
 
     // End the header
@@ -287,177 +747,4064 @@ Connection: close\r\n",
 }
 
 /**
- * Handle an incomming request.
- * @brief Handle an incomming request and answer it with a reasonable response.
- * @details Will write log messages to stderr.
- * May use the global variable prog_name. 
- * @param connfd The connection file descriptor.
- * @param index The name of the default file in a directory if no file is 
- * descriped in the request.
- * @param doc_root The name of the folder from which this server will server 
- * files from. 
- * @return 
+ * Format the header of a part.
+ * @brief Writes the boundary and header in front of a range of a 
+ * multipart/byteranges body, or the closing boundary after the last range.
+ * @param text The buffer to write to, at least PART_HEADER_SIZE bytes.
+ * @param conn The connection whose ranges are sent.
+ * @param index The index of the range, range_count for the closing boundary.
+ * @return The length of the part header.
  */
-static int handle_request(int connfd, char *index, char *doc_root)
+static size_t format_part_header(char *text, struct connection *conn,
+                                 size_t index)
 {
-    // Convert the file descriptor to a FILE struct
-    FILE *conn_file = fdopen(connfd, "r+");
-    if (conn_file == NULL)
+    if (index == conn->range_count)
     {
-        fprintf(stderr, "[%s] ERROR: Unable to fdopen: %s\n",
-                prog_name, strerror(errno));
-        close(connfd);
-        return -1;
+        return snprintf(text, PART_HEADER_SIZE, "\r\n--" RANGE_BOUNDARY "--\r\n");
     }
-    setvbuf(conn_file, NULL, _IONBF, 0);
 
-    // NOTE: The server neeeds to read the whole request before writing any
-    // content.
+    const char *type = content_type(conn->filename);
+    return snprintf(text, PART_HEADER_SIZE,
+                    "\r\n--" RANGE_BOUNDARY "\r\n%s%s%sContent-Range: bytes %lld-%lld/%lld\r\n\r\n",
+                    type != NULL ? "Content-Type: " : "",
+                    type != NULL ? type : "", type != NULL ? "\r\n" : "",
+                    (long long)conn->ranges[index].first,
+                    (long long)conn->ranges[index].last,
+                    (long long)conn->file_size);
+}
 
-    // parse the first line
-    char *first = NULL;
-    size_t first_cap = 0;
-    if (getline(&first, &first_cap, conn_file) == -1)
+/**
+ * Parse a Range header.
+ * @brief Parse the byte ranges of a Range header value into the connection.
+ * @details An invalid or unsupported value is ignored as if there was no 
+ * Range header, just like a value with more than MAX_RANGES ranges.
+ * @param conn The connection which requests the ranges.
+ * @param value The value of the header, it ends with the end of the line.
+ */
+static void parse_ranges(struct connection *conn, const char *value)
+{
+    conn->range_count = 0;
+    while (*value == ' ' || *value == '\t')
     {
-        fprintf(stderr, "[%s] Request: 400 Bad Request (No first line)\n", prog_name);
-        write_error_header(conn_file, "400 Bad Request");
-        free(first);
-        fclose(conn_file);
-        return 0;
+        value++;
     }
-    char *method = strtok(first, " ");
-    char *resource = strtok(NULL, " ");
-    char *protocol = strtok(NULL, "\r");
+    if (strncmp(value, "bytes=", strlen("bytes=")) != 0)
+    {
+        return;
+    }
+    const char *pos = value + strlen("bytes=");
 
-    // read all other headerfields
-    char *line = NULL;
-    size_t cap = 0;
-    bool compress = false;
     while (true)
     {
-        if (getline(&line, &cap, conn_file) == -1)
+        while (*pos == ' ' || *pos == '\t')
         {
-            fprintf(stderr, "[%s] Request: 400 Bad Request (No empty line)\n",
-                    prog_name);
-            write_error_header(conn_file, "400 Bad Request");
-            free(first);
-            free(line);
-            fclose(conn_file);
-            return 0;
+            pos++;
         }
 
-        if (strcmp(line, "\r\n") == 0)
+        struct byte_range range = {-1, -1};
+        char *end;
+        if (*pos >= '0' && *pos <= '9')
         {
-            break;
+            range.first = strtoll(pos, &end, 10);
+            pos = end;
+        }
+        if (*pos != '-')
+        {
+            conn->range_count = 0;
+            return;
+        }
+        pos++;
+        if (*pos >= '0' && *pos <= '9')
+        {
+            range.last = strtoll(pos, &end, 10);
+            pos = end;
         }
+        if ((range.first == -1 && range.last == -1) ||
+            (range.last != -1 && range.first > range.last) ||
+            conn->range_count == MAX_RANGES)
+        {
+            conn->range_count = 0;
+            return;
+        }
+        conn->ranges[conn->range_count++] = range;
 
-        if (strncmp(line, "Accept-Encoding", strlen("Accept-Encoding")) == 0 &&
-            strstr(line, "gzip") != NULL)
+        while (*pos == ' ' || *pos == '\t')
+        {
+            pos++;
+        }
+        if (*pos != ',')
         {
-            compress = true;
+            break;
         }
+        pos++;
     }
 
-    // check if the request is valid (and implemented by this server)
-    if (method == NULL || resource == NULL ||
-        protocol == NULL || strcmp(protocol, "HTTP/1.1") != 0)
+    if (*pos != '\r' && *pos != '\n' && *pos != '\0')
     {
-        fprintf(stderr, "[%s] Request: 400 Bad Request (First line: %s %s %s)\n",
-                prog_name, method, resource, protocol);
-        write_error_header(conn_file, "400 Bad Request");
-        free(first);
-        free(line);
-        fclose(conn_file);
-        return 0;
+        conn->range_count = 0;
     }
+}
 
-    if (strcmp(method, "GET") != 0)
+/**
+ * Resolve the byte ranges.
+ * @brief Replace omitted positions with the ones they mean for a file of
+ * the given size, drop unsatisfiable ranges and sum up the body length.
+ * @param conn The connection whose ranges are resolved.
+ * @param size The size of the file.
+ * @return The number of satisfiable ranges.
+ */
+static size_t resolve_ranges(struct connection *conn, off_t size)
+{
+    size_t count = 0;
+    for (size_t i = 0; i < conn->range_count; i++)
     {
-        fprintf(stderr, "[%s] Request: 501 Not implemented (Method: %s)\n",
-                prog_name, method);
-        write_error_header(conn_file, "501 Not implemented");
-        free(first);
-        free(line);
-        fclose(conn_file);
-        return 0;
+        struct byte_range range = conn->ranges[i];
+        if (range.first == -1)
+        {
+            // The last bytes of the file
+            range.first = range.last >= size ? 0 : size - range.last;
+            range.last = size - 1;
+        }
+        else if (range.last == -1 || range.last >= size)
+        {
+            range.last = size - 1;
+        }
+        if (range.first >= size || range.first > range.last)
+        {
+            continue;
+        }
+        conn->ranges[count++] = range;
     }
+    conn->range_count = count;
+    conn->file_size = size;
 
-    // create the file path
-    char filename[strlen(doc_root) + strlen(index) + strlen(resource)];
-    strcpy(filename, doc_root);
-    strcat(filename, resource);
-    if (resource[strlen(resource) - 1] == '/')
+    if (count == 1)
     {
-        strcat(filename, index);
+        conn->body_start = conn->ranges[0].first;
+        conn->body_len = conn->ranges[0].last - conn->ranges[0].first + 1;
     }
-
-    // send the header
-    FILE *in_file = fopen(filename, "r");
-    if (in_file == NULL)
+    else if (count > 1)
     {
-        fprintf(stderr, "[%s] Request: 404 Not Found (File: %s)\n",
-                prog_name, filename);
-        write_error_header(conn_file, "404 Not Found");
-        free(first);
-        free(line);
-        fclose(conn_file);
-        return 0;
+        char part[PART_HEADER_SIZE];
+        conn->body_len = 0;
+        for (size_t i = 0; i <= count; i++)
+        {
+            conn->body_len += format_part_header(part, conn, i);
+            if (i < count)
+            {
+                conn->body_len += conn->ranges[i].last - conn->ranges[i].first + 1;
+            }
+        }
     }
+    return count;
+}
 
-    uint8_t *data;
-    size_t filesize;
-
-    if (compress)
+/**
+ * Create a gzip stream.
+ * @brief Allocate the deflate state and chunk buffer for a streamed body.
+ * @details Memory is bounded by the zlib state and one compressed 
+ * STREAM_WINDOW, independent of the file size.
+ * @return Upon success the stream, otherwise NULL.
+ */
+static struct gzstream *create_gzstream(void)
+{
+    struct gzstream *stream = calloc(1, sizeof(struct gzstream));
+    if (stream == NULL)
     {
-        filesize = compress_file(in_file, &data);
+        return NULL;
     }
-    else
+    if (deflateInit2(&stream->zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED,
+                     16 + MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
     {
-        filesize = read_file(in_file, &data);
+        free(stream);
+        return NULL;
     }
 
-    if (filesize < 0)
+    // Room for the chunk size line, a flushed window, the gzip trailer, the
+    // chunk end and the terminating last chunk
+    stream->out_cap = deflateBound(&stream->zs, STREAM_WINDOW) + 64;
+    stream->out = malloc(stream->out_cap);
+    if (stream->out == NULL)
     {
-        fprintf(stderr, "[%s] Request: 500 Internal Server Error (Ran out of memmory! File: %s) \n",
-                prog_name, filename);
-        write_error_header(conn_file, "500 Internal Server Error");
-        free(first);
-        free(line);
-        fclose(conn_file);
-        return 0;
+        deflateEnd(&stream->zs);
+        free(stream);
+        return NULL;
     }
-
-    fprintf(stderr, "[%s] Request: 200 OK (File: %s)\n",
-            prog_name, filename);
-    write_success_header(conn_file, filename, filesize, compress);
-
-    // Send the payload
-    fwrite(data, sizeof(uint8_t), filesize, conn_file);
-
-    // Cleanup
-    free(data);
-    free(first);
-    free(line);
-    fclose(conn_file);
-    fclose(in_file);
-    return 0;
+    return stream;
 }
 
 /**
- * The entrypoint of the server.
- * @brief Execution of the server starts and always ends here.
- * @details Uses the global variable prog_name.
- * @param argc The argument counter.
- * @param argv The argument vector.
- * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ * Destroy a gzip stream.
+ * @brief Free the deflate state and all buffers of the stream.
  */
-int main(int argc, char *argv[])
+static void destroy_gzstream(struct gzstream *stream)
 {
-    prog_name = argv[0];
+    deflateEnd(&stream->zs);
+    free(stream->out);
+    free(stream);
+}
 
-    // Setup the singal handler
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
+/**
+ * Reset a connection.
+ * @brief Prepare a connection for the next request on the same socket.
+ * @details Bytes of a pipelined request that were already read stay in the
+ * buffer and will be parsed next.
+ * @param conn The connection to reset.
+ */
+static void reset_connection(struct connection *conn)
+{
+    free(conn->filename);
+    if (conn->gz_entry != NULL)
+    {
+        gzcache_release(conn->gz_entry);
+    }
+    if (conn->gz_stream != NULL)
+    {
+        destroy_gzstream(conn->gz_stream);
+    }
+    if (conn->body_fd != -1)
+    {
+        close(conn->body_fd);
+    }
+    conn->header_len = 0;
+    conn->header_sent = 0;
+    conn->gz_entry = NULL;
+    conn->gz_stream = NULL;
+    conn->body_fd = -1;
+    conn->body_start = 0;
+    conn->body_len = 0;
+    conn->body_sent = 0;
+    conn->range_count = 0;
+    conn->range_index = 0;
+    conn->part_len = 0;
+    conn->part_sent = 0;
+    conn->filename = NULL;
+    conn->encoding = ENCODING_IDENTITY;
+
+    memmove(conn->request, conn->request + conn->request_end,
+            conn->request_len - conn->request_end);
+    conn->request_len -= conn->request_end;
+    conn->request_end = 0;
+    conn->state = STATE_READ_HEADER;
+}
+
+/**
+ * Create a new connection.
+ * @brief Allocate a connection for an accepted socket and register it with
+ * the event loop.
+ * @details May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param connfd The accepted (already non-blocking) socket.
+ * @return Upon success the new connection, otherwise NULL.
+ */
+static struct connection *create_connection(struct server *srv, int connfd)
+{
+    struct connection *conn = calloc(1, sizeof(struct connection));
+    if (conn == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to allocate a connection: %s\n",
+                prog_name, strerror(errno));
+        return NULL;
+    }
+    conn->fd = connfd;
+    conn->body_fd = -1;
+    conn->pipe_fds[0] = -1;
+    conn->pipe_fds[1] = -1;
+    conn->state = STATE_READ_HEADER;
+    conn->last_active = time(NULL);
+
+    // In io_uring mode every operation is submitted on its own
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = conn;
+    if (srv->ring == NULL &&
+        epoll_ctl(srv->epollfd, EPOLL_CTL_ADD, connfd, &ev) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to add connection to epoll: %s\n",
+                prog_name, strerror(errno));
+        free(conn);
+        return NULL;
+    }
+
+    conn->next = srv->connections;
+    if (srv->connections != NULL)
+    {
+        srv->connections->prev = conn;
+    }
+    srv->connections = conn;
+    return conn;
+}
+
+/**
+ * Create a HTTP/2 stream.
+ * @brief Allocate a stream and append it to the streams of the connection.
+ * @details The flow control window starts with the initial window the client
+ * set.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param id The identifier of the stream.
+ * @return Upon success the stream, otherwise NULL.
+ */
+static struct h2_stream *create_stream(struct h2_conn *h2, uint32_t id)
+{
+    struct h2_stream *stream = calloc(1, sizeof(struct h2_stream));
+    if (stream == NULL)
+    {
+        return NULL;
+    }
+    stream->id = id;
+    stream->body_fd = -1;
+    stream->encoding = ENCODING_IDENTITY;
+    stream->window = h2->peer.values[H2_INITIAL_WINDOW_SIZE];
+
+    struct h2_stream **link = &h2->streams;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = stream;
+    h2->stream_count++;
+    return stream;
+}
+
+/**
+ * Find a HTTP/2 stream.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param id The identifier of the stream.
+ * @return The open stream with the identifier, or NULL if there is none.
+ */
+static struct h2_stream *find_stream(struct h2_conn *h2, uint32_t id)
+{
+    struct h2_stream *stream = h2->streams;
+    while (stream != NULL && stream->id != id)
+    {
+        stream = stream->next;
+    }
+    return stream;
+}
+
+/**
+ * Unlink a HTTP/2 stream.
+ * @brief Remove the stream from the list of its connection.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream to remove.
+ */
+static void unlink_stream(struct h2_conn *h2, struct h2_stream *stream)
+{
+    struct h2_stream **link = &h2->streams;
+    while (*link != stream)
+    {
+        link = &(*link)->next;
+    }
+    *link = stream->next;
+    stream->next = NULL;
+}
+
+/**
+ * Free a HTTP/2 stream.
+ * @brief Remove the stream from its connection and free all resources of it.
+ * @details A job still working for the stream is freed once the disk thread
+ * has finished it. The stream must not be the one whose DATA frame is being
+ * sent.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream to free.
+ */
+static void free_stream(struct h2_conn *h2, struct h2_stream *stream)
+{
+    unlink_stream(h2, stream);
+    h2->stream_count--;
+    if (stream->job != NULL)
+    {
+        stream->job->job.owner = NULL;
+        stream->job->stream = NULL;
+        h2->jobs--;
+    }
+    if (stream->body_fd != -1)
+    {
+        close(stream->body_fd);
+    }
+    if (stream->gz_entry != NULL)
+    {
+        gzcache_release(stream->gz_entry);
+    }
+    free(stream->filename);
+    free(stream);
+}
+
+/**
+ * Destroy the HTTP/2 state.
+ * @brief Free all streams, the decoder and the buffers of a connection.
+ * @param conn The connection whose HTTP/2 state is destroyed.
+ */
+static void destroy_h2(struct connection *conn)
+{
+    struct h2_conn *h2 = conn->h2;
+    h2->sending = NULL;
+    while (h2->streams != NULL)
+    {
+        free_stream(h2, h2->streams);
+    }
+    h2_hpack_destroy(&h2->hpack);
+    free(h2->block);
+    free(h2->out);
+    free(h2);
+    conn->h2 = NULL;
+}
+
+/**
+ * Destroy a connection.
+ * @brief Close the socket and free all resources of a connection.
+ * @details Closing the socket also removes it from the epoll set.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to destroy.
+ */
+static void destroy_connection(struct server *srv, struct connection *conn)
+{
+    if (conn->prev != NULL)
+    {
+        conn->prev->next = conn->next;
+    }
+    else
+    {
+        srv->connections = conn->next;
+    }
+    if (conn->next != NULL)
+    {
+        conn->next->prev = conn->prev;
+    }
+
+    close(conn->fd);
+    if (conn->job != NULL)
+    {
+        // The job is freed once the disk thread has finished it
+        conn->job->job.owner = NULL;
+    }
+    if (conn->h2 != NULL)
+    {
+        destroy_h2(conn);
+    }
+    if (conn->body_fd != -1)
+    {
+        close(conn->body_fd);
+    }
+    if (conn->gz_entry != NULL)
+    {
+        gzcache_release(conn->gz_entry);
+    }
+    if (conn->gz_stream != NULL)
+    {
+        destroy_gzstream(conn->gz_stream);
+    }
+    if (conn->pipe_fds[0] != -1)
+    {
+        close(conn->pipe_fds[0]);
+        close(conn->pipe_fds[1]);
+    }
+    free(conn->filename);
+    free(conn);
+}
+
+/**
+ * Open the header buffer.
+ * @brief Open the fixed header buffer of the connection as a file, so the
+ * header can be written with the usual functions without any allocation of
+ * the buffer itself.
+ * @param conn The connection whose header will be rendered.
+ * @return Upon success the file, otherwise NULL.
+ */
+static FILE *open_header(struct connection *conn)
+{
+    return fmemopen(conn->header, HEADER_SIZE, "w");
+}
+
+/**
+ * Close the header buffer.
+ * @brief Close the file opened with open_header and remember the length of
+ * the rendered header.
+ * @param conn The connection whose header was rendered.
+ * @param out The file returned by open_header.
+ * @return Upon success 0, otherwise -1 (also if the header didn't fit).
+ */
+static int close_header(struct connection *conn, FILE *out)
+{
+    fflush(out);
+    long len = ftell(out);
+    bool failed = ferror(out);
+    fclose(out);
+    if (failed || len < 0 || len >= HEADER_SIZE)
+    {
+        return -1;
+    }
+    conn->header_len = len;
+    conn->header_sent = 0;
+    return 0;
+}
+
+/**
+ * Prepare an error response.
+ * @brief Render an error header into the connection's send buffer.
+ * @details The connection will be closed after the header was sent.
+ * @param conn The connection to answer.
+ * @param status A status text like "400 Bad Request".
+ * @return Upon success 0, otherwise -1.
+ */
+static int prepare_error(struct connection *conn, char *status)
+{
+    FILE *out = open_header(conn);
+    if (out == NULL)
+    {
+        return -1;
+    }
+    write_error_header(out, status);
+    if (close_header(conn, out) == -1)
+    {
+        return -1;
+    }
+
+    conn->keep_alive = false;
+    conn->state = STATE_SEND_HEADER;
+    return 0;
+}
+
+/**
+ * Create the path of a resource.
+ * @brief Append the resource to the document root, and the index if the
+ * resource is a directory.
+ * @details The caller must free the returned string.
+ * @param doc_root The name of the folder from which this server will server 
+ * files from.
+ * @param resource The requested resource, starting with a slash.
+ * @param index The name of the default file in a directory.
+ * @return Upon success the path, otherwise NULL.
+ */
+static char *resource_path(const char *doc_root, const char *resource,
+                           const char *index)
+{
+    char *path = malloc(strlen(doc_root) + strlen(index) +
+                        strlen(resource) + 1);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+    strcpy(path, doc_root);
+    strcat(path, resource);
+    if (resource[strlen(resource) - 1] == '/')
+    {
+        strcat(path, index);
+    }
+    return path;
+}
+
+/**
+ * Parse the HTTP2-Settings header.
+ * @brief Decode the settings a client sends with an upgrade to h2c.
+ * @param settings The settings to update.
+ * @param value The base64url value of the header.
+ * @return true if the settings are valid.
+ */
+static bool parse_upgrade_settings(struct h2_settings *settings,
+                                   const char *value)
+{
+    value += strspn(value, " \t");
+    size_t len = strcspn(value, " \t\r");
+    uint8_t payload[len * 3 / 4 + 1];
+    long n = h2_base64url_decode(value, len, payload);
+    return n >= 0 && h2_settings_apply(settings, payload, n) == H2_NO_ERROR;
+}
+
+/**
+ * Parse a request.
+ * @brief Parse the complete request header that sits at the start of the
+ * connection's request buffer.
+ * @details Sets filename, the accepted codings, keep_alive and the requested
+ * ranges of the connection, and upgrade if the client asks to switch to h2c
+ * with valid settings. 
+ * Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param conn The connection whose request is parsed.
+ * @param index The name of the default file in a directory if no file is 
+ * descriped in the request.
+ * @param doc_root The name of the folder from which this server will server 
+ * files from.
+ * @return NULL if the request is valid, otherwise the status text with which
+ * the request must be answered.
+ */
+static char *parse_request(struct connection *conn, char *index, char *doc_root)
+{
+    // Work on a terminated copy as pipelined requests may follow the header
+    char header[conn->request_end + 1];
+    memcpy(header, conn->request, conn->request_end);
+    header[conn->request_end] = '\0';
+
+    // parse the first line
+    char *save_line;
+    char *first = strtok_r(header, "\n", &save_line);
+    char *save_first;
+    char *method = strtok_r(first, " ", &save_first);
+    char *resource = strtok_r(NULL, " ", &save_first);
+    char *protocol = strtok_r(NULL, "\r", &save_first);
+
+    // read all other headerfields
+    conn->keep_alive = true;
+    encoding_parse_accept(&conn->accept, NULL, 0);
+    bool h2c = false;
+    bool h2_settings = false;
+    h2_settings_init(&conn->upgrade_settings);
+    char *line;
+    while ((line = strtok_r(NULL, "\n", &save_line)) != NULL)
+    {
+        if (strcmp(line, "\r") == 0)
+        {
+            break;
+        }
+
+        if (strncasecmp(line, "Accept-Encoding:", strlen("Accept-Encoding:")) == 0)
+        {
+            char *value = line + strlen("Accept-Encoding:");
+            encoding_parse_accept(&conn->accept, value, strcspn(value, "\r"));
+        }
+
+        if (strncasecmp(line, "Connection", strlen("Connection")) == 0 &&
+            strstr(line, "close") != NULL)
+        {
+            conn->keep_alive = false;
+        }
+
+        if (strncasecmp(line, "Range:", strlen("Range:")) == 0)
+        {
+            parse_ranges(conn, line + strlen("Range:"));
+        }
+
+        if (strncasecmp(line, "Upgrade:", strlen("Upgrade:")) == 0 &&
+            strstr(line, "h2c") != NULL)
+        {
+            h2c = true;
+        }
+
+        if (strncasecmp(line, "HTTP2-Settings:", strlen("HTTP2-Settings:")) == 0)
+        {
+            h2_settings = parse_upgrade_settings(&conn->upgrade_settings,
+                                                 line + strlen("HTTP2-Settings:"));
+        }
+    }
+    conn->upgrade = h2c && h2_settings;
+
+    // While draining for a shutdown no further requests are accepted
+    if (!alive)
+    {
+        conn->keep_alive = false;
+    }
+
+    // check if the request is valid (and implemented by this server)
+    if (method == NULL || resource == NULL ||
+        protocol == NULL || strcmp(protocol, "HTTP/1.1") != 0)
+    {
+        fprintf(stderr, "[%s] Request: 400 Bad Request (First line: %s %s %s)\n",
+                prog_name, method, resource, protocol);
+        return "400 Bad Request";
+    }
+
+    if (strcmp(method, "GET") != 0)
+    {
+        fprintf(stderr, "[%s] Request: 501 Not implemented (Method: %s)\n",
+                prog_name, method);
+        return "501 Not implemented";
+    }
+
+    // create the file path
+    conn->filename = resource_path(doc_root, resource, index);
+    if (conn->filename == NULL)
+    {
+        fprintf(stderr, "[%s] Request: 500 Internal Server Error (Ran out of memmory!)\n",
+                prog_name);
+        return "500 Internal Server Error";
+    }
+
+    return NULL;
+}
+
+static void start_h2(struct server *srv, struct connection *conn,
+                     bool upgraded);
+
+/**
+ * Find the request header.
+ * @brief Parse the request if its complete header is in the buffer.
+ * @details Will switch the connection to STATE_OPEN_FILE, STATE_SEND_HEADER
+ * (on a bad request or a header too large) or STATE_CLOSE. With HTTP/2
+ * enabled a client may also start with the connection preface or upgrade
+ * its request, which switches it to STATE_H2.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection whose buffer is searched.
+ * @return true if the state of the connection changed, false if more has to
+ * be read.
+ */
+static bool find_request(struct server *srv, struct connection *conn)
+{
+    // A client with prior knowledge starts with the preface right away
+    size_t preface_len = conn->request_len < H2_PREFACE_LEN
+                             ? conn->request_len
+                             : H2_PREFACE_LEN;
+    if (srv->h2 && preface_len > 0 &&
+        memcmp(conn->request, H2_PREFACE, preface_len) == 0)
+    {
+        if (preface_len < H2_PREFACE_LEN)
+        {
+            return false;
+        }
+        conn->request_end = H2_PREFACE_LEN;
+        start_h2(srv, conn, false);
+        return true;
+    }
+
+    // A pipelined request might already be complete in the buffer
+    conn->request[conn->request_len] = '\0';
+    char *end = strstr(conn->request, "\r\n\r\n");
+    if (end != NULL)
+    {
+        conn->request_end = end - conn->request + 4;
+        char *status = parse_request(conn, srv->index, srv->doc_root);
+        if (status != NULL)
+        {
+            if (prepare_error(conn, status) == -1)
+            {
+                conn->state = STATE_CLOSE;
+            }
+            return true;
+        }
+        if (srv->h2 && conn->upgrade)
+        {
+            start_h2(srv, conn, true);
+            return true;
+        }
+        conn->state = STATE_OPEN_FILE;
+        return true;
+    }
+
+    if (conn->request_len == REQUEST_SIZE)
+    {
+        fprintf(stderr, "[%s] Request: 400 Bad Request (Header too large)\n",
+                prog_name);
+        conn->request_end = conn->request_len;
+        if (prepare_error(conn, "400 Bad Request") == -1)
+        {
+            conn->state = STATE_CLOSE;
+        }
+        return true;
+    }
+    return false;
+}
+
+/**
+ * End the request.
+ * @brief Handle a socket that can't be read anymore.
+ * @details A client that closed the connection after sending an incomplete
+ * header is answered with 400 Bad Request, otherwise the connection gets 
+ * closed.
+ * Will switch the connection to STATE_SEND_HEADER or STATE_CLOSE.
+ * May use the global variable prog_name.
+ * @param conn The connection whose socket ended.
+ * @param eof If true the client closed the connection, otherwise reading
+ * failed.
+ */
+static void end_request(struct connection *conn, bool eof)
+{
+    // The client is gone or closed the connection after sending
+    // an incomplete header.
+    if (eof && conn->request_len > 0)
+    {
+        fprintf(stderr, "[%s] Request: 400 Bad Request (No empty line)\n",
+                prog_name);
+        conn->request_end = conn->request_len;
+        if (prepare_error(conn, "400 Bad Request") == 0)
+        {
+            return;
+        }
+    }
+    conn->state = STATE_CLOSE;
+}
+
+/**
+ * Read the request header.
+ * @brief Read from the socket until the complete header was received or the
+ * socket would block.
+ * @details Will switch the connection to STATE_OPEN_FILE, STATE_SEND_HEADER
+ * (on a bad request) or STATE_CLOSE.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to read from.
+ */
+static void read_header(struct server *srv, struct connection *conn)
+{
+    while (!find_request(srv, conn))
+    {
+        ssize_t n = read(conn->fd, conn->request + conn->request_len,
+                         REQUEST_SIZE - conn->request_len);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            end_request(conn, n == 0);
+            return;
+        }
+        conn->request_len += n;
+    }
+}
+
+/**
+ * Free a file job.
+ * @brief Close the file and free all buffers the job still holds.
+ * @param job The job to free.
+ */
+static void free_file_job(struct fileio_job *job)
+{
+    struct file_job *file = (struct file_job *)job;
+    if (file->fd != -1)
+    {
+        close(file->fd);
+    }
+    free(file->data);
+    free(file->filename);
+    free(file);
+}
+
+/**
+ * Create a file job.
+ * @brief Allocate a job for a file of the connection.
+ * @param conn The connection of which the file is opened.
+ * @param fd The already opened file or -1.
+ * @return Upon success the job, otherwise NULL.
+ */
+static struct file_job *create_file_job(struct connection *conn, int fd)
+{
+    struct file_job *job = calloc(1, sizeof(struct file_job));
+    if (job == NULL)
+    {
+        return NULL;
+    }
+    job->filename = strdup(conn->filename);
+    if (job->filename == NULL)
+    {
+        free(job);
+        return NULL;
+    }
+    job->fd = fd;
+    job->accept = conn->accept;
+    job->ranged = conn->range_count > 0;
+    job->encoding = conn->encoding;
+    return job;
+}
+
+/**
+ * Find the precompressed siblings of a file.
+ * @brief Look for a regular file with the suffix of every coding next to the
+ * file, which is at least as new as the file itself.
+ * @param filename The path of the file.
+ * @param st The stat of the file.
+ * @return The set of codings with a sibling.
+ */
+static unsigned find_siblings(const char *filename, const struct stat *st)
+{
+    unsigned found = 0;
+    char path[strlen(filename) + 8];
+    for (int e = 0; e < ENCODING_IDENTITY; e++)
+    {
+        snprintf(path, sizeof(path), "%s%s", filename, encoding_suffix(e));
+        struct stat sst;
+        if (stat(path, &sst) == 0 && S_ISREG(sst.st_mode) &&
+            (sst.st_mtim.tv_sec > st->st_mtim.tv_sec ||
+             (sst.st_mtim.tv_sec == st->st_mtim.tv_sec &&
+              sst.st_mtim.tv_nsec >= st->st_mtim.tv_nsec)))
+        {
+            found |= ENCODING_BIT(e);
+        }
+    }
+    return found;
+}
+
+/**
+ * Open the sibling of a file.
+ * @brief Replace the opened file of a job with its sibling for the chosen
+ * coding.
+ * @param file The job, whose file was opened and stated.
+ * @return Upon success 0, otherwise -1 and the job still holds the file.
+ */
+static int open_sibling(struct file_job *file)
+{
+    const char *suffix = encoding_suffix(file->encoding);
+    char path[strlen(file->filename) + strlen(suffix) + 1];
+    snprintf(path, sizeof(path), "%s%s", file->filename, suffix);
+
+    struct stat sst;
+    int fd = open(path, O_RDONLY);
+    if (fd == -1)
+    {
+        return -1;
+    }
+    if (fstat(fd, &sst) == -1 || !S_ISREG(sst.st_mode))
+    {
+        close(fd);
+        return -1;
+    }
+    close(file->fd);
+    file->fd = fd;
+    file->st = sst;
+    file->variant = true;
+    return 0;
+}
+
+/**
+ * Open a file.
+ * @brief Open and stat the file of a job and choose its content coding.
+ * @details Runs on a disk thread. The codings the server can offer are those
+ * compiled in, large files are only compressed with gzip while they are sent
+ * (see STREAM_THRESHOLD), plus the codings of the precompressed siblings.
+ * The streamed body is framed with HTTP/1.1 chunks, so on a HTTP/2 stream 
+ * large files are only sent as they are or from a sibling.
+ * @param job The job of the file.
+ */
+static void run_open(struct fileio_job *job)
+{
+    struct file_job *file = (struct file_job *)job;
+    file->fd = open(file->filename, O_RDONLY);
+    file->failed = file->fd == -1 || fstat(file->fd, &file->st) == -1 ||
+                   !S_ISREG(file->st.st_mode);
+    if (file->failed || file->ranged)
+    {
+        return;
+    }
+
+    unsigned compressible = ENCODING_COMPILED;
+    if (file->st.st_size > STREAM_THRESHOLD)
+    {
+        compressible = file->h2 ? ENCODING_BIT(ENCODING_IDENTITY)
+                                : ENCODING_BIT(ENCODING_GZIP) |
+                                      ENCODING_BIT(ENCODING_IDENTITY);
+    }
+    unsigned siblings = find_siblings(file->filename, &file->st);
+    file->encoding = encoding_choose(&file->accept, compressible | siblings);
+    if ((siblings & ENCODING_BIT(file->encoding)) != 0 &&
+        open_sibling(file) == -1)
+    {
+        // The sibling vanished meanwhile
+        file->encoding = encoding_choose(&file->accept, compressible);
+    }
+}
+
+/**
+ * Compress a file.
+ * @brief Read the opened file of a job and compress it into memory.
+ * @details Runs on a disk thread. The file is closed afterwards.
+ * @param job The job of the file.
+ */
+static void run_compress(struct fileio_job *job)
+{
+    struct file_job *file = (struct file_job *)job;
+    FILE *in_file = fdopen(file->fd, "r");
+    if (in_file == NULL)
+    {
+        file->failed = true;
+        return;
+    }
+
+    file->data_len = compress_file(in_file, file->encoding, &file->data);
+    fclose(in_file);
+    file->fd = -1;
+    if (file->data_len < 0)
+    {
+        // compress_file already freed the buffer
+        file->data = NULL;
+        file->failed = true;
+    }
+}
+
+static void finish_file_job(struct server *srv, struct file_job *job);
+static void finish_stream_job(struct server *srv, struct connection *conn,
+                              struct file_job *job);
+
+/**
+ * Start a file job.
+ * @brief Hand a job of the connection to the disk threads, or run it right 
+ * away if there are none.
+ * @details Will switch the connection to STATE_WAIT_FILE until the job is 
+ * finished.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of which the file is opened.
+ * @param job The job to run.
+ * @param run The function that does the work of the job.
+ */
+static void start_file_job(struct server *srv, struct connection *conn,
+                           struct file_job *job,
+                           void (*run)(struct fileio_job *job))
+{
+    job->job.run = run;
+    job->job.owner = conn;
+    conn->job = job;
+    conn->state = STATE_WAIT_FILE;
+    if (srv->io != NULL)
+    {
+        fileio_submit(srv->io, &job->job);
+        return;
+    }
+
+    run(&job->job);
+    finish_file_job(srv, job);
+}
+
+/**
+ * Prepare an internal error response.
+ * @brief Log the failure and render a 500 Internal Server Error header.
+ * @details May use the global variable prog_name.
+ * @param conn The connection to answer.
+ */
+static void prepare_internal_error(struct connection *conn)
+{
+    fprintf(stderr, "[%s] Request: 500 Internal Server Error (Ran out of memmory! File: %s) \n",
+            prog_name, conn->filename);
+    if (prepare_error(conn, "500 Internal Server Error") == -1)
+    {
+        conn->state = STATE_CLOSE;
+    }
+}
+
+/**
+ * Open the requested file.
+ * @brief Start opening the requested file on a disk thread.
+ * @details Will switch the connection to STATE_WAIT_FILE (or, without disk 
+ * threads, to the state after the file was opened).
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of which the file is opened.
+ */
+static void open_file(struct server *srv, struct connection *conn)
+{
+    struct file_job *job = create_file_job(conn, -1);
+    if (job == NULL)
+    {
+        prepare_internal_error(conn);
+        return;
+    }
+    start_file_job(srv, conn, job, run_open);
+}
+
+/**
+ * Render the success header.
+ * @brief Render the header for the body the connection is about to send.
+ * @details Will switch the connection to STATE_SEND_HEADER.
+ * Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param conn The connection whose response is rendered.
+ */
+static void prepare_success(struct connection *conn)
+{
+    FILE *out = open_header(conn);
+    if (out == NULL)
+    {
+        conn->state = STATE_CLOSE;
+        return;
+    }
+    if (conn->range_count > 0)
+    {
+        write_partial_header(out, conn);
+    }
+    else
+    {
+        write_success_header(out, conn->filename, conn->body_len, conn->encoding,
+                             conn->gz_stream != NULL, conn->keep_alive);
+    }
+    if (close_header(conn, out) == -1)
+    {
+        conn->state = STATE_CLOSE;
+        return;
+    }
+
+    if (conn->range_count > 0)
+    {
+        fprintf(stderr, "[%s] Request: 206 Partial Content (File: %s, Ranges: %lu)\n",
+                prog_name, conn->filename, conn->range_count);
+    }
+    else
+    {
+        fprintf(stderr, "[%s] Request: 200 OK (File: %s)\n",
+                prog_name, conn->filename);
+    }
+    conn->state = STATE_SEND_HEADER;
+}
+
+/**
+ * Continue with the opened file.
+ * @brief Decide how the opened file is sent, find its compressed version in
+ * the cache, and render the header.
+ * @details Precompressed siblings are sent like uncompressed files. Files
+ * larger than STREAM_THRESHOLD are compressed while they are sent, with 
+ * chunked transfer encoding, so the first byte doesn't wait for the whole 
+ * file to be compressed. Smaller ones are compressed up front by a disk 
+ * thread and cached.
+ * Will switch the connection to STATE_SEND_HEADER or STATE_WAIT_FILE.
+ * Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of which the file is opened.
+ * @param job The finished job that opened the file, the file now belongs to
+ * the connection.
+ */
+static void file_opened(struct server *srv, struct connection *conn,
+                        struct file_job *job)
+{
+    int fd = job->fd;
+    struct stat st = job->st;
+    job->fd = -1;
+    conn->encoding = job->encoding;
+    if (job->failed)
+    {
+        fprintf(stderr, "[%s] Request: 404 Not Found (File: %s)\n",
+                prog_name, conn->filename);
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        if (prepare_error(conn, "404 Not Found") == -1)
+        {
+            conn->state = STATE_CLOSE;
+        }
+        return;
+    }
+
+    if (conn->range_count > 0)
+    {
+        // Ranges always refer to the uncompressed file
+        conn->body_fd = fd;
+        if (resolve_ranges(conn, st.st_size) == 0)
+        {
+            close(fd);
+            conn->body_fd = -1;
+            fprintf(stderr, "[%s] Request: 416 Range Not Satisfiable (File: %s)\n",
+                    prog_name, conn->filename);
+            FILE *out = open_header(conn);
+            if (out == NULL)
+            {
+                conn->state = STATE_CLOSE;
+                return;
+            }
+            fprintf(out, "HTTP/1.1 416 Range Not Satisfiable\r\nContent-Range: bytes */%lld\r\nConnection: close\r\n\r\n",
+                    (long long)st.st_size);
+            conn->keep_alive = false;
+            conn->state = close_header(conn, out) == -1 ? STATE_CLOSE : STATE_SEND_HEADER;
+            return;
+        }
+    }
+    else if (conn->encoding == ENCODING_IDENTITY || job->variant)
+    {
+        // Uncompressed bodies and siblings are sent straight from the page 
+        // cache
+        conn->body_fd = fd;
+        conn->body_len = st.st_size;
+    }
+    else if ((conn->gz_entry = gzcache_lookup(srv->cache, conn->filename,
+                                              conn->encoding, &st)) != NULL)
+    {
+        close(fd);
+        conn->body_len = conn->gz_entry->len;
+    }
+    else if (st.st_size > STREAM_THRESHOLD)
+    {
+        conn->gz_stream = create_gzstream();
+        if (conn->gz_stream == NULL)
+        {
+            close(fd);
+            prepare_internal_error(conn);
+            return;
+        }
+        conn->body_fd = fd;
+    }
+    else
+    {
+        struct file_job *compress = create_file_job(conn, fd);
+        if (compress == NULL)
+        {
+            close(fd);
+            prepare_internal_error(conn);
+            return;
+        }
+        compress->st = st;
+        start_file_job(srv, conn, compress, run_compress);
+        return;
+    }
+
+    prepare_success(conn);
+}
+
+/**
+ * Continue with the compressed file.
+ * @brief Cache the compressed file and render the header.
+ * @details Will switch the connection to STATE_SEND_HEADER.
+ * Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of which the file is compressed.
+ * @param job The finished job that compressed the file.
+ */
+static void file_compressed(struct server *srv, struct connection *conn,
+                            struct file_job *job)
+{
+    if (!job->failed)
+    {
+        // The cache takes the compressed data, even on failure
+        conn->gz_entry = gzcache_insert(srv->cache, conn->filename,
+                                        conn->encoding, &job->st, job->data,
+                                        job->data_len);
+        job->data = NULL;
+    }
+    if (conn->gz_entry == NULL)
+    {
+        prepare_internal_error(conn);
+        return;
+    }
+    conn->body_len = conn->gz_entry->len;
+    prepare_success(conn);
+}
+
+/**
+ * Finish a file job.
+ * @brief Continue the connection the job belongs to, and free the job.
+ * @details A job whose connection (or HTTP/2 stream) was closed meanwhile is
+ * only freed.
+ * @param srv The server to which the connection belongs.
+ * @param job The finished job.
+ */
+static void finish_file_job(struct server *srv, struct file_job *job)
+{
+    struct connection *conn = job->job.owner;
+    if (conn != NULL && conn->h2 != NULL)
+    {
+        finish_stream_job(srv, conn, job);
+    }
+    else if (conn != NULL)
+    {
+        conn->job = NULL;
+        if (job->job.run == run_open)
+        {
+            file_opened(srv, conn, job);
+        }
+        else
+        {
+            file_compressed(srv, conn, job);
+        }
+    }
+    free_file_job(&job->job);
+}
+
+/**
+ * Send a buffer.
+ * @brief Write as much of a buffer to the socket as possible without
+ * blocking.
+ * @param fd The socket to write to.
+ * @param buf The buffer to send.
+ * @param len The length of the buffer.
+ * @param sent The number of bytes already sent, will be updated.
+ * @param flags Additional flags for send, like MSG_MORE.
+ * @return 1 if the buffer was sent completely, 0 if the socket would block
+ * and -1 on error.
+ */
+static int send_buffer(int fd, void *buf, size_t len, size_t *sent, int flags)
+{
+    while (*sent < len)
+    {
+        ssize_t n = send(fd, (uint8_t *)buf + *sent, len - *sent,
+                         MSG_NOSIGNAL | flags);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            return -1;
+        }
+        *sent += n;
+    }
+    return 1;
+}
+
+/**
+ * Count sent header and body bytes.
+ * @brief Advance the progress of a header and an in memory body sent with
+ * the same syscall.
+ * @param conn The connection whose header and compressed body are sent.
+ * @param n The number of bytes that were sent.
+ */
+static void advance_header_body(struct connection *conn, size_t n)
+{
+    size_t header_left = conn->header_len - conn->header_sent;
+    if (n <= header_left)
+    {
+        conn->header_sent += n;
+    }
+    else
+    {
+        conn->header_sent = conn->header_len;
+        conn->body_sent += n - header_left;
+    }
+}
+
+/**
+ * Send the header and an in memory body.
+ * @brief Write as much of the header and the body as possible without
+ * blocking, both with the same syscall.
+ * @details Small responses leave in a single segment instead of two.
+ * @param conn The connection whose header and compressed body are sent.
+ * @return 1 if both were sent completely, 0 if the socket would block
+ * and -1 on error.
+ */
+static int send_header_body(struct connection *conn)
+{
+    while (conn->header_sent < conn->header_len ||
+           conn->body_sent < conn->body_len)
+    {
+        struct iovec iov[2];
+        int iovcnt = 0;
+        if (conn->header_sent < conn->header_len)
+        {
+            iov[iovcnt].iov_base = conn->header + conn->header_sent;
+            iov[iovcnt].iov_len = conn->header_len - conn->header_sent;
+            iovcnt++;
+        }
+        iov[iovcnt].iov_base = conn->gz_entry->data + conn->body_sent;
+        iov[iovcnt].iov_len = conn->body_len - conn->body_sent;
+        iovcnt++;
+
+        // sendmsg instead of writev, as only it can suppress SIGPIPE
+        struct msghdr msg = {.msg_iov = iov, .msg_iovlen = iovcnt};
+        ssize_t n = sendmsg(conn->fd, &msg, MSG_NOSIGNAL);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            return -1;
+        }
+
+        advance_header_body(conn, n);
+    }
+    return 1;
+}
+
+/**
+ * Send a file.
+ * @brief Copy as much of a file to the socket as possible without blocking.
+ * @details Uses sendfile so the data never passes through user space.
+ * @param fd The socket to write to.
+ * @param file_fd The file to send.
+ * @param start The offset in the file where the data to send starts.
+ * @param len The number of bytes to send.
+ * @param sent The number of bytes already sent, will be updated.
+ * @return 1 if the file was sent completely, 0 if the socket would block
+ * and -1 on error.
+ */
+static int send_file(int fd, int file_fd, off_t start, size_t len,
+                     size_t *sent)
+{
+    while (*sent < len)
+    {
+        off_t offset = start + *sent;
+        ssize_t n = sendfile(fd, file_fd, &offset, len - *sent);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                return 0;
+            }
+            return -1;
+        }
+        if (n == 0)
+        {
+            // The file was truncated while we were sending it
+            return -1;
+        }
+        *sent += n;
+    }
+    return 1;
+}
+
+/**
+ * Send a multipart/byteranges body.
+ * @brief Send the part headers and ranges of the file as far as possible 
+ * without blocking.
+ * @details range_index is the part currently sent, part_len is zero as long
+ * as its header was not rendered yet.
+ * @param conn The connection whose ranges are sent.
+ * @return 1 if the body was sent completely, 0 if the socket would block
+ * and -1 on error.
+ */
+static int send_ranges(struct connection *conn)
+{
+    while (conn->range_index <= conn->range_count)
+    {
+        size_t index = conn->range_index;
+        if (conn->part_len == 0)
+        {
+            conn->part_len = format_part_header(conn->part_header, conn, index);
+            conn->part_sent = 0;
+            conn->body_sent = 0;
+        }
+
+        bool last = index == conn->range_count;
+        int ret = send_buffer(conn->fd, conn->part_header, conn->part_len,
+                              &conn->part_sent, last ? 0 : MSG_MORE);
+        if (ret == 1 && !last)
+        {
+            struct byte_range *range = &conn->ranges[index];
+            ret = send_file(conn->fd, conn->body_fd, range->first,
+                            range->last - range->first + 1, &conn->body_sent);
+        }
+        if (ret != 1)
+        {
+            return ret;
+        }
+        conn->range_index++;
+        conn->part_len = 0;
+    }
+    return 1;
+}
+
+/**
+ * Fill the next chunk.
+ * @brief Read the next window of the file and deflate it into a chunk.
+ * @details The window is flushed with Z_SYNC_FLUSH so the client can inflate
+ * every chunk as soon as it arrives. The size line is written in front of 
+ * the compressed data, so out_sent marks the start of the chunk. At the end 
+ * of the file the gzip trailer and the terminating zero size chunk are 
+ * stored and the stream is marked as done.
+ * @param stream The stream to fill.
+ * @param file_fd The file to read from.
+ * @return Upon success 0, otherwise -1.
+ */
+static int fill_chunk(struct gzstream *stream, int file_fd)
+{
+    ssize_t n;
+    do
+    {
+        n = read(file_fd, stream->in, STREAM_WINDOW);
+    } while (n == -1 && errno == EINTR);
+    if (n == -1)
+    {
+        return -1;
+    }
+
+    const size_t reserved = 16;
+    int flush = n == 0 ? Z_FINISH : Z_SYNC_FLUSH;
+    stream->zs.next_in = stream->in;
+    stream->zs.avail_in = n;
+    stream->zs.next_out = stream->out + reserved;
+    stream->zs.avail_out = stream->out_cap - reserved - 7;
+    int err = deflate(&stream->zs, flush);
+    if ((err != Z_OK && err != Z_STREAM_END) || stream->zs.avail_out == 0)
+    {
+        return -1;
+    }
+    size_t len = stream->zs.next_out - (stream->out + reserved);
+
+    char line[reserved];
+    int line_len = snprintf(line, sizeof(line), "%lx\r\n", len);
+    stream->out_sent = reserved - line_len;
+    memcpy(stream->out + stream->out_sent, line, line_len);
+    memcpy(stream->out + reserved + len, "\r\n", 2);
+    stream->out_len = reserved + len + 2;
+
+    if (flush == Z_FINISH)
+    {
+        memcpy(stream->out + stream->out_len, "0\r\n\r\n", 5);
+        stream->out_len += 5;
+        stream->done = true;
+    }
+    return 0;
+}
+
+/**
+ * Send a streamed body.
+ * @brief Deflate and send chunks until the file ended or the socket would
+ * block.
+ * @param fd The socket to write to.
+ * @param stream The stream of the body.
+ * @param file_fd The file to compress.
+ * @return 1 if the body was sent completely, 0 if the socket would block
+ * and -1 on error.
+ */
+static int send_chunked(int fd, struct gzstream *stream, int file_fd)
+{
+    while (true)
+    {
+        int ret = send_buffer(fd, stream->out, stream->out_len,
+                              &stream->out_sent, 0);
+        if (ret != 1)
+        {
+            return ret;
+        }
+        if (stream->done)
+        {
+            return 1;
+        }
+        if (fill_chunk(stream, file_fd) == -1)
+        {
+            return -1;
+        }
+    }
+}
+
+/**
+ * Reserve HTTP/2 output.
+ * @brief Append room for len bytes to the frames waiting to be sent.
+ * @details If memory runs out the connection is closed once the frames 
+ * queued so far are sent.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param len The number of bytes.
+ * @return Upon success the room, otherwise NULL.
+ */
+static uint8_t *reserve_out(struct h2_conn *h2, size_t len)
+{
+    if (h2->out_len + len > h2->out_cap)
+    {
+        size_t cap = h2->out_cap == 0 ? BUFFER_SIZE : h2->out_cap;
+        while (cap < h2->out_len + len)
+        {
+            cap *= 2;
+        }
+        uint8_t *out = realloc(h2->out, cap);
+        if (out == NULL)
+        {
+            h2->closing = true;
+            return NULL;
+        }
+        h2->out = out;
+        h2->out_cap = cap;
+    }
+    uint8_t *room = h2->out + h2->out_len;
+    h2->out_len += len;
+    return room;
+}
+
+/**
+ * Queue a HTTP/2 frame.
+ * @brief Append the header of a frame to the output.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param length The length of the payload.
+ * @param type The type of the frame.
+ * @param flags The flags of the frame.
+ * @param stream The stream of the frame, 0 for the connection.
+ * @return Upon success the room for the payload, otherwise NULL.
+ */
+static uint8_t *queue_frame(struct h2_conn *h2, uint32_t length, uint8_t type,
+                            uint8_t flags, uint32_t stream)
+{
+    uint8_t *frame = reserve_out(h2, H2_FRAME_HEADER + length);
+    if (frame == NULL)
+    {
+        return NULL;
+    }
+    h2_write_frame(frame, length, type, flags, stream);
+    return frame + H2_FRAME_HEADER;
+}
+
+/**
+ * Queue GOAWAY.
+ * @brief Tell the client the last stream that will be served.
+ * @details No new streams are accepted afterwards. With an error the
+ * connection is closed as soon as the frame is sent, otherwise once the open
+ * streams are done.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param err The error of the connection or H2_NO_ERROR.
+ */
+static void queue_goaway(struct h2_conn *h2, enum h2_error err)
+{
+    uint8_t *payload = queue_frame(h2, 8, H2_GOAWAY, 0, 0);
+    if (payload != NULL)
+    {
+        h2_put32(payload, h2->last_stream);
+        h2_put32(payload + 4, err);
+    }
+    h2->goaway = true;
+    if (err != H2_NO_ERROR)
+    {
+        h2->closing = true;
+    }
+}
+
+/**
+ * Queue RST_STREAM.
+ * @brief Tell the client that a stream ended with an error.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param id The identifier of the stream.
+ * @param err The error of the stream.
+ */
+static void queue_rst(struct h2_conn *h2, uint32_t id, enum h2_error err)
+{
+    uint8_t *payload = queue_frame(h2, 4, H2_RST_STREAM, 0, id);
+    if (payload != NULL)
+    {
+        h2_put32(payload, err);
+    }
+}
+
+/**
+ * End a HTTP/2 stream.
+ * @brief Free a stream that is reset, by the client or by us.
+ * @details A stream whose DATA frame is being sent is only marked, it is
+ * freed once the frame is complete.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream to end.
+ */
+static void end_stream(struct h2_conn *h2, struct h2_stream *stream)
+{
+    if (stream == h2->sending)
+    {
+        stream->reset = true;
+        return;
+    }
+    free_stream(h2, stream);
+}
+
+/**
+ * Respond on a HTTP/2 stream.
+ * @brief Queue the HEADERS of the response, the body follows once flow 
+ * control allows it.
+ * @details Only 200 responses describe the body, error responses have none.
+ * Streams without a body end with the HEADERS and are freed.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream to answer.
+ * @param status The status code like "200".
+ */
+static void respond_stream(struct h2_conn *h2, struct h2_stream *stream,
+                           const char *status)
+{
+    uint8_t block[HEADER_SIZE];
+    size_t len = h2_hpack_encode(block, sizeof(block), ":status", status);
+    if (strcmp(status, "200") == 0)
+    {
+        char length[24];
+        snprintf(length, sizeof(length), "%lu", stream->body_len);
+        len += h2_hpack_encode(block + len, sizeof(block) - len,
+                               "content-length", length);
+        const char *type = content_type(stream->filename);
+        if (type != NULL)
+        {
+            len += h2_hpack_encode(block + len, sizeof(block) - len,
+                                   "content-type", type);
+        }
+        if (stream->encoding != ENCODING_IDENTITY)
+        {
+            len += h2_hpack_encode(block + len, sizeof(block) - len,
+                                   "content-encoding",
+                                   encoding_name(stream->encoding));
+        }
+        len += h2_hpack_encode(block + len, sizeof(block) - len, "vary",
+                               "accept-encoding");
+    }
+    char time_text[200];
+    format_date(time_text, sizeof(time_text));
+    len += h2_hpack_encode(block + len, sizeof(block) - len, "date",
+                           time_text);
+
+    uint8_t flags = H2_FLAG_END_HEADERS;
+    if (stream->body_len == 0)
+    {
+        flags |= H2_FLAG_END_STREAM;
+    }
+    uint8_t *payload = queue_frame(h2, len, H2_HEADERS, flags, stream->id);
+    if (payload != NULL)
+    {
+        memcpy(payload, block, len);
+    }
+    stream->responded = true;
+    if (stream->body_len == 0)
+    {
+        free_stream(h2, stream);
+    }
+}
+
+/**
+ * Fail a HTTP/2 stream.
+ * @brief Log the failure and answer 500 Internal Server Error.
+ * @details May use the global variable prog_name.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream to answer.
+ */
+static void fail_stream(struct h2_conn *h2, struct h2_stream *stream)
+{
+    fprintf(stderr, "[%s] Request: 500 Internal Server Error (Ran out of memmory! File: %s, Stream: %u) \n",
+            prog_name, stream->filename, stream->id);
+    respond_stream(h2, stream, "500");
+}
+
+/**
+ * Create a file job of a HTTP/2 stream.
+ * @brief Allocate a job for the file of the stream.
+ * @param stream The stream of which the file is opened.
+ * @param fd The already opened file or -1.
+ * @return Upon success the job, otherwise NULL.
+ */
+static struct file_job *create_stream_job(struct h2_stream *stream, int fd)
+{
+    struct file_job *job = calloc(1, sizeof(struct file_job));
+    if (job == NULL)
+    {
+        return NULL;
+    }
+    job->filename = strdup(stream->filename);
+    if (job->filename == NULL)
+    {
+        free(job);
+        return NULL;
+    }
+    job->fd = fd;
+    job->accept = stream->accept;
+    job->encoding = stream->encoding;
+    job->h2 = true;
+    return job;
+}
+
+/**
+ * Start a file job of a HTTP/2 stream.
+ * @brief Hand a job of the stream to the disk threads, or run it right away
+ * if there are none.
+ * @details The connection keeps serving its other streams meanwhile.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param stream The stream of which the file is opened.
+ * @param job The job to run.
+ * @param run The function that does the work of the job.
+ */
+static void start_stream_job(struct server *srv, struct connection *conn,
+                             struct h2_stream *stream, struct file_job *job,
+                             void (*run)(struct fileio_job *job))
+{
+    job->job.run = run;
+    job->job.owner = conn;
+    job->stream = stream;
+    stream->job = job;
+    conn->h2->jobs++;
+    if (srv->io != NULL)
+    {
+        fileio_submit(srv->io, &job->job);
+        return;
+    }
+
+    run(&job->job);
+    finish_file_job(srv, job);
+}
+
+/**
+ * Open the file of a HTTP/2 stream.
+ * @brief Start opening the requested file on a disk thread.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param stream The stream whose filename is set.
+ */
+static void open_stream(struct server *srv, struct connection *conn,
+                        struct h2_stream *stream)
+{
+    struct file_job *job = create_stream_job(stream, -1);
+    if (job == NULL)
+    {
+        fail_stream(conn->h2, stream);
+        return;
+    }
+    start_stream_job(srv, conn, stream, job, run_open);
+}
+
+/**
+ * Continue a HTTP/2 stream with the opened file.
+ * @brief Find the body of the stream like file_opened does and respond.
+ * @details Files without a compressed version in the cache are compressed 
+ * by a disk thread first.
+ * Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param stream The stream of which the file is opened.
+ * @param job The finished job that opened the file, the file now belongs to
+ * the stream.
+ */
+static void stream_opened(struct server *srv, struct connection *conn,
+                          struct h2_stream *stream, struct file_job *job)
+{
+    int fd = job->fd;
+    struct stat st = job->st;
+    job->fd = -1;
+    stream->encoding = job->encoding;
+    if (job->failed)
+    {
+        fprintf(stderr, "[%s] Request: 404 Not Found (File: %s, Stream: %u)\n",
+                prog_name, stream->filename, stream->id);
+        if (fd != -1)
+        {
+            close(fd);
+        }
+        respond_stream(conn->h2, stream, "404");
+        return;
+    }
+
+    if (stream->encoding == ENCODING_IDENTITY || job->variant)
+    {
+        stream->body_fd = fd;
+        stream->body_len = st.st_size;
+    }
+    else if ((stream->gz_entry = gzcache_lookup(srv->cache, stream->filename,
+                                                stream->encoding, &st)) != NULL)
+    {
+        close(fd);
+        stream->body_len = stream->gz_entry->len;
+    }
+    else
+    {
+        struct file_job *compress = create_stream_job(stream, fd);
+        if (compress == NULL)
+        {
+            close(fd);
+            fail_stream(conn->h2, stream);
+            return;
+        }
+        compress->st = st;
+        start_stream_job(srv, conn, stream, compress, run_compress);
+        return;
+    }
+
+    fprintf(stderr, "[%s] Request: 200 OK (File: %s, Stream: %u)\n",
+            prog_name, stream->filename, stream->id);
+    respond_stream(conn->h2, stream, "200");
+}
+
+/**
+ * Continue a HTTP/2 stream with the compressed file.
+ * @brief Cache the compressed file and respond.
+ * @details Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param stream The stream of which the file is compressed.
+ * @param job The finished job that compressed the file.
+ */
+static void stream_compressed(struct server *srv, struct connection *conn,
+                              struct h2_stream *stream, struct file_job *job)
+{
+    if (!job->failed)
+    {
+        stream->gz_entry = gzcache_insert(srv->cache, stream->filename,
+                                          stream->encoding, &job->st,
+                                          job->data, job->data_len);
+        job->data = NULL;
+    }
+    if (stream->gz_entry == NULL)
+    {
+        fail_stream(conn->h2, stream);
+        return;
+    }
+    stream->body_len = stream->gz_entry->len;
+    fprintf(stderr, "[%s] Request: 200 OK (File: %s, Stream: %u)\n",
+            prog_name, stream->filename, stream->id);
+    respond_stream(conn->h2, stream, "200");
+}
+
+/**
+ * Finish a file job of a HTTP/2 stream.
+ * @brief Continue the stream the job belongs to.
+ * @details The job is freed by finish_file_job. Jobs of streams that were 
+ * freed meanwhile have no owner anymore and don't get here.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param job The finished job.
+ */
+static void finish_stream_job(struct server *srv, struct connection *conn,
+                              struct file_job *job)
+{
+    struct h2_stream *stream = job->stream;
+    stream->job = NULL;
+    conn->h2->jobs--;
+    if (job->job.run == run_open)
+    {
+        stream_opened(srv, conn, stream, job);
+    }
+    else
+    {
+        stream_compressed(srv, conn, stream, job);
+    }
+}
+
+/**
+ * A HTTP/2 request.
+ * @brief The fields of a request header block the server looks at.
+ **/
+struct h2_request
+{
+    char method[16];
+    char *path;
+    struct encoding_accept accept;
+};
+
+/**
+ * Collect a field of a HTTP/2 request.
+ * @brief Store the method, the path and the accepted codings.
+ * @details Called by h2_hpack_decode for every field.
+ * @param arg The struct h2_request to fill.
+ * @param name The name of the field.
+ * @param name_len The length of the name.
+ * @param value The value of the field.
+ * @param value_len The length of the value.
+ */
+static void collect_field(void *arg, const char *name, size_t name_len,
+                          const char *value, size_t value_len)
+{
+    struct h2_request *request = arg;
+    if (name_len == strlen(":method") &&
+        memcmp(name, ":method", name_len) == 0)
+    {
+        snprintf(request->method, sizeof(request->method), "%.*s",
+                 (int)value_len, value);
+    }
+    else if (name_len == strlen(":path") &&
+             memcmp(name, ":path", name_len) == 0 && request->path == NULL)
+    {
+        request->path = strndup(value, value_len);
+    }
+    else if (name_len == strlen("accept-encoding") &&
+             memcmp(name, "accept-encoding", name_len) == 0)
+    {
+        encoding_parse_accept(&request->accept, value, value_len);
+    }
+}
+
+/**
+ * Start a HTTP/2 request.
+ * @brief Check the request of a new stream and open the requested file.
+ * @details Will write log messages to stderr.
+ * May use the global variable prog_name.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection of the stream.
+ * @param stream The new stream.
+ * @param request The decoded request, the stream takes its path.
+ */
+static void start_request(struct server *srv, struct connection *conn,
+                          struct h2_stream *stream,
+                          struct h2_request *request)
+{
+    if (request->method[0] == '\0' || request->path == NULL ||
+        request->path[0] != '/')
+    {
+        fprintf(stderr, "[%s] Request: 400 Bad Request (Path: %s, Stream: %u)\n",
+                prog_name, request->path, stream->id);
+        respond_stream(conn->h2, stream, "400");
+        return;
+    }
+    if (strcmp(request->method, "GET") != 0)
+    {
+        fprintf(stderr, "[%s] Request: 501 Not implemented (Method: %s, Stream: %u)\n",
+                prog_name, request->method, stream->id);
+        respond_stream(conn->h2, stream, "501");
+        return;
+    }
+
+    stream->accept = request->accept;
+    stream->filename = resource_path(srv->doc_root, request->path,
+                                     srv->index);
+    if (stream->filename == NULL)
+    {
+        fprintf(stderr, "[%s] Request: 500 Internal Server Error (Ran out of memmory!)\n",
+                prog_name);
+        respond_stream(conn->h2, stream, "500");
+        return;
+    }
+    open_stream(srv, conn, stream);
+}
+
+/**
+ * Handle a complete header block.
+ * @brief Decode the block and open a stream for the request.
+ * @details The block is decoded even if the stream is refused or ignored, 
+ * to keep the decoder in sync with the client. Blocks on open streams are
+ * trailers and ignored, streams beyond H2_MAX_STREAMS are refused and
+ * streams after GOAWAY are ignored.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection that received the block.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error end_headers(struct server *srv, struct connection *conn)
+{
+    struct h2_conn *h2 = conn->h2;
+    struct h2_request request;
+    request.method[0] = '\0';
+    request.path = NULL;
+    encoding_parse_accept(&request.accept, NULL, 0);
+    enum h2_error err = h2_hpack_decode(&h2->hpack, h2->block, h2->block_len,
+                                        collect_field, &request);
+    uint32_t id = h2->block_stream;
+    h2->block_len = 0;
+    h2->continuation = false;
+    if (err != H2_NO_ERROR || id <= h2->last_stream || h2->goaway)
+    {
+        if (err == H2_NO_ERROR && id <= h2->last_stream &&
+            find_stream(h2, id) == NULL)
+        {
+            queue_rst(h2, id, H2_STREAM_CLOSED);
+        }
+        free(request.path);
+        return err;
+    }
+    if (id % 2 == 0)
+    {
+        free(request.path);
+        return H2_PROTOCOL_ERROR;
+    }
+
+    h2->last_stream = id;
+    struct h2_stream *stream = NULL;
+    if (h2->stream_count < H2_MAX_STREAMS)
+    {
+        stream = create_stream(h2, id);
+    }
+    if (stream == NULL)
+    {
+        queue_rst(h2, id, h2->stream_count < H2_MAX_STREAMS
+                              ? H2_INTERNAL_ERROR
+                              : H2_REFUSED_STREAM);
+        free(request.path);
+        return H2_NO_ERROR;
+    }
+    start_request(srv, conn, stream, &request);
+    free(request.path);
+    return H2_NO_ERROR;
+}
+
+/**
+ * Collect a header block fragment.
+ * @brief Append the fragment of a HEADERS or CONTINUATION frame to the 
+ * header block.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection that received the frame.
+ * @param fragment The fragment.
+ * @param len The length of the fragment.
+ * @param end Whether the frame ends the block.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error append_block(struct server *srv, struct connection *conn,
+                                  const uint8_t *fragment, size_t len,
+                                  bool end)
+{
+    struct h2_conn *h2 = conn->h2;
+    if (h2->block == NULL)
+    {
+        h2->block = malloc(H2_BLOCK_SIZE);
+        if (h2->block == NULL)
+        {
+            return H2_INTERNAL_ERROR;
+        }
+    }
+    if (len > H2_BLOCK_SIZE - h2->block_len)
+    {
+        return H2_ENHANCE_YOUR_CALM;
+    }
+    memcpy(h2->block + h2->block_len, fragment, len);
+    h2->block_len += len;
+    if (!end)
+    {
+        h2->continuation = true;
+        return H2_NO_ERROR;
+    }
+    return end_headers(srv, conn);
+}
+
+/**
+ * Handle HEADERS.
+ * @brief Strip the padding and priority of the frame and collect its 
+ * fragment.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection that received the frame.
+ * @param frame The header of the frame.
+ * @param payload The payload of the frame.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error handle_headers(struct server *srv,
+                                    struct connection *conn,
+                                    const struct h2_frame *frame,
+                                    const uint8_t *payload)
+{
+    if (frame->stream == 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    size_t start = 0;
+    size_t pad = 0;
+    if ((frame->flags & H2_FLAG_PADDED) != 0)
+    {
+        if (frame->length < 1)
+        {
+            return H2_FRAME_SIZE_ERROR;
+        }
+        pad = payload[0];
+        start = 1;
+    }
+    if ((frame->flags & H2_FLAG_PRIORITY) != 0)
+    {
+        start += 5;
+    }
+    if (start + pad > frame->length)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+
+    conn->h2->block_stream = frame->stream;
+    conn->h2->block_len = 0;
+    return append_block(srv, conn, payload + start,
+                        frame->length - start - pad,
+                        (frame->flags & H2_FLAG_END_HEADERS) != 0);
+}
+
+/**
+ * Handle SETTINGS.
+ * @brief Apply the settings of the client and acknowledge them.
+ * @details A new initial window changes the window of every open stream by
+ * the difference.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param frame The header of the frame.
+ * @param payload The payload of the frame.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error handle_settings(struct h2_conn *h2,
+                                     const struct h2_frame *frame,
+                                     const uint8_t *payload)
+{
+    if (frame->stream != 0)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+    if ((frame->flags & H2_FLAG_ACK) != 0)
+    {
+        return frame->length == 0 ? H2_NO_ERROR : H2_FRAME_SIZE_ERROR;
+    }
+
+    int64_t old_window = h2->peer.values[H2_INITIAL_WINDOW_SIZE];
+    enum h2_error err = h2_settings_apply(&h2->peer, payload, frame->length);
+    if (err != H2_NO_ERROR)
+    {
+        return err;
+    }
+    int64_t delta = h2->peer.values[H2_INITIAL_WINDOW_SIZE] - old_window;
+    for (struct h2_stream *stream = h2->streams; stream != NULL;
+         stream = stream->next)
+    {
+        stream->window += delta;
+        if (stream->window > H2_MAX_WINDOW)
+        {
+            return H2_FLOW_CONTROL_ERROR;
+        }
+    }
+    queue_frame(h2, 0, H2_SETTINGS, H2_FLAG_ACK, 0);
+    return H2_NO_ERROR;
+}
+
+/**
+ * Handle WINDOW_UPDATE.
+ * @brief Grow the flow control window of the connection or a stream.
+ * @details An invalid update of a stream only resets that stream.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param frame The header of the frame.
+ * @param payload The payload of the frame.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error handle_window_update(struct h2_conn *h2,
+                                          const struct h2_frame *frame,
+                                          const uint8_t *payload)
+{
+    if (frame->length != 4)
+    {
+        return H2_FRAME_SIZE_ERROR;
+    }
+    uint32_t increment = h2_get32(payload) & 0x7fffffff;
+    if (frame->stream == 0)
+    {
+        h2->window += increment;
+        if (increment == 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        return h2->window > H2_MAX_WINDOW ? H2_FLOW_CONTROL_ERROR
+                                          : H2_NO_ERROR;
+    }
+
+    struct h2_stream *stream = find_stream(h2, frame->stream);
+    if (stream == NULL)
+    {
+        return H2_NO_ERROR;
+    }
+    stream->window += increment;
+    if (increment == 0 || stream->window > H2_MAX_WINDOW)
+    {
+        queue_rst(h2, stream->id, increment == 0 ? H2_PROTOCOL_ERROR
+                                                 : H2_FLOW_CONTROL_ERROR);
+        end_stream(h2, stream);
+    }
+    return H2_NO_ERROR;
+}
+
+/**
+ * Handle a HTTP/2 frame.
+ * @brief Act on a complete frame received from the client.
+ * @details Request bodies are not needed, DATA is only given back to the 
+ * flow control window of the connection. PRIORITY and unknown frames are
+ * ignored.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection that received the frame.
+ * @param frame The header of the frame.
+ * @param payload The payload of the frame.
+ * @return H2_NO_ERROR or the error of the connection.
+ */
+static enum h2_error handle_frame(struct server *srv, struct connection *conn,
+                                  const struct h2_frame *frame,
+                                  const uint8_t *payload)
+{
+    struct h2_conn *h2 = conn->h2;
+    if (h2->continuation && frame->type != H2_CONTINUATION)
+    {
+        return H2_PROTOCOL_ERROR;
+    }
+
+    struct h2_stream *stream;
+    switch (frame->type)
+    {
+    case H2_DATA:
+        if (frame->stream == 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        if (frame->length > 0)
+        {
+            uint8_t *increment = queue_frame(h2, 4, H2_WINDOW_UPDATE, 0, 0);
+            if (increment != NULL)
+            {
+                h2_put32(increment, frame->length);
+            }
+        }
+        return H2_NO_ERROR;
+
+    case H2_HEADERS:
+        return handle_headers(srv, conn, frame, payload);
+
+    case H2_PRIORITY:
+        if (frame->stream == 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        return frame->length == 5 ? H2_NO_ERROR : H2_FRAME_SIZE_ERROR;
+
+    case H2_RST_STREAM:
+        if (frame->stream == 0 || frame->stream > h2->last_stream)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        if (frame->length != 4)
+        {
+            return H2_FRAME_SIZE_ERROR;
+        }
+        stream = find_stream(h2, frame->stream);
+        if (stream != NULL)
+        {
+            end_stream(h2, stream);
+        }
+        return H2_NO_ERROR;
+
+    case H2_SETTINGS:
+        return handle_settings(h2, frame, payload);
+
+    case H2_PUSH_PROMISE:
+        // Clients must not push
+        return H2_PROTOCOL_ERROR;
+
+    case H2_PING:
+        if (frame->stream != 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        if (frame->length != 8)
+        {
+            return H2_FRAME_SIZE_ERROR;
+        }
+        if ((frame->flags & H2_FLAG_ACK) == 0)
+        {
+            uint8_t *pong = queue_frame(h2, 8, H2_PING, H2_FLAG_ACK, 0);
+            if (pong != NULL)
+            {
+                memcpy(pong, payload, 8);
+            }
+        }
+        return H2_NO_ERROR;
+
+    case H2_GOAWAY:
+        if (frame->stream != 0)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        if (frame->length < 8)
+        {
+            return H2_FRAME_SIZE_ERROR;
+        }
+        // The open streams are still served
+        if (!h2->goaway)
+        {
+            queue_goaway(h2, H2_NO_ERROR);
+        }
+        return H2_NO_ERROR;
+
+    case H2_WINDOW_UPDATE:
+        return handle_window_update(h2, frame, payload);
+
+    case H2_CONTINUATION:
+        if (!h2->continuation || frame->stream != h2->block_stream)
+        {
+            return H2_PROTOCOL_ERROR;
+        }
+        return append_block(srv, conn, payload, frame->length,
+                            (frame->flags & H2_FLAG_END_HEADERS) != 0);
+
+    default:
+        return H2_NO_ERROR;
+    }
+}
+
+/**
+ * Handle the received HTTP/2 frames.
+ * @brief Check the preface and act on every complete frame in the input.
+ * @details Stops early while the output is above H2_OUT_LIMIT, the rest is
+ * handled once it was sent. A connection error queues GOAWAY and closes the
+ * connection.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection that received the frames.
+ */
+static void handle_frames(struct server *srv, struct connection *conn)
+{
+    struct h2_conn *h2 = conn->h2;
+    size_t pos = 0;
+    if (!h2->preface)
+    {
+        size_t len = h2->in_len < H2_PREFACE_LEN ? h2->in_len : H2_PREFACE_LEN;
+        if (memcmp(h2->in, H2_PREFACE, len) != 0)
+        {
+            queue_goaway(h2, H2_PROTOCOL_ERROR);
+            return;
+        }
+        if (len < H2_PREFACE_LEN)
+        {
+            return;
+        }
+        h2->preface = true;
+        pos = H2_PREFACE_LEN;
+    }
+
+    while (!h2->closing && h2->out_len < H2_OUT_LIMIT &&
+           h2->in_len - pos >= H2_FRAME_HEADER)
+    {
+        struct h2_frame frame;
+        h2_read_frame(h2->in + pos, &frame);
+        if (frame.length > H2_DEFAULT_FRAME_SIZE)
+        {
+            queue_goaway(h2, H2_FRAME_SIZE_ERROR);
+            break;
+        }
+        if (h2->in_len - pos < H2_FRAME_HEADER + frame.length)
+        {
+            break;
+        }
+        enum h2_error err = handle_frame(srv, conn, &frame,
+                                         h2->in + pos + H2_FRAME_HEADER);
+        pos += H2_FRAME_HEADER + frame.length;
+        if (err != H2_NO_ERROR)
+        {
+            queue_goaway(h2, err);
+        }
+    }
+    memmove(h2->in, h2->in + pos, h2->in_len - pos);
+    h2->in_len -= pos;
+}
+
+/**
+ * Find the next HTTP/2 stream to send.
+ * @brief Find the first stream whose body may continue.
+ * @details The body must have been responded, and flow control of the
+ * stream and the connection must allow at least one byte. A DATA frame of a
+ * file only starts while the output is empty. After an upgrade the bodies 
+ * wait for the preface, as a client that is still switching may only buffer
+ * little behind the 101 response.
+ * @param h2 The HTTP/2 state of the connection.
+ * @return The stream, or NULL if no stream may send.
+ */
+static struct h2_stream *next_sender(struct h2_conn *h2)
+{
+    if (h2->window <= 0 || !h2->preface)
+    {
+        return NULL;
+    }
+    for (struct h2_stream *stream = h2->streams; stream != NULL;
+         stream = stream->next)
+    {
+        if (stream->responded && !stream->reset && stream->window > 0 &&
+            (stream->body_fd == -1 || h2->out_len == 0))
+        {
+            return stream;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Queue a HTTP/2 DATA frame.
+ * @brief Queue the next part of the body of a stream, as large as the frame
+ * size and the flow control windows allow.
+ * @details The stream goes to the end of the list. A body in memory is 
+ * copied into the output and the stream is freed after its last frame, for
+ * a file the frame becomes the one being sent.
+ * @param h2 The HTTP/2 state of the connection.
+ * @param stream The stream that may send.
+ */
+static void queue_data_frame(struct h2_conn *h2, struct h2_stream *stream)
+{
+    size_t len = stream->body_len - stream->body_sent;
+    if (len > h2->peer.values[H2_MAX_FRAME_SIZE])
+    {
+        len = h2->peer.values[H2_MAX_FRAME_SIZE];
+    }
+    if ((int64_t)len > stream->window)
+    {
+        len = stream->window;
+    }
+    if ((int64_t)len > h2->window)
+    {
+        len = h2->window;
+    }
+    bool end = stream->body_sent + len == stream->body_len;
+    uint8_t flags = end ? H2_FLAG_END_STREAM : 0;
+    stream->window -= len;
+    h2->window -= len;
+
+    unlink_stream(h2, stream);
+    struct h2_stream **link = &h2->streams;
+    while (*link != NULL)
+    {
+        link = &(*link)->next;
+    }
+    *link = stream;
+
+    if (stream->body_fd != -1)
+    {
+        h2_write_frame(h2->segment_header, len, H2_DATA, flags, stream->id);
+        h2->segment_header_sent = 0;
+        h2->segment = len;
+        h2->segment_sent = 0;
+        h2->sending = stream;
+        return;
+    }
+
+    uint8_t *payload = queue_frame(h2, len, H2_DATA, flags, stream->id);
+    if (payload == NULL)
+    {
+        return;
+    }
+    memcpy(payload, stream->gz_entry->data + stream->body_sent, len);
+    stream->body_sent += len;
+    if (end)
+    {
+        free_stream(h2, stream);
+    }
+}
+
+/**
+ * Send the HTTP/2 output.
+ * @brief Send the queued frames and the bodies of the streams as far as 
+ * possible without blocking.
+ * @details Bodies in memory are queued up to H2_OUT_LIMIT and leave in one
+ * send, files leave with sendfile one DATA frame at a time.
+ * @param conn The connection to send on.
+ * @return 1 if nothing is left that may be sent, 0 if the socket would
+ * block and -1 on error.
+ */
+static int send_h2(struct connection *conn)
+{
+    struct h2_conn *h2 = conn->h2;
+    while (true)
+    {
+        int ret;
+        if (h2->sending != NULL)
+        {
+            struct h2_stream *stream = h2->sending;
+            ret = send_buffer(conn->fd, h2->segment_header, H2_FRAME_HEADER,
+                              &h2->segment_header_sent, MSG_MORE);
+            if (ret == 1)
+            {
+                ret = send_file(conn->fd, stream->body_fd, stream->body_sent,
+                                h2->segment, &h2->segment_sent);
+            }
+            if (ret != 1)
+            {
+                return ret;
+            }
+            stream->body_sent += h2->segment;
+            h2->sending = NULL;
+            if (stream->reset || stream->body_sent == stream->body_len)
+            {
+                free_stream(h2, stream);
+            }
+        }
+        else if (h2->out_sent < h2->out_len)
+        {
+            ret = send_buffer(conn->fd, h2->out, h2->out_len, &h2->out_sent, 0);
+            if (ret != 1)
+            {
+                return ret;
+            }
+            h2->out_len = 0;
+            h2->out_sent = 0;
+        }
+        else
+        {
+            struct h2_stream *stream;
+            bool queued = false;
+            while (!h2->closing && h2->sending == NULL &&
+                   h2->out_len < H2_OUT_LIMIT &&
+                   (stream = next_sender(h2)) != NULL)
+            {
+                queue_data_frame(h2, stream);
+                queued = true;
+            }
+            if (!queued)
+            {
+                return 1;
+            }
+        }
+    }
+}
+
+/**
+ * Switch a connection to HTTP/2.
+ * @brief Set up the HTTP/2 state and queue the settings of the server.
+ * @details After an upgrade the 101 response comes first, the request 
+ * becomes stream 1 and the preface of the client is still expected. With 
+ * prior knowledge the preface was already read. The bytes after the request
+ * or the preface are the first frames.
+ * Will switch the connection to STATE_H2 or STATE_CLOSE.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection whose request (or preface) was read.
+ * @param upgraded Whether the client asked for an upgrade.
+ */
+static void start_h2(struct server *srv, struct connection *conn,
+                     bool upgraded)
+{
+    struct h2_conn *h2 = calloc(1, sizeof(struct h2_conn));
+    if (h2 == NULL)
+    {
+        conn->state = STATE_CLOSE;
+        return;
+    }
+    h2_hpack_init(&h2->hpack, H2_DEFAULT_TABLE_SIZE);
+    h2_settings_init(&h2->peer);
+    h2->window = H2_DEFAULT_WINDOW;
+    h2->preface = !upgraded;
+    conn->h2 = h2;
+    conn->state = STATE_H2;
+
+    memcpy(h2->in, conn->request + conn->request_end,
+           conn->request_len - conn->request_end);
+    h2->in_len = conn->request_len - conn->request_end;
+    conn->request_len = 0;
+    conn->request_end = 0;
+    conn->range_count = 0;
+
+    if (upgraded)
+    {
+        const char *switching = "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+        uint8_t *out = reserve_out(h2, strlen(switching));
+        if (out != NULL)
+        {
+            memcpy(out, switching, strlen(switching));
+        }
+        h2->peer = conn->upgrade_settings;
+    }
+    uint8_t *settings = queue_frame(h2, 6, H2_SETTINGS, 0, 0);
+    if (settings != NULL)
+    {
+        h2_write_setting(settings, H2_MAX_CONCURRENT_STREAMS, H2_MAX_STREAMS);
+    }
+
+    if (upgraded)
+    {
+        struct h2_stream *stream = create_stream(h2, 1);
+        if (stream == NULL)
+        {
+            conn->state = STATE_CLOSE;
+            return;
+        }
+        h2->last_stream = 1;
+        stream->filename = conn->filename;
+        stream->accept = conn->accept;
+        conn->filename = NULL;
+        open_stream(srv, conn, stream);
+    }
+}
+
+/**
+ * Drive a HTTP/2 connection.
+ * @brief Handle the received frames, send what may be sent and read more
+ * frames, until the socket would block.
+ * @details Once the server shuts down GOAWAY is sent. The connection is
+ * closed after a connection error, or after GOAWAY once all streams are
+ * done.
+ * Will switch the connection to STATE_CLOSE.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to drive.
+ * @return true if the connection waits for the socket to be writable, false
+ * if it waits for frames.
+ */
+static bool drive_h2(struct server *srv, struct connection *conn)
+{
+    struct h2_conn *h2 = conn->h2;
+    if (!alive && !h2->goaway)
+    {
+        queue_goaway(h2, H2_NO_ERROR);
+    }
+
+    while (true)
+    {
+        handle_frames(srv, conn);
+        int ret = send_h2(conn);
+        if (ret == -1 ||
+            (ret == 1 && (h2->closing || (h2->goaway && h2->streams == NULL))))
+        {
+            conn->state = STATE_CLOSE;
+            return false;
+        }
+        if (ret == 0)
+        {
+            return true;
+        }
+        if (h2->in_len == sizeof(h2->in))
+        {
+            // Frames are left that waited for the output
+            continue;
+        }
+
+        ssize_t n = read(conn->fd, h2->in + h2->in_len,
+                         sizeof(h2->in) - h2->in_len);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return false;
+        }
+        if (n == -1 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            conn->state = STATE_CLOSE;
+            return false;
+        }
+        h2->in_len += n;
+    }
+}
+
+/**
+ * Update the epoll interest.
+ * @brief Wait for the socket to become readable or writable, depending on 
+ * the state of the connection.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to update.
+ * @param want_write If true the connection waits for EPOLLOUT otherwise for 
+ * EPOLLIN.
+ */
+static void watch_connection(struct server *srv, struct connection *conn,
+                             bool want_write)
+{
+    if (!conn->paused && conn->want_write == want_write)
+    {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = want_write ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = conn;
+    epoll_ctl(srv->epollfd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->want_write = want_write;
+    conn->paused = false;
+}
+
+/**
+ * Pause the epoll interest.
+ * @brief Stop waiting for the socket while a disk thread works for the 
+ * connection.
+ * @details Otherwise the loop would wake up over and over for a pipelined
+ * request that can't be read yet. Errors and hangups are still reported.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to pause.
+ */
+static void pause_connection(struct server *srv, struct connection *conn)
+{
+    if (conn->paused)
+    {
+        return;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.data.ptr = conn;
+    epoll_ctl(srv->epollfd, EPOLL_CTL_MOD, conn->fd, &ev);
+    conn->paused = true;
+}
+
+/**
+ * Drive a connection.
+ * @brief Run the state machine of the connection until it would block or is
+ * closed.
+ * @details The connection must not be used after this function as it might 
+ * have been destroyed.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to drive.
+ */
+static void handle_connection(struct server *srv, struct connection *conn)
+{
+    conn->last_active = time(NULL);
+
+    while (true)
+    {
+        int ret;
+        bool want_write;
+        switch (conn->state)
+        {
+        case STATE_READ_HEADER:
+            read_header(srv, conn);
+            if (conn->state == STATE_READ_HEADER)
+            {
+                watch_connection(srv, conn, false);
+                return;
+            }
+            break;
+
+        case STATE_OPEN_FILE:
+            open_file(srv, conn);
+            break;
+
+        case STATE_WAIT_FILE:
+            pause_connection(srv, conn);
+            return;
+
+        case STATE_SEND_HEADER:
+            if (conn->gz_entry != NULL)
+            {
+                ret = send_header_body(conn);
+            }
+            else
+            {
+                // With MSG_MORE the header leaves together with the start of
+                // the file instead of in a segment of its own
+                bool more = conn->gz_stream != NULL ||
+                            (conn->body_fd != -1 && conn->body_len > 0);
+                ret = send_buffer(conn->fd, conn->header, conn->header_len,
+                                  &conn->header_sent, more ? MSG_MORE : 0);
+            }
+            if (ret == 0)
+            {
+                watch_connection(srv, conn, true);
+                return;
+            }
+            conn->state = ret == 1 ? STATE_SEND_BODY : STATE_CLOSE;
+            break;
+
+        case STATE_SEND_BODY:
+            if (conn->gz_stream != NULL)
+            {
+                ret = send_chunked(conn->fd, conn->gz_stream, conn->body_fd);
+            }
+            else if (conn->range_count > 1)
+            {
+                ret = send_ranges(conn);
+            }
+            else if (conn->body_fd != -1)
+            {
+                ret = send_file(conn->fd, conn->body_fd, conn->body_start,
+                                conn->body_len, &conn->body_sent);
+            }
+            else if (conn->gz_entry != NULL)
+            {
+                ret = send_buffer(conn->fd, conn->gz_entry->data, conn->body_len,
+                                  &conn->body_sent, 0);
+            }
+            else
+            {
+                // Error responses have no body
+                ret = 1;
+            }
+            if (ret == 0)
+            {
+                watch_connection(srv, conn, true);
+                return;
+            }
+            if (ret == -1 || !conn->keep_alive)
+            {
+                conn->state = STATE_CLOSE;
+                break;
+            }
+            reset_connection(conn);
+            break;
+
+        case STATE_H2:
+            want_write = drive_h2(srv, conn);
+            if (conn->state == STATE_H2)
+            {
+                watch_connection(srv, conn, want_write);
+                return;
+            }
+            break;
+
+        case STATE_CLOSE:
+            destroy_connection(srv, conn);
+            return;
+        }
+    }
+}
+
+/**
+ * Accept new connections.
+ * @brief Accept all pending connections on the listening socket.
+ * @details May use the global variable prog_name.
+ * @param srv The server that accepts.
+ * @return Upon success 0, otherwise -1.
+ */
+static int accept_connections(struct server *srv)
+{
+    while (true)
+    {
+        int connfd = accept(srv->sockfd, NULL, NULL);
+        if (connfd == -1)
+        {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR ||
+                errno == ECONNABORTED)
+            {
+                return 0;
+            }
+            if (errno == EMFILE || errno == ENFILE)
+            {
+                // Out of file descriptors, the idle sweep will free some
+                fprintf(stderr, "[%s] WARNING: Unable to accept: %s\n",
+                        prog_name, strerror(errno));
+                return 0;
+            }
+            fprintf(stderr, "[%s] ERROR: Unable to connect: %s\n",
+                    prog_name, strerror(errno));
+            return -1;
+        }
+
+        if (fcntl(connfd, F_SETFL, O_NONBLOCK) == -1 ||
+            create_connection(srv, connfd) == NULL)
+        {
+            close(connfd);
+        }
+    }
+}
+
+/**
+ * Queue an operation of a connection.
+ * @brief Get a submission queue entry for an operation on behalf of the 
+ * connection.
+ * @details The connection and the operation are stored in the user data of
+ * the entry, and the connection counts the operation as in flight until its 
+ * completion arrives.
+ * @param srv The server with the ring.
+ * @param conn The connection.
+ * @param op The operation.
+ * @return The entry, or NULL if the queue is full.
+ */
+static struct io_uring_sqe *queue_op(struct server *srv, struct connection *conn,
+                                     enum uring_op op)
+{
+    struct io_uring_sqe *sqe = uring_sqe(srv->ring);
+    if (sqe != NULL)
+    {
+        sqe->user_data = (uintptr_t)conn | op;
+        conn->inflight++;
+    }
+    return sqe;
+}
+
+/**
+ * Queue a read of the request.
+ * @brief Receive into a buffer the kernel picks from the provided buffers.
+ * @param srv The server with the ring.
+ * @param conn The connection to read from.
+ * @return 0 if the read was queued, -1 on error.
+ */
+static int uring_recv(struct server *srv, struct connection *conn)
+{
+    struct io_uring_sqe *sqe = queue_op(srv, conn, URING_RECV);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    size_t room = REQUEST_SIZE - conn->request_len;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->len = room < URING_BUFFER_SIZE ? room : URING_BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    return 0;
+}
+
+/**
+ * Queue a send.
+ * @brief The io_uring version of send_buffer.
+ * @param srv The server with the ring.
+ * @param conn The connection to send to.
+ * @param buf The buffer to send.
+ * @param len The length of the buffer.
+ * @param sent The number of bytes already sent, will be updated when the 
+ * send completes.
+ * @param flags Additional flags for send, like MSG_MORE.
+ * @return 1 if the buffer was sent completely, 0 if the send was queued and
+ * -1 on error.
+ */
+static int uring_send(struct server *srv, struct connection *conn, void *buf,
+                      size_t len, size_t *sent, int flags)
+{
+    if (*sent == len)
+    {
+        return 1;
+    }
+    struct io_uring_sqe *sqe = queue_op(srv, conn, URING_SEND);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = conn->fd;
+    sqe->addr = (uintptr_t)((uint8_t *)buf + *sent);
+    sqe->len = len - *sent;
+    sqe->msg_flags = MSG_NOSIGNAL | flags;
+    conn->send_progress = sent;
+    return 0;
+}
+
+/**
+ * Queue the header and an in memory body.
+ * @brief The io_uring version of send_header_body.
+ * @param srv The server with the ring.
+ * @param conn The connection whose header and compressed body are sent.
+ * @return 1 if both were sent completely, 0 if the send was queued and -1 on
+ * error.
+ */
+static int uring_send_header_body(struct server *srv, struct connection *conn)
+{
+    if (conn->header_sent == conn->header_len &&
+        conn->body_sent == conn->body_len)
+    {
+        return 1;
+    }
+    struct io_uring_sqe *sqe = queue_op(srv, conn, URING_SEND);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+
+    int iovcnt = 0;
+    if (conn->header_sent < conn->header_len)
+    {
+        conn->send_iov[iovcnt].iov_base = conn->header + conn->header_sent;
+        conn->send_iov[iovcnt].iov_len = conn->header_len - conn->header_sent;
+        iovcnt++;
+    }
+    conn->send_iov[iovcnt].iov_base = conn->gz_entry->data + conn->body_sent;
+    conn->send_iov[iovcnt].iov_len = conn->body_len - conn->body_sent;
+    iovcnt++;
+    memset(&conn->send_msg, 0, sizeof(conn->send_msg));
+    conn->send_msg.msg_iov = conn->send_iov;
+    conn->send_msg.msg_iovlen = iovcnt;
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uintptr_t)&conn->send_msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    conn->send_progress = NULL;
+    return 0;
+}
+
+/**
+ * Queue a part of a file.
+ * @brief The io_uring version of send_file.
+ * @details Two linked splices move the next SPLICE_WINDOW bytes from the 
+ * file into the pipe of the connection and from there into the socket, so
+ * the data never passes through user space. If the socket took less than 
+ * the pipe holds, only the rest in the pipe is sent.
+ * @param srv The server with the ring.
+ * @param conn The connection to send to.
+ * @param file_fd The file to send.
+ * @param start The offset in the file where the data to send starts.
+ * @param len The number of bytes to send.
+ * @param sent The number of bytes already sent, will be updated when the 
+ * splices complete.
+ * @return 1 if the file was sent completely, 0 if the splices were queued
+ * and -1 on error.
+ */
+static int uring_splice(struct server *srv, struct connection *conn,
+                        int file_fd, off_t start, size_t len, size_t *sent)
+{
+    if (*sent == len)
+    {
+        return 1;
+    }
+    if (conn->pipe_fds[0] == -1 && pipe2(conn->pipe_fds, O_CLOEXEC) == -1)
+    {
+        conn->pipe_fds[0] = -1;
+        return -1;
+    }
+    conn->send_progress = sent;
+
+    size_t window = conn->pipe_len;
+    if (window == 0)
+    {
+        size_t left = len - *sent;
+        window = left < SPLICE_WINDOW ? left : SPLICE_WINDOW;
+        struct io_uring_sqe *in = queue_op(srv, conn, URING_SPLICE_IN);
+        if (in == NULL)
+        {
+            return -1;
+        }
+        in->opcode = IORING_OP_SPLICE;
+        in->splice_fd_in = file_fd;
+        in->splice_off_in = start + *sent;
+        in->fd = conn->pipe_fds[1];
+        in->off = -1;
+        in->len = window;
+        in->flags = IOSQE_IO_LINK;
+    }
+
+    struct io_uring_sqe *out = queue_op(srv, conn, URING_SPLICE_OUT);
+    if (out == NULL)
+    {
+        return -1;
+    }
+    out->opcode = IORING_OP_SPLICE;
+    out->splice_fd_in = conn->pipe_fds[0];
+    out->splice_off_in = -1;
+    out->fd = conn->fd;
+    out->off = -1;
+    out->len = window;
+    return 0;
+}
+
+/**
+ * Queue the response header.
+ * @brief The io_uring version of the STATE_SEND_HEADER step.
+ * @param srv The server with the ring.
+ * @param conn The connection whose header is sent.
+ * @return 1 if the header was sent completely, 0 if the send was queued and
+ * -1 on error.
+ */
+static int uring_send_header(struct server *srv, struct connection *conn)
+{
+    if (conn->gz_entry != NULL)
+    {
+        return uring_send_header_body(srv, conn);
+    }
+    bool more = conn->gz_stream != NULL ||
+                (conn->body_fd != -1 && conn->body_len > 0);
+    return uring_send(srv, conn, conn->header, conn->header_len,
+                      &conn->header_sent, more ? MSG_MORE : 0);
+}
+
+/**
+ * Queue a multipart/byteranges body.
+ * @brief The io_uring version of send_ranges.
+ * @param srv The server with the ring.
+ * @param conn The connection whose ranges are sent.
+ * @return 1 if the body was sent completely, 0 if a send was queued and -1 
+ * on error.
+ */
+static int uring_send_ranges(struct server *srv, struct connection *conn)
+{
+    while (conn->range_index <= conn->range_count)
+    {
+        size_t index = conn->range_index;
+        if (conn->part_len == 0)
+        {
+            conn->part_len = format_part_header(conn->part_header, conn, index);
+            conn->part_sent = 0;
+            conn->body_sent = 0;
+        }
+
+        bool last = index == conn->range_count;
+        int ret = uring_send(srv, conn, conn->part_header, conn->part_len,
+                             &conn->part_sent, last ? 0 : MSG_MORE);
+        if (ret == 1 && !last)
+        {
+            struct byte_range *range = &conn->ranges[index];
+            ret = uring_splice(srv, conn, conn->body_fd, range->first,
+                               range->last - range->first + 1, &conn->body_sent);
+        }
+        if (ret != 1)
+        {
+            return ret;
+        }
+        conn->range_index++;
+        conn->part_len = 0;
+    }
+    return 1;
+}
+
+/**
+ * Queue the response body.
+ * @brief The io_uring version of the STATE_SEND_BODY step.
+ * @param srv The server with the ring.
+ * @param conn The connection whose body is sent.
+ * @return 1 if the body was sent completely, 0 if a send was queued and -1 
+ * on error.
+ */
+static int uring_send_body(struct server *srv, struct connection *conn)
+{
+    if (conn->gz_stream != NULL)
+    {
+        struct gzstream *stream = conn->gz_stream;
+        while (stream->out_sent == stream->out_len)
+        {
+            if (stream->done)
+            {
+                return 1;
+            }
+            if (fill_chunk(stream, conn->body_fd) == -1)
+            {
+                return -1;
+            }
+        }
+        return uring_send(srv, conn, stream->out, stream->out_len,
+                          &stream->out_sent, 0);
+    }
+    if (conn->range_count > 1)
+    {
+        return uring_send_ranges(srv, conn);
+    }
+    if (conn->body_fd != -1)
+    {
+        return uring_splice(srv, conn, conn->body_fd, conn->body_start,
+                            conn->body_len, &conn->body_sent);
+    }
+    if (conn->gz_entry != NULL)
+    {
+        return uring_send(srv, conn, conn->gz_entry->data, conn->body_len,
+                          &conn->body_sent, 0);
+    }
+    // Error responses have no body
+    return 1;
+}
+
+/**
+ * Drive a connection in io_uring mode.
+ * @brief Run the state machine of the connection until an operation is in 
+ * flight or the connection is closed.
+ * @details The same steps as handle_connection, but instead of calling a 
+ * syscall that would block an operation is queued, and the connection is
+ * driven again once all its operations completed.
+ * The connection must not be used after this function as it might have been
+ * destroyed.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to drive.
+ */
+static void drive_connection(struct server *srv, struct connection *conn)
+{
+    conn->last_active = time(NULL);
+
+    while (conn->inflight == 0)
+    {
+        int ret = 0;
+        switch (conn->state)
+        {
+        case STATE_READ_HEADER:
+            if (!find_request(srv, conn))
+            {
+                ret = uring_recv(srv, conn);
+            }
+            break;
+
+        case STATE_OPEN_FILE:
+            open_file(srv, conn);
+            break;
+
+        case STATE_WAIT_FILE:
+            return;
+
+        case STATE_SEND_HEADER:
+            ret = uring_send_header(srv, conn);
+            if (ret == 1)
+            {
+                conn->state = STATE_SEND_BODY;
+            }
+            break;
+
+        case STATE_SEND_BODY:
+            ret = uring_send_body(srv, conn);
+            if (ret == 1 && !conn->keep_alive)
+            {
+                conn->state = STATE_CLOSE;
+            }
+            else if (ret == 1)
+            {
+                reset_connection(conn);
+            }
+            break;
+
+        case STATE_H2:
+            // HTTP/2 is only offered in epoll mode
+            ret = -1;
+            break;
+
+        case STATE_CLOSE:
+            destroy_connection(srv, conn);
+            return;
+        }
+        if (ret == -1)
+        {
+            conn->state = STATE_CLOSE;
+        }
+    }
+}
+
+/**
+ * Continue a connection.
+ * @brief Drive the connection with the state machine of the current mode.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to continue.
+ */
+static void continue_connection(struct server *srv, struct connection *conn)
+{
+    if (srv->ring != NULL)
+    {
+        drive_connection(srv, conn);
+    }
+    else
+    {
+        handle_connection(srv, conn);
+    }
+}
+
+/**
+ * Close a connection.
+ * @brief Destroy the connection, or in io_uring mode, shut its socket down
+ * if operations are still in flight.
+ * @details The kernel may still use the buffers of the connection, so it is
+ * destroyed when the failed operations complete.
+ * @param srv The server to which the connection belongs.
+ * @param conn The connection to close.
+ */
+static void close_connection(struct server *srv, struct connection *conn)
+{
+    if (conn->inflight > 0)
+    {
+        conn->state = STATE_CLOSE;
+        shutdown(conn->fd, SHUT_RDWR);
+        return;
+    }
+    destroy_connection(srv, conn);
+}
+
+/**
+ * Collect finished file jobs.
+ * @brief Continue every connection whose file was opened or compressed by a
+ * disk thread.
+ * @param srv The server whose jobs are collected.
+ */
+static void collect_file_jobs(struct server *srv)
+{
+    struct fileio_job *job;
+    while ((job = fileio_complete(srv->io)) != NULL)
+    {
+        struct connection *conn = job->owner;
+        finish_file_job(srv, (struct file_job *)job);
+        if (conn != NULL)
+        {
+            continue_connection(srv, conn);
+        }
+    }
+}
+
+/**
+ * Close idle connections.
+ * @brief Close all connections that didn't make any progress for 
+ * IDLE_TIMEOUT seconds.
+ * @details Connections waiting for a disk thread are not idle, a slow disk
+ * is not the fault of the client.
+ * @param srv The server whose connections are checked.
+ */
+static void close_idle_connections(struct server *srv)
+{
+    time_t now = time(NULL);
+    struct connection *conn = srv->connections;
+    while (conn != NULL)
+    {
+        struct connection *next = conn->next;
+        if (conn->job == NULL && (conn->h2 == NULL || conn->h2->jobs == 0) &&
+            now - conn->last_active >= IDLE_TIMEOUT)
+        {
+            close_connection(srv, conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Close connections for a shutdown.
+ * @brief Close all connections that wait for a new request on a keep-alive 
+ * connection.
+ * @details Connections that are in the middle of a request are left alone
+ * so that they can finish. HTTP/2 connections are driven once more, so they
+ * send GOAWAY and close once their open streams are done.
+ * @param srv The server whose connections are checked.
+ */
+static void close_waiting_connections(struct server *srv)
+{
+    struct connection *conn = srv->connections;
+    while (conn != NULL)
+    {
+        struct connection *next = conn->next;
+        if (conn->state == STATE_READ_HEADER && conn->request_len == 0)
+        {
+            close_connection(srv, conn);
+        }
+        else if (conn->state == STATE_H2 && !conn->h2->goaway)
+        {
+            continue_connection(srv, conn);
+        }
+        conn = next;
+    }
+}
+
+/**
+ * Run the event loop.
+ * @brief Serve all connections until the server is shut down.
+ * @details Reads the global variable alive. Once alive is false no new 
+ * connections are accepted, but responses in flight get DRAIN_TIMEOUT seconds
+ * to finish.
+ * May use the global variable prog_name.
+ * @param srv The server to run.
+ * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ */
+static int run_server(struct server *srv)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL;
+    if (epoll_ctl(srv->epollfd, EPOLL_CTL_ADD, srv->sockfd, &ev) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to add socket to epoll: %s\n",
+                prog_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+    if (srv->io != NULL)
+    {
+        ev.data.ptr = srv->io;
+        if (epoll_ctl(srv->epollfd, EPOLL_CTL_ADD, srv->io->eventfd, &ev) == -1)
+        {
+            fprintf(stderr, "[%s] ERROR: Unable to add disk threads to epoll: %s\n",
+                    prog_name, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    time_t last_sweep = time(NULL);
+    time_t drain_start = 0;
+    while (true)
+    {
+        if (!alive)
+        {
+            if (drain_start == 0)
+            {
+                epoll_ctl(srv->epollfd, EPOLL_CTL_DEL, srv->sockfd, NULL);
+                drain_start = time(NULL);
+            }
+            close_waiting_connections(srv);
+            if (srv->connections == NULL ||
+                time(NULL) - drain_start >= DRAIN_TIMEOUT)
+            {
+                break;
+            }
+        }
+
+        int n = epoll_wait(srv->epollfd, events, MAX_EVENTS, alive ? 1000 : 100);
+        if (n == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "[%s] ERROR: Unable to wait for events: %s\n",
+                    prog_name, strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        bool jobs_finished = false;
+        for (int i = 0; i < n; i++)
+        {
+            if (events[i].data.ptr == NULL)
+            {
+                if (accept_connections(srv) == -1)
+                {
+                    return EXIT_FAILURE;
+                }
+                continue;
+            }
+            if (srv->io != NULL && events[i].data.ptr == srv->io)
+            {
+                jobs_finished = true;
+                continue;
+            }
+
+            struct connection *conn = events[i].data.ptr;
+            if (events[i].events & (EPOLLERR | EPOLLHUP) &&
+                !(events[i].events & EPOLLIN))
+            {
+                conn->state = STATE_CLOSE;
+            }
+            handle_connection(srv, conn);
+        }
+
+        // Only after all events, as continuing a connection might close it
+        // while an event for it is still in the list
+        if (jobs_finished)
+        {
+            collect_file_jobs(srv);
+        }
+
+        if (time(NULL) - last_sweep >= 1)
+        {
+            close_idle_connections(srv);
+            last_sweep = time(NULL);
+        }
+    }
+
+    return EXIT_SUCCESS;
+}
+
+/**
+ * Queue the multishot accept.
+ * @brief Accept connections on the listening socket until the accept is 
+ * cancelled, with one completion for every connection.
+ * @param srv The server that accepts.
+ * @return Upon success 0, otherwise -1.
+ */
+static int uring_accept(struct server *srv)
+{
+    struct io_uring_sqe *sqe = uring_sqe(srv->ring);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = srv->sockfd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = URING_ACCEPT;
+    return 0;
+}
+
+/**
+ * Queue a poll for finished file jobs.
+ * @brief Wait for the eventfd of the disk threads to become readable.
+ * @param srv The server with the disk threads.
+ * @return Upon success 0, otherwise -1.
+ */
+static int uring_poll_jobs(struct server *srv)
+{
+    struct io_uring_sqe *sqe = uring_sqe(srv->ring);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = srv->io->eventfd;
+    sqe->poll32_events = POLLIN;
+    sqe->user_data = URING_JOBS;
+    return 0;
+}
+
+/**
+ * Queue the tick.
+ * @brief A timeout that wakes up the loop, so idle connections are closed 
+ * and a shutdown is noticed.
+ * @param srv The server to wake up.
+ * @param ms The milliseconds until the tick.
+ * @return Upon success 0, otherwise -1.
+ */
+static int uring_tick(struct server *srv, long ms)
+{
+    struct io_uring_sqe *sqe = uring_sqe(srv->ring);
+    if (sqe == NULL)
+    {
+        return -1;
+    }
+    srv->tick.tv_sec = ms / 1000;
+    srv->tick.tv_nsec = (ms % 1000) * 1000000;
+    sqe->opcode = IORING_OP_TIMEOUT;
+    sqe->addr = (uintptr_t)&srv->tick;
+    sqe->len = 1;
+    sqe->user_data = URING_TICK;
+    return 0;
+}
+
+/**
+ * Complete an operation of a connection.
+ * @brief Take over the result of the operation and drive the connection 
+ * once none of its operations is in flight anymore.
+ * @details A closing connection only waits for its operations.
+ * @param srv The server with the ring.
+ * @param conn The connection of the operation.
+ * @param op The operation.
+ * @param cqe The completion of the operation.
+ */
+static void complete_op(struct server *srv, struct connection *conn,
+                        enum uring_op op, const struct io_uring_cqe *cqe)
+{
+    conn->inflight--;
+    bool closing = conn->state == STATE_CLOSE;
+    int res = cqe->res;
+    switch (op)
+    {
+    case URING_RECV:
+        if (cqe->flags & IORING_CQE_F_BUFFER)
+        {
+            uint16_t id = cqe->flags >> IORING_CQE_BUFFER_SHIFT;
+            if (!closing && res > 0)
+            {
+                memcpy(conn->request + conn->request_len,
+                       uring_buffer(srv->ring, id), res);
+                conn->request_len += res;
+            }
+            uring_recycle(srv->ring, id);
+        }
+        // Without a free buffer the read is simply queued again
+        if (!closing && res <= 0 && res != -ENOBUFS && res != -EINTR)
+        {
+            end_request(conn, res == 0);
+        }
+        break;
+
+    case URING_SEND:
+        if (closing)
+        {
+            break;
+        }
+        if (res < 0)
+        {
+            conn->state = STATE_CLOSE;
+        }
+        else if (conn->send_progress != NULL)
+        {
+            *conn->send_progress += res;
+        }
+        else
+        {
+            advance_header_body(conn, res);
+        }
+        break;
+
+    case URING_SPLICE_IN:
+        if (res > 0)
+        {
+            conn->pipe_len += res;
+        }
+        else if (!closing)
+        {
+            // An error, or the file was truncated while we were sending it
+            conn->state = STATE_CLOSE;
+        }
+        break;
+
+    case URING_SPLICE_OUT:
+        if (res > 0)
+        {
+            conn->pipe_len -= res;
+            *conn->send_progress += res;
+        }
+        else if (!closing && res != -ECANCELED)
+        {
+            // Cancelled means the file gave less than the window, the pipe
+            // is sent on its own next time
+            conn->state = STATE_CLOSE;
+        }
+        break;
+    }
+
+    if (conn->inflight == 0)
+    {
+        drive_connection(srv, conn);
+    }
+}
+
+/**
+ * Handle completions.
+ * @brief Dispatch all completions that arrived to their connections or the
+ * server.
+ * @details May use the global variable prog_name.
+ * @param srv The server with the ring.
+ * @return Upon success 0, otherwise -1.
+ */
+static int handle_completions(struct server *srv)
+{
+    bool jobs_finished = false;
+    struct io_uring_cqe *entry;
+    while ((entry = uring_cqe(srv->ring)) != NULL)
+    {
+        // Handling the completion may queue new entries, which is fine as
+        // the completion is copied first
+        struct io_uring_cqe cqe = *entry;
+        uring_cqe_seen(srv->ring);
+
+        if (cqe.user_data >= URING_TAGS)
+        {
+            struct connection *conn = (struct connection *)(uintptr_t)(cqe.user_data & ~(uint64_t)URING_OP_MASK);
+            complete_op(srv, conn, cqe.user_data & URING_OP_MASK, &cqe);
+            continue;
+        }
+
+        switch (cqe.user_data)
+        {
+        case URING_ACCEPT:
+            if (cqe.res >= 0)
+            {
+                struct connection *conn = create_connection(srv, cqe.res);
+                if (conn == NULL)
+                {
+                    close(cqe.res);
+                }
+                else
+                {
+                    drive_connection(srv, conn);
+                }
+            }
+            else if (cqe.res == -EINVAL)
+            {
+                fprintf(stderr, "[%s] ERROR: Unable to accept: %s\n",
+                        prog_name, strerror(-cqe.res));
+                return -1;
+            }
+            else if (cqe.res != -ECANCELED)
+            {
+                // Out of file descriptors, the idle sweep will free some
+                fprintf(stderr, "[%s] WARNING: Unable to accept: %s\n",
+                        prog_name, strerror(-cqe.res));
+            }
+            if (!(cqe.flags & IORING_CQE_F_MORE) && alive &&
+                uring_accept(srv) == -1)
+            {
+                return -1;
+            }
+            break;
+
+        case URING_JOBS:
+            jobs_finished = true;
+            break;
+
+        case URING_TICK:
+            if (uring_tick(srv, alive ? 1000 : 100) == -1)
+            {
+                return -1;
+            }
+            break;
+        }
+    }
+
+    if (jobs_finished)
+    {
+        collect_file_jobs(srv);
+        if (uring_poll_jobs(srv) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Run the io_uring loop.
+ * @brief Serve all connections until the server is shut down, like 
+ * run_server.
+ * @details Connections are accepted with a multishot accept, requests are
+ * received into provided buffers and bodies are sent with send and linked 
+ * splices, each one an entry of the ring, so a request mostly costs a single
+ * io_uring_enter for all connections together.
+ * Reads the global variable alive.
+ * May use the global variable prog_name.
+ * @param srv The server to run.
+ * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ */
+static int run_uring(struct server *srv)
+{
+    // Splicing into a socket the client closed raises SIGPIPE
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = SIG_IGN;
+    sigaction(SIGPIPE, &sa, NULL);
+
+    if (uring_accept(srv) == -1 || uring_tick(srv, 1000) == -1 ||
+        (srv->io != NULL && uring_poll_jobs(srv) == -1))
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to queue the first entries\n",
+                prog_name);
+        return EXIT_FAILURE;
+    }
+
+    int ret = EXIT_SUCCESS;
+    time_t last_sweep = time(NULL);
+    time_t drain_start = 0;
+    while (true)
+    {
+        if (!alive)
+        {
+            if (drain_start == 0)
+            {
+                struct io_uring_sqe *sqe = uring_sqe(srv->ring);
+                if (sqe != NULL)
+                {
+                    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+                    sqe->addr = URING_ACCEPT;
+                    sqe->user_data = URING_CANCEL;
+                }
+                drain_start = time(NULL);
+            }
+            close_waiting_connections(srv);
+            if (srv->connections == NULL ||
+                time(NULL) - drain_start >= DRAIN_TIMEOUT)
+            {
+                break;
+            }
+        }
+
+        if (uring_wait(srv->ring) == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "[%s] ERROR: Unable to wait for completions: %s\n",
+                    prog_name, strerror(errno));
+            ret = EXIT_FAILURE;
+            break;
+        }
+        if (handle_completions(srv) == -1)
+        {
+            ret = EXIT_FAILURE;
+            break;
+        }
+
+        if (time(NULL) - last_sweep >= 1)
+        {
+            close_idle_connections(srv);
+            last_sweep = time(NULL);
+        }
+    }
+
+    // The kernel may still use the buffers of connections with operations
+    // in flight, so wait (a little) until the shut down sockets failed them
+    struct connection *conn = srv->connections;
+    while (conn != NULL)
+    {
+        struct connection *next = conn->next;
+        close_connection(srv, conn);
+        conn = next;
+    }
+    time_t deadline = time(NULL) + 1;
+    while (srv->connections != NULL && time(NULL) <= deadline)
+    {
+        if ((uring_wait(srv->ring) == -1 && errno != EINTR) ||
+            handle_completions(srv) == -1)
+        {
+            break;
+        }
+    }
+    return ret;
+}
+
+/**
+ * Create the ring.
+ * @brief Set up an io_uring instance with provided buffers for requests.
+ * @details Buffer rings need a kernel as new as multishot accept (5.19), so
+ * if they can be registered every operation of run_uring is supported.
+ * @return Upon success the ring, otherwise NULL (errno is set).
+ */
+static struct uring *create_uring(void)
+{
+    struct uring *ring = uring_create(URING_ENTRIES);
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    if (uring_buffers(ring, URING_BUFFER_GROUP, URING_BUFFERS,
+                      URING_BUFFER_SIZE) == -1)
+    {
+        int err = errno;
+        uring_destroy(ring);
+        errno = err;
+        return NULL;
+    }
+    return ring;
+}
+
+/**
+ * Serve.
+ * @brief Create the socket, the cache and the event loop and serve until 
+ * the server gets shut down.
+ * @details In multi-worker mode every worker calls this function and so has 
+ * its own listening socket and cache.
+ * May use the global variable prog_name.
+ * @param srv The server with port, index, doc_root and the cache settings 
+ * set.
+ * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ */
+static int serve(struct server *srv)
+{
+    srv->cache = gzcache_create(srv->cache_budget, srv->cache_mirror);
+    if (srv->cache == NULL)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to create the gzip cache: %s\n",
+                prog_name, strerror(errno));
+        return EXIT_FAILURE;
+    }
+
+    srv->ring = NULL;
+    if (srv->use_uring)
+    {
+        srv->ring = create_uring();
+        if (srv->ring == NULL)
+        {
+            fprintf(stderr, "[%s] WARNING: io_uring is not available (%s), using epoll\n",
+                    prog_name, strerror(errno));
+        }
+    }
+    if (srv->ring != NULL && srv->h2)
+    {
+        fprintf(stderr, "[%s] WARNING: HTTP/2 is only offered with epoll\n",
+                prog_name);
+        srv->h2 = false;
+    }
+
+    srv->io = NULL;
+    if (srv->disk_threads > 0)
+    {
+        srv->io = fileio_create(srv->disk_threads);
+        if (srv->io == NULL)
+        {
+            fprintf(stderr, "[%s] ERROR: Unable to start the disk threads: %s\n",
+                    prog_name, strerror(errno));
+            goto free_io;
+        }
+    }
+
+    // Create the socket
+    srv->sockfd = create_socket(srv->port, srv->reuse_port);
+    if (srv->sockfd == -1)
+    {
+        goto free_io;
+    }
+
+    // io_uring fails operations on non-blocking files instead of waiting
+    if (srv->ring == NULL && fcntl(srv->sockfd, F_SETFL, O_NONBLOCK) == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to make the socket non-blocking: %s\n",
+                prog_name, strerror(errno));
+        close(srv->sockfd);
+        goto free_io;
+    }
+
+    // Create the event loop
+    srv->epollfd = srv->ring == NULL ? epoll_create1(0) : -1;
+    if (srv->ring == NULL && srv->epollfd == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to create epoll instance: %s\n",
+                prog_name, strerror(errno));
+        close(srv->sockfd);
+        goto free_io;
+    }
+
+    // Serve connections until a signal arrives
+    srv->connections = NULL;
+    int ret = srv->ring != NULL ? run_uring(srv) : run_server(srv);
+
+    // free resources, the ring first as it cancels everything in flight
+    if (srv->ring != NULL)
+    {
+        uring_destroy(srv->ring);
+        srv->ring = NULL;
+    }
+    while (srv->connections != NULL)
+    {
+        destroy_connection(srv, srv->connections);
+    }
+    if (srv->io != NULL)
+    {
+        fileio_destroy(srv->io, free_file_job);
+    }
+    gzcache_destroy(srv->cache);
+    if (srv->epollfd != -1)
+    {
+        close(srv->epollfd);
+    }
+    close(srv->sockfd);
+    return ret;
+
+free_io:
+    if (srv->io != NULL)
+    {
+        fileio_destroy(srv->io, free_file_job);
+    }
+    if (srv->ring != NULL)
+    {
+        uring_destroy(srv->ring);
+    }
+    gzcache_destroy(srv->cache);
+    return EXIT_FAILURE;
+}
+
+/**
+ * Start a worker.
+ * @brief Fork a worker process that serves until it gets SIGTERM.
+ * @details May use the global variable prog_name.
+ * @param srv The server configuration for the worker.
+ * @return The pid of the worker, or -1 on error.
+ */
+static pid_t start_worker(struct server *srv)
+{
+    pid_t pid = fork();
+    if (pid == -1)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to fork a worker: %s\n",
+                prog_name, strerror(errno));
+        return -1;
+    }
+    if (pid == 0)
+    {
+        exit(serve(srv));
+    }
+    return pid;
+}
+
+/**
+ * Run the workers.
+ * @brief Pre-fork the workers and supervise them until the server is shut 
+ * down.
+ * @details Every worker binds its own SO_REUSEPORT socket. A worker that 
+ * exits or crashes while the server is alive is restarted, unless it failed
+ * right after being started, which means it cannot start at all (e.g. the 
+ * port is in use). On shutdown SIGTERM is forwarded to all workers and the supervisor 
+ * waits for them to drain.
+ * Reads the global variable alive.
+ * May use the global variable prog_name.
+ * @param srv The server configuration for the workers.
+ * @param workers The number of workers.
+ * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ */
+static int run_workers(struct server *srv, int workers)
+{
+    pid_t pids[workers];
+    time_t started[workers];
+    int ret = EXIT_SUCCESS;
+    for (int i = 0; i < workers; i++)
+    {
+        pids[i] = start_worker(srv);
+        started[i] = time(NULL);
+        if (pids[i] == -1)
+        {
+            alive = false;
+            ret = EXIT_FAILURE;
+            break;
+        }
+    }
+
+    while (alive)
+    {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            break;
+        }
+
+        for (int i = 0; i < workers; i++)
+        {
+            if (pids[i] != pid)
+            {
+                continue;
+            }
+            pids[i] = -1;
+            if (!alive)
+            {
+                break;
+            }
+            if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS &&
+                time(NULL) - started[i] < 1)
+            {
+                fprintf(stderr, "[%s] ERROR: Worker %d failed to start\n",
+                        prog_name, pid);
+                alive = false;
+                ret = EXIT_FAILURE;
+                break;
+            }
+            fprintf(stderr, "[%s] WARNING: Worker %d exited (status %d), restarting\n",
+                    prog_name, pid, status);
+            pids[i] = start_worker(srv);
+            started[i] = time(NULL);
+        }
+    }
+
+    // Forward the shutdown to the workers and wait for them to drain
+    for (int i = 0; i < workers; i++)
+    {
+        if (pids[i] > 0)
+        {
+            kill(pids[i], SIGTERM);
+        }
+    }
+    while (wait(NULL) != -1 || errno == EINTR)
+    {
+    }
+    return ret;
+}
+
+/**
+ * The entrypoint of the server.
+ * @brief Execution of the server starts and always ends here.
+ * @details Uses the global variable prog_name.
+ * @param argc The argument counter.
+ * @param argv The argument vector.
+ * @return Returns EXIT_SUCCESS upon success, otherwiese EXIT_FAILURE.
+ */
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+
+    // Setup the singal handler
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
     sa.sa_handler = handle_signal;
     sigaction(SIGINT, &sa, NULL);
     sigaction(SIGTERM, &sa, NULL);
@@ -465,8 +4812,14 @@ int main(int argc, char *argv[])
     // Parse arguments
     char *port = NULL;
     char *index = NULL;
+    char *budget_text = NULL;
+    char *workers_text = NULL;
+    char *threads_text = NULL;
+    bool mirror = false;
+    bool use_uring = false;
+    bool h2 = false;
     int c;
-    while ((c = getopt(argc, argv, "p:i:")) != -1)
+    while ((c = getopt(argc, argv, "p:i:c:gt:u2w:")) != -1)
     {
         switch (c)
         {
@@ -486,6 +4839,39 @@ int main(int argc, char *argv[])
             }
             index = optarg;
             break;
+        case 'c':
+            if (budget_text != NULL)
+            {
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            budget_text = optarg;
+            break;
+        case 'g':
+            mirror = true;
+            break;
+        case 't':
+            if (threads_text != NULL)
+            {
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            threads_text = optarg;
+            break;
+        case 'u':
+            use_uring = true;
+            break;
+        case '2':
+            h2 = true;
+            break;
+        case 'w':
+            if (workers_text != NULL)
+            {
+                usage();
+                exit(EXIT_FAILURE);
+            }
+            workers_text = optarg;
+            break;
         default:
             assert(false);
             break;
@@ -509,43 +4895,58 @@ int main(int argc, char *argv[])
     {
         index = "index.html";
     }
-
-    // Create the socket
-    int sockfd = create_socket(port);
-    if (sockfd == -1)
+    size_t budget = DEFAULT_CACHE_BUDGET;
+    if (budget_text != NULL)
     {
-        exit(EXIT_FAILURE);
+        char *endptr;
+        errno = 0;
+        budget = strtoull(budget_text, &endptr, 10);
+        if (errno != 0 || *endptr != '\0' || endptr == budget_text)
+        {
+            usage();
+            exit(EXIT_FAILURE);
+        }
     }
-
-    // Wait for connections
-    int ret = EXIT_SUCCESS;
-    while (alive)
+    long workers = 1;
+    if (workers_text != NULL)
     {
-        // Wait for a request and receive that socket
-        int connfd = accept(sockfd, NULL, NULL);
-        if (connfd == -1)
+        char *endptr;
+        workers = strtol(workers_text, &endptr, 10);
+        if (*endptr != '\0' || endptr == workers_text || workers < 1 ||
+            workers > 1024)
         {
-            if (errno != EINTR)
-            {
-                fprintf(stderr, "[%s] ERROR: Unable to connect: %s\n",
-                        prog_name, strerror(errno));
-                ret = EXIT_FAILURE;
-            }
-
-            alive = false;
-            break;
+            usage();
+            exit(EXIT_FAILURE);
         }
+    }
 
-        // Handle the request
-        int err = handle_request(connfd, index, doc_root);
-        if (err == -1)
+    long disk_threads = DEFAULT_DISK_THREADS;
+    if (threads_text != NULL)
+    {
+        char *endptr;
+        disk_threads = strtol(threads_text, &endptr, 10);
+        if (*endptr != '\0' || endptr == threads_text || disk_threads < 0 ||
+            disk_threads > 1024)
         {
-            alive = false;
-            ret = EXIT_FAILURE;
+            usage();
+            exit(EXIT_FAILURE);
         }
     }
 
-    // free resources
-    close(sockfd);
-    return ret;
+    struct server srv = {
+        .port = port,
+        .reuse_port = workers > 1,
+        .index = index,
+        .doc_root = doc_root,
+        .cache_budget = budget,
+        .cache_mirror = mirror,
+        .disk_threads = disk_threads,
+        .use_uring = use_uring,
+        .h2 = h2,
+    };
+    if (workers == 1)
+    {
+        return serve(&srv);
+    }
+    return run_workers(&srv, workers);
 }
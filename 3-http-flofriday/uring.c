@@ -0,0 +1,257 @@
+/**
+ * @file uring.c
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Implementation of the uring module.
+ **/
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "uring.h"
+
+/**
+ * Load a value written by the kernel.
+ * @brief Reads with acquire semantics, so everything the kernel wrote before
+ * is visible.
+ */
+static unsigned load_acquire(const unsigned *p)
+{
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+/**
+ * Store a value read by the kernel.
+ * @brief Writes with release semantics, so everything written before is
+ * visible to the kernel.
+ */
+static void store_release(unsigned *p, unsigned value)
+{
+    __atomic_store_n(p, value, __ATOMIC_RELEASE);
+}
+
+/**
+ * Map a part of the ring.
+ * @return The mapping, or MAP_FAILED.
+ */
+static void *map_ring(int fd, size_t size, off_t offset)
+{
+    return mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                fd, offset);
+}
+
+struct uring *uring_create(unsigned entries)
+{
+    struct uring *ring = calloc(1, sizeof(struct uring));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->sq_ring = MAP_FAILED;
+    ring->cq_ring = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+
+    ring->fd = syscall(__NR_io_uring_setup, entries, &ring->params);
+    if (ring->fd == -1)
+    {
+        int err = errno;
+        free(ring);
+        errno = err;
+        return NULL;
+    }
+
+    struct io_uring_params *p = &ring->params;
+    ring->sq_ring_size = p->sq_off.array + p->sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p->cq_off.cqes + p->cq_entries * sizeof(struct io_uring_cqe);
+    if (p->features & IORING_FEAT_SINGLE_MMAP)
+    {
+        // Both rings share one mapping
+        if (ring->cq_ring_size > ring->sq_ring_size)
+        {
+            ring->sq_ring_size = ring->cq_ring_size;
+        }
+        ring->sq_ring = map_ring(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = ring->sq_ring;
+    }
+    else
+    {
+        ring->sq_ring = map_ring(ring->fd, ring->sq_ring_size, IORING_OFF_SQ_RING);
+        ring->cq_ring = map_ring(ring->fd, ring->cq_ring_size, IORING_OFF_CQ_RING);
+    }
+    ring->sqes_size = p->sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = map_ring(ring->fd, ring->sqes_size, IORING_OFF_SQES);
+    if (ring->sq_ring == MAP_FAILED || ring->cq_ring == MAP_FAILED ||
+        ring->sqes == MAP_FAILED)
+    {
+        int err = errno;
+        uring_destroy(ring);
+        errno = err;
+        return NULL;
+    }
+
+    uint8_t *sq = ring->sq_ring;
+    ring->sq_head = (unsigned *)(sq + p->sq_off.head);
+    ring->sq_tail = (unsigned *)(sq + p->sq_off.tail);
+    ring->sq_mask = *(unsigned *)(sq + p->sq_off.ring_mask);
+    ring->sq_array = (unsigned *)(sq + p->sq_off.array);
+    ring->sq_local_tail = *ring->sq_tail;
+
+    // Entry i of the array always points to sqe i
+    for (unsigned i = 0; i < p->sq_entries; i++)
+    {
+        ring->sq_array[i] = i;
+    }
+
+    uint8_t *cq = ring->cq_ring;
+    ring->cq_head = (unsigned *)(cq + p->cq_off.head);
+    ring->cq_tail = (unsigned *)(cq + p->cq_off.tail);
+    ring->cq_mask = *(unsigned *)(cq + p->cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe *)(cq + p->cq_off.cqes);
+    return ring;
+}
+
+void uring_destroy(struct uring *ring)
+{
+    if (ring->buf_ring != NULL)
+    {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+        free(ring->buffers);
+    }
+    if (ring->sqes != MAP_FAILED)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->cq_ring != MAP_FAILED && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (ring->sq_ring != MAP_FAILED)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+int uring_buffers(struct uring *ring, uint16_t group, unsigned count,
+                  size_t size)
+{
+    size_t ring_size = count * sizeof(struct io_uring_buf);
+    struct io_uring_buf_ring *buf_ring = mmap(NULL, ring_size,
+                                              PROT_READ | PROT_WRITE,
+                                              MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf_ring == MAP_FAILED)
+    {
+        return -1;
+    }
+    uint8_t *buffers = malloc(count * size);
+    if (buffers == NULL)
+    {
+        munmap(buf_ring, ring_size);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uintptr_t)buf_ring;
+    reg.ring_entries = count;
+    reg.bgid = group;
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PBUF_RING,
+                &reg, 1) == -1)
+    {
+        int err = errno;
+        munmap(buf_ring, ring_size);
+        free(buffers);
+        errno = err;
+        return -1;
+    }
+
+    ring->buf_ring = buf_ring;
+    ring->buf_ring_size = ring_size;
+    ring->buffers = buffers;
+    ring->buf_count = count;
+    ring->buf_size = size;
+    for (unsigned i = 0; i < count; i++)
+    {
+        uring_recycle(ring, i);
+    }
+    return 0;
+}
+
+uint8_t *uring_buffer(struct uring *ring, uint16_t id)
+{
+    return ring->buffers + (size_t)id * ring->buf_size;
+}
+
+void uring_recycle(struct uring *ring, uint16_t id)
+{
+    // The tail overlays a field of the first buffer, so only this side
+    // writes it
+    uint16_t tail = ring->buf_ring->tail;
+    struct io_uring_buf *buf = &ring->buf_ring->bufs[tail & (ring->buf_count - 1)];
+    buf->addr = (uintptr_t)uring_buffer(ring, id);
+    buf->len = ring->buf_size;
+    buf->bid = id;
+    __atomic_store_n(&ring->buf_ring->tail, (uint16_t)(tail + 1), __ATOMIC_RELEASE);
+}
+
+/**
+ * Enter the kernel.
+ * @brief Submit all queued entries and optionally wait for completions.
+ * @param ring The ring to submit to.
+ * @param wait The number of completions to wait for.
+ * @return Upon success 0, otherwise -1.
+ */
+static int enter(struct uring *ring, unsigned wait)
+{
+    store_release(ring->sq_tail, ring->sq_local_tail);
+    unsigned pending = ring->sq_local_tail - load_acquire(ring->sq_head);
+    if (syscall(__NR_io_uring_enter, ring->fd, pending, wait,
+                wait > 0 ? IORING_ENTER_GETEVENTS : 0, NULL, 0) == -1)
+    {
+        return -1;
+    }
+    return 0;
+}
+
+struct io_uring_sqe *uring_sqe(struct uring *ring)
+{
+    if (ring->sq_local_tail - load_acquire(ring->sq_head) ==
+            ring->params.sq_entries &&
+        (enter(ring, 0) == -1 ||
+         ring->sq_local_tail - load_acquire(ring->sq_head) ==
+             ring->params.sq_entries))
+    {
+        return NULL;
+    }
+
+    struct io_uring_sqe *sqe = &ring->sqes[ring->sq_local_tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_local_tail++;
+    return sqe;
+}
+
+int uring_wait(struct uring *ring)
+{
+    return enter(ring, 1);
+}
+
+struct io_uring_cqe *uring_cqe(struct uring *ring)
+{
+    unsigned head = *ring->cq_head;
+    if (head == load_acquire(ring->cq_tail))
+    {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+void uring_cqe_seen(struct uring *ring)
+{
+    store_release(ring->cq_head, *ring->cq_head + 1);
+}
@@ -0,0 +1,136 @@
+/**
+ * @file uring.h
+ * @author flofriday <eXXXXXXXX@student.tuwien.ac.at>
+ * @date 19.12.2020
+ *
+ * @brief Provides a minimal io_uring interface.
+ *
+ * The uring module. It maps the submission and completion queues of an
+ * io_uring instance and talks to the kernel with the raw system calls, so the
+ * server doesn't depend on liburing. Optionally a ring of provided buffers is
+ * registered, from which the kernel picks a buffer for every read with
+ * IOSQE_BUFFER_SELECT.
+ **/
+
+#ifndef URING_H
+#define URING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <linux/io_uring.h>
+
+/**
+ * Structure of the ring
+ * @brief The mapped queues of an io_uring instance and its provided buffers.
+ */
+struct uring
+{
+    int fd;
+    struct io_uring_params params;
+
+    void *sq_ring;
+    size_t sq_ring_size;
+    unsigned *sq_head;
+    unsigned *sq_tail;
+    unsigned *sq_array;
+    unsigned sq_mask;
+    struct io_uring_sqe *sqes;
+    size_t sqes_size;
+    unsigned sq_local_tail;
+
+    void *cq_ring;
+    size_t cq_ring_size;
+    unsigned *cq_head;
+    unsigned *cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe *cqes;
+
+    struct io_uring_buf_ring *buf_ring;
+    size_t buf_ring_size;
+    uint8_t *buffers;
+    unsigned buf_count;
+    size_t buf_size;
+};
+
+/**
+ * Create a ring.
+ * @brief Set up an io_uring instance and map its queues.
+ * @details The caller must call uring_destroy to free the ring.
+ * @param entries The number of submission queue entries.
+ * @return Upon success a pointer to the ring, otherwise NULL (errno is set,
+ * ENOSYS or EPERM if io_uring is not available).
+ */
+struct uring *uring_create(unsigned entries);
+
+/**
+ * Destroy a ring.
+ * @brief Unmap the queues and the provided buffers and close the ring.
+ * @details Requests still in flight are cancelled by the kernel.
+ * @param ring The ring to destroy.
+ */
+void uring_destroy(struct uring *ring);
+
+/**
+ * Register provided buffers.
+ * @brief Allocate count buffers of size bytes and register them as a ring
+ * of provided buffers, with the buffer ids 0 to count - 1.
+ * @param ring The ring that gets the buffers.
+ * @param group The buffer group id, used as buf_group of reads.
+ * @param count The number of buffers, a power of two.
+ * @param size The size of every buffer.
+ * @return Upon success 0, otherwise -1 (errno is set, EINVAL if the kernel
+ * doesn't support buffer rings).
+ */
+int uring_buffers(struct uring *ring, uint16_t group, unsigned count,
+                  size_t size);
+
+/**
+ * Get a provided buffer.
+ * @param ring The ring of the buffer.
+ * @param id The buffer id of a completion with IORING_CQE_F_BUFFER.
+ * @return The start of the buffer.
+ */
+uint8_t *uring_buffer(struct uring *ring, uint16_t id);
+
+/**
+ * Return a provided buffer.
+ * @brief Give a buffer back to the kernel after its data was consumed.
+ * @param ring The ring of the buffer.
+ * @param id The buffer id.
+ */
+void uring_recycle(struct uring *ring, uint16_t id);
+
+/**
+ * Get a submission queue entry.
+ * @brief Get the next free entry, cleared, to be filled by the caller.
+ * @details If the queue is full the queued entries are submitted first.
+ * Entries are submitted with the next uring_wait.
+ * @param ring The ring to submit to.
+ * @return The entry, or NULL if the queue is full and can't be submitted.
+ */
+struct io_uring_sqe *uring_sqe(struct uring *ring);
+
+/**
+ * Submit and wait.
+ * @brief Submit all queued entries and wait for at least one completion.
+ * @param ring The ring to submit to.
+ * @return Upon success 0, otherwise -1 (errno is set, EINTR if a signal
+ * arrived).
+ */
+int uring_wait(struct uring *ring);
+
+/**
+ * Peek at a completion.
+ * @param ring The ring to look at.
+ * @return The oldest completion that was not marked as seen, or NULL.
+ */
+struct io_uring_cqe *uring_cqe(struct uring *ring);
+
+/**
+ * Mark a completion as seen.
+ * @brief Free the completion returned by uring_cqe for the kernel.
+ * @param ring The ring of the completion.
+ */
+void uring_cqe_seen(struct uring *ring);
+
+#endif
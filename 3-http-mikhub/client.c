@@ -8,11 +8,16 @@ static FILE* open_output_file(client_arg_t arg);
 static void connect_to_address(http_request_t req);
 static void send_request(http_request_t req);
 static http_status_t get_response_header(void);
+static char* get_header_value(char* line, char* name);
 static void get_and_write_response_body(void);
+static long long copy_stream(FILE* from, FILE* to, FILE* copy);
+static void open_cache(char* dir, char* url);
+static void start_cache_update(void);
+static void finish_cache_update(long long received);
 static void cleanup(void);
 
 char* PROGRAM_NAME;
-char* USAGE_MESSAGE = "Usage: %s [-p PORT] [ -o FILE | -d DIR ] URL\n";
+char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-c CACHE_DIR] [ -o FILE | -d DIR ] URL\n";
 
 /**
  * @file client.c
@@ -23,6 +28,9 @@ char* USAGE_MESSAGE = "Usage: %s [-p PORT] [ -o FILE | -d DIR ] URL\n";
  * The client takes an URL as input, connects to the corresponding server 
  * and requests the file specified in the URL. The transmitted content of 
  * that file is written to stdout or to a file.
+ * With -c the response is kept in a cache directory together with its validators
+ * (ETag, Last-Modified), the next request for the same URL is conditional and on
+ * 304 Not Modified the cached copy is written instead.
  */
 
 // The following variables are global because they are relevant in the whole context of
@@ -40,6 +48,9 @@ static http_request_t req;
 /** Struct containing status code of HTTP response */
 static http_response_t res;
 
+/** Struct containing the cached copy of the requested URL */
+static cache_t cache;
+
 /**
  * @brief Main function handling the program flow
  * @details Uses the global variables out, req, res, conn
@@ -61,11 +72,16 @@ int main(int argc, char** argv) {
     if (res.status.code == -1) {
         fprintf(stderr, "%s\n", PROTOCOL_ERROR);
         exit(EXIT_PROTOCOL_ERROR);
-    } else if (res.status.code != 200) {
+    } else if (res.status.code == HTTP_NOT_MODIFIED && cache.file != NULL) {
+        // the cached copy is still up to date
+        copy_stream(cache.file, out, NULL);
+        exit(EXIT_SUCCESS);
+    } else if (res.status.code != HTTP_OK) {
         fprintf(stderr, "%ld %s\n", res.status.code, res.status.detail);
         exit(EXIT_STATUS_ERROR);
     }
 
+    start_cache_update();
     get_and_write_response_body();
 
     // cleanup is done via exit-function
@@ -83,6 +99,10 @@ static void initialize(void) {
     conn.ai = NULL;
     conn.socket_file = NULL;
     res.status.detail = NULL;
+    res.etag = NULL;
+    res.last_modified = NULL;
+    res.content_length = -1;
+    memset(&cache, 0, sizeof(cache));
 
     // register exit function
     if(atexit(cleanup) < 0) {
@@ -97,12 +117,12 @@ static void initialize(void) {
  * if the usage of the program is violated
  */ 
 static client_arg_t parse_arguments(int argc, char** argv){
-    client_arg_t args = {.dir = NULL, .file = NULL, .port = NULL};
+    client_arg_t args = {.dir = NULL, .file = NULL, .port = NULL, .cache = NULL};
 
     // parse options
-    int count_p = 0, count_o = 0, count_d = 0;
+    int count_p = 0, count_o = 0, count_d = 0, count_c = 0;
     int c;  
-    while((c = getopt(argc, argv, "p:o:d:")) != -1 ) {
+    while((c = getopt(argc, argv, "p:o:d:c:")) != -1 ) {
         switch (c) {
             case 'p':
                 args.port = optarg;
@@ -119,6 +139,11 @@ static client_arg_t parse_arguments(int argc, char** argv){
                 count_d++;
                 break;
 
+            case 'c':
+                args.cache = optarg;
+                count_c++;
+                break;
+
             case '?':
                 USAGE();
                 break;
@@ -130,13 +155,18 @@ static client_arg_t parse_arguments(int argc, char** argv){
     }
 
     // wrong usage
-    if (count_p > 1 || count_o > 1 || count_d > 1 || (count_o > 0 && count_d > 0)) {
+    if (count_p > 1 || count_o > 1 || count_d > 1 || count_c > 1 || (count_o > 0 && count_d > 0)) {
         USAGE();
     }
     if (argc == optind || argc > (optind+1)) {
         USAGE();
     }
 
+    // the cache is keyed by the whole URL, which is split up by parse_url
+    if (args.cache != NULL) {
+        open_cache(args.cache, argv[optind]);
+    }
+
     // parse requested URL from args
     req = parse_url(argv[optind]);
     if (req.filename == NULL) {
@@ -254,10 +284,20 @@ static void connect_to_address(http_request_t req) {
 
 /** 
  * @brief Sends the request given in the argument to the connected socket
- * @details Uses the global variable conn
+ * @details If there is a cached copy, its validators are sent, so the server can answer
+ * with 304 Not Modified. Uses the global variables conn and cache
  */
 static void send_request(http_request_t req) {
-    if(fprintf(conn.socket_file, "GET /%s HTTP/1.1\r\nHost: %s\r\nConnection:close\r\n\r\n", req.dirpath, req.host) < 0) {
+    if(fprintf(conn.socket_file, "GET /%s HTTP/1.1\r\nHost: %s\r\n", req.dirpath, req.host) < 0) {
+        ERROR_EXIT("Error while writing request", strerror(errno));
+    }
+    if (cache.etag != NULL && fprintf(conn.socket_file, "If-None-Match: %s\r\n", cache.etag) < 0) {
+        ERROR_EXIT("Error while writing request", strerror(errno));
+    }
+    if (cache.last_modified != NULL && fprintf(conn.socket_file, "If-Modified-Since: %s\r\n", cache.last_modified) < 0) {
+        ERROR_EXIT("Error while writing request", strerror(errno));
+    }
+    if(fprintf(conn.socket_file, "Connection:close\r\n\r\n") < 0) {
         ERROR_EXIT("Error while writing request", strerror(errno));
     }
     if(fflush(conn.socket_file) == EOF) {
@@ -268,7 +308,8 @@ static void send_request(http_request_t req) {
 /**
  * @brief Reads and parses the response from the connected socket and returns the 
  * status code (if present)
- * @details Uses the global variable conn
+ * @details The validators and the content length are stored in the global variable res.
+ * Uses the global variables conn and res
  */
 static http_status_t get_response_header(void) {
     http_status_t status = { .code = 0, .detail = NULL };
@@ -303,24 +344,178 @@ static http_status_t get_response_header(void) {
     strncpy(status.detail, endptr+1, detail_length-1);
     status.detail[detail_length-1] = '\0';
 
-    // skip rest of header
+    // read rest of header, only the validators and the length are of interest
     while ((len = getline(&line, &buflen, conn.socket_file)) != -1) {
         if (strcmp(line, "\r\n") == 0) break;
+
+        char* value;
+        if (res.etag == NULL && (value = get_header_value(line, "ETag")) != NULL) {
+            res.etag = value;
+        } else if (res.last_modified == NULL && (value = get_header_value(line, "Last-Modified")) != NULL) {
+            res.last_modified = value;
+        } else if ((value = get_header_value(line, "Content-Length")) != NULL) {
+            res.content_length = strtoll(value, NULL, 10);
+            free(value);
+        }
     }
     free(line);
 
     return status;
 }
 
+/**
+ * @brief Returns a copy of the value of the header line (without surrounding whitespace) if the
+ * field is called name (case insensitive), otherwise NULL
+ * @details The returned value has to be freed
+ */
+static char* get_header_value(char* line, char* name) {
+    size_t name_len = strlen(name);
+    if (strncasecmp(line, name, name_len) != 0 || line[name_len] != ':') {
+        return NULL;
+    }
+
+    char* value = &(line[name_len+1]);
+    while (*value == ' ' || *value == '\t') value++;
+    size_t value_len = strlen(value);
+    while (value_len > 0 && isspace((unsigned char) value[value_len-1])) value_len--;
+
+    char* copy = strndup(value, value_len);
+    if (copy == NULL) {
+        ERROR_EXIT("Error allocating header value", strerror(errno));
+    }
+    return copy;
+}
+
 /**
  * @brief Reads the response body from the connected socket and writes it to the outfile
- * @details Uses the global variables conn and out
+ * @details If the response is cached, the body is written to the new copy as well.
+ * Uses the global variables conn, out and cache
  */ 
 static void get_and_write_response_body(void) {
-    // read response and write to out-file
-    char buf[1];
-    while (fread(buf, 1, 1, conn.socket_file) == 1) {
-        fwrite(buf, 1, 1, out);
+    long long received = copy_stream(conn.socket_file, out, cache.tmp_file);
+    finish_cache_update(received);
+}
+
+/**
+ * @brief Copies everything from the stream from to the stream to and (if not NULL) to copy,
+ * and returns the number of bytes copied
+ * @details Terminates the program if reading or writing fails
+ */
+static long long copy_stream(FILE* from, FILE* to, FILE* copy) {
+    char buf[BODY_BUFFER_SIZE];
+    long long copied = 0;
+    size_t n;
+    while ((n = fread(buf, 1, sizeof(buf), from)) > 0) {
+        if (fwrite(buf, 1, n, to) != n) {
+            ERROR_EXIT("Error writing response body", strerror(errno));
+        }
+        if (copy != NULL && fwrite(buf, 1, n, copy) != n) {
+            ERROR_EXIT("Error writing cache file", strerror(errno));
+        }
+        copied += n;
+    }
+    if (ferror(from)) {
+        ERROR_EXIT("Error reading response body", strerror(errno));
+    }
+    return copied;
+}
+
+/**
+ * @brief Opens the cached copy of url in the cache directory dir, if there is one
+ * @details The name of the cache file is the FNV-1a hash of the URL. A cache file of another
+ * URL with the same hash is treated as if there was no copy, and replaced after the request.
+ * Uses and fills the global variable cache
+ */
+static void open_cache(char* dir, char* url) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (char* c = url; *c != '\0'; c++) {
+        hash = (hash ^ (unsigned char) *c) * 1099511628211ULL;
+    }
+
+    // room for '/', 16 hex digits and ".tmp." with a pid
+    size_t path_len = strlen(dir) + 48;
+    cache.path = malloc(path_len);
+    cache.tmp_path = malloc(path_len);
+    if (cache.path == NULL || cache.tmp_path == NULL) {
+        ERROR_EXIT("Error allocating cache path", strerror(errno));
+    }
+    snprintf(cache.path, path_len, "%s/%016llx", dir, (unsigned long long) hash);
+    snprintf(cache.tmp_path, path_len, "%s.tmp.%ld", cache.path, (long) getpid());
+    cache.url = strdup(url);
+    if (cache.url == NULL) {
+        ERROR_EXIT("Error allocating cache path", strerror(errno));
+    }
+
+    cache.file = fopen(cache.path, "r");
+    if (cache.file == NULL) {
+        return;
+    }
+
+    // the first line has to be the URL, then the validators follow up to the empty line
+    char* line = NULL;
+    size_t buflen;
+    ssize_t len = getline(&line, &buflen, cache.file);
+    bool valid = len > 0 && line[len-1] == '\n' && strlen(url) == (size_t) len-1 && strncmp(line, url, len-1) == 0;
+    while (valid && (len = getline(&line, &buflen, cache.file)) > 0 && strcmp(line, "\n") != 0) {
+        char* value;
+        if ((value = get_header_value(line, "ETag")) != NULL) {
+            free(cache.etag);
+            cache.etag = value;
+        } else if ((value = get_header_value(line, "Last-Modified")) != NULL) {
+            free(cache.last_modified);
+            cache.last_modified = value;
+        }
+    }
+    free(line);
+
+    if (!valid || len <= 0) {
+        // no complete copy of this URL, so no conditional request
+        fclose(cache.file);
+        cache.file = NULL;
+        free(cache.etag);
+        free(cache.last_modified);
+        cache.etag = NULL;
+        cache.last_modified = NULL;
+    }
+}
+
+/**
+ * @brief Starts writing a new copy of the response, if the response can be validated later on
+ * @details The URL and the validators are written to a temporary file, the body is added while
+ * it is received. Failing to cache is not an error, the response is written to the outfile anyway.
+ * Uses the global variables cache and res
+ */
+static void start_cache_update(void) {
+    if (cache.path == NULL || (res.etag == NULL && res.last_modified == NULL)) {
+        return;
+    }
+
+    cache.tmp_file = fopen(cache.tmp_path, "w");
+    if (cache.tmp_file == NULL) {
+        ERROR_MSG("Could not create cache file", strerror(errno));
+        return;
+    }
+    fprintf(cache.tmp_file, "%s\n", cache.url);
+    if (res.etag != NULL) fprintf(cache.tmp_file, "ETag: %s\n", res.etag);
+    if (res.last_modified != NULL) fprintf(cache.tmp_file, "Last-Modified: %s\n", res.last_modified);
+    fprintf(cache.tmp_file, "\n");
+}
+
+/**
+ * @brief Replaces the cache file with the new copy if the whole body was received
+ * @details Uses the global variables cache and res
+ */
+static void finish_cache_update(long long received) {
+    if (cache.tmp_file == NULL) {
+        return;
+    }
+
+    bool complete = res.content_length < 0 || received == res.content_length;
+    bool written = fclose(cache.tmp_file) == 0;
+    cache.tmp_file = NULL;
+    if (!complete || !written || rename(cache.tmp_path, cache.path) < 0) {
+        ERROR_MSG("Could not update cache file", written ? NULL : strerror(errno));
+        unlink(cache.tmp_path);
     }
 }
 
@@ -333,4 +528,18 @@ static void cleanup(void) {
     if (conn.socket_file != NULL) fclose(conn.socket_file);
     if (conn.ai != NULL) freeaddrinfo(conn.ai);
     if (res.status.detail != NULL) free(res.status.detail); 
+    free(res.etag);
+    free(res.last_modified);
+
+    // an incomplete copy must not replace the cache file
+    if (cache.tmp_file != NULL) {
+        fclose(cache.tmp_file);
+        unlink(cache.tmp_path);
+    }
+    if (cache.file != NULL) fclose(cache.file);
+    free(cache.url);
+    free(cache.path);
+    free(cache.tmp_path);
+    free(cache.etag);
+    free(cache.last_modified);
 }
\ No newline at end of file
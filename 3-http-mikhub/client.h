@@ -3,6 +3,9 @@
 
 #include <stdio.h>
 #include <string.h>
+#include <strings.h>
+#include <stdint.h>
+#include <unistd.h>
 #include <stdbool.h>
 #include <getopt.h>
 #include <stdlib.h>
@@ -21,6 +24,10 @@
 
 #define URL_DELIM ";/?:@=&"
 #define HEADER_PROTOCOL "HTTP/1.1"
+#define BODY_BUFFER_SIZE 4096
+
+#define HTTP_OK 200
+#define HTTP_NOT_MODIFIED 304
 
 #define PROTOCOL_ERROR "Protocol error!"
 #define EXIT_PROTOCOL_ERROR 2
@@ -57,8 +64,33 @@ typedef struct {
 typedef struct {
     /** Status of HTTP response */
     http_status_t status;
+    /** Validators of the response body (NULL if not sent) */
+    char* etag;
+    char* last_modified;
+    /** Content length of the response body or -1 if not sent */
+    long long content_length;
 } http_response_t;
 
+/**
+ * @brief Represents the cached copy of the requested URL
+ * @details A cache file starts with the URL, followed by the validators as header lines and
+ * an empty line, the rest of the file is the body.
+ */
+typedef struct {
+    /** Copy of the requested URL, the key of the cache */
+    char* url;
+    /** Path of the cache file or NULL if no cache is used */
+    char* path;
+    /** Cache file positioned at the start of the body or NULL if there is no copy */
+    FILE* file;
+    /** Validators of the cached copy (NULL if unknown) */
+    char* etag;
+    char* last_modified;
+    /** Path and stream of the new copy, which replaces the cache file once it is complete */
+    char* tmp_path;
+    FILE* tmp_file;
+} cache_t;
+
 /**
  * @brief Represents a connection via a socket
  */
@@ -81,6 +113,8 @@ typedef struct {
     char* file; 
     /** Director where response should be stored in */
     char* dir;
+    /** Directory of the response cache */
+    char* cache;
  } client_arg_t;
 
 #endif
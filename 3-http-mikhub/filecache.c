@@ -0,0 +1,328 @@
+#include "filecache.h"
+
+/**
+ * @file filecache.c
+ * @author Michael Huber 11712763
+ * @date 15.01.2021
+ * @brief Implementation of the open file cache
+ * @details The entries are kept in a hash table and a doubly linked LRU list,
+ * the head of the list is the most recently used entry.
+ */
+
+#define WATCH_EVENTS (IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | \
+                      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF)
+
+/**
+ * @brief Represents a watched directory
+ */
+typedef struct {
+    /** Watch descriptor returned by inotify_add_watch */
+    int wd;
+    /** Path of the directory as it appears in the cached paths */
+    char* dir;
+} watch_t;
+
+static void handle_sigio(int signal);
+static size_t hash_path(char* path);
+static void remove_entry(file_cache_entry_t* entry);
+static void invalidate(char* prefix, size_t len);
+static void process_events(void);
+static int add_watch(char* dir, size_t len);
+static void clear_cache(void);
+static char* get_mime_type(char* path);
+
+/** Inotify descriptor */
+static int inotify_fd = -1;
+
+/** Number of cached entries */
+static size_t count;
+
+/** Head (most recently used) and tail of the LRU list */
+static file_cache_entry_t *head, *tail;
+
+/** Hash table of the entries */
+static file_cache_entry_t* buckets[FILE_CACHE_BUCKETS];
+
+/** Watched directories, the first one is the doc root */
+static watch_t watches[FILE_CACHE_WATCHES];
+static size_t watch_count;
+
+/** Pending-Flag - set by the SIGIO handler if inotify events can be read */
+static volatile sig_atomic_t events_pending;
+
+int file_cache_init(char* root) {
+    events_pending = false;
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd < 0) {
+        return -1;
+    }
+
+    // a changed file must not interrupt sending a response
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handle_sigio;
+    sa.sa_flags = SA_RESTART;
+
+    if (sigaction(SIGIO, &sa, NULL) < 0
+        || fcntl(inotify_fd, F_SETOWN, getpid()) < 0
+        || fcntl(inotify_fd, F_SETFL, O_NONBLOCK | O_ASYNC) < 0
+        || add_watch(root, strlen(root)) < 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+void file_cache_free(void) {
+    while (head != NULL) {
+        remove_entry(head);
+    }
+    for (size_t i = 0; i < watch_count; i++) {
+        free(watches[i].dir);
+    }
+    watch_count = 0;
+    if (inotify_fd >= 0) {
+        close(inotify_fd);
+        inotify_fd = -1;
+    }
+}
+
+file_cache_entry_t* file_cache_lookup(char* path) {
+    if (events_pending) {
+        process_events();
+    }
+
+    file_cache_entry_t* entry = buckets[hash_path(path)];
+    while (entry != NULL && strcmp(entry->path, path) != 0) {
+        entry = entry->bucket_next;
+    }
+
+    // hit - move entry to the head of the LRU list
+    if (entry != NULL && entry != head) {
+        entry->prev->next = entry->next;
+        if (entry->next != NULL) entry->next->prev = entry->prev;
+        else tail = entry->prev;
+        entry->prev = NULL;
+        entry->next = head;
+        head->prev = entry;
+        head = entry;
+    }
+    return entry;
+}
+
+file_cache_entry_t* file_cache_get(char* path, bool* hit) {
+    file_cache_entry_t* entry = file_cache_lookup(path);
+    if (hit != NULL) {
+        *hit = entry != NULL;
+    }
+    if (entry != NULL) {
+        return entry;
+    }
+
+    // miss - watch the directory before opening the file, so no change gets lost
+    char* slash = strrchr(path, '/');
+    if (slash != NULL && slash != path && add_watch(path, slash - path) < 0) {
+        return NULL;
+    }
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0) {
+        close(fd);
+        return NULL;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = EISDIR;
+        return NULL;
+    }
+
+    entry = malloc(sizeof(file_cache_entry_t));
+    if (entry == NULL || (entry->path = strdup(path)) == NULL) {
+        free(entry);
+        close(fd);
+        return NULL;
+    }
+    entry->fd = fd;
+    entry->size = st.st_size;
+    entry->mtime = st.st_mtim;
+    entry->mime_type = get_mime_type(entry->path);
+
+    if (count == FILE_CACHE_SIZE) {
+        remove_entry(tail);
+    }
+
+    size_t bucket = hash_path(path);
+    entry->bucket_next = buckets[bucket];
+    buckets[bucket] = entry;
+    entry->prev = NULL;
+    entry->next = head;
+    if (head != NULL) head->prev = entry;
+    else tail = entry;
+    head = entry;
+    count++;
+
+    return entry;
+}
+
+/**
+ * @brief Sets the pending-flag, so the inotify events are read before the next lookup.
+ */
+static void handle_sigio(int signal) {
+    events_pending = true;
+}
+
+/**
+ * @brief Computes the hash bucket of a path (djb2).
+ */
+static size_t hash_path(char* path) {
+    size_t hash = 5381;
+    while (*path != '\0') {
+        hash = hash * 33 + (unsigned char) *path++;
+    }
+    return hash % FILE_CACHE_BUCKETS;
+}
+
+/**
+ * @brief Unlinks the entry from the hash table and the LRU list, closes the file and frees the entry.
+ */
+static void remove_entry(file_cache_entry_t* entry) {
+    file_cache_entry_t** link = &buckets[hash_path(entry->path)];
+    while (*link != entry) {
+        link = &(*link)->bucket_next;
+    }
+    *link = entry->bucket_next;
+
+    if (entry->prev != NULL) entry->prev->next = entry->next;
+    else head = entry->next;
+    if (entry->next != NULL) entry->next->prev = entry->prev;
+    else tail = entry->prev;
+
+    count--;
+    close(entry->fd);
+    free(entry->path);
+    free(entry);
+}
+
+/**
+ * @brief Removes every entry whose path is prefix or lies inside the directory prefix.
+ */
+static void invalidate(char* prefix, size_t len) {
+    file_cache_entry_t* entry = head;
+    while (entry != NULL) {
+        file_cache_entry_t* next = entry->next;
+        if (strncmp(entry->path, prefix, len) == 0 && (entry->path[len] == '\0' || entry->path[len] == '/')) {
+            remove_entry(entry);
+        }
+        entry = next;
+    }
+}
+
+/**
+ * @brief Reads all pending inotify events and invalidates the affected entries.
+ * @details On a queue overflow the whole cache is cleared, as events were lost.
+ */
+static void process_events(void) {
+    // reset first, so that events arriving while reading are not lost
+    events_pending = false;
+
+    char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t len;
+    while ((len = read(inotify_fd, buf, sizeof(buf))) > 0) {
+        char* ptr = buf;
+        while (ptr < buf + len) {
+            struct inotify_event* event = (struct inotify_event*) ptr;
+            ptr += sizeof(struct inotify_event) + event->len;
+
+            if (event->mask & IN_Q_OVERFLOW) {
+                clear_cache();
+                continue;
+            }
+
+            // the same directory may be watched under different names
+            for (long i = 0; i < (long) watch_count; i++) {
+                if (watches[i].wd != event->wd) {
+                    continue;
+                }
+                if (event->len > 0) {
+                    char changed[strlen(watches[i].dir) + 1 + strlen(event->name) + 1];
+                    sprintf(changed, "%s/%s", watches[i].dir, event->name);
+                    invalidate(changed, strlen(changed));
+                } else {
+                    invalidate(watches[i].dir, strlen(watches[i].dir));
+                }
+                // directory is gone, forget about the watch
+                if (event->mask & IN_IGNORED) {
+                    free(watches[i].dir);
+                    watches[i--] = watches[--watch_count];
+                }
+            }
+        }
+    }
+}
+
+/**
+ * @brief Watches the directory given by the first len characters of dir, if not watched already.
+ * @details If all FILE_CACHE_WATCHES watches are used up, the cache is cleared first.
+ * @return 0 on success, -1 on failure
+ */
+static int add_watch(char* dir, size_t len) {
+    for (size_t i = 0; i < watch_count; i++) {
+        if (strlen(watches[i].dir) == len && strncmp(watches[i].dir, dir, len) == 0) {
+            return 0;
+        }
+    }
+    if (watch_count == FILE_CACHE_WATCHES) {
+        clear_cache();
+    }
+
+    char* copy = strndup(dir, len);
+    if (copy == NULL) {
+        return -1;
+    }
+    int wd = inotify_add_watch(inotify_fd, copy, WATCH_EVENTS);
+    if (wd < 0) {
+        free(copy);
+        return -1;
+    }
+    watches[watch_count].wd = wd;
+    watches[watch_count].dir = copy;
+    watch_count++;
+    return 0;
+}
+
+/**
+ * @brief Removes all entries and all watches except the one of the doc root.
+ */
+static void clear_cache(void) {
+    while (head != NULL) {
+        remove_entry(head);
+    }
+    while (watch_count > 1) {
+        watch_count--;
+        inotify_rm_watch(inotify_fd, watches[watch_count].wd);
+        free(watches[watch_count].dir);
+    }
+}
+
+/**
+ * @brief Gets the content type of a file depending on the file extension.
+ */
+static char* get_mime_type(char* path) {
+    char* extension = strrchr(path, '.');
+    if (extension == NULL) {
+        return NULL;
+    } else if (strcmp(extension, ".html") == 0 || strcmp(extension, ".htm") == 0) {
+        return "text/html";
+    } else if (strcmp(extension, ".css") == 0) {
+        return "text/css";
+    } else if (strcmp(extension, ".js") == 0) {
+        return "application/javascript";
+    } else {
+        return NULL;
+    }
+}
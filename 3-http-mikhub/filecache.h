@@ -0,0 +1,83 @@
+#ifndef _FILECACHE_H_
+#define _FILECACHE_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+
+/**
+ * @file filecache.h
+ * @author Michael Huber 11712763
+ * @date 15.01.2021
+ * @brief Cache of open files served out of the doc root
+ * @details Maps a resolved path to an open file descriptor together with the size,
+ * modification time and MIME type of the file, so that a hot file does not have to be
+ * opened and measured again for every request. At most FILE_CACHE_SIZE files are kept open,
+ * the least recently used one is closed first. Entries are invalidated with inotify watches
+ * on the doc root and every directory a cached file lives in. Because the inotify descriptor
+ * raises SIGIO, events are only read after something actually changed.
+ */
+
+#define FILE_CACHE_SIZE 128
+#define FILE_CACHE_BUCKETS 256
+#define FILE_CACHE_WATCHES 64
+
+/**
+ * @brief Represents a cached file
+ */
+typedef struct file_cache_entry {
+    /** Resolved path of the file */
+    char* path;
+    /** Open file descriptor, shared by all requests - only use it with explicit offsets */
+    int fd;
+    /** Size of the file in bytes */
+    size_t size;
+    /** Modification time of the file */
+    struct timespec mtime;
+    /** Content type of the file or NULL if unknown */
+    char* mime_type;
+    /** Neighbours in the LRU list */
+    struct file_cache_entry *prev, *next;
+    /** Next entry in the same hash bucket */
+    struct file_cache_entry *bucket_next;
+} file_cache_entry_t;
+
+/**
+ * @brief Sets up the cache and watches the doc root root.
+ * @details Installs a SIGIO handler, has to be called once in every serving process.
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int file_cache_init(char* root);
+
+/**
+ * @brief Closes all cached files and the inotify descriptor.
+ */
+void file_cache_free(void);
+
+/**
+ * @brief Returns the cache entry of the file at path without opening the file, NULL on a cache miss.
+ * @details Pending inotify events are processed first, so the size and modification time of the
+ * entry are up to date. The entry is valid until the next call of file_cache_lookup,
+ * file_cache_get or file_cache_free.
+ */
+file_cache_entry_t* file_cache_lookup(char* path);
+
+/**
+ * @brief Returns the cache entry of the file at path and opens the file on a cache miss.
+ * @details Pending inotify events are processed first. Only regular files are cached,
+ * for anything else NULL is returned with errno set to EISDIR. The entry is valid until
+ * the next call of file_cache_get or file_cache_free. If hit is not NULL, it is set to whether
+ * the file was found in the cache.
+ * @return The entry or NULL on failure (errno is set)
+ */
+file_cache_entry_t* file_cache_get(char* path, bool* hit);
+
+#endif
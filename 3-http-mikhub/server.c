@@ -4,19 +4,24 @@
 static server_arg_t parse_arguments(int argc, char** argv);
 static void set_signal_handler(void);
 static server_socket_t setup_server_socket(void);
+static void serve(void);
+static pid_t start_worker(long index);
+static int run_workers(void);
 static client_connection_t accept_next_connection(void);
 static void handle_connection(client_connection_t conn);
-static http_request_t get_request_header(client_connection_t conn);
+static http_request_t get_request_header(client_connection_t conn, struct httpparse_arena* arena);
 static http_response_t create_response_header(http_request_t req);
-static void send_response_header(client_connection_t conn, http_response_t res);
+static void set_validators(http_response_t* res, size_t size, struct timespec mtime);
+static bool is_not_modified(http_request_t req, http_response_t* res, struct timespec mtime);
+static bool parse_http_date(struct httpparse_span span, time_t* time);
+static bool send_response(client_connection_t conn, http_response_t res, size_t* sent);
+static bool send_all(int fd, char* buf, size_t len, int flags);
 static void handle_signal(int signal);
-static size_t get_file_size(FILE* file);
-static char* get_current_date_time(void);
-static char* get_mime_type(char* path);
+static const char* get_current_date_time(void);
 static void close_server_socket(server_socket_t sock);
 
 char* PROGRAM_NAME;
-char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] \n";
+char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] [-w WORKERS] DOC_ROOT\n";
 
 /**
  * @file client.c
@@ -25,6 +30,11 @@ char* USAGE_MESSAGE = "Usage: %s [-p PORT] [-i INDEX] \n";
  * @brief OSUE Exercise 3 http
  * @details This server program partially implements version 1.1 of the HTTP. 
  * The server waits for connections from clients and transmits the requested files.
+ * Opened files are kept in the file cache (see filecache.h) and sent with sendfile.
+ * Responses carry the validators ETag and Last-Modified, a conditional request for an unchanged
+ * file is answered with 304 Not Modified without opening the file.
+ * Every request is timed and counted (see stats.h), the sum over all workers is served
+ * on the reserved path STATS_PATH.
  */
 
 // The following variables are global because they are relevant in the whole context of
@@ -39,9 +49,12 @@ static server_socket_t server_socket;
 /** Terminate-Flag - set by the signal handler */
 static volatile sig_atomic_t running;
 
+/** Body of a response to STATS_PATH */
+static char stats_body[STATS_SIZE];
+
 /**
  * @brief Main function handling the program flow
- * @details Uses the global variables args, server_socket, running.
+ * @details Uses the global variable args.
  */ 
 int main(int argc, char** argv) {
     PROGRAM_NAME = argv[0];
@@ -51,7 +64,30 @@ int main(int argc, char** argv) {
 
     set_signal_handler();
 
+    // the statistics are shared, so they have to be mapped before any worker is forked
+    if (stats_init(args.workers) < 0) {
+        ERROR_EXIT("Error setting up statistics", strerror(errno));
+    }
+
+    int exit_code = EXIT_SUCCESS;
+    if (args.workers > 1) {
+        exit_code = run_workers();
+    } else {
+        serve();
+    }
+    stats_free();
+    exit(exit_code);
+}
+
+/**
+ * @brief Opens the server socket and handles connections until the running-flag is cleared.
+ * @details Uses the global variables server_socket, running.
+ */
+static void serve(void) {
     server_socket = setup_server_socket();
+    if (file_cache_init(args.root) < 0) {
+        ERROR_EXIT("Error setting up file cache", strerror(errno));
+    }
 
     running = true;
     while(running) {
@@ -67,8 +103,90 @@ int main(int argc, char** argv) {
     }
     
     close_server_socket(server_socket);
+    file_cache_free();
     LOG("Closed server socket and freed all resources");
-    exit(EXIT_SUCCESS);
+}
+
+/**
+ * @brief Forks a worker process which serves connections until it receives a signal.
+ * @details The worker inherits the signal handlers of the supervisor and counts its requests
+ * in the statistics slot index, a restarted worker continues the counters of its predecessor.
+ * @return The pid of the worker
+ */
+static pid_t start_worker(long index) {
+    pid_t pid = fork();
+    if (pid < 0) {
+        ERROR_EXIT("Error forking worker", strerror(errno));
+    }
+    if (pid == 0) {
+        stats_select(index);
+        serve();
+        exit(EXIT_SUCCESS);
+    }
+    LOG("Started worker %d", pid);
+    return pid;
+}
+
+/**
+ * @brief Starts args.workers workers, each with its own SO_REUSEPORT socket, and restarts
+ * every worker that exits while the server is running.
+ * @details A worker that fails within a second after its start could not set up its socket,
+ * so instead of restarting it forever the whole server is shut down.
+ * On SIGINT or SIGTERM the signal is forwarded to all workers, which finish their current
+ * connection before they exit.
+ * Uses the global variables args, running.
+ * @return EXIT_SUCCESS on a regular shutdown, EXIT_FAILURE if a worker could not start
+ */
+static int run_workers(void) {
+    pid_t workers[args.workers];
+    time_t started[args.workers];
+    int exit_code = EXIT_SUCCESS;
+
+    running = true;
+    for (long i = 0; i < args.workers; i++) {
+        workers[i] = start_worker(i);
+        started[i] = time(NULL);
+    }
+
+    while (running) {
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        for (long i = 0; i < args.workers; i++) {
+            if (workers[i] != pid) {
+                continue;
+            }
+            workers[i] = -1;
+            if (!running) {
+                break;
+            }
+            if (WIFEXITED(status) && WEXITSTATUS(status) != EXIT_SUCCESS && time(NULL) - started[i] < 1) {
+                ERROR_MSG("Worker failed to start", NULL);
+                running = false;
+                exit_code = EXIT_FAILURE;
+                break;
+            }
+            LOG("Worker %d exited, restarting it", pid);
+            workers[i] = start_worker(i);
+            started[i] = time(NULL);
+        }
+    }
+
+    for (long i = 0; i < args.workers; i++) {
+        if (workers[i] > 0) {
+            kill(workers[i], SIGTERM);
+        }
+    }
+    while (wait(NULL) >= 0 || errno == EINTR);
+
+    LOG("All workers stopped");
+    return exit_code;
 }
 
 /**
@@ -76,11 +194,12 @@ int main(int argc, char** argv) {
  * @details This function terminates the program if the usage of the program is violated
  */ 
 static server_arg_t parse_arguments(int argc, char** argv) {
-    server_arg_t args = {.index = NULL, .port = NULL, .root = NULL};
+    server_arg_t args = {.index = NULL, .port = NULL, .root = NULL, .workers = DEFAULT_WORKERS};
 
-    int count_p = 0, count_i = 0;
+    int count_p = 0, count_i = 0, count_w = 0;
+    char* endptr;
     int c;  
-    while((c = getopt(argc, argv, "p:i:")) != -1 ) {
+    while((c = getopt(argc, argv, "p:i:w:")) != -1 ) {
         switch (c) {
             case 'p':
                 args.port = optarg;
@@ -92,6 +211,15 @@ static server_arg_t parse_arguments(int argc, char** argv) {
                 count_i++;
                 break;
 
+            case 'w':
+                args.workers = strtol(optarg, &endptr, 10);
+                if (endptr == optarg || *endptr != '\0' || args.workers < 1 || args.workers > MAX_WORKERS) {
+                    ERROR_MSG("Number of workers must be between 1 and 1024", optarg);
+                    USAGE();
+                }
+                count_w++;
+                break;
+
             case '?':
                 USAGE();
                 break;
@@ -102,7 +230,7 @@ static server_arg_t parse_arguments(int argc, char** argv) {
         }
     }
     // wrong usage
-    if (count_p > 1 || count_i > 1) {
+    if (count_p > 1 || count_i > 1 || count_w > 1) {
         USAGE();
     }
     if (argc == optind || argc > (optind+1)) {
@@ -150,7 +278,8 @@ static void set_signal_handler(void) {
 /**
  * @brief Creates a new server socket listening on the port specified in the program arguments
  * and returns a struct containing the socket fd, the port and the addrinfo struct ai.
- * @details Uses the global variable args.
+ * @details When multiple workers are used SO_REUSEPORT is set, so that every worker can bind
+ * its own socket to the same port. Uses the global variable args.
  */ 
 static server_socket_t setup_server_socket(void) {
     server_socket_t sock = {.port_string = args.port};
@@ -176,6 +305,9 @@ static server_socket_t setup_server_socket(void) {
     // set option
     int optval = 1;
     setsockopt(sock.fd, SOL_SOCKET, SO_REUSEADDR, &optval, sizeof(optval));
+    if (args.workers > 1 && setsockopt(sock.fd, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval)) < 0) {
+        ERROR_EXIT("Error setting SO_REUSEPORT", strerror(errno));
+    }
 
     if (bind(sock.fd, sock.ai->ai_addr, sock.ai->ai_addrlen) < 0) {
         ERROR_EXIT("Error binding socket", strerror(errno));
@@ -209,6 +341,7 @@ static client_connection_t accept_next_connection(void) {
         }
         return conn;
     }
+    conn.accepted = stats_now();
 
     // open socket file
     conn.socket_file = fdopen(conn.socket_fd, "r+");
@@ -226,29 +359,33 @@ static client_connection_t accept_next_connection(void) {
  * @brief Handles an established connection and communicates via HTTP, 
  * parses the request sent by the client, creates the corresponding
  * response and sends it before closing the connection.
+ * @details Every phase is timed from the end of the previous one, starting when accept returned.
  */
 static void handle_connection(client_connection_t conn) {
-    http_request_t req = get_request_header(conn);
-    if (req.bad == false) LOG("Client sent HTTP %s request for %s", req.method, req.path);
+    uint64_t since = conn.accepted;
+    stats_phase(STATS_ACCEPT, &since);
+
+    // the request header is parsed in place, method and path point into the arena
+    struct httpparse_arena arena;
+    arena.len = 0;
+    http_request_t req = get_request_header(conn, &arena);
+    stats_phase(STATS_PARSE, &since);
+    if (req.method.ptr == NULL) LOG("Client sent no request");
+    else if (req.bad == false) LOG("Client sent HTTP %.*s request for %.*s", (int) req.method.len, req.method.ptr, (int) req.path.len, req.path.ptr);
     else LOG("Client sent bad request");
 
     http_response_t res = create_response_header(req);
-    send_response_header(conn, res);
-    LOG("Sent response status %ld %s", res.status.code, res.status.detail);
+    stats_phase(STATS_OPEN, &since);
 
-    // only send body if successful
-    if (res.status.code == OK) {
-        char buf[1];
-        while (fread(buf, 1, 1, res.content) == 1) {
-            fwrite(buf, 1, 1, conn.socket_file);
-        }
-        LOG("Sent response body");
+    size_t sent = 0;
+    if (send_response(conn, res, &sent)) {
+        LOG("Sent response status %ld %s", res.status.code, res.status.detail);
+    } else {
+        ERROR_LOG("Error sending response", strerror(errno));
     }
+    stats_phase(STATS_SEND, &since);
+    stats_request(res.status.code, sent, since - conn.accepted);
 
-    if (req.method != NULL) free(req.method);
-    if (req.path != NULL) free(req.path);
-    if (res.date_time != NULL) free(res.date_time);
-    if (res.content != NULL) fclose(res.content);
     if (conn.socket_file != NULL) fclose(conn.socket_file);
 }
 
@@ -256,45 +393,42 @@ static void handle_connection(client_connection_t conn) {
  * @brief Gets the request header the connected client sent, parses it
  * for validity and returns a struct containing the requested resource path,
  * the request method and whether the request is malformed (bad).
+ * @details The whole header is read into arena and parsed there without allocating anything (see
+ * httpparse.h), the returned method and path point into the arena. Headers larger than the arena
+ * are bad requests. If no request could be read at all, method.ptr is NULL.
  */
-static http_request_t get_request_header(client_connection_t conn) {
-    http_request_t req = {.method = NULL, .path = NULL, .bad = false};
-
-    // get first line of header
-    char *line = NULL;
-    size_t len, buflen;
-    if(getline(&line, &buflen, conn.socket_file) < 0) {
-        ERROR_LOG("Error reading request header", strerror(errno));
-        return req;
-    }
-
-    char *line_p = line;
-
-    char* method = strsep(&line_p, " ");
-    req.method = strdup(method);
-    if (line_p == NULL) {
-        ERROR_LOG("Invalid request header", "No path specified");
-        req.bad = true;
-    } else {
-        char* path = strsep(&line_p, " ");
-        req.path = strdup(path);
-        if (line_p == NULL) {
-            ERROR_LOG("Invalid request header", "No protocol specified");
+static http_request_t get_request_header(client_connection_t conn, struct httpparse_arena* arena) {
+    http_request_t req = {.method = {NULL, 0}, .path = {NULL, 0}, .if_none_match = {NULL, 0},
+                          .if_modified_since = {NULL, 0}, .bad = false};
+    struct httpparse_request header;
+
+    switch (httpparse_read(conn.socket_fd, arena, &header)) {
+        case HTTPPARSE_OK:
+            break;
+        case HTTPPARSE_CLOSED:
+            ERROR_LOG("Error reading request header", errno != 0 ? strerror(errno) : "Connection closed");
+            return req;
+        case HTTPPARSE_TOO_LARGE:
+            ERROR_LOG("Invalid request header", "Header too large");
+            req.method.ptr = arena->data;
             req.bad = true;
-        } else {
-            if (strcmp(line_p, "HTTP/1.1\r\n") != 0) {
-                ERROR_LOG("Invalid request header", "Wrong procotol specified");
-                req.bad = true;
-            }
-        }
+            return req;
+        default:
+            ERROR_LOG("Invalid request header", "Malformed header");
+            req.method.ptr = arena->data;
+            req.bad = true;
+            return req;
     }
 
-    // skip rest of header
-    while ((len = getline(&line, &buflen, conn.socket_file)) != -1) {
-        if (strcmp(line, "\r\n") == 0) break;
+    req.method = header.method;
+    req.path = header.path;
+    const struct httpparse_span* value;
+    if ((value = httpparse_find_header(&header, "If-None-Match")) != NULL) req.if_none_match = *value;
+    if ((value = httpparse_find_header(&header, "If-Modified-Since")) != NULL) req.if_modified_since = *value;
+    if (!httpparse_equals(header.version, "HTTP/1.1")) {
+        ERROR_LOG("Invalid request header", "Wrong procotol specified");
+        req.bad = true;
     }
-    free(line);
-
     return req;
 }
 
@@ -302,12 +436,16 @@ static http_request_t get_request_header(client_connection_t conn) {
  * @brief Creates a response for the given request - in the case of a
  * valid request opens the requested resource, gets it content type and length,
  * gets the current date/time and returns a struct containing the response values.
+ * @details A request for STATS_PATH (or STATS_JSON_PATH) is answered with the statistics of all
+ * workers instead of a file. The validators are taken from the file cache, or from stat if the
+ * file is not cached, so a conditional request for an unchanged file is answered with 304
+ * without opening the file.
  */
 static http_response_t create_response_header(http_request_t req) {
-    http_response_t res = { .content = NULL, .content_length = 0 };
+    http_response_t res = { .content_fd = -1, .content_length = 0, .content = NULL, .etag = "", .last_modified = "" };
 
     // check for errors in request
-    if (req.method == NULL) { // 500
+    if (req.method.ptr == NULL) { // 500
         res.status.code = INTERNAL_SERVER_ERROR;
         res.status.detail = INTERNAL_SERVER_ERROR_STRING;
         return res;
@@ -315,63 +453,81 @@ static http_response_t create_response_header(http_request_t req) {
         res.status.code = BAD_REQUEST;
         res.status.detail = BAD_REQUEST_STRING;
         return res;
-    } else if (strcmp(req.method, GET) != 0) { // 501
+    } else if (!httpparse_equals(req.method, GET)) { // 501
         res.status.code = NOT_IMPLEMENTED;
         res.status.detail = NOT_IMPLEMENTED_STRING;
         return res;
     }
 
-    // 200 OK
-
-    // add index file to path if request path is root
-    char* requested_path;
-    if (strcmp(req.path, "/") == 0) {
-        requested_path = malloc(strlen(args.index) + 1 + 1);
-        if (requested_path == NULL) {
-            ERROR_LOG("malloc failed", strerror(errno));
-            res.status.code = INTERNAL_SERVER_ERROR;
-            res.status.detail = INTERNAL_SERVER_ERROR_STRING;
-            return res;
-        }
-        strcpy(requested_path, req.path);
-        strcat(requested_path, args.index);
-    } else {
-        requested_path = strdup(req.path);
-        if (requested_path == NULL) {
-            ERROR_LOG("strdup failed", strerror(errno));
+    // statistics
+    bool json = httpparse_equals(req.path, STATS_JSON_PATH);
+    if (json || httpparse_equals(req.path, STATS_PATH)) {
+        int len = stats_format(stats_body, sizeof(stats_body), json);
+        if (len < 0) {
             res.status.code = INTERNAL_SERVER_ERROR;
             res.status.detail = INTERNAL_SERVER_ERROR_STRING;
             return res;
         }
+        res.content = stats_body;
+        res.content_length = len;
+        res.mime_type = json ? "application/json" : "text/plain";
+        res.date_time = get_current_date_time();
+        res.status.code = OK;
+        res.status.detail = OK_STRING;
+        return res;
     }
 
-    // concat doc_root with path
-    char* path = malloc(strlen(args.root) + strlen(requested_path) + 1);
-    strcpy(path, args.root); strcat(path, requested_path);
-    free(requested_path);
+    // 200 OK
 
-    // check if file exists
-    if (access(path, F_OK) != 0) {
-        res.status.code = NOT_FOUND;
-        res.status.detail = NOT_FOUND_STRING;
-        free(path);
+    // concat doc_root with path, add index file to path if request path is root
+    char path[strlen(args.root) + req.path.len + strlen(args.index) + 1];
+    strcpy(path, args.root);
+    strncat(path, req.path.ptr, req.path.len);
+    if (httpparse_equals(req.path, "/")) strcat(path, args.index);
+
+    // 304 Not Modified
+    file_cache_entry_t* file = file_cache_lookup(path);
+    struct stat st;
+    bool not_modified = false;
+    if (file != NULL) {
+        set_validators(&res, file->size, file->mtime);
+        not_modified = is_not_modified(req, &res, file->mtime);
+    } else if ((req.if_none_match.ptr != NULL || req.if_modified_since.ptr != NULL) &&
+               stat(path, &st) == 0 && S_ISREG(st.st_mode)) {
+        set_validators(&res, st.st_size, st.st_mtim);
+        not_modified = is_not_modified(req, &res, st.st_mtim);
+    }
+    if (not_modified) {
+        stats_cache(file != NULL);
+        res.date_time = get_current_date_time();
+        res.status.code = NOT_MODIFIED;
+        res.status.detail = NOT_MODIFIED_STRING;
         return res;
     }
 
-    // get mime-type of file
-    res.mime_type = get_mime_type(path);
-
-    // open file
-    res.content = fopen(path, "r");
-    free(path);
-    if (res.content == NULL) {
-        res.status.code = INTERNAL_SERVER_ERROR;
-        res.status.detail = INTERNAL_SERVER_ERROR_STRING;
+    // open file (or get it from the cache)
+    bool hit = file != NULL;
+    if (file == NULL) {
+        file = file_cache_get(path, &hit);
+    }
+    stats_cache(hit);
+    if (file == NULL) {
+        if (errno == ENOENT || errno == ENOTDIR || errno == EISDIR) {
+            res.status.code = NOT_FOUND;
+            res.status.detail = NOT_FOUND_STRING;
+        } else {
+            ERROR_LOG("Error opening requested file", strerror(errno));
+            res.status.code = INTERNAL_SERVER_ERROR;
+            res.status.detail = INTERNAL_SERVER_ERROR_STRING;
+        }
         return res;
     }
 
     // get other header fields and return
-    res.content_length = get_file_size(res.content);
+    set_validators(&res, file->size, file->mtime);
+    res.content_fd = file->fd;
+    res.mime_type = file->mime_type;
+    res.content_length = file->size;
     res.date_time = get_current_date_time();
     res.status.code = OK;
     res.status.detail = OK_STRING;
@@ -379,64 +535,165 @@ static http_response_t create_response_header(http_request_t req) {
 }
 
 /**
- * @brief Sends the response header res to the connected client.
+ * @brief Formats the validators of a file with the given size and modification time into res.
+ * @details The ETag is made of the modification time (with nanoseconds) and the size, so it
+ * changes whenever the file is written.
  */
-static void send_response_header(client_connection_t conn, http_response_t res) {
-    if (res.status.code != OK) {
-        fprintf(conn.socket_file, "HTTP/1.1 %ld %s\r\nConnection: close\r\n\r\n", res.status.code, res.status.detail);
-    } else if (res.mime_type == NULL) {
-        fprintf(conn.socket_file, "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", res.date_time, res.content_length);
-    } else {
-        fprintf(conn.socket_file, "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\nConnection: close\r\n\r\n", res.date_time, res.mime_type, res.content_length);
+static void set_validators(http_response_t* res, size_t size, struct timespec mtime) {
+    snprintf(res->etag, sizeof(res->etag), "\"%lx.%lx-%zx\"", (long) mtime.tv_sec, mtime.tv_nsec, size);
+
+    struct tm modified;
+    gmtime_r(&mtime.tv_sec, &modified);
+    if (strftime(res->last_modified, sizeof(res->last_modified), "%a, %d %b %Y %T GMT", &modified) == 0) {
+        res->last_modified[0] = '\0';
     }
 }
 
 /**
- * @brief Closes the server socket sock and frees the addrinfo struct associated with it.
+ * @brief Returns whether the validators of the request match the file, so 304 can be answered.
+ * @details The validators of the file have to be set in res. If-None-Match takes precedence over
+ * If-Modified-Since, the latter only compares whole seconds.
  */
-static void close_server_socket(server_socket_t sock) {
-    close(sock.fd);
-    freeaddrinfo(sock.ai);
+static bool is_not_modified(http_request_t req, http_response_t* res, struct timespec mtime) {
+    if (res->etag[0] == '\0') {
+        return false;
+    }
+    if (req.if_none_match.ptr != NULL) {
+        return httpparse_equals(req.if_none_match, "*") || httpparse_contains(req.if_none_match, res->etag);
+    }
+    time_t since;
+    return req.if_modified_since.ptr != NULL && parse_http_date(req.if_modified_since, &since) && mtime.tv_sec <= since;
 }
 
 /**
- * @brief Gets the content type of a file depending on the file extension.
+ * @brief Parses a date in the format of Last-Modified (e.g. "Sun, 06 Nov 1994 08:49:37 GMT").
+ * @return true on success, false if the date is malformed
  */
-static char* get_mime_type(char* path) {
-    char* extension = strrchr(path, '.');
-    if (strcmp(extension, ".html") == 0 || strcmp(extension, ".htm") == 0) {
-        return "text/html";
-    } else if (strcmp(extension, ".css") == 0) {
-        return "text/css";
-    } else if (strcmp(extension, ".js") == 0) {
-        return "application/javascript";
+static bool parse_http_date(struct httpparse_span span, time_t* time) {
+    static const char* months = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    char date[DATE_TIME_SIZE];
+    if (span.len >= sizeof(date)) {
+        return false;
+    }
+    memcpy(date, span.ptr, span.len);
+    date[span.len] = '\0';
+
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    char month[4];
+    if (sscanf(date, "%*3s, %d %3s %d %d:%d:%d GMT", &tm.tm_mday, month, &tm.tm_year,
+               &tm.tm_hour, &tm.tm_min, &tm.tm_sec) != 6) {
+        return false;
+    }
+    char* found = strstr(months, month);
+    if (strlen(month) != 3 || found == NULL || (found - months) % 3 != 0) {
+        return false;
+    }
+    tm.tm_mon = (found - months) / 3;
+    tm.tm_year -= 1900;
+    *time = timegm(&tm);
+    return *time != (time_t) -1;
+}
+
+/**
+ * @brief Sends the response res to the connected client, the header followed by the file if
+ * the request was successful.
+ * @details The header is formatted into a buffer on the stack and written directly to the socket.
+ * If a file follows, the header is sent with MSG_MORE, so the kernel sends it together with the
+ * first bytes of the file (copied with sendfile) instead of in a segment of its own.
+ * A body in memory (res.content) is sent instead of the file. The number of bytes sent is
+ * added to *sent.
+ * @return true on success, false on failure (errno is set)
+ */
+static bool send_response(client_connection_t conn, http_response_t res, size_t* sent) {
+    char header[HEADER_SIZE];
+    char validators[ETAG_SIZE + DATE_TIME_SIZE + 32] = "";
+    if (res.etag[0] != '\0') {
+        snprintf(validators, sizeof(validators), "ETag: %s\r\nLast-Modified: %s\r\n", res.etag, res.last_modified);
+    }
+
+    int len;
+    if (res.status.code == NOT_MODIFIED) {
+        len = snprintf(header, sizeof(header), "HTTP/1.1 304 Not Modified\r\nDate: %s\r\n%sConnection: close\r\n\r\n", res.date_time, validators);
+    } else if (res.status.code != OK) {
+        len = snprintf(header, sizeof(header), "HTTP/1.1 %ld %s\r\nConnection: close\r\n\r\n", res.status.code, res.status.detail);
+    } else if (res.mime_type == NULL) {
+        len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Length: %lu\r\n%sConnection: close\r\n\r\n", res.date_time, res.content_length, validators);
     } else {
-        return NULL;
+        len = snprintf(header, sizeof(header), "HTTP/1.1 200 OK\r\nDate: %s\r\nContent-Type: %s\r\nContent-Length: %lu\r\n%sConnection: close\r\n\r\n", res.date_time, res.mime_type, res.content_length, validators);
+    }
+    if (len < 0 || (size_t) len >= sizeof(header)) {
+        errno = EOVERFLOW;
+        return false;
+    }
+
+    // only send body if successful
+    bool body = res.status.code == OK && res.content_length > 0;
+    if (!send_all(conn.socket_fd, header, len, body ? MSG_MORE : 0)) {
+        return false;
+    }
+    *sent += len;
+    if (body && res.content != NULL) {
+        if (!send_all(conn.socket_fd, res.content, res.content_length, 0)) {
+            return false;
+        }
+        *sent += res.content_length;
+        return true;
     }
+    off_t offset = 0;
+    while (body && offset < res.content_length) {
+        ssize_t n = sendfile(conn.socket_fd, res.content_fd, &offset, res.content_length - offset);
+        if (n <= 0) {
+            return false;
+        }
+        *sent += n;
+    }
+    return true;
+}
+
+/**
+ * @brief Writes len bytes of buf to the socket fd, continuing after partial writes.
+ * @return true on success, false on failure (errno is set)
+ */
+static bool send_all(int fd, char* buf, size_t len, int flags) {
+    while (len > 0) {
+        ssize_t sent = send(fd, buf, len, flags);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        buf += sent;
+        len -= sent;
+    }
+    return true;
 }
 
 /**
- * @brief Gets the size of a file in bytes.
+ * @brief Closes the server socket sock and frees the addrinfo struct associated with it.
  */
-static size_t get_file_size(FILE* file) {
-    size_t size;
-    fseek(file, 0, SEEK_END);
-    size = ftell(file);
-    fseek(file, 0, SEEK_SET);
-    return size;
+static void close_server_socket(server_socket_t sock) {
+    close(sock.fd);
+    freeaddrinfo(sock.ai);
 }
 
 /**
  * @brief Gets the current UTC time and returns it in a RFC822-compliant format.
+ * @details The string lives in a static buffer which is only formatted again once the
+ * second changed, so it must not be freed and is valid until the next call.
  */
-static char* get_current_date_time(void) {
-    char* date_time = malloc(256);
+static const char* get_current_date_time(void) {
+    static char date_time[DATE_TIME_SIZE];
+    static time_t formatted = (time_t) -1;
+
     time_t tictoc;
-    struct tm *now;
     time(&tictoc);
-    now = gmtime(&tictoc);
-    if (strftime(date_time, 256, "%a, %d %b %y %T GMT", now) < 0) {
-        ERROR_LOG("Error getting current date/time", strerror(errno));
+    if (tictoc != formatted) {
+        struct tm now;
+        gmtime_r(&tictoc, &now);
+        if (strftime(date_time, DATE_TIME_SIZE, "%a, %d %b %y %T GMT", &now) == 0) {
+            ERROR_LOG("Error getting current date/time", strerror(errno));
+        }
+        formatted = tictoc;
     }
     return date_time;
 }
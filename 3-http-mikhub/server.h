@@ -16,13 +16,26 @@
 #include <signal.h>
 #include <dirent.h>
 #include <time.h>
+#include <sys/wait.h>
+#include <sys/sendfile.h>
+
+#include "filecache.h"
+#include "httpparse.h"
+#include "stats.h"
 
 #define DEFAULT_PORT 8080
 #define DEFAULT_PORT_STRING "8080"
 #define DEFAULT_FILENAME "index.html"
+#define DEFAULT_WORKERS 1
+#define MAX_WORKERS 1024
+#define DATE_TIME_SIZE 32
+#define HEADER_SIZE 512
+#define ETAG_SIZE 64
 
 #define OK 200
 #define OK_STRING "OK"
+#define NOT_MODIFIED 304
+#define NOT_MODIFIED_STRING "Not Modified"
 #define NOT_IMPLEMENTED 501
 #define NOT_IMPLEMENTED_STRING "Not implemented"
 #define NOT_FOUND 404
@@ -38,10 +51,13 @@
  * @brief Represents an HTTP request
  */
 typedef struct {
-    /** HTTP method used in request */  
-    char* method;
-    /** Requested file path */
-    char* path;
+    /** HTTP method used in request, points into the arena the header was read into */
+    struct httpparse_span method;
+    /** Requested file path, points into the arena the header was read into */
+    struct httpparse_span path;
+    /** Values of the If-None-Match and If-Modified-Since headers (ptr is NULL if not sent) */
+    struct httpparse_span if_none_match;
+    struct httpparse_span if_modified_since;
     /** Whether the request is malformed */
     bool bad;
 } http_request_t;
@@ -62,14 +78,19 @@ typedef struct {
 typedef struct {
     /** Status of HTTP response */
     http_status_t status;
-    /** Date and time the response was sent */
-    char* date_time;
+    /** Date and time the response was sent (cached, must not be freed) */
+    const char* date_time;
     /** Content type of the file in the response body */
     char* mime_type;
     /** Content length of the file in the response body */
     size_t content_length;
-    /** File to be sent in response body */
-    FILE* content;
+    /** Cached file descriptor of the file to be sent in response body */
+    int content_fd;
+    /** Response body in memory, sent instead of the file if not NULL */
+    char* content;
+    /** Validators of the file in the response body (empty if there is no file) */
+    char etag[ETAG_SIZE];
+    char last_modified[DATE_TIME_SIZE];
 } http_response_t;
 
 /**
@@ -82,6 +103,8 @@ typedef struct {
     FILE *socket_file;
     /** Whether the connection was successfully established */
     bool succesful;
+    /** Time accept returned (see stats_now) */
+    uint64_t accepted;
  } client_connection_t;
 
  typedef struct {
@@ -103,6 +126,8 @@ typedef struct {
     char* index; 
     /** Directory to serve files out of */
     char* root;
+    /** Number of pre-forked worker processes */
+    long workers;
  } server_arg_t;
 
 #endif
\ No newline at end of file
@@ -0,0 +1,181 @@
+#include <stdarg.h>
+
+#include "stats.h"
+
+/**
+ * @file stats.c
+ * @author Michael Huber 11712763
+ * @date 21.01.2021
+ * @brief Implementation of the per-worker request statistics
+ */
+
+static void add(uint64_t* counter, uint64_t value);
+static uint64_t get(uint64_t* counter);
+static bool append(char* buf, size_t size, size_t* len, char* format, ...);
+
+/** Names of the phases as they appear in the output */
+static char* phase_names[STATS_PHASES] = {"accept", "parse", "open", "send"};
+
+/** Slots of all workers in the shared mapping */
+static stats_worker_t* slots;
+static long slot_count;
+
+/** Slot of this process */
+static stats_worker_t* own;
+
+int stats_init(long workers) {
+    slots = mmap(NULL, workers * sizeof(stats_worker_t), PROT_READ | PROT_WRITE,
+                 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (slots == MAP_FAILED) {
+        slots = NULL;
+        return -1;
+    }
+    slot_count = workers;
+    own = &slots[0];
+    return 0;
+}
+
+void stats_free(void) {
+    if (slots != NULL) {
+        munmap(slots, slot_count * sizeof(stats_worker_t));
+        slots = NULL;
+        own = NULL;
+    }
+}
+
+void stats_select(long worker) {
+    own = &slots[worker];
+}
+
+uint64_t stats_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+void stats_phase(stats_phase_t phase, uint64_t* since) {
+    uint64_t now = stats_now();
+    add(&own->phase_ns[phase], now - *since);
+    *since = now;
+}
+
+void stats_cache(bool hit) {
+    add(hit ? &own->cache_hits : &own->cache_misses, 1);
+}
+
+void stats_request(long status, size_t bytes, uint64_t latency_ns) {
+    add(&own->requests, 1);
+    if (status >= 100 && status < 600) {
+        add(&own->status[status / 100], 1);
+    }
+    add(&own->bytes, bytes);
+
+    // the bucket is the number of bits of the latency in microseconds
+    uint64_t us = latency_ns / 1000;
+    int bucket = us == 0 ? 0 : 64 - __builtin_clzll(us);
+    if (bucket >= STATS_BUCKETS) bucket = STATS_BUCKETS - 1;
+    add(&own->latency[bucket], 1);
+}
+
+int stats_format(char* buf, size_t size, bool json) {
+    stats_worker_t sum;
+    memset(&sum, 0, sizeof(sum));
+    uint64_t worker_requests[slot_count];
+
+    // the slots are a flat array of counters, so they can be summed up field by field
+    size_t fields = sizeof(stats_worker_t) / sizeof(uint64_t);
+    for (long i = 0; i < slot_count; i++) {
+        uint64_t* from = (uint64_t*) &slots[i];
+        uint64_t* to = (uint64_t*) &sum;
+        for (size_t j = 0; j < fields; j++) {
+            to[j] += get(&from[j]);
+        }
+        worker_requests[i] = get(&slots[i].requests);
+    }
+
+    uint64_t lookups = sum.cache_hits + sum.cache_misses;
+    double hit_ratio = lookups > 0 ? (double) sum.cache_hits / lookups : 0;
+    size_t len = 0;
+    bool ok = true;
+
+    if (json) {
+        ok = ok && append(buf, size, &len, "{\"requests\":%lu,\"status\":{", sum.requests);
+        for (int i = 1; i < 6; i++) {
+            ok = ok && append(buf, size, &len, "%s\"%dxx\":%lu", i > 1 ? "," : "", i, sum.status[i]);
+        }
+        ok = ok && append(buf, size, &len, "},\"bytes\":%lu,\"cache\":{\"hits\":%lu,\"misses\":%lu,\"hit_ratio\":%.4f},\"phases_us\":{",
+                          sum.bytes, sum.cache_hits, sum.cache_misses, hit_ratio);
+        for (int i = 0; i < STATS_PHASES; i++) {
+            ok = ok && append(buf, size, &len, "%s\"%s\":{\"total\":%lu,\"avg\":%.3f}", i > 0 ? "," : "", phase_names[i],
+                              sum.phase_ns[i] / 1000, sum.requests > 0 ? sum.phase_ns[i] / 1000.0 / sum.requests : 0);
+        }
+        ok = ok && append(buf, size, &len, "},\"latency_us\":{");
+        for (int i = 0; i < STATS_BUCKETS; i++) {
+            if (i < STATS_BUCKETS - 1) {
+                ok = ok && append(buf, size, &len, "%s\"lt_%lu\":%lu", i > 0 ? "," : "", (uint64_t) 1 << i, sum.latency[i]);
+            } else {
+                ok = ok && append(buf, size, &len, ",\"ge_%lu\":%lu", (uint64_t) 1 << (i - 1), sum.latency[i]);
+            }
+        }
+        ok = ok && append(buf, size, &len, "},\"workers\":[");
+        for (long i = 0; i < slot_count; i++) {
+            ok = ok && append(buf, size, &len, "%s%lu", i > 0 ? "," : "", worker_requests[i]);
+        }
+        ok = ok && append(buf, size, &len, "]}\n");
+    } else {
+        ok = ok && append(buf, size, &len, "requests %lu\n", sum.requests);
+        for (int i = 1; i < 6; i++) {
+            ok = ok && append(buf, size, &len, "status_%dxx %lu\n", i, sum.status[i]);
+        }
+        ok = ok && append(buf, size, &len, "bytes %lu\ncache_hits %lu\ncache_misses %lu\ncache_hit_ratio %.4f\n",
+                          sum.bytes, sum.cache_hits, sum.cache_misses, hit_ratio);
+        for (int i = 0; i < STATS_PHASES; i++) {
+            ok = ok && append(buf, size, &len, "phase_%s_us_total %lu\nphase_%s_us_avg %.3f\n", phase_names[i],
+                              sum.phase_ns[i] / 1000, phase_names[i],
+                              sum.requests > 0 ? sum.phase_ns[i] / 1000.0 / sum.requests : 0);
+        }
+        for (int i = 0; i < STATS_BUCKETS; i++) {
+            if (i < STATS_BUCKETS - 1) {
+                ok = ok && append(buf, size, &len, "latency_us_lt_%lu %lu\n", (uint64_t) 1 << i, sum.latency[i]);
+            } else {
+                ok = ok && append(buf, size, &len, "latency_us_ge_%lu %lu\n", (uint64_t) 1 << (i - 1), sum.latency[i]);
+            }
+        }
+        for (long i = 0; i < slot_count; i++) {
+            ok = ok && append(buf, size, &len, "worker_%ld_requests %lu\n", i, worker_requests[i]);
+        }
+    }
+    return ok ? (int) len : -1;
+}
+
+/**
+ * @brief Adds value to a counter of the own slot.
+ * @details Only the owner writes to a slot, so the increment does not have to be atomic, the
+ * store only has to be a single one so that readers never see a torn value.
+ */
+static void add(uint64_t* counter, uint64_t value) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + value, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Reads a counter of any slot.
+ */
+static uint64_t get(uint64_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Appends the formatted text to buf, which already holds *len characters.
+ * @return true on success, false if buf is too small
+ */
+static bool append(char* buf, size_t size, size_t* len, char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int n = vsnprintf(buf + *len, size - *len, format, args);
+    va_end(args);
+    if (n < 0 || (size_t) n >= size - *len) {
+        return false;
+    }
+    *len += n;
+    return true;
+}
@@ -0,0 +1,107 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/mman.h>
+
+/**
+ * @file stats.h
+ * @author Michael Huber 11712763
+ * @date 21.01.2021
+ * @brief Per-worker request statistics
+ * @details Every worker owns one slot in a shared anonymous mapping created before the workers
+ * are forked. Only the owner writes to its slot, so the counters need no locks - they are
+ * updated with relaxed atomic loads and stores, which is a plain mov on x86. Any worker can
+ * sum up all slots to answer a request for STATS_PATH. Times are taken from CLOCK_MONOTONIC,
+ * which is read through the vDSO without a syscall.
+ */
+
+#define STATS_PATH "/__stats"
+#define STATS_JSON_PATH "/__stats?format=json"
+#define STATS_BUCKETS 24
+#define STATS_SIZE 8192
+
+/**
+ * @brief The phases a request is timed in
+ */
+typedef enum {
+    /** From accept returning until the connection is handled */
+    STATS_ACCEPT,
+    /** Reading and parsing the request header */
+    STATS_PARSE,
+    /** Resolving the path and opening the file (or getting it from the cache) */
+    STATS_OPEN,
+    /** Sending the header and the body */
+    STATS_SEND,
+    STATS_PHASES
+} stats_phase_t;
+
+/**
+ * @brief The counters of one worker
+ */
+typedef struct {
+    /** Number of handled requests */
+    uint64_t requests;
+    /** Number of responses by status class, index is code / 100 */
+    uint64_t status[6];
+    /** Bytes sent, header and body */
+    uint64_t bytes;
+    /** Lookups in the file cache */
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    /** Total time spent in every phase in nanoseconds */
+    uint64_t phase_ns[STATS_PHASES];
+    /** Request latencies, bucket i counts latencies below 2^i microseconds (the last one all others) */
+    uint64_t latency[STATS_BUCKETS];
+} stats_worker_t;
+
+/**
+ * @brief Maps the slots for workers workers, has to be called before the workers are forked.
+ * @return 0 on success, -1 on failure (errno is set)
+ */
+int stats_init(long workers);
+
+/**
+ * @brief Unmaps the slots.
+ */
+void stats_free(void);
+
+/**
+ * @brief Selects the slot of worker worker for all following updates of this process.
+ */
+void stats_select(long worker);
+
+/**
+ * @brief Returns the current time of the monotonic clock in nanoseconds.
+ */
+uint64_t stats_now(void);
+
+/**
+ * @brief Adds the time since *since to the phase phase and sets *since to the current time.
+ */
+void stats_phase(stats_phase_t phase, uint64_t* since);
+
+/**
+ * @brief Counts a lookup in the file cache.
+ */
+void stats_cache(bool hit);
+
+/**
+ * @brief Counts a finished request with the status code status, bytes sent bytes and the
+ * latency latency_ns.
+ */
+void stats_request(long status, size_t bytes, uint64_t latency_ns);
+
+/**
+ * @brief Sums up the slots of all workers and writes them as plain text (or JSON) to buf.
+ * @return The length of the text or -1 if buf is too small
+ */
+int stats_format(char* buf, size_t size, bool json);
+
+#endif
@@ -0,0 +1,881 @@
+/**
+ * @file httpbench.c
+ * @date 21.01.2021
+ *
+ * @brief A load generator for the http servers of the third exercise.
+ * @details Opens a number of concurrent connections to a server and sends
+ * GET requests for a fixed duration, one after the other on every connection.
+ * The latency of every request (for new connections including the connect)
+ * is recorded in a log-linear histogram, so percentiles come out with a
+ * relative error of at most 1/32 without storing every sample.
+ * Every run is repeated with keep-alive on and off and gzip on and off, so the
+ * effect of connection reuse and compression can be compared directly.
+ **/
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+
+/**
+ * Each power of two range of the histogram is split into this many buckets.
+ **/
+#define SUB_BUCKETS 32
+
+/**
+ * Number of buckets of the histogram, enough for any 64 bit value.
+ **/
+#define HISTOGRAM_SIZE ((64 - 5) * SUB_BUCKETS + 2 * SUB_BUCKETS)
+
+/**
+ * Size of the buffer a response is read into.
+ **/
+#define BUFFER_SIZE (64 * 1024)
+
+/**
+ * Maximum size of a response header.
+ **/
+#define HEADER_SIZE 8192
+
+/**
+ * The maximum number of concurrent connections.
+ **/
+#define MAX_CONNECTIONS 10000
+
+/**
+ * Maximum number of events handled per epoll_wait call.
+ **/
+#define MAX_EVENTS 256
+
+/**
+ * A log-linear histogram.
+ * @brief Values below 2 * SUB_BUCKETS are counted exactly, above every power
+ * of two is split into SUB_BUCKETS buckets of equal width.
+ **/
+struct histogram
+{
+    uint64_t counts[HISTOGRAM_SIZE];
+    uint64_t total;
+    uint64_t min;
+    uint64_t max;
+    uint64_t sum;
+};
+
+/**
+ * The states a connection walks through.
+ **/
+enum conn_state
+{
+    STATE_CONNECT,
+    STATE_SEND,
+    STATE_HEADER,
+    STATE_BODY,
+    STATE_CHUNK_SIZE,
+    STATE_CHUNK_DATA,
+    STATE_CHUNK_END,
+    STATE_TRAILER,
+};
+
+/**
+ * A connection to the server.
+ **/
+struct connection
+{
+    int fd;
+    enum conn_state state;
+    uint64_t start;
+    size_t sent;
+
+    char header[HEADER_SIZE];
+    size_t header_len;
+
+    bool chunked;
+    bool until_close;
+    bool server_closes;
+    uint64_t body_left;
+    char line[32];
+    size_t line_len;
+};
+
+/**
+ * The configuration of a run.
+ **/
+struct options
+{
+    char *host;
+    char *port;
+    char *path;
+    long connections;
+    long duration;
+};
+
+/**
+ * The results of a run.
+ **/
+struct results
+{
+    struct histogram latency;
+    uint64_t requests;
+    uint64_t bytes;
+    uint64_t connects;
+    uint64_t errors;
+    uint64_t bad_status;
+    double seconds;
+};
+
+/**
+ * The name of the current program.
+ **/
+static char *prog_name;
+
+/**
+ * The address of the server.
+ **/
+static struct addrinfo *server_addr;
+
+/**
+ * The request sent on every connection of the current run.
+ **/
+static char request[1024];
+static size_t request_len;
+
+/**
+ * Whether the current run keeps the connections alive.
+ **/
+static bool keep_alive;
+
+/**
+ * Print the usage and exit.
+ **/
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: %s [-c CONNECTIONS] [-d SECONDS] [-k on|off|both] [-z on|off|both] URL\n",
+            prog_name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Get the current time.
+ * @return The time of the monotonic clock in microseconds.
+ **/
+static uint64_t now_us(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/**
+ * Find the bucket of a value.
+ * @return The index of the bucket counting value.
+ **/
+static size_t histogram_index(uint64_t value)
+{
+    if (value < 2 * SUB_BUCKETS)
+    {
+        return value;
+    }
+    int shift = 63 - __builtin_clzll(value) - 5;
+    return (size_t)shift * SUB_BUCKETS + (value >> shift);
+}
+
+/**
+ * Find the largest value of a bucket.
+ * @return The largest value counted in the bucket at index.
+ **/
+static uint64_t histogram_upper(size_t index)
+{
+    if (index < 2 * SUB_BUCKETS)
+    {
+        return index;
+    }
+    int shift = index / SUB_BUCKETS - 1;
+    uint64_t sub = index - shift * SUB_BUCKETS;
+    return ((sub + 1) << shift) - 1;
+}
+
+/**
+ * Record a value.
+ * @param h The histogram to update.
+ * @param value The value to count.
+ **/
+static void histogram_record(struct histogram *h, uint64_t value)
+{
+    h->counts[histogram_index(value)]++;
+    if (h->total == 0 || value < h->min)
+    {
+        h->min = value;
+    }
+    if (value > h->max)
+    {
+        h->max = value;
+    }
+    h->total++;
+    h->sum += value;
+}
+
+/**
+ * Calculate a percentile.
+ * @param h The histogram to evaluate.
+ * @param percentile The percentile between 0 and 100.
+ * @return The upper bound of the bucket holding the percentile, but at most
+ * the largest recorded value.
+ **/
+static uint64_t histogram_percentile(const struct histogram *h,
+                                     double percentile)
+{
+    if (h->total == 0)
+    {
+        return 0;
+    }
+    uint64_t rank = (uint64_t)(percentile / 100.0 * h->total + 0.5);
+    if (rank < 1)
+    {
+        rank = 1;
+    }
+    uint64_t seen = 0;
+    for (size_t i = 0; i < HISTOGRAM_SIZE; i++)
+    {
+        seen += h->counts[i];
+        if (seen >= rank)
+        {
+            uint64_t upper = histogram_upper(i);
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+/**
+ * Parse an URL.
+ * @brief Split an URL of the form http://host[:port]/path.
+ * @details The parts point into url, which is modified.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int parse_url(char *url, struct options *opts)
+{
+    if (strncasecmp(url, "http://", strlen("http://")) != 0)
+    {
+        return -1;
+    }
+    char *host = url + strlen("http://");
+    char *slash = strchr(host, '/');
+    // The host has to be terminated, but the path needs its slash
+    static char path[1024];
+    snprintf(path, sizeof(path), "%s", slash != NULL ? slash : "/");
+    if (slash != NULL)
+    {
+        *slash = '\0';
+    }
+    char *colon = strchr(host, ':');
+    if (colon != NULL)
+    {
+        *colon = '\0';
+        opts->port = colon + 1;
+    }
+    else
+    {
+        opts->port = "80";
+    }
+    if (*host == '\0' || *opts->port == '\0')
+    {
+        return -1;
+    }
+    opts->host = host;
+    opts->path = path;
+    return 0;
+}
+
+/**
+ * Parse a mode option.
+ * @param arg The argument "on", "off" or "both".
+ * @param on Set if the feature should be benchmarked on.
+ * @param off Set if the feature should be benchmarked off.
+ **/
+static void parse_mode(const char *arg, bool *on, bool *off)
+{
+    *on = strcmp(arg, "on") == 0 || strcmp(arg, "both") == 0;
+    *off = strcmp(arg, "off") == 0 || strcmp(arg, "both") == 0;
+    if (!*on && !*off)
+    {
+        usage();
+    }
+}
+
+/**
+ * Parse a number option.
+ * @return The number, the program exits if it isn't in [min, max].
+ **/
+static long parse_number(const char *arg, long min, long max)
+{
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || value < min ||
+        value > max)
+    {
+        usage();
+    }
+    return value;
+}
+
+/**
+ * Open a connection.
+ * @brief Start a non-blocking connect and register the socket with epoll.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int open_connection(int epollfd, struct connection *conn,
+                           struct results *res)
+{
+    conn->fd = socket(server_addr->ai_family,
+                      server_addr->ai_socktype | SOCK_NONBLOCK,
+                      server_addr->ai_protocol);
+    if (conn->fd == -1)
+    {
+        return -1;
+    }
+    conn->start = now_us();
+    conn->state = STATE_CONNECT;
+    conn->sent = 0;
+    res->connects++;
+
+    if (connect(conn->fd, server_addr->ai_addr, server_addr->ai_addrlen) == -1 &&
+        errno != EINPROGRESS)
+    {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLOUT;
+    ev.data.ptr = conn;
+    if (epoll_ctl(epollfd, EPOLL_CTL_ADD, conn->fd, &ev) == -1)
+    {
+        close(conn->fd);
+        conn->fd = -1;
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * Close a connection.
+ **/
+static void close_connection(struct connection *conn)
+{
+    if (conn->fd != -1)
+    {
+        close(conn->fd);
+        conn->fd = -1;
+    }
+}
+
+/**
+ * Wait for different events.
+ * @param writable Wait until the socket is writeable instead of readable.
+ **/
+static void watch_connection(int epollfd, struct connection *conn,
+                             bool writable)
+{
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = writable ? EPOLLOUT : EPOLLIN;
+    ev.data.ptr = conn;
+    epoll_ctl(epollfd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+/**
+ * Start a new request.
+ * @brief Reset the response state, the latency is measured from now on.
+ **/
+static void begin_request(struct connection *conn)
+{
+    conn->state = STATE_SEND;
+    conn->sent = 0;
+    conn->header_len = 0;
+    conn->chunked = false;
+    conn->until_close = false;
+    conn->server_closes = false;
+    conn->body_left = 0;
+    conn->line_len = 0;
+}
+
+/**
+ * Parse a response header.
+ * @brief Check the status and find out how the body is delimited.
+ * @param conn The connection whose header is complete.
+ * @param res The results which count a bad status.
+ **/
+static void parse_response(struct connection *conn, struct results *res)
+{
+    conn->header[conn->header_len] = '\0';
+    if (strncmp(conn->header, "HTTP/1.1 200 ", strlen("HTTP/1.1 200 ")) != 0)
+    {
+        res->bad_status++;
+    }
+
+    bool has_length = false;
+    char *save;
+    char *line = strtok_r(conn->header, "\r\n", &save);
+    while ((line = strtok_r(NULL, "\r\n", &save)) != NULL)
+    {
+        if (strncasecmp(line, "Content-Length:", strlen("Content-Length:")) == 0)
+        {
+            conn->body_left = strtoull(line + strlen("Content-Length:"), NULL, 10);
+            has_length = true;
+        }
+        else if (strncasecmp(line, "Transfer-Encoding:", strlen("Transfer-Encoding:")) == 0 &&
+                 strstr(line, "chunked") != NULL)
+        {
+            conn->chunked = true;
+        }
+        else if (strncasecmp(line, "Connection:", strlen("Connection:")) == 0 &&
+                 strstr(line, "close") != NULL)
+        {
+            conn->server_closes = true;
+        }
+    }
+
+    if (conn->chunked)
+    {
+        conn->state = STATE_CHUNK_SIZE;
+    }
+    else if (has_length)
+    {
+        conn->state = STATE_BODY;
+    }
+    else
+    {
+        // Without a length the body ends when the server closes
+        conn->until_close = true;
+        conn->server_closes = true;
+        conn->state = STATE_BODY;
+    }
+}
+
+/**
+ * Read a line of the chunked encoding.
+ * @return The number of bytes consumed, the line is complete if line_len
+ * ends with a newline.
+ **/
+static size_t read_line(struct connection *conn, const char *data, size_t len)
+{
+    size_t i = 0;
+    while (i < len)
+    {
+        char c = data[i++];
+        if (conn->line_len < sizeof(conn->line) - 1)
+        {
+            conn->line[conn->line_len++] = c;
+        }
+        if (c == '\n')
+        {
+            conn->line[conn->line_len] = '\0';
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * Consume body bytes.
+ * @brief Walk through the received bytes of the body.
+ * @return 1 if the response is complete, 0 if more bytes are needed and -1
+ * if the response is malformed.
+ **/
+static int consume_body(struct connection *conn, const char *data, size_t len)
+{
+    size_t pos = 0;
+    while (pos < len || (conn->state == STATE_BODY && conn->body_left == 0 &&
+                         !conn->until_close))
+    {
+        switch (conn->state)
+        {
+        case STATE_BODY:
+            if (conn->until_close)
+            {
+                return 0;
+            }
+            if ((uint64_t)(len - pos) >= conn->body_left)
+            {
+                return 1;
+            }
+            conn->body_left -= len - pos;
+            return 0;
+
+        case STATE_CHUNK_SIZE:
+        case STATE_CHUNK_END:
+        case STATE_TRAILER:
+            pos += read_line(conn, data + pos, len - pos);
+            if (conn->line_len == 0 || conn->line[conn->line_len - 1] != '\n')
+            {
+                return 0;
+            }
+            if (conn->state == STATE_CHUNK_SIZE)
+            {
+                char *end;
+                conn->body_left = strtoull(conn->line, &end, 16);
+                if (end == conn->line)
+                {
+                    return -1;
+                }
+                conn->state = conn->body_left == 0 ? STATE_TRAILER : STATE_CHUNK_DATA;
+            }
+            else if (conn->state == STATE_CHUNK_END)
+            {
+                conn->state = STATE_CHUNK_SIZE;
+            }
+            else if (strcmp(conn->line, "\r\n") == 0 || strcmp(conn->line, "\n") == 0)
+            {
+                return 1;
+            }
+            conn->line_len = 0;
+            break;
+
+        case STATE_CHUNK_DATA:
+        {
+            size_t take = len - pos;
+            if ((uint64_t)take > conn->body_left)
+            {
+                take = conn->body_left;
+            }
+            pos += take;
+            conn->body_left -= take;
+            if (conn->body_left == 0)
+            {
+                conn->state = STATE_CHUNK_END;
+            }
+            break;
+        }
+
+        default:
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Finish a request.
+ * @brief Record the latency and start the next request, on the same
+ * connection if possible.
+ * @param reuse Whether the connection can be used for another request.
+ **/
+static void finish_request(int epollfd, struct connection *conn,
+                           struct results *res, bool reuse)
+{
+    histogram_record(&res->latency, now_us() - conn->start);
+    res->requests++;
+
+    if (reuse && keep_alive && !conn->server_closes)
+    {
+        begin_request(conn);
+        conn->start = now_us();
+        watch_connection(epollfd, conn, true);
+        return;
+    }
+    close_connection(conn);
+    if (open_connection(epollfd, conn, res) == -1)
+    {
+        res->errors++;
+    }
+}
+
+/**
+ * Fail a request.
+ * @brief Count the error and retry on a new connection.
+ **/
+static void fail_request(int epollfd, struct connection *conn,
+                         struct results *res)
+{
+    res->errors++;
+    close_connection(conn);
+    if (open_connection(epollfd, conn, res) == -1)
+    {
+        res->errors++;
+    }
+}
+
+/**
+ * Handle an event of a connection.
+ **/
+static void handle_connection(int epollfd, struct connection *conn,
+                              struct results *res)
+{
+    if (conn->state == STATE_CONNECT)
+    {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        if (getsockopt(conn->fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1 ||
+            err != 0)
+        {
+            fail_request(epollfd, conn, res);
+            return;
+        }
+        // The latency of a new connection includes the connect
+        uint64_t start = conn->start;
+        begin_request(conn);
+        conn->start = start;
+    }
+
+    if (conn->state == STATE_SEND)
+    {
+        while (conn->sent < request_len)
+        {
+            ssize_t n = send(conn->fd, request + conn->sent,
+                             request_len - conn->sent, MSG_NOSIGNAL);
+            if (n == -1)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    watch_connection(epollfd, conn, true);
+                    return;
+                }
+                fail_request(epollfd, conn, res);
+                return;
+            }
+            conn->sent += n;
+        }
+        conn->state = STATE_HEADER;
+        watch_connection(epollfd, conn, false);
+        return;
+    }
+
+    char buffer[BUFFER_SIZE];
+    while (true)
+    {
+        ssize_t n = recv(conn->fd, buffer, sizeof(buffer), 0);
+        if (n == -1 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return;
+        }
+        if (n == 0 && conn->state == STATE_BODY && conn->until_close)
+        {
+            finish_request(epollfd, conn, res, false);
+            return;
+        }
+        if (n <= 0)
+        {
+            fail_request(epollfd, conn, res);
+            return;
+        }
+        res->bytes += n;
+
+        size_t pos = 0;
+        if (conn->state == STATE_HEADER)
+        {
+            // Copy byte by byte until the empty line, the rest is body
+            while (pos < (size_t)n && conn->header_len < HEADER_SIZE - 1)
+            {
+                conn->header[conn->header_len++] = buffer[pos++];
+                if (conn->header_len >= 4 &&
+                    memcmp(conn->header + conn->header_len - 4, "\r\n\r\n", 4) == 0)
+                {
+                    break;
+                }
+            }
+            if (conn->header_len < 4 ||
+                memcmp(conn->header + conn->header_len - 4, "\r\n\r\n", 4) != 0)
+            {
+                if (conn->header_len == HEADER_SIZE - 1)
+                {
+                    fail_request(epollfd, conn, res);
+                    return;
+                }
+                continue;
+            }
+            parse_response(conn, res);
+        }
+
+        int ret = consume_body(conn, buffer + pos, n - pos);
+        if (ret == -1)
+        {
+            fail_request(epollfd, conn, res);
+            return;
+        }
+        if (ret == 1)
+        {
+            finish_request(epollfd, conn, res, true);
+            return;
+        }
+    }
+}
+
+/**
+ * Run one benchmark.
+ * @brief Keep all connections busy for the duration of the run.
+ * @return Upon success 0, otherwise -1.
+ **/
+static int run(const struct options *opts, bool gzip, struct results *res)
+{
+    request_len = snprintf(request, sizeof(request),
+                           "GET %s HTTP/1.1\r\nHost: %s\r\nConnection: %s\r\n%s\r\n",
+                           opts->path, opts->host,
+                           keep_alive ? "keep-alive" : "close",
+                           gzip ? "Accept-Encoding: gzip\r\n" : "");
+    memset(res, 0, sizeof(*res));
+
+    int epollfd = epoll_create1(0);
+    if (epollfd == -1)
+    {
+        return -1;
+    }
+    struct connection *conns = calloc(opts->connections, sizeof(struct connection));
+    if (conns == NULL)
+    {
+        close(epollfd);
+        return -1;
+    }
+
+    uint64_t begin = now_us();
+    uint64_t deadline = begin + (uint64_t)opts->duration * 1000000;
+    for (long i = 0; i < opts->connections; i++)
+    {
+        conns[i].fd = -1;
+        if (open_connection(epollfd, &conns[i], res) == -1)
+        {
+            res->errors++;
+        }
+    }
+
+    struct epoll_event events[MAX_EVENTS];
+    uint64_t now;
+    while ((now = now_us()) < deadline)
+    {
+        int timeout = (deadline - now) / 1000 + 1;
+        int n = epoll_wait(epollfd, events, MAX_EVENTS, timeout);
+        if (n == -1 && errno != EINTR)
+        {
+            break;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            handle_connection(epollfd, events[i].data.ptr, res);
+        }
+    }
+    res->seconds = (now_us() - begin) / 1e6;
+
+    for (long i = 0; i < opts->connections; i++)
+    {
+        close_connection(&conns[i]);
+    }
+    free(conns);
+    close(epollfd);
+    return 0;
+}
+
+/**
+ * Print the results of a run as one row of the table.
+ **/
+static void print_results(bool gzip, const struct results *res)
+{
+    const struct histogram *h = &res->latency;
+    printf("%-10s %-4s %10.0f %9.2f %8.3f %8.3f %8.3f %8.3f %8.3f %8lu %8lu %8lu\n",
+           keep_alive ? "keep-alive" : "close", gzip ? "gzip" : "-",
+           res->requests / res->seconds,
+           res->bytes / res->seconds / (1024 * 1024),
+           histogram_percentile(h, 50) / 1000.0,
+           histogram_percentile(h, 90) / 1000.0,
+           histogram_percentile(h, 99) / 1000.0,
+           histogram_percentile(h, 99.9) / 1000.0,
+           h->max / 1000.0, res->connects, res->errors, res->bad_status);
+}
+
+/**
+ * Program entry point.
+ **/
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+    struct options opts = {.connections = 16, .duration = 5};
+    bool keep_on = true, keep_off = true, gzip_on = true, gzip_off = true;
+
+    int c;
+    while ((c = getopt(argc, argv, "c:d:k:z:")) != -1)
+    {
+        switch (c)
+        {
+        case 'c':
+            opts.connections = parse_number(optarg, 1, MAX_CONNECTIONS);
+            break;
+        case 'd':
+            opts.duration = parse_number(optarg, 1, 3600);
+            break;
+        case 'k':
+            parse_mode(optarg, &keep_on, &keep_off);
+            break;
+        case 'z':
+            parse_mode(optarg, &gzip_on, &gzip_off);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc - 1 || parse_url(argv[optind], &opts) == -1)
+    {
+        usage();
+    }
+
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    int err = getaddrinfo(opts.host, opts.port, &hints, &server_addr);
+    if (err != 0)
+    {
+        fprintf(stderr, "[%s] ERROR: Unable to resolve %s: %s\n", prog_name,
+                opts.host, gai_strerror(err));
+        exit(EXIT_FAILURE);
+    }
+    signal(SIGPIPE, SIG_IGN);
+
+    printf("%ld connections, %ld s per run, GET %s from %s:%s\n\n",
+           opts.connections, opts.duration, opts.path, opts.host, opts.port);
+    printf("%-10s %-4s %10s %9s %8s %8s %8s %8s %8s %8s %8s %8s\n",
+           "connection", "enc", "req/s", "MiB/s", "p50 ms", "p90 ms",
+           "p99 ms", "p999 ms", "max ms", "connects", "errors", "non-200");
+
+    static struct results res;
+    for (int k = 0; k < 2; k++)
+    {
+        keep_alive = k == 0;
+        if ((keep_alive && !keep_on) || (!keep_alive && !keep_off))
+        {
+            continue;
+        }
+        for (int z = 0; z < 2; z++)
+        {
+            bool gzip = z == 1;
+            if ((gzip && !gzip_on) || (!gzip && !gzip_off))
+            {
+                continue;
+            }
+            if (run(&opts, gzip, &res) == -1)
+            {
+                fprintf(stderr, "[%s] ERROR: Unable to run the benchmark: %s\n",
+                        prog_name, strerror(errno));
+                freeaddrinfo(server_addr);
+                exit(EXIT_FAILURE);
+            }
+            print_results(gzip, &res);
+            fflush(stdout);
+        }
+    }
+
+    freeaddrinfo(server_addr);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,241 @@
+/**
+ * @file ringbench.c
+ * @date 20.02.2021
+ *
+ * @brief A micro-benchmark of the shmring module.
+ * @details Creates a ring, forks the writers, which each write a fixed number
+ * of records (optionally in batches), and reads all of them. Prints one CSV
+ * row with the backend, the geometry, the time and the records per second,
+ * so the backends can be compared without the noise of a search.
+ **/
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "shmring.h"
+
+/**
+ * @brief The name of the shared memory object.
+ */
+#define SHM_NAME "/osue_ringbench"
+
+/**
+ * @brief The most writers and the largest batch.
+ */
+#define MAX_WRITERS 64
+#define MAX_BATCH 1024
+
+/**
+ * @brief The largest record (in bytes).
+ */
+#define MAX_RECORD_SIZE 65536
+
+/**
+ * Structure of the benchmark configuration
+ */
+struct options
+{
+    enum shmring_backend backend;
+    long writers;
+    long records;
+    long size;
+    long capacity;
+    long batch;
+};
+
+/**
+ * @brief The name of the program, for error messages.
+ */
+static const char *prog_name;
+
+/**
+ * Print the usage and exit.
+ */
+static void usage(void)
+{
+    fprintf(stderr,
+            "Usage: %s [-b lockfree|semaphore] [-w WRITERS] [-n RECORDS] [-s SIZE] "
+            "[-c CAPACITY] [-B BATCH]\n",
+            prog_name);
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Print an error and exit.
+ */
+static void fail(const char *what)
+{
+    fprintf(stderr, "[%s] ERROR: %s: %s\n", prog_name, what, strerror(errno));
+    exit(EXIT_FAILURE);
+}
+
+/**
+ * Parse a number option.
+ * @return The number, the program exits if it isn't in [min, max].
+ */
+static long parse_number(const char *arg, long min, long max)
+{
+    char *end;
+    errno = 0;
+    long value = strtol(arg, &end, 10);
+    if (errno != 0 || *arg == '\0' || *end != '\0' || value < min || value > max)
+    {
+        usage();
+    }
+    return value;
+}
+
+/**
+ * Get the current time.
+ * @return The time of the monotonic clock in seconds.
+ */
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/**
+ * Run a writer.
+ * @brief Writes the records, every record starts with the number of the
+ * writer and a counter.
+ */
+static void run_writer(const struct options *opts, long id)
+{
+    struct shmring *ring = shmring_open(SHM_NAME, opts->size);
+    unsigned char *records = calloc(opts->batch, opts->size);
+    if (ring == NULL || records == NULL)
+    {
+        fail("Unable to open the ring");
+    }
+
+    for (long sent = 0; sent < opts->records; sent += opts->batch)
+    {
+        long count = opts->records - sent < opts->batch ? opts->records - sent : opts->batch;
+        for (long i = 0; i < count; i++)
+        {
+            uint32_t header[2] = {id, sent + i};
+            memcpy(records + i * opts->size, header, opts->size < 8 ? opts->size : 8);
+        }
+        if (shmring_write_batch(ring, records, count) == -1)
+        {
+            fail("Unable to write");
+        }
+    }
+
+    free(records);
+    shmring_close(ring);
+    exit(EXIT_SUCCESS);
+}
+
+/**
+ * Program entry point.
+ * @brief Runs the benchmark once and prints the result.
+ */
+int main(int argc, char *argv[])
+{
+    prog_name = argv[0];
+    struct options opts = {.backend = SHMRING_DEFAULT, .writers = 4, .records = 1000000,
+                           .size = 64, .capacity = 64, .batch = 1};
+
+    int c;
+    while ((c = getopt(argc, argv, "b:w:n:s:c:B:")) != -1)
+    {
+        switch (c)
+        {
+        case 'b':
+            if (strcmp(optarg, "lockfree") == 0)
+            {
+                opts.backend = SHMRING_LOCKFREE;
+            }
+            else if (strcmp(optarg, "semaphore") == 0)
+            {
+                opts.backend = SHMRING_SEMAPHORE;
+            }
+            else
+            {
+                usage();
+            }
+            break;
+        case 'w':
+            opts.writers = parse_number(optarg, 1, MAX_WRITERS);
+            break;
+        case 'n':
+            opts.records = parse_number(optarg, 1, INT32_MAX);
+            break;
+        case 's':
+            opts.size = parse_number(optarg, 1, MAX_RECORD_SIZE);
+            break;
+        case 'c':
+            opts.capacity = parse_number(optarg, 1, SHMRING_MAX_CAPACITY);
+            break;
+        case 'B':
+            opts.batch = parse_number(optarg, 1, MAX_BATCH);
+            break;
+        default:
+            usage();
+        }
+    }
+    if (optind != argc)
+    {
+        usage();
+    }
+
+    struct shmring_config config = {.record_size = opts.size, .capacity = opts.capacity,
+                                    .backend = opts.backend};
+    shm_unlink(SHM_NAME);
+    struct shmring *ring = shmring_create(SHM_NAME, &config);
+    unsigned char *records = malloc(MAX_BATCH * opts.size);
+    if (ring == NULL || records == NULL)
+    {
+        fail("Unable to create the ring");
+    }
+
+    double start = now();
+    for (long i = 0; i < opts.writers; i++)
+    {
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            fail("Unable to fork");
+        }
+        if (pid == 0)
+        {
+            run_writer(&opts, i);
+        }
+    }
+
+    long total = opts.writers * opts.records;
+    for (long received = 0; received < total;)
+    {
+        ssize_t n = shmring_read_batch(ring, records, opts.batch, NULL);
+        if (n == -1)
+        {
+            fail("Unable to read");
+        }
+        received += n;
+    }
+    double elapsed = now() - start;
+
+    int status;
+    while (wait(&status) > 0)
+    {
+    }
+    printf("backend,writers,records,size,capacity,batch,seconds,records_per_s\n");
+    printf("%s,%ld,%ld,%ld,%ld,%ld,%.3f,%.0f\n",
+           shmring_backend(ring) == SHMRING_LOCKFREE ? "lockfree" : "semaphore",
+           opts.writers, total, opts.size, opts.capacity, opts.batch, elapsed,
+           total / elapsed);
+
+    free(records);
+    shmring_close(ring);
+    return EXIT_SUCCESS;
+}
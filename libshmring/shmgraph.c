@@ -0,0 +1,554 @@
+/**
+ * @file shmgraph.c
+ * @date 20.02.2021
+ *
+ * @brief Implementation of the shmgraph module.
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shmgraph.h"
+
+/**
+ * @brief Marks a complete graph ("SGRF").
+ */
+#define MAGIC 0x53475246u
+
+/**
+ * @brief The arrays behind the header start at a multiple of this size.
+ */
+#define HEADER_SIZE 64
+
+/**
+ * @brief The size (in bytes) of the first read when a file is loaded.
+ */
+#define READ_CHUNK 65536
+
+/**
+ * Structure of the shared memory header
+ * @brief The size of the graph, which determines the offsets of the arrays.
+ * @details The creator writes magic last, so a generator that maps the graph
+ * too early sees no magic. Behind the header follow | labels | edges |
+ * out_offsets | out_targets | in_offsets | in_sources |, see layout.
+ */
+struct header
+{
+    uint32_t magic;
+    uint32_t num_vertices;
+    uint32_t num_edges;
+    size_t size;
+};
+
+struct shmgraph
+{
+    void *base;
+    size_t size;
+    char *name;
+    bool creator;
+    struct shmgraph_view view;
+};
+
+/**
+ * @brief Compute the size of a graph and point the view at its arrays.
+ * @param base The start of the shared memory, NULL to only compute the size.
+ * @return The size of the shared memory.
+ */
+static size_t layout(unsigned char *base, uint32_t num_vertices, uint32_t num_edges, struct shmgraph_view *view)
+{
+    // The edges come second, as they need the alignment of the arrays of uint32_t twice
+    size_t labels = HEADER_SIZE;
+    size_t edges = labels + ((size_t)num_vertices + num_vertices % 2) * sizeof(uint32_t);
+    size_t out_offsets = edges + (size_t)num_edges * sizeof(struct shmgraph_edge);
+    size_t out_targets = out_offsets + ((size_t)num_vertices + 1) * sizeof(uint32_t);
+    size_t in_offsets = out_targets + (size_t)num_edges * sizeof(uint32_t);
+    size_t in_sources = in_offsets + ((size_t)num_vertices + 1) * sizeof(uint32_t);
+    size_t size = in_sources + (size_t)num_edges * sizeof(uint32_t);
+
+    if (base != NULL)
+    {
+        view->num_vertices = num_vertices;
+        view->num_edges = num_edges;
+        view->labels = (const uint32_t *)(base + labels);
+        view->edges = (const struct shmgraph_edge *)(base + edges);
+        view->out_offsets = (const uint32_t *)(base + out_offsets);
+        view->out_targets = (const uint32_t *)(base + out_targets);
+        view->in_offsets = (const uint32_t *)(base + in_offsets);
+        view->in_sources = (const uint32_t *)(base + in_sources);
+    }
+    return size;
+}
+
+/**
+ * @brief Read a whole file into memory.
+ * @param file The file.
+ * @param len The destination for the number of bytes read.
+ * @return Upon success the contents with a terminating '\0', which the
+ * caller must free, otherwise NULL.
+ */
+static char *read_file(FILE *file, size_t *len)
+{
+    size_t capacity = READ_CHUNK;
+    size_t used = 0;
+    char *data = malloc(capacity + 1);
+    if (data == NULL)
+    {
+        return NULL;
+    }
+
+    size_t n;
+    while ((n = fread(data + used, 1, capacity - used, file)) > 0)
+    {
+        used += n;
+        if (used == capacity)
+        {
+            char *grown = realloc(data, 2 * capacity + 1);
+            if (grown == NULL)
+            {
+                free(data);
+                return NULL;
+            }
+            data = grown;
+            capacity *= 2;
+        }
+    }
+    if (ferror(file))
+    {
+        free(data);
+        errno = EIO;
+        return NULL;
+    }
+
+    data[used] = '\0';
+    *len = used;
+    return data;
+}
+
+/**
+ * @brief Parse a decimal vertex label.
+ * @param pos The position to start at, gets advanced behind the label.
+ * @param label The destination for the label.
+ * @return true if there is a label of at most UINT32_MAX, otherwise false.
+ */
+static bool parse_label(const char **pos, uint32_t *label)
+{
+    const char *p = *pos;
+    uint64_t value = 0;
+    if (*p < '0' || *p > '9')
+    {
+        return false;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        value = value * 10 + (*p++ - '0');
+        if (value > UINT32_MAX)
+        {
+            return false;
+        }
+    }
+    *pos = p;
+    *label = value;
+    return true;
+}
+
+/**
+ * @brief Parse a text edge list.
+ * @return Upon success the number of edges, otherwise -1 and errno is set.
+ */
+static ssize_t parse_text(const char *text, struct shmgraph_edge **edges)
+{
+    size_t count = 0;
+    size_t capacity = 1024;
+    struct shmgraph_edge *list = malloc(capacity * sizeof(struct shmgraph_edge));
+    if (list == NULL)
+    {
+        return -1;
+    }
+
+    const char *p = text;
+    for (;;)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+        {
+            p++;
+        }
+        if (*p == '#')
+        {
+            while (*p != '\0' && *p != '\n')
+            {
+                p++;
+            }
+            continue;
+        }
+        if (*p == '\0')
+        {
+            break;
+        }
+
+        struct shmgraph_edge edge;
+        if (!parse_label(&p, &edge.u) || *p++ != '-' || !parse_label(&p, &edge.v) ||
+            (*p != '\0' && *p != ' ' && *p != '\t' && *p != '\n' && *p != '\r' && *p != '#'))
+        {
+            free(list);
+            errno = EINVAL;
+            return -1;
+        }
+        if (count == SHMGRAPH_MAX_EDGES)
+        {
+            free(list);
+            errno = EFBIG;
+            return -1;
+        }
+        if (count == capacity)
+        {
+            struct shmgraph_edge *grown = realloc(list, 2 * capacity * sizeof(struct shmgraph_edge));
+            if (grown == NULL)
+            {
+                free(list);
+                return -1;
+            }
+            list = grown;
+            capacity *= 2;
+        }
+        list[count++] = edge;
+    }
+
+    *edges = list;
+    return count;
+}
+
+/**
+ * @brief Parse a binary edge list, the magic is already checked.
+ * @return Upon success the number of edges, otherwise -1 and errno is set.
+ */
+static ssize_t parse_binary(const char *data, size_t len, struct shmgraph_edge **edges)
+{
+    size_t bytes = len - strlen(SHMGRAPH_BINARY_MAGIC);
+    if (bytes % sizeof(struct shmgraph_edge) != 0)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    size_t count = bytes / sizeof(struct shmgraph_edge);
+    if (count > SHMGRAPH_MAX_EDGES)
+    {
+        errno = EFBIG;
+        return -1;
+    }
+
+    // Never NULL, an empty list is rejected by the caller and freed
+    struct shmgraph_edge *list = malloc(bytes + 1);
+    if (list == NULL)
+    {
+        return -1;
+    }
+    memcpy(list, data + strlen(SHMGRAPH_BINARY_MAGIC), bytes);
+    *edges = list;
+    return count;
+}
+
+int shmgraph_load(const char *path, struct shmgraph_edge **edges, size_t *count)
+{
+    bool use_stdin = strcmp(path, "-") == 0;
+    FILE *file = use_stdin ? stdin : fopen(path, "rb");
+    if (file == NULL)
+    {
+        return -1;
+    }
+
+    size_t len;
+    char *data = read_file(file, &len);
+    int err = errno;
+    if (!use_stdin)
+    {
+        fclose(file);
+    }
+    if (data == NULL)
+    {
+        errno = err;
+        return -1;
+    }
+
+    // Anything else with a '\0' is neither a text edge list nor complete
+    size_t magic_len = strlen(SHMGRAPH_BINARY_MAGIC);
+    ssize_t n;
+    if (len >= magic_len && memcmp(data, SHMGRAPH_BINARY_MAGIC, magic_len) == 0)
+    {
+        n = parse_binary(data, len, edges);
+    }
+    else if (memchr(data, '\0', len) != NULL)
+    {
+        errno = EINVAL;
+        n = -1;
+    }
+    else
+    {
+        n = parse_text(data, edges);
+    }
+    err = errno;
+    free(data);
+
+    if (n == 0)
+    {
+        free(*edges);
+        err = EINVAL;
+        n = -1;
+    }
+    if (n == -1)
+    {
+        errno = err;
+        return -1;
+    }
+    *count = n;
+    return 0;
+}
+
+/**
+ * @brief Compare two labels for qsort.
+ */
+static int compare_labels(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *)a;
+    uint32_t y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+/**
+ * @brief Find the index of a label in the sorted labels.
+ */
+static uint32_t find_label(const uint32_t *labels, uint32_t num_vertices, uint32_t label)
+{
+    uint32_t low = 0;
+    uint32_t high = num_vertices;
+    while (high - low > 1)
+    {
+        uint32_t mid = low + (high - low) / 2;
+        if (labels[mid] <= label)
+        {
+            low = mid;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low;
+}
+
+/**
+ * @brief Build one CSR array with a counting sort.
+ * @param edges The edges with vertex indices.
+ * @param reverse false for the successors (rows by u), true for the
+ * predecessors (rows by v).
+ * @param next A scratch array of num_vertices elements.
+ */
+static void build_rows(const struct shmgraph_edge *edges, bool reverse, uint32_t num_vertices, uint32_t num_edges,
+                       uint32_t *offsets, uint32_t *entries, uint32_t *next)
+{
+    memset(offsets, 0, ((size_t)num_vertices + 1) * sizeof(uint32_t));
+    for (uint32_t i = 0; i < num_edges; i++)
+    {
+        offsets[(reverse ? edges[i].v : edges[i].u) + 1]++;
+    }
+    for (uint32_t x = 0; x < num_vertices; x++)
+    {
+        offsets[x + 1] += offsets[x];
+        next[x] = offsets[x];
+    }
+    for (uint32_t i = 0; i < num_edges; i++)
+    {
+        if (reverse)
+        {
+            entries[next[edges[i].v]++] = edges[i].u;
+        }
+        else
+        {
+            entries[next[edges[i].u]++] = edges[i].v;
+        }
+    }
+}
+
+struct shmgraph *shmgraph_create(const char *name, const struct shmgraph_edge *edges, size_t count)
+{
+    if (count < 1 || count > SHMGRAPH_MAX_EDGES)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // Every edge has two labels, so the sorted unique labels fit into 2*count
+    uint32_t *labels = malloc(2 * count * sizeof(uint32_t));
+    if (labels == NULL)
+    {
+        return NULL;
+    }
+    for (size_t i = 0; i < count; i++)
+    {
+        labels[2 * i] = edges[i].u;
+        labels[2 * i + 1] = edges[i].v;
+    }
+    qsort(labels, 2 * count, sizeof(uint32_t), compare_labels);
+    uint32_t num_vertices = 1;
+    for (size_t i = 1; i < 2 * count; i++)
+    {
+        if (labels[i] != labels[num_vertices - 1])
+        {
+            labels[num_vertices++] = labels[i];
+        }
+    }
+
+    struct shmgraph *graph = malloc(sizeof(struct shmgraph));
+    uint32_t *next = malloc(((size_t)num_vertices) * sizeof(uint32_t));
+    if (graph == NULL || next == NULL || (graph->name = strdup(name)) == NULL)
+    {
+        int err = errno;
+        free(next);
+        free(graph);
+        free(labels);
+        errno = err;
+        return NULL;
+    }
+    graph->size = layout(NULL, num_vertices, count, NULL);
+    graph->creator = true;
+
+    // Only readable, the descriptor of the creator is writable nevertheless
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0400);
+    if (fd == -1)
+    {
+        int err = errno;
+        free(graph->name);
+        free(graph);
+        free(next);
+        free(labels);
+        errno = err;
+        return NULL;
+    }
+    if (ftruncate(fd, graph->size) == -1 ||
+        (graph->base = mmap(NULL, graph->size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+    {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        free(graph->name);
+        free(graph);
+        free(next);
+        free(labels);
+        errno = err;
+        return NULL;
+    }
+    close(fd);
+
+    // The view is const, so the creator fills the arrays through the same offsets
+    struct header *shm = graph->base;
+    layout(graph->base, num_vertices, count, &graph->view);
+    uint32_t *shm_labels = (uint32_t *)graph->view.labels;
+    struct shmgraph_edge *shm_edges = (struct shmgraph_edge *)graph->view.edges;
+
+    memcpy(shm_labels, labels, (size_t)num_vertices * sizeof(uint32_t));
+    free(labels);
+    for (size_t i = 0; i < count; i++)
+    {
+        shm_edges[i].u = find_label(shm_labels, num_vertices, edges[i].u);
+        shm_edges[i].v = find_label(shm_labels, num_vertices, edges[i].v);
+    }
+    build_rows(shm_edges, false, num_vertices, count,
+               (uint32_t *)graph->view.out_offsets, (uint32_t *)graph->view.out_targets, next);
+    build_rows(shm_edges, true, num_vertices, count,
+               (uint32_t *)graph->view.in_offsets, (uint32_t *)graph->view.in_sources, next);
+    free(next);
+
+    shm->num_vertices = num_vertices;
+    shm->num_edges = count;
+    shm->size = graph->size;
+    __atomic_store_n(&shm->magic, MAGIC, __ATOMIC_RELEASE);
+
+    // The creator doesn't change the graph anymore either
+    mprotect(graph->base, graph->size, PROT_READ);
+    return graph;
+}
+
+struct shmgraph *shmgraph_open(const char *name)
+{
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t)st.st_size < HEADER_SIZE)
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    struct shmgraph *graph = malloc(sizeof(struct shmgraph));
+    if (graph == NULL || (graph->name = strdup(name)) == NULL)
+    {
+        int err = errno;
+        free(graph);
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    graph->size = st.st_size;
+    graph->creator = false;
+    graph->base = mmap(NULL, graph->size, PROT_READ, MAP_SHARED, fd, 0);
+    int err = errno;
+    close(fd);
+    if (graph->base == MAP_FAILED)
+    {
+        free(graph->name);
+        free(graph);
+        errno = err;
+        return NULL;
+    }
+
+    const struct header *shm = graph->base;
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != MAGIC ||
+        shm->num_edges < 1 || shm->num_edges > SHMGRAPH_MAX_EDGES ||
+        shm->num_vertices < 1 || shm->num_vertices > 2 * shm->num_edges ||
+        shm->size != graph->size || layout(NULL, shm->num_vertices, shm->num_edges, NULL) != graph->size)
+    {
+        munmap(graph->base, graph->size);
+        free(graph->name);
+        free(graph);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    layout(graph->base, shm->num_vertices, shm->num_edges, &graph->view);
+    return graph;
+}
+
+const struct shmgraph_view *shmgraph_view(struct shmgraph *graph)
+{
+    return &graph->view;
+}
+
+int shmgraph_close(struct shmgraph *graph)
+{
+    int ret = munmap(graph->base, graph->size);
+    if (graph->creator && shm_unlink(graph->name) == -1)
+    {
+        ret = -1;
+    }
+    free(graph->name);
+    free(graph);
+    return ret;
+}
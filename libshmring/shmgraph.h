@@ -0,0 +1,134 @@
+/**
+ * @file shmgraph.h
+ * @date 20.02.2021
+ *
+ * @brief A graph in a read-only shared memory object, which the supervisor
+ * loads once and the generators map instead of parsing their arguments.
+ *
+ * The shmgraph module. The supervisor reads a graph file (a text or a
+ * binary edge list, see shmgraph_load), the vertex labels are compacted into
+ * indices 0 to num_vertices-1 and the edges are stored both as a list and as
+ * compressed sparse rows (CSR) of the successors and of the predecessors of
+ * every vertex. The supervisor creates the object once and the generators
+ * map it read-only, so starting a generator costs the same for every graph
+ * size and no graph runs into the limit of the argument length.
+ *
+ * The supervisor must create the graph before the ring (see shmring.h), so a
+ * generator that found the ring always finds the whole graph.
+ **/
+
+#ifndef SHMGRAPH_H
+#define SHMGRAPH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief The most edges a graph can have.
+ */
+#define SHMGRAPH_MAX_EDGES (UINT32_C(1) << 28)
+
+/**
+ * @brief The first bytes of a binary edge list, after which follow the edges
+ * as pairs of uint32_t (u, v) in the byte order of the machine.
+ */
+#define SHMGRAPH_BINARY_MAGIC "EDGES32\n"
+
+/**
+ * Structure of an edge
+ * @brief A directed edge from u to v. Depending on the function these are
+ * vertex labels (as in the file) or vertex indices.
+ */
+struct shmgraph_edge
+{
+    uint32_t u;
+    uint32_t v;
+};
+
+/**
+ * Structure of the view on a graph
+ * @brief Pointers into the shared memory, which is read-only.
+ * @details labels holds the label of every vertex index in ascending order.
+ * edges holds the edges with vertex indices in the order of the file,
+ * duplicates and loops included. The successors of vertex x are
+ * out_targets[out_offsets[x]] up to out_targets[out_offsets[x+1]-1], the
+ * predecessors in_sources[in_offsets[x]] up to in_sources[in_offsets[x+1]-1],
+ * both in the order of the edges. An undirected graph (the 3coloring) uses
+ * both rows of a vertex as its neighbours.
+ */
+struct shmgraph_view
+{
+    uint32_t num_vertices;
+    uint32_t num_edges;
+    const uint32_t *labels;
+    const struct shmgraph_edge *edges;
+    const uint32_t *out_offsets;
+    const uint32_t *out_targets;
+    const uint32_t *in_offsets;
+    const uint32_t *in_sources;
+};
+
+/**
+ * @brief The graph as seen by one process.
+ * @details This is an opaque struct, its contents are in the view.
+ */
+struct shmgraph;
+
+/**
+ * Load an edge list.
+ * @brief Read the edges of a graph file with their vertex labels.
+ * @details A file starting with SHMGRAPH_BINARY_MAGIC is a binary edge list,
+ * any other file is text: edges "u-v" with decimal labels, separated by
+ * whitespace, and comments from '#' to the end of the line. The caller must
+ * free the edges.
+ * @param path The path of the file, "-" for stdin.
+ * @param edges The destination for the edges.
+ * @param count The destination for the number of edges.
+ * @return Upon success 0, otherwise -1 and errno is set (EINVAL if the file
+ * is malformed or has no edges, EFBIG if it has more than
+ * SHMGRAPH_MAX_EDGES).
+ */
+int shmgraph_load(const char *path, struct shmgraph_edge **edges, size_t *count);
+
+/**
+ * Create a graph.
+ * @brief Create the shared memory object and fill it with the graph.
+ * @details The labels are sorted and numbered, then both CSR arrays are
+ * built with a counting sort. The object is read-only for everybody but the
+ * creator, which must call shmgraph_close, which also removes the object.
+ * @param name The name of the shared memory object, with a leading slash.
+ * @param edges The edges with vertex labels, like from shmgraph_load.
+ * @param count The number of edges, 1 to SHMGRAPH_MAX_EDGES.
+ * @return Upon success the graph, otherwise NULL and errno is set (EEXIST if
+ * the object already exists, EINVAL if count is invalid).
+ */
+struct shmgraph *shmgraph_create(const char *name, const struct shmgraph_edge *edges, size_t count);
+
+/**
+ * Open a graph.
+ * @brief Map a graph some other process created, read-only.
+ * @details The caller must call shmgraph_close.
+ * @param name The name of the shared memory object.
+ * @return Upon success the graph, otherwise NULL and errno is set (ENOENT if
+ * there is no graph, EINVAL if it is not complete yet or malformed).
+ */
+struct shmgraph *shmgraph_open(const char *name);
+
+/**
+ * Get the view.
+ * @param graph The graph.
+ * @return The view on the graph, valid until shmgraph_close.
+ */
+const struct shmgraph_view *shmgraph_view(struct shmgraph *graph);
+
+/**
+ * Close a graph.
+ * @brief Unmap the graph, the creator also removes the shared memory
+ * object.
+ * @details Processes that still have it mapped keep their view.
+ * @param graph The graph, it is invalid afterwards.
+ * @return Upon success 0, otherwise -1.
+ */
+int shmgraph_close(struct shmgraph *graph);
+
+#endif
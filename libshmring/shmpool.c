@@ -0,0 +1,326 @@
+/**
+ * @file shmpool.c
+ * @date 20.02.2021
+ *
+ * @brief Implementation of the shmpool module.
+ **/
+
+#define _GNU_SOURCE
+
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "shmpool.h"
+
+/**
+ * @brief The directory with a directory per CPU, which holds a link to the
+ * node of the CPU.
+ */
+#define CPU_DIRECTORY "/sys/devices/system/cpu"
+
+/**
+ * Structure of a process
+ * @brief Its id, its CPU (-1 if it isn't pinned) and whether it was reaped.
+ */
+struct process
+{
+    pid_t pid;
+    int cpu;
+    bool reaped;
+};
+
+/**
+ * Structure of a pool
+ * @brief The processes in the order they were forked.
+ */
+struct shmpool
+{
+    size_t count;
+    struct process processes[];
+};
+
+/**
+ * @brief The CPUs the caller could run on before shmpool_pin_self.
+ */
+static cpu_set_t allowed_before_pin;
+
+/**
+ * @brief Whether allowed_before_pin is set.
+ */
+static bool pinned_self = false;
+
+/**
+ * Get the node of a CPU.
+ * @brief Look for the link "nodeN" in the sysfs directory of the CPU.
+ * @param cpu The CPU.
+ * @return The node, or -1 if it is unknown.
+ */
+static int cpu_node(int cpu)
+{
+    char path[64];
+    snprintf(path, sizeof(path), CPU_DIRECTORY "/cpu%d", cpu);
+
+    DIR *directory = opendir(path);
+    if (directory == NULL)
+    {
+        return -1;
+    }
+
+    int node = -1;
+    struct dirent *entry;
+    while (node == -1 && (entry = readdir(directory)) != NULL)
+    {
+        if (sscanf(entry->d_name, "node%d", &node) != 1)
+        {
+            node = -1;
+        }
+    }
+    closedir(directory);
+    return node;
+}
+
+/**
+ * Order the CPUs.
+ * @brief List the CPUs the caller may run on: first those on its own node,
+ * then the others, its own CPU last.
+ * @details Within a group the CPUs are in ascending order.
+ * @param cpus The destination, of size CPU_SETSIZE.
+ * @return Upon success the number of CPUs, otherwise -1.
+ */
+static int order_cpus(int *cpus)
+{
+    cpu_set_t allowed;
+    if (pinned_self)
+    {
+        allowed = allowed_before_pin;
+    }
+    else if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        return -1;
+    }
+
+    int self = sched_getcpu();
+    int self_node = self == -1 ? -1 : cpu_node(self);
+
+    int count = 0;
+    for (int pass = 0; pass < 2; pass++)
+    {
+        for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+        {
+            if (!CPU_ISSET(cpu, &allowed) || cpu == self)
+            {
+                continue;
+            }
+            // Without nodes every CPU is taken in the first pass
+            bool local = self_node == -1 || cpu_node(cpu) == self_node;
+            if (local == (pass == 0))
+            {
+                cpus[count++] = cpu;
+            }
+        }
+    }
+
+    if (self != -1 && (CPU_ISSET(self, &allowed) || count == 0))
+    {
+        cpus[count++] = self;
+    }
+    return count == 0 ? -1 : count;
+}
+
+/**
+ * Reap the processes.
+ * @brief Wait for every process that wasn't reaped yet.
+ * @param pool The pool.
+ * @param sig The signal the processes were sent, 0 for none.
+ * @return Upon success the number of processes that failed, otherwise -1.
+ */
+static int reap(struct shmpool *pool, int sig)
+{
+    int failed = 0;
+    int result = 0;
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        struct process *process = &pool->processes[i];
+        if (process->reaped)
+        {
+            continue;
+        }
+
+        int status;
+        while (waitpid(process->pid, &status, 0) == -1)
+        {
+            if (errno != EINTR)
+            {
+                result = -1;
+                break;
+            }
+        }
+        if (result == -1)
+        {
+            break;
+        }
+        process->reaped = true;
+
+        bool ok = WIFEXITED(status) ? WEXITSTATUS(status) == 0 : (sig != 0 && WTERMSIG(status) == sig);
+        if (!ok)
+        {
+            failed++;
+        }
+    }
+    return result == -1 ? -1 : failed;
+}
+
+int shmpool_pin_self(void)
+{
+    cpu_set_t allowed;
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) == -1)
+    {
+        return -1;
+    }
+
+    int cpu = sched_getcpu();
+    if (cpu == -1)
+    {
+        return -1;
+    }
+
+    cpu_set_t self;
+    CPU_ZERO(&self);
+    CPU_SET(cpu, &self);
+    if (sched_setaffinity(0, sizeof(self), &self) == -1)
+    {
+        return -1;
+    }
+
+    if (!pinned_self)
+    {
+        allowed_before_pin = allowed;
+        pinned_self = true;
+    }
+    return cpu;
+}
+
+struct shmpool *shmpool_spawn(const struct shmpool_config *config)
+{
+    if (config->path == NULL || config->argv == NULL || config->count == 0 ||
+        config->count > SHMPOOL_MAX_PROCESSES)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int cpus[CPU_SETSIZE];
+    int cpu_count = 0;
+    if (config->pin && (cpu_count = order_cpus(cpus)) == -1)
+    {
+        return NULL;
+    }
+
+    struct shmpool *pool = malloc(sizeof(*pool) + config->count * sizeof(pool->processes[0]));
+    if (pool == NULL)
+    {
+        return NULL;
+    }
+    pool->count = 0;
+    pid_t parent = getpid();
+
+    for (size_t i = 0; i < config->count; i++)
+    {
+        int cpu = config->pin ? cpus[i % cpu_count] : -1;
+
+        pid_t pid = fork();
+        if (pid == -1)
+        {
+            int error = errno;
+            for (size_t j = 0; j < pool->count; j++)
+            {
+                kill(pool->processes[j].pid, SIGTERM);
+            }
+            reap(pool, SIGTERM);
+            free(pool);
+            errno = error;
+            return NULL;
+        }
+
+        if (pid == 0)
+        {
+            // A signal from the terminal only reaches the caller, which ends the pool itself
+            setpgid(0, 0);
+            if (prctl(PR_SET_PDEATHSIG, SIGTERM) == -1 || getppid() != parent)
+            {
+                _exit(127);
+            }
+            if (cpu != -1)
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                CPU_SET(cpu, &set);
+                if (sched_setaffinity(0, sizeof(set), &set) == -1)
+                {
+                    fprintf(stderr, "%s: cannot pin to cpu %d: %s\n", config->path, cpu, strerror(errno));
+                    _exit(127);
+                }
+            }
+            execv(config->path, config->argv);
+            fprintf(stderr, "%s: cannot execute: %s\n", config->path, strerror(errno));
+            _exit(127);
+        }
+
+        pool->processes[i] = (struct process){.pid = pid, .cpu = cpu, .reaped = false};
+        pool->count++;
+    }
+    return pool;
+}
+
+size_t shmpool_count(const struct shmpool *pool)
+{
+    return pool->count;
+}
+
+ssize_t shmpool_find(const struct shmpool *pool, pid_t pid)
+{
+    for (size_t i = 0; i < pool->count; i++)
+    {
+        if (pool->processes[i].pid == pid)
+        {
+            return i;
+        }
+    }
+    return -1;
+}
+
+pid_t shmpool_pid(const struct shmpool *pool, size_t index)
+{
+    return pool->processes[index].pid;
+}
+
+int shmpool_cpu(const struct shmpool *pool, size_t index)
+{
+    return pool->processes[index].cpu;
+}
+
+int shmpool_close(struct shmpool *pool, int sig)
+{
+    if (sig != 0)
+    {
+        for (size_t i = 0; i < pool->count; i++)
+        {
+            // A process that exited but wasn't reaped yet still takes the signal without harm
+            kill(pool->processes[i].pid, sig);
+        }
+    }
+
+    int result = reap(pool, sig);
+    int error = errno;
+    free(pool);
+    errno = error;
+    return result;
+}
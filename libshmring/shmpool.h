@@ -0,0 +1,120 @@
+/**
+ * @file shmpool.h
+ * @date 20.02.2021
+ *
+ * @brief A pool of generator processes the supervisor starts itself, each
+ * pinned to its own CPU.
+ *
+ * The shmpool module. Instead of a shell loop the supervisor forks and
+ * executes the generators, so it knows all of them and can place them: with
+ * pinning every generator gets one CPU the supervisor may run on. The CPUs
+ * of the NUMA node of the supervisor come first, so the generators poll the
+ * cache lines of the ring from the node its memory is on (see populate in
+ * shmring.h) as long as there are CPUs left there. The CPU of the supervisor
+ * itself comes last. The nodes are read from sysfs; without it the CPUs are
+ * taken in ascending order.
+ **/
+
+#ifndef SHMPOOL_H
+#define SHMPOOL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+/**
+ * @brief The most processes a pool can have.
+ */
+#define SHMPOOL_MAX_PROCESSES 1024
+
+/**
+ * Structure of the pool configuration
+ * @brief path is the program every process executes with the arguments argv
+ * (argv[0] included, NULL terminated), count the number of processes (1 to
+ * SHMPOOL_MAX_PROCESSES). If pin is set, process i is pinned to the i-th CPU
+ * of the order above, round-robin if there are more processes than CPUs.
+ */
+struct shmpool_config
+{
+    const char *path;
+    char *const *argv;
+    size_t count;
+    bool pin;
+};
+
+/**
+ * @brief The processes of a pool.
+ * @details This is an opaque struct.
+ */
+struct shmpool;
+
+/**
+ * Pin the caller.
+ * @brief Pin the calling process to the CPU it is running on.
+ * @details Call it before creating the ring, so the pages populate touches
+ * stay on the node of the caller. The CPUs the caller could run on before
+ * are remembered, so a pool spawned afterwards still uses all of them.
+ * @return Upon success the CPU, otherwise -1 and errno is set.
+ */
+int shmpool_pin_self(void);
+
+/**
+ * Spawn a pool.
+ * @brief Fork and execute count processes.
+ * @details If a fork fails, the processes forked so far are terminated again.
+ * Every process gets a process group of its own, like a background job of a
+ * shell, so SIGINT from the terminal only reaches the caller, and SIGTERM if
+ * the caller dies before closing the pool. A process that can't execute path prints why and exits with 127, which
+ * shmpool_close reports.
+ * @param config The processes to start.
+ * @return Upon success the pool, otherwise NULL and errno is set (EINVAL if
+ * the configuration is invalid).
+ */
+struct shmpool *shmpool_spawn(const struct shmpool_config *config);
+
+/**
+ * Get the number of processes.
+ * @param pool The pool.
+ * @return The number of processes, the count of the configuration.
+ */
+size_t shmpool_count(const struct shmpool *pool);
+
+/**
+ * Find a process.
+ * @param pool The pool.
+ * @param pid The process id.
+ * @return The index of the process, or -1 if it is not part of the pool.
+ */
+ssize_t shmpool_find(const struct shmpool *pool, pid_t pid);
+
+/**
+ * Get a process id.
+ * @param pool The pool.
+ * @param index The index of the process, below shmpool_count.
+ * @return The process id.
+ */
+pid_t shmpool_pid(const struct shmpool *pool, size_t index);
+
+/**
+ * Get the CPU of a process.
+ * @param pool The pool.
+ * @param index The index of the process, below shmpool_count.
+ * @return The CPU the process is pinned to, or -1 if it isn't pinned.
+ */
+int shmpool_cpu(const struct shmpool *pool, size_t index);
+
+/**
+ * Close a pool.
+ * @brief Send a signal to every process that is still running and wait for
+ * all of them.
+ * @details Call it after the ring was shut down, so the processes are on
+ * their way out anyway.
+ * @param pool The pool, it is invalid afterwards.
+ * @param sig The signal to send, 0 to only wait.
+ * @return Upon success the number of processes that failed (exited with
+ * another status than 0 or were killed by another signal than sig),
+ * otherwise -1 and errno is set.
+ */
+int shmpool_close(struct shmpool *pool, int sig);
+
+#endif
@@ -0,0 +1,802 @@
+/**
+ * @file shmring.c
+ * @date 20.02.2021
+ *
+ * @brief Implementation of the shmring module.
+ **/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "shmring.h"
+
+/**
+ * @brief The size (in bytes) of a cache line. Fields written by different
+ * processes are kept on seperate lines, so a write by one process doesn't
+ * invalidate the line another process is polling.
+ */
+#define CACHE_LINE_SIZE 64
+
+/**
+ * @brief The shared memory is rounded up to a multiple of this size (2 MiB)
+ * if hugepages are requested.
+ */
+#define HUGEPAGE_SIZE (2 * 1024 * 1024)
+
+/**
+ * @brief Marks an initialized ring ("SRNG").
+ */
+#define MAGIC 0x53524e47u
+
+/**
+ * @brief How often the reader polls an empty ring before it parks itself and
+ * how often a writer yields before it sleeps on a full ring.
+ */
+#define SPIN_LIMIT 64
+
+/**
+ * @brief How long (in nanoseconds) a writer sleeps between polls on a full
+ * ring.
+ */
+#define BACKOFF_NS 50000
+
+/**
+ * Structure of the shared memory header
+ * @brief The geometry, the state of both backends and the best-bound slot.
+ * @details The creator writes the geometry once and magic last, so a writer
+ * that maps the ring too early sees no magic. After the header follow the
+ * best record, the slots and the application area, each starting a cache
+ * line at the offsets in the header.
+ * Every group of fields written by a different party starts its own cache
+ * line: the flags (the creator and the writer that wakes it up), readpos
+ * (only the reader), writepos (the writers), the semaphores and the best
+ * bound (only the creator, polled by the writers).
+ */
+struct header
+{
+    uint32_t magic;
+    uint32_t backend;
+    pid_t creator;
+    size_t size;
+    size_t record_size;
+    size_t slot_size;
+    size_t capacity;
+    size_t extra_size;
+    size_t best_offset;
+    size_t slots_offset;
+    size_t extra_offset;
+
+    int alive __attribute__((aligned(CACHE_LINE_SIZE)));
+    unsigned int writers;
+    int reader_parked;
+    sem_t wake;
+
+    size_t readpos __attribute__((aligned(CACHE_LINE_SIZE)));
+    size_t writepos __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    sem_t free __attribute__((aligned(CACHE_LINE_SIZE)));
+    sem_t used __attribute__((aligned(CACHE_LINE_SIZE)));
+    sem_t mutex __attribute__((aligned(CACHE_LINE_SIZE)));
+
+    uint64_t best_bound __attribute__((aligned(CACHE_LINE_SIZE)));
+    uint64_t best_seq;
+    size_t best_len;
+};
+
+/**
+ * Structure of one slot
+ * @brief A slot holds one record of up to record_size bytes.
+ * @details In the lockfree backend the sequence number tells who may use the
+ * slot: if it is equal to the position a writer claimed, the slot is free,
+ * if it is one greater, it is filled and can be read. The semaphore backend
+ * doesn't need it.
+ */
+struct slot
+{
+    size_t seq;
+    size_t len;
+    unsigned char data[];
+};
+
+struct shmring
+{
+    struct header *shm;
+    unsigned char *best;
+    unsigned char *slots;
+    void *extra;
+    char *name;
+    bool creator;
+};
+
+/**
+ * @brief Round a size up to a multiple of align.
+ */
+static size_t round_up(size_t size, size_t align)
+{
+    return (size + align - 1) / align * align;
+}
+
+/**
+ * @brief Get the slot of a position.
+ */
+static struct slot *get_slot(struct shmring *ring, size_t pos)
+{
+    return (struct slot *)(ring->slots + pos % ring->shm->capacity * ring->shm->slot_size);
+}
+
+/**
+ * @brief Resolve SHMRING_DEFAULT.
+ * @return The backend, or SHMRING_DEFAULT if SHMRING_BACKEND is invalid.
+ */
+static enum shmring_backend resolve_backend(enum shmring_backend backend)
+{
+    if (backend != SHMRING_DEFAULT)
+    {
+        return backend;
+    }
+
+    const char *env = getenv("SHMRING_BACKEND");
+    if (env == NULL || *env == '\0' || strcmp(env, "lockfree") == 0)
+    {
+        return SHMRING_LOCKFREE;
+    }
+    if (strcmp(env, "semaphore") == 0)
+    {
+        return SHMRING_SEMAPHORE;
+    }
+    return SHMRING_DEFAULT;
+}
+
+/**
+ * @brief Map the shared memory object and set up the handle.
+ * @return Upon success the ring, otherwise NULL.
+ */
+static struct shmring *map_ring(const char *name, int fd, size_t size, bool creator)
+{
+    struct shmring *ring = malloc(sizeof(struct shmring));
+    if (ring == NULL)
+    {
+        return NULL;
+    }
+    ring->name = strdup(name);
+    ring->shm = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (ring->name == NULL || ring->shm == MAP_FAILED)
+    {
+        int err = errno;
+        free(ring->name);
+        free(ring);
+        errno = err;
+        return NULL;
+    }
+    ring->creator = creator;
+    return ring;
+}
+
+/**
+ * @brief Point the handle at the parts behind the header.
+ */
+static void locate(struct shmring *ring)
+{
+    unsigned char *base = (unsigned char *)ring->shm;
+    ring->best = base + ring->shm->best_offset;
+    ring->slots = base + ring->shm->slots_offset;
+    ring->extra = ring->shm->extra_size > 0 ? base + ring->shm->extra_offset : NULL;
+}
+
+struct shmring *shmring_create(const char *name, const struct shmring_config *config)
+{
+    enum shmring_backend backend = resolve_backend(config->backend);
+    if (config->record_size < 1 || config->capacity < 1 ||
+        config->capacity > SHMRING_MAX_CAPACITY || backend == SHMRING_DEFAULT)
+    {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    // | header | best record | slots | application area |
+    size_t slot_size = round_up(sizeof(struct slot) + config->record_size, CACHE_LINE_SIZE);
+    size_t best_offset = round_up(sizeof(struct header), CACHE_LINE_SIZE);
+    size_t slots_offset = best_offset + round_up(config->record_size, CACHE_LINE_SIZE);
+    size_t extra_offset = slots_offset + config->capacity * slot_size;
+    size_t size = extra_offset + config->extra_size;
+    if (config->hugepages)
+    {
+        size = round_up(size, HUGEPAGE_SIZE);
+    }
+
+    int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+    struct shmring *ring = NULL;
+    if (ftruncate(fd, size) == -1 || (ring = map_ring(name, fd, size, true)) == NULL)
+    {
+        int err = errno;
+        close(fd);
+        shm_unlink(name);
+        errno = err;
+        return NULL;
+    }
+    close(fd);
+
+#ifdef MADV_HUGEPAGE
+    // Only a hint, without hugepages the memory still works
+    if (config->hugepages)
+    {
+        madvise(ring->shm, size, MADV_HUGEPAGE);
+    }
+#endif
+
+    // Writing a zero allocates the page on the node of the creator and changes nothing else
+    if (config->populate)
+    {
+        size_t page_size = sysconf(_SC_PAGESIZE);
+        for (size_t offset = 0; offset < size; offset += page_size)
+        {
+            ((volatile unsigned char *)ring->shm)[offset] = 0;
+        }
+    }
+
+    // The object is new, so everything else is zero already
+    struct header *shm = ring->shm;
+    shm->backend = backend;
+    shm->creator = getpid();
+    shm->size = size;
+    shm->record_size = config->record_size;
+    shm->slot_size = slot_size;
+    shm->capacity = config->capacity;
+    shm->extra_size = config->extra_size;
+    shm->best_offset = best_offset;
+    shm->slots_offset = slots_offset;
+    shm->extra_offset = extra_offset;
+    shm->alive = 1;
+    shm->best_bound = SHMRING_NO_BOUND;
+    locate(ring);
+    for (size_t i = 0; i < config->capacity; i++)
+    {
+        get_slot(ring, i)->seq = i;
+    }
+
+    if (sem_init(&shm->wake, 1, 0) == -1 ||
+        sem_init(&shm->free, 1, config->capacity) == -1 ||
+        sem_init(&shm->used, 1, 0) == -1 ||
+        sem_init(&shm->mutex, 1, 1) == -1)
+    {
+        int err = errno;
+        shmring_close(ring);
+        errno = err;
+        return NULL;
+    }
+
+    __atomic_store_n(&shm->magic, MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+struct shmring *shmring_open(const char *name, size_t record_size)
+{
+    int fd = shm_open(name, O_RDWR, 0600);
+    if (fd == -1)
+    {
+        return NULL;
+    }
+
+    // The size tells how much to map, the header the rest of the geometry
+    struct stat st;
+    if (fstat(fd, &st) == -1)
+    {
+        int err = errno;
+        close(fd);
+        errno = err;
+        return NULL;
+    }
+    if ((size_t)st.st_size < sizeof(struct header))
+    {
+        close(fd);
+        errno = EINVAL;
+        return NULL;
+    }
+    struct shmring *ring = map_ring(name, fd, st.st_size, false);
+    int err = errno;
+    close(fd);
+    if (ring == NULL)
+    {
+        errno = err;
+        return NULL;
+    }
+
+    struct header *shm = ring->shm;
+    if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != MAGIC ||
+        shm->size != (size_t)st.st_size || shm->record_size != record_size ||
+        shm->capacity < 1 || shm->capacity > SHMRING_MAX_CAPACITY ||
+        shm->slot_size < sizeof(struct slot) + record_size ||
+        shm->best_offset < sizeof(struct header) ||
+        shm->best_offset + record_size > shm->slots_offset ||
+        shm->slots_offset + shm->capacity * shm->slot_size > shm->extra_offset ||
+        shm->extra_offset + shm->extra_size > shm->size ||
+        (shm->backend != SHMRING_LOCKFREE && shm->backend != SHMRING_SEMAPHORE))
+    {
+        munmap(shm, st.st_size);
+        free(ring->name);
+        free(ring);
+        errno = EINVAL;
+        return NULL;
+    }
+
+    locate(ring);
+    __atomic_add_fetch(&shm->writers, 1, __ATOMIC_RELAXED);
+    return ring;
+}
+
+/**
+ * @details The semaphores are not destroyed, writers may still wait on them
+ * until they see that the ring was shut down. They vanish with the object.
+ */
+int shmring_close(struct shmring *ring)
+{
+    int ret = 0;
+    if (ring->creator)
+    {
+        shmring_shutdown(ring);
+    }
+    else
+    {
+        __atomic_sub_fetch(&ring->shm->writers, 1, __ATOMIC_RELAXED);
+    }
+
+    if (munmap(ring->shm, ring->shm->size) == -1)
+    {
+        ret = -1;
+    }
+    if (ring->creator && shm_unlink(ring->name) == -1)
+    {
+        ret = -1;
+    }
+    free(ring->name);
+    free(ring);
+    return ret;
+}
+
+/**
+ * @brief Check whether the ring was shut down.
+ * @details A ring whose creator died without closing it counts as shut down
+ * too, so writers waiting for a free slot don't wait forever. Only checked
+ * on the slow path, as it needs a system call.
+ */
+static bool creator_gone(struct header *shm)
+{
+    return kill(shm->creator, 0) == -1 && errno == ESRCH;
+}
+
+/**
+ * @brief Wait on a semaphore until the deadline.
+ * @return The same as sem_wait.
+ */
+static int wait_semaphore(sem_t *sem, const struct timespec *deadline)
+{
+    return deadline == NULL ? sem_wait(sem) : sem_timedwait(sem, deadline);
+}
+
+/**
+ * @brief Wait till the slot of a position is free.
+ * @details Yields the processor for the first few polls and sleeps
+ * afterwards. A signal doesn't stop the wait, as the position is claimed
+ * already and the reader would wait for it forever.
+ * @return 0 if the slot is free, -1 if the ring was shut down.
+ */
+static int wait_free(struct shmring *ring, size_t pos)
+{
+    struct slot *slot = get_slot(ring, pos);
+    struct timespec backoff = {.tv_sec = 0, .tv_nsec = BACKOFF_NS};
+
+    for (int i = 0; __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos; i++)
+    {
+        if (!__atomic_load_n(&ring->shm->alive, __ATOMIC_RELAXED))
+        {
+            return -1;
+        }
+        if (i < SPIN_LIMIT)
+        {
+            sched_yield();
+            continue;
+        }
+        if (creator_gone(ring->shm))
+        {
+            return -1;
+        }
+        nanosleep(&backoff, NULL);
+    }
+    return 0;
+}
+
+/**
+ * @brief Fill a claimed slot and publish it to the reader.
+ */
+static void publish(struct shmring *ring, size_t pos, const void *record, size_t len)
+{
+    struct slot *slot = get_slot(ring, pos);
+    slot->len = len;
+    memcpy(slot->data, record, len);
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_SEQ_CST);
+}
+
+/**
+ * @brief Wake up the reader if it is parked.
+ * @details The check before the exchange keeps the line of the flag shared
+ * as long as the reader is busy.
+ */
+static void wake_reader(struct shmring *ring)
+{
+    struct header *shm = ring->shm;
+    if (__atomic_load_n(&shm->reader_parked, __ATOMIC_SEQ_CST) &&
+        __atomic_exchange_n(&shm->reader_parked, 0, __ATOMIC_SEQ_CST))
+    {
+        sem_post(&shm->wake);
+    }
+}
+
+/**
+ * @brief Write records with the lockfree backend.
+ * @details Claims all positions at once, every slot is published as soon as
+ * it is filled, so the reader can work on the first ones while later ones
+ * still wait for a free slot.
+ */
+static int write_lockfree(struct shmring *ring, const unsigned char *records,
+                          size_t count, size_t len)
+{
+    size_t pos = __atomic_fetch_add(&ring->shm->writepos, count, __ATOMIC_RELAXED);
+    for (size_t i = 0; i < count; i++)
+    {
+        if (wait_free(ring, pos + i) == -1)
+        {
+            errno = ECANCELED;
+            return -1;
+        }
+        publish(ring, pos + i, records + i * len, len);
+        wake_reader(ring);
+    }
+    return 0;
+}
+
+/**
+ * @brief Write records with the semaphore backend.
+ * @details Takes at most capacity free slots at a time, the slots are filled
+ * under the writer mutex. A writer that sees the shutdown passes it on to the
+ * next one waiting on free.
+ */
+static int write_semaphore(struct shmring *ring, const unsigned char *records,
+                           size_t count, size_t len)
+{
+    struct header *shm = ring->shm;
+    while (count > 0)
+    {
+        size_t chunk = count < shm->capacity ? count : shm->capacity;
+        for (size_t taken = 0; taken < chunk; taken++)
+        {
+            if (sem_wait(&shm->free) == -1 || !__atomic_load_n(&shm->alive, __ATOMIC_SEQ_CST))
+            {
+                int err = __atomic_load_n(&shm->alive, __ATOMIC_SEQ_CST) ? errno : ECANCELED;
+                size_t back = err == ECANCELED ? taken + 1 : taken;
+                for (size_t i = 0; i < back; i++)
+                {
+                    sem_post(&shm->free);
+                }
+                errno = err;
+                return -1;
+            }
+        }
+
+        while (sem_wait(&shm->mutex) == -1)
+        {
+            // The slots are taken, so finish the write
+        }
+        for (size_t i = 0; i < chunk; i++)
+        {
+            struct slot *slot = get_slot(ring, shm->writepos++);
+            slot->len = len;
+            memcpy(slot->data, records + i * len, len);
+        }
+        sem_post(&shm->mutex);
+        for (size_t i = 0; i < chunk; i++)
+        {
+            sem_post(&shm->used);
+        }
+
+        records += chunk * len;
+        count -= chunk;
+    }
+    return 0;
+}
+
+/**
+ * @brief Write records with the backend of the ring.
+ */
+static int write_records(struct shmring *ring, const void *records, size_t count, size_t len)
+{
+    if (!__atomic_load_n(&ring->shm->alive, __ATOMIC_RELAXED))
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    if (ring->shm->backend == SHMRING_LOCKFREE)
+    {
+        return write_lockfree(ring, records, count, len);
+    }
+    return write_semaphore(ring, records, count, len);
+}
+
+int shmring_write(struct shmring *ring, const void *record, size_t len)
+{
+    if (len > ring->shm->record_size)
+    {
+        errno = EINVAL;
+        return -1;
+    }
+    return write_records(ring, record, 1, len);
+}
+
+int shmring_write_batch(struct shmring *ring, const void *records, size_t count)
+{
+    return write_records(ring, records, count, ring->shm->record_size);
+}
+
+/**
+ * @brief Wait till the slot of the read position got filled.
+ * @details Polls the slot for a short while and afterwards parks on the wake
+ * semaphore. Before parking the reader announces it in reader_parked and
+ * checks the slot again, so a writer that fills the slot at the same time
+ * either is seen or sees the announcement and posts the semaphore.
+ * @param ring The ring.
+ * @param block Whether to wait at all.
+ * @param deadline When to give up, NULL to wait forever.
+ * @return 0 if the slot is filled, otherwise -1 and errno is set (EAGAIN if
+ * block is false).
+ */
+static int wait_filled(struct shmring *ring, bool block, const struct timespec *deadline)
+{
+    struct header *shm = ring->shm;
+    size_t pos = shm->readpos;
+    struct slot *slot = get_slot(ring, pos);
+
+    for (int i = 0; __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1; i++)
+    {
+        if (!block)
+        {
+            errno = EAGAIN;
+            return -1;
+        }
+        if (!__atomic_load_n(&shm->alive, __ATOMIC_RELAXED))
+        {
+            errno = ECANCELED;
+            return -1;
+        }
+        if (i < SPIN_LIMIT)
+        {
+            sched_yield();
+            continue;
+        }
+
+        __atomic_store_n(&shm->reader_parked, 1, __ATOMIC_SEQ_CST);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_SEQ_CST) == pos + 1)
+        {
+            // A left over post only causes one more loop later
+            __atomic_store_n(&shm->reader_parked, 0, __ATOMIC_SEQ_CST);
+            break;
+        }
+        if (wait_semaphore(&shm->wake, deadline) == -1)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Take the next record out of the ring.
+ * @param ring The ring.
+ * @param record The destination.
+ * @param block Whether to wait for a record.
+ * @param deadline When to give up, NULL to wait forever.
+ * @return The length of the record, otherwise -1 and errno is set.
+ */
+static ssize_t take(struct shmring *ring, void *record, bool block,
+                    const struct timespec *deadline)
+{
+    struct header *shm = ring->shm;
+    if (shm->backend == SHMRING_LOCKFREE)
+    {
+        if (wait_filled(ring, block, deadline) == -1)
+        {
+            return -1;
+        }
+    }
+    else if ((block ? wait_semaphore(&shm->used, deadline) : sem_trywait(&shm->used)) == -1)
+    {
+        return -1;
+    }
+    else if (!__atomic_load_n(&shm->alive, __ATOMIC_SEQ_CST))
+    {
+        // The post of the shutdown
+        sem_post(&shm->used);
+        errno = ECANCELED;
+        return -1;
+    }
+
+    size_t pos = shm->readpos;
+    struct slot *slot = get_slot(ring, pos);
+    size_t len = slot->len < shm->record_size ? slot->len : shm->record_size;
+    memcpy(record, slot->data, len);
+
+    // Free the slot for the next round
+    if (shm->backend == SHMRING_LOCKFREE)
+    {
+        __atomic_store_n(&slot->seq, pos + shm->capacity, __ATOMIC_RELEASE);
+        __atomic_store_n(&shm->readpos, pos + 1, __ATOMIC_RELAXED);
+    }
+    else
+    {
+        __atomic_store_n(&shm->readpos, pos + 1, __ATOMIC_RELAXED);
+        sem_post(&shm->free);
+    }
+    return len;
+}
+
+ssize_t shmring_read(struct shmring *ring, void *record, const struct timespec *deadline)
+{
+    if (!__atomic_load_n(&ring->shm->alive, __ATOMIC_RELAXED))
+    {
+        errno = ECANCELED;
+        return -1;
+    }
+    return take(ring, record, true, deadline);
+}
+
+ssize_t shmring_read_batch(struct shmring *ring, void *records, size_t max,
+                           const struct timespec *deadline)
+{
+    unsigned char *out = records;
+    size_t size = ring->shm->record_size;
+    if (shmring_read(ring, out, deadline) == -1)
+    {
+        return -1;
+    }
+
+    size_t count = 1;
+    while (count < max && take(ring, out + count * size, false, NULL) != -1)
+    {
+        count++;
+    }
+    return count;
+}
+
+/**
+ * @details The creator is the only one writing the slot, so the sequence
+ * number can't change between the two stores.
+ */
+void shmring_set_best(struct shmring *ring, uint64_t bound, const void *record, size_t len)
+{
+    struct header *shm = ring->shm;
+    uint64_t seq = shm->best_seq;
+    if (len > shm->record_size)
+    {
+        len = shm->record_size;
+    }
+
+    __atomic_store_n(&shm->best_seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    if (record != NULL)
+    {
+        memcpy(ring->best, record, len);
+    }
+    shm->best_len = record != NULL ? len : 0;
+    __atomic_store_n(&shm->best_bound, bound, __ATOMIC_RELAXED);
+    __atomic_store_n(&shm->best_seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+uint64_t shmring_best_bound(struct shmring *ring)
+{
+    return __atomic_load_n(&ring->shm->best_bound, __ATOMIC_RELAXED);
+}
+
+/**
+ * @details The length is clamped, in case the copy raced with a write and
+ * the retry didn't happen yet.
+ */
+bool shmring_read_best(struct shmring *ring, uint64_t *seen, void *record, size_t *len)
+{
+    struct header *shm = ring->shm;
+
+    for (;;)
+    {
+        uint64_t seq = __atomic_load_n(&shm->best_seq, __ATOMIC_ACQUIRE);
+        if (seq == *seen)
+        {
+            return false;
+        }
+        if (seq & 1)
+        {
+            sched_yield();
+            continue;
+        }
+
+        size_t copied = shm->best_len;
+        if (copied > shm->record_size)
+        {
+            copied = shm->record_size;
+        }
+        memcpy(record, ring->best, copied);
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shm->best_seq, __ATOMIC_RELAXED) == seq)
+        {
+            *seen = seq;
+            if (len != NULL)
+            {
+                *len = copied;
+            }
+            return true;
+        }
+    }
+}
+
+/**
+ * @details Every semaphore something may block on is posted once, whoever
+ * wakes up and sees the shutdown posts it again for the next one.
+ */
+void shmring_shutdown(struct shmring *ring)
+{
+    struct header *shm = ring->shm;
+    __atomic_store_n(&shm->alive, 0, __ATOMIC_SEQ_CST);
+    sem_post(&shm->free);
+    sem_post(&shm->used);
+    sem_post(&shm->wake);
+}
+
+bool shmring_alive(struct shmring *ring)
+{
+    return __atomic_load_n(&ring->shm->alive, __ATOMIC_RELAXED);
+}
+
+void *shmring_extra(struct shmring *ring)
+{
+    return ring->extra;
+}
+
+size_t shmring_capacity(struct shmring *ring)
+{
+    return ring->shm->capacity;
+}
+
+size_t shmring_pending(struct shmring *ring)
+{
+    struct header *shm = ring->shm;
+    if (shm->backend == SHMRING_SEMAPHORE)
+    {
+        int value;
+        sem_getvalue(&shm->used, &value);
+        return value > 0 ? value : 0;
+    }
+
+    size_t written = __atomic_load_n(&shm->writepos, __ATOMIC_RELAXED);
+    size_t read = __atomic_load_n(&shm->readpos, __ATOMIC_RELAXED);
+    size_t pending = written - read;
+    return pending < shm->capacity ? pending : shm->capacity;
+}
+
+unsigned int shmring_writers(struct shmring *ring)
+{
+    return __atomic_load_n(&ring->shm->writers, __ATOMIC_RELAXED);
+}
+
+enum shmring_backend shmring_backend(struct shmring *ring)
+{
+    return ring->shm->backend;
+}
@@ -0,0 +1,296 @@
+/**
+ * @file shmring.h
+ * @date 20.02.2021
+ *
+ * @brief A circular buffer of fixed-size records in shared memory, shared by
+ * the supervisor/generator programs of the second exercise.
+ *
+ * The shmring module. One process (the supervisor) creates the ring and is
+ * its only reader, any number of processes (the generators) open it and
+ * write records. Besides the records the shared memory holds a best-bound
+ * slot, in which the reader publishes the best record so far and a number
+ * the writers compare against (e.g. the number of edges of the best
+ * solution), a shutdown flag and an optional area the application uses for
+ * its own data.
+ *
+ * There are two backends with the same interface, the creator chooses one
+ * and the writers follow it:
+ * - lockfree: a writer claims a slot by atomically increasing the write
+ *   position and publishes it through the sequence number of the slot, the
+ *   reader polls for a while and only then parks on a semaphore.
+ * - semaphore: the classic free/used semaphores and a mutex for the writers.
+ *
+ * All semaphores are unnamed and live in the shared memory, so only the
+ * shared memory object itself has a name.
+ **/
+
+#ifndef SHMRING_H
+#define SHMRING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <time.h>
+
+/**
+ * @brief The largest number of records a ring can hold.
+ */
+#define SHMRING_MAX_CAPACITY (1 << 20)
+
+/**
+ * @brief The bound of the best-bound slot as long as the reader published
+ * nothing.
+ */
+#define SHMRING_NO_BOUND UINT64_MAX
+
+/**
+ * Backends of a ring
+ * @brief SHMRING_DEFAULT takes the backend from the environment variable
+ * SHMRING_BACKEND ("lockfree" or "semaphore") and is lockfree otherwise.
+ */
+enum shmring_backend
+{
+    SHMRING_DEFAULT,
+    SHMRING_LOCKFREE,
+    SHMRING_SEMAPHORE
+};
+
+/**
+ * Structure of the ring configuration
+ * @brief The geometry the creator chooses.
+ * @details record_size is the size of one record (at least 1), capacity the
+ * number of records the ring holds (1 to SHMRING_MAX_CAPACITY) and
+ * extra_size the size of the application area (may be 0). If hugepages is
+ * set the shared memory is rounded up to a multiple of 2 MiB and the kernel
+ * is asked to back it with transparent hugepages. If populate is set the
+ * creator touches every page before any writer can open the ring, so with
+ * the default first-touch policy all of it lives on the NUMA node of the
+ * creator (which should be pinned to a CPU, see shmpool_pin_self) instead of
+ * on the node of whichever writer touches a slot first.
+ */
+struct shmring_config
+{
+    size_t record_size;
+    size_t capacity;
+    size_t extra_size;
+    enum shmring_backend backend;
+    bool hugepages;
+    bool populate;
+};
+
+/**
+ * @brief The ring as seen by one process.
+ * @details This is an opaque struct, only a creator may read from it.
+ */
+struct shmring;
+
+/**
+ * Create a ring.
+ * @brief Create the shared memory object and initialize the ring, the
+ * caller becomes the only reader.
+ * @details Fails with EEXIST if the object already exists. The caller must
+ * call shmring_close, which also removes the object.
+ * @param name The name of the shared memory object, with a leading slash.
+ * @param config The geometry of the ring.
+ * @return Upon success the ring, otherwise NULL and errno is set (EINVAL if
+ * the configuration is invalid).
+ */
+struct shmring *shmring_create(const char *name, const struct shmring_config *config);
+
+/**
+ * Open a ring.
+ * @brief Map a ring some other process created, the caller becomes a
+ * writer.
+ * @details The caller must call shmring_close.
+ * @param name The name of the shared memory object.
+ * @param record_size The size of the records the caller writes, it must be
+ * the one the creator chose.
+ * @return Upon success the ring, otherwise NULL and errno is set (ENOENT if
+ * there is no ring, EINVAL if it is not initialized yet or has other
+ * records).
+ */
+struct shmring *shmring_open(const char *name, size_t record_size);
+
+/**
+ * Close a ring.
+ * @brief Unmap the ring, the creator also shuts it down and removes the
+ * shared memory object.
+ * @param ring The ring, it is invalid afterwards.
+ * @return Upon success 0, otherwise -1.
+ */
+int shmring_close(struct shmring *ring);
+
+/**
+ * Write a record.
+ * @brief Block until a slot is free and copy the record into it.
+ * @param ring A ring opened with shmring_open.
+ * @param record The record.
+ * @param len The number of bytes of the record that are used, at most the
+ * record size. Only those are copied.
+ * @return Upon success 0, otherwise -1 and errno is set (ECANCELED if the
+ * ring was shut down or its creator died, EINTR if a signal arrived while
+ * waiting for a free slot with the semaphore backend; the lockfree backend
+ * keeps waiting, as the slot it claimed must be filled).
+ */
+int shmring_write(struct shmring *ring, const void *record, size_t len);
+
+/**
+ * Write several records.
+ * @brief Like shmring_write for count whole records, but the slots are
+ * claimed together (with the semaphore backend at most capacity at a time)
+ * instead of one by one.
+ * @param ring A ring opened with shmring_open.
+ * @param records The records, one after the other.
+ * @param count The number of records.
+ * @return The same as shmring_write. If the ring was shut down meanwhile
+ * some of the records may have been written.
+ */
+int shmring_write_batch(struct shmring *ring, const void *records, size_t count);
+
+/**
+ * Read a record.
+ * @brief Block until a record was written and copy it.
+ * @param ring A ring created with shmring_create.
+ * @param record The destination, it must hold a whole record.
+ * @param deadline The CLOCK_REALTIME time to give up at, NULL to wait
+ * forever.
+ * @return Upon success the length the writer passed, otherwise -1 and errno
+ * is set (ECANCELED if the ring was shut down, ETIMEDOUT if the deadline
+ * passed, EINTR if a signal arrived).
+ */
+ssize_t shmring_read(struct shmring *ring, void *record, const struct timespec *deadline);
+
+/**
+ * Read several records.
+ * @brief Block until a record was written and copy it and all other records
+ * that are written already, up to max.
+ * @details The parts of a record its writer didn't use are undefined.
+ * @param ring A ring created with shmring_create.
+ * @param records The destination, it must hold max records.
+ * @param max The most records to read, at least 1.
+ * @param deadline The same as for shmring_read.
+ * @return Upon success the number of records read, otherwise the same as
+ * shmring_read.
+ */
+ssize_t shmring_read_batch(struct shmring *ring, void *records, size_t max,
+                           const struct timespec *deadline);
+
+/**
+ * Publish the best record.
+ * @brief Store a record and its bound in the best-bound slot.
+ * @details Only the creator must call this function. The slot is protected
+ * by a seqlock, so the writers never block the reader.
+ * @param ring A ring created with shmring_create.
+ * @param bound The bound the writers compare against.
+ * @param record The record, NULL if only the bound is of interest.
+ * @param len The number of bytes of the record, 0 if record is NULL.
+ */
+void shmring_set_best(struct shmring *ring, uint64_t bound, const void *record, size_t len);
+
+/**
+ * Read the best bound.
+ * @param ring The ring.
+ * @return The latest bound the creator published, or SHMRING_NO_BOUND.
+ */
+uint64_t shmring_best_bound(struct shmring *ring);
+
+/**
+ * Read the best record.
+ * @brief Copy the record of the best-bound slot, if it changed.
+ * @details The caller keeps the sequence number of the last record it read
+ * in seen, which must be 0 before the first call. Only if the creator
+ * published another record since then it is copied, so a writer can call
+ * this function after every solution.
+ * @param ring The ring.
+ * @param seen The sequence number of the last read record, gets updated.
+ * @param record The destination, it must hold a whole record.
+ * @param len The destination for the length of the record, may be NULL.
+ * @return true if a new record was copied, otherwise false.
+ */
+bool shmring_read_best(struct shmring *ring, uint64_t *seen, void *record, size_t *len);
+
+/**
+ * Shut the ring down.
+ * @brief Wake up every blocked reader and writer, all further reads and
+ * writes fail with ECANCELED.
+ * @details Is async-signal-safe, so it may be called from a signal handler.
+ * @param ring The ring.
+ */
+void shmring_shutdown(struct shmring *ring);
+
+/**
+ * Check the ring.
+ * @param ring The ring.
+ * @return false once the ring was shut down, otherwise true.
+ */
+bool shmring_alive(struct shmring *ring);
+
+/**
+ * Get the application area.
+ * @details The ring never touches it, the creator finds it zeroed.
+ * @param ring The ring.
+ * @return The area of extra_size bytes, aligned to a cache line, or NULL if
+ * the creator chose no area.
+ */
+void *shmring_extra(struct shmring *ring);
+
+/**
+ * Get the capacity.
+ * @param ring The ring.
+ * @return The number of records the ring holds.
+ */
+size_t shmring_capacity(struct shmring *ring);
+
+/**
+ * Get the number of pending records.
+ * @details Only a snapshot, the lockfree backend also counts records whose
+ * writer claimed a slot but didn't finish yet.
+ * @param ring The ring.
+ * @return The number of records written but not read yet.
+ */
+size_t shmring_pending(struct shmring *ring);
+
+/**
+ * Get the number of writers.
+ * @param ring The ring.
+ * @return The number of processes that have the ring open as writer.
+ */
+unsigned int shmring_writers(struct shmring *ring);
+
+/**
+ * Get the backend.
+ * @param ring The ring.
+ * @return The backend the creator chose, never SHMRING_DEFAULT.
+ */
+enum shmring_backend shmring_backend(struct shmring *ring);
+
+/**
+ * Define typed functions.
+ * @brief Defines prefix_write, prefix_write_batch, prefix_read and
+ * prefix_read_batch for records of type, which copy whole records and check
+ * type at compile time. Use it at file scope without a semicolon.
+ */
+#define SHMRING_TYPED(prefix, type)                                          \
+    static inline int prefix##_write(struct shmring *ring, const type *record) \
+    {                                                                        \
+        return shmring_write(ring, record, sizeof(type));                    \
+    }                                                                        \
+    static inline int prefix##_write_batch(struct shmring *ring,             \
+                                           const type *records, size_t count) \
+    {                                                                        \
+        return shmring_write_batch(ring, records, count);                    \
+    }                                                                        \
+    static inline int prefix##_read(struct shmring *ring, type *record,      \
+                                    const struct timespec *deadline)         \
+    {                                                                        \
+        return shmring_read(ring, record, deadline) == -1 ? -1 : 0;          \
+    }                                                                        \
+    static inline ssize_t prefix##_read_batch(struct shmring *ring,          \
+                                              type *records, size_t max,     \
+                                              const struct timespec *deadline) \
+    {                                                                        \
+        return shmring_read_batch(ring, records, max, deadline);             \
+    }
+
+#endif